@@ -0,0 +1,219 @@
+#include "AssetCache.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+#include <unordered_map>
+
+namespace
+{
+	// --------------------------------------------------------
+	// What the index remembers about one source file
+	// --------------------------------------------------------
+	struct SourceStamp
+	{
+		int64_t Timestamp;	// last write time
+		uint64_t Size;		// bytes
+		uint64_t Hash;		// HashBytes() of the contents
+	};
+
+	// --------------------------------------------------------
+	// The cache's state, shared by every thread that loads assets
+	// --------------------------------------------------------
+	struct AssetCacheState
+	{
+		std::mutex Mutex;
+		std::string Directory;
+		std::unordered_map<std::string, SourceStamp> Index; // by canonical path
+	};
+
+	AssetCacheState& State()
+	{
+		static AssetCacheState state;
+		return state;
+	}
+
+	/// <summary>
+	/// Absolute path with forward slashes, so the same file found through different relative paths shares an index entry
+	/// </summary>
+	std::string CanonicalName(const std::string& a_sFileName)
+	{
+		std::error_code error;
+		std::filesystem::path path = std::filesystem::weakly_canonical(std::filesystem::path(a_sFileName), error);
+		return error ? std::filesystem::path(a_sFileName).generic_string() : path.generic_string();
+	}
+
+	/// <summary>
+	/// Version of the data a kind of entry holds; meshes also change whenever the mesh cache layout does
+	/// </summary>
+	uint32_t KindVersion(int a_nKind)
+	{
+		return a_nKind == ASSET_KIND_MESH || a_nKind == ASSET_KIND_MESH_UNOPTIMIZED ? MESH_CACHE_VERSION : 0;
+	}
+
+	const char* KindExtension(int a_nKind)
+	{
+		return a_nKind == ASSET_KIND_MESH || a_nKind == ASSET_KIND_MESH_UNOPTIMIZED ? ".meshcache" : ".dds";
+	}
+
+	std::string IndexFileName(const std::string& a_sDirectory)
+	{
+		return (std::filesystem::path(a_sDirectory) / ASSET_CACHE_INDEX_FILE).string();
+	}
+}
+
+/// <summary>
+/// Points the cache at a directory and reads the source index in it
+/// </summary>
+/// <param name="a_sDirectory">Cache directory (created when the first entry is), empty to turn the cache off</param>
+void SetAssetCacheDirectory(const std::string& a_sDirectory)
+{
+	AssetCacheState& state = State();
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	state.Directory = a_sDirectory;
+	state.Index.clear();
+	if (a_sDirectory.empty())
+		return;
+
+	// one source per line: hash, size, write time, path (which may hold spaces, so it comes last)
+	std::ifstream file(IndexFileName(a_sDirectory));
+	std::string sLine;
+	while (std::getline(file, sLine))
+	{
+		SourceStamp stamp;
+		std::string sPath;
+		std::istringstream fields(sLine);
+		fields >> std::hex >> stamp.Hash >> std::dec >> stamp.Size >> stamp.Timestamp;
+		fields.get();
+		if (fields && std::getline(fields, sPath) && !sPath.empty())
+			state.Index[sPath] = stamp;
+	}
+}
+
+/// <summary>
+/// Gets the directory entries are kept in
+/// </summary>
+/// <returns>Cache directory, empty if the cache is off</returns>
+std::string GetAssetCacheDirectory()
+{
+	AssetCacheState& state = State();
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	return state.Directory;
+}
+
+/// <summary>
+/// Hashes the contents of a source file, or takes the hash from the index if the file hasn't changed since
+/// </summary>
+/// <param name="a_sFileName">Path to the source</param>
+/// <param name="a_uHash">Receives the hash</param>
+/// <returns>False if the file can't be read</returns>
+bool HashAssetSource(const std::string& a_sFileName, uint64_t& a_uHash)
+{
+	std::error_code error;
+	std::filesystem::path path(a_sFileName);
+	auto time = std::filesystem::last_write_time(path, error);
+	if (error) return false;
+	uintmax_t size = std::filesystem::file_size(path, error);
+	if (error) return false;
+
+	SourceStamp stamp = { (int64_t)time.time_since_epoch().count(), (uint64_t)size, 0 };
+	std::string sName = CanonicalName(a_sFileName);
+	AssetCacheState& state = State();
+	{
+		std::lock_guard<std::mutex> lock(state.Mutex);
+		auto it = state.Index.find(sName);
+		if (it != state.Index.end() && it->second.Timestamp == stamp.Timestamp && it->second.Size == stamp.Size)
+		{
+			a_uHash = it->second.Hash;
+			return true;
+		}
+	}
+
+	// hashed outside the lock, so other threads can look up their sources meanwhile
+	if (size > 0)
+	{
+		MappedFile source(a_sFileName.c_str());
+		if (!source.IsOpen())
+			return false;
+		stamp.Hash = HashBytes(source.GetData(), source.GetSize());
+	}
+	else
+		stamp.Hash = HashBytes(nullptr, 0);
+
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	state.Index[sName] = stamp;
+	a_uHash = stamp.Hash;
+	return true;
+}
+
+/// <summary>
+/// Finds where the entry of an asset cooked from the given sources lives
+/// </summary>
+/// <param name="a_nKind">ASSET_KIND_* the sources are cooked as</param>
+/// <param name="a_vSources">Source files in the order the kind takes them, empty for a missing one</param>
+/// <param name="a_uParameters">Hash of anything else the cooked data depends on</param>
+/// <returns>Path of the entry, which may not exist yet; empty if the cache is off or a source can't be read</returns>
+std::string GetAssetCachePath(int a_nKind, const std::vector<std::string>& a_vSources, uint64_t a_uParameters)
+{
+	std::string sDirectory = GetAssetCacheDirectory();
+	if (sDirectory.empty())
+		return "";
+
+	// the key covers the cooker's version and everything that goes into the cooked data, and nothing else,
+	// so moving or renaming a source keeps its entry
+	uint64_t pHeader[3] = { ((uint64_t)ASSET_CACHE_VERSION << 32) | KindVersion(a_nKind), (uint64_t)a_nKind, a_uParameters };
+	uint64_t uKey = HashBytes(pHeader, sizeof(pHeader));
+	for (const std::string& sSource : a_vSources)
+	{
+		uint64_t uHash = 0;
+		if (!sSource.empty() && !HashAssetSource(sSource, uHash))
+			return "";
+		uKey = HashBytes(&uHash, sizeof(uHash), uKey);
+	}
+
+	// entries are spread over 256 directories by the first byte of their key
+	char sName[32];
+	snprintf(sName, sizeof(sName), "%016" PRIx64, uKey);
+	std::filesystem::path directory = std::filesystem::path(sDirectory) / std::string(sName, 2);
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	return (directory / (std::string(sName) + KindExtension(a_nKind))).string();
+}
+
+/// <summary>
+/// Writes the source index to the cache directory (to a temporary file that is then renamed over the old one)
+/// </summary>
+/// <returns>Whether the index was written</returns>
+bool SaveAssetCacheIndex()
+{
+	AssetCacheState& state = State();
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	if (state.Directory.empty())
+		return false;
+
+	std::error_code error;
+	std::filesystem::create_directories(state.Directory, error);
+	std::string sFileName = IndexFileName(state.Directory);
+	std::string sTempName = sFileName + ".tmp";
+	{
+		std::ofstream file(sTempName, std::ios::trunc);
+		if (!file)
+			return false;
+		for (const auto& entry : state.Index)
+		{
+			char sLine[64];
+			snprintf(sLine, sizeof(sLine), "%016" PRIx64 " %" PRIu64 " %" PRId64 " ", entry.second.Hash, entry.second.Size, entry.second.Timestamp);
+			file << sLine << entry.first << '\n';
+		}
+		if (!file.good())
+			return false;
+	}
+	std::filesystem::rename(sTempName, sFileName, error);
+	return !error;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bump whenever what the cook tool writes for a kind changes, so older entries miss instead of loading
+#define ASSET_CACHE_VERSION 1
+
+// What an entry was cooked as. Part of its key, so one source cooked two ways gets two entries.
+#define ASSET_KIND_MESH				0	// .meshcache of an optimized OBJ
+#define ASSET_KIND_MESH_UNOPTIMIZED	1	// .meshcache of an OBJ in its own order
+#define ASSET_KIND_COLOR_TEXTURE	2	// BC7 .dds of an albedo map
+#define ASSET_KIND_NORMAL_TEXTURE	3	// BC5 .dds of a normal map
+#define ASSET_KIND_DATA_TEXTURE		4	// BC4 .dds of a one-channel map
+#define ASSET_KIND_PACKED_MAPS		5	// BC7 .dds of occlusion, roughness and metalness maps packed into RGB
+#define ASSET_KIND_CUBEMAP			6	// BC7 .dds cubemap from six faces
+
+// File in the cache directory that remembers the hash of every source by its size and write time
+#define ASSET_CACHE_INDEX_FILE "sources.index"
+
+// Points the cache at a directory (empty turns it off) and reads the source index in it. Until it
+// is called, GetAssetCachePath returns nothing and assets load from their sources as before.
+void SetAssetCacheDirectory(const std::string& a_sDirectory);
+
+// The directory entries are kept in, empty if the cache is off
+std::string GetAssetCacheDirectory();
+
+// Content hash (HashBytes) of a source file. A file whose size and write time match the index
+// isn't read again. Safe to call from any thread.
+bool HashAssetSource(const std::string& a_sFileName, uint64_t& a_uHash);
+
+// Path of the entry a kind of asset cooked from these sources has, keyed by the sources' contents,
+// the cooker version and a_uParameters (anything else the cooked data depends on, e.g. defaults).
+// An empty source name stands for a missing input, like an absent packed map. Creates the entry's
+// directory, but not the entry; returns an empty string if the cache is off or a source can't be read.
+std::string GetAssetCachePath(int a_nKind, const std::vector<std::string>& a_vSources, uint64_t a_uParameters = 0);
+
+// Writes the source index back, so the next run doesn't hash unchanged sources again
+bool SaveAssetCacheIndex();
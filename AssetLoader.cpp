@@ -0,0 +1,554 @@
+#include "AssetLoader.h"
+#include <Windows.h>
+#include <objbase.h>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "AssetCache.h"
+#include "DDSTextureLoader.h"
+#include "DdsFile.h"
+#include "Hash.h"
+#include "Graphics.h"
+#include "TextureUpload.h"
+
+using namespace DirectX;
+
+namespace
+{
+	/// <summary>
+	/// Builds a unit cube that stands in for meshes that are still loading
+	/// </summary>
+	/// <returns>Uploaded cube mesh</returns>
+	std::shared_ptr<Mesh> CreatePlaceholderCube()
+	{
+		const XMFLOAT3 normals[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		const XMFLOAT2 uvs[4] = { { 0, 1 }, { 0, 0 }, { 1, 0 }, { 1, 1 } };
+		const float corners[4][2] = { { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, -1 } };
+
+		Vertex verts[24];
+		unsigned int indices[36];
+		for (int f = 0; f < 6; f++)
+		{
+			// right and up as seen from outside the face, so the corners below wind clockwise
+			XMVECTOR n = XMLoadFloat3(&normals[f]);
+			XMVECTOR up = normals[f].y != 0 ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0);
+			XMVECTOR right = XMVector3Cross(up, XMVectorNegate(n));
+			for (int c = 0; c < 4; c++)
+			{
+				Vertex& v = verts[f * 4 + c];
+				XMVECTOR p = XMVectorScale(XMVectorAdd(n, XMVectorAdd(XMVectorScale(right, corners[c][0]), XMVectorScale(up, corners[c][1]))), 0.5f);
+				XMStoreFloat3(&v.Position, p);
+				v.UV = uvs[c];
+				v.Normal = normals[f];
+				v.Tangent = XMFLOAT4(0, 0, 0, 0);
+			}
+
+			unsigned int uFirst = f * 4;
+			unsigned int face[6] = { uFirst, uFirst + 1, uFirst + 2, uFirst, uFirst + 2, uFirst + 3 };
+			std::copy(face, face + 6, indices + f * 6);
+		}
+		return std::make_shared<Mesh>(verts, 24, indices, 36, false);
+	}
+
+	/// <summary>
+	/// Creates a 1x1 texture (or cubemap) of a single color that stands in for textures that are still loading
+	/// </summary>
+	/// <param name="a_f4Color">Color of the texture</param>
+	/// <param name="a_bCubemap">Whether to create a cubemap</param>
+	/// <returns>Texture view</returns>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateSolidTexture(XMFLOAT4 a_f4Color, bool a_bCubemap)
+	{
+		uint32_t uPixel = 0;
+		const float channels[4] = { a_f4Color.x, a_f4Color.y, a_f4Color.z, a_f4Color.w };
+		for (int c = 0; c < 4; c++)
+			uPixel |= (uint32_t)(std::clamp(channels[c], 0.0f, 1.0f) * 255.0f + 0.5f) << (c * 8);
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = 1;
+		desc.Height = 1;
+		desc.MipLevels = 1;
+		desc.ArraySize = a_bCubemap ? 6 : 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = a_bCubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+		D3D11_SUBRESOURCE_DATA faces[6];
+		for (int i = 0; i < 6; i++)
+			faces[i] = { &uPixel, sizeof(uPixel), 0 };
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> cpTexture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cpSRV;
+		if (SUCCEEDED(Graphics::Device->CreateTexture2D(&desc, faces, cpTexture.GetAddressOf())))
+			Graphics::Device->CreateShaderResourceView(cpTexture.Get(), nullptr, cpSRV.GetAddressOf());
+		return cpSRV;
+	}
+
+	/// <summary>
+	/// Strips the directories off a path for display
+	/// </summary>
+	std::string FileNameOf(const std::wstring& a_wsPath)
+	{
+		size_t uSlash = a_wsPath.find_last_of(L"/\\");
+		std::wstring wsName = uSlash == std::wstring::npos ? a_wsPath : a_wsPath.substr(uSlash + 1);
+		std::string sName;
+		for (wchar_t c : wsName)
+			sName += c < 128 ? (char)c : '?';
+		return sName;
+	}
+
+	/// <summary>
+	/// Path the texture cooker writes an image's .dds to: the same name with a .dds extension
+	/// </summary>
+	std::wstring CookedFileNameOf(const std::wstring& a_wsPath)
+	{
+		size_t uDot = a_wsPath.find_last_of(L'.');
+		size_t uSlash = a_wsPath.find_last_of(L"/\\");
+		if (uDot == std::wstring::npos || (uSlash != std::wstring::npos && uDot < uSlash))
+			return a_wsPath + L".dds";
+		return a_wsPath.substr(0, uDot) + L".dds";
+	}
+
+	/// <summary>
+	/// Path the texture cooker writes a material's packed maps to: the first map's name with _packed.dds
+	/// </summary>
+	/// <returns>Empty if the material has no maps</returns>
+	std::wstring PackedFileNameOf(const std::vector<std::wstring>& a_vMaps)
+	{
+		for (const std::wstring& wsMap : a_vMaps)
+			if (!wsMap.empty())
+			{
+				std::wstring wsCooked = CookedFileNameOf(wsMap);
+				return wsCooked.substr(0, wsCooked.size() - 4) + L"_packed.dds";
+			}
+		return L"";
+	}
+
+	/// <summary>
+	/// Path of a texture's entry in the asset cache (see the Cook tool), which is keyed by the contents of its images
+	/// </summary>
+	/// <param name="a_vImages">Image files of the request, empty for a missing packed map</param>
+	/// <param name="a_nKind">TEXTURE_KIND_* of a single image</param>
+	/// <param name="a_pPackDefaults">Constants of missing packed maps, null if the images aren't packed</param>
+	/// <returns>Empty if the cache is off or an image can't be read</returns>
+	std::wstring CacheEntryOf(const std::vector<std::wstring>& a_vImages, int a_nKind, bool a_bCubemap, const float* a_pPackDefaults)
+	{
+		int nKind = a_bCubemap ? ASSET_KIND_CUBEMAP : a_pPackDefaults ? ASSET_KIND_PACKED_MAPS :
+			a_nKind == TEXTURE_KIND_NORMAL ? ASSET_KIND_NORMAL_TEXTURE : a_nKind == TEXTURE_KIND_DATA ? ASSET_KIND_DATA_TEXTURE : ASSET_KIND_COLOR_TEXTURE;
+		std::vector<std::string> vSources;
+		for (const std::wstring& wsImage : a_vImages)
+			vSources.push_back(wsImage.empty() ? std::string() : std::filesystem::path(wsImage).string());
+		uint64_t uParameters = a_pPackDefaults ? HashBytes(a_pPackDefaults, sizeof(float) * PACKED_CHANNEL_COUNT) : 0;
+		return std::filesystem::path(GetAssetCachePath(nKind, vSources, uParameters)).wstring();
+	}
+
+	/// <summary>
+	/// Reads a whole file into memory
+	/// </summary>
+	/// <returns>False if the file doesn't exist or can't be read</returns>
+	bool ReadWholeFile(const std::wstring& a_wsPath, std::vector<uint8_t>& a_vData)
+	{
+		std::ifstream file(std::filesystem::path(a_wsPath), std::ios::binary);
+		if (!file)
+			return false;
+		a_vData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return !file.bad() && !a_vData.empty();
+	}
+
+	/// <summary>
+	/// Milliseconds between two points in time
+	/// </summary>
+	double MillisecondsBetween(std::chrono::high_resolution_clock::time_point a_tpStart, std::chrono::high_resolution_clock::time_point a_tpEnd)
+	{
+		return std::chrono::duration<double, std::milli>(a_tpEnd - a_tpStart).count();
+	}
+}
+
+/// <summary>
+/// Starts the worker threads
+/// </summary>
+/// <param name="a_uThreadCount">Number of workers, 0 to use every core but the main thread's (up to ASSET_LOADER_MAX_THREADS)</param>
+AssetLoader::AssetLoader(unsigned int a_uThreadCount)
+{
+	m_bStopping = false;
+	m_uPending = 0;
+	m_dAllLoadedMilliseconds = 0.0;
+	m_tpCreated = std::chrono::high_resolution_clock::now();
+
+	if (a_uThreadCount == 0)
+		a_uThreadCount = std::clamp(std::thread::hardware_concurrency(), 2u, ASSET_LOADER_MAX_THREADS + 1u) - 1;
+	for (unsigned int i = 0; i < a_uThreadCount; i++)
+		m_vWorkers.emplace_back(&AssetLoader::WorkerMain, this);
+}
+
+/// <summary>
+/// Stops the workers, dropping anything that hasn't started loading
+/// </summary>
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStopping = true;
+	}
+	m_WorkAvailable.notify_all();
+	for (std::thread& worker : m_vWorkers)
+		worker.join();
+}
+
+/// <summary>
+/// Queues an .OBJ mesh for loading
+/// </summary>
+/// <param name="a_sFileName">Path to the .OBJ file</param>
+/// <param name="a_bOptimize">Whether to optimize the mesh (see Mesh)</param>
+/// <returns>A mesh that draws as a cube until the file is loaded</returns>
+std::shared_ptr<Mesh> AssetLoader::LoadMesh(const std::string& a_sFileName, bool a_bOptimize)
+{
+	std::unique_ptr<Request> upRequest = std::make_unique<Request>();
+	upRequest->MeshFileName = a_sFileName;
+	upRequest->Optimize = a_bOptimize;
+	upRequest->MeshHandle = CreatePlaceholderCube();
+
+	std::shared_ptr<Mesh> spHandle = upRequest->MeshHandle;
+	Submit(std::move(upRequest), FileNameOf(std::wstring(a_sFileName.begin(), a_sFileName.end())));
+	return spHandle;
+}
+
+/// <summary>
+/// Queues an image file for loading as a mipmapped texture, or the cooked .dds next to it if there is one
+/// </summary>
+/// <param name="a_wsFileName">Path to the image</param>
+/// <param name="a_f4Placeholder">Color of the 1x1 texture used until the image is loaded</param>
+/// <param name="a_nKind">TEXTURE_KIND_* of the image, which decides how its mips are filtered</param>
+/// <returns>Texture handle</returns>
+std::shared_ptr<TextureAsset> AssetLoader::LoadTexture(const std::wstring& a_wsFileName, DirectX::XMFLOAT4 a_f4Placeholder, int a_nKind)
+{
+	std::unique_ptr<Request> upRequest = std::make_unique<Request>();
+	upRequest->ImageFileNames = { a_wsFileName };
+	upRequest->Kind = a_nKind;
+	upRequest->Cubemap = false;
+	upRequest->PackedMaps = false;
+	upRequest->TextureHandle = std::make_shared<TextureAsset>();
+	upRequest->TextureHandle->SRV = CreateSolidTexture(a_f4Placeholder, false);
+	upRequest->TextureHandle->Loaded = false;
+
+	std::shared_ptr<TextureAsset> spHandle = upRequest->TextureHandle;
+	Submit(std::move(upRequest), FileNameOf(a_wsFileName));
+	return spHandle;
+}
+
+/// <summary>
+/// Queues six image files for loading as the faces of a cubemap
+/// </summary>
+/// <param name="a_f4Placeholder">Color of the 1x1 cubemap used until the faces are loaded</param>
+/// <returns>Texture handle</returns>
+std::shared_ptr<TextureAsset> AssetLoader::LoadCubemap(const std::wstring& a_wsRight, const std::wstring& a_wsLeft, const std::wstring& a_wsUp,
+	const std::wstring& a_wsDown, const std::wstring& a_wsFront, const std::wstring& a_wsBack, DirectX::XMFLOAT4 a_f4Placeholder)
+{
+	std::unique_ptr<Request> upRequest = std::make_unique<Request>();
+	upRequest->ImageFileNames = { a_wsRight, a_wsLeft, a_wsUp, a_wsDown, a_wsFront, a_wsBack };
+	upRequest->Kind = TEXTURE_KIND_COLOR;
+	upRequest->Cubemap = true;
+	upRequest->PackedMaps = false;
+	upRequest->TextureHandle = std::make_shared<TextureAsset>();
+	upRequest->TextureHandle->SRV = CreateSolidTexture(a_f4Placeholder, true);
+	upRequest->TextureHandle->Loaded = false;
+
+	std::shared_ptr<TextureAsset> spHandle = upRequest->TextureHandle;
+	Submit(std::move(upRequest), FileNameOf(a_wsRight) + " (cubemap)");
+	return spHandle;
+}
+
+/// <summary>
+/// Queues a material's occlusion, roughness and metalness maps for packing into the RGB channels
+/// of one texture (or loads the cooked _packed.dds of them). Flat maps collapse into constants.
+/// </summary>
+/// <param name="a_wsOcclusion">Path to the occlusion map, empty if there is none</param>
+/// <param name="a_wsRoughness">Path to the roughness map, empty if there is none</param>
+/// <param name="a_wsMetalness">Path to the metalness map, empty if there is none</param>
+/// <param name="a_f3Defaults">Occlusion, roughness and metalness of missing maps, also used until the maps are loaded</param>
+/// <returns>Texture handle, with the constant channels in Constant/Sampled</returns>
+std::shared_ptr<TextureAsset> AssetLoader::LoadPackedMaps(const std::wstring& a_wsOcclusion, const std::wstring& a_wsRoughness,
+	const std::wstring& a_wsMetalness, DirectX::XMFLOAT3 a_f3Defaults)
+{
+	std::unique_ptr<Request> upRequest = std::make_unique<Request>();
+	upRequest->ImageFileNames = { a_wsOcclusion, a_wsRoughness, a_wsMetalness };
+	upRequest->Kind = TEXTURE_KIND_DATA;
+	upRequest->Cubemap = false;
+	upRequest->PackedMaps = true;
+	upRequest->PackDefaults[PACKED_CHANNEL_OCCLUSION] = a_f3Defaults.x;
+	upRequest->PackDefaults[PACKED_CHANNEL_ROUGHNESS] = a_f3Defaults.y;
+	upRequest->PackDefaults[PACKED_CHANNEL_METALNESS] = a_f3Defaults.z;
+
+	// until the maps are in, every channel is its default and nothing is sampled
+	upRequest->TextureHandle = std::make_shared<TextureAsset>();
+	upRequest->TextureHandle->SRV = CreateSolidTexture(XMFLOAT4(a_f3Defaults.x, a_f3Defaults.y, a_f3Defaults.z, 1.0f), false);
+	upRequest->TextureHandle->Loaded = false;
+	upRequest->TextureHandle->Constant = a_f3Defaults;
+	upRequest->TextureHandle->Sampled = XMFLOAT3(0, 0, 0);
+
+	std::wstring wsFirst = !a_wsOcclusion.empty() ? a_wsOcclusion : !a_wsRoughness.empty() ? a_wsRoughness : a_wsMetalness;
+	std::shared_ptr<TextureAsset> spHandle = upRequest->TextureHandle;
+	Submit(std::move(upRequest), FileNameOf(wsFirst) + " (packed)");
+	return spHandle;
+}
+
+/// <summary>
+/// Creates the GPU resources of every asset the workers finished since the last call
+/// and swaps them in for their placeholders. Call once per frame on the main thread.
+/// </summary>
+void AssetLoader::Update()
+{
+	std::vector<std::unique_ptr<Request>> vFinished;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		vFinished.swap(m_vFinished);
+	}
+
+	for (std::unique_ptr<Request>& upRequest : vFinished)
+		Finish(*upRequest);
+}
+
+/// <summary>
+/// Adds a request to the queue
+/// </summary>
+/// <param name="a_upRequest">Request with its handle set up</param>
+/// <param name="a_sName">Name shown in the load timings</param>
+void AssetLoader::Submit(std::unique_ptr<Request> a_upRequest, std::string a_sName)
+{
+	AssetLoadRecord record = {};
+	record.Name = a_sName;
+	m_vRecords.push_back(record);
+	m_uPending++;
+	m_dAllLoadedMilliseconds = 0.0;
+
+	a_upRequest->Record = m_vRecords.size() - 1;
+	a_upRequest->Queued = std::chrono::high_resolution_clock::now();
+	a_upRequest->Failed = false;
+	a_upRequest->MipMilliseconds = 0.0;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_dQueued.push_back(std::move(a_upRequest));
+	}
+	m_WorkAvailable.notify_one();
+}
+
+/// <summary>
+/// Worker loop: reads and decodes requests until the loader is destroyed
+/// </summary>
+void AssetLoader::WorkerMain()
+{
+	// WIC needs COM on every thread that decodes
+	HRESULT hrCom = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	while (true)
+	{
+		std::unique_ptr<Request> upRequest;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkAvailable.wait(lock, [this] { return m_bStopping || !m_dQueued.empty(); });
+			if (m_bStopping)
+				break;
+			upRequest = std::move(m_dQueued.front());
+			m_dQueued.pop_front();
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		upRequest->WaitMilliseconds = MillisecondsBetween(upRequest->Queued, start);
+		try
+		{
+			if (upRequest->MeshHandle)
+			{
+				upRequest->LoadedMesh = std::make_unique<Mesh>(upRequest->MeshFileName.c_str(), upRequest->Optimize, true);
+			}
+			else
+			{
+				// the texture's entry in the asset cache, or else a cooked .dds next to the image,
+				// is loaded instead of decoding the images
+				std::wstring wsEntry = CacheEntryOf(upRequest->ImageFileNames, upRequest->Kind, upRequest->Cubemap,
+					upRequest->PackedMaps ? upRequest->PackDefaults : nullptr);
+				std::wstring wsCooked = upRequest->Cubemap ? L"" :
+					upRequest->PackedMaps ? PackedFileNameOf(upRequest->ImageFileNames) : CookedFileNameOf(upRequest->ImageFileNames[0]);
+				if ((wsEntry.empty() || !ReadWholeFile(wsEntry, upRequest->CookedData)) &&
+					(wsCooked.empty() || !ReadWholeFile(wsCooked, upRequest->CookedData)))
+				{
+					upRequest->Images.resize(upRequest->ImageFileNames.size());
+					for (size_t i = 0; i < upRequest->ImageFileNames.size() && !upRequest->Failed; i++)
+						if (!upRequest->ImageFileNames[i].empty())
+							upRequest->Failed = !DecodeImageFile(upRequest->ImageFileNames[i].c_str(), upRequest->Images[i]);
+
+					if (upRequest->PackedMaps && !upRequest->Failed)
+					{
+						const DecodedImage* pMaps[PACKED_CHANNEL_COUNT];
+						for (int c = 0; c < PACKED_CHANNEL_COUNT; c++)
+							pMaps[c] = upRequest->ImageFileNames[c].empty() ? nullptr : &upRequest->Images[c];
+						PackMaterialMaps(upRequest->Packed, pMaps[PACKED_CHANNEL_OCCLUSION], pMaps[PACKED_CHANNEL_ROUGHNESS],
+							pMaps[PACKED_CHANNEL_METALNESS], upRequest->PackDefaults);
+						upRequest->Images.clear();
+						upRequest->Images.push_back(std::move(upRequest->Packed.Image));
+					}
+
+					// the pool already loads one texture per core, so each chain is built on this thread alone
+					auto mipStart = std::chrono::high_resolution_clock::now();
+					if (!upRequest->Failed)
+						for (DecodedImage& image : upRequest->Images)
+							upRequest->MipChains.push_back(GenerateMipChain(std::move(image), upRequest->Kind, ASSET_LOADER_MIP_FILTER, 1));
+					upRequest->Images.clear();
+					upRequest->MipMilliseconds = MillisecondsBetween(mipStart, std::chrono::high_resolution_clock::now());
+				}
+			}
+		}
+		catch (const std::exception&)
+		{
+			upRequest->Failed = true;
+		}
+		upRequest->LoadMilliseconds = MillisecondsBetween(start, std::chrono::high_resolution_clock::now());
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_vFinished.push_back(std::move(upRequest));
+	}
+
+	if (SUCCEEDED(hrCom))
+		CoUninitialize();
+}
+
+/// <summary>
+/// Creates the GPU resources of one finished request and replaces its placeholder
+/// </summary>
+/// <param name="a_Request">Request a worker is done with</param>
+void AssetLoader::Finish(Request& a_Request)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	if (!a_Request.Failed)
+	{
+		if (a_Request.MeshHandle)
+		{
+			a_Request.LoadedMesh->Upload();
+			a_Request.MeshHandle->Replace(std::move(*a_Request.LoadedMesh));
+		}
+		else
+		{
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cpSRV;
+			if (a_Request.Cubemap || !m_spTextureStreamer || !StreamTexture(a_Request, cpSRV))
+			{
+				if (!a_Request.CookedData.empty())
+					CreateDDSTextureFromMemory(Graphics::Device.Get(), a_Request.CookedData.data(), a_Request.CookedData.size(), nullptr, cpSRV.GetAddressOf());
+				else
+					cpSRV = a_Request.Cubemap ? CreateMippedCubemap(a_Request.MipChains) : CreateMippedTexture(a_Request.MipChains[0]);
+			}
+			a_Request.Failed = cpSRV == nullptr;
+			if (cpSRV)
+			{
+				a_Request.TextureHandle->SRV = cpSRV;
+				a_Request.TextureHandle->Loaded = true;
+
+				// the cooked file doesn't say which channels are flat (it holds their values), so all of it is sampled
+				if (a_Request.PackedMaps)
+				{
+					const PackedMaterialMaps& packed = a_Request.Packed;
+					bool bCooked = !a_Request.CookedData.empty();
+					if (!bCooked)
+						a_Request.TextureHandle->Constant = XMFLOAT3(packed.ConstantValue[0], packed.ConstantValue[1], packed.ConstantValue[2]);
+					a_Request.TextureHandle->Sampled = XMFLOAT3(
+						bCooked || !packed.Constant[0] ? 1.0f : 0.0f,
+						bCooked || !packed.Constant[1] ? 1.0f : 0.0f,
+						bCooked || !packed.Constant[2] ? 1.0f : 0.0f);
+				}
+			}
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	AssetLoadRecord& record = m_vRecords[a_Request.Record];
+	record.WaitMilliseconds = a_Request.WaitMilliseconds;
+	record.LoadMilliseconds = a_Request.LoadMilliseconds;
+	record.MipMilliseconds = a_Request.MipMilliseconds;
+	record.UploadMilliseconds = MillisecondsBetween(start, end);
+	record.TotalMilliseconds = MillisecondsBetween(a_Request.Queued, end);
+	record.Done = true;
+	record.Failed = a_Request.Failed;
+	record.Cooked = !a_Request.CookedData.empty();
+
+	if (--m_uPending == 0)
+		m_dAllLoadedMilliseconds = MillisecondsBetween(m_tpCreated, end);
+}
+
+/// <summary>
+/// Hands a finished 2D texture's levels to the texture streamer, which creates it with only its low levels
+/// </summary>
+/// <param name="a_Request">Texture request a worker is done with</param>
+/// <param name="a_cpSRV">Receives the streamed texture's view, null if it couldn't be created</param>
+/// <returns>False if the cooked file isn't one the texture cooker wrote, which is then loaded whole</returns>
+bool AssetLoader::StreamTexture(Request& a_Request, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& a_cpSRV)
+{
+	std::vector<StreamedMipLevel> vLevels;
+	DXGI_FORMAT format;
+	if (!a_Request.CookedData.empty())
+	{
+		uint32_t uFormat;
+		std::vector<DdsMipLevel> vBlocks;
+		if (!ReadDdsFile(a_Request.CookedData.data(), a_Request.CookedData.size(), uFormat, vBlocks))
+			return false;
+		uint32_t uBlockSize = GetDdsBlockSize(uFormat);
+		for (DdsMipLevel& level : vBlocks)
+			vLevels.push_back({ level.Width, level.Height, (level.Width + 3) / 4 * uBlockSize, std::move(level.Blocks) });
+		format = (DXGI_FORMAT)uFormat;
+	}
+	else
+	{
+		std::vector<DecodedImage>& vMips = a_Request.MipChains[0];
+		for (DecodedImage& mip : vMips)
+			vLevels.push_back({ mip.Width, mip.Height, mip.Width * 4, std::move(mip.Pixels) });
+		format = vMips[0].SRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	a_cpSRV = m_spTextureStreamer->AddTexture(a_Request.TextureHandle, format, std::move(vLevels)) ? a_Request.TextureHandle->SRV : nullptr;
+	return true;
+}
+
+#pragma region Getters
+/// <summary>
+/// Gets the number of worker threads
+/// </summary>
+/// <returns>Thread count</returns>
+unsigned int AssetLoader::GetThreadCount()
+{
+	return (unsigned int)m_vWorkers.size();
+}
+/// <summary>
+/// Gets the number of assets that still show their placeholder
+/// </summary>
+/// <returns>Pending asset count</returns>
+unsigned int AssetLoader::GetPendingCount()
+{
+	return m_uPending;
+}
+/// <summary>
+/// Gets the timings of every requested asset, in request order
+/// </summary>
+/// <returns>Load records</returns>
+std::vector<AssetLoadRecord> AssetLoader::GetRecords()
+{
+	return m_vRecords;
+}
+/// <summary>
+/// Gets the time from the loader's creation until the last pending asset came in
+/// </summary>
+/// <returns>Milliseconds, 0 while assets are still loading</returns>
+double AssetLoader::GetAllLoadedMilliseconds()
+{
+	return m_dAllLoadedMilliseconds;
+}
+#pragma endregion
+#pragma region Setters
+/// <summary>
+/// Sets the streamer loaded 2D textures are handed to (cubemaps are always created whole)
+/// </summary>
+/// <param name="a_spTextureStreamer">Texture streamer, null to create textures with every level</param>
+void AssetLoader::SetTextureStreamer(std::shared_ptr<TextureStreamer> a_spTextureStreamer)
+{
+	m_spTextureStreamer = a_spTextureStreamer;
+}
+#pragma endregion
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <DirectXMath.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Mesh.h"
+#include "ImageDecoder.h"
+#include "MaterialPacking.h"
+#include "TextureAsset.h"
+#include "TextureMips.h"
+#include "TextureStreaming.h"
+
+// Most worker threads the loader starts (each one may hold a decoded 4K image at a time)
+#define ASSET_LOADER_MAX_THREADS 8
+
+// Filter the workers build the mip chains of decoded images with (MIP_FILTER_*)
+#define ASSET_LOADER_MIP_FILTER MIP_FILTER_KAISER
+
+// --------------------------------------------------------
+// Timings of one loaded (or failed) asset
+// --------------------------------------------------------
+struct AssetLoadRecord
+{
+	std::string Name;
+	double WaitMilliseconds;	// queued before a worker picked it up
+	double LoadMilliseconds;	// worker: file I/O, parsing and decoding
+	double MipMilliseconds;		// worker: building mip chains (part of LoadMilliseconds)
+	double UploadMilliseconds;	// main thread: creating the GPU resources
+	double TotalMilliseconds;	// from the request until the asset replaced its placeholder
+	bool Done;
+	bool Failed;				// the placeholder stays
+	bool Cooked;				// came from a block compressed .dds the asset cache or the texture cooker had
+};
+
+// --------------------------------------------------------
+// Loads meshes and textures on a pool of worker threads.
+// Every request immediately returns a handle that draws as a
+// placeholder (a cube, or a 1x1 texture) until the asset is
+// in. The workers read, decode and build the mip chains of
+// textures; the GPU resources are created in batches on the
+// main thread by Update(). A texture with an entry in the
+// asset cache (see AssetCache and the Cook tool), or a cooked
+// .dds next to its image (see TextureCooker), is read from
+// that instead, compressed and with its mips. With a texture streamer set,
+// loaded 2D textures are handed to it instead of being
+// created with every level.
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+	AssetLoader(unsigned int a_uThreadCount = 0);
+	~AssetLoader();
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	std::shared_ptr<Mesh> LoadMesh(const std::string& a_sFileName, bool a_bOptimize = true);
+	std::shared_ptr<TextureAsset> LoadTexture(const std::wstring& a_wsFileName, DirectX::XMFLOAT4 a_f4Placeholder, int a_nKind = TEXTURE_KIND_COLOR);
+	std::shared_ptr<TextureAsset> LoadCubemap(const std::wstring& a_wsRight, const std::wstring& a_wsLeft, const std::wstring& a_wsUp,
+		const std::wstring& a_wsDown, const std::wstring& a_wsFront, const std::wstring& a_wsBack, DirectX::XMFLOAT4 a_f4Placeholder);
+	std::shared_ptr<TextureAsset> LoadPackedMaps(const std::wstring& a_wsOcclusion, const std::wstring& a_wsRoughness,
+		const std::wstring& a_wsMetalness, DirectX::XMFLOAT3 a_f3Defaults);
+
+	void Update();
+
+	// getters
+	unsigned int GetThreadCount();
+	unsigned int GetPendingCount();
+	std::vector<AssetLoadRecord> GetRecords();
+	double GetAllLoadedMilliseconds();
+
+	// setters
+	void SetTextureStreamer(std::shared_ptr<TextureStreamer> a_spTextureStreamer);
+
+private:
+	// One request, handed from the main thread to a worker and back
+	struct Request
+	{
+		size_t Record;	// index into m_vRecords
+		std::chrono::high_resolution_clock::time_point Queued;
+		double WaitMilliseconds;
+		double LoadMilliseconds;
+		double MipMilliseconds;
+		bool Failed;
+
+		// meshes: the handle given out and the mesh the worker loads
+		std::string MeshFileName;
+		bool Optimize;
+		std::shared_ptr<Mesh> MeshHandle;
+		std::unique_ptr<Mesh> LoadedMesh;
+
+		// textures: the handle given out, the decoded images (six for a cubemap,
+		// occlusion/roughness/metalness for packed maps, where a missing map has no name)
+		// and the mip chains built from them
+		std::vector<std::wstring> ImageFileNames;
+		int Kind; // TEXTURE_KIND_*
+		bool Cubemap;
+		bool PackedMaps;
+		float PackDefaults[PACKED_CHANNEL_COUNT];
+		PackedMaterialMaps Packed;
+		std::shared_ptr<TextureAsset> TextureHandle;
+		std::vector<DecodedImage> Images;
+		std::vector<std::vector<DecodedImage>> MipChains;
+		std::vector<uint8_t> CookedData; // the cached or cooked .dds of the images, loaded instead when it exists
+	};
+
+	std::vector<std::thread> m_vWorkers;
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkAvailable;
+	std::deque<std::unique_ptr<Request>> m_dQueued; //waiting for a worker
+	std::vector<std::unique_ptr<Request>> m_vFinished; //waiting for Update()
+	bool m_bStopping;
+
+	std::vector<AssetLoadRecord> m_vRecords; //main thread only
+	unsigned int m_uPending; //requested but not yet replaced, main thread only
+	std::chrono::high_resolution_clock::time_point m_tpCreated;
+	double m_dAllLoadedMilliseconds; //when the last pending asset came in, 0 while loading
+	std::shared_ptr<TextureStreamer> m_spTextureStreamer; //takes over 2D textures when set
+
+	void WorkerMain();
+	void Submit(std::unique_ptr<Request> a_upRequest, std::string a_sName);
+	void Finish(Request& a_Request);
+	bool StreamTexture(Request& a_Request, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& a_cpSRV);
+};
@@ -0,0 +1,250 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../DrawSort.h"
+#include "../EntityWorld.h"
+#include "../FrustumCulling.h"
+#include "../Meshlets.h"
+#include "../ObjParser.h"
+#include "../RenderStateCache.h"
+#include "../TangentGenerator.h"
+#include "../TransformHierarchy.h"
+
+// Headless benchmarks and checks of the engine's device-free modules, so they can run
+// without a window, a GPU or Windows (the game shows the same numbers in its UI).
+// Every mode prints its timings and returns nonzero when its correctness check fails.
+// Pure C++, so it also builds on Linux with DirectXMath (header only) on the include path:
+//   g++ -std=c++17 -O2 -msse2 -pthread -I<DirectXMath>/Inc Bench/Main.cpp ObjParser.cpp MappedFile.cpp
+//       TangentGenerator.cpp Meshlets.cpp FrustumCulling.cpp MeshOptimizer.cpp
+//       EntityWorld.cpp DrawSort.cpp RenderStateCache.cpp TransformHierarchy.cpp JobScheduler.cpp -o bench
+
+namespace
+{
+	void PrintUsage()
+	{
+		printf("Usage: Bench [--obj [triangles]] [--tangents [triangles]] [--meshlets [triangles]] [--cull [boxes]]\n");
+		printf("             [--entities [count]] [--draw-sort [keys]] [--state-cache [draws]] [--transforms [nodes]]\n");
+		printf("--obj parses a generated OBJ of that many triangles (4000000 by default) on one and on every thread.\n");
+		printf("--tangents generates tangents for a grid of that many triangles (1000000 by default) and compares\n");
+		printf("           them with the scalar routine meshes used before.\n");
+		printf("--meshlets builds clusters for a sphere of that many triangles (1000000 by default), checks their\n");
+		printf("           limits, coverage and bounds, and culls them from %d cameras around it.\n", MESHLET_BENCHMARK_VIEWS);
+		printf("--cull culls that many random bounding boxes (1000000 by default) batched and one at a time.\n");
+		printf("--entities iterates and updates worlds of 10K, 100K and 1M entities, or of count entities,\n");
+		printf("           against entities made of shared_ptrs.\n");
+		printf("--draw-sort radix sorts that many random draw keys (1000000 by default) and compares with std::sort.\n");
+		printf("--state-cache plays that many draws (100000 by default) through the render state cache over a\n");
+		printf("              recording context and checks what ends up bound after every call.\n");
+		printf("--transforms updates flat, wide and deep hierarchies of that many nodes (100000 by default) against\n");
+		printf("             a scene graph of separately allocated nodes and compares their matrices.\n");
+	}
+
+	/// <summary>
+	/// Reads an optional count after a mode, keeping the default when there is none
+	/// </summary>
+	unsigned int ReadCount(int argc, char* argv[], int& i, unsigned int a_uDefault)
+	{
+		if (i + 1 < argc && argv[i + 1][0] != '-')
+			return (unsigned int)strtoul(argv[++i], nullptr, 10);
+		return a_uDefault;
+	}
+
+	/// <summary>
+	/// Loads a generated OBJ file and reports throughput in MB/s and triangles/s
+	/// </summary>
+	bool RunObjParser(unsigned int a_uTriangles)
+	{
+		ObjParserBenchmark result = BenchmarkObjParser(a_uTriangles);
+		if (result.Triangles == 0 && !result.Correct)
+		{
+			printf("OBJ parser: could not write the temporary OBJ file\n");
+			return false;
+		}
+		printf("OBJ parser, %u triangles, %.1f MB file, best of %d loads (open, map and parse):\n", result.Triangles, result.Bytes / 1e6, OBJ_PARSER_BENCHMARK_RUNS);
+		auto PrintRun = [&](unsigned int a_uThreads, double a_dMilliseconds)
+		{
+			printf("  %2u thread%s %8.1f ms %8.0f MB/s %8.1f M triangles/s\n", a_uThreads, a_uThreads == 1 ? " " : "s",
+				a_dMilliseconds, result.Bytes / (a_dMilliseconds * 1000.0), result.Triangles / (a_dMilliseconds * 1000.0));
+		};
+		PrintRun(1, result.SingleThreadMilliseconds);
+		PrintRun(result.Threads, result.ThreadedMilliseconds);
+		printf("  %u floats differ from std::from_chars, faces %s\n", result.FloatMismatches, result.Correct ? "match" : "DO NOT MATCH");
+		return result.Correct && result.FloatMismatches == 0;
+	}
+
+	/// <summary>
+	/// Generates tangents with GenerateTangents and with the old scalar routine and compares them
+	/// </summary>
+	bool RunTangents(unsigned int a_uTriangles)
+	{
+		TangentBenchmark result = BenchmarkTangents(a_uTriangles);
+		printf("Tangents, %u triangles, %u verticies, best of %d runs:\n", result.Triangles, result.Verticies, TANGENT_BENCHMARK_RUNS);
+		auto PrintRun = [&](const char* a_sName, unsigned int a_uThreads, double a_dMilliseconds)
+		{
+			printf("  %-8s %2u thread%s %8.1f ms %8.1f M triangles/s\n", a_sName, a_uThreads, a_uThreads == 1 ? " " : "s",
+				a_dMilliseconds, result.Triangles / (a_dMilliseconds * 1000.0));
+		};
+		PrintRun("scalar", 1, result.ScalarMilliseconds);
+		PrintRun("SIMD", 1, result.SingleThreadMilliseconds);
+		PrintRun("SIMD", result.Threads, result.ThreadedMilliseconds);
+		printf("  largest difference %g, %u verticies over %g\n", result.MaxDifference, result.Mismatches, TANGENT_BENCHMARK_TOLERANCE);
+		return result.Mismatches == 0;
+	}
+
+	/// <summary>
+	/// Builds, checks and culls the clusters of a generated sphere
+	/// </summary>
+	bool RunMeshlets(unsigned int a_uTriangles)
+	{
+		MeshletBenchmark result = BenchmarkMeshlets(a_uTriangles);
+		printf("Meshlets, %u triangles in %u clusters, best of %d runs:\n", result.Triangles, result.Meshlets, MESHLET_BENCHMARK_RUNS);
+		printf("  build %8.2f ms %8.1f M triangles/s\n", result.BuildMilliseconds, result.Triangles / (result.BuildMilliseconds * 1000.0));
+		printf("  cull  %8.3f ms per view, %u triangles visible on average\n", result.CullMilliseconds, result.VisibleTriangles);
+		printf("  %u oversized clusters, %u triangles not in exactly one cluster, %u loose spheres, %u loose cones\n",
+			result.Check.Oversized, result.Check.MiscoveredTriangles, result.Check.LooseSpheres, result.Check.LooseCones);
+		printf("  %u clusters culled with a visible triangle\n", result.WrongCulls);
+		return result.Check.Oversized == 0 && result.Check.MiscoveredTriangles == 0 && result.Check.LooseSpheres == 0 &&
+			result.Check.LooseCones == 0 && result.WrongCulls == 0;
+	}
+
+	/// <summary>
+	/// Culls random bounding boxes with the batched test and the scalar reference
+	/// </summary>
+	bool RunFrustumCull(unsigned int a_uBoxes)
+	{
+		FrustumCullBenchmark result = BenchmarkFrustumCull(a_uBoxes);
+		printf("Frustum cull, %zu boxes, %zu visible, best of several runs:\n", result.BoxCount, result.Visible);
+		printf("  batched %8.3f ms %8.1f M boxes/s\n", result.SimdMilliseconds, result.BoxCount / (result.SimdMilliseconds * 1000.0));
+		printf("  scalar  %8.3f ms %8.1f M boxes/s\n", result.ScalarMilliseconds, result.BoxCount / (result.ScalarMilliseconds * 1000.0));
+		printf("  %zu boxes where the two disagree\n", result.Mismatches);
+		return result.Mismatches == 0;
+	}
+
+	/// <summary>
+	/// Iterates and updates an entity world against entities made of shared_ptrs
+	/// </summary>
+	bool RunEntityWorld(unsigned int a_uEntities)
+	{
+		EntityWorldBenchmark result = BenchmarkEntityWorld(a_uEntities);
+		printf("Entity world, %u entities in %u archetypes, %u chunks:\n", result.Entities, result.Archetypes, result.Chunks);
+		printf("  iterate %8.3f ms, shared_ptrs %8.3f ms (%.1fx)\n", result.IterateMilliseconds,
+			result.PointerIterateMilliseconds, result.PointerIterateMilliseconds / result.IterateMilliseconds);
+		printf("  update  %8.3f ms, shared_ptrs %8.3f ms (%.1fx)\n", result.UpdateMilliseconds,
+			result.PointerUpdateMilliseconds, result.PointerUpdateMilliseconds / result.UpdateMilliseconds);
+		if (result.Checksum < 0.0)
+			printf("  the two layouts DISAGREE\n");
+		return result.Checksum >= 0.0;
+	}
+
+	/// <summary>
+	/// Sorts random draw keys with the radix sort and std::sort and counts the state changes
+	/// </summary>
+	bool RunDrawSort(unsigned int a_uKeys)
+	{
+		DrawSortBenchmark result = BenchmarkDrawSort(a_uKeys);
+		printf("Draw sort, %u keys, best of %d runs:\n", result.Keys, DRAW_SORT_BENCHMARK_RUNS);
+		printf("  radix     %8.3f ms %8.1f M keys/s\n", result.RadixMilliseconds, result.Keys / (result.RadixMilliseconds * 1000.0));
+		printf("  std::sort %8.3f ms %8.1f M keys/s\n", result.StdSortMilliseconds, result.Keys / (result.StdSortMilliseconds * 1000.0));
+		printf("  unsorted: %u shaders, %u materials, %u meshes\n", result.Unsorted.Shaders, result.Unsorted.Materials, result.Unsorted.Meshes);
+		printf("  sorted:   %u shaders, %u materials, %u meshes\n", result.Sorted.Shaders, result.Sorted.Materials, result.Sorted.Meshes);
+		if (!result.Correct)
+			printf("  the two orders DISAGREE\n");
+		return result.Correct;
+	}
+
+	/// <summary>
+	/// Updates a transform hierarchy against a pointer-based scene graph of the same shape
+	/// </summary>
+	bool RunTransformHierarchy(const char* a_sName, unsigned int a_uNodes, unsigned int a_uBranching)
+	{
+		TransformHierarchyBenchmark result = BenchmarkTransformHierarchy(a_uNodes, a_uBranching);
+		printf("Transform hierarchy, %s, %u nodes, depth %u, best of %d runs:\n", a_sName, result.Nodes, result.Depth, TRANSFORM_HIERARCHY_BENCHMARK_RUNS);
+		printf("  all moved   %8.3f ms on %2u threads (%.1fx), %8.3f ms on 1 (%.1fx)\n", result.FullMilliseconds, result.Threads,
+			result.PointerMilliseconds / result.FullMilliseconds, result.SingleThreadMilliseconds, result.PointerMilliseconds / result.SingleThreadMilliseconds);
+		printf("  scene graph %8.3f ms\n", result.PointerMilliseconds);
+		printf("  1%% moved    %8.3f ms\n", result.PartialMilliseconds);
+		printf("  largest difference from the scene graph %g\n", result.MaxDifference);
+		return result.MaxDifference <= TRANSFORM_HIERARCHY_BENCHMARK_TOLERANCE;
+	}
+
+	/// <summary>
+	/// Plays draws through the render state cache and checks the context it binds to
+	/// </summary>
+	bool RunRenderStateCache(unsigned int a_uDraws)
+	{
+		RenderStateCacheCheck result = VerifyRenderStateCache(a_uDraws);
+		printf("Render state cache, %u draws:\n", result.Draws);
+		printf("  %u calls, %u issued, %u skipped (%.1f%%)\n", result.Calls, result.Issued, result.Skipped,
+			result.Calls > 0 ? 100.0 * result.Skipped / result.Calls : 0.0);
+		printf("  %u times the context had the wrong state bound\n", result.Mismatches);
+		return result.Mismatches == 0;
+	}
+}
+
+// --------------------------------------------------------
+// Entry point of the benchmarks
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	bool bPassed = true;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--obj") == 0)
+		{
+			bPassed &= RunObjParser(ReadCount(argc, argv, i, 4000000));
+		}
+		else if (strcmp(argv[i], "--tangents") == 0)
+		{
+			bPassed &= RunTangents(ReadCount(argc, argv, i, 1000000));
+		}
+		else if (strcmp(argv[i], "--meshlets") == 0)
+		{
+			bPassed &= RunMeshlets(ReadCount(argc, argv, i, 1000000));
+		}
+		else if (strcmp(argv[i], "--cull") == 0)
+		{
+			bPassed &= RunFrustumCull(ReadCount(argc, argv, i, 1000000));
+		}
+		else if (strcmp(argv[i], "--entities") == 0)
+		{
+			unsigned int uEntities = ReadCount(argc, argv, i, 0);
+			if (uEntities > 0)
+			{
+				bPassed &= RunEntityWorld(uEntities);
+			}
+			else
+			{
+				for (unsigned int uDefault : { 10000u, 100000u, 1000000u })
+					bPassed &= RunEntityWorld(uDefault);
+			}
+		}
+		else if (strcmp(argv[i], "--draw-sort") == 0)
+		{
+			bPassed &= RunDrawSort(ReadCount(argc, argv, i, 1000000));
+		}
+		else if (strcmp(argv[i], "--state-cache") == 0)
+		{
+			bPassed &= RunRenderStateCache(ReadCount(argc, argv, i, 100000));
+		}
+		else if (strcmp(argv[i], "--transforms") == 0)
+		{
+			unsigned int uNodes = ReadCount(argc, argv, i, 100000);
+			bPassed &= RunTransformHierarchy("flat", uNodes, 0);
+			bPassed &= RunTransformHierarchy("wide", uNodes, 8);
+			bPassed &= RunTransformHierarchy("deep", uNodes, 1);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	return bPassed ? 0 : 1;
+}
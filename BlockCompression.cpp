@@ -0,0 +1,665 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Fewest rows of blocks worth handing to their own thread
+	const uint32_t MIN_CHUNK_BLOCK_ROWS = 8;
+
+	// Interpolation weights (out of 64) of BC7's 4-bit indices
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	/// <summary>
+	/// Finds the nearest palette entry of each of a block's 16 pixels
+	/// </summary>
+	/// <param name="a_pIndices">Receives the index of the nearest entry per pixel</param>
+	/// <param name="a_pPixels">Pixels stored per channel</param>
+	/// <param name="a_pPalette">Palette entries</param>
+	/// <param name="a_nEntries">Number of palette entries</param>
+	/// <param name="a_nChannels">Channels compared (1-4)</param>
+	/// <returns>Summed squared error of the chosen entries</returns>
+	float SelectIndices(uint8_t a_pIndices[16], const float a_pPixels[4][16], const float a_pPalette[][4], int a_nEntries, int a_nChannels)
+	{
+		float fError = 0.0f;
+#if defined(__AVX__)
+		for (int g = 0; g < 16; g += 8)
+		{
+			__m256 pixels[4];
+			for (int c = 0; c < a_nChannels; c++)
+				pixels[c] = _mm256_loadu_ps(&a_pPixels[c][g]);
+
+			__m256 best = _mm256_set1_ps(FLT_MAX);
+			__m256 bestIndex = _mm256_setzero_ps();
+			for (int k = 0; k < a_nEntries; k++)
+			{
+				__m256 distance = _mm256_setzero_ps();
+				for (int c = 0; c < a_nChannels; c++)
+				{
+					__m256 difference = _mm256_sub_ps(pixels[c], _mm256_set1_ps(a_pPalette[k][c]));
+					distance = _mm256_add_ps(distance, _mm256_mul_ps(difference, difference));
+				}
+				__m256 closer = _mm256_cmp_ps(distance, best, _CMP_LT_OQ);
+				best = _mm256_min_ps(distance, best);
+				bestIndex = _mm256_blendv_ps(bestIndex, _mm256_set1_ps((float)k), closer);
+			}
+
+			alignas(32) int32_t indices[8];
+			alignas(32) float errors[8];
+			_mm256_store_si256((__m256i*)indices, _mm256_cvttps_epi32(bestIndex));
+			_mm256_store_ps(errors, best);
+			for (int i = 0; i < 8; i++)
+			{
+				a_pIndices[g + i] = (uint8_t)indices[i];
+				fError += errors[i];
+			}
+		}
+#else
+		for (int g = 0; g < 16; g += 4)
+		{
+			__m128 pixels[4];
+			for (int c = 0; c < a_nChannels; c++)
+				pixels[c] = _mm_loadu_ps(&a_pPixels[c][g]);
+
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (int k = 0; k < a_nEntries; k++)
+			{
+				__m128 distance = _mm_setzero_ps();
+				for (int c = 0; c < a_nChannels; c++)
+				{
+					__m128 difference = _mm_sub_ps(pixels[c], _mm_set1_ps(a_pPalette[k][c]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+				}
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+				best = _mm_min_ps(distance, best);
+				bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(k)));
+			}
+
+			alignas(16) int32_t indices[4];
+			alignas(16) float errors[4];
+			_mm_store_si128((__m128i*)indices, bestIndex);
+			_mm_store_ps(errors, best);
+			for (int i = 0; i < 4; i++)
+			{
+				a_pIndices[g + i] = (uint8_t)indices[i];
+				fError += errors[i];
+			}
+		}
+#endif
+		return fError;
+	}
+
+	/// <summary>
+	/// Copies a 4x4 block out of an image, repeating the last row/column past its edges
+	/// </summary>
+	void LoadBlock(float a_pPixels[4][16], const DecodedImage& a_Image, uint32_t a_uBlockX, uint32_t a_uBlockY)
+	{
+		for (uint32_t y = 0; y < 4; y++)
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				uint32_t uX = std::min(a_uBlockX * 4 + x, a_Image.Width - 1);
+				uint32_t uY = std::min(a_uBlockY * 4 + y, a_Image.Height - 1);
+				const uint8_t* pPixel = &a_Image.Pixels[((size_t)uY * a_Image.Width + uX) * 4];
+				for (int c = 0; c < 4; c++)
+					a_pPixels[c][y * 4 + x] = pPixel[c];
+			}
+	}
+
+	/// <summary>
+	/// Fits a line through the pixels with principal component analysis
+	/// </summary>
+	/// <param name="a_pLow">Receives the end of the line the pixels project lowest on</param>
+	/// <param name="a_pHigh">Receives the other end</param>
+	void FitLine(float a_pLow[4], float a_pHigh[4], const float a_pPixels[4][16], int a_nChannels)
+	{
+		float mean[4] = {};
+		for (int c = 0; c < a_nChannels; c++)
+		{
+			for (int i = 0; i < 16; i++)
+				mean[c] += a_pPixels[c][i];
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++)
+			for (int a = 0; a < a_nChannels; a++)
+				for (int b = a; b < a_nChannels; b++)
+					covariance[a][b] += (a_pPixels[a][i] - mean[a]) * (a_pPixels[b][i] - mean[b]);
+		for (int a = 0; a < a_nChannels; a++)
+			for (int b = 0; b < a; b++)
+				covariance[a][b] = covariance[b][a];
+
+		// power iteration towards the largest eigenvector, starting from the spread of the box
+		float axis[4] = {};
+		for (int c = 0; c < a_nChannels; c++)
+		{
+			float fMin = *std::min_element(a_pPixels[c], a_pPixels[c] + 16);
+			float fMax = *std::max_element(a_pPixels[c], a_pPixels[c] + 16);
+			axis[c] = fMax - fMin;
+		}
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float fLength = 0.0f;
+			for (int a = 0; a < a_nChannels; a++)
+			{
+				for (int b = 0; b < a_nChannels; b++)
+					next[a] += covariance[a][b] * axis[b];
+				fLength = std::max(fLength, fabsf(next[a]));
+			}
+			if (fLength < 1e-6f)
+				break;
+			for (int c = 0; c < a_nChannels; c++)
+				axis[c] = next[c] / fLength;
+		}
+		float fLengthSquared = 0.0f;
+		for (int c = 0; c < a_nChannels; c++)
+			fLengthSquared += axis[c] * axis[c];
+
+		// a flat block collapses to its mean
+		if (fLengthSquared < 1e-12f)
+		{
+			for (int c = 0; c < 4; c++)
+				a_pLow[c] = a_pHigh[c] = c < a_nChannels ? mean[c] : 0.0f;
+			return;
+		}
+
+		float fMin = FLT_MAX, fMax = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < a_nChannels; c++)
+				t += (a_pPixels[c][i] - mean[c]) * axis[c];
+			fMin = std::min(fMin, t);
+			fMax = std::max(fMax, t);
+		}
+		for (int c = 0; c < 4; c++)
+		{
+			a_pLow[c] = c < a_nChannels ? std::clamp(mean[c] + axis[c] * fMin / fLengthSquared, 0.0f, 255.0f) : 0.0f;
+			a_pHigh[c] = c < a_nChannels ? std::clamp(mean[c] + axis[c] * fMax / fLengthSquared, 0.0f, 255.0f) : 0.0f;
+		}
+	}
+
+	/// <summary>
+	/// Least squares endpoints for pixels whose blend factors (0 = first endpoint, 1 = second) are fixed
+	/// </summary>
+	/// <returns>False if the factors can't pin down two endpoints</returns>
+	bool RefitEndpoints(float a_pFirst[4], float a_pSecond[4], const float a_pPixels[4][16], const float a_pFactors[16], int a_nChannels)
+	{
+		float fAA = 0.0f, fAB = 0.0f, fBB = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float b = a_pFactors[i], a = 1.0f - b;
+			fAA += a * a;
+			fAB += a * b;
+			fBB += b * b;
+			for (int c = 0; c < a_nChannels; c++)
+			{
+				ax[c] += a * a_pPixels[c][i];
+				bx[c] += b * a_pPixels[c][i];
+			}
+		}
+		float fDeterminant = fAA * fBB - fAB * fAB;
+		if (fabsf(fDeterminant) < 1e-6f)
+			return false;
+		for (int c = 0; c < a_nChannels; c++)
+		{
+			a_pFirst[c] = std::clamp((fBB * ax[c] - fAB * bx[c]) / fDeterminant, 0.0f, 255.0f);
+			a_pSecond[c] = std::clamp((fAA * bx[c] - fAB * ax[c]) / fDeterminant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Writes values into a block least significant bit first
+	// --------------------------------------------------------
+	struct BlockBitWriter
+	{
+		uint8_t* Data;
+		int Position;
+
+		void Write(uint32_t a_uValue, int a_nBits)
+		{
+			for (int b = 0; b < a_nBits; b++, Position++)
+				Data[Position >> 3] |= (uint8_t)(((a_uValue >> b) & 1) << (Position & 7));
+		}
+	};
+
+	uint32_t ReadBits(const uint8_t* a_pData, int& a_nPosition, int a_nBits)
+	{
+		uint32_t uValue = 0;
+		for (int b = 0; b < a_nBits; b++, a_nPosition++)
+			uValue |= (uint32_t)((a_pData[a_nPosition >> 3] >> (a_nPosition & 7)) & 1) << b;
+		return uValue;
+	}
+
+#pragma region BC1
+	uint16_t PackRgb565(const float a_pColor[4])
+	{
+		uint32_t r = (uint32_t)lrintf(a_pColor[0] * 31.0f / 255.0f);
+		uint32_t g = (uint32_t)lrintf(a_pColor[1] * 63.0f / 255.0f);
+		uint32_t b = (uint32_t)lrintf(a_pColor[2] * 31.0f / 255.0f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRgb565(int a_pColor[3], uint16_t a_uPacked)
+	{
+		int r = (a_uPacked >> 11) & 31, g = (a_uPacked >> 5) & 63, b = a_uPacked & 31;
+		a_pColor[0] = (r << 3) | (r >> 2);
+		a_pColor[1] = (g << 2) | (g >> 4);
+		a_pColor[2] = (b << 3) | (b >> 2);
+	}
+
+	// the four colors of a BC1 block with color0 > color1, as the decoder computes them
+	void Bc1Palette(int a_pPalette[4][3], uint16_t a_uColor0, uint16_t a_uColor1)
+	{
+		UnpackRgb565(a_pPalette[0], a_uColor0);
+		UnpackRgb565(a_pPalette[1], a_uColor1);
+		for (int c = 0; c < 3; c++)
+		{
+			a_pPalette[2][c] = (2 * a_pPalette[0][c] + a_pPalette[1][c]) / 3;
+			a_pPalette[3][c] = (a_pPalette[0][c] + 2 * a_pPalette[1][c]) / 3;
+		}
+	}
+
+	/// <summary>
+	/// Quantizes two endpoints and picks the indices for them
+	/// </summary>
+	/// <returns>Squared error of the block</returns>
+	float TryBc1Endpoints(uint16_t& a_uColor0, uint16_t& a_uColor1, uint8_t a_pIndices[16], const float a_pFirst[4], const float a_pSecond[4], const float a_pPixels[4][16])
+	{
+		a_uColor0 = PackRgb565(a_pFirst);
+		a_uColor1 = PackRgb565(a_pSecond);
+		if (a_uColor0 < a_uColor1)
+			std::swap(a_uColor0, a_uColor1);
+
+		// equal endpoints would switch to three color mode, where index 0 is still color0
+		int palette[4][3];
+		Bc1Palette(palette, a_uColor0, a_uColor1);
+		float floatPalette[4][4] = {};
+		for (int k = 0; k < 4; k++)
+			for (int c = 0; c < 3; c++)
+				floatPalette[k][c] = (float)palette[k][c];
+		return SelectIndices(a_pIndices, a_pPixels, floatPalette, a_uColor0 == a_uColor1 ? 1 : 4, 3);
+	}
+
+	void EncodeBc1(uint8_t* a_pBlock, const float a_pPixels[4][16])
+	{
+		float first[4], second[4];
+		FitLine(second, first, a_pPixels, 3);
+
+		uint16_t uColor0, uColor1;
+		uint8_t indices[16];
+		float fError = TryBc1Endpoints(uColor0, uColor1, indices, first, second, a_pPixels);
+
+		// two rounds of refitting the endpoints to the chosen indices
+		static const float FACTORS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		for (int iteration = 0; iteration < 2 && uColor0 != uColor1; iteration++)
+		{
+			float factors[16];
+			for (int i = 0; i < 16; i++)
+				factors[i] = FACTORS[indices[i]];
+			if (!RefitEndpoints(first, second, a_pPixels, factors, 3))
+				break;
+
+			uint16_t uNewColor0, uNewColor1;
+			uint8_t newIndices[16];
+			float fNewError = TryBc1Endpoints(uNewColor0, uNewColor1, newIndices, first, second, a_pPixels);
+			if (fNewError >= fError)
+				break;
+			fError = fNewError;
+			uColor0 = uNewColor0;
+			uColor1 = uNewColor1;
+			memcpy(indices, newIndices, 16);
+		}
+
+		uint32_t uIndexBits = 0;
+		for (int i = 0; i < 16; i++)
+			uIndexBits |= (uint32_t)indices[i] << (i * 2);
+		memcpy(a_pBlock, &uColor0, 2);
+		memcpy(a_pBlock + 2, &uColor1, 2);
+		memcpy(a_pBlock + 4, &uIndexBits, 4);
+	}
+
+	void DecodeBc1(uint8_t a_pPixels[16][4], const uint8_t* a_pBlock)
+	{
+		uint16_t uColor0, uColor1;
+		uint32_t uIndexBits;
+		memcpy(&uColor0, a_pBlock, 2);
+		memcpy(&uColor1, a_pBlock + 2, 2);
+		memcpy(&uIndexBits, a_pBlock + 4, 4);
+
+		int palette[4][3];
+		int alpha[4] = { 255, 255, 255, 255 };
+		Bc1Palette(palette, uColor0, uColor1);
+		if (uColor0 <= uColor1)
+		{
+			// three colors and transparent black
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+			alpha[3] = 0;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int nIndex = (uIndexBits >> (i * 2)) & 3;
+			for (int c = 0; c < 3; c++)
+				a_pPixels[i][c] = (uint8_t)palette[nIndex][c];
+			a_pPixels[i][3] = (uint8_t)alpha[nIndex];
+		}
+	}
+#pragma endregion
+
+#pragma region BC4
+	void EncodeBc4(uint8_t* a_pBlock, const float a_pValues[16])
+	{
+		// eight value mode (red0 > red1) between the smallest and largest value
+		int nMin = 255, nMax = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			nMin = std::min(nMin, (int)a_pValues[i]);
+			nMax = std::max(nMax, (int)a_pValues[i]);
+		}
+		memset(a_pBlock, 0, 8);
+		a_pBlock[0] = (uint8_t)nMax;
+		a_pBlock[1] = (uint8_t)nMin;
+		if (nMax == nMin)
+			return;
+
+		float palette[8][4] = {};
+		palette[0][0] = (float)nMax;
+		palette[1][0] = (float)nMin;
+		for (int k = 2; k < 8; k++)
+			palette[k][0] = (float)(((8 - k) * nMax + (k - 1) * nMin) / 7);
+
+		float pixels[4][16];
+		memcpy(pixels[0], a_pValues, sizeof(pixels[0]));
+		uint8_t indices[16];
+		SelectIndices(indices, pixels, palette, 8, 1);
+
+		BlockBitWriter writer = { a_pBlock, 16 };
+		for (int i = 0; i < 16; i++)
+			writer.Write(indices[i], 3);
+	}
+
+	void DecodeBc4(uint8_t a_pPixels[16][4], const uint8_t* a_pBlock, int a_nChannel)
+	{
+		int nRed0 = a_pBlock[0], nRed1 = a_pBlock[1];
+		int palette[8] = { nRed0, nRed1 };
+		if (nRed0 > nRed1)
+			for (int k = 2; k < 8; k++)
+				palette[k] = ((8 - k) * nRed0 + (k - 1) * nRed1) / 7;
+		else
+		{
+			for (int k = 2; k < 6; k++)
+				palette[k] = ((6 - k) * nRed0 + (k - 1) * nRed1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+		int nPosition = 16;
+		for (int i = 0; i < 16; i++)
+			a_pPixels[i][a_nChannel] = (uint8_t)palette[ReadBits(a_pBlock, nPosition, 3)];
+	}
+#pragma endregion
+
+#pragma region BC7
+	/// <summary>
+	/// Quantizes two RGBA endpoints to mode 6's 7 bits plus a p-bit each, trying every
+	/// p-bit pair, and picks the indices for the best pair
+	/// </summary>
+	/// <returns>Squared error of the block</returns>
+	float TryBc7Endpoints(int a_pEndpoints[2][4], int a_pPBits[2], uint8_t a_pIndices[16], const float a_pFirst[4], const float a_pSecond[4], const float a_pPixels[4][16])
+	{
+		float fBestError = FLT_MAX;
+		for (int nPBits = 0; nPBits < 4; nPBits++)
+		{
+			int pbits[2] = { nPBits & 1, nPBits >> 1 };
+			int endpoints[2][4];
+			int expanded[2][4];
+			for (int c = 0; c < 4; c++)
+			{
+				endpoints[0][c] = std::clamp((int)lrintf((a_pFirst[c] - pbits[0]) * 0.5f), 0, 127);
+				endpoints[1][c] = std::clamp((int)lrintf((a_pSecond[c] - pbits[1]) * 0.5f), 0, 127);
+				expanded[0][c] = (endpoints[0][c] << 1) | pbits[0];
+				expanded[1][c] = (endpoints[1][c] << 1) | pbits[1];
+			}
+
+			float palette[16][4];
+			for (int k = 0; k < 16; k++)
+				for (int c = 0; c < 4; c++)
+					palette[k][c] = (float)(((64 - BC7_WEIGHTS[k]) * expanded[0][c] + BC7_WEIGHTS[k] * expanded[1][c] + 32) >> 6);
+
+			uint8_t indices[16];
+			float fError = SelectIndices(indices, a_pPixels, palette, 16, 4);
+			if (fError < fBestError)
+			{
+				fBestError = fError;
+				memcpy(a_pEndpoints, endpoints, sizeof(endpoints));
+				memcpy(a_pPBits, pbits, sizeof(pbits));
+				memcpy(a_pIndices, indices, 16);
+			}
+		}
+		return fBestError;
+	}
+
+	void EncodeBc7(uint8_t* a_pBlock, const float a_pPixels[4][16])
+	{
+		float first[4], second[4];
+		FitLine(first, second, a_pPixels, 4);
+
+		int endpoints[2][4], pbits[2];
+		uint8_t indices[16];
+		float fError = TryBc7Endpoints(endpoints, pbits, indices, first, second, a_pPixels);
+
+		for (int iteration = 0; iteration < 2; iteration++)
+		{
+			float factors[16];
+			for (int i = 0; i < 16; i++)
+				factors[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+			if (!RefitEndpoints(first, second, a_pPixels, factors, 4))
+				break;
+
+			int newEndpoints[2][4], newPBits[2];
+			uint8_t newIndices[16];
+			float fNewError = TryBc7Endpoints(newEndpoints, newPBits, newIndices, first, second, a_pPixels);
+			if (fNewError >= fError)
+				break;
+			fError = fNewError;
+			memcpy(endpoints, newEndpoints, sizeof(endpoints));
+			memcpy(pbits, newPBits, sizeof(pbits));
+			memcpy(indices, newIndices, 16);
+		}
+
+		// the anchor (first) index is stored without its top bit, so it has to be below 8
+		if (indices[0] >= 8)
+		{
+			for (int c = 0; c < 4; c++)
+				std::swap(endpoints[0][c], endpoints[1][c]);
+			std::swap(pbits[0], pbits[1]);
+			for (int i = 0; i < 16; i++)
+				indices[i] = (uint8_t)(15 - indices[i]);
+		}
+
+		memset(a_pBlock, 0, 16);
+		BlockBitWriter writer = { a_pBlock, 0 };
+		writer.Write(1 << 6, 7); // mode 6
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Write(endpoints[0][c], 7);
+			writer.Write(endpoints[1][c], 7);
+		}
+		writer.Write(pbits[0], 1);
+		writer.Write(pbits[1], 1);
+		writer.Write(indices[0], 3);
+		for (int i = 1; i < 16; i++)
+			writer.Write(indices[i], 4);
+	}
+
+	void DecodeBc7(uint8_t a_pPixels[16][4], const uint8_t* a_pBlock)
+	{
+		// only mode 6 is decoded (the only one the encoder writes); other modes read as black
+		if ((a_pBlock[0] & 0x7F) != 0x40)
+		{
+			memset(a_pPixels, 0, 16 * 4);
+			return;
+		}
+		int nPosition = 7;
+		int expanded[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			expanded[0][c] = (int)ReadBits(a_pBlock, nPosition, 7) << 1;
+			expanded[1][c] = (int)ReadBits(a_pBlock, nPosition, 7) << 1;
+		}
+		int nPBit0 = (int)ReadBits(a_pBlock, nPosition, 1);
+		int nPBit1 = (int)ReadBits(a_pBlock, nPosition, 1);
+		for (int c = 0; c < 4; c++)
+		{
+			expanded[0][c] |= nPBit0;
+			expanded[1][c] |= nPBit1;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int nWeight = BC7_WEIGHTS[ReadBits(a_pBlock, nPosition, i == 0 ? 3 : 4)];
+			for (int c = 0; c < 4; c++)
+				a_pPixels[i][c] = (uint8_t)(((64 - nWeight) * expanded[0][c] + nWeight * expanded[1][c] + 32) >> 6);
+		}
+	}
+#pragma endregion
+
+	/// <summary>
+	/// Compresses the rows of blocks [a_uFirstRow, a_uEndRow)
+	/// </summary>
+	void CompressBlockRows(uint8_t* a_pDestination, const DecodedImage& a_Image, int a_nFormat, uint32_t a_uFirstRow, uint32_t a_uEndRow)
+	{
+		uint32_t uBlocksWide = (a_Image.Width + 3) / 4;
+		size_t uBlockSize = GetBlockSize(a_nFormat);
+		for (uint32_t by = a_uFirstRow; by < a_uEndRow; by++)
+			for (uint32_t bx = 0; bx < uBlocksWide; bx++)
+			{
+				float pixels[4][16];
+				LoadBlock(pixels, a_Image, bx, by);
+				uint8_t* pBlock = a_pDestination + ((size_t)by * uBlocksWide + bx) * uBlockSize;
+				switch (a_nFormat)
+				{
+				case BC_FORMAT_BC1: EncodeBc1(pBlock, pixels); break;
+				case BC_FORMAT_BC4: EncodeBc4(pBlock, pixels[0]); break;
+				case BC_FORMAT_BC5: EncodeBc4(pBlock, pixels[0]); EncodeBc4(pBlock + 8, pixels[1]); break;
+				case BC_FORMAT_BC7: EncodeBc7(pBlock, pixels); break;
+				}
+			}
+	}
+}
+
+/// <summary>
+/// Bytes of one 4x4 block
+/// </summary>
+size_t GetBlockSize(int a_nFormat)
+{
+	return a_nFormat == BC_FORMAT_BC1 || a_nFormat == BC_FORMAT_BC4 ? 8 : 16;
+}
+
+/// <summary>
+/// Bytes an image takes once compressed
+/// </summary>
+size_t GetCompressedSize(uint32_t a_uWidth, uint32_t a_uHeight, int a_nFormat)
+{
+	return (size_t)((a_uWidth + 3) / 4) * ((a_uHeight + 3) / 4) * GetBlockSize(a_nFormat);
+}
+
+/// <summary>
+/// Compresses an image; rows of blocks are split into contiguous ranges, one per thread
+/// </summary>
+/// <param name="a_pDestination">Receives GetCompressedSize bytes of blocks</param>
+/// <param name="a_Image">RGBA8 image</param>
+/// <param name="a_nFormat">BC_FORMAT_*</param>
+/// <param name="a_uThreadCount">Upper bound on threads (0 = hardware concurrency)</param>
+void CompressImage(uint8_t* a_pDestination, const DecodedImage& a_Image, int a_nFormat, unsigned int a_uThreadCount)
+{
+	uint32_t uBlocksHigh = (a_Image.Height + 3) / 4;
+	unsigned int uThreads = a_uThreadCount ? a_uThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	uint32_t uChunkCount = std::max(1u, std::min<uint32_t>(uThreads, uBlocksHigh / MIN_CHUNK_BLOCK_ROWS));
+	auto ChunkStart = [&](uint32_t i) { return (uint32_t)((uint64_t)uBlocksHigh * i / uChunkCount); };
+
+	// the calling thread takes the first chunk
+	auto RunChunk = [&](uint32_t i) { CompressBlockRows(a_pDestination, a_Image, a_nFormat, ChunkStart(i), ChunkStart(i + 1)); };
+	std::vector<std::thread> vWorkers;
+	for (uint32_t i = 1; i < uChunkCount; i++)
+		vWorkers.emplace_back(RunChunk, i);
+	RunChunk(0);
+	for (auto& t : vWorkers) t.join();
+}
+
+/// <summary>
+/// Expands compressed blocks back to pixels
+/// </summary>
+/// <param name="a_Image">Receives the RGBA8 image</param>
+/// <param name="a_pSource">GetCompressedSize bytes of blocks</param>
+/// <param name="a_uWidth">Image width</param>
+/// <param name="a_uHeight">Image height</param>
+/// <param name="a_nFormat">BC_FORMAT_*</param>
+void DecompressImage(DecodedImage& a_Image, const uint8_t* a_pSource, uint32_t a_uWidth, uint32_t a_uHeight, int a_nFormat)
+{
+	a_Image.Width = a_uWidth;
+	a_Image.Height = a_uHeight;
+	a_Image.SRGB = false;
+	a_Image.Pixels.assign((size_t)a_uWidth * a_uHeight * 4, 0);
+
+	uint32_t uBlocksWide = (a_uWidth + 3) / 4, uBlocksHigh = (a_uHeight + 3) / 4;
+	size_t uBlockSize = GetBlockSize(a_nFormat);
+	for (uint32_t by = 0; by < uBlocksHigh; by++)
+		for (uint32_t bx = 0; bx < uBlocksWide; bx++)
+		{
+			const uint8_t* pBlock = a_pSource + ((size_t)by * uBlocksWide + bx) * uBlockSize;
+			uint8_t pixels[16][4] = {};
+			for (int i = 0; i < 16; i++)
+				pixels[i][3] = 255;
+			switch (a_nFormat)
+			{
+			case BC_FORMAT_BC1: DecodeBc1(pixels, pBlock); break;
+			case BC_FORMAT_BC4: DecodeBc4(pixels, pBlock, 0); break;
+			case BC_FORMAT_BC5: DecodeBc4(pixels, pBlock, 0); DecodeBc4(pixels, pBlock + 8, 1); break;
+			case BC_FORMAT_BC7: DecodeBc7(pixels, pBlock); break;
+			}
+
+			for (uint32_t y = 0; y < 4 && by * 4 + y < a_uHeight; y++)
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < a_uWidth; x++)
+					memcpy(&a_Image.Pixels[(((size_t)by * 4 + y) * a_uWidth + bx * 4 + x) * 4], pixels[y * 4 + x], 4);
+		}
+}
+
+/// <summary>
+/// Peak signal to noise ratio between two images
+/// </summary>
+/// <param name="a_Reference">Original image</param>
+/// <param name="a_Image">Image to compare, the same size</param>
+/// <param name="a_nChannels">Leading channels compared (1-4)</param>
+/// <returns>PSNR in dB</returns>
+double ComputePsnr(const DecodedImage& a_Reference, const DecodedImage& a_Image, int a_nChannels)
+{
+	size_t uPixels = std::min(a_Reference.Pixels.size(), a_Image.Pixels.size()) / 4;
+	double dSquaredError = 0.0;
+	for (size_t i = 0; i < uPixels; i++)
+		for (int c = 0; c < a_nChannels; c++)
+		{
+			double dDifference = (double)a_Reference.Pixels[i * 4 + c] - a_Image.Pixels[i * 4 + c];
+			dSquaredError += dDifference * dDifference;
+		}
+	if (dSquaredError == 0.0)
+		return std::numeric_limits<double>::infinity();
+	double dMeanSquaredError = dSquaredError / ((double)uPixels * a_nChannels);
+	return 10.0 * log10(255.0 * 255.0 / dMeanSquaredError);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ImageDecoder.h"
+
+// Block compressed formats the encoder writes (4x4 pixel blocks)
+#define BC_FORMAT_BC1	1	// RGB, 8 bytes per block
+#define BC_FORMAT_BC4	4	// R, 8 bytes per block
+#define BC_FORMAT_BC5	5	// RG, 16 bytes per block
+#define BC_FORMAT_BC7	7	// RGBA, 16 bytes per block (mode 6 only)
+
+// Bytes of one block of a format
+size_t GetBlockSize(int a_nFormat);
+
+// Bytes an image of the given size takes in a format (partial blocks are padded to whole ones)
+size_t GetCompressedSize(uint32_t a_uWidth, uint32_t a_uHeight, int a_nFormat);
+
+// Compresses an RGBA8 image into a_pDestination, which needs GetCompressedSize bytes. Rows of
+// blocks are shared out between a_uThreadCount threads (0 uses every hardware thread); the
+// palette search of every block runs four pixels at a time in SSE registers (eight with AVX).
+// BC4 takes the red channel and BC5 red and green; BC1 ignores alpha.
+void CompressImage(uint8_t* a_pDestination, const DecodedImage& a_Image, int a_nFormat, unsigned int a_uThreadCount = 0);
+
+// Expands compressed blocks back to RGBA8 (channels the format doesn't store read 0, alpha 255)
+void DecompressImage(DecodedImage& a_Image, const uint8_t* a_pSource, uint32_t a_uWidth, uint32_t a_uHeight, int a_nFormat);
+
+// Peak signal to noise ratio in dB over the first a_nChannels channels of two equally sized
+// RGBA8 images (infinity when they match)
+double ComputePsnr(const DecodedImage& a_Reference, const DecodedImage& a_Image, int a_nChannels);
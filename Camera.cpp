@@ -22,7 +22,8 @@
 Camera::Camera(float a_fAspectRatio, DirectX::XMFLOAT3 a_f3Position, DirectX::XMFLOAT3 a_f3Orientation, float a_fFieldOfView, float a_fNearPlaneDistance, float a_fFarPlaneDistance, float a_fMovementSpeed, float a_fMouseLookSpeed)
 {
 	// initialize transform
-	m_spTransform = std::make_shared<Transform>();
+	m_spHierarchy = std::make_shared<TransformHierarchy>();
+	m_spTransform = std::make_shared<Transform>(m_spHierarchy);
 	m_spTransform->SetPosition(a_f3Position);
 	m_spTransform->SetRotation(a_f3Orientation);
 
@@ -173,6 +174,7 @@ void Camera::Update(float a_fDeltaTime)
 		m_spTransform->SetRotation(newPitch, newYaw, 0.0f);
 	}
 
+	m_spHierarchy->Update();
 	UpdateViewMatrix();
 }
 #pragma endregion
@@ -27,6 +27,7 @@ public:
 
 private:
 	std::shared_ptr<Transform> m_spTransform;
+	std::shared_ptr<TransformHierarchy> m_spHierarchy; //the camera's alone, so it can move while a job updates the entities'
 	DirectX::XMFLOAT4X4 m_m4View;
 	DirectX::XMFLOAT4X4 m_m4Projection;
 
@@ -0,0 +1,446 @@
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "../AssetCache.h"
+#include "../BlockCompression.h"
+#include "../DdsFile.h"
+#include "../Hash.h"
+#include "../ImageCodecs.h"
+#include "../JobScheduler.h"
+#include "../MaterialPacking.h"
+#include "../Mesh.h"
+#include "../TextureMips.h"
+
+// Offline cook: walks an asset directory, hashes every source and cooks OBJ meshes into
+// .meshcache files and textures into block compressed .dds files, in a content-addressed cache
+// (see AssetCache.h) the game resolves its assets through. An entry's name is the hash of its
+// sources and the cooker version, so only sources that changed (or are new) get cooked again.
+// The work runs on the game's job scheduler: every texture is split into bands of rows, and workers
+// that run out of their own bands steal other textures'. Meshes are cooked by the game's own
+// importer (Mesh), which is why this links the same D3D11 headers and libraries as the game;
+// it never creates a device.
+
+// Pixel rows each texture compression task takes (a multiple of the 4x4 block size)
+#define COOK_BAND_ROWS 64
+
+namespace
+{
+	// Faces of a cubemap directory, in the order D3D11 expects them (+X, -X, +Y, -Y, +Z, -Z)
+	const char* CUBEMAP_FACES[6] = { "right", "left", "up", "down", "front", "back" };
+
+	// Occlusion, roughness and metalness of missing packed maps: no occlusion and half rough, like the game's materials
+	const float PACK_DEFAULTS[PACKED_CHANNEL_COUNT] = { 1.0f, 0.5f, 0.0f };
+
+	// --------------------------------------------------------
+	// One asset to cook: an ASSET_KIND_* and its sources
+	// --------------------------------------------------------
+	struct CookItem
+	{
+		int Kind;
+		std::vector<std::string> Sources; // empty for a missing packed map
+		std::string Name;
+		std::string Output;
+	};
+
+	// --------------------------------------------------------
+	// Totals of a run, updated by every worker
+	// --------------------------------------------------------
+	struct CookStats
+	{
+		std::atomic<unsigned int> Cooked{ 0 };
+		std::atomic<unsigned int> UpToDate{ 0 };
+		std::atomic<unsigned int> Failed{ 0 };
+	};
+
+	// --------------------------------------------------------
+	// A texture being cooked: the tasks that decode its faces
+	// and compress its bands share this, and the last one to
+	// finish writes the file
+	// --------------------------------------------------------
+	struct TextureJob
+	{
+		CookItem Item;
+		int Format;			// BC_FORMAT_*
+		int MipKind;		// TEXTURE_KIND_*
+		std::vector<std::vector<DecodedImage>> Mips;	// every face's chain
+		std::vector<std::vector<DdsMipLevel>> Levels;	// every face's compressed chain
+		std::atomic<size_t> Remaining{ 0 };				// tasks still to finish
+		std::atomic<bool> Failed{ false };
+		std::chrono::steady_clock::time_point Start;
+	};
+
+	void PrintUsage()
+	{
+		printf("Usage: Cook [assets directory] [cache directory] [--threads N] [--force]\n");
+		printf("Cooks every OBJ mesh and every texture set under the assets directory (Assets by default)\n");
+		printf("into the cache directory (Cache by default), skipping those whose entry is already there.\n");
+		printf("Textures are recognized by name: _diff and _albedo (BC7), _nor (BC5), _rough, _metal and _ao\n");
+		printf("(packed into one BC7 texture per material), and right/left/up/down/front/back (a BC7 cubemap).\n");
+		printf("--force cooks everything again.\n");
+	}
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point a_tpStart)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - a_tpStart).count();
+	}
+
+	std::string Lowercase(std::string a_sText)
+	{
+		for (char& c : a_sText)
+			c = (char)tolower((unsigned char)c);
+		return a_sText;
+	}
+
+	/// <summary>
+	/// Finds every asset under a directory, grouping packed maps by material and cubemap faces by directory
+	/// </summary>
+	/// <param name="a_sAssets">Directory to walk</param>
+	/// <param name="a_uSkipped">Receives the number of files that aren't assets this cooks</param>
+	/// <returns>Assets in a stable order</returns>
+	std::vector<CookItem> FindAssets(const std::string& a_sAssets, unsigned int& a_uSkipped)
+	{
+		std::map<std::string, CookItem> htItems; // by name, so runs cook in the same order
+		std::map<std::string, std::vector<std::string>> htPacks; // by directory and material name
+		std::map<std::string, std::vector<std::string>> htCubemaps; // by directory
+		a_uSkipped = 0;
+
+		std::error_code error;
+		for (auto it = std::filesystem::recursive_directory_iterator(a_sAssets, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		{
+			if (!it->is_regular_file())
+				continue;
+			std::filesystem::path path = it->path();
+			std::string sPath = path.string();
+			std::string sExtension = Lowercase(path.extension().string());
+			std::string sStem = Lowercase(path.stem().string());
+			std::string sDirectory = path.parent_path().string();
+
+			if (sExtension == ".obj")
+			{
+				htItems[sPath] = { ASSET_KIND_MESH, { sPath }, sPath, "" };
+				continue;
+			}
+			if (sExtension != ".png" && sExtension != ".jpg" && sExtension != ".jpeg")
+			{
+				a_uSkipped++;
+				continue;
+			}
+
+			bool bFace = false;
+			for (int f = 0; f < 6 && !bFace; f++)
+				if (sStem == CUBEMAP_FACES[f])
+				{
+					std::vector<std::string>& vFaces = htCubemaps[sDirectory];
+					vFaces.resize(6);
+					vFaces[f] = sPath;
+					bFace = true;
+				}
+			if (bFace)
+				continue;
+
+			// the naming of the texture sets in Assets: <material>_<map>_<resolution>
+			const char* TOKENS[6] = { "_diff", "_albedo", "_nor", "_ao", "_rough", "_metal" };
+			size_t uToken = std::string::npos;
+			int nToken = -1;
+			for (int t = 0; t < 6 && nToken < 0; t++)
+				if ((uToken = sStem.find(TOKENS[t])) != std::string::npos)
+					nToken = t;
+			if (nToken < 0)
+				a_uSkipped++;
+			else if (nToken < 2)
+				htItems[sPath] = { ASSET_KIND_COLOR_TEXTURE, { sPath }, sPath, "" };
+			else if (nToken == 2)
+				htItems[sPath] = { ASSET_KIND_NORMAL_TEXTURE, { sPath }, sPath, "" };
+			else
+			{
+				std::vector<std::string>& vMaps = htPacks[(path.parent_path() / sStem.substr(0, uToken)).string()];
+				vMaps.resize(PACKED_CHANNEL_COUNT);
+				vMaps[nToken == 3 ? PACKED_CHANNEL_OCCLUSION : nToken == 4 ? PACKED_CHANNEL_ROUGHNESS : PACKED_CHANNEL_METALNESS] = sPath;
+			}
+		}
+
+		for (auto& pack : htPacks)
+			htItems[pack.first + " (packed)"] = { ASSET_KIND_PACKED_MAPS, pack.second, pack.first + " (packed)", "" };
+		for (auto& cubemap : htCubemaps)
+		{
+			bool bComplete = true;
+			for (const std::string& sFace : cubemap.second)
+				bComplete = bComplete && !sFace.empty();
+			if (bComplete)
+				htItems[cubemap.first + " (cubemap)"] = { ASSET_KIND_CUBEMAP, cubemap.second, cubemap.first + " (cubemap)", "" };
+			else
+				a_uSkipped += 1;
+		}
+
+		std::vector<CookItem> vItems;
+		for (auto& item : htItems)
+			vItems.push_back(std::move(item.second));
+		return vItems;
+	}
+
+	/// <summary>
+	/// Moves a finished temporary file over an entry, so a crash never leaves a torn entry behind
+	/// </summary>
+	bool CommitEntry(const std::string& a_sTempName, const std::string& a_sOutput)
+	{
+		std::error_code error;
+		std::filesystem::rename(a_sTempName, a_sOutput, error);
+		return !error;
+	}
+
+	/// <summary>
+	/// Writes a texture once its last band is compressed
+	/// </summary>
+	void FinishTexture(TextureJob& a_Job, CookStats& a_Stats)
+	{
+		bool bWritten = false;
+		std::string sTempName = a_Job.Item.Output + ".tmp";
+		if (!a_Job.Failed)
+		{
+			// the cubemap's faces are sRGB if the images say so, like the ones the game decodes itself
+			uint32_t uDxgiFormat = a_Job.Format == BC_FORMAT_BC5 ? DDS_DXGI_FORMAT_BC5_UNORM :
+				a_Job.Item.Kind == ASSET_KIND_CUBEMAP && a_Job.Mips[0][0].SRGB ? DDS_DXGI_FORMAT_BC7_UNORM_SRGB : DDS_DXGI_FORMAT_BC7_UNORM;
+			uint32_t uBlockSize = (uint32_t)GetBlockSize(a_Job.Format);
+			bWritten = a_Job.Item.Kind == ASSET_KIND_CUBEMAP ?
+				WriteDdsCubemap(sTempName.c_str(), uDxgiFormat, uBlockSize, a_Job.Levels) :
+				WriteDdsFile(sTempName.c_str(), uDxgiFormat, uBlockSize, a_Job.Levels[0]);
+			bWritten = bWritten && CommitEntry(sTempName, a_Job.Item.Output);
+		}
+
+		if (bWritten)
+		{
+			a_Stats.Cooked++;
+			printf("%s: %ux%u, %zu mips, %s (%.0f ms)\n", a_Job.Item.Name.c_str(), a_Job.Levels[0][0].Width, a_Job.Levels[0][0].Height,
+				a_Job.Levels[0].size(), a_Job.Format == BC_FORMAT_BC5 ? "BC5" : "BC7", MillisecondsSince(a_Job.Start));
+		}
+		else
+		{
+			a_Stats.Failed++;
+			printf("%s: failed\n", a_Job.Item.Name.c_str());
+		}
+
+		// the chains aren't needed any more, even while the job itself may still be referenced
+		a_Job.Mips.clear();
+		a_Job.Levels.clear();
+	}
+
+	void FinishTask(const std::shared_ptr<TextureJob>& a_spJob, CookStats& a_Stats)
+	{
+		if (--a_spJob->Remaining == 0)
+			FinishTexture(*a_spJob, a_Stats);
+	}
+
+	/// <summary>
+	/// Compresses one band of rows of one level into its place in the level's blocks
+	/// </summary>
+	void CompressBand(const std::shared_ptr<TextureJob>& a_spJob, size_t a_uFace, size_t a_uLevel, uint32_t a_uFirstRow, CookStats& a_Stats)
+	{
+		const DecodedImage& level = a_spJob->Mips[a_uFace][a_uLevel];
+		DecodedImage band;
+		band.Width = level.Width;
+		band.Height = std::min<uint32_t>(COOK_BAND_ROWS, level.Height - a_uFirstRow);
+		band.SRGB = level.SRGB;
+		band.Pixels.assign(level.Pixels.begin() + (size_t)a_uFirstRow * level.Width * 4,
+			level.Pixels.begin() + (size_t)(a_uFirstRow + band.Height) * level.Width * 4);
+
+		// bands start on block rows, so each one's blocks are a contiguous part of the level's
+		size_t uOffset = GetCompressedSize(level.Width, a_uFirstRow, a_spJob->Format);
+		CompressImage(a_spJob->Levels[a_uFace][a_uLevel].Blocks.data() + uOffset, band, a_spJob->Format, 1);
+		FinishTask(a_spJob, a_Stats);
+	}
+
+	/// <summary>
+	/// Decodes one face of a texture, builds its mip chain and queues the compression of its bands
+	/// </summary>
+	void PrepareFace(const std::shared_ptr<TextureJob>& a_spJob, size_t a_uFace, JobScheduler& a_Jobs, JobCounter& a_Done, CookStats& a_Stats)
+	{
+		TextureJob& job = *a_spJob;
+		DecodedImage image;
+		try
+		{
+			if (job.Item.Kind == ASSET_KIND_PACKED_MAPS)
+			{
+				DecodedImage maps[PACKED_CHANNEL_COUNT];
+				const DecodedImage* pMaps[PACKED_CHANNEL_COUNT] = {};
+				for (int c = 0; c < PACKED_CHANNEL_COUNT && !job.Failed; c++)
+					if (!job.Item.Sources[c].empty())
+					{
+						job.Failed = job.Failed || !LoadImageFile(job.Item.Sources[c].c_str(), maps[c]);
+						pMaps[c] = &maps[c];
+					}
+				if (!job.Failed)
+				{
+					PackedMaterialMaps packed;
+					PackMaterialMaps(packed, pMaps[PACKED_CHANNEL_OCCLUSION], pMaps[PACKED_CHANNEL_ROUGHNESS], pMaps[PACKED_CHANNEL_METALNESS], PACK_DEFAULTS);
+					image = std::move(packed.Image);
+				}
+			}
+			else if (!LoadImageFile(job.Item.Sources[a_uFace].c_str(), image))
+				job.Failed = true;
+
+			if (!job.Failed)
+			{
+				std::vector<DecodedImage>& vMips = job.Mips[a_uFace];
+				vMips = GenerateMipChain(std::move(image), job.MipKind, MIP_FILTER_KAISER, 1);
+				job.Levels[a_uFace].resize(vMips.size());
+				for (size_t i = 0; i < vMips.size(); i++)
+				{
+					DdsMipLevel& level = job.Levels[a_uFace][i];
+					level.Width = vMips[i].Width;
+					level.Height = vMips[i].Height;
+					level.Blocks.resize(GetCompressedSize(level.Width, level.Height, job.Format));
+
+					// counted before this task finishes, so the texture can't be written early
+					for (uint32_t y = 0; y < level.Height; y += COOK_BAND_ROWS)
+					{
+						job.Remaining++;
+						a_Jobs.Run(a_Done, [a_spJob, a_uFace, i, y, &a_Stats] { CompressBand(a_spJob, a_uFace, i, y, a_Stats); });
+					}
+				}
+			}
+		}
+		catch (const std::exception&)
+		{
+			job.Failed = true;
+		}
+		FinishTask(a_spJob, a_Stats);
+	}
+
+	/// <summary>
+	/// Queues the cook of one texture: a task per face, which queue a task per band
+	/// </summary>
+	void CookTexture(CookItem a_Item, JobScheduler& a_Jobs, JobCounter& a_Done, CookStats& a_Stats)
+	{
+		std::shared_ptr<TextureJob> spJob = std::make_shared<TextureJob>();
+		size_t uFaces = a_Item.Kind == ASSET_KIND_CUBEMAP ? 6 : 1;
+		spJob->Format = a_Item.Kind == ASSET_KIND_NORMAL_TEXTURE ? BC_FORMAT_BC5 : BC_FORMAT_BC7;
+		spJob->MipKind = a_Item.Kind == ASSET_KIND_NORMAL_TEXTURE ? TEXTURE_KIND_NORMAL :
+			a_Item.Kind == ASSET_KIND_PACKED_MAPS ? TEXTURE_KIND_DATA : TEXTURE_KIND_COLOR;
+		spJob->Item = std::move(a_Item);
+		spJob->Mips.resize(uFaces);
+		spJob->Levels.resize(uFaces);
+		spJob->Remaining = uFaces;
+		spJob->Start = std::chrono::steady_clock::now();
+		for (size_t f = 0; f < uFaces; f++)
+			a_Jobs.Run(a_Done, [spJob, f, &a_Jobs, &a_Done, &a_Stats] { PrepareFace(spJob, f, a_Jobs, a_Done, a_Stats); });
+	}
+
+	/// <summary>
+	/// Queues the cook of one mesh, which the game's importer writes into the cache itself
+	/// </summary>
+	void CookMesh(CookItem a_Item, JobScheduler& a_Jobs, JobCounter& a_Done, CookStats& a_Stats)
+	{
+		a_Jobs.Run(a_Done, [a_Item, &a_Stats]
+		{
+			auto start = std::chrono::steady_clock::now();
+			try
+			{
+				Mesh mesh(a_Item.Sources[0].c_str(), true, true);
+				std::error_code error;
+				if (std::filesystem::exists(a_Item.Output, error))
+				{
+					a_Stats.Cooked++;
+					printf("%s: %u vertices, %u indices, %u levels of detail (%.0f ms)\n", a_Item.Name.c_str(),
+						mesh.GetVertexCount(), mesh.GetIndexCount(), mesh.GetLodCount(), MillisecondsSince(start));
+					return;
+				}
+			}
+			catch (const std::exception&)
+			{
+			}
+			a_Stats.Failed++;
+			printf("%s: failed\n", a_Item.Name.c_str());
+		});
+	}
+}
+
+// --------------------------------------------------------
+// Entry point of the cook tool
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> vDirectories;
+	unsigned int uThreads = 0;
+	bool bForce = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			uThreads = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--force") == 0)
+			bForce = true;
+		else if (argv[i][0] == '-' || vDirectories.size() == 2)
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			vDirectories.push_back(argv[i]);
+	}
+	std::string sAssets = vDirectories.size() > 0 ? vDirectories[0] : "Assets";
+	std::string sCache = vDirectories.size() > 1 ? vDirectories[1] : "Cache";
+	if (!std::filesystem::is_directory(sAssets))
+	{
+		printf("%s is not a directory\n", sAssets.c_str());
+		PrintUsage();
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	SetAssetCacheDirectory(sCache);
+	unsigned int uSkipped;
+	std::vector<CookItem> vItems = FindAssets(sAssets, uSkipped);
+
+	// hashing the sources finds each entry; the index spares re-reading sources that weren't touched
+	CookStats stats;
+	std::vector<CookItem> vToCook;
+	for (CookItem& item : vItems)
+	{
+		uint64_t uParameters = item.Kind == ASSET_KIND_PACKED_MAPS ? HashBytes(PACK_DEFAULTS, sizeof(PACK_DEFAULTS)) : 0;
+		item.Output = GetAssetCachePath(item.Kind, item.Sources, uParameters);
+		std::error_code error;
+		if (item.Output.empty())
+		{
+			stats.Failed++;
+			printf("%s: can't read the source\n", item.Name.c_str());
+		}
+		else if (std::filesystem::exists(item.Output, error) && !bForce)
+			stats.UpToDate++;
+		else
+		{
+			std::filesystem::remove(item.Output, error);
+			vToCook.push_back(std::move(item));
+		}
+	}
+	double dHashMilliseconds = MillisecondsSince(start);
+
+	// this thread is the scheduler's first worker, so it queues the items and then helps cook them
+	JobScheduler jobs(uThreads);
+	JobCounter done;
+	for (CookItem& item : vToCook)
+	{
+		if (item.Kind == ASSET_KIND_MESH)
+			CookMesh(std::move(item), jobs, done, stats);
+		else
+			CookTexture(std::move(item), jobs, done, stats);
+	}
+	jobs.Wait(done);
+	jobs.EndFrame();
+	JobSchedulerStats jobStats = jobs.GetStats();
+	SaveAssetCacheIndex();
+
+	printf("%u cooked, %u up to date, %u failed, %u other files skipped\n", stats.Cooked.load(), stats.UpToDate.load(), stats.Failed.load(), uSkipped);
+	printf("%.0f ms (%.0f ms finding and hashing sources) on %u threads, %llu of %llu jobs stolen\n", MillisecondsSince(start), dHashMilliseconds,
+		jobStats.Threads, (unsigned long long)jobStats.Steals, (unsigned long long)jobStats.Jobs);
+	return stats.Failed ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+#include "DdsFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	// DDS_HEADER and DDS_HEADER_DXT10 as laid out in the file
+	struct DdsPixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask, GBitMask, BBitMask, ABitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		uint32_t Reserved1[11];
+		DdsPixelFormat PixelFormat;
+		uint32_t Caps, Caps2, Caps3, Caps4;
+		uint32_t Reserved2;
+	};
+
+	struct DdsHeaderDx10
+	{
+		uint32_t DxgiFormat;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	const uint32_t DDS_FOURCC_DX10 = 0x30315844; // "DX10"
+	const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+	const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xFE00; // DDSCAPS2_CUBEMAP and all six DDSCAPS2_CUBEMAP_* faces
+	const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+	const uint32_t D3D11_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+	/// <summary>
+	/// Writes the headers and then every face's levels, one face after another
+	/// </summary>
+	/// <param name="a_vFaces">One face for a 2D texture, six for a cubemap; each with the same levels</param>
+	bool WriteFaces(const char* a_sFileName, uint32_t a_uDxgiFormat, uint32_t a_uBlockSize, const std::vector<const std::vector<DdsMipLevel>*>& a_vFaces)
+	{
+		const std::vector<DdsMipLevel>& vLevels = *a_vFaces[0];
+		if (vLevels.empty())
+			return false;
+		for (const std::vector<DdsMipLevel>* pFace : a_vFaces)
+			if (pFace->size() != vLevels.size() || (*pFace)[0].Width != vLevels[0].Width || (*pFace)[0].Height != vLevels[0].Height)
+				return false;
+		bool bCubemap = a_vFaces.size() == 6;
+
+		DdsHeader header = {};
+		header.Size = sizeof(DdsHeader);
+		header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+		header.Width = vLevels[0].Width;
+		header.Height = vLevels[0].Height;
+		header.PitchOrLinearSize = ((header.Width + 3) / 4) * ((header.Height + 3) / 4) * a_uBlockSize;
+		header.Depth = 1;
+		header.MipMapCount = (uint32_t)vLevels.size();
+		header.PixelFormat.Size = sizeof(DdsPixelFormat);
+		header.PixelFormat.Flags = DDPF_FOURCC;
+		header.PixelFormat.FourCC = DDS_FOURCC_DX10;
+		header.Caps = DDSCAPS_TEXTURE | (vLevels.size() > 1 || bCubemap ? DDSCAPS_COMPLEX : 0) | (vLevels.size() > 1 ? DDSCAPS_MIPMAP : 0);
+		header.Caps2 = bCubemap ? DDSCAPS2_CUBEMAP_ALLFACES : 0;
+
+		// a cubemap is one array slice with the cube flag; the loader reads six faces for it
+		DdsHeaderDx10 dx10 = {};
+		dx10.DxgiFormat = a_uDxgiFormat;
+		dx10.ResourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+		dx10.MiscFlag = bCubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+		dx10.ArraySize = 1;
+
+		std::ofstream file(a_sFileName, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+		file.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)&dx10, sizeof(dx10));
+		for (const std::vector<DdsMipLevel>* pFace : a_vFaces)
+			for (const DdsMipLevel& level : *pFace)
+				file.write((const char*)level.Blocks.data(), level.Blocks.size());
+		file.close();
+		return !file.fail();
+	}
+}
+
+/// <summary>
+/// Writes a block compressed texture to a DDS file
+/// </summary>
+/// <param name="a_sFileName">Path of the file to create</param>
+/// <param name="a_uDxgiFormat">DDS_DXGI_FORMAT_*</param>
+/// <param name="a_uBlockSize">Bytes per 4x4 block</param>
+/// <param name="a_vLevels">Mip levels, largest first</param>
+/// <returns>Whether the whole file was written</returns>
+bool WriteDdsFile(const char* a_sFileName, uint32_t a_uDxgiFormat, uint32_t a_uBlockSize, const std::vector<DdsMipLevel>& a_vLevels)
+{
+	return WriteFaces(a_sFileName, a_uDxgiFormat, a_uBlockSize, { &a_vLevels });
+}
+
+/// <summary>
+/// Writes a block compressed cubemap to a DDS file
+/// </summary>
+/// <param name="a_sFileName">Path of the file to create</param>
+/// <param name="a_uDxgiFormat">DDS_DXGI_FORMAT_*</param>
+/// <param name="a_uBlockSize">Bytes per 4x4 block</param>
+/// <param name="a_vFaces">Mip levels of +X, -X, +Y, -Y, +Z and -Z, largest first</param>
+/// <returns>Whether the whole file was written</returns>
+bool WriteDdsCubemap(const char* a_sFileName, uint32_t a_uDxgiFormat, uint32_t a_uBlockSize, const std::vector<std::vector<DdsMipLevel>>& a_vFaces)
+{
+	if (a_vFaces.size() != 6)
+		return false;
+	std::vector<const std::vector<DdsMipLevel>*> vFaces;
+	for (const std::vector<DdsMipLevel>& face : a_vFaces)
+		vFaces.push_back(&face);
+	return WriteFaces(a_sFileName, a_uDxgiFormat, a_uBlockSize, vFaces);
+}
+
+/// <summary>
+/// Reads a block compressed texture written by WriteDdsFile back from memory
+/// </summary>
+/// <param name="a_pData">Contents of the file</param>
+/// <param name="a_uSize">Size of the file</param>
+/// <param name="a_uDxgiFormat">Receives the DDS_DXGI_FORMAT_*</param>
+/// <param name="a_vLevels">Receives the mip levels, largest first</param>
+/// <returns>Whether the file is a 2D texture in one of the cooker's formats, with every level present</returns>
+bool ReadDdsFile(const uint8_t* a_pData, size_t a_uSize, uint32_t& a_uDxgiFormat, std::vector<DdsMipLevel>& a_vLevels)
+{
+	size_t uOffset = sizeof(DDS_MAGIC) + sizeof(DdsHeader) + sizeof(DdsHeaderDx10);
+	if (a_uSize < uOffset)
+		return false;
+
+	uint32_t uMagic;
+	DdsHeader header;
+	DdsHeaderDx10 dx10;
+	memcpy(&uMagic, a_pData, sizeof(uMagic));
+	memcpy(&header, a_pData + sizeof(uMagic), sizeof(header));
+	memcpy(&dx10, a_pData + sizeof(uMagic) + sizeof(header), sizeof(dx10));
+	if (uMagic != DDS_MAGIC || header.Size != sizeof(DdsHeader) || header.PixelFormat.FourCC != DDS_FOURCC_DX10 ||
+		dx10.ResourceDimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || dx10.ArraySize != 1 || dx10.MiscFlag != 0)
+		return false;
+
+	uint32_t uBlockSize = GetDdsBlockSize(dx10.DxgiFormat);
+	if (uBlockSize == 0 || header.Width == 0 || header.Height == 0)
+		return false;
+
+	a_uDxgiFormat = dx10.DxgiFormat;
+	a_vLevels.resize(std::max(1u, header.MipMapCount));
+	uint32_t uWidth = header.Width, uHeight = header.Height;
+	for (DdsMipLevel& level : a_vLevels)
+	{
+		size_t uBytes = (size_t)((uWidth + 3) / 4) * ((uHeight + 3) / 4) * uBlockSize;
+		if (a_uSize - uOffset < uBytes)
+			return false;
+		level.Width = uWidth;
+		level.Height = uHeight;
+		level.Blocks.assign(a_pData + uOffset, a_pData + uOffset + uBytes);
+		uOffset += uBytes;
+		uWidth = std::max(1u, uWidth / 2);
+		uHeight = std::max(1u, uHeight / 2);
+	}
+	return true;
+}
+
+/// <summary>
+/// Gets the bytes per 4x4 block of a DDS_DXGI_FORMAT_*
+/// </summary>
+/// <returns>8 or 16, 0 for formats the cooker doesn't write</returns>
+uint32_t GetDdsBlockSize(uint32_t a_uDxgiFormat)
+{
+	switch (a_uDxgiFormat)
+	{
+	case DDS_DXGI_FORMAT_BC1_UNORM:
+	case DDS_DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DDS_DXGI_FORMAT_BC4_UNORM:
+		return 8;
+	case DDS_DXGI_FORMAT_BC5_UNORM:
+	case DDS_DXGI_FORMAT_BC7_UNORM:
+	case DDS_DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 16;
+	default:
+		return 0;
+	}
+}
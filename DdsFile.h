@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// DXGI_FORMAT values of the formats the texture cooker writes (dxgiformat.h isn't available off Windows)
+#define DDS_DXGI_FORMAT_BC1_UNORM		71
+#define DDS_DXGI_FORMAT_BC1_UNORM_SRGB	72
+#define DDS_DXGI_FORMAT_BC4_UNORM		80
+#define DDS_DXGI_FORMAT_BC5_UNORM		83
+#define DDS_DXGI_FORMAT_BC7_UNORM		98
+#define DDS_DXGI_FORMAT_BC7_UNORM_SRGB	99
+
+// --------------------------------------------------------
+// One mip level of a block compressed 2D texture
+// --------------------------------------------------------
+struct DdsMipLevel
+{
+	uint32_t Width;
+	uint32_t Height;
+	std::vector<uint8_t> Blocks;
+};
+
+// Writes a block compressed 2D texture with its mip chain (largest level first) as a DDS file
+// with the DX10 header extension, which the DDS texture loader reads straight into a texture.
+// a_uBlockSize is the bytes per 4x4 block (8 or 16). Returns false if the file can't be written.
+bool WriteDdsFile(const char* a_sFileName, uint32_t a_uDxgiFormat, uint32_t a_uBlockSize, const std::vector<DdsMipLevel>& a_vLevels);
+
+// Writes a block compressed cubemap the same way: six faces (+X, -X, +Y, -Y, +Z, -Z) of equal size, each
+// with its mip chain, which the DDS texture loader reads into a cube texture.
+bool WriteDdsCubemap(const char* a_sFileName, uint32_t a_uDxgiFormat, uint32_t a_uBlockSize, const std::vector<std::vector<DdsMipLevel>>& a_vFaces);
+
+// Reads a file WriteDdsFile wrote back from memory, level by level, so they can be uploaded
+// separately (see TextureStreamer). Returns false for any other kind of DDS file, which the
+// DDS texture loader still reads.
+bool ReadDdsFile(const uint8_t* a_pData, size_t a_uSize, uint32_t& a_uDxgiFormat, std::vector<DdsMipLevel>& a_vLevels);
+
+// Bytes per 4x4 block of a DDS_DXGI_FORMAT_*, 0 for any other format
+uint32_t GetDdsBlockSize(uint32_t a_uDxgiFormat);
@@ -0,0 +1,235 @@
+#include "DrawSort.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <utility>
+
+namespace
+{
+	const unsigned int RADIX_DIGITS = 1u << DRAW_SORT_RADIX_BITS;
+	const unsigned int RADIX_PASSES = 64 / DRAW_SORT_RADIX_BITS;
+
+	/// <summary>
+	/// Keeps the low bits of a field that fit in the key
+	/// </summary>
+	uint64_t Field(uint32_t a_uValue, unsigned int a_uBits, unsigned int a_uShift)
+	{
+		return ((uint64_t)a_uValue & ((1ull << a_uBits) - 1)) << a_uShift;
+	}
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point a_tpStart)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - a_tpStart).count();
+	}
+}
+
+/// <summary>
+/// Packs what a draw binds into a key that sorts draws sharing state next to each other.
+/// Ids that don't fit in their field wrap: draws that share state may then sort apart, and
+/// draws with different ids can end up with the same key, so anything that merges draws by
+/// key has to compare the real ids too (RenderList::BatchInstances does).
+/// </summary>
+/// <param name="a_uPass">DRAW_PASS_ the draw belongs to</param>
+/// <param name="a_uShader">Id of the shader program</param>
+/// <param name="a_uMaterial">Id of the material</param>
+/// <param name="a_uMesh">Id of the mesh</param>
+/// <param name="a_uLod">Level of detail the mesh is drawn at</param>
+/// <param name="a_uDepth">Depth from QuantizeDrawDepth (0 for none)</param>
+/// <returns>Key</returns>
+uint64_t MakeDrawKey(uint32_t a_uPass, uint32_t a_uShader, uint32_t a_uMaterial, uint32_t a_uMesh, uint32_t a_uLod, uint32_t a_uDepth)
+{
+	return Field(a_uPass, DRAW_KEY_PASS_BITS, DRAW_KEY_PASS_SHIFT)
+		| Field(a_uShader, DRAW_KEY_SHADER_BITS, DRAW_KEY_SHADER_SHIFT)
+		| Field(a_uMaterial, DRAW_KEY_MATERIAL_BITS, DRAW_KEY_MATERIAL_SHIFT)
+		| Field(a_uMesh, DRAW_KEY_MESH_BITS, DRAW_KEY_MESH_SHIFT)
+		| Field(a_uLod, DRAW_KEY_LOD_BITS, DRAW_KEY_LOD_SHIFT)
+		| Field(a_uDepth, DRAW_KEY_DEPTH_BITS, DRAW_KEY_DEPTH_SHIFT);
+}
+
+/// <summary>
+/// Turns a view depth into the key's depth field, linearly between the clip planes, so nearer draws sort first
+/// </summary>
+/// <param name="a_fDepth">Distance along the view direction</param>
+/// <param name="a_fNear">Near clip plane distance</param>
+/// <param name="a_fFar">Far clip plane distance</param>
+/// <returns>Depth field</returns>
+uint32_t QuantizeDrawDepth(float a_fDepth, float a_fNear, float a_fFar)
+{
+	float fDepth = (a_fDepth - a_fNear) / (a_fFar - a_fNear);
+	fDepth = (std::max)(0.0f, (std::min)(fDepth, 1.0f));
+	return (uint32_t)(fDepth * (float)((1u << DRAW_KEY_DEPTH_BITS) - 1));
+}
+
+/// <summary>
+/// Gets the pass field of a key
+/// </summary>
+uint32_t GetDrawKeyPass(uint64_t a_uKey)
+{
+	return (uint32_t)((a_uKey >> DRAW_KEY_PASS_SHIFT) & ((1ull << DRAW_KEY_PASS_BITS) - 1));
+}
+
+/// <summary>
+/// Gets the shader program field of a key
+/// </summary>
+uint32_t GetDrawKeyShader(uint64_t a_uKey)
+{
+	return (uint32_t)((a_uKey >> DRAW_KEY_SHADER_SHIFT) & ((1ull << DRAW_KEY_SHADER_BITS) - 1));
+}
+
+/// <summary>
+/// Gets the material field of a key
+/// </summary>
+uint32_t GetDrawKeyMaterial(uint64_t a_uKey)
+{
+	return (uint32_t)((a_uKey >> DRAW_KEY_MATERIAL_SHIFT) & ((1ull << DRAW_KEY_MATERIAL_BITS) - 1));
+}
+
+/// <summary>
+/// Gets the mesh field of a key
+/// </summary>
+uint32_t GetDrawKeyMesh(uint64_t a_uKey)
+{
+	return (uint32_t)((a_uKey >> DRAW_KEY_MESH_SHIFT) & ((1ull << DRAW_KEY_MESH_BITS) - 1));
+}
+
+/// <summary>
+/// Gets the level of detail field of a key
+/// </summary>
+uint32_t GetDrawKeyLod(uint64_t a_uKey)
+{
+	return (uint32_t)((a_uKey >> DRAW_KEY_LOD_SHIFT) & ((1ull << DRAW_KEY_LOD_BITS) - 1));
+}
+
+/// <summary>
+/// Gets everything but the depth of a key. Draws with the same batch bind the same state
+/// and geometry, and can be drawn as instances of one draw, as long as their ids fit their
+/// fields (see MakeDrawKey).
+/// </summary>
+uint64_t GetDrawKeyBatch(uint64_t a_uKey)
+{
+	return a_uKey >> DRAW_KEY_LOD_SHIFT;
+}
+
+/// <summary>
+/// Counts how often consecutive draws differ in shader program, material and mesh (the first draw binds everything)
+/// </summary>
+/// <param name="a_pKeys">Keys of the draws, in submission order</param>
+/// <param name="a_uCount">Number of draws</param>
+/// <returns>Changes of each kind</returns>
+DrawStateChanges CountDrawStateChanges(const uint64_t* a_pKeys, size_t a_uCount)
+{
+	DrawStateChanges changes = {};
+	for (size_t i = 0; i < a_uCount; i++)
+	{
+		bool bFirst = i == 0;
+		changes.Shaders += bFirst || GetDrawKeyShader(a_pKeys[i]) != GetDrawKeyShader(a_pKeys[i - 1]);
+		changes.Materials += bFirst || GetDrawKeyMaterial(a_pKeys[i]) != GetDrawKeyMaterial(a_pKeys[i - 1]);
+		changes.Meshes += bFirst || GetDrawKeyMesh(a_pKeys[i]) != GetDrawKeyMesh(a_pKeys[i - 1]);
+	}
+	return changes;
+}
+
+/// <summary>
+/// Sorts keys in ascending order, moving each value with its key. Stable, so equal keys keep their order.
+/// </summary>
+/// <param name="a_vKeys">Keys to sort</param>
+/// <param name="a_vValues">Value of each key, as many as there are keys</param>
+void DrawKeySorter::Sort(std::vector<uint64_t>& a_vKeys, std::vector<uint32_t>& a_vValues)
+{
+	size_t uCount = a_vKeys.size();
+	if (uCount < 2)
+		return;
+
+	// every digit's histogram in one read of the keys
+	std::vector<uint32_t> vCounts(RADIX_PASSES * RADIX_DIGITS, 0);
+	for (uint64_t uKey : a_vKeys)
+		for (unsigned int p = 0; p < RADIX_PASSES; p++)
+			vCounts[p * RADIX_DIGITS + ((uKey >> (p * DRAW_SORT_RADIX_BITS)) & (RADIX_DIGITS - 1))]++;
+
+	m_vKeyScratch.resize(uCount);
+	m_vValueScratch.resize(uCount);
+	for (unsigned int p = 0; p < RADIX_PASSES; p++)
+	{
+		uint32_t* pCounts = &vCounts[p * RADIX_DIGITS];
+		unsigned int uShift = p * DRAW_SORT_RADIX_BITS;
+
+		// a digit every key has leaves the order as it is
+		if (pCounts[(a_vKeys[0] >> uShift) & (RADIX_DIGITS - 1)] == uCount)
+			continue;
+
+		uint32_t uOffset = 0;
+		for (unsigned int d = 0; d < RADIX_DIGITS; d++)
+		{
+			uint32_t uDigitCount = pCounts[d];
+			pCounts[d] = uOffset;
+			uOffset += uDigitCount;
+		}
+		for (size_t i = 0; i < uCount; i++)
+		{
+			uint32_t uTo = pCounts[(a_vKeys[i] >> uShift) & (RADIX_DIGITS - 1)]++;
+			m_vKeyScratch[uTo] = a_vKeys[i];
+			m_vValueScratch[uTo] = a_vValues[i];
+		}
+		a_vKeys.swap(m_vKeyScratch);
+		a_vValues.swap(m_vValueScratch);
+	}
+}
+
+/// <summary>
+/// Sorts a frame's worth of random draw keys with the radix sort and with std::sort, and counts
+/// the state changes of submitting the draws in the order they came in against the sorted order
+/// </summary>
+/// <param name="a_uKeys">Number of draws</param>
+/// <param name="a_uSeed">Seed of the random draws</param>
+/// <returns>Best time of each sort and the state changes</returns>
+DrawSortBenchmark BenchmarkDrawSort(unsigned int a_uKeys, unsigned int a_uSeed)
+{
+	// a few shader programs, each material using one of them, and many meshes spread over the depth range
+	const uint32_t SHADERS = 16;
+	const uint32_t MATERIALS = 512;
+	const uint32_t MESHES = 2048;
+	std::mt19937 random(a_uSeed);
+	std::uniform_int_distribution<uint32_t> material(0, MATERIALS - 1);
+	std::uniform_int_distribution<uint32_t> mesh(0, MESHES - 1);
+	std::uniform_real_distribution<float> depth(0.1f, 1000.0f);
+	std::vector<uint64_t> vKeys(a_uKeys);
+	for (unsigned int i = 0; i < a_uKeys; i++)
+	{
+		uint32_t uMaterial = material(random);
+		vKeys[i] = MakeDrawKey(DRAW_PASS_OPAQUE, uMaterial % SHADERS, uMaterial, mesh(random), 0, QuantizeDrawDepth(depth(random), 0.1f, 1000.0f));
+	}
+
+	DrawSortBenchmark result = {};
+	result.Keys = a_uKeys;
+	result.Unsorted = CountDrawStateChanges(vKeys.data(), vKeys.size());
+	result.RadixMilliseconds = result.StdSortMilliseconds = 1e30;
+
+	DrawKeySorter sorter;
+	std::vector<uint64_t> vSortedKeys;
+	std::vector<uint32_t> vSortedValues;
+	std::vector<std::pair<uint64_t, uint32_t>> vPairs(a_uKeys);
+	for (int run = 0; run < DRAW_SORT_BENCHMARK_RUNS; run++)
+	{
+		vSortedKeys = vKeys;
+		vSortedValues.resize(a_uKeys);
+		for (unsigned int i = 0; i < a_uKeys; i++)
+			vSortedValues[i] = i;
+		auto start = std::chrono::high_resolution_clock::now();
+		sorter.Sort(vSortedKeys, vSortedValues);
+		result.RadixMilliseconds = (std::min)(result.RadixMilliseconds, MillisecondsSince(start));
+
+		for (unsigned int i = 0; i < a_uKeys; i++)
+			vPairs[i] = { vKeys[i], i };
+		start = std::chrono::high_resolution_clock::now();
+		std::sort(vPairs.begin(), vPairs.end());
+		result.StdSortMilliseconds = (std::min)(result.StdSortMilliseconds, MillisecondsSince(start));
+	}
+
+	// both sorts are stable on (key, index), so they agree exactly
+	result.Correct = true;
+	for (unsigned int i = 0; i < a_uKeys; i++)
+		if (vPairs[i].first != vSortedKeys[i] || vPairs[i].second != vSortedValues[i])
+			result.Correct = false;
+	result.Sorted = CountDrawStateChanges(vSortedKeys.data(), vSortedKeys.size());
+	return result;
+}
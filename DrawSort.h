@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bits of each field of a draw key, from the most significant down: draws sort by pass,
+// then shader program, material, mesh and level of detail, and last by depth
+#define DRAW_KEY_PASS_BITS		2
+#define DRAW_KEY_SHADER_BITS	10
+#define DRAW_KEY_MATERIAL_BITS	16
+#define DRAW_KEY_MESH_BITS		16
+#define DRAW_KEY_LOD_BITS		4
+#define DRAW_KEY_DEPTH_BITS		16
+
+#define DRAW_KEY_DEPTH_SHIFT	0
+#define DRAW_KEY_LOD_SHIFT		(DRAW_KEY_DEPTH_SHIFT + DRAW_KEY_DEPTH_BITS)
+#define DRAW_KEY_MESH_SHIFT		(DRAW_KEY_LOD_SHIFT + DRAW_KEY_LOD_BITS)
+#define DRAW_KEY_MATERIAL_SHIFT	(DRAW_KEY_MESH_SHIFT + DRAW_KEY_MESH_BITS)
+#define DRAW_KEY_SHADER_SHIFT	(DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS)
+#define DRAW_KEY_PASS_SHIFT		(DRAW_KEY_SHADER_SHIFT + DRAW_KEY_SHADER_BITS)
+
+// Passes, in the order their draws sort
+#define DRAW_PASS_OPAQUE	0
+#define DRAW_PASS_SHADOW	1
+
+// Bits the radix sort handles per pass over the keys
+#define DRAW_SORT_RADIX_BITS 8
+
+// Times each case of BenchmarkDrawSort runs (the best run counts)
+#define DRAW_SORT_BENCHMARK_RUNS 5
+
+// --------------------------------------------------------
+// How often consecutive draws switched what they bind
+// --------------------------------------------------------
+struct DrawStateChanges
+{
+	unsigned int Shaders;
+	unsigned int Materials;
+	unsigned int Meshes;
+};
+
+// --------------------------------------------------------
+// Result of BenchmarkDrawSort
+// --------------------------------------------------------
+struct DrawSortBenchmark
+{
+	unsigned int Keys;
+	double RadixMilliseconds;
+	double StdSortMilliseconds;		// std::sort of the same keys, for comparison
+	DrawStateChanges Unsorted;		// in the order the draws were made
+	DrawStateChanges Sorted;
+	bool Correct;					// the radix sort's order matches std::sort's
+};
+
+uint64_t MakeDrawKey(uint32_t a_uPass, uint32_t a_uShader, uint32_t a_uMaterial, uint32_t a_uMesh, uint32_t a_uLod, uint32_t a_uDepth);
+uint32_t QuantizeDrawDepth(float a_fDepth, float a_fNear, float a_fFar);
+uint32_t GetDrawKeyPass(uint64_t a_uKey);
+uint32_t GetDrawKeyShader(uint64_t a_uKey);
+uint32_t GetDrawKeyMaterial(uint64_t a_uKey);
+uint32_t GetDrawKeyMesh(uint64_t a_uKey);
+uint32_t GetDrawKeyLod(uint64_t a_uKey);
+uint64_t GetDrawKeyBatch(uint64_t a_uKey);
+DrawStateChanges CountDrawStateChanges(const uint64_t* a_pKeys, size_t a_uCount);
+
+// --------------------------------------------------------
+// Least-significant-digit radix sort of draw keys, carrying
+// a value (a packet index) along with each. Passes over
+// digits every key shares are skipped, so the unused high
+// fields cost nothing. Keeps its scratch between frames.
+// --------------------------------------------------------
+class DrawKeySorter
+{
+public:
+	void Sort(std::vector<uint64_t>& a_vKeys, std::vector<uint32_t>& a_vValues);
+
+private:
+	std::vector<uint64_t> m_vKeyScratch;
+	std::vector<uint32_t> m_vValueScratch;
+};
+
+// Times sorting a_uKeys random draw keys and counts the state changes before and after
+DrawSortBenchmark BenchmarkDrawSort(unsigned int a_uKeys, unsigned int a_uSeed = 1);
@@ -5,49 +5,280 @@
 #include <wrl/client.h>
 #include "Mesh.h"
 #include "Entity.h"
+#include "Window.h"
 #include <d3d11.h>
+#include <cmath>
+
+namespace
+{
+	/// <summary>
+	/// Gets one coordinate of a bobbing position: its center plus its amplitude times the wave,
+	/// or the current value on axes that don't bob
+	/// </summary>
+	float Bob(float a_fCurrent, float a_fCenter, float a_fAmplitude, float a_fWave)
+	{
+		return a_fAmplitude != 0.0f ? a_fCenter + a_fAmplitude * a_fWave : a_fCurrent;
+	}
+
+	/// <summary>
+	/// Hands a material's constants to its pixel shader, uploads both shaders' constants and binds its textures
+	/// </summary>
+	void PrepareDraw(Material& a_Material, SimpleVertexShader& a_VertexShader, DirectX::XMFLOAT3 a_f3CameraPosition, float a_fTotalTime)
+	{
+		a_Material.GetPixelShader()->SetFloat4("colorTint", a_Material.GetColorTint());
+		a_Material.GetPixelShader()->SetFloat2("uvScale", a_Material.GetUVScale());
+		a_Material.GetPixelShader()->SetFloat2("uvOffset", a_Material.GetUVOffset());
+		a_Material.GetPixelShader()->SetFloat3("packedConstant", a_Material.GetPackedConstant());
+		a_Material.GetPixelShader()->SetFloat3("packedSampled", a_Material.GetPackedSampled());
+		a_Material.GetPixelShader()->SetFloat3("cameraPos", a_f3CameraPosition);
+		a_Material.GetPixelShader()->SetFloat("totalTime", a_fTotalTime);
+
+		//Map / memcpy / Unmap the Constant Buffer resource
+		a_VertexShader.CopyAllBufferData();
+		a_Material.GetPixelShader()->CopyAllBufferData();
+
+		// bind texture & sampler
+		a_Material.PrepareMaterial();
+	}
+}
 
 /// <summary>
-/// Creates a new entity with the given mesh and a default transform
+/// Gets the components every drawn entity has
+/// </summary>
+ComponentMask DrawnEntityMask()
+{
+	return ComponentMaskOf<EntityTransform, EntityRender, EntityLod, EntityBounds>();
+}
+
+/// <summary>
+/// Recomputes the world-space box around an entity's mesh if the transform or mesh changed since
+/// it was last computed (including a loaded mesh replacing its placeholder)
+/// </summary>
+/// <param name="a_Transform">Entity's transform</param>
+/// <param name="a_Render">Entity's mesh and material</param>
+/// <param name="a_Bounds">Box to bring up to date</param>
+void UpdateEntityBounds(const EntityTransform& a_Transform, const EntityRender& a_Render, EntityBounds& a_Bounds)
+{
+	unsigned int uTransformVersion = a_Transform.Hierarchy->GetVersion(a_Transform.Node);
+	if (a_Bounds.Valid && a_Bounds.TransformVersion == uTransformVersion && a_Bounds.MeshVersion == a_Render.Mesh->GetVersion())
+		return;
+
+	DirectX::XMFLOAT3 f3Min = a_Render.Mesh->GetBoundsMin();
+	DirectX::XMFLOAT3 f3Max = a_Render.Mesh->GetBoundsMax();
+	DirectX::XMVECTOR vMin = DirectX::XMLoadFloat3(&f3Min);
+	DirectX::XMVECTOR vMax = DirectX::XMLoadFloat3(&f3Max);
+	DirectX::XMVECTOR vCenter = DirectX::XMVectorScale(DirectX::XMVectorAdd(vMin, vMax), 0.5f);
+	DirectX::XMVECTOR vExtent = DirectX::XMVectorScale(DirectX::XMVectorSubtract(vMax, vMin), 0.5f);
+
+	// the center moves with the matrix, the extent grows by the absolute value of its 3x3 part
+	DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&a_Transform.Hierarchy->GetWorldMatrix(a_Transform.Node));
+	DirectX::XMVECTOR vWorldExtent = DirectX::XMVectorMultiply(DirectX::XMVectorSplatX(vExtent), DirectX::XMVectorAbs(world.r[0]));
+	vWorldExtent = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorSplatY(vExtent), DirectX::XMVectorAbs(world.r[1]), vWorldExtent);
+	vWorldExtent = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorSplatZ(vExtent), DirectX::XMVectorAbs(world.r[2]), vWorldExtent);
+
+	DirectX::XMStoreFloat3(&a_Bounds.Center, DirectX::XMVector3TransformCoord(vCenter, world));
+	DirectX::XMStoreFloat3(&a_Bounds.Extent, vWorldExtent);
+	a_Bounds.TransformVersion = uTransformVersion;
+	a_Bounds.MeshVersion = a_Render.Mesh->GetVersion();
+	a_Bounds.Valid = true;
+}
+
+/// <summary>
+/// Draws a mesh with a material, at the coarsest level of detail that still looks the same
+/// </summary>
+/// <param name="a_Mesh">Mesh to draw</param>
+/// <param name="a_Material">Material to draw it with</param>
+/// <param name="a_m4World">World matrix</param>
+/// <param name="a_m4WorldInverseTranspose">Normal matrix that goes with it</param>
+/// <param name="a_Camera">Camera to draw from</param>
+/// <param name="a_fTotalTime">Time since the game started</param>
+/// <returns>Level of detail drawn</returns>
+unsigned int DrawMesh(Mesh& a_Mesh, Material& a_Material, const DirectX::XMFLOAT4X4& a_m4World, const DirectX::XMFLOAT4X4& a_m4WorldInverseTranspose,
+	Camera& a_Camera, float a_fTotalTime)
+{
+	DirectX::XMFLOAT4X4 m4View = a_Camera.GetViewMatrix();
+	DirectX::XMFLOAT4X4 m4Projection = a_Camera.GetProjectionMatrix();
+	DirectX::XMFLOAT3 f3CameraPosition = a_Camera.GetTransform()->GetPosition();
+
+	a_Material.GetVertexShader()->SetShader();
+	a_Material.GetPixelShader()->SetShader();
+
+	//Collect data for the current entity in a C++ struct 
+	//a_Material.GetVertexShader()->SetFloat4("colorTint", a_Material.GetColorTint()); 
+	a_Material.GetVertexShader()->SetMatrix4x4("world", a_m4World);
+	a_Material.GetVertexShader()->SetMatrix4x4("worldInvTranspose", a_m4WorldInverseTranspose);
+	a_Material.GetVertexShader()->SetMatrix4x4("view", m4View); 
+	a_Material.GetVertexShader()->SetMatrix4x4("projection", m4Projection);
+	a_Mesh.SetDecodeParameters(a_Material.GetVertexShader());
+	PrepareDraw(a_Material, *a_Material.GetVertexShader(), f3CameraPosition, a_fTotalTime);
+
+	// pick the coarsest level of detail that still looks the same at this size on screen
+	unsigned int uLod = a_Mesh.SelectLod(a_m4World, m4View, m4Projection, (float)Window::Height(), LOD_MAX_PIXEL_ERROR);
+
+	//Set the correct Vertex and Index Buffers
+	//Tell D3D to render using the currently bound resources
+	//(large meshes at full resolution cull their clusters against the camera first)
+	if (uLod == 0)
+		a_Mesh.DrawClusters(a_m4World, m4View, m4Projection, f3CameraPosition);
+	else
+		a_Mesh.Draw(uLod);
+	return uLod;
+}
+
+/// <summary>
+/// Draws a level of detail of a mesh with a material once for each of a run of instances in the
+/// instance buffer, with the material's instanced vertex shader
 /// </summary>
-/// <param name="a_mMesh">Mesh of this entity</param>
+/// <param name="a_Mesh">Mesh to draw</param>
+/// <param name="a_Material">Material to draw it with; must have an instanced vertex shader</param>
+/// <param name="a_uLod">Level of detail to draw</param>
+/// <param name="a_uFirstInstance">First instance in the instance buffer</param>
+/// <param name="a_uInstanceCount">Number of instances to draw</param>
+/// <param name="a_Camera">Camera to draw from</param>
+/// <param name="a_fTotalTime">Time since the game started</param>
+void DrawMeshInstances(Mesh& a_Mesh, Material& a_Material, unsigned int a_uLod, unsigned int a_uFirstInstance, unsigned int a_uInstanceCount,
+	Camera& a_Camera, float a_fTotalTime)
+{
+	std::shared_ptr<SimpleVertexShader> spVertexShader = a_Material.GetInstancedVertexShader();
+	spVertexShader->SetShader();
+	a_Material.GetPixelShader()->SetShader();
+
+	// the world matrices come with the instances
+	spVertexShader->SetMatrix4x4("view", a_Camera.GetViewMatrix());
+	spVertexShader->SetMatrix4x4("projection", a_Camera.GetProjectionMatrix());
+	a_Mesh.SetDecodeParameters(spVertexShader);
+	PrepareDraw(a_Material, *spVertexShader, a_Camera.GetTransform()->GetPosition(), a_fTotalTime);
+
+	a_Mesh.DrawInstanced(a_uLod, a_uFirstInstance, a_uInstanceCount);
+}
+
+/// <summary>
+/// Draws an entity with its material, at the coarsest level of detail that still looks the same
+/// </summary>
+/// <param name="a_Transform">Entity's transform</param>
+/// <param name="a_Render">Entity's mesh and material</param>
+/// <param name="a_Lod">Receives the level of detail drawn</param>
+/// <param name="a_Camera">Camera to draw from</param>
+/// <param name="a_fTotalTime">Time since the game started</param>
+void DrawEntity(const EntityTransform& a_Transform, const EntityRender& a_Render, EntityLod& a_Lod, Camera& a_Camera, float a_fTotalTime)
+{
+	a_Lod.Lod = DrawMesh(*a_Render.Mesh, *a_Render.Material, a_Transform.Hierarchy->GetWorldMatrix(a_Transform.Node),
+		a_Transform.Hierarchy->GetWorldInverseTransposeMatrix(a_Transform.Node), a_Camera, a_fTotalTime);
+}
+
+/// <summary>
+/// Plays every entity's motion: bobbing, spinning and pulsing with the time
+/// </summary>
+/// <param name="a_World">World whose entities to move</param>
+/// <param name="a_fTotalTime">Time since the game started</param>
+void UpdateEntityMotion(EntityWorld& a_World, float a_fTotalTime)
+{
+	float fWave = sinf(a_fTotalTime);
+	a_World.ForEach(ComponentMaskOf<EntityTransform, EntityMotion>(), [fWave, a_fTotalTime](const EntityChunk& a_Chunk)
+	{
+		const EntityTransform* pTransforms = a_Chunk.Get<EntityTransform>();
+		const EntityMotion* pMotions = a_Chunk.Get<EntityMotion>();
+		for (uint32_t i = 0; i < a_Chunk.Count; i++)
+		{
+			Transform* pTransform = pTransforms[i].Transform;
+			const EntityMotion& motion = pMotions[i];
+			if (motion.Amplitude.x != 0.0f || motion.Amplitude.y != 0.0f || motion.Amplitude.z != 0.0f)
+			{
+				DirectX::XMFLOAT3 f3Position = pTransform->GetPosition();
+				pTransform->SetPosition(
+					Bob(f3Position.x, motion.Center.x, motion.Amplitude.x, fWave),
+					Bob(f3Position.y, motion.Center.y, motion.Amplitude.y, fWave),
+					Bob(f3Position.z, motion.Center.z, motion.Amplitude.z, fWave));
+			}
+			if (motion.Spin.x != 0.0f || motion.Spin.y != 0.0f || motion.Spin.z != 0.0f)
+				pTransform->SetRotation(
+					motion.Rotation.x + motion.Spin.x * a_fTotalTime,
+					motion.Rotation.y + motion.Spin.y * a_fTotalTime,
+					motion.Rotation.z + motion.Spin.z * a_fTotalTime);
+			if (motion.Pulse != 0.0f)
+			{
+				float fScale = 1.0f + motion.Pulse * fWave;
+				pTransform->SetScale(motion.Scale.x * fScale, motion.Scale.y * fScale, motion.Scale.z * fScale);
+			}
+		}
+	});
+}
+
+/// <summary>
+/// Creates a new entity with the given mesh and a default transform in the default world
+/// </summary>
+/// <param name="a_spMesh">Mesh of this entity</param>
+/// <param name="a_spMaterial">Material of this entity</param>
 Entity::Entity(std::shared_ptr<Mesh> a_spMesh, std::shared_ptr<Material> a_spMaterial)
+	: Entity(EntityWorld::GetDefault(), a_spMesh, a_spMaterial)
+{
+}
+
+/// <summary>
+/// Creates a new entity with the given mesh and a default transform
+/// </summary>
+/// <param name="a_spWorld">World the entity's components live in</param>
+/// <param name="a_spMesh">Mesh of this entity</param>
+/// <param name="a_spMaterial">Material of this entity</param>
+Entity::Entity(std::shared_ptr<EntityWorld> a_spWorld, std::shared_ptr<Mesh> a_spMesh, std::shared_ptr<Material> a_spMaterial)
 {
+	m_spWorld = a_spWorld;
 	m_spMesh = a_spMesh;
 	m_spTransform = std::make_shared<Transform>();
 	m_spMaterial = a_spMaterial;
+
+	m_uId = m_spWorld->Create(DrawnEntityMask());
+	*m_spWorld->Get<EntityTransform>(m_uId) = { m_spTransform.get(), m_spTransform->GetHierarchy().get(), m_spTransform->GetNode() };
+	*m_spWorld->Get<EntityRender>(m_uId) = { m_spMesh.get(), m_spMaterial.get() };
 }
 
-void Entity::Draw(std::shared_ptr<Camera> a_spCamera, float a_fTotalTime)
+Entity::~Entity()
 {
-	m_spMaterial->GetVertexShader()->SetShader();
-	m_spMaterial->GetPixelShader()->SetShader();
+	if (m_spWorld)
+		m_spWorld->Destroy(m_uId);
+}
 
-	//Collect data for the current entity in a C++ struct 
-	//m_spMaterial->GetVertexShader()->SetFloat4("colorTint", m_spMaterial->GetColorTint()); 
-	m_spMaterial->GetVertexShader()->SetMatrix4x4("world", m_spTransform->GetWorldMatrix());
-	m_spMaterial->GetVertexShader()->SetMatrix4x4("worldInvTranspose", m_spTransform->GetWorldInverseTransposeMatrix());
-	m_spMaterial->GetVertexShader()->SetMatrix4x4("view", a_spCamera->GetViewMatrix()); 
-	m_spMaterial->GetVertexShader()->SetMatrix4x4("projection", a_spCamera->GetProjectionMatrix());
-
-	m_spMaterial->GetPixelShader()->SetFloat4("colorTint", m_spMaterial->GetColorTint());
-	m_spMaterial->GetPixelShader()->SetFloat2("uvScale", m_spMaterial->GetUVScale());
-	m_spMaterial->GetPixelShader()->SetFloat2("uvOffset", m_spMaterial->GetUVOffset());
-	m_spMaterial->GetPixelShader()->SetFloat("roughness", m_spMaterial->GetRoughness());
-	m_spMaterial->GetPixelShader()->SetFloat3("cameraPos", a_spCamera->GetTransform()->GetPosition());
-	m_spMaterial->GetPixelShader()->SetFloat("totalTime", a_fTotalTime);
-	
-
-	//Map / memcpy / Unmap the Constant Buffer resource
-	m_spMaterial->GetVertexShader()->CopyAllBufferData();
-	m_spMaterial->GetPixelShader()->CopyAllBufferData();
-
-	// bind texture & sampler
-	m_spMaterial->PrepareMaterial();
+Entity::Entity(Entity&& a_Other) noexcept
+	: m_spWorld(std::move(a_Other.m_spWorld)), m_uId(a_Other.m_uId),
+	m_spTransform(std::move(a_Other.m_spTransform)), m_spMesh(std::move(a_Other.m_spMesh)), m_spMaterial(std::move(a_Other.m_spMaterial))
+{
+	a_Other.m_uId = ENTITY_NONE;
+}
 
-	//Set the correct Vertex and Index Buffers
-	//Tell D3D to render using the currently bound resources
-	m_spMesh->Draw();
+Entity& Entity::operator=(Entity&& a_Other) noexcept
+{
+	if (this != &a_Other)
+	{
+		if (m_spWorld)
+			m_spWorld->Destroy(m_uId);
+		m_spWorld = std::move(a_Other.m_spWorld);
+		m_uId = a_Other.m_uId;
+		m_spTransform = std::move(a_Other.m_spTransform);
+		m_spMesh = std::move(a_Other.m_spMesh);
+		m_spMaterial = std::move(a_Other.m_spMaterial);
+		a_Other.m_uId = ENTITY_NONE;
+	}
+	return *this;
+}
+
+void Entity::Draw(Camera& a_Camera, float a_fTotalTime)
+{
+	DrawEntity(*m_spWorld->Get<EntityTransform>(m_uId), *m_spWorld->Get<EntityRender>(m_uId), *m_spWorld->Get<EntityLod>(m_uId), a_Camera, a_fTotalTime);
+}
+
+/// <summary>
+/// Gets the entity's motion component, adding a still one if it has none yet
+/// </summary>
+EntityMotion* Entity::Motion()
+{
+	if (EntityMotion* pMotion = m_spWorld->Get<EntityMotion>(m_uId))
+		return pMotion;
+
+	EntityMotion* pMotion = m_spWorld->Add<EntityMotion>(m_uId);
+	pMotion->Center = m_spTransform->GetPosition();
+	pMotion->Rotation = m_spTransform->GetPitchYawRoll();
+	pMotion->Scale = m_spTransform->GetScale();
+	return pMotion;
 }
 
 #pragma region Getters
@@ -75,6 +306,43 @@ std::shared_ptr<Material> Entity::GetMaterial()
 {
 	return m_spMaterial;
 }
+/// <summary>
+/// Gets the level of detail the entity's mesh was last drawn with
+/// </summary>
+/// <returns>LOD index (0 is full resolution)</returns>
+unsigned int Entity::GetLod()
+{
+	return m_spWorld->Get<EntityLod>(m_uId)->Lod;
+}
+/// <summary>
+/// Gets the world-space box around the entity's mesh, only recomputing it when the
+/// transform or mesh changed since the last call (including a loaded mesh replacing its placeholder)
+/// </summary>
+/// <param name="a_f3Center">Receives the center of the box</param>
+/// <param name="a_f3Extent">Receives the half size of the box along each axis</param>
+void Entity::GetWorldBounds(DirectX::XMFLOAT3& a_f3Center, DirectX::XMFLOAT3& a_f3Extent)
+{
+	EntityBounds* pBounds = m_spWorld->Get<EntityBounds>(m_uId);
+	UpdateEntityBounds(*m_spWorld->Get<EntityTransform>(m_uId), *m_spWorld->Get<EntityRender>(m_uId), *pBounds);
+	a_f3Center = pBounds->Center;
+	a_f3Extent = pBounds->Extent;
+}
+/// <summary>
+/// Gets the world the entity's components live in
+/// </summary>
+/// <returns>World</returns>
+std::shared_ptr<EntityWorld> Entity::GetWorld()
+{
+	return m_spWorld;
+}
+/// <summary>
+/// Gets the entity's id in its world
+/// </summary>
+/// <returns>Id</returns>
+uint32_t Entity::GetId()
+{
+	return m_uId;
+}
 #pragma endregion
 #pragma region Setters
 /// <summary>
@@ -84,6 +352,8 @@ std::shared_ptr<Material> Entity::GetMaterial()
 void Entity::SetMesh(std::shared_ptr<Mesh> a_spMesh)
 {
 	m_spMesh = a_spMesh;
+	m_spWorld->Get<EntityRender>(m_uId)->Mesh = m_spMesh.get();
+	m_spWorld->Get<EntityBounds>(m_uId)->Valid = false;
 }
 /// <summary>
 /// Sets the entity's transform to the given transform
@@ -92,6 +362,8 @@ void Entity::SetMesh(std::shared_ptr<Mesh> a_spMesh)
 void Entity::SetTransform(std::shared_ptr<Transform> a_spTransform)
 {
 	m_spTransform = a_spTransform;
+	*m_spWorld->Get<EntityTransform>(m_uId) = { m_spTransform.get(), m_spTransform->GetHierarchy().get(), m_spTransform->GetNode() };
+	m_spWorld->Get<EntityBounds>(m_uId)->Valid = false;
 }
 /// <summary>
 /// Sets the entity's material to the given material
@@ -100,6 +372,34 @@ void Entity::SetTransform(std::shared_ptr<Transform> a_spTransform)
 void Entity::setMaterial(std::shared_ptr<Material> a_spMaterial)
 {
 	m_spMaterial = a_spMaterial;
+	m_spWorld->Get<EntityRender>(m_uId)->Material = m_spMaterial.get();
+}
+/// <summary>
+/// Makes the entity bob around where it is now with the sine of the time
+/// </summary>
+/// <param name="a_f3Amplitude">How far it moves along each axis</param>
+void Entity::SetBob(DirectX::XMFLOAT3 a_f3Amplitude)
+{
+	Motion()->Amplitude = a_f3Amplitude;
+}
+/// <summary>
+/// Makes the entity turn at a constant rate
+/// </summary>
+/// <param name="a_f3Rotation">Pitch, yaw and roll at time 0</param>
+/// <param name="a_f3Spin">Radians per second added to each</param>
+void Entity::SetSpin(DirectX::XMFLOAT3 a_f3Rotation, DirectX::XMFLOAT3 a_f3Spin)
+{
+	EntityMotion* pMotion = Motion();
+	pMotion->Rotation = a_f3Rotation;
+	pMotion->Spin = a_f3Spin;
+}
+/// <summary>
+/// Makes the entity grow and shrink around its current scale with the sine of the time
+/// </summary>
+/// <param name="a_fPulse">Fraction of the scale it changes by</param>
+void Entity::SetPulse(float a_fPulse)
+{
+	Motion()->Pulse = a_fPulse;
 }
 #pragma endregion
 
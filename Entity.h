@@ -5,25 +5,104 @@
 #include "Mesh.h"
 #include "Camera.h"
 #include "Material.h"
+#include "EntityWorld.h"
 
+// How many pixels the simplified surface of a level of detail may be off by on screen
+#define LOD_MAX_PIXEL_ERROR 1.0f
+
+// --------------------------------------------------------
+// Components of the entities the game draws. The pointers
+// are kept alive by the Entity that owns the components.
+// --------------------------------------------------------
+struct EntityTransform
+{
+	::Transform* Transform;
+	TransformHierarchy* Hierarchy;	// the transform's, so reading world matrices skips a pointer
+	uint32_t Node;
+};
+struct EntityRender
+{
+	::Mesh* Mesh;
+	::Material* Material;
+};
+struct EntityLod
+{
+	unsigned int Lod;	// level of detail of the mesh at the last draw
+};
+// world-space box around the mesh, cached until the transform or mesh changes
+struct EntityBounds
+{
+	DirectX::XMFLOAT3 Center;
+	DirectX::XMFLOAT3 Extent;
+	unsigned int TransformVersion;	// transform version the box was computed at
+	unsigned int MeshVersion;		// mesh version the box was computed at
+	bool Valid;
+};
+// the animation Game::Update plays on an entity
+struct EntityMotion
+{
+	DirectX::XMFLOAT3 Center;		// position it bobs around
+	DirectX::XMFLOAT3 Amplitude;	// how far it bobs along each axis with the sine of the time; axes with 0 are left alone
+	DirectX::XMFLOAT3 Rotation;		// pitch/yaw/roll at time 0
+	DirectX::XMFLOAT3 Spin;			// radians per second added to the rotation; all 0 leaves the rotation alone
+	DirectX::XMFLOAT3 Scale;		// scale it pulses around
+	float Pulse;					// fraction of the scale it grows and shrinks by; 0 leaves the scale alone
+};
+
+// the components every drawn entity has
+ComponentMask DrawnEntityMask();
+
+void UpdateEntityBounds(const EntityTransform& a_Transform, const EntityRender& a_Render, EntityBounds& a_Bounds);
+unsigned int DrawMesh(Mesh& a_Mesh, Material& a_Material, const DirectX::XMFLOAT4X4& a_m4World, const DirectX::XMFLOAT4X4& a_m4WorldInverseTranspose,
+	Camera& a_Camera, float a_fTotalTime);
+void DrawMeshInstances(Mesh& a_Mesh, Material& a_Material, unsigned int a_uLod, unsigned int a_uFirstInstance, unsigned int a_uInstanceCount,
+	Camera& a_Camera, float a_fTotalTime);
+void DrawEntity(const EntityTransform& a_Transform, const EntityRender& a_Render, EntityLod& a_Lod, Camera& a_Camera, float a_fTotalTime);
+void UpdateEntityMotion(EntityWorld& a_World, float a_fTotalTime);
+
+// --------------------------------------------------------
+// An entity of an EntityWorld with a transform, mesh and
+// material. It owns what the components point to and
+// destroys the entity with itself; the per-frame work goes
+// over the world's chunks rather than through this.
+// --------------------------------------------------------
 class Entity
 {
 public:
 	Entity(std::shared_ptr<Mesh> a_spMesh, std::shared_ptr<Material> a_spMaterial);
+	Entity(std::shared_ptr<EntityWorld> a_spWorld, std::shared_ptr<Mesh> a_spMesh, std::shared_ptr<Material> a_spMaterial);
+	~Entity();
+	Entity(Entity&& a_Other) noexcept;
+	Entity& operator=(Entity&& a_Other) noexcept;
+	Entity(const Entity&) = delete;
+	Entity& operator=(const Entity&) = delete;
 
-	void Draw(std::shared_ptr<Camera> a_spCamera, float a_fTotalTime);
+	void Draw(Camera& a_Camera, float a_fTotalTime);
 
 	// Getters
 	std::shared_ptr<Mesh> GetMesh();
 	std::shared_ptr<Transform> GetTransform();
 	std::shared_ptr<Material> GetMaterial();
+	unsigned int GetLod();
+	void GetWorldBounds(DirectX::XMFLOAT3& a_f3Center, DirectX::XMFLOAT3& a_f3Extent);
+	std::shared_ptr<EntityWorld> GetWorld();
+	uint32_t GetId();
 
 	// Setters
 	void SetMesh(std::shared_ptr<Mesh> a_spMesh);
 	void SetTransform(std::shared_ptr<Transform> a_spTransform);
 	void setMaterial(std::shared_ptr<Material> a_spMaterial);
+	void SetBob(DirectX::XMFLOAT3 a_f3Amplitude);
+	void SetSpin(DirectX::XMFLOAT3 a_f3Rotation, DirectX::XMFLOAT3 a_f3Spin);
+	void SetPulse(float a_fPulse);
 private:
+	std::shared_ptr<EntityWorld> m_spWorld;
+	uint32_t m_uId;
+
+	// owners of what the components point to
 	std::shared_ptr<Transform> m_spTransform;
 	std::shared_ptr<Mesh> m_spMesh;
 	std::shared_ptr<Material> m_spMaterial;
-};
\ No newline at end of file
+
+	EntityMotion* Motion();
+};
@@ -0,0 +1,519 @@
+#include "EntityWorld.h"
+#include <DirectXMath.h>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+	// size of every component type, by its bit
+	std::vector<size_t>& ComponentTypeSizes()
+	{
+		static std::vector<size_t> s_vSizes;
+		return s_vSizes;
+	}
+	std::mutex& ComponentTypeMutex()
+	{
+		static std::mutex s_Mutex;
+		return s_Mutex;
+	}
+
+	uint8_t* AllocateChunk(size_t a_uBytes)
+	{
+		return (uint8_t*)::operator new(a_uBytes, std::align_val_t(ENTITY_CHUNK_ALIGNMENT));
+	}
+	void FreeChunk(uint8_t* a_pChunk)
+	{
+		::operator delete(a_pChunk, std::align_val_t(ENTITY_CHUNK_ALIGNMENT));
+	}
+
+	size_t AlignUp(size_t a_uBytes)
+	{
+		return (a_uBytes + ENTITY_CHUNK_ALIGNMENT - 1) & ~(size_t)(ENTITY_CHUNK_ALIGNMENT - 1);
+	}
+
+	// --------------------------------------------------------
+	// Parts of an entity the way the benchmark compares with:
+	// each allocated on its own and shared through shared_ptrs
+	// that the getters hand out by value
+	// --------------------------------------------------------
+	struct PointerTransform
+	{
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 Velocity;
+		bool Moving;
+	};
+	struct PointerMesh
+	{
+		DirectX::XMFLOAT3 Extent;
+		uint32_t Id;
+	};
+	struct PointerMaterial
+	{
+		DirectX::XMFLOAT4 Tint;
+		uint32_t Id;
+	};
+	struct PointerEntity
+	{
+		std::shared_ptr<PointerTransform> Transform;
+		std::shared_ptr<PointerMesh> Mesh;
+		std::shared_ptr<PointerMaterial> Material;
+		DirectX::XMFLOAT3 Center; //cached world bounds, like Entity kept
+
+		std::shared_ptr<PointerTransform> GetTransform() { return Transform; }
+		std::shared_ptr<PointerMesh> GetMesh() { return Mesh; }
+		std::shared_ptr<PointerMaterial> GetMaterial() { return Material; }
+	};
+
+	// the benchmark's components
+	struct BenchmarkPosition
+	{
+		DirectX::XMFLOAT3 Position;
+	};
+	struct BenchmarkVelocity
+	{
+		DirectX::XMFLOAT3 Velocity;
+	};
+	struct BenchmarkBounds
+	{
+		DirectX::XMFLOAT3 Center;
+		DirectX::XMFLOAT3 Extent;
+	};
+	struct BenchmarkRender
+	{
+		uint32_t Mesh;
+		uint32_t Material;
+	};
+	struct BenchmarkTint
+	{
+		DirectX::XMFLOAT4 Tint;
+	};
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point a_tpStart)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - a_tpStart).count();
+	}
+}
+
+/// <summary>
+/// Gives a component type the next free bit
+/// </summary>
+/// <param name="a_uSize">Bytes one component takes</param>
+/// <returns>The type's bit</returns>
+uint32_t RegisterComponentType(size_t a_uSize)
+{
+	std::lock_guard<std::mutex> lock(ComponentTypeMutex());
+	std::vector<size_t>& vSizes = ComponentTypeSizes();
+	if (vSizes.size() >= ENTITY_MAX_COMPONENT_TYPES)
+		throw std::length_error("more component types than ENTITY_MAX_COMPONENT_TYPES");
+	vSizes.push_back(a_uSize);
+	return (uint32_t)vSizes.size() - 1;
+}
+
+/// <summary>
+/// Gets the bytes one component of a type takes
+/// </summary>
+size_t GetComponentTypeSize(uint32_t a_uType)
+{
+	std::lock_guard<std::mutex> lock(ComponentTypeMutex());
+	return ComponentTypeSizes()[a_uType];
+}
+
+EntityWorld::EntityWorld()
+{
+}
+
+EntityWorld::~EntityWorld()
+{
+	for (EntityArchetype& archetype : m_vArchetypes)
+		for (uint8_t* pChunk : archetype.Chunks)
+			FreeChunk(pChunk);
+}
+
+/// <summary>
+/// Gets the world entities are created in by default
+/// </summary>
+std::shared_ptr<EntityWorld> EntityWorld::GetDefault()
+{
+	static std::shared_ptr<EntityWorld> spDefault = std::make_shared<EntityWorld>();
+	return spDefault;
+}
+
+/// <summary>
+/// Adds an entity with the given components, all zeroed
+/// </summary>
+/// <param name="a_Components">Mask of the entity's components</param>
+/// <returns>Id of the entity</returns>
+uint32_t EntityWorld::Create(ComponentMask a_Components)
+{
+	uint32_t uEntity;
+	if (!m_vFreeEntities.empty())
+	{
+		uEntity = m_vFreeEntities.back();
+		m_vFreeEntities.pop_back();
+	}
+	else
+	{
+		uEntity = (uint32_t)m_vArchetypeOf.size();
+		m_vArchetypeOf.push_back(ENTITY_NONE);
+		m_vRowOf.push_back(0);
+	}
+
+	uint32_t uArchetype = FindArchetype(a_Components);
+	m_vRowOf[uEntity] = Append(uArchetype, uEntity);
+	m_vArchetypeOf[uEntity] = uArchetype;
+	return uEntity;
+}
+
+/// <summary>
+/// Removes an entity; its id may be given out again
+/// </summary>
+/// <param name="a_uEntity">Entity to remove</param>
+void EntityWorld::Destroy(uint32_t a_uEntity)
+{
+	if (!IsAlive(a_uEntity))
+		return;
+
+	Remove(m_vArchetypeOf[a_uEntity], m_vRowOf[a_uEntity]);
+	m_vArchetypeOf[a_uEntity] = ENTITY_NONE;
+	m_vFreeEntities.push_back(a_uEntity);
+}
+
+/// <summary>
+/// Gives an entity more components (zeroed), moving it to the archetype with them
+/// </summary>
+/// <param name="a_uEntity">Entity to change</param>
+/// <param name="a_Components">Mask of the components to add; ones it already has keep their values</param>
+void EntityWorld::AddComponents(uint32_t a_uEntity, ComponentMask a_Components)
+{
+	Move(a_uEntity, GetComponents(a_uEntity) | a_Components);
+}
+
+/// <summary>
+/// Takes components away from an entity, moving it to the archetype without them
+/// </summary>
+/// <param name="a_uEntity">Entity to change</param>
+/// <param name="a_Components">Mask of the components to remove</param>
+void EntityWorld::RemoveComponents(uint32_t a_uEntity, ComponentMask a_Components)
+{
+	Move(a_uEntity, GetComponents(a_uEntity) & ~a_Components);
+}
+
+/// <summary>
+/// Finds the archetype of a set of components, laying out its chunks the first time: the entity ids,
+/// then each component's array in the order of their bits, each on its own cache line
+/// </summary>
+uint32_t EntityWorld::FindArchetype(ComponentMask a_Components)
+{
+	auto it = m_htArchetypes.find(a_Components);
+	if (it != m_htArchetypes.end())
+		return it->second;
+
+	EntityArchetype archetype = {};
+	archetype.Mask = a_Components;
+	size_t uRowBytes = sizeof(uint32_t);
+	size_t uArrays = 1;
+	for (uint32_t t = 0; t < ENTITY_MAX_COMPONENT_TYPES; t++)
+		if (a_Components & (ComponentMask(1) << t))
+		{
+			archetype.Sizes[t] = (uint32_t)GetComponentTypeSize(t);
+			uRowBytes += archetype.Sizes[t];
+			uArrays++;
+		}
+
+	// every array may waste up to a cache line to its alignment; oversized entities get a larger chunk of one
+	size_t uPadding = uArrays * ENTITY_CHUNK_ALIGNMENT;
+	archetype.Capacity = (uint32_t)(std::max)((size_t)1, (ENTITY_CHUNK_BYTES - (std::min)(uPadding, (size_t)ENTITY_CHUNK_BYTES)) / uRowBytes);
+	size_t uOffset = archetype.Capacity * sizeof(uint32_t);
+	for (uint32_t t = 0; t < ENTITY_MAX_COMPONENT_TYPES; t++)
+		if (a_Components & (ComponentMask(1) << t))
+		{
+			uOffset = AlignUp(uOffset);
+			archetype.Offsets[t] = (uint32_t)uOffset;
+			uOffset += archetype.Capacity * archetype.Sizes[t];
+		}
+	archetype.ChunkBytes = (std::max)((size_t)ENTITY_CHUNK_BYTES, AlignUp(uOffset));
+
+	m_vArchetypes.push_back(archetype);
+	uint32_t uArchetype = (uint32_t)m_vArchetypes.size() - 1;
+	m_htArchetypes[a_Components] = uArchetype;
+	return uArchetype;
+}
+
+/// <summary>
+/// Adds a row with zeroed components at the end of an archetype, starting a chunk if the last one is full
+/// </summary>
+/// <returns>The row</returns>
+uint32_t EntityWorld::Append(uint32_t a_uArchetype, uint32_t a_uEntity)
+{
+	EntityArchetype& archetype = m_vArchetypes[a_uArchetype];
+	uint32_t uRow = archetype.Count;
+	if (uRow == archetype.Chunks.size() * archetype.Capacity)
+		archetype.Chunks.push_back(AllocateChunk(archetype.ChunkBytes));
+
+	uint8_t* pChunk = archetype.Chunks[uRow / archetype.Capacity];
+	uint32_t uIndex = uRow % archetype.Capacity;
+	((uint32_t*)pChunk)[uIndex] = a_uEntity;
+	for (uint32_t t = 0; t < ENTITY_MAX_COMPONENT_TYPES; t++)
+		if (archetype.Mask & (ComponentMask(1) << t))
+		{
+			size_t uSize = archetype.Sizes[t];
+			memset(pChunk + archetype.Offsets[t] + uIndex * uSize, 0, uSize);
+		}
+	archetype.Count++;
+	return uRow;
+}
+
+/// <summary>
+/// Removes a row of an archetype by moving its last row into it, and frees the last chunk once it's empty
+/// </summary>
+void EntityWorld::Remove(uint32_t a_uArchetype, uint32_t a_uRow)
+{
+	EntityArchetype& archetype = m_vArchetypes[a_uArchetype];
+	uint32_t uLast = archetype.Count - 1;
+	if (a_uRow != uLast)
+	{
+		uint8_t* pTo = archetype.Chunks[a_uRow / archetype.Capacity];
+		uint8_t* pFrom = archetype.Chunks[uLast / archetype.Capacity];
+		uint32_t uTo = a_uRow % archetype.Capacity;
+		uint32_t uFrom = uLast % archetype.Capacity;
+		uint32_t uMoved = ((uint32_t*)pFrom)[uFrom];
+		((uint32_t*)pTo)[uTo] = uMoved;
+		for (uint32_t t = 0; t < ENTITY_MAX_COMPONENT_TYPES; t++)
+			if (archetype.Mask & (ComponentMask(1) << t))
+			{
+				size_t uSize = archetype.Sizes[t];
+				memcpy(pTo + archetype.Offsets[t] + uTo * uSize, pFrom + archetype.Offsets[t] + uFrom * uSize, uSize);
+			}
+		m_vRowOf[uMoved] = a_uRow;
+	}
+
+	archetype.Count--;
+	if (archetype.Count == (archetype.Chunks.size() - 1) * archetype.Capacity)
+	{
+		FreeChunk(archetype.Chunks.back());
+		archetype.Chunks.pop_back();
+	}
+}
+
+/// <summary>
+/// Moves an entity to the archetype of a new set of components, copying the ones both have
+/// </summary>
+void EntityWorld::Move(uint32_t a_uEntity, ComponentMask a_Components)
+{
+	uint32_t uOld = m_vArchetypeOf[a_uEntity];
+	if (m_vArchetypes[uOld].Mask == a_Components)
+		return;
+
+	uint32_t uNew = FindArchetype(a_Components);
+	uint32_t uOldRow = m_vRowOf[a_uEntity];
+	uint32_t uNewRow = Append(uNew, a_uEntity);
+
+	const EntityArchetype& from = m_vArchetypes[uOld];
+	const EntityArchetype& to = m_vArchetypes[uNew];
+	uint8_t* pFrom = from.Chunks[uOldRow / from.Capacity];
+	uint8_t* pTo = to.Chunks[uNewRow / to.Capacity];
+	uint32_t uFrom = uOldRow % from.Capacity;
+	uint32_t uTo = uNewRow % to.Capacity;
+	ComponentMask shared = from.Mask & to.Mask;
+	for (uint32_t t = 0; t < ENTITY_MAX_COMPONENT_TYPES; t++)
+		if (shared & (ComponentMask(1) << t))
+		{
+			size_t uSize = to.Sizes[t];
+			memcpy(pTo + to.Offsets[t] + uTo * uSize, pFrom + from.Offsets[t] + uFrom * uSize, uSize);
+		}
+
+	Remove(uOld, uOldRow);
+	m_vArchetypeOf[a_uEntity] = uNew;
+	m_vRowOf[a_uEntity] = uNewRow;
+}
+
+/// <summary>
+/// Finds one of an entity's components in its chunk
+/// </summary>
+/// <returns>The component, nullptr if the entity doesn't have it</returns>
+void* EntityWorld::ComponentOf(uint32_t a_uEntity, uint32_t a_uType)
+{
+	const EntityArchetype& archetype = m_vArchetypes[m_vArchetypeOf[a_uEntity]];
+	if (!(archetype.Mask & (ComponentMask(1) << a_uType)))
+		return nullptr;
+	uint32_t uRow = m_vRowOf[a_uEntity];
+	return archetype.Chunks[uRow / archetype.Capacity] + archetype.Offsets[a_uType] + (uRow % archetype.Capacity) * archetype.Sizes[a_uType];
+}
+
+#pragma region Getters
+/// <summary>
+/// Gets whether an id belongs to an entity that hasn't been destroyed
+/// </summary>
+bool EntityWorld::IsAlive(uint32_t a_uEntity)
+{
+	return a_uEntity < m_vArchetypeOf.size() && m_vArchetypeOf[a_uEntity] != ENTITY_NONE;
+}
+
+/// <summary>
+/// Gets the mask of an entity's components
+/// </summary>
+ComponentMask EntityWorld::GetComponents(uint32_t a_uEntity)
+{
+	return m_vArchetypes[m_vArchetypeOf[a_uEntity]].Mask;
+}
+
+/// <summary>
+/// Gets how many entities a query with the given components visits
+/// </summary>
+uint32_t EntityWorld::GetCount(ComponentMask a_Components)
+{
+	uint32_t uCount = 0;
+	for (const EntityArchetype& archetype : m_vArchetypes)
+		if ((archetype.Mask & a_Components) == a_Components)
+			uCount += archetype.Count;
+	return uCount;
+}
+
+/// <summary>
+/// Gets how many entities, archetypes and chunks the world holds
+/// </summary>
+EntityWorldStats EntityWorld::GetStats()
+{
+	EntityWorldStats stats = {};
+	for (const EntityArchetype& archetype : m_vArchetypes)
+	{
+		stats.Entities += archetype.Count;
+		stats.Chunks += (unsigned int)archetype.Chunks.size();
+		stats.Bytes += archetype.Chunks.size() * archetype.ChunkBytes;
+	}
+	stats.Archetypes = (unsigned int)m_vArchetypes.size();
+	return stats;
+}
+#pragma endregion
+
+/// <summary>
+/// Times a read-only pass and a moving pass over a_uEntities entities, once stored in an
+/// EntityWorld and once as objects holding shared_ptrs to their separately allocated parts
+/// </summary>
+/// <param name="a_uEntities">How many entities</param>
+/// <param name="a_uSeed">Seed of the random scene</param>
+/// <returns>Best time of each pass</returns>
+EntityWorldBenchmark BenchmarkEntityWorld(unsigned int a_uEntities, unsigned int a_uSeed)
+{
+	const uint32_t MESHES = 64;
+	const uint32_t MATERIALS = 16;
+	const float DELTA_TIME = 1.0f / 60.0f;
+
+	// a quarter of the entities stand still, and a third of the moving ones carry an extra component,
+	// so the queries cross three archetypes created in random order
+	std::mt19937 random(a_uSeed);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> velocity(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 2.0f);
+	std::uniform_int_distribution<uint32_t> kind(0, 11);
+	std::vector<PointerMesh> vMeshes(MESHES);
+	for (uint32_t i = 0; i < MESHES; i++)
+		vMeshes[i] = { DirectX::XMFLOAT3(extent(random), extent(random), extent(random)), i };
+
+	EntityWorld world;
+	ComponentMask still = ComponentMaskOf<BenchmarkPosition, BenchmarkBounds, BenchmarkRender>();
+	ComponentMask moving = still | ComponentMaskOf<BenchmarkVelocity>();
+	ComponentMask tinted = moving | ComponentMaskOf<BenchmarkTint>();
+	std::vector<PointerEntity> vPointerEntities(a_uEntities);
+	std::vector<std::shared_ptr<PointerMesh>> vPointerMeshes(MESHES);
+	std::vector<std::shared_ptr<PointerMaterial>> vPointerMaterials(MATERIALS);
+	for (uint32_t i = 0; i < MESHES; i++)
+		vPointerMeshes[i] = std::make_shared<PointerMesh>(vMeshes[i]);
+	for (uint32_t i = 0; i < MATERIALS; i++)
+		vPointerMaterials[i] = std::make_shared<PointerMaterial>(PointerMaterial{ DirectX::XMFLOAT4(1, 1, 1, 1), i });
+	for (unsigned int i = 0; i < a_uEntities; i++)
+	{
+		uint32_t uKind = kind(random);
+		DirectX::XMFLOAT3 f3Position(position(random), position(random), position(random));
+		DirectX::XMFLOAT3 f3Velocity = uKind < 3 ? DirectX::XMFLOAT3(0, 0, 0) : DirectX::XMFLOAT3(velocity(random), velocity(random), velocity(random));
+		uint32_t uMesh = i % MESHES;
+		uint32_t uMaterial = i % MATERIALS;
+
+		uint32_t uEntity = world.Create(uKind < 3 ? still : uKind < 6 ? tinted : moving);
+		world.Get<BenchmarkPosition>(uEntity)->Position = f3Position;
+		if (BenchmarkVelocity* pVelocity = world.Get<BenchmarkVelocity>(uEntity))
+			pVelocity->Velocity = f3Velocity;
+		if (BenchmarkTint* pTint = world.Get<BenchmarkTint>(uEntity))
+			pTint->Tint = DirectX::XMFLOAT4(1, 1, 1, 1);
+		*world.Get<BenchmarkBounds>(uEntity) = { f3Position, vMeshes[uMesh].Extent };
+		*world.Get<BenchmarkRender>(uEntity) = { uMesh, uMaterial };
+
+		PointerEntity& e = vPointerEntities[i];
+		e.Transform = std::make_shared<PointerTransform>(PointerTransform{ f3Position, f3Velocity, uKind >= 3 });
+		e.Mesh = vPointerMeshes[uMesh];
+		e.Material = vPointerMaterials[uMaterial];
+		e.Center = f3Position;
+	}
+
+	EntityWorldBenchmark result = {};
+	EntityWorldStats stats = world.GetStats();
+	result.Entities = a_uEntities;
+	result.Archetypes = stats.Archetypes;
+	result.Chunks = stats.Chunks;
+	result.IterateMilliseconds = result.UpdateMilliseconds = result.PointerIterateMilliseconds = result.PointerUpdateMilliseconds = 1e30;
+
+	// the read-only pass adds up the render ids of the entities whose box reaches above the ground (without
+	// branching, which would time mispredictions instead), a sum of whole numbers the visiting order can't change
+	double dPointerChecksum = 0.0;
+	for (int run = 0; run < ENTITY_WORLD_BENCHMARK_RUNS; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		world.ForEach(ComponentMaskOf<BenchmarkPosition, BenchmarkVelocity, BenchmarkBounds>(), [&](const EntityChunk& a_Chunk)
+		{
+			BenchmarkPosition* pPositions = a_Chunk.Get<BenchmarkPosition>();
+			const BenchmarkVelocity* pVelocities = a_Chunk.Get<BenchmarkVelocity>();
+			BenchmarkBounds* pBounds = a_Chunk.Get<BenchmarkBounds>();
+			for (uint32_t i = 0; i < a_Chunk.Count; i++)
+			{
+				pPositions[i].Position.x += pVelocities[i].Velocity.x * DELTA_TIME;
+				pPositions[i].Position.y += pVelocities[i].Velocity.y * DELTA_TIME;
+				pPositions[i].Position.z += pVelocities[i].Velocity.z * DELTA_TIME;
+				pBounds[i].Center = pPositions[i].Position;
+			}
+		});
+		result.UpdateMilliseconds = (std::min)(result.UpdateMilliseconds, MillisecondsSince(start));
+
+		start = std::chrono::high_resolution_clock::now();
+		double dChecksum = 0.0;
+		world.ForEach(ComponentMaskOf<BenchmarkBounds, BenchmarkRender>(), [&](const EntityChunk& a_Chunk)
+		{
+			const BenchmarkBounds* pBounds = a_Chunk.Get<BenchmarkBounds>();
+			const BenchmarkRender* pRender = a_Chunk.Get<BenchmarkRender>();
+			uint64_t uSum = 0;
+			for (uint32_t i = 0; i < a_Chunk.Count; i++)
+				uSum += (uint64_t)(pBounds[i].Center.y + pBounds[i].Extent.y > 0.0f) * (pRender[i].Mesh + pRender[i].Material);
+			dChecksum += (double)uSum;
+		});
+		result.IterateMilliseconds = (std::min)(result.IterateMilliseconds, MillisecondsSince(start));
+		result.Checksum = dChecksum;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (PointerEntity& e : vPointerEntities)
+		{
+			std::shared_ptr<PointerTransform> spTransform = e.GetTransform();
+			if (!spTransform->Moving)
+				continue;
+			spTransform->Position.x += spTransform->Velocity.x * DELTA_TIME;
+			spTransform->Position.y += spTransform->Velocity.y * DELTA_TIME;
+			spTransform->Position.z += spTransform->Velocity.z * DELTA_TIME;
+			e.Center = spTransform->Position;
+		}
+		result.PointerUpdateMilliseconds = (std::min)(result.PointerUpdateMilliseconds, MillisecondsSince(start));
+
+		start = std::chrono::high_resolution_clock::now();
+		uint64_t uPointerSum = 0;
+		for (PointerEntity& e : vPointerEntities)
+			uPointerSum += (uint64_t)(e.Center.y + e.GetMesh()->Extent.y > 0.0f) * (e.GetMesh()->Id + e.GetMaterial()->Id);
+		result.PointerIterateMilliseconds = (std::min)(result.PointerIterateMilliseconds, MillisecondsSince(start));
+		dPointerChecksum = (double)uPointerSum;
+	}
+
+	// both layouts saw the same scene, unless one of them is broken
+	if (dPointerChecksum != result.Checksum)
+		result.Checksum = -1.0;
+	return result;
+}
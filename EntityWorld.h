@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Entity id of no entity
+#define ENTITY_NONE 0xFFFFFFFFu
+
+// Bytes of one chunk of an archetype; a chunk holds as many of its entities as fit
+#define ENTITY_CHUNK_BYTES (16 * 1024)
+
+// Every chunk and every component array in it starts on a cache line
+#define ENTITY_CHUNK_ALIGNMENT 64
+
+// Component types a program can have (one bit each in a ComponentMask)
+#define ENTITY_MAX_COMPONENT_TYPES 64
+
+// Times each case of BenchmarkEntityWorld runs (the best run counts)
+#define ENTITY_WORLD_BENCHMARK_RUNS 5
+
+// One bit per component type
+typedef uint64_t ComponentMask;
+
+// Gives a component type the next free bit; use ComponentTypeOf instead
+uint32_t RegisterComponentType(size_t a_uSize);
+size_t GetComponentTypeSize(uint32_t a_uType);
+
+/// <summary>
+/// Gets the bit of a component type, assigning it the first time the type is asked for.
+/// Components are plain data: they are moved between chunks with memcpy and start zeroed.
+/// </summary>
+template<typename T>
+uint32_t ComponentTypeOf()
+{
+	static_assert(std::is_trivially_copyable_v<T>, "components are moved with memcpy");
+	static_assert(alignof(T) <= ENTITY_CHUNK_ALIGNMENT, "component arrays are only aligned to a cache line");
+	static const uint32_t s_uType = RegisterComponentType(sizeof(T));
+	return s_uType;
+}
+
+/// <summary>
+/// Gets the mask of a set of component types
+/// </summary>
+template<typename... T>
+ComponentMask ComponentMaskOf()
+{
+	return (ComponentMask(0) | ... | (ComponentMask(1) << ComponentTypeOf<T>()));
+}
+
+// --------------------------------------------------------
+// Every entity with exactly the same set of components.
+// Its entities are packed into chunks, each chunk holding
+// one array of entity ids and one array per component; all
+// chunks but the last are full.
+// --------------------------------------------------------
+struct EntityArchetype
+{
+	ComponentMask Mask;
+	uint32_t Capacity;	// entities per chunk
+	uint32_t Count;		// entities in all of its chunks
+	uint32_t Offsets[ENTITY_MAX_COMPONENT_TYPES];	// where each component's array starts in a chunk (the ids start at 0)
+	uint32_t Sizes[ENTITY_MAX_COMPONENT_TYPES];		// bytes of one of each of its components, 0 for the rest
+	size_t ChunkBytes;
+	std::vector<uint8_t*> Chunks;
+};
+
+// --------------------------------------------------------
+// One chunk as a query sees it: Count entities, with each
+// component the query asked for as a dense array
+// --------------------------------------------------------
+struct EntityChunk
+{
+	const EntityArchetype* Archetype;
+	uint8_t* Data;
+	uint32_t Count;
+
+	const uint32_t* GetEntities() const
+	{
+		return (const uint32_t*)Data;
+	}
+
+	// nullptr when the archetype doesn't have the component
+	template<typename T>
+	T* Get() const
+	{
+		uint32_t uType = ComponentTypeOf<T>();
+		if (!(Archetype->Mask & (ComponentMask(1) << uType)))
+			return nullptr;
+		return (T*)(Data + Archetype->Offsets[uType]);
+	}
+};
+
+// --------------------------------------------------------
+// How many entities, archetypes and chunks a world holds
+// --------------------------------------------------------
+struct EntityWorldStats
+{
+	unsigned int Entities;
+	unsigned int Archetypes;
+	unsigned int Chunks;
+	size_t Bytes;	// memory the chunks take
+};
+
+// --------------------------------------------------------
+// Result of BenchmarkEntityWorld
+// --------------------------------------------------------
+struct EntityWorldBenchmark
+{
+	unsigned int Entities;
+	unsigned int Archetypes;
+	unsigned int Chunks;
+	double IterateMilliseconds;			// read every entity's bounds and render ids
+	double UpdateMilliseconds;			// move every entity that has a velocity and its bounds with it
+	double PointerIterateMilliseconds;	// the same on entities that hold three shared_ptrs, the way Entity used to
+	double PointerUpdateMilliseconds;
+	double Checksum;					// what the read-only pass added up, -1 if the two layouts disagreed
+};
+
+// --------------------------------------------------------
+// Entities stored by archetype: each component lives in a
+// dense, cache-line aligned array inside fixed size chunks,
+// so a query walks matching chunks front to back instead of
+// following pointers. Adding or removing components moves an
+// entity to another archetype; destroying one moves the last
+// entity of its archetype into the hole, so chunks stay
+// packed. Entities are addressed by ids that survive these
+// moves. Don't create, destroy, add or remove components
+// inside ForEach. Main thread only.
+// --------------------------------------------------------
+class EntityWorld
+{
+public:
+	EntityWorld();
+	~EntityWorld();
+	EntityWorld(const EntityWorld&) = delete;
+	EntityWorld& operator=(const EntityWorld&) = delete;
+
+	// the world entities are created in unless they're given one
+	static std::shared_ptr<EntityWorld> GetDefault();
+
+	uint32_t Create(ComponentMask a_Components);
+	void Destroy(uint32_t a_uEntity);
+	void AddComponents(uint32_t a_uEntity, ComponentMask a_Components);
+	void RemoveComponents(uint32_t a_uEntity, ComponentMask a_Components);
+
+	/// <summary>
+	/// Gives an entity a component (zeroed if it didn't have it yet)
+	/// </summary>
+	template<typename T>
+	T* Add(uint32_t a_uEntity)
+	{
+		AddComponents(a_uEntity, ComponentMaskOf<T>());
+		return Get<T>(a_uEntity);
+	}
+
+	/// <summary>
+	/// Gets one of an entity's components; nullptr if it doesn't have it.
+	/// Valid until the next structural change.
+	/// </summary>
+	template<typename T>
+	T* Get(uint32_t a_uEntity)
+	{
+		return (T*)ComponentOf(a_uEntity, ComponentTypeOf<T>());
+	}
+
+	/// <summary>
+	/// Calls a_Function(EntityChunk&) for every chunk of every archetype that
+	/// has all of the given components, in the same order until the next structural change
+	/// </summary>
+	template<typename F>
+	void ForEach(ComponentMask a_Components, F&& a_Function)
+	{
+		for (EntityArchetype& archetype : m_vArchetypes)
+		{
+			if ((archetype.Mask & a_Components) != a_Components)
+				continue;
+			for (size_t c = 0; c < archetype.Chunks.size(); c++)
+			{
+				EntityChunk chunk;
+				chunk.Archetype = &archetype;
+				chunk.Data = archetype.Chunks[c];
+				chunk.Count = (std::min)(archetype.Capacity, archetype.Count - (uint32_t)c * archetype.Capacity);
+				a_Function(chunk);
+			}
+		}
+	}
+
+	// getters
+	bool IsAlive(uint32_t a_uEntity);
+	ComponentMask GetComponents(uint32_t a_uEntity);
+	uint32_t GetCount(ComponentMask a_Components);
+	EntityWorldStats GetStats();
+
+private:
+	std::vector<EntityArchetype> m_vArchetypes;
+	std::unordered_map<ComponentMask, uint32_t> m_htArchetypes; //index of the archetype of each mask
+
+	// where each entity id is
+	std::vector<uint32_t> m_vArchetypeOf; //ENTITY_NONE for free ids
+	std::vector<uint32_t> m_vRowOf; //index among its archetype's entities
+	std::vector<uint32_t> m_vFreeEntities;
+
+	uint32_t FindArchetype(ComponentMask a_Components);
+	uint32_t Append(uint32_t a_uArchetype, uint32_t a_uEntity);
+	void Remove(uint32_t a_uArchetype, uint32_t a_uRow);
+	void Move(uint32_t a_uEntity, ComponentMask a_Components);
+	void* ComponentOf(uint32_t a_uEntity, uint32_t a_uType);
+};
+
+// Times iterating and updating a_uEntities entities spread over a few archetypes, against the
+// same entities as objects holding shared_ptrs to separately allocated parts
+EntityWorldBenchmark BenchmarkEntityWorld(unsigned int a_uEntities, unsigned int a_uSeed = 1);
@@ -0,0 +1,267 @@
+#include "FrustumCulling.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Benchmark runs per implementation; the fastest one is reported
+	const int FRUSTUM_CULL_BENCHMARK_RUNS = 5;
+
+	/// <summary>
+	/// Normalizes a plane so its distances are in the units of its space
+	/// </summary>
+	void NormalizePlane(float a_pPlane[4])
+	{
+		float fLength = sqrtf(a_pPlane[0] * a_pPlane[0] + a_pPlane[1] * a_pPlane[1] + a_pPlane[2] * a_pPlane[2]);
+		if (fLength > 0.0f)
+			for (int k = 0; k < 4; k++)
+				a_pPlane[k] /= fLength;
+	}
+
+	/// <summary>
+	/// One box at a time version of CullBoundingBoxes, used as the benchmark's baseline
+	/// </summary>
+	FrustumCullStats CullBoundingBoxesScalar(uint8_t* a_pVisible, const BoundingBoxList& a_Boxes, const float a_pPlanes[6][4])
+	{
+		FrustumCullStats stats = {};
+		for (size_t i = 0; i < a_Boxes.Count; i++)
+		{
+			bool bInside = true;
+			for (int p = 0; p < 6 && bInside; p++)
+			{
+				// signed distance of the center against the box's projected radius on the plane normal
+				float fDistance = a_pPlanes[p][0] * a_Boxes.CenterX[i] + a_pPlanes[p][1] * a_Boxes.CenterY[i] +
+					a_pPlanes[p][2] * a_Boxes.CenterZ[i] + a_pPlanes[p][3];
+				float fRadius = fabsf(a_pPlanes[p][0]) * a_Boxes.ExtentX[i] + fabsf(a_pPlanes[p][1]) * a_Boxes.ExtentY[i] +
+					fabsf(a_pPlanes[p][2]) * a_Boxes.ExtentZ[i];
+				bInside = fDistance + fRadius >= 0.0f;
+			}
+			a_pVisible[i] = bInside ? 1 : 0;
+			if (bInside)
+				stats.Visible++;
+			else
+				stats.Culled++;
+		}
+		return stats;
+	}
+
+#if defined(__AVX__)
+	/// <summary>
+	/// Returns a bit per box of a batch starting at a_uFirst that is outside one of the planes
+	/// </summary>
+	int OutsideMask(const BoundingBoxList& a_Boxes, size_t a_uFirst, const float a_pPlanes[6][4])
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		__m256 cx = _mm256_loadu_ps(&a_Boxes.CenterX[a_uFirst]);
+		__m256 cy = _mm256_loadu_ps(&a_Boxes.CenterY[a_uFirst]);
+		__m256 cz = _mm256_loadu_ps(&a_Boxes.CenterZ[a_uFirst]);
+		__m256 ex = _mm256_loadu_ps(&a_Boxes.ExtentX[a_uFirst]);
+		__m256 ey = _mm256_loadu_ps(&a_Boxes.ExtentY[a_uFirst]);
+		__m256 ez = _mm256_loadu_ps(&a_Boxes.ExtentZ[a_uFirst]);
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 nx = _mm256_set1_ps(a_pPlanes[p][0]);
+			__m256 ny = _mm256_set1_ps(a_pPlanes[p][1]);
+			__m256 nz = _mm256_set1_ps(a_pPlanes[p][2]);
+
+			// distance + radius, with the radius taken along |normal|
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+				_mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(a_pPlanes[p][3])));
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex),
+				_mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)), _mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+		return _mm256_movemask_ps(outside);
+	}
+#else
+	/// <summary>
+	/// Returns a bit per box of a batch starting at a_uFirst that is outside one of the planes
+	/// (SSE2 only has four lanes, so the batch is tested as two halves sharing each plane)
+	/// </summary>
+	int OutsideMask(const BoundingBoxList& a_Boxes, size_t a_uFirst, const float a_pPlanes[6][4])
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 cx[2], cy[2], cz[2], ex[2], ey[2], ez[2], outside[2];
+		for (int h = 0; h < 2; h++)
+		{
+			size_t i = a_uFirst + h * 4;
+			cx[h] = _mm_loadu_ps(&a_Boxes.CenterX[i]);
+			cy[h] = _mm_loadu_ps(&a_Boxes.CenterY[i]);
+			cz[h] = _mm_loadu_ps(&a_Boxes.CenterZ[i]);
+			ex[h] = _mm_loadu_ps(&a_Boxes.ExtentX[i]);
+			ey[h] = _mm_loadu_ps(&a_Boxes.ExtentY[i]);
+			ez[h] = _mm_loadu_ps(&a_Boxes.ExtentZ[i]);
+			outside[h] = _mm_setzero_ps();
+		}
+
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 nx = _mm_set1_ps(a_pPlanes[p][0]);
+			__m128 ny = _mm_set1_ps(a_pPlanes[p][1]);
+			__m128 nz = _mm_set1_ps(a_pPlanes[p][2]);
+			__m128 w = _mm_set1_ps(a_pPlanes[p][3]);
+			__m128 ax = _mm_andnot_ps(signMask, nx);
+			__m128 ay = _mm_andnot_ps(signMask, ny);
+			__m128 az = _mm_andnot_ps(signMask, nz);
+
+			// distance + radius, with the radius taken along |normal|
+			for (int h = 0; h < 2; h++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx[h]), _mm_mul_ps(ny, cy[h])),
+					_mm_add_ps(_mm_mul_ps(nz, cz[h]), w));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ex[h]), _mm_mul_ps(ay, ey[h])), _mm_mul_ps(az, ez[h]));
+				outside[h] = _mm_or_ps(outside[h], _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			}
+		}
+		return _mm_movemask_ps(outside[0]) | (_mm_movemask_ps(outside[1]) << 4);
+	}
+#endif
+}
+
+/// <summary>
+/// Resizes the list, padding the arrays to a whole batch with empty boxes at the origin
+/// </summary>
+/// <param name="a_uCount">Number of boxes</param>
+void BoundingBoxList::Resize(size_t a_uCount)
+{
+	size_t uPadded = (a_uCount + FRUSTUM_CULL_BATCH - 1) / FRUSTUM_CULL_BATCH * FRUSTUM_CULL_BATCH;
+	for (std::vector<float>* pArray : { &CenterX, &CenterY, &CenterZ, &ExtentX, &ExtentY, &ExtentZ })
+		pArray->resize(uPadded, 0.0f);
+	Count = a_uCount;
+}
+
+/// <summary>
+/// Stores one box
+/// </summary>
+/// <param name="a_uIndex">Index of the box, less than Count</param>
+/// <param name="a_pCenter">Center of the box</param>
+/// <param name="a_pExtent">Half size of the box along each axis</param>
+void BoundingBoxList::Set(size_t a_uIndex, const float a_pCenter[3], const float a_pExtent[3])
+{
+	CenterX[a_uIndex] = a_pCenter[0];
+	CenterY[a_uIndex] = a_pCenter[1];
+	CenterZ[a_uIndex] = a_pCenter[2];
+	ExtentX[a_uIndex] = a_pExtent[0];
+	ExtentY[a_uIndex] = a_pExtent[1];
+	ExtentZ[a_uIndex] = a_pExtent[2];
+}
+
+/// <summary>
+/// Builds the frustum planes of a camera or light straight from its clip matrix columns (Gribb & Hartmann)
+/// </summary>
+/// <param name="a_pPlanes">Receives left, right, bottom, top, near and far, normalized</param>
+/// <param name="a_pViewProjection">View * projection (D3D clip space, 0 <= z <= w)</param>
+void ExtractFrustumPlanes(float a_pPlanes[6][4], const float a_pViewProjection[16])
+{
+	const float(*viewProjection)[4] = (const float(*)[4])a_pViewProjection;
+	for (int r = 0; r < 4; r++)
+	{
+		a_pPlanes[0][r] = viewProjection[r][3] + viewProjection[r][0];	// left
+		a_pPlanes[1][r] = viewProjection[r][3] - viewProjection[r][0];	// right
+		a_pPlanes[2][r] = viewProjection[r][3] + viewProjection[r][1];	// bottom
+		a_pPlanes[3][r] = viewProjection[r][3] - viewProjection[r][1];	// top
+		a_pPlanes[4][r] = viewProjection[r][2];							// near
+		a_pPlanes[5][r] = viewProjection[r][3] - viewProjection[r][2];	// far
+	}
+	for (int p = 0; p < 6; p++)
+		NormalizePlane(a_pPlanes[p]);
+}
+
+/// <summary>
+/// Culls a list of boxes against a frustum. A box is only culled when it is entirely behind one
+/// plane, so a few boxes near the frustum's corners are kept although they are outside.
+/// </summary>
+/// <param name="a_pVisible">Receives 1 or 0 per box</param>
+/// <param name="a_Boxes">Boxes to test</param>
+/// <param name="a_pPlanes">Planes from ExtractFrustumPlanes (in the space of the boxes)</param>
+/// <returns>How many boxes were kept and culled</returns>
+FrustumCullStats CullBoundingBoxes(uint8_t* a_pVisible, const BoundingBoxList& a_Boxes, const float a_pPlanes[6][4])
+{
+	FrustumCullStats stats = {};
+	for (size_t i = 0; i < a_Boxes.Count; i += FRUSTUM_CULL_BATCH)
+	{
+		int nOutside = OutsideMask(a_Boxes, i, a_pPlanes);
+
+		// the padding at the end of the last batch is never written
+		size_t uLanes = std::min<size_t>(FRUSTUM_CULL_BATCH, a_Boxes.Count - i);
+		for (size_t k = 0; k < uLanes; k++)
+		{
+			uint8_t bVisible = ((nOutside >> k) & 1) ? 0 : 1;
+			a_pVisible[i + k] = bVisible;
+			stats.Visible += bVisible;
+		}
+	}
+	stats.Culled = (uint32_t)a_Boxes.Count - stats.Visible;
+	return stats;
+}
+
+/// <summary>
+/// Times the batched cull against the scalar reference
+/// </summary>
+/// <param name="a_uBoxCount">Number of random boxes</param>
+/// <param name="a_uSeed">Seed of the box generator</param>
+/// <returns>Timings of both versions</returns>
+FrustumCullBenchmark BenchmarkFrustumCull(size_t a_uBoxCount, unsigned int a_uSeed)
+{
+	// boxes scattered through a cube around a camera at the origin looking down +z
+	std::mt19937 random(a_uSeed);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	BoundingBoxList boxes;
+	boxes.Resize(a_uBoxCount);
+	for (size_t i = 0; i < a_uBoxCount; i++)
+	{
+		float center[3] = { position(random), position(random), position(random) };
+		float extent[3] = { size(random), size(random), size(random) };
+		boxes.Set(i, center, extent);
+	}
+
+	// left-handed perspective projection (60 degree vertical field of view, 16:9), identity view
+	const float fNear = 0.1f;
+	const float fFar = 100.0f;
+	float fScaleY = 1.0f / tanf(0.5f * 1.04719755f);
+	float fScaleX = fScaleY / (16.0f / 9.0f);
+	float fRange = fFar / (fFar - fNear);
+	float viewProjection[16] =
+	{
+		fScaleX, 0.0f, 0.0f, 0.0f,
+		0.0f, fScaleY, 0.0f, 0.0f,
+		0.0f, 0.0f, fRange, 1.0f,
+		0.0f, 0.0f, -fRange * fNear, 0.0f,
+	};
+	float planes[6][4];
+	ExtractFrustumPlanes(planes, viewProjection);
+
+	FrustumCullBenchmark result = {};
+	result.BoxCount = a_uBoxCount;
+	result.SimdMilliseconds = result.ScalarMilliseconds = 1e30;
+	std::vector<uint8_t> vVisible(a_uBoxCount), vScalarVisible(a_uBoxCount);
+	for (int run = 0; run < FRUSTUM_CULL_BENCHMARK_RUNS; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		FrustumCullStats stats = CullBoundingBoxes(vVisible.data(), boxes, planes);
+		auto end = std::chrono::high_resolution_clock::now();
+		result.SimdMilliseconds = std::min(result.SimdMilliseconds, std::chrono::duration<double, std::milli>(end - start).count());
+		result.Visible = stats.Visible;
+
+		start = std::chrono::high_resolution_clock::now();
+		CullBoundingBoxesScalar(vScalarVisible.data(), boxes, planes);
+		end = std::chrono::high_resolution_clock::now();
+		result.ScalarMilliseconds = std::min(result.ScalarMilliseconds, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	result.Mismatches = 0;
+	for (size_t i = 0; i < a_uBoxCount; i++)
+		result.Mismatches += vVisible[i] != vScalarVisible[i] ? 1 : 0;
+	return result;
+}
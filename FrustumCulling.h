@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Boxes tested per loop iteration (one AVX register, or two SSE registers, per box component)
+#define FRUSTUM_CULL_BATCH 8
+
+// --------------------------------------------------------
+// World-space axis-aligned boxes stored as separate arrays
+// of each component so a batch of them loads straight into
+// SIMD registers. The arrays are padded to a whole batch.
+// --------------------------------------------------------
+struct BoundingBoxList
+{
+	std::vector<float> CenterX, CenterY, CenterZ;
+	std::vector<float> ExtentX, ExtentY, ExtentZ;	// half sizes
+	size_t Count = 0;
+
+	void Resize(size_t a_uCount);
+	void Set(size_t a_uIndex, const float a_pCenter[3], const float a_pExtent[3]);
+};
+
+// --------------------------------------------------------
+// What a call to CullBoundingBoxes did
+// --------------------------------------------------------
+struct FrustumCullStats
+{
+	uint32_t Visible;	// boxes at least partly inside the frustum
+	uint32_t Culled;	// boxes completely outside one of the planes
+};
+
+// --------------------------------------------------------
+// Result of BenchmarkFrustumCull
+// --------------------------------------------------------
+struct FrustumCullBenchmark
+{
+	size_t BoxCount;
+	size_t Visible;
+	double SimdMilliseconds;	// best of several runs of CullBoundingBoxes
+	double ScalarMilliseconds;	// best of several runs of the one-box-at-a-time reference
+	size_t Mismatches;			// boxes the two disagree on
+};
+
+// Extracts the six normalized frustum planes (left, right, bottom, top, near, far) of a
+// row-major view * projection matrix that transforms row vectors (p * M) into D3D clip space.
+// A point p is inside when dot(xyz, p) + w >= 0 for every plane.
+void ExtractFrustumPlanes(float a_pPlanes[6][4], const float a_pViewProjection[16]);
+
+// Tests every box against the planes, FRUSTUM_CULL_BATCH at a time, and writes 1 (visible)
+// or 0 (culled) per box to a_pVisible, which needs room for a_Boxes.Count entries
+FrustumCullStats CullBoundingBoxes(uint8_t* a_pVisible, const BoundingBoxList& a_Boxes, const float a_pPlanes[6][4]);
+
+// Times CullBoundingBoxes against a scalar reference on a_uBoxCount random boxes scattered
+// around a fixed camera. Needs no device, so it also runs without a window.
+FrustumCullBenchmark BenchmarkFrustumCull(size_t a_uBoxCount, unsigned int a_uSeed = 1);
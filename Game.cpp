@@ -8,9 +8,11 @@
 #include "SimpleShader.h"
 #include <DirectXMath.h>
 #include "Material.h"
-#include "WICTextureLoader.h"
 #include <wrl/client.h>
 #include "ShadowMap.h"
+#include "AssetCache.h"
+#include "GeometryPool.h"
+#include "InstanceBuffer.h"
 
 // This code assumes files are in "ImGui" subfolder!
 // Adjust as necessary for your own folder structure and project setup
@@ -40,6 +42,23 @@ static int nBlurRadius = 0;
 // --------------------------------------------------------
 void Game::Initialize()
 {
+	// everything below counts towards the time to the first frame
+	m_tpInitializeStart = std::chrono::high_resolution_clock::now();
+
+	// assets load from their cooked entries in the cache (see the Cook tool) when they have one
+	SetAssetCacheDirectory(FixPath("../../Cache"));
+
+	// start the workers the frame's update and view preparation run on; this thread is the first of them
+	m_spJobs = std::make_shared<JobScheduler>();
+	TransformHierarchy::GetDefault()->SetJobScheduler(m_spJobs);
+
+	// start the workers that read meshes and textures in the background
+	m_spAssetLoader = std::make_shared<AssetLoader>();
+
+	// 2D textures start with only their low mips and stream in the rest as they're seen
+	m_spTextureStreamer = std::make_shared<TextureStreamer>();
+	m_spAssetLoader->SetTextureStreamer(m_spTextureStreamer);
+
 	// Initialize ImGui itself & platform/renderer backends
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -95,11 +114,11 @@ void Game::Initialize()
 
 #pragma region Shadow mapping
 	// create shadow maps
-	std::shared_ptr<SimpleVertexShader> spShadowVertexShader = std::make_shared<SimpleVertexShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"ShadowMapVertexShader.cso").c_str());
+	std::shared_ptr<SimpleVertexShader> spShadowVertexShader = Mesh::LoadVertexShader(FixPath(L"ShadowMapVertexShader.cso").c_str());
+	std::shared_ptr<SimpleVertexShader> spInstancedShadowVertexShader = Mesh::LoadVertexShader(FixPath(L"ShadowMapVertexShaderInstanced.cso").c_str(), true);
 
-	m_vShadowMaps.push_back(ShadowMap(spDirectionalLight1, spShadowVertexShader, nShadowMapResolution, fLightProjectionSize, 1.0f, 100.0f, 20.0f));
-	m_vShadowMaps.push_back(ShadowMap(spDirectionalLight4, spShadowVertexShader, nShadowMapResolution, fLightProjectionSize, 1.0f, 100.0f, 20.0f));
+	m_vShadowMaps.push_back(ShadowMap(spDirectionalLight1, spShadowVertexShader, spInstancedShadowVertexShader, nShadowMapResolution, fLightProjectionSize, 1.0f, 100.0f, 20.0f));
+	m_vShadowMaps.push_back(ShadowMap(spDirectionalLight4, spShadowVertexShader, spInstancedShadowVertexShader, nShadowMapResolution, fLightProjectionSize, 1.0f, 100.0f, 20.0f));
 
 	// create a rasterizer state for depth biasing
 	D3D11_RASTERIZER_DESC shadowRastDesc = {};
@@ -177,7 +196,7 @@ void Game::Initialize()
 		// Tell the input assembler (IA) stage of the pipeline what kind of
 		// geometric primitives (points, lines or triangles) we want to draw.  
 		// Essentially: "What kind of shape should the GPU draw with our vertices?"
-		Graphics::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		Graphics::State->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 		// Ensure the pipeline knows how to interpret all the numbers stored in
 		// the vertex buffer. For this course, all of your vertices will probably
@@ -205,6 +224,12 @@ Game::~Game()
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
+
+	// remember the hashes of the sources, so the next run doesn't read them again to find their entries
+	SaveAssetCacheIndex();
+
+	// the default hierarchy outlives the game, but its workers shouldn't
+	TransformHierarchy::GetDefault()->SetJobScheduler(nullptr);
 }
 
 
@@ -287,8 +312,8 @@ void Game::LoadShaders()
 // --------------------------------------------------------
 void Game::CreateGeometry()
 {
-	std::shared_ptr<SimpleVertexShader> spVertexShader = std::make_shared<SimpleVertexShader>(
-		Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str());
+	std::shared_ptr<SimpleVertexShader> spVertexShader = Mesh::LoadVertexShader(FixPath(L"VertexShader.cso").c_str());
+	std::shared_ptr<SimpleVertexShader> spInstancedVertexShader = Mesh::LoadVertexShader(FixPath(L"VertexShaderInstanced.cso").c_str(), true);
 	std::shared_ptr<SimplePixelShader> spPixelShaderSolid = std::make_shared<SimplePixelShader>(
 		Graphics::Device, Graphics::Context, FixPath(L"PixelShader.cso").c_str());
 	/*std::shared_ptr<SimplePixelShader> spPixelShaderMultiTexture = std::make_shared<SimplePixelShader>(
@@ -310,35 +335,30 @@ void Game::CreateGeometry()
 	XMFLOAT4 grey = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.5f);*/
 	XMFLOAT4 white = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 
-	// load textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetal;
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/metal_plate/metal_plate_02_diff_4k.jpg").c_str(), nullptr, srvMetal.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetalNormal;
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/metal_plate/metal_plate_02_nor_gl_4k.jpg").c_str(), nullptr, srvMetalNormal.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetalRough;
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/metal_plate/metal_plate_02_rough_4k.jpg").c_str(), nullptr, srvMetalRough.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetalMetalness;
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/metal_plate/metal_plate_02_metal_4k.jpg").c_str(), nullptr, srvMetalMetalness.GetAddressOf());
-	
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvBrick; 
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/stone_brick_wall/stone_brick_wall_001_diff_4k.jpg").c_str(), nullptr, srvBrick.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvBrickNormal;
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/stone_brick_wall/stone_brick_wall_001_nor_gl_4k.jpg").c_str(), nullptr, srvBrickNormal.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvBrickRough;
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/stone_brick_wall/stone_brick_wall_001_rough_4k.jpg").c_str(), nullptr, srvBrickRough.GetAddressOf());
-	
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetalSafety;
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/metal_plate_safety/metal_plate_diff_4k.jpg").c_str(), nullptr, srvMetalSafety.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetalSafetyNormal;														
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/metal_plate_safety/metal_plate_nor_gl_4k.jpg").c_str(), nullptr, srvMetalSafetyNormal.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetalSafetyRough;														 
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/metal_plate_safety/metal_plate_rough_4k.jpg").c_str(), nullptr, srvMetalSafetyRough.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetalSafetyMetalness;													 
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/metal_plate_safety/metal_plate_metal_4k.jpg").c_str(), nullptr, srvMetalSafetyMetalness.GetAddressOf());
-	
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvNoMetalness;
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/default_metalness.png").c_str(), nullptr, srvNoMetalness.GetAddressOf());
-	
+	// queue the textures; materials show a flat 1x1 placeholder until their images are decoded
+	XMFLOAT4 f4Albedo = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+	XMFLOAT4 f4FlatNormal = XMFLOAT4(0.5f, 0.5f, 1.0f, 1.0f);
+	// occlusion, roughness and metalness are packed into one texture per material; maps that are
+	// missing or flat become constants (the brick has no metalness map, so it is simply 0)
+	XMFLOAT3 f3NoOcclusionHalfRough = XMFLOAT3(1.0f, 0.5f, 0.0f);
+
+	std::shared_ptr<TextureAsset> spTexMetal = m_spAssetLoader->LoadTexture(FixPath(L"../../Assets/Textures/metal_plate/metal_plate_02_diff_4k.jpg"), f4Albedo);
+	std::shared_ptr<TextureAsset> spTexMetalNormal = m_spAssetLoader->LoadTexture(FixPath(L"../../Assets/Textures/metal_plate/metal_plate_02_nor_gl_4k.jpg"), f4FlatNormal, TEXTURE_KIND_NORMAL);
+	std::shared_ptr<TextureAsset> spTexMetalPacked = m_spAssetLoader->LoadPackedMaps(L"",
+		FixPath(L"../../Assets/Textures/metal_plate/metal_plate_02_rough_4k.jpg"),
+		FixPath(L"../../Assets/Textures/metal_plate/metal_plate_02_metal_4k.jpg"), f3NoOcclusionHalfRough);
+
+	std::shared_ptr<TextureAsset> spTexBrick = m_spAssetLoader->LoadTexture(FixPath(L"../../Assets/Textures/stone_brick_wall/stone_brick_wall_001_diff_4k.jpg"), f4Albedo);
+	std::shared_ptr<TextureAsset> spTexBrickNormal = m_spAssetLoader->LoadTexture(FixPath(L"../../Assets/Textures/stone_brick_wall/stone_brick_wall_001_nor_gl_4k.jpg"), f4FlatNormal, TEXTURE_KIND_NORMAL);
+	std::shared_ptr<TextureAsset> spTexBrickPacked = m_spAssetLoader->LoadPackedMaps(L"",
+		FixPath(L"../../Assets/Textures/stone_brick_wall/stone_brick_wall_001_rough_4k.jpg"), L"", f3NoOcclusionHalfRough);
+
+	std::shared_ptr<TextureAsset> spTexMetalSafety = m_spAssetLoader->LoadTexture(FixPath(L"../../Assets/Textures/metal_plate_safety/metal_plate_diff_4k.jpg"), f4Albedo);
+	std::shared_ptr<TextureAsset> spTexMetalSafetyNormal = m_spAssetLoader->LoadTexture(FixPath(L"../../Assets/Textures/metal_plate_safety/metal_plate_nor_gl_4k.jpg"), f4FlatNormal, TEXTURE_KIND_NORMAL);
+	std::shared_ptr<TextureAsset> spTexMetalSafetyPacked = m_spAssetLoader->LoadPackedMaps(L"",
+		FixPath(L"../../Assets/Textures/metal_plate_safety/metal_plate_rough_4k.jpg"),
+		FixPath(L"../../Assets/Textures/metal_plate_safety/metal_plate_metal_4k.jpg"), f3NoOcclusionHalfRough);
+
 	Microsoft::WRL::ComPtr <ID3D11SamplerState> cpSamplerState;
 	D3D11_SAMPLER_DESC samplerDesc = {};
 
@@ -358,27 +378,27 @@ void Game::CreateGeometry()
 	//Material mMatCustom = Material(blue, spVertexShader, spPixelShaderCustom);
 
 	std::shared_ptr<Material> spMatMetal = std::make_shared<Material>(white, spVertexShader, spPixelShaderSolid, 0.5f);
-	spMatMetal->AddTextureSRV("Albedo", srvMetal);
-	spMatMetal->AddTextureSRV("NormalMap", srvMetalNormal);
-	spMatMetal->AddTextureSRV("RoughnessMap", srvMetalRough);
-	spMatMetal->AddTextureSRV("MetalnessMap", srvMetalNormal);
+	spMatMetal->AddTexture("Albedo", spTexMetal);
+	spMatMetal->AddTexture("NormalMap", spTexMetalNormal);
+	spMatMetal->SetPackedMaps(spTexMetalPacked);
 	spMatMetal->AddSampler("BasicSampler", cpSamplerState);
+	spMatMetal->SetInstancedVertexShader(spInstancedVertexShader);
 	//spMatMetal->SetUVScale(5.0f, 5.0f);
 	//spMatMetal->SetUVOffset(0.75f, 0.0f);
 
 	std::shared_ptr<Material> spMatBrick = std::make_shared<Material>(white, spVertexShader, spPixelShaderSolid, 1.0f);
-	spMatBrick->AddTextureSRV("Albedo", srvBrick);
-	spMatBrick->AddTextureSRV("NormalMap", srvBrickNormal);
-	spMatBrick->AddTextureSRV("RoughnessMap", srvBrickRough);
-	spMatBrick->AddTextureSRV("MetalnessMap", srvNoMetalness);
+	spMatBrick->AddTexture("Albedo", spTexBrick);
+	spMatBrick->AddTexture("NormalMap", spTexBrickNormal);
+	spMatBrick->SetPackedMaps(spTexBrickPacked);
 	spMatBrick->AddSampler("BasicSampler", cpSamplerState);
+	spMatBrick->SetInstancedVertexShader(spInstancedVertexShader);
 
 	std::shared_ptr<Material> spMatMetalSafety = std::make_shared<Material>(white, spVertexShader, spPixelShaderSolid, 0.5f);
-	spMatMetalSafety->AddTextureSRV("Albedo", srvMetalSafety);
-	spMatMetalSafety->AddTextureSRV("NormalMap", srvMetalSafetyNormal);
-	spMatMetalSafety->AddTextureSRV("RoughnessMap", srvMetalSafetyRough);
-	spMatMetalSafety->AddTextureSRV("MetalnessMap", srvMetalSafetyMetalness);
+	spMatMetalSafety->AddTexture("Albedo", spTexMetalSafety);
+	spMatMetalSafety->AddTexture("NormalMap", spTexMetalSafetyNormal);
+	spMatMetalSafety->SetPackedMaps(spTexMetalSafetyPacked);
 	spMatMetalSafety->AddSampler("BasicSampler", cpSamplerState);
+	spMatMetalSafety->SetInstancedVertexShader(spInstancedVertexShader);
 	//
 	//std::shared_ptr<Material> spMatWood = std::make_shared<Material>(white, spVertexShader, spPixelShaderSolid, 0.1);
 	////Material mWood = Material(white, spVertexShader, spPixelShaderSolid);
@@ -392,22 +412,24 @@ void Game::CreateGeometry()
 	//spMatCrackedBrick->AddTextureSRV("Decal", srvCrack);
 	//spMatCrackedBrick->AddSampler("BasicSampler", cpSamplerState);
 
-	std::shared_ptr<Mesh> spMeshCube = std::make_shared<Mesh>(FixPath("../../Assets/Models/cube.obj").c_str());
-	std::shared_ptr<Mesh> spMeshHelix = std::make_shared<Mesh>(FixPath("../../Assets/Models/helix.obj").c_str());
-	std::shared_ptr<Mesh> spMeshSphere = std::make_shared<Mesh>(FixPath("../../Assets/Models/sphere.obj").c_str());
-	std::shared_ptr<Mesh> spMeshCylinder = std::make_shared<Mesh>(FixPath("../../Assets/Models/cylinder.obj").c_str());
-	std::shared_ptr<Mesh> spMeshTorus = std::make_shared<Mesh>(FixPath("../../Assets/Models/torus.obj").c_str());
-	std::shared_ptr<Mesh> spMeshQuadDouble = std::make_shared<Mesh>(FixPath("../../Assets/Models/quad_double_sided.obj").c_str());
-	std::shared_ptr<Mesh> spMeshQuad = std::make_shared<Mesh>(FixPath("../../Assets/Models/quad.obj").c_str());
+	// queue the meshes; entities draw a placeholder cube until theirs is loaded
+	std::shared_ptr<Mesh> spMeshCube = m_spAssetLoader->LoadMesh(FixPath("../../Assets/Models/cube.obj"));
+	std::shared_ptr<Mesh> spMeshHelix = m_spAssetLoader->LoadMesh(FixPath("../../Assets/Models/helix.obj"));
+	std::shared_ptr<Mesh> spMeshSphere = m_spAssetLoader->LoadMesh(FixPath("../../Assets/Models/sphere.obj"));
+	std::shared_ptr<Mesh> spMeshCylinder = m_spAssetLoader->LoadMesh(FixPath("../../Assets/Models/cylinder.obj"));
+	std::shared_ptr<Mesh> spMeshTorus = m_spAssetLoader->LoadMesh(FixPath("../../Assets/Models/torus.obj"));
+	std::shared_ptr<Mesh> spMeshQuadDouble = m_spAssetLoader->LoadMesh(FixPath("../../Assets/Models/quad_double_sided.obj"));
+	std::shared_ptr<Mesh> spMeshQuad = m_spAssetLoader->LoadMesh(FixPath("../../Assets/Models/quad.obj"));
 
 	// create skybox
-	m_spSkybox = std::make_shared<Sky>(spMeshCube, cpSamplerState,
-		FixPath(L"../../Assets/Skies/Clouds_Pink/right.png").c_str(),
-		FixPath(L"../../Assets/Skies/Clouds_Pink/left.png").c_str(),
-		FixPath(L"../../Assets/Skies/Clouds_Pink/up.png").c_str(),
-		FixPath(L"../../Assets/Skies/Clouds_Pink/down.png").c_str(),
-		FixPath(L"../../Assets/Skies/Clouds_Pink/front.png").c_str(),
-		FixPath(L"../../Assets/Skies/Clouds_Pink/back.png").c_str());
+	m_spSkybox = std::make_shared<Sky>(spMeshCube, cpSamplerState, m_spAssetLoader->LoadCubemap(
+		FixPath(L"../../Assets/Skies/Clouds_Pink/right.png"),
+		FixPath(L"../../Assets/Skies/Clouds_Pink/left.png"),
+		FixPath(L"../../Assets/Skies/Clouds_Pink/up.png"),
+		FixPath(L"../../Assets/Skies/Clouds_Pink/down.png"),
+		FixPath(L"../../Assets/Skies/Clouds_Pink/front.png"),
+		FixPath(L"../../Assets/Skies/Clouds_Pink/back.png"),
+		XMFLOAT4(0.4f, 0.6f, 0.75f, 1.0f)));
 
 	m_vEntities.push_back(Entity(spMeshCube, spMatMetal));
 	m_vEntities[0].GetTransform()->SetPosition(-7.5f, 0.0f, 0.0f);
@@ -439,6 +461,14 @@ void Game::CreateGeometry()
 	m_vEntities.push_back(Entity(spMeshQuadDouble, spMatBrick));
 	m_vEntities[6].GetTransform()->SetPosition(0.0f, -3.0f, 0.0f);
 	m_vEntities[6].GetTransform()->SetScale(10.0f, 1.0f, 20.0f);
+
+	// what Game::Update plays on them every frame
+	m_vEntities[0].SetBob(XMFLOAT3(0.0f, 5.0f, 0.0f));
+	m_vEntities[1].SetSpin(XMFLOAT3(0.0f, 0.5f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f));
+	m_vEntities[2].SetBob(XMFLOAT3(0.0f, 0.0f, 5.0f));
+	m_vEntities[3].SetPulse(0.5f);
+	m_vEntities[4].SetBob(XMFLOAT3(0.0f, 2.0f, 0.0f));
+	m_vEntities[4].SetSpin(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f));
 	//
 	//m_vEntities.push_back(Entity(spMeshCube, spMatMetalSafety));
 	//m_vEntities[14].GetTransform()->SetPosition(0.0f, -6.0f, 0.0f);
@@ -488,31 +518,78 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
-	// update camera
+	auto tpStart = std::chrono::high_resolution_clock::now();
 
-	m_spActiveCamera->Update(deltaTime);
+	// swap in any meshes and textures the loader finished since last frame
+	m_spAssetLoader->Update();
 
 	// initialize ImGui frame
 	InitializeNewUIFrame(deltaTime);
 
-	//create UI
+	//create UI (before the jobs, since its buttons add entities and switch cameras)
 	BuildUI();
 
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::KeyDown(VK_ESCAPE))
 		Window::Quit();
 
-	
-	m_vEntities[0].GetTransform()->SetPosition(m_vEntities[0].GetTransform()->GetPosition().x, (float)sin(totalTime) * 5, m_vEntities[0].GetTransform()->GetPosition().z);
-	m_vEntities[1].GetTransform()->SetRotation(totalTime, 0.5f, 0.0f);
-	m_vEntities[2].GetTransform()->SetPosition(m_vEntities[2].GetTransform()->GetPosition().x, m_vEntities[2].GetTransform()->GetPosition().y, (float)sin(totalTime) * 5);
-	m_vEntities[3].GetTransform()->SetScale(sinf(totalTime)/ 2 + 1, sinf(totalTime) / 2 + 1, sinf(totalTime) / 2 + 1);
-	m_vEntities[4].GetTransform()->SetPosition(m_vEntities[4].GetTransform()->GetPosition().x, sinf(totalTime) * 2, m_vEntities[4].GetTransform()->GetPosition().z);
-	m_vEntities[4].GetTransform()->SetRotation(totalTime, 0.0f, 0.0f);
-	//m_vEntities[4].GetTransform()->SetPosition(-sinf(totalTime), -sinf(totalTime), 0.0f);
-	//m_vEntities[4].GetTransform()->SetScale(sinf(totalTime) + 1.5, sinf(totalTime) + 1.5, 0.0f);
-	
-	
+	// the rest runs as jobs: the camera moves (in a hierarchy of its own) while the entities bob, spin and pulse,
+	// then every world matrix that changed is recomputed in one pass, and then what the passes draw is gathered
+	// once, so they only read it. Input and the UI stay on this thread, which Windows and ImGui tie them to.
+	JobCounter cameraMoved;
+	JobCounter entitiesMoved;
+	JobCounter transformsUpdated;
+	JobCounter listBuilt;
+	m_spJobs->Run(cameraMoved, [this, deltaTime] { m_spActiveCamera->Update(deltaTime); });
+	m_spJobs->Run(entitiesMoved, [totalTime] { UpdateEntityMotion(*EntityWorld::GetDefault(), totalTime); });
+	m_spJobs->Run(transformsUpdated, [] { TransformHierarchy::GetDefault()->Update(); }, &entitiesMoved);
+	m_spJobs->Run(listBuilt, [this] { m_RenderList.Build(*EntityWorld::GetDefault()); }, &transformsUpdated);
+	m_spJobs->Wait(cameraMoved);
+	m_spJobs->Wait(listBuilt);
+	m_dUpdateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tpStart).count();
+}
+
+// --------------------------------------------------------
+// Works out what the main pass draws, and in which order,
+// without touching the device context, so it can run as a
+// job next to the shadow maps' Prepare()
+// --------------------------------------------------------
+void Game::PrepareMainView()
+{
+	// skip entities outside the active camera's view
+	XMFLOAT4X4 m4View = m_spActiveCamera->GetViewMatrix();
+	XMFLOAT4X4 m4Projection = m_spActiveCamera->GetProjectionMatrix();
+	XMFLOAT4X4 m4ViewProjection;
+	XMStoreFloat4x4(&m4ViewProjection, XMMatrixMultiply(XMLoadFloat4x4(&m4View), XMLoadFloat4x4(&m4Projection)));
+	float planes[6][4];
+	ExtractFrustumPlanes(planes, &m4ViewProjection._11);
+	const std::vector<DrawPacket>& vPackets = m_RenderList.GetPackets();
+	m_vEntityVisible.resize(vPackets.size());
+	m_MainCullStats = CullBoundingBoxes(m_vEntityVisible.data(), m_RenderList.GetBounds(), planes);
+
+	// sort the visible packets by shader program, material, mesh and level of detail, and front to back within those
+	XMFLOAT3 f3CameraPosition = m_spActiveCamera->GetTransform()->GetPosition();
+	XMFLOAT3 f3CameraForward = m_spActiveCamera->GetTransform()->GetForward();
+	float fNearClipPlaneDistance = m_spActiveCamera->GetNearClipPlaneDistance();
+	float fFarClipPlaneDistance = m_spActiveCamera->GetFarClipPlaneDistance();
+	m_vDrawKeys.clear();
+	m_vDrawOrder.clear();
+	for (uint32_t i = 0; i < (uint32_t)vPackets.size(); i++)
+	{
+		if (!m_vEntityVisible[i])
+			continue;
+
+		// pick the coarsest level of detail that still looks the same at this size on screen
+		unsigned int uLod = m_RenderList.GetMesh(vPackets[i].Mesh)->SelectLod(m_RenderList.GetWorldMatrix(vPackets[i].World), m4View, m4Projection,
+			(float)Window::Height(), LOD_MAX_PIXEL_ERROR);
+		float fDepth = XMVectorGetX(XMVector3Dot(XMVectorSubtract(XMLoadFloat3(&vPackets[i].Center), XMLoadFloat3(&f3CameraPosition)),
+			XMLoadFloat3(&f3CameraForward)));
+		m_vDrawKeys.push_back(vPackets[i].SortKey | ((uint64_t)uLod << DRAW_KEY_LOD_SHIFT) | QuantizeDrawDepth(fDepth, fNearClipPlaneDistance, fFarClipPlaneDistance));
+		m_vDrawOrder.push_back(i);
+	}
+	m_UnsortedStateChanges = CountDrawStateChanges(m_vDrawKeys.data(), m_vDrawKeys.size());
+	m_DrawSorter.Sort(m_vDrawKeys, m_vDrawOrder);
+	m_MainStateChanges = CountDrawStateChanges(m_vDrawKeys.data(), m_vDrawKeys.size());
 }
 
  
@@ -521,12 +598,24 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	auto tpStart = std::chrono::high_resolution_clock::now();
+
+	// cull, pick levels of detail and sort the draws of every view on the workers, leaving only their submission to this thread.
+	// This thread takes its newest job first and the others steal the oldest, so the main view, queued first, goes to another
+	// worker while the shadow maps come back here in the order they're drawn.
+	JobCounter mainViewPrepared;
+	std::vector<JobCounter> vShadowsPrepared(m_vShadowMaps.size());
+	m_spJobs->Run(mainViewPrepared, [this] { PrepareMainView(); });
+	for (size_t i = m_vShadowMaps.size(); i-- > 0;)
+		m_spJobs->Run(vShadowsPrepared[i], [this, i] { m_vShadowMaps[i].Prepare(m_RenderList); });
+
 	// draw SHADOW MAP
 	{
-		// loop through all the shadow maps and draw them
-		for (auto& e : m_vShadowMaps)
+		// loop through all the shadow maps and draw each one once it's prepared
+		for (size_t i = 0; i < m_vShadowMaps.size(); i++)
 		{
-			e.Draw(m_vEntities, m_cpShadowRasterizer);
+			m_spJobs->Wait(vShadowsPrepared[i]);
+			m_vShadowMaps[i].Draw(m_RenderList, m_cpShadowRasterizer);
 		}
 
 		// create a Texture2DArray SRV from the shadow maps
@@ -550,48 +639,113 @@ void Game::Draw(float deltaTime, float totalTime)
 	}
 
 	Graphics::Context->ClearRenderTargetView(m_cpBlurRenderTargetView.Get(), backgroundColor);
-	Graphics::Context->OMSetRenderTargets(1, m_cpBlurRenderTargetView.GetAddressOf(), Graphics::DepthBufferDSV.Get());
+	Graphics::State->SetRenderTargets(1, m_cpBlurRenderTargetView.GetAddressOf(), Graphics::DepthBufferDSV.Get());
 
 
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
 	{
-		//draw all entities
-		for (int i = 0; i < m_vEntities.size(); i++)
+		// the main view was culled and sorted by its job
+		m_spJobs->Wait(mainViewPrepared);
+		XMFLOAT4X4 m4Projection = m_spActiveCamera->GetProjectionMatrix();
+		const std::vector<DrawPacket>& vPackets = m_RenderList.GetPackets();
+
+		// ask for the texture detail each visible entity covers: its bounding sphere's size on screen,
+		// seen from its nearest point, divided by how often its material repeats the textures
+		XMFLOAT3 f3CameraPosition = m_spActiveCamera->GetTransform()->GetPosition();
+		float fPixelsPerUnit = m4Projection._22 * Window::Height() * 0.5f; // at a distance of 1
+		float fNearClipPlaneDistance = m_spActiveCamera->GetNearClipPlaneDistance();
+		for (size_t i = 0; i < vPackets.size(); i++)
 		{
-			std::vector<XMFLOAT4X4> vShadowViews;
-			std::vector<XMFLOAT4X4> vShadowProjections;
+			if (!m_vEntityVisible[i])
+				continue;
+
+			const DrawPacket& packet = vPackets[i];
+			float fRadius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&packet.Extent)));
+			float fDistance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&packet.Center), XMLoadFloat3(&f3CameraPosition)))) - fRadius;
+			fDistance = (std::max)(fDistance, fNearClipPlaneDistance);
+
+			Material* pMaterial = m_RenderList.GetMaterial(packet.Material);
+			XMFLOAT2 f2UVScale = pMaterial->GetUVScale();
+			float fRepeats = (std::max)((std::min)(f2UVScale.x, f2UVScale.y), 0.001f);
+			float fTexels = 2.0f * fRadius * fPixelsPerUnit / fDistance / fRepeats;
+			for (auto& t : pMaterial->GetTextureAssets())
+				m_spTextureStreamer->RequestDetail(t.second, fTexels);
+		}
+		m_spTextureStreamer->Update();
+
+		// every mesh draws from the geometry pool's buffers, which are set once for the pass
+		GeometryPool::Bind();
 
-			// send the light view and projection to the vertex shader
-			for (auto& e : m_vShadowMaps)
+		//draw all visible entities
+		std::vector<XMFLOAT4X4> vShadowViews;
+		std::vector<XMFLOAT4X4> vShadowProjections;
+		for (auto& e : m_vShadowMaps)
+		{
+			vShadowViews.push_back(e.GetViewMatrix());
+			vShadowProjections.push_back(e.GetProjectionMatrix());
+		}
+
+		// runs of packets that only differ in depth become instanced draws
+		m_RenderList.BatchInstances(m_vDrawKeys, m_vDrawOrder, m_vDrawBatches);
+		InstanceBuffer::Bind();
+		m_uInstancedDraws = 0;
+		m_uInstancedPackets = 0;
+
+		EntityWorld& world = *EntityWorld::GetDefault();
+		uint32_t uLastMaterial = UINT32_MAX;
+		for (const DrawBatch& batch : m_vDrawBatches)
+		{
+			const DrawPacket& first = vPackets[m_vDrawOrder[batch.First]];
+			Mesh* pMesh = m_RenderList.GetMesh(first.Mesh);
+			Material* pMaterial = m_RenderList.GetMaterial(first.Material);
+
+			// the frame's lighting only has to be handed to a material's shaders when the material changes;
+			// DrawMesh() and DrawMeshInstances() upload it with the per-draw constants
+			if (first.Material != uLastMaterial)
 			{
-				vShadowViews.push_back(e.GetViewMatrix());
-				vShadowProjections.push_back(e.GetProjectionMatrix());
-			}
+				uLastMaterial = first.Material;
 
-			m_vEntities[i].GetMaterial()->GetVertexShader()->SetData("lightViews", &vShadowViews[0], sizeof(XMFLOAT4X4) * (int)vShadowViews.size());
-			m_vEntities[i].GetMaterial()->GetVertexShader()->SetData("lightProjections", &vShadowProjections[0], sizeof(XMFLOAT4X4) * (int)vShadowProjections.size());
-			//m_vEntities[i].GetMaterial()->GetVertexShader()->SetMatrix4x4("lightView", m_m4LightView);
-			//m_vEntities[i].GetMaterial()->GetVertexShader()->SetMatrix4x4("lightProjection", m_m4LightProjection);
-			m_vEntities[i].GetMaterial()->GetVertexShader()->CopyAllBufferData();
+				// send the light view and projection to the vertex shaders
+				pMaterial->GetVertexShader()->SetData("lightViews", &vShadowViews[0], sizeof(XMFLOAT4X4) * (int)vShadowViews.size());
+				pMaterial->GetVertexShader()->SetData("lightProjections", &vShadowProjections[0], sizeof(XMFLOAT4X4) * (int)vShadowProjections.size());
+				if (pMaterial->GetInstancedVertexShader())
+				{
+					pMaterial->GetInstancedVertexShader()->SetData("lightViews", &vShadowViews[0], sizeof(XMFLOAT4X4) * (int)vShadowViews.size());
+					pMaterial->GetInstancedVertexShader()->SetData("lightProjections", &vShadowProjections[0], sizeof(XMFLOAT4X4) * (int)vShadowProjections.size());
+				}
 
-			// send the shadow sampler to the pixel shader
-			m_vEntities[i].GetMaterial()->GetPixelShader()->SetSamplerState("ShadowSampler", m_cpShadowSampler);
+				// send the shadow sampler to the pixel shader
+				pMaterial->GetPixelShader()->SetSamplerState("ShadowSampler", m_cpShadowSampler);
 
-			// send the ambient light to the entity's pixel shader
-			m_vEntities[i].GetMaterial()->GetPixelShader()->SetFloat3("ambient", m_f3AmbientLight);
+				// send the ambient light to the entity's pixel shader
+				pMaterial->GetPixelShader()->SetFloat3("ambient", m_f3AmbientLight);
 
-			// send light to entity's pixel shader
-			m_vEntities[i].GetMaterial()->GetPixelShader()->SetData("lights", &m_vLights[0], sizeof(Light) * (int)m_vLights.size());
-			m_vEntities[i].GetMaterial()->GetPixelShader()->CopyAllBufferData();
+				// send light to entity's pixel shader
+				pMaterial->GetPixelShader()->SetData("lights", &m_vLights[0], sizeof(Light) * (int)m_vLights.size());
 
-			// send shadow map to entity's pixel shader
-			m_vEntities[i].GetMaterial()->GetPixelShader()->SetShaderResourceView("ShadowMaps", m_cpShadowSRV);
-			//m_vEntities[i].GetMaterial()->GetPixelShader()->SetShaderResourceView("ShadowMap", m_vShadowMaps[0].GetSRV());
-			
+				// send shadow map to entity's pixel shader
+				pMaterial->GetPixelShader()->SetShaderResourceView("ShadowMaps", m_cpShadowSRV);
+			}
 
-			m_vEntities[i].Draw(m_spActiveCamera, totalTime);
+			// the level of detail goes back to the entities for the statistics
+			if (batch.Instanced)
+			{
+				unsigned int uLod = GetDrawKeyLod(m_vDrawKeys[batch.First]);
+				DrawMeshInstances(*pMesh, *pMaterial, uLod, batch.FirstInstance, batch.Count, *m_spActiveCamera, totalTime);
+				for (uint32_t i = batch.First; i < batch.First + batch.Count; i++)
+					world.Get<EntityLod>(vPackets[m_vDrawOrder[i]].Entity)->Lod = uLod;
+				m_uInstancedDraws++;
+				m_uInstancedPackets += batch.Count;
+				continue;
+			}
+			for (uint32_t i = batch.First; i < batch.First + batch.Count; i++)
+			{
+				const DrawPacket& packet = vPackets[m_vDrawOrder[i]];
+				world.Get<EntityLod>(packet.Entity)->Lod = DrawMesh(*pMesh, *pMaterial,
+					m_RenderList.GetWorldMatrix(packet.World), m_RenderList.GetWorldInverseTransposeMatrix(packet.World), *m_spActiveCamera, totalTime);
+			}
 		}
 
 		// draw the skybox
@@ -600,7 +754,7 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	// DRAW POST PROCESS ///////////////////////////////
 	{
-		Graphics::Context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), 0);
+		Graphics::State->SetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), 0);
 
 		m_spPostProcessVertexShader->SetShader();
 		m_spBlurPixelShader->SetShader();
@@ -627,6 +781,10 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	ImGui::Render(); // Turns this frames UI into renderable triangles
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData()); // Draws it to the screen
+	Graphics::State->Invalidate(); // the UI sets its state on the context directly
+
+	// everything up to handing the frame to the GPU
+	m_dDrawMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tpStart).count();
 
 	// Frame END
 	// - These should happen exactly ONCE PER FRAME
@@ -638,15 +796,24 @@ void Game::Draw(float deltaTime, float totalTime)
 			vsync ? 1 : 0,
 			vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
 
+		// close the frame's draw, buffer bind, instance and state call counts
+		GeometryPool::EndFrame();
+		InstanceBuffer::EndFrame();
+		Graphics::State->EndFrame();
+		m_spJobs->EndFrame();
+
+		// remember how long it took to get something on screen
+		if (m_dFirstFrameMilliseconds == 0.0)
+			m_dFirstFrameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_tpInitializeStart).count();
+
 		// Re-bind back buffer and depth buffer after presenting
-		Graphics::Context->OMSetRenderTargets(
+		Graphics::State->SetRenderTargets(
 			1,
 			Graphics::BackBufferRTV.GetAddressOf(),
 			Graphics::DepthBufferDSV.Get());
 
 		// unbind SRVs
-		ID3D11ShaderResourceView* nullSRVs[128] = {};
-		Graphics::Context->PSSetShaderResources(0, 128, nullSRVs);
+		Graphics::State->ClearShaderResources(RENDER_STATE_STAGE_PIXEL);
 	}
 }
 
@@ -724,19 +891,361 @@ void Game::BuildUI()
 
 	m_spActiveCamera = m_vCameras[e];
 
+	// display how many meshes each pass drew at each level of detail
+	if (ImGui::CollapsingHeader("Levels of Detail", ImGuiTreeNodeFlags_None))
+	{
+		unsigned int vMainDraws[MESH_MAX_LODS] = {};
+		unsigned int uMainTriangles = 0;
+		unsigned int uFullTriangles = 0;
+		EntityWorld::GetDefault()->ForEach(ComponentMaskOf<EntityRender, EntityLod>(), [&](const EntityChunk& a_Chunk)
+		{
+			const EntityRender* pRenders = a_Chunk.Get<EntityRender>();
+			const EntityLod* pLods = a_Chunk.Get<EntityLod>();
+			for (uint32_t i = 0; i < a_Chunk.Count; i++)
+			{
+				vMainDraws[pLods[i].Lod]++;
+				uMainTriangles += pRenders[i].Mesh->GetLod(pLods[i].Lod).IndexCount / 3;
+				uFullTriangles += pRenders[i].Mesh->GetLod(0).IndexCount / 3;
+			}
+		});
+		unsigned int vShadowDraws[MESH_MAX_LODS] = {};
+		for (auto& e : m_vShadowMaps)
+		{
+			std::vector<unsigned int> vCounts = e.GetLodDrawCounts();
+			for (size_t l = 0; l < vCounts.size(); l++)
+				vShadowDraws[l] += vCounts[l];
+		}
+
+		ImGui::Indent();
+		ImGui::Text("Main pass: %u of %u triangles", uMainTriangles, uFullTriangles);
+		for (int l = 0; l < MESH_MAX_LODS; l++)
+			ImGui::Text("  LOD %d: %u main draws, %u shadow draws", l, vMainDraws[l], vShadowDraws[l]);
+		ImGui::Unindent();
+	}
+
+	// display how long the assets took to load
+	if (ImGui::CollapsingHeader("Asset Loading", ImGuiTreeNodeFlags_None))
+	{
+		ImGui::Indent();
+		ImGui::Text("Time to first frame: %.1f ms", m_dFirstFrameMilliseconds);
+		if (m_spAssetLoader->GetPendingCount() > 0)
+			ImGui::Text("%u assets still loading on %u threads", m_spAssetLoader->GetPendingCount(), m_spAssetLoader->GetThreadCount());
+		else
+			ImGui::Text("All assets loaded after %.1f ms (%u threads)", m_spAssetLoader->GetAllLoadedMilliseconds(), m_spAssetLoader->GetThreadCount());
+
+		for (const AssetLoadRecord& record : m_spAssetLoader->GetRecords())
+		{
+			if (!record.Done)
+				ImGui::Text("%s: loading", record.Name.c_str());
+			else if (record.Failed)
+				ImGui::Text("%s: failed, kept the placeholder", record.Name.c_str());
+			else
+				ImGui::Text("%s%s: %.1f ms (queued %.1f, load %.1f of which mips %.1f, upload %.1f)", record.Name.c_str(), record.Cooked ? " (cooked)" : "",
+					record.TotalMilliseconds, record.WaitMilliseconds, record.LoadMilliseconds, record.MipMilliseconds, record.UploadMilliseconds);
+		}
+
+		// time the CPU mip generator on a 4K image, down to 1x1
+		if (ImGui::Button("Benchmark 4K mip chain"))
+			m_MipBenchmark = BenchmarkMipChain(4096);
+		if (m_MipBenchmark.Size > 0)
+		{
+			double dPixels = (double)m_MipBenchmark.Size * m_MipBenchmark.Size;
+			ImGui::Text("Box, 1 thread: %.1f ms (%.0f M pixels/s)", m_MipBenchmark.BoxMilliseconds, dPixels / (m_MipBenchmark.BoxMilliseconds * 1000.0));
+			ImGui::Text("Box, %u threads: %.1f ms (%.0f M pixels/s)", m_MipBenchmark.Threads, m_MipBenchmark.BoxThreadedMilliseconds,
+				dPixels / (m_MipBenchmark.BoxThreadedMilliseconds * 1000.0));
+			ImGui::Text("Kaiser, 1 thread: %.1f ms (%.0f M pixels/s)", m_MipBenchmark.KaiserMilliseconds, dPixels / (m_MipBenchmark.KaiserMilliseconds * 1000.0));
+			ImGui::Text("Kaiser, %u threads: %.1f ms (%.0f M pixels/s)", m_MipBenchmark.Threads, m_MipBenchmark.KaiserThreadedMilliseconds,
+				dPixels / (m_MipBenchmark.KaiserThreadedMilliseconds * 1000.0));
+			ImGui::Text("Scalar box, 1 thread: %.1f ms (%.0f M pixels/s)", m_MipBenchmark.ScalarMilliseconds, dPixels / (m_MipBenchmark.ScalarMilliseconds * 1000.0));
+			ImGui::Text("Largest box difference from scalar: %d", m_MipBenchmark.MaxBoxError);
+		}
+		ImGui::Unindent();
+	}
+
+	// display how much of the texture budget the streamed mips take
+	if (ImGui::CollapsingHeader("Texture Streaming", ImGuiTreeNodeFlags_None))
+	{
+		ImGui::Indent();
+		TextureStreamingStats stats = m_spTextureStreamer->GetStats();
+		int nBudgetMB = (int)(stats.BudgetBytes >> 20);
+		if (ImGui::SliderInt("Budget (MB)", &nBudgetMB, 1, 1024))
+			m_spTextureStreamer->SetBudget((size_t)nBudgetMB << 20);
+		ImGui::Text("Resident: %.1f MB of %.1f MB with every mip", stats.ResidentBytes / 1048576.0, stats.FullBytes / 1048576.0);
+		ImGui::Text("%u textures, %u requests pending", stats.Textures, stats.PendingRequests);
+		ImGui::Text("%u mips streamed in, %u evicted", stats.StreamedLevels, stats.EvictedLevels);
+		ImGui::Unindent();
+	}
+
+	// display how full and fragmented the shared geometry buffers are
+	if (ImGui::CollapsingHeader("Geometry Pool", ImGuiTreeNodeFlags_None))
+	{
+		ImGui::Indent();
+		GeometryPoolStats stats = GeometryPool::GetStats();
+		ImGui::Text("%u meshes, %u buffer reallocations", stats.Allocations, stats.Grows);
+		ImGui::Text("Last frame: %u draws, %u buffer binds", stats.Draws, stats.BufferBinds);
+		const char* names[3] = { "Vertices", "16-bit indices", "32-bit indices" };
+		const GeometryPoolBufferStats* pBuffers[3] = { &stats.Vertices, &stats.ShortIndices, &stats.LongIndices };
+		for (int i = 0; i < 3; i++)
+		{
+			const GeometryPoolBufferStats& buffer = *pBuffers[i];
+			if (buffer.Capacity == 0)
+				continue;
+
+			// fragmentation: how much of the free space the largest free range is not
+			unsigned int uFree = buffer.Capacity - buffer.Used;
+			ImGui::Text("%s: %u of %u (%.1f%%), %.2f MB", names[i], buffer.Used, buffer.Capacity,
+				100.0 * buffer.Used / buffer.Capacity, buffer.Bytes / 1048576.0);
+			ImGui::Text("  %u free ranges, largest %u, %.1f%% fragmented", buffer.FreeRanges, buffer.LargestFree,
+				uFree > 0 ? 100.0 * (uFree - buffer.LargestFree) / uFree : 0.0);
+		}
+		ImGui::Unindent();
+	}
+
+	// display the shape of the transform hierarchy and what the last update recomputed
+	if (ImGui::CollapsingHeader("Transform Hierarchy", ImGuiTreeNodeFlags_None))
+	{
+		ImGui::Indent();
+		TransformHierarchyStats stats = TransformHierarchy::GetDefault()->GetStats();
+		ImGui::Text("%u transforms, %u roots, %u re-sorts", stats.Nodes, stats.Roots, stats.Reorders);
+		ImGui::Text("Last update: %u subtrees, %u world matrices", stats.DirtyRanges, stats.UpdatedNodes);
+
+		// time updates of large hierarchies against a pointer-based scene graph
+		if (ImGui::Button("Benchmark 128K deep"))
+			m_DeepHierarchyBenchmark = BenchmarkTransformHierarchy(131072, 1);
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark 128K wide"))
+			m_WideHierarchyBenchmark = BenchmarkTransformHierarchy(131072, 8);
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark 100K flat"))
+			m_FlatHierarchyBenchmark = BenchmarkTransformHierarchy(100000, 0);
+		const char* names[3] = { "Deep", "Wide", "Flat" };
+		const TransformHierarchyBenchmark* pBenchmarks[3] = { &m_DeepHierarchyBenchmark, &m_WideHierarchyBenchmark, &m_FlatHierarchyBenchmark };
+		for (int i = 0; i < 3; i++)
+		{
+			const TransformHierarchyBenchmark& benchmark = *pBenchmarks[i];
+			if (benchmark.Nodes == 0)
+				continue;
+
+			ImGui::Text("%s: %u nodes, depth %u", names[i], benchmark.Nodes, benchmark.Depth);
+			ImGui::Text("  All moved: %.3f ms on %u threads, %.3f ms on 1, scene graph %.3f ms (%.1fx)", benchmark.FullMilliseconds,
+				benchmark.Threads, benchmark.SingleThreadMilliseconds, benchmark.PointerMilliseconds, benchmark.PointerMilliseconds / benchmark.FullMilliseconds);
+			ImGui::Text("  1%% moved: %.3f ms", benchmark.PartialMilliseconds);
+		}
+		ImGui::Unindent();
+	}
+
+	// display what the passes draw from and how long a frame takes on the CPU
+	if (ImGui::CollapsingHeader("Render List", ImGuiTreeNodeFlags_None))
+	{
+		ImGui::Indent();
+		ImGui::Text("%zu draw packets, %u meshes, %u materials, built in %.3f ms", m_RenderList.GetPackets().size(),
+			m_RenderList.GetMeshCount(), m_RenderList.GetMaterialCount(), m_RenderList.GetBuildMilliseconds());
+		ImGui::Text("CPU: update %.3f ms, draw %.3f ms", m_dUpdateMilliseconds, m_dDrawMilliseconds);
+		ImGui::Text("Main pass changes: %u shaders, %u materials, %u meshes", m_MainStateChanges.Shaders,
+			m_MainStateChanges.Materials, m_MainStateChanges.Meshes);
+		ImGui::Text("  unsorted: %u shaders, %u materials, %u meshes", m_UnsortedStateChanges.Shaders,
+			m_UnsortedStateChanges.Materials, m_UnsortedStateChanges.Meshes);
+		ImGui::Text("Main pass instancing: %u packets in %u draws, %zu draws in all", m_uInstancedPackets, m_uInstancedDraws,
+			m_vDrawKeys.size() - m_uInstancedPackets + m_uInstancedDraws);
+		InstanceBufferStats instanceStats = InstanceBuffer::GetStats();
+		ImGui::Text("Instance buffer: %u instances written in %u maps, room for %u (%.2f MB, %u grows)", instanceStats.Instances,
+			instanceStats.Maps, instanceStats.Capacity, instanceStats.Bytes / (1024.0 * 1024.0), instanceStats.Grows);
+
+		// time the key sort on a large random frame
+		if (ImGui::Button("Benchmark sorting 1M draws"))
+			m_DrawSortBenchmark = BenchmarkDrawSort(1000000);
+		if (m_DrawSortBenchmark.Keys > 0)
+		{
+			ImGui::Text("%u keys%s", m_DrawSortBenchmark.Keys, m_DrawSortBenchmark.Correct ? "" : " (orders disagree!)");
+			ImGui::Text("Radix sort: %.3f ms, std::sort %.3f ms (%.1fx)", m_DrawSortBenchmark.RadixMilliseconds,
+				m_DrawSortBenchmark.StdSortMilliseconds, m_DrawSortBenchmark.StdSortMilliseconds / m_DrawSortBenchmark.RadixMilliseconds);
+			ImGui::Text("Unsorted: %u shaders, %u materials, %u meshes", m_DrawSortBenchmark.Unsorted.Shaders,
+				m_DrawSortBenchmark.Unsorted.Materials, m_DrawSortBenchmark.Unsorted.Meshes);
+			ImGui::Text("Sorted: %u shaders, %u materials, %u meshes", m_DrawSortBenchmark.Sorted.Shaders,
+				m_DrawSortBenchmark.Sorted.Materials, m_DrawSortBenchmark.Sorted.Meshes);
+		}
+
+		// load the scene up to measure the frame time with many entities
+		if (ImGui::Button("Spawn 10K entities"))
+		{
+			std::vector<std::pair<std::shared_ptr<Mesh>, std::shared_ptr<Material>>> vLooks;
+			for (size_t i = 0; i < (std::min)(m_vEntities.size(), (size_t)6); i++)
+				vLooks.push_back({ m_vEntities[i].GetMesh(), m_vEntities[i].GetMaterial() });
+			for (int i = 0; i < 10000; i++)
+			{
+				m_vEntities.push_back(Entity(vLooks[i % vLooks.size()].first, vLooks[i % vLooks.size()].second));
+				m_vEntities.back().GetTransform()->SetPosition((i % 100 - 50) * 3.0f, -10.0f, (i / 100) * 3.0f);
+			}
+		}
+
+		// one mesh and material many times over, which the main and shadow passes draw instanced
+		ImGui::SameLine();
+		if (ImGui::Button("Spawn 100K spheres"))
+		{
+			for (int i = 0; i < 100000; i++)
+			{
+				m_vEntities.push_back(Entity(m_vEntities[2].GetMesh(), m_vEntities[2].GetMaterial()));
+				m_vEntities.back().GetTransform()->SetPosition((i % 400 - 200) * 1.5f, -14.0f, (i / 400) * 1.5f);
+			}
+		}
+		ImGui::Unindent();
+	}
+
+	// display how the frame's jobs spread over the workers, and how the scheduler scales with them
+	if (ImGui::CollapsingHeader("Jobs", ImGuiTreeNodeFlags_None))
+	{
+		ImGui::Indent();
+		JobSchedulerStats stats = m_spJobs->GetStats();
+		ImGui::Text("%u workers: %llu jobs, %llu stolen, %llu run on the spot, %llu sleeps", stats.Threads,
+			stats.Jobs, stats.Steals, stats.Inline, stats.Sleeps);
+
+		// time the same work on 1, 2, 4 ... 64 workers
+		if (ImGui::Button("Benchmark 256K matrices on 1-64 threads"))
+			m_JobBenchmark = BenchmarkJobScheduler(262144);
+		if (m_JobBenchmark.Cases > 0)
+		{
+			ImGui::Text("%u matrices, %u hardware threads", m_JobBenchmark.Items, m_JobBenchmark.HardwareThreads);
+			for (unsigned int i = 0; i < m_JobBenchmark.Cases; i++)
+			{
+				const JobScalingCase& scaling = m_JobBenchmark.Results[i];
+				ImGui::Text("  %2u threads: %.3f ms (%.2fx), %.3f us per empty job, %llu steals", scaling.Threads,
+					scaling.Milliseconds, scaling.Speedup, scaling.JobMicroseconds, scaling.Steals);
+			}
+		}
+		ImGui::Unindent();
+	}
+
+	// display how many state changes the cache let through and dropped
+	if (ImGui::CollapsingHeader("Render State", ImGuiTreeNodeFlags_None))
+	{
+		ImGui::Indent();
+		RenderStateStats stats = Graphics::State->GetStats();
+		const char* names[RENDER_STATE_CALL_KINDS] = { "Shaders", "Constant buffers", "Shader resources", "Samplers", "Input assembler", "Rasterizer/depth" };
+		unsigned int uIssued = 0;
+		unsigned int uSkipped = 0;
+		for (int i = 0; i < RENDER_STATE_CALL_KINDS; i++)
+		{
+			ImGui::Text("%s: %u issued, %u skipped", names[i], stats.Issued[i], stats.Skipped[i]);
+			uIssued += stats.Issued[i];
+			uSkipped += stats.Skipped[i];
+		}
+		ImGui::Text("Last frame: %u issued, %u skipped", uIssued, uSkipped);
+
+		// play random frames through a cache over a recording context and check it kept the state right
+		if (ImGui::Button("Verify 100K draws"))
+			m_RenderStateCheck = VerifyRenderStateCache(100000);
+		if (m_RenderStateCheck.Draws > 0)
+		{
+			ImGui::Text("%u draws, %u calls: %u issued, %u skipped", m_RenderStateCheck.Draws, m_RenderStateCheck.Calls,
+				m_RenderStateCheck.Issued, m_RenderStateCheck.Skipped);
+			ImGui::Text("%u mismatches", m_RenderStateCheck.Mismatches);
+		}
+		ImGui::Unindent();
+	}
+
+	// display how many entities each pass culled against its view volume
+	if (ImGui::CollapsingHeader("Frustum Culling", ImGuiTreeNodeFlags_None))
+	{
+		ImGui::Indent();
+		ImGui::Text("Main pass: %u visible, %u culled", m_MainCullStats.Visible, m_MainCullStats.Culled);
+		for (int i = 0; i < m_vShadowMaps.size(); i++)
+		{
+			FrustumCullStats stats = m_vShadowMaps[i].GetCullStats();
+			ImGui::Text("Shadow map %d: %u visible, %u culled", i, stats.Visible, stats.Culled);
+		}
+
+		// time the batched test on a large random scene
+		if (ImGui::Button("Benchmark 1M boxes"))
+			m_CullBenchmark = BenchmarkFrustumCull(1000000);
+		if (m_CullBenchmark.BoxCount > 0)
+		{
+			ImGui::Text("%zu boxes, %zu visible%s", m_CullBenchmark.BoxCount, m_CullBenchmark.Visible,
+				m_CullBenchmark.Mismatches > 0 ? " (results disagree!)" : "");
+			ImGui::Text("Batched: %.3f ms (%.1f M boxes/s)", m_CullBenchmark.SimdMilliseconds,
+				m_CullBenchmark.BoxCount / (m_CullBenchmark.SimdMilliseconds * 1000.0));
+			ImGui::Text("Scalar: %.3f ms (%.1f M boxes/s)", m_CullBenchmark.ScalarMilliseconds,
+				m_CullBenchmark.BoxCount / (m_CullBenchmark.ScalarMilliseconds * 1000.0));
+		}
+		ImGui::Unindent();
+	}
+
 	// display info about entities
 	if(ImGui::CollapsingHeader("Entities", ImGuiTreeNodeFlags_None))
 	{
 		ImGui::Indent();
+		EntityWorldStats worldStats = EntityWorld::GetDefault()->GetStats();
+		ImGui::Text("%u entities in %u archetypes, %u chunks (%.1f KB)", worldStats.Entities, worldStats.Archetypes,
+			worldStats.Chunks, worldStats.Bytes / 1024.0);
+
+		// time iterating and updating large worlds against entities made of shared_ptrs
+		if (ImGui::Button("Benchmark 10K/100K/1M entities"))
+		{
+			m_vEntityWorldBenchmarks.clear();
+			for (unsigned int uEntities : { 10000u, 100000u, 1000000u })
+				m_vEntityWorldBenchmarks.push_back(BenchmarkEntityWorld(uEntities));
+		}
+		for (const EntityWorldBenchmark& benchmark : m_vEntityWorldBenchmarks)
+		{
+			ImGui::Text("%u entities, %u archetypes, %u chunks%s", benchmark.Entities, benchmark.Archetypes, benchmark.Chunks,
+				benchmark.Checksum < 0.0 ? " (layouts disagree!)" : "");
+			ImGui::Text("  Iterate: %.3f ms, shared_ptrs %.3f ms (%.1fx)", benchmark.IterateMilliseconds,
+				benchmark.PointerIterateMilliseconds, benchmark.PointerIterateMilliseconds / benchmark.IterateMilliseconds);
+			ImGui::Text("  Update: %.3f ms, shared_ptrs %.3f ms (%.1fx)", benchmark.UpdateMilliseconds,
+				benchmark.PointerUpdateMilliseconds, benchmark.PointerUpdateMilliseconds / benchmark.UpdateMilliseconds);
+		}
+
 		for (int i = 0; i < m_vEntities.size(); i++)
 		{
 			//create unique header name
-			std::string sHeaderName = "Entity " + std::to_string(i);
+			std::string sHeaderName = "Entity " + std::to_string(i) + " (id " + std::to_string(m_vEntities[i].GetId()) + ")";
 			if (ImGui::CollapsingHeader(sHeaderName.c_str(), ImGuiTreeNodeFlags_None))
 			{
 				ImGui::Indent();
-				ImGui::Text("Verticies %u", m_vEntities[i].GetMesh()->GetVertexCount());
-				ImGui::Text("Indicies %u", m_vEntities[i].GetMesh()->GetIndexCount());
+				ImGui::Text("Verticies %u (%u before welding)", m_vEntities[i].GetMesh()->GetVertexCount(), m_vEntities[i].GetMesh()->GetUnweldedVertexCount());
+				ImGui::Text("Indicies %u (all levels of detail)", m_vEntities[i].GetMesh()->GetIndexCount());
+				ImGui::Text("ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+					m_vEntities[i].GetMesh()->GetSourceACMR(), m_vEntities[i].GetMesh()->GetACMR(),
+					m_vEntities[i].GetMesh()->GetSourceATVR(), m_vEntities[i].GetMesh()->GetATVR());
+				if (m_vEntities[i].GetMesh()->GetTangentThreadCount() > 0)
+				{
+					// throughput of the tangent generator
+					double dSeconds = m_vEntities[i].GetMesh()->GetTangentMilliseconds() / 1000.0;
+					ImGui::Text("Tangents %.2f ms on %u threads (%.0f tris/s), %u mirrored verticies",
+						m_vEntities[i].GetMesh()->GetTangentMilliseconds(),
+						m_vEntities[i].GetMesh()->GetTangentThreadCount(),
+						dSeconds > 0.0 ? m_vEntities[i].GetMesh()->GetLod(0).IndexCount / 3 / dSeconds : 0.0,
+						m_vEntities[i].GetMesh()->GetMirroredVertexCount());
+				}
+				ImGui::Text("LOD %u of %u drawn", m_vEntities[i].GetLod(), m_vEntities[i].GetMesh()->GetLodCount());
+				if (m_vEntities[i].GetMesh()->GetMeshletCount() > 0)
+				{
+					// last CPU cluster cull of this mesh (shared by every entity that uses it)
+					ClusterCullStats clusterStats = m_vEntities[i].GetMesh()->GetClusterCullStats();
+					ImGui::Text("Clusters %u: %u visible, %u back-facing, %u outside frustum (%u of %u tris)",
+						m_vEntities[i].GetMesh()->GetMeshletCount(), clusterStats.Visible, clusterStats.BackFacing, clusterStats.OutsideFrustum,
+						clusterStats.VisibleTriangles, m_vEntities[i].GetMesh()->GetLod(0).IndexCount / 3);
+				}
+				for (unsigned int l = 0; l < m_vEntities[i].GetMesh()->GetLodCount(); l++)
+				{
+					MeshLod lod = m_vEntities[i].GetMesh()->GetLod(l);
+					ImGui::Text("  LOD %u: %u tris, error %.4f", l, lod.IndexCount / 3, lod.Error);
+				}
+				ImGui::Text("Vertex %u bytes, %u-bit indicies",
+					m_vEntities[i].GetMesh()->GetVertexStride(), m_vEntities[i].GetMesh()->GetIndexStride() * 8);
+				VertexPackingError packingError = m_vEntities[i].GetMesh()->GetPackingError();
+				ImGui::Text("Packing error: pos %.5f, normal %.3f deg, tangent %.3f deg, uv %.5f",
+					packingError.Position, packingError.Normal, packingError.Tangent, packingError.UV);
+				if (m_vEntities[i].GetMesh()->GetFileBytes() > 0)
+				{
+					// load throughput of the OBJ loader or the mesh cache
+					double dSeconds = m_vEntities[i].GetMesh()->GetLoadMilliseconds() / 1000.0;
+					ImGui::Text("%s %.2f ms on %u threads (%.1f MB/s, %.0f tris/s)",
+						m_vEntities[i].GetMesh()->GetLoadedFromCache() ? "Cache hit" : "Parsed",
+						m_vEntities[i].GetMesh()->GetLoadMilliseconds(),
+						m_vEntities[i].GetMesh()->GetLoadThreadCount(),
+						dSeconds > 0.0 ? m_vEntities[i].GetMesh()->GetFileBytes() / (1024.0 * 1024.0) / dSeconds : 0.0,
+						dSeconds > 0.0 ? m_vEntities[i].GetMesh()->GetLod(0).IndexCount / 3 / dSeconds : 0.0);
+				}
 
 				// create a local variable that can be passed into ImGui
 				XMFLOAT3 f3EntityPosition = m_vEntities[i].GetTransform()->GetPosition();
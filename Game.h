@@ -10,6 +10,13 @@
 #include "Lights.h"
 #include "Sky.h"
 #include "ShadowMap.h"
+#include "FrustumCulling.h"
+#include "RenderList.h"
+#include "RenderStateCache.h"
+#include "AssetLoader.h"
+#include "TextureMips.h"
+#include "JobScheduler.h"
+#include <chrono>
 
 class Game
 {
@@ -35,6 +42,7 @@ private:
 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateSRVTextureArray(std::vector<Microsoft::WRL::ComPtr<ID3D11Texture2D>> a_vTextures);
 	void MakePostProcessRenderTargets();
+	void PrepareMainView();
 #pragma endregion
 
 	
@@ -82,11 +90,53 @@ private:
 #pragma endregion
 
 #pragma region Game Objects
-	std::vector<Entity> m_vEntities;
+	std::vector<Entity> m_vEntities; //owners of the default EntityWorld's drawn entities
 	std::vector<std::shared_ptr<Camera>> m_vCameras;
 	std::shared_ptr<Camera> m_spActiveCamera;
 	std::vector<Light> m_vLights;
 	std::shared_ptr<Sky> m_spSkybox;
 #pragma endregion
+
+#pragma region Asset Loading
+	std::shared_ptr<AssetLoader> m_spAssetLoader;
+	std::shared_ptr<TextureStreamer> m_spTextureStreamer; //owns the mips of the loader's 2D textures
+	std::chrono::high_resolution_clock::time_point m_tpInitializeStart;
+	double m_dFirstFrameMilliseconds = 0.0; //from Initialize() until the first frame was presented
+	MipChainBenchmark m_MipBenchmark = {};
+#pragma endregion
+
+#pragma region Rendering
+	RenderList m_RenderList; //what every pass draws, rebuilt at the end of each update
+	double m_dUpdateMilliseconds = 0.0; //CPU time of the last Update()
+	double m_dDrawMilliseconds = 0.0; //CPU time of the last Draw() up to presenting
+	std::vector<uint64_t> m_vDrawKeys; //draw keys of the main pass's visible packets
+	std::vector<uint32_t> m_vDrawOrder; //the main pass's visible packets, in the order they're drawn
+	DrawKeySorter m_DrawSorter;
+	std::vector<DrawBatch> m_vDrawBatches; //runs of the main pass's draw order that bind the same state and geometry
+	unsigned int m_uInstancedDraws = 0; //instanced draws of the main pass last frame
+	unsigned int m_uInstancedPackets = 0; //packets they drew
+	DrawStateChanges m_MainStateChanges = {}; //state changes of the main pass last frame
+	DrawStateChanges m_UnsortedStateChanges = {}; //what they would have been in the list's order
+	DrawSortBenchmark m_DrawSortBenchmark = {};
+	RenderStateCacheCheck m_RenderStateCheck = {};
+#pragma endregion
+
+#pragma region Culling
+	std::vector<uint8_t> m_vEntityVisible; //which draw packets the active camera saw last frame
+	FrustumCullStats m_MainCullStats = {};
+	FrustumCullBenchmark m_CullBenchmark = {};
+#pragma endregion
+
+#pragma region Jobs
+	std::shared_ptr<JobScheduler> m_spJobs; //runs the update and the views' preparation; the main thread is its first worker
+	JobSchedulerBenchmark m_JobBenchmark = {};
+#pragma endregion
+
+#pragma region Transforms
+	TransformHierarchyBenchmark m_DeepHierarchyBenchmark = {};
+	TransformHierarchyBenchmark m_WideHierarchyBenchmark = {};
+	TransformHierarchyBenchmark m_FlatHierarchyBenchmark = {};
+	std::vector<EntityWorldBenchmark> m_vEntityWorldBenchmarks;
+#pragma endregion
 };
 
@@ -0,0 +1,426 @@
+#include "GeometryPool.h"
+#include "Graphics.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <utility>
+
+namespace GeometryPool
+{
+	// Annonymous namespace to hold the pool's state
+	// only accessible in this file
+	namespace
+	{
+		// --------------------------------------------------------
+		// One of the shared buffers and the ranges of it (in
+		// elements) that no allocation holds
+		// --------------------------------------------------------
+		struct PoolBuffer
+		{
+			Microsoft::WRL::ComPtr<ID3D11Buffer> Buffer;
+			UINT BindFlags;
+			unsigned int Stride;
+			unsigned int Capacity;
+			unsigned int Used;
+			std::map<unsigned int, unsigned int> Free; //element count by first element, never adjacent
+		};
+
+		PoolBuffer vertices = { nullptr, D3D11_BIND_VERTEX_BUFFER, 0, 0, 0, {} };
+		PoolBuffer shortIndices = { nullptr, D3D11_BIND_INDEX_BUFFER, sizeof(uint16_t), 0, 0, {} };
+		PoolBuffer longIndices = { nullptr, D3D11_BIND_INDEX_BUFFER, sizeof(uint32_t), 0, 0, {} };
+		unsigned int allocations = 0;
+		unsigned int grows = 0;
+
+		// this frame's counts, and last frame's
+		unsigned int draws = 0;
+		unsigned int binds = 0;
+		unsigned int lastDraws = 0;
+		unsigned int lastBinds = 0;
+		unsigned int instances = 0;
+		unsigned int lastInstances = 0;
+
+		/// <summary>
+		/// Reallocates a buffer with room for at least a_uCapacity elements, copying its contents over
+		/// </summary>
+		/// <returns>False if the new buffer couldn't be created, in which case the old one is kept</returns>
+		bool Grow(PoolBuffer& a_Buffer, unsigned int a_uCapacity)
+		{
+			D3D11_BUFFER_DESC desc = {};
+			desc.Usage = D3D11_USAGE_DEFAULT;	// written a range at a time by UpdateSubresource
+			desc.ByteWidth = a_uCapacity * a_Buffer.Stride;
+			desc.BindFlags = a_Buffer.BindFlags;
+			Microsoft::WRL::ComPtr<ID3D11Buffer> cpBuffer;
+			if ((uint64_t)a_uCapacity * a_Buffer.Stride > UINT32_MAX || FAILED(Graphics::Device->CreateBuffer(&desc, nullptr, cpBuffer.GetAddressOf())))
+				return false;
+
+			// offsets stay the same, so every allocation remains valid
+			if (a_Buffer.Buffer)
+			{
+				D3D11_BOX box = { 0, 0, 0, a_Buffer.Capacity * a_Buffer.Stride, 1, 1 };
+				Graphics::Context->CopySubresourceRegion(cpBuffer.Get(), 0, 0, 0, 0, a_Buffer.Buffer.Get(), 0, &box);
+				grows++;
+			}
+
+			// the new space joins the free range at the end, if there is one
+			unsigned int uFirst = a_Buffer.Capacity;
+			unsigned int uCount = a_uCapacity - a_Buffer.Capacity;
+			if (!a_Buffer.Free.empty())
+			{
+				auto last = std::prev(a_Buffer.Free.end());
+				if (last->first + last->second == uFirst)
+				{
+					uFirst = last->first;
+					uCount += last->second;
+				}
+			}
+			a_Buffer.Free[uFirst] = uCount;
+			a_Buffer.Buffer = cpBuffer;
+			a_Buffer.Capacity = a_uCapacity;
+			return true;
+		}
+
+		/// <summary>
+		/// Takes the smallest free range that fits, growing the buffer if none does, and uploads the data into it
+		/// </summary>
+		/// <param name="a_Buffer">Buffer to allocate from</param>
+		/// <param name="a_pData">Elements to upload</param>
+		/// <param name="a_uCount">Number of elements (at least 1)</param>
+		/// <param name="a_uInitialCapacity">Capacity the buffer is created with</param>
+		/// <param name="a_uFirst">Receives the first element of the range</param>
+		/// <returns>False if the buffer couldn't be grown</returns>
+		bool AllocateRange(PoolBuffer& a_Buffer, const void* a_pData, unsigned int a_uCount, unsigned int a_uInitialCapacity, unsigned int& a_uFirst)
+		{
+			// best fit keeps the large ranges for large meshes
+			auto best = a_Buffer.Free.end();
+			for (auto it = a_Buffer.Free.begin(); it != a_Buffer.Free.end(); ++it)
+				if (it->second >= a_uCount && (best == a_Buffer.Free.end() || it->second < best->second))
+					best = it;
+
+			if (best == a_Buffer.Free.end())
+			{
+				unsigned int uCapacity = (std::max)(a_Buffer.Capacity * 2, a_uInitialCapacity);
+				while (uCapacity - a_Buffer.Capacity < a_uCount)
+					uCapacity *= 2;
+				if (!Grow(a_Buffer, uCapacity))
+					return false;
+
+				// only the free range at the end can fit now
+				best = std::prev(a_Buffer.Free.end());
+				if (best->second < a_uCount)
+					return false;
+			}
+
+			a_uFirst = best->first;
+			unsigned int uLeft = best->second - a_uCount;
+			a_Buffer.Free.erase(best);
+			if (uLeft > 0)
+				a_Buffer.Free[a_uFirst + a_uCount] = uLeft;
+			a_Buffer.Used += a_uCount;
+
+			D3D11_BOX box = { a_uFirst * a_Buffer.Stride, 0, 0, (a_uFirst + a_uCount) * a_Buffer.Stride, 1, 1 };
+			Graphics::Context->UpdateSubresource(a_Buffer.Buffer.Get(), 0, &box, a_pData, 0, 0);
+			return true;
+		}
+
+		/// <summary>
+		/// Returns a range to a buffer, merging it with the free ranges on either side
+		/// </summary>
+		void FreeRange(PoolBuffer& a_Buffer, unsigned int a_uFirst, unsigned int a_uCount)
+		{
+			a_Buffer.Used -= a_uCount;
+			auto next = a_Buffer.Free.lower_bound(a_uFirst);
+			if (next != a_Buffer.Free.end() && a_uFirst + a_uCount == next->first)
+			{
+				a_uCount += next->second;
+				next = a_Buffer.Free.erase(next);
+			}
+			if (next != a_Buffer.Free.begin())
+			{
+				auto previous = std::prev(next);
+				if (previous->first + previous->second == a_uFirst)
+				{
+					previous->second += a_uCount;
+					return;
+				}
+			}
+			a_Buffer.Free[a_uFirst] = a_uCount;
+		}
+
+		GeometryPoolBufferStats BufferStats(const PoolBuffer& a_Buffer)
+		{
+			GeometryPoolBufferStats stats = { a_Buffer.Capacity, a_Buffer.Used, (unsigned int)a_Buffer.Free.size(), 0, (size_t)a_Buffer.Capacity * a_Buffer.Stride };
+			for (const auto& range : a_Buffer.Free)
+				stats.LargestFree = (std::max)(stats.LargestFree, range.second);
+			return stats;
+		}
+
+		PoolBuffer& IndexBufferOf(const GeometryAllocation& a_Allocation)
+		{
+			return a_Allocation.GetIndexSize() == sizeof(uint16_t) ? shortIndices : longIndices;
+		}
+
+		DXGI_FORMAT IndexFormatOf(const GeometryAllocation& a_Allocation)
+		{
+			return a_Allocation.GetIndexSize() == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		}
+
+		/// <summary>
+		/// Sets the shared vertex buffer and an index buffer; the state cache skips whichever is already set
+		/// </summary>
+		void SetBuffers(ID3D11Buffer* a_pIndexBuffer, DXGI_FORMAT a_eIndexFormat)
+		{
+			binds += Graphics::State->SetVertexBuffer(0, vertices.Buffer.Get(), vertices.Stride, 0);
+			binds += Graphics::State->SetIndexBuffer(a_pIndexBuffer, a_eIndexFormat, 0);
+		}
+	}
+}
+
+/// <summary>
+/// Copies a mesh's GPU-ready vertices and indices into the shared buffers
+/// </summary>
+/// <param name="a_pVertexData">Vertex buffer contents</param>
+/// <param name="a_uVertexCount">Number of vertices</param>
+/// <param name="a_uVertexStride">Size of one vertex in bytes, the same for every mesh</param>
+/// <param name="a_pIndexData">Index buffer contents, relative to the mesh's first vertex</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_uIndexSize">Size of one index in bytes (2 or 4)</param>
+/// <returns>The mesh's ranges, invalid if a buffer couldn't grow or the mesh is empty</returns>
+GeometryAllocation GeometryPool::Allocate(const void* a_pVertexData, unsigned int a_uVertexCount, unsigned int a_uVertexStride,
+	const void* a_pIndexData, unsigned int a_uIndexCount, unsigned int a_uIndexSize)
+{
+	GeometryAllocation allocation;
+	if (a_uVertexCount == 0 || a_uIndexCount == 0)
+		return allocation;
+
+	// the vertex buffer is created for the first mesh's vertex format
+	if (vertices.Stride == 0)
+		vertices.Stride = a_uVertexStride;
+	if (vertices.Stride != a_uVertexStride)
+		return allocation;
+
+	PoolBuffer& indices = a_uIndexSize == sizeof(uint16_t) ? shortIndices : longIndices;
+	unsigned int uBaseVertex, uFirstIndex;
+	if (!AllocateRange(vertices, a_pVertexData, a_uVertexCount, GEOMETRY_POOL_INITIAL_VERTICES, uBaseVertex))
+		return allocation;
+	if (!AllocateRange(indices, a_pIndexData, a_uIndexCount, GEOMETRY_POOL_INITIAL_INDICES, uFirstIndex))
+	{
+		FreeRange(vertices, uBaseVertex, a_uVertexCount);
+		return allocation;
+	}
+
+	allocation.m_uBaseVertex = uBaseVertex;
+	allocation.m_uVertexCount = a_uVertexCount;
+	allocation.m_uFirstIndex = uFirstIndex;
+	allocation.m_uIndexCount = a_uIndexCount;
+	allocation.m_uIndexSize = indices.Stride;
+	allocations++;
+	return allocation;
+}
+
+/// <summary>
+/// Returns a mesh's ranges to the pool (the allocation does this when it is destroyed)
+/// </summary>
+/// <param name="a_Allocation">Allocation to free, invalid afterwards</param>
+void GeometryPool::Free(GeometryAllocation& a_Allocation)
+{
+	if (!a_Allocation.IsValid())
+		return;
+
+	FreeRange(vertices, a_Allocation.m_uBaseVertex, a_Allocation.m_uVertexCount);
+	FreeRange(IndexBufferOf(a_Allocation), a_Allocation.m_uFirstIndex, a_Allocation.m_uIndexCount);
+	a_Allocation.m_uIndexSize = 0;
+	allocations--;
+}
+
+/// <summary>
+/// Sets the shared vertex buffer and 16-bit index buffer, unless they're still set.
+/// Call at the start of every pass that draws meshes.
+/// </summary>
+void GeometryPool::Bind()
+{
+	SetBuffers(shortIndices.Buffer.Get(), DXGI_FORMAT_R16_UINT);
+}
+
+/// <summary>
+/// Draws a range of a mesh's indices. Switches index buffers only for meshes with
+/// the other index size; nothing is set for the common case.
+/// </summary>
+/// <param name="a_Allocation">Mesh to draw</param>
+/// <param name="a_uIndexStart">First index, relative to the mesh's</param>
+/// <param name="a_uIndexCount">Number of indices to draw</param>
+void GeometryPool::Draw(const GeometryAllocation& a_Allocation, unsigned int a_uIndexStart, unsigned int a_uIndexCount)
+{
+	if (!a_Allocation.IsValid())
+		return;
+
+	SetBuffers(IndexBufferOf(a_Allocation).Buffer.Get(), IndexFormatOf(a_Allocation));
+	Graphics::Context->DrawIndexed(a_uIndexCount, a_Allocation.GetFirstIndex() + a_uIndexStart, (INT)a_Allocation.GetBaseVertex());
+	draws++;
+}
+
+/// <summary>
+/// Draws a mesh's vertices with indices from a buffer of its own (like the survivors of cluster culling)
+/// </summary>
+/// <param name="a_Allocation">Mesh whose vertices the indices address</param>
+/// <param name="a_pIndexBuffer">Index buffer in the mesh's index size, relative to its first vertex</param>
+/// <param name="a_uIndexCount">Number of indices to draw, from the start of the buffer</param>
+void GeometryPool::DrawWithIndexBuffer(const GeometryAllocation& a_Allocation, ID3D11Buffer* a_pIndexBuffer, unsigned int a_uIndexCount)
+{
+	if (!a_Allocation.IsValid())
+		return;
+
+	SetBuffers(a_pIndexBuffer, IndexFormatOf(a_Allocation));
+	Graphics::Context->DrawIndexed(a_uIndexCount, 0, (INT)a_Allocation.GetBaseVertex());
+	draws++;
+}
+
+/// <summary>
+/// Draws a range of a mesh's indices once for each of a run of instances. The per-instance
+/// data is read from whatever is bound to vertex buffer slot 1 (see InstanceBuffer).
+/// </summary>
+/// <param name="a_Allocation">Mesh to draw</param>
+/// <param name="a_uIndexStart">First index, relative to the mesh's</param>
+/// <param name="a_uIndexCount">Number of indices to draw</param>
+/// <param name="a_uInstanceStart">First instance in the instance buffer</param>
+/// <param name="a_uInstanceCount">Number of instances to draw</param>
+void GeometryPool::DrawInstanced(const GeometryAllocation& a_Allocation, unsigned int a_uIndexStart, unsigned int a_uIndexCount,
+	unsigned int a_uInstanceStart, unsigned int a_uInstanceCount)
+{
+	if (!a_Allocation.IsValid() || a_uInstanceCount == 0)
+		return;
+
+	SetBuffers(IndexBufferOf(a_Allocation).Buffer.Get(), IndexFormatOf(a_Allocation));
+	Graphics::Context->DrawIndexedInstanced(a_uIndexCount, a_uInstanceCount, a_Allocation.GetFirstIndex() + a_uIndexStart,
+		(INT)a_Allocation.GetBaseVertex(), a_uInstanceStart);
+	draws++;
+	instances += a_uInstanceCount;
+}
+
+/// <summary>
+/// Closes the frame's draw, instance and bind counts (see GetStats)
+/// </summary>
+void GeometryPool::EndFrame()
+{
+	lastDraws = draws;
+	lastBinds = binds;
+	lastInstances = instances;
+	draws = 0;
+	binds = 0;
+	instances = 0;
+}
+
+/// <summary>
+/// Returns the occupancy of the buffers, and the draws and binds of the last frame
+/// </summary>
+/// <returns>Pool statistics</returns>
+GeometryPoolStats GeometryPool::GetStats()
+{
+	GeometryPoolStats stats = {};
+	stats.Vertices = BufferStats(vertices);
+	stats.ShortIndices = BufferStats(shortIndices);
+	stats.LongIndices = BufferStats(longIndices);
+	stats.Allocations = allocations;
+	stats.Grows = grows;
+	stats.Draws = lastDraws;
+	stats.BufferBinds = lastBinds;
+	stats.Instances = lastInstances;
+	return stats;
+}
+
+/// <summary>
+/// Creates an allocation that holds nothing
+/// </summary>
+GeometryAllocation::GeometryAllocation()
+{
+	m_uBaseVertex = 0;
+	m_uVertexCount = 0;
+	m_uFirstIndex = 0;
+	m_uIndexCount = 0;
+	m_uIndexSize = 0;
+}
+
+/// <summary>
+/// Returns the ranges to the pool
+/// </summary>
+GeometryAllocation::~GeometryAllocation()
+{
+	GeometryPool::Free(*this);
+}
+
+/// <summary>
+/// Takes over another allocation's ranges, leaving it empty
+/// </summary>
+GeometryAllocation::GeometryAllocation(GeometryAllocation&& a_Other) noexcept
+	: GeometryAllocation()
+{
+	*this = std::move(a_Other);
+}
+
+/// <summary>
+/// Frees this allocation's ranges and takes over another's, leaving it empty
+/// </summary>
+GeometryAllocation& GeometryAllocation::operator=(GeometryAllocation&& a_Other) noexcept
+{
+	if (this != &a_Other)
+	{
+		GeometryPool::Free(*this);
+		m_uBaseVertex = a_Other.m_uBaseVertex;
+		m_uVertexCount = a_Other.m_uVertexCount;
+		m_uFirstIndex = a_Other.m_uFirstIndex;
+		m_uIndexCount = a_Other.m_uIndexCount;
+		m_uIndexSize = a_Other.m_uIndexSize;
+		a_Other.m_uIndexSize = 0;
+	}
+	return *this;
+}
+
+#pragma region Getters
+/// <summary>
+/// Returns whether the allocation holds ranges of the pool
+/// </summary>
+bool GeometryAllocation::IsValid() const
+{
+	return m_uIndexSize != 0;
+}
+
+/// <summary>
+/// Returns the mesh's first vertex in the shared vertex buffer
+/// </summary>
+unsigned int GeometryAllocation::GetBaseVertex() const
+{
+	return m_uBaseVertex;
+}
+
+/// <summary>
+/// Returns the number of vertices allocated
+/// </summary>
+unsigned int GeometryAllocation::GetVertexCount() const
+{
+	return m_uVertexCount;
+}
+
+/// <summary>
+/// Returns the mesh's first index in the shared index buffer of its index size
+/// </summary>
+unsigned int GeometryAllocation::GetFirstIndex() const
+{
+	return m_uFirstIndex;
+}
+
+/// <summary>
+/// Returns the number of indices allocated
+/// </summary>
+unsigned int GeometryAllocation::GetIndexCount() const
+{
+	return m_uIndexCount;
+}
+
+/// <summary>
+/// Returns the size of one index in bytes, 0 if nothing is allocated
+/// </summary>
+unsigned int GeometryAllocation::GetIndexSize() const
+{
+	return m_uIndexSize;
+}
+#pragma endregion
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+// Elements the shared buffers start with; each doubles (keeping its contents) whenever an allocation doesn't fit
+#define GEOMETRY_POOL_INITIAL_VERTICES	(1 << 18)
+#define GEOMETRY_POOL_INITIAL_INDICES	(1 << 20)
+
+class GeometryAllocation;
+
+// --------------------------------------------------------
+// Occupancy of one of the pool's buffers, in elements
+// (vertices or indices)
+// --------------------------------------------------------
+struct GeometryPoolBufferStats
+{
+	unsigned int Capacity;
+	unsigned int Used;
+	unsigned int FreeRanges;	// holes between allocations, and the unused tail
+	unsigned int LargestFree;	// elements in the largest free range; far below Capacity - Used means fragmented
+	size_t Bytes;				// video memory the buffer takes
+};
+
+// --------------------------------------------------------
+// What the geometry pool holds and what it did last frame
+// --------------------------------------------------------
+struct GeometryPoolStats
+{
+	GeometryPoolBufferStats Vertices;
+	GeometryPoolBufferStats ShortIndices;	// 16-bit, for meshes of up to 65536 vertices
+	GeometryPoolBufferStats LongIndices;	// 32-bit
+	unsigned int Allocations;		// meshes in the pool
+	unsigned int Grows;				// times a buffer was reallocated larger so far
+	unsigned int Draws;				// draw calls last frame
+	unsigned int BufferBinds;		// IASetVertexBuffers/IASetIndexBuffer calls last frame
+	unsigned int Instances;			// instances drawn by instanced draw calls last frame
+};
+
+// --------------------------------------------------------
+// One vertex buffer and one index buffer per index size that
+// every mesh's geometry is sub-allocated from, so they are
+// bound once per pass instead of once per draw. A mesh is a
+// base vertex and a range of indices (relative to that base),
+// and draws with DrawIndexed's base vertex offset. Allocating
+// and freeing run on the thread that owns the device context.
+// --------------------------------------------------------
+namespace GeometryPool
+{
+	GeometryAllocation Allocate(const void* a_pVertexData, unsigned int a_uVertexCount, unsigned int a_uVertexStride,
+		const void* a_pIndexData, unsigned int a_uIndexCount, unsigned int a_uIndexSize);
+	void Free(GeometryAllocation& a_Allocation);
+
+	void Bind();
+	void Draw(const GeometryAllocation& a_Allocation, unsigned int a_uIndexStart, unsigned int a_uIndexCount);
+	void DrawWithIndexBuffer(const GeometryAllocation& a_Allocation, ID3D11Buffer* a_pIndexBuffer, unsigned int a_uIndexCount);
+	void DrawInstanced(const GeometryAllocation& a_Allocation, unsigned int a_uIndexStart, unsigned int a_uIndexCount,
+		unsigned int a_uInstanceStart, unsigned int a_uInstanceCount);
+	void EndFrame();
+
+	GeometryPoolStats GetStats();
+}
+
+// --------------------------------------------------------
+// A mesh's ranges in the geometry pool, returned to the
+// pool when the allocation is destroyed. Move-only, so a
+// mesh that takes over another's geometry frees its own.
+// --------------------------------------------------------
+class GeometryAllocation
+{
+public:
+	GeometryAllocation();
+	~GeometryAllocation();
+	GeometryAllocation(GeometryAllocation&& a_Other) noexcept;
+	GeometryAllocation& operator=(GeometryAllocation&& a_Other) noexcept;
+	GeometryAllocation(const GeometryAllocation&) = delete;
+	GeometryAllocation& operator=(const GeometryAllocation&) = delete;
+
+	// getters
+	bool IsValid() const;
+	unsigned int GetBaseVertex() const;
+	unsigned int GetVertexCount() const;
+	unsigned int GetFirstIndex() const;
+	unsigned int GetIndexCount() const;
+	unsigned int GetIndexSize() const;
+
+private:
+	friend GeometryAllocation GeometryPool::Allocate(const void*, unsigned int, unsigned int, const void*, unsigned int, unsigned int);
+	friend void GeometryPool::Free(GeometryAllocation&);
+
+	unsigned int m_uBaseVertex; //first vertex in the pool's vertex buffer
+	unsigned int m_uVertexCount;
+	unsigned int m_uFirstIndex; //first index in the pool's index buffer of m_uIndexSize
+	unsigned int m_uIndexCount;
+	unsigned int m_uIndexSize; //2 or 4 bytes, 0 if nothing is allocated
+};
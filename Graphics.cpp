@@ -22,6 +22,48 @@ namespace Graphics
 		D3D_FEATURE_LEVEL featureLevel;
 
 		Microsoft::WRL::ComPtr<ID3D11InfoQueue> InfoQueue;
+
+		// the state cache writes its slot counts out so it doesn't need d3d11.h
+		static_assert(RENDER_STATE_CONSTANT_BUFFER_SLOTS == D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, "constant buffer slots");
+		static_assert(RENDER_STATE_SHADER_RESOURCE_SLOTS == D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, "shader resource slots");
+		static_assert(RENDER_STATE_SAMPLER_SLOTS == D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT, "sampler slots");
+		static_assert(RENDER_STATE_VERTEX_BUFFER_SLOTS == D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT, "vertex buffer slots");
+
+		// passes the state cache's calls on to the immediate context
+		class ImmediateRenderContext : public IRenderContext
+		{
+		public:
+			void SetInputLayout(ID3D11InputLayout* inputLayout) override { Context->IASetInputLayout(inputLayout); }
+			void SetPrimitiveTopology(UINT topology) override { Context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology); }
+			void SetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset) override { Context->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset); }
+			void SetIndexBuffer(ID3D11Buffer* buffer, UINT format, UINT offset) override { Context->IASetIndexBuffer(buffer, (DXGI_FORMAT)format, offset); }
+			void SetVertexShader(ID3D11VertexShader* shader) override { Context->VSSetShader(shader, 0, 0); }
+			void SetPixelShader(ID3D11PixelShader* shader) override { Context->PSSetShader(shader, 0, 0); }
+			void SetConstantBuffer(UINT stage, UINT slot, ID3D11Buffer* buffer) override
+			{
+				if (stage == RENDER_STATE_STAGE_VERTEX) Context->VSSetConstantBuffers(slot, 1, &buffer);
+				else Context->PSSetConstantBuffers(slot, 1, &buffer);
+			}
+			void SetShaderResource(UINT stage, UINT slot, ID3D11ShaderResourceView* view) override
+			{
+				if (stage == RENDER_STATE_STAGE_VERTEX) Context->VSSetShaderResources(slot, 1, &view);
+				else Context->PSSetShaderResources(slot, 1, &view);
+			}
+			void ClearShaderResources(UINT stage) override
+			{
+				ID3D11ShaderResourceView* nullViews[RENDER_STATE_SHADER_RESOURCE_SLOTS] = {};
+				if (stage == RENDER_STATE_STAGE_VERTEX) Context->VSSetShaderResources(0, RENDER_STATE_SHADER_RESOURCE_SLOTS, nullViews);
+				else Context->PSSetShaderResources(0, RENDER_STATE_SHADER_RESOURCE_SLOTS, nullViews);
+			}
+			void SetSampler(UINT stage, UINT slot, ID3D11SamplerState* sampler) override
+			{
+				if (stage == RENDER_STATE_STAGE_VERTEX) Context->VSSetSamplers(slot, 1, &sampler);
+				else Context->PSSetSamplers(slot, 1, &sampler);
+			}
+			void SetRasterizerState(ID3D11RasterizerState* state) override { Context->RSSetState(state); }
+			void SetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) override { Context->OMSetDepthStencilState(state, stencilRef); }
+			void SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depth) override { Context->OMSetRenderTargets(count, targets, depth); }
+		};
 	}
 }
 
@@ -122,6 +164,9 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 		Context.GetAddressOf());	// Pointer to our Device Context pointer
 	if (FAILED(hr)) return hr;
 
+	// Everything binds through the state cache from here on
+	State = std::make_shared<RenderStateCache>(std::make_shared<ImmediateRenderContext>());
+
 	// We're set up
 	apiInitialized = true;
 
@@ -222,7 +267,7 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 
 	// Bind the views to the pipeline, so rendering properly 
 	// uses their underlying textures
-	Context->OMSetRenderTargets(
+	State->SetRenderTargets(
 		1,
 		BackBufferRTV.GetAddressOf(), // This requires a pointer to a pointer (an array of pointers), so we get the address of the pointer
 		DepthBufferDSV.Get());
@@ -0,0 +1,115 @@
+#include "Hash.h"
+#include <cstring>
+
+namespace
+{
+	const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+	const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+	const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+	const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+	const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+	inline uint64_t RotateLeft(uint64_t a_uValue, int a_nBits)
+	{
+		return (a_uValue << a_nBits) | (a_uValue >> (64 - a_nBits));
+	}
+
+	inline uint64_t Read64(const unsigned char* a_pData)
+	{
+		uint64_t value;
+		memcpy(&value, a_pData, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t Read32(const unsigned char* a_pData)
+	{
+		uint32_t value;
+		memcpy(&value, a_pData, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t Round(uint64_t a_uAccumulator, uint64_t a_uInput)
+	{
+		a_uAccumulator += a_uInput * PRIME64_2;
+		a_uAccumulator = RotateLeft(a_uAccumulator, 31);
+		return a_uAccumulator * PRIME64_1;
+	}
+
+	inline uint64_t MergeRound(uint64_t a_uAccumulator, uint64_t a_uValue)
+	{
+		a_uAccumulator ^= Round(0, a_uValue);
+		return a_uAccumulator * PRIME64_1 + PRIME64_4;
+	}
+}
+
+/// <summary>
+/// Hashes a block of memory with XXH64 (little-endian reads, matches the reference implementation)
+/// </summary>
+/// <param name="a_pData">Start of the data</param>
+/// <param name="a_uLength">Length of the data in bytes</param>
+/// <param name="a_uSeed">Seed value</param>
+/// <returns>64-bit hash</returns>
+uint64_t HashBytes(const void* a_pData, size_t a_uLength, uint64_t a_uSeed)
+{
+	const unsigned char* p = (const unsigned char*)a_pData;
+	const unsigned char* end = p + a_uLength;
+	uint64_t hash;
+
+	// bulk of the data: four independent lanes of 8 bytes each
+	if (a_uLength >= 32)
+	{
+		uint64_t v1 = a_uSeed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = a_uSeed + PRIME64_2;
+		uint64_t v3 = a_uSeed;
+		uint64_t v4 = a_uSeed - PRIME64_1;
+
+		const unsigned char* limit = end - 32;
+		do
+		{
+			v1 = Round(v1, Read64(p)); p += 8;
+			v2 = Round(v2, Read64(p)); p += 8;
+			v3 = Round(v3, Read64(p)); p += 8;
+			v4 = Round(v4, Read64(p)); p += 8;
+		} while (p <= limit);
+
+		hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		hash = MergeRound(hash, v1);
+		hash = MergeRound(hash, v2);
+		hash = MergeRound(hash, v3);
+		hash = MergeRound(hash, v4);
+	}
+	else
+	{
+		hash = a_uSeed + PRIME64_5;
+	}
+
+	hash += (uint64_t)a_uLength;
+
+	// tail: remaining 8-, 4- and 1-byte pieces
+	while (p + 8 <= end)
+	{
+		hash ^= Round(0, Read64(p));
+		hash = RotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		hash ^= (uint64_t)Read32(p) * PRIME64_1;
+		hash = RotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		hash ^= (*p) * PRIME64_5;
+		hash = RotateLeft(hash, 11) * PRIME64_1;
+		p++;
+	}
+
+	// final avalanche
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit xxHash (XXH64) of a block of memory
+uint64_t HashBytes(const void* a_pData, size_t a_uLength, uint64_t a_uSeed = 0);
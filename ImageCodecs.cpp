@@ -0,0 +1,956 @@
+#include "ImageCodecs.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+#pragma region Inflate
+	// Bits looked up at once when decoding a Huffman symbol (longer codes take the slow path)
+	const int HUFFMAN_FAST_BITS = 9;
+
+	// --------------------------------------------------------
+	// Reads a deflate stream least significant bit first
+	// --------------------------------------------------------
+	struct DeflateBits
+	{
+		const uint8_t* Data;
+		size_t Size;
+		size_t Position;
+		uint32_t Buffer;
+		int Count;
+		bool Overrun;
+
+		// tops the buffer up to at least 25 bits while there is input
+		void Fill()
+		{
+			while (Count <= 24 && Position < Size)
+			{
+				Buffer |= (uint32_t)Data[Position++] << Count;
+				Count += 8;
+			}
+		}
+		uint32_t Peek(int a_nBits)
+		{
+			Fill();
+			return Buffer & ((1u << a_nBits) - 1);
+		}
+		void Consume(int a_nBits)
+		{
+			if (Count < a_nBits)
+			{
+				Overrun = true;
+				a_nBits = Count;
+			}
+			Buffer >>= a_nBits;
+			Count -= a_nBits;
+		}
+		uint32_t Read(int a_nBits)
+		{
+			if (a_nBits == 0)
+				return 0;
+			uint32_t uValue = Peek(a_nBits);
+			Consume(a_nBits);
+			return uValue;
+		}
+		void AlignToByte()
+		{
+			Consume(Count & 7);
+		}
+	};
+
+	// --------------------------------------------------------
+	// Canonical Huffman code of a deflate block
+	// --------------------------------------------------------
+	struct DeflateHuffman
+	{
+		uint16_t Fast[1 << HUFFMAN_FAST_BITS];	// (length << 9) | symbol of codes up to HUFFMAN_FAST_BITS long, 0 if longer
+		uint16_t Counts[16];					// codes of each length
+		uint16_t Symbols[288];					// symbols ordered by code
+
+		/// <summary>
+		/// Builds the code from a code length per symbol
+		/// </summary>
+		/// <returns>Whether the lengths describe a valid code</returns>
+		bool Build(const uint8_t* a_pLengths, int a_nSymbols)
+		{
+			memset(Counts, 0, sizeof(Counts));
+			memset(Fast, 0, sizeof(Fast));
+			for (int s = 0; s < a_nSymbols; s++)
+				Counts[a_pLengths[s]]++;
+			Counts[0] = 0;
+
+			// reject over-subscribed codes (incomplete ones are allowed)
+			int nLeft = 1;
+			for (int len = 1; len < 16; len++)
+			{
+				nLeft = (nLeft << 1) - Counts[len];
+				if (nLeft < 0)
+					return false;
+			}
+
+			uint16_t offsets[16];
+			offsets[1] = 0;
+			for (int len = 1; len < 15; len++)
+				offsets[len + 1] = offsets[len] + Counts[len];
+			for (int s = 0; s < a_nSymbols; s++)
+				if (a_pLengths[s] != 0)
+					Symbols[offsets[a_pLengths[s]]++] = (uint16_t)s;
+
+			// the fast table is indexed by the bit-reversed code (deflate sends codes MSB first)
+			int nCode = 0;
+			int nIndex = 0;
+			for (int len = 1; len <= HUFFMAN_FAST_BITS; len++)
+			{
+				for (int i = 0; i < Counts[len]; i++, nCode++, nIndex++)
+				{
+					int nReversed = 0;
+					for (int b = 0; b < len; b++)
+						nReversed |= ((nCode >> b) & 1) << (len - 1 - b);
+					for (int fill = nReversed; fill < (1 << HUFFMAN_FAST_BITS); fill += 1 << len)
+						Fast[fill] = (uint16_t)((len << 9) | Symbols[nIndex]);
+				}
+				nCode <<= 1;
+			}
+			return true;
+		}
+
+		/// <summary>
+		/// Decodes one symbol
+		/// </summary>
+		/// <returns>Symbol, or -1 if the bits are no code</returns>
+		int Decode(DeflateBits& a_Bits) const
+		{
+			uint16_t uEntry = Fast[a_Bits.Peek(HUFFMAN_FAST_BITS)];
+			if (uEntry != 0)
+			{
+				a_Bits.Consume(uEntry >> 9);
+				return uEntry & 511;
+			}
+
+			// slow path, one bit at a time
+			int nCode = 0, nFirst = 0, nIndex = 0;
+			for (int len = 1; len < 16; len++)
+			{
+				nCode |= (int)a_Bits.Read(1);
+				int nCount = Counts[len];
+				if (nCode - nCount < nFirst)
+					return Symbols[nIndex + (nCode - nFirst)];
+				nIndex += nCount;
+				nFirst = (nFirst + nCount) << 1;
+				nCode <<= 1;
+			}
+			return -1;
+		}
+	};
+
+	const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	/// <summary>
+	/// Decompresses a zlib stream (RFC 1950/1951)
+	/// </summary>
+	/// <param name="a_vOutput">Receives the data; reserve the expected size up front</param>
+	/// <returns>Whether the stream was complete and valid</returns>
+	bool Inflate(const uint8_t* a_pData, size_t a_uSize, std::vector<uint8_t>& a_vOutput)
+	{
+		// zlib header: deflate, no preset dictionary
+		if (a_uSize < 2 || (a_pData[0] & 15) != 8 || ((a_pData[0] << 8) | a_pData[1]) % 31 != 0 || (a_pData[1] & 32))
+			return false;
+
+		DeflateBits bits = { a_pData + 2, a_uSize - 2, 0, 0, 0, false };
+		DeflateHuffman literals, distances;
+		bool bFinal = false;
+		while (!bFinal && !bits.Overrun)
+		{
+			bFinal = bits.Read(1) != 0;
+			uint32_t uType = bits.Read(2);
+			if (uType == 0)
+			{
+				// stored block
+				bits.AlignToByte();
+				uint32_t uLength = bits.Read(16);
+				uint32_t uInverse = bits.Read(16);
+				if ((uLength ^ 0xFFFF) != uInverse)
+					return false;
+				for (uint32_t i = 0; i < uLength && !bits.Overrun; i++)
+					a_vOutput.push_back((uint8_t)bits.Read(8));
+				continue;
+			}
+
+			uint8_t lengths[320] = {};
+			int nLiterals = 288, nDistances = 30;
+			if (uType == 1)
+			{
+				// fixed codes
+				for (int s = 0; s < 288; s++)
+					lengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+				for (int s = 0; s < 30; s++)
+					lengths[288 + s] = 5;
+			}
+			else if (uType == 2)
+			{
+				// dynamic codes, themselves sent with a code length code
+				nLiterals = (int)bits.Read(5) + 257;
+				nDistances = (int)bits.Read(5) + 1;
+				int nCodeLengths = (int)bits.Read(4) + 4;
+				static const uint8_t ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+				uint8_t codeLengths[19] = {};
+				for (int i = 0; i < nCodeLengths; i++)
+					codeLengths[ORDER[i]] = (uint8_t)bits.Read(3);
+				DeflateHuffman lengthCode;
+				if (!lengthCode.Build(codeLengths, 19))
+					return false;
+
+				uint8_t dynamicLengths[320] = {};
+				int n = 0;
+				while (n < nLiterals + nDistances)
+				{
+					int nSymbol = lengthCode.Decode(bits);
+					if (nSymbol < 0 || bits.Overrun)
+						return false;
+					if (nSymbol < 16)
+					{
+						dynamicLengths[n++] = (uint8_t)nSymbol;
+						continue;
+					}
+					int nRepeat;
+					uint8_t uValue = 0;
+					if (nSymbol == 16)
+					{
+						if (n == 0)
+							return false;
+						uValue = dynamicLengths[n - 1];
+						nRepeat = 3 + (int)bits.Read(2);
+					}
+					else if (nSymbol == 17)
+						nRepeat = 3 + (int)bits.Read(3);
+					else
+						nRepeat = 11 + (int)bits.Read(7);
+					if (n + nRepeat > nLiterals + nDistances)
+						return false;
+					while (nRepeat--)
+						dynamicLengths[n++] = uValue;
+				}
+				memcpy(lengths, dynamicLengths, nLiterals);
+				memcpy(lengths + 288, dynamicLengths + nLiterals, nDistances);
+			}
+			else
+				return false;
+
+			if (!literals.Build(lengths, nLiterals) || !distances.Build(lengths + 288, nDistances))
+				return false;
+
+			// literal/length + distance pairs until the end of block symbol
+			while (true)
+			{
+				int nSymbol = literals.Decode(bits);
+				if (nSymbol < 0 || bits.Overrun)
+					return false;
+				if (nSymbol < 256)
+				{
+					a_vOutput.push_back((uint8_t)nSymbol);
+					continue;
+				}
+				if (nSymbol == 256)
+					break;
+
+				nSymbol -= 257;
+				if (nSymbol >= 29)
+					return false;
+				size_t uLength = LENGTH_BASE[nSymbol] + bits.Read(LENGTH_EXTRA[nSymbol]);
+				int nDistanceSymbol = distances.Decode(bits);
+				if (nDistanceSymbol < 0 || nDistanceSymbol >= 30)
+					return false;
+				size_t uDistance = DISTANCE_BASE[nDistanceSymbol] + bits.Read(DISTANCE_EXTRA[nDistanceSymbol]);
+				if (uDistance > a_vOutput.size())
+					return false;
+
+				// byte by byte, since the copy may overlap what it writes
+				size_t uFrom = a_vOutput.size() - uDistance;
+				for (size_t i = 0; i < uLength; i++)
+					a_vOutput.push_back(a_vOutput[uFrom + i]);
+			}
+		}
+		return bFinal && !bits.Overrun;
+	}
+#pragma endregion
+
+#pragma region PNG
+	uint32_t ReadBigEndian32(const uint8_t* a_pData)
+	{
+		return ((uint32_t)a_pData[0] << 24) | ((uint32_t)a_pData[1] << 16) | ((uint32_t)a_pData[2] << 8) | a_pData[3];
+	}
+
+	/// <summary>
+	/// Paeth predictor of the PNG filters
+	/// </summary>
+	uint8_t Paeth(int a_nLeft, int a_nUp, int a_nUpLeft)
+	{
+		int p = a_nLeft + a_nUp - a_nUpLeft;
+		int pa = abs(p - a_nLeft), pb = abs(p - a_nUp), pc = abs(p - a_nUpLeft);
+		if (pa <= pb && pa <= pc)
+			return (uint8_t)a_nLeft;
+		return (uint8_t)(pb <= pc ? a_nUp : a_nUpLeft);
+	}
+#pragma endregion
+
+#pragma region JPEG
+	const uint8_t JPEG_ZIGZAG[64] =
+	{
+		0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+		12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+		35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+		58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+	};
+
+	// --------------------------------------------------------
+	// Reads entropy-coded JPEG data most significant bit first,
+	// removing stuffed zero bytes and stopping at markers
+	// --------------------------------------------------------
+	struct JpegBits
+	{
+		const uint8_t* Data;
+		size_t Size;
+		size_t Position;
+		uint32_t Buffer;	// bits are kept at the top
+		int Count;
+		bool HitMarker;
+
+		void Fill()
+		{
+			while (Count <= 24)
+			{
+				uint32_t uByte = 0;
+				if (!HitMarker && Position < Size)
+				{
+					uByte = Data[Position];
+					if (uByte == 0xFF)
+					{
+						// 0xFF00 is a literal 0xFF, anything else is a marker that ends the data
+						if (Position + 1 < Size && Data[Position + 1] == 0x00)
+							Position += 2;
+						else
+						{
+							HitMarker = true;
+							uByte = 0;
+						}
+					}
+					else
+						Position++;
+				}
+				Buffer |= uByte << (24 - Count);
+				Count += 8;
+			}
+		}
+		uint32_t Peek(int a_nBits)
+		{
+			Fill();
+			return Buffer >> (32 - a_nBits);
+		}
+		void Consume(int a_nBits)
+		{
+			Buffer <<= a_nBits;
+			Count -= a_nBits;
+		}
+		uint32_t Read(int a_nBits)
+		{
+			if (a_nBits == 0)
+				return 0;
+			uint32_t uValue = Peek(a_nBits);
+			Consume(a_nBits);
+			return uValue;
+		}
+
+		// restarts after an RSTn marker
+		void Reset()
+		{
+			Buffer = 0;
+			Count = 0;
+			HitMarker = false;
+			while (Position + 1 < Size && !(Data[Position] == 0xFF && Data[Position + 1] >= 0xD0 && Data[Position + 1] <= 0xD7))
+				Position++;
+			Position += 2;
+		}
+	};
+
+	// --------------------------------------------------------
+	// A JPEG Huffman table
+	// --------------------------------------------------------
+	struct JpegHuffman
+	{
+		uint16_t Fast[1 << HUFFMAN_FAST_BITS];	// (length << 8) | symbol, 0 if the code is longer
+		int MaxCode[18];						// largest code of each length (-1 if none)
+		int ValueOffset[17];					// index of a length's first code in Values minus that code
+		uint8_t Values[256];
+		bool Defined;
+
+		/// <summary>
+		/// Builds the table from the 16 code counts and the symbols of a DHT segment
+		/// </summary>
+		void Build(const uint8_t* a_pCounts, const uint8_t* a_pValues)
+		{
+			memset(Fast, 0, sizeof(Fast));
+			int nCode = 0, nIndex = 0;
+			for (int len = 1; len <= 16; len++)
+			{
+				ValueOffset[len] = nIndex - nCode;
+				for (int i = 0; i < a_pCounts[len - 1]; i++, nCode++, nIndex++)
+				{
+					Values[nIndex] = a_pValues[nIndex];
+					if (len <= HUFFMAN_FAST_BITS)
+					{
+						int nShift = HUFFMAN_FAST_BITS - len;
+						for (int fill = 0; fill < (1 << nShift); fill++)
+							Fast[(nCode << nShift) | fill] = (uint16_t)((len << 8) | a_pValues[nIndex]);
+					}
+				}
+				MaxCode[len] = a_pCounts[len - 1] ? nCode - 1 : -1;
+				nCode <<= 1;
+			}
+			MaxCode[17] = 0x7FFFFFFF;
+			Defined = true;
+		}
+
+		int Decode(JpegBits& a_Bits) const
+		{
+			uint16_t uEntry = Fast[a_Bits.Peek(HUFFMAN_FAST_BITS)];
+			if (uEntry != 0)
+			{
+				a_Bits.Consume(uEntry >> 8);
+				return uEntry & 255;
+			}
+			for (int len = HUFFMAN_FAST_BITS + 1; len <= 16; len++)
+			{
+				int nCode = (int)a_Bits.Peek(len);
+				if (nCode <= MaxCode[len])
+				{
+					a_Bits.Consume(len);
+					return Values[ValueOffset[len] + nCode];
+				}
+			}
+			return -1;
+		}
+	};
+
+	// --------------------------------------------------------
+	// One color component of a JPEG frame
+	// --------------------------------------------------------
+	struct JpegComponent
+	{
+		int Id;
+		int H, V;			// sampling factors
+		int Quant;			// quantization table
+		int DcTable, AcTable;
+		int BlocksWide, BlocksHigh;	// blocks of this component in the padded image
+		int Predictor;		// DC of the previous block
+		std::vector<uint8_t> Plane;	// BlocksWide * 8 by BlocksHigh * 8 samples
+	};
+
+	// JPEG's extension of a value of a_nBits bits to a signed coefficient
+	int Extend(uint32_t a_uValue, int a_nBits)
+	{
+		return a_uValue < (1u << (a_nBits - 1)) ? (int)a_uValue - (1 << a_nBits) + 1 : (int)a_uValue;
+	}
+
+	// --------------------------------------------------------
+	// Separable float 8x8 inverse DCT
+	// --------------------------------------------------------
+	struct JpegIdct
+	{
+		float Basis[8][8];	// Basis[u][x] = C(u) / 2 * cos((2x + 1) u pi / 16)
+
+		JpegIdct()
+		{
+			for (int u = 0; u < 8; u++)
+				for (int x = 0; x < 8; x++)
+					Basis[u][x] = (u == 0 ? sqrtf(0.5f) : 1.0f) * 0.5f * cosf((2 * x + 1) * u * 3.14159265f / 16.0f);
+		}
+
+		/// <summary>
+		/// Transforms dequantized coefficients (natural order) into 8x8 samples
+		/// </summary>
+		void Transform(const float a_pCoefficients[64], uint8_t* a_pOutput, size_t a_uStride, bool a_bOnlyDC) const
+		{
+			if (a_bOnlyDC)
+			{
+				uint8_t uValue = (uint8_t)std::clamp((int)lrintf(a_pCoefficients[0] * 0.125f + 128.0f), 0, 255);
+				for (int y = 0; y < 8; y++)
+					memset(a_pOutput + y * a_uStride, uValue, 8);
+				return;
+			}
+
+			// rows of coefficients -> rows of horizontal samples, then the columns
+			float rows[64];
+			for (int v = 0; v < 8; v++)
+				for (int x = 0; x < 8; x++)
+				{
+					float fSum = 0.0f;
+					for (int u = 0; u < 8; u++)
+						fSum += Basis[u][x] * a_pCoefficients[v * 8 + u];
+					rows[v * 8 + x] = fSum;
+				}
+			for (int y = 0; y < 8; y++)
+				for (int x = 0; x < 8; x++)
+				{
+					float fSum = 0.0f;
+					for (int v = 0; v < 8; v++)
+						fSum += Basis[v][y] * rows[v * 8 + x];
+					a_pOutput[y * a_uStride + x] = (uint8_t)std::clamp((int)lrintf(fSum + 128.0f), 0, 255);
+				}
+		}
+	};
+#pragma endregion
+}
+
+/// <summary>
+/// Decodes a PNG file
+/// </summary>
+/// <param name="a_pData">File contents</param>
+/// <param name="a_uSize">File size</param>
+/// <param name="a_Image">Receives the RGBA8 pixels</param>
+/// <returns>Whether the file could be decoded</returns>
+bool DecodePng(const uint8_t* a_pData, size_t a_uSize, DecodedImage& a_Image)
+{
+	static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (a_uSize < 8 || memcmp(a_pData, SIGNATURE, 8) != 0)
+		return false;
+
+	uint32_t uWidth = 0, uHeight = 0;
+	int nBitDepth = 0, nColorType = -1;
+	std::vector<uint8_t> vCompressed;
+	uint8_t palette[256][4] = {};
+	bool bTransparentKey = false;
+	uint16_t transparentKey[3] = {};
+	a_Image.SRGB = false;
+
+	// walk the chunks
+	size_t uOffset = 8;
+	while (uOffset + 12 <= a_uSize)
+	{
+		uint32_t uLength = ReadBigEndian32(a_pData + uOffset);
+		const uint8_t* pType = a_pData + uOffset + 4;
+		const uint8_t* pChunk = a_pData + uOffset + 8;
+		if (uLength > a_uSize - uOffset - 12)
+			return false;
+
+		if (memcmp(pType, "IHDR", 4) == 0 && uLength >= 13)
+		{
+			uWidth = ReadBigEndian32(pChunk);
+			uHeight = ReadBigEndian32(pChunk + 4);
+			nBitDepth = pChunk[8];
+			nColorType = pChunk[9];
+			if (pChunk[12] != 0)
+				return false; // interlaced
+		}
+		else if (memcmp(pType, "PLTE", 4) == 0)
+		{
+			for (uint32_t i = 0; i < uLength / 3 && i < 256; i++)
+				palette[i][0] = pChunk[i * 3], palette[i][1] = pChunk[i * 3 + 1], palette[i][2] = pChunk[i * 3 + 2], palette[i][3] = 255;
+		}
+		else if (memcmp(pType, "tRNS", 4) == 0)
+		{
+			if (nColorType == 3)
+				for (uint32_t i = 0; i < uLength && i < 256; i++)
+					palette[i][3] = pChunk[i];
+			else if (nColorType == 0 && uLength >= 2)
+				bTransparentKey = true, transparentKey[0] = (uint16_t)((pChunk[0] << 8) | pChunk[1]);
+			else if (nColorType == 2 && uLength >= 6)
+			{
+				bTransparentKey = true;
+				for (int c = 0; c < 3; c++)
+					transparentKey[c] = (uint16_t)((pChunk[c * 2] << 8) | pChunk[c * 2 + 1]);
+			}
+		}
+		else if (memcmp(pType, "sRGB", 4) == 0)
+			a_Image.SRGB = true;
+		else if (memcmp(pType, "IDAT", 4) == 0)
+			vCompressed.insert(vCompressed.end(), pChunk, pChunk + uLength);
+		else if (memcmp(pType, "IEND", 4) == 0)
+			break;
+
+		uOffset += 12 + (size_t)uLength;
+	}
+
+	static const int CHANNELS[7] = { 1, 0, 3, 1, 2, 0, 4 };
+	if (uWidth == 0 || uHeight == 0 || nColorType < 0 || nColorType > 6 || CHANNELS[nColorType] == 0 ||
+		(nBitDepth != 1 && nBitDepth != 2 && nBitDepth != 4 && nBitDepth != 8 && nBitDepth != 16))
+		return false;
+
+	int nChannels = CHANNELS[nColorType];
+	size_t uRowBytes = ((size_t)uWidth * nChannels * nBitDepth + 7) / 8;
+	size_t uPixelBytes = std::max<size_t>(1, (size_t)nChannels * nBitDepth / 8);
+
+	std::vector<uint8_t> vFiltered;
+	vFiltered.reserve((uRowBytes + 1) * uHeight);
+	if (!Inflate(vCompressed.data(), vCompressed.size(), vFiltered) || vFiltered.size() < (uRowBytes + 1) * uHeight)
+		return false;
+
+	// undo the per-row filters in place
+	std::vector<uint8_t> vPrevious(uRowBytes, 0);
+	for (uint32_t y = 0; y < uHeight; y++)
+	{
+		uint8_t* pRow = vFiltered.data() + y * (uRowBytes + 1);
+		uint8_t uFilter = pRow[0];
+		uint8_t* pData = pRow + 1;
+		const uint8_t* pUp = y > 0 ? pData - (uRowBytes + 1) : vPrevious.data();
+		for (size_t i = 0; i < uRowBytes; i++)
+		{
+			int nLeft = i >= uPixelBytes ? pData[i - uPixelBytes] : 0;
+			int nUpLeft = i >= uPixelBytes ? pUp[i - uPixelBytes] : 0;
+			switch (uFilter)
+			{
+			case 0: break;
+			case 1: pData[i] = (uint8_t)(pData[i] + nLeft); break;
+			case 2: pData[i] = (uint8_t)(pData[i] + pUp[i]); break;
+			case 3: pData[i] = (uint8_t)(pData[i] + ((nLeft + pUp[i]) >> 1)); break;
+			case 4: pData[i] = (uint8_t)(pData[i] + Paeth(nLeft, pUp[i], nUpLeft)); break;
+			default: return false;
+			}
+		}
+	}
+
+	// expand to RGBA8 (16-bit samples keep their high byte, low bit depths are scaled up)
+	a_Image.Width = uWidth;
+	a_Image.Height = uHeight;
+	a_Image.Pixels.resize((size_t)uWidth * uHeight * 4);
+	int nMaxSample = (1 << nBitDepth) - 1;
+	for (uint32_t y = 0; y < uHeight; y++)
+	{
+		const uint8_t* pData = vFiltered.data() + y * (uRowBytes + 1) + 1;
+		uint8_t* pOut = a_Image.Pixels.data() + (size_t)y * uWidth * 4;
+		for (uint32_t x = 0; x < uWidth; x++, pOut += 4)
+		{
+			// raw samples of this pixel
+			uint16_t samples[4] = {};
+			for (int c = 0; c < nChannels; c++)
+			{
+				size_t uSample = (size_t)x * nChannels + c;
+				if (nBitDepth == 16)
+					samples[c] = (uint16_t)((pData[uSample * 2] << 8) | pData[uSample * 2 + 1]);
+				else if (nBitDepth == 8)
+					samples[c] = pData[uSample];
+				else
+				{
+					size_t uBit = uSample * nBitDepth;
+					samples[c] = (uint16_t)((pData[uBit / 8] >> (8 - nBitDepth - uBit % 8)) & nMaxSample);
+				}
+			}
+
+			if (nColorType == 3)
+			{
+				memcpy(pOut, palette[samples[0] & 255], 4);
+				continue;
+			}
+
+			bool bTransparent = bTransparentKey && samples[0] == transparentKey[0] &&
+				(nColorType != 2 || (samples[1] == transparentKey[1] && samples[2] == transparentKey[2]));
+			uint8_t values[4];
+			for (int c = 0; c < nChannels; c++)
+				values[c] = nBitDepth == 16 ? (uint8_t)(samples[c] >> 8) : (uint8_t)(samples[c] * 255 / nMaxSample);
+			switch (nColorType)
+			{
+			case 0: pOut[0] = pOut[1] = pOut[2] = values[0]; pOut[3] = bTransparent ? 0 : 255; break;
+			case 2: pOut[0] = values[0]; pOut[1] = values[1]; pOut[2] = values[2]; pOut[3] = bTransparent ? 0 : 255; break;
+			case 4: pOut[0] = pOut[1] = pOut[2] = values[0]; pOut[3] = values[1]; break;
+			case 6: memcpy(pOut, values, 4); break;
+			}
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Decodes a baseline (or extended Huffman) JPEG file
+/// </summary>
+/// <param name="a_pData">File contents</param>
+/// <param name="a_uSize">File size</param>
+/// <param name="a_Image">Receives the RGBA8 pixels</param>
+/// <returns>Whether the file could be decoded</returns>
+bool DecodeJpeg(const uint8_t* a_pData, size_t a_uSize, DecodedImage& a_Image)
+{
+	if (a_uSize < 4 || a_pData[0] != 0xFF || a_pData[1] != 0xD8)
+		return false;
+
+	static const JpegIdct idct;
+	uint16_t quant[4][64] = {};
+	JpegHuffman huffman[2][4] = {};	// [DC/AC][table]
+	std::vector<JpegComponent> vComponents;
+	int nWidth = 0, nHeight = 0, nMaxH = 1, nMaxV = 1;
+	int nRestartInterval = 0;
+	int nAdobeTransform = -1;
+	bool bFrameDecoded = false;
+
+	size_t uOffset = 2;
+	while (uOffset + 4 <= a_uSize)
+	{
+		if (a_pData[uOffset] != 0xFF)
+		{
+			uOffset++;
+			continue;
+		}
+		uint8_t uMarker = a_pData[uOffset + 1];
+		if (uMarker == 0xFF || uMarker == 0x01 || (uMarker >= 0xD0 && uMarker <= 0xD7))
+		{
+			uOffset += uMarker == 0xFF ? 1 : 2;
+			continue;
+		}
+		if (uMarker == 0xD9)
+			break;
+
+		size_t uLength = ((size_t)a_pData[uOffset + 2] << 8) | a_pData[uOffset + 3];
+		const uint8_t* pSegment = a_pData + uOffset + 4;
+		if (uLength < 2 || uOffset + 2 + uLength > a_uSize)
+			return false;
+		size_t uSegmentSize = uLength - 2;
+
+		if (uMarker == 0xDB)
+		{
+			// quantization tables, stored in zigzag order
+			for (size_t i = 0; i < uSegmentSize;)
+			{
+				int nPrecision = pSegment[i] >> 4, nTable = pSegment[i] & 3;
+				i++;
+				for (int k = 0; k < 64 && i < uSegmentSize; k++)
+				{
+					quant[nTable][JPEG_ZIGZAG[k]] = nPrecision ? (uint16_t)((pSegment[i] << 8) | pSegment[i + 1]) : pSegment[i];
+					i += nPrecision ? 2 : 1;
+				}
+			}
+		}
+		else if (uMarker == 0xC4)
+		{
+			// Huffman tables
+			for (size_t i = 0; i + 17 <= uSegmentSize;)
+			{
+				int nClass = pSegment[i] >> 4, nTable = pSegment[i] & 3;
+				const uint8_t* pCounts = pSegment + i + 1;
+				int nTotal = 0;
+				for (int k = 0; k < 16; k++)
+					nTotal += pCounts[k];
+				if (nClass > 1 || nTotal > 256 || i + 17 + nTotal > uSegmentSize)
+					return false;
+				huffman[nClass][nTable].Build(pCounts, pCounts + 16);
+				i += 17 + nTotal;
+			}
+		}
+		else if (uMarker == 0xC0 || uMarker == 0xC1)
+		{
+			// baseline / extended Huffman frame
+			if (uSegmentSize < 6 || pSegment[0] != 8)
+				return false;
+			nHeight = (pSegment[1] << 8) | pSegment[2];
+			nWidth = (pSegment[3] << 8) | pSegment[4];
+			int nComponents = pSegment[5];
+			if (nWidth == 0 || nHeight == 0 || (nComponents != 1 && nComponents != 3) || uSegmentSize < 6 + (size_t)nComponents * 3)
+				return false;
+			vComponents.resize(nComponents);
+			for (int c = 0; c < nComponents; c++)
+			{
+				JpegComponent& component = vComponents[c];
+				component.Id = pSegment[6 + c * 3];
+				component.H = pSegment[7 + c * 3] >> 4;
+				component.V = pSegment[7 + c * 3] & 15;
+				component.Quant = pSegment[8 + c * 3] & 3;
+				if (component.H < 1 || component.H > 4 || component.V < 1 || component.V > 4)
+					return false;
+				nMaxH = std::max(nMaxH, component.H);
+				nMaxV = std::max(nMaxV, component.V);
+			}
+
+			// every component is padded to whole MCUs
+			int nMcusWide = (nWidth + nMaxH * 8 - 1) / (nMaxH * 8);
+			int nMcusHigh = (nHeight + nMaxV * 8 - 1) / (nMaxV * 8);
+			for (JpegComponent& component : vComponents)
+			{
+				component.BlocksWide = nMcusWide * component.H;
+				component.BlocksHigh = nMcusHigh * component.V;
+				component.Plane.assign((size_t)component.BlocksWide * 8 * component.BlocksHigh * 8, 0);
+			}
+		}
+		else if (uMarker >= 0xC2 && uMarker <= 0xCF && uMarker != 0xC4 && uMarker != 0xC8 && uMarker != 0xCC)
+			return false; // progressive, lossless or arithmetic coded
+		else if (uMarker == 0xDD && uSegmentSize >= 2)
+			nRestartInterval = (pSegment[0] << 8) | pSegment[1];
+		else if (uMarker == 0xEE && uSegmentSize >= 12 && memcmp(pSegment, "Adobe", 5) == 0)
+			nAdobeTransform = pSegment[11];
+		else if (uMarker == 0xDA)
+		{
+			// start of scan: the entropy-coded data follows the header
+			if (vComponents.empty() || uSegmentSize < 1)
+				return false;
+			int nScanComponents = pSegment[0];
+			std::vector<JpegComponent*> vScan;
+			for (int s = 0; s < nScanComponents; s++)
+			{
+				for (JpegComponent& component : vComponents)
+					if (component.Id == pSegment[1 + s * 2])
+					{
+						component.DcTable = pSegment[2 + s * 2] >> 4;
+						component.AcTable = pSegment[2 + s * 2] & 3;
+						component.Predictor = 0;
+						vScan.push_back(&component);
+					}
+			}
+			if (vScan.empty() || vScan.size() != (size_t)nScanComponents)
+				return false;
+
+			JpegBits bits = { a_pData, a_uSize, uOffset + 2 + uLength, 0, 0, false };
+
+			// decodes one 8x8 block into its component's plane
+			auto DecodeBlock = [&](JpegComponent& a_Component, int a_nBlockX, int a_nBlockY) -> bool
+			{
+				const JpegHuffman& dc = huffman[0][a_Component.DcTable];
+				const JpegHuffman& ac = huffman[1][a_Component.AcTable];
+				if (!dc.Defined || !ac.Defined)
+					return false;
+
+				float coefficients[64] = {};
+				const uint16_t* pQuant = quant[a_Component.Quant];
+				int nSize = dc.Decode(bits);
+				if (nSize < 0 || nSize > 11)
+					return false;
+				a_Component.Predictor += nSize ? Extend(bits.Read(nSize), nSize) : 0;
+				coefficients[0] = (float)(a_Component.Predictor * pQuant[0]);
+
+				bool bOnlyDC = true;
+				for (int k = 1; k < 64;)
+				{
+					int nSymbol = ac.Decode(bits);
+					if (nSymbol < 0)
+						return false;
+					int nRun = nSymbol >> 4, nBits = nSymbol & 15;
+					if (nBits == 0)
+					{
+						if (nRun != 15)
+							break; // end of block
+						k += 16;
+						continue;
+					}
+					k += nRun;
+					if (k > 63)
+						return false;
+					int nNatural = JPEG_ZIGZAG[k++];
+					coefficients[nNatural] = (float)(Extend(bits.Read(nBits), nBits) * pQuant[nNatural]);
+					bOnlyDC = false;
+				}
+
+				size_t uStride = (size_t)a_Component.BlocksWide * 8;
+				idct.Transform(coefficients, a_Component.Plane.data() + (size_t)a_nBlockY * 8 * uStride + (size_t)a_nBlockX * 8, uStride, bOnlyDC);
+				return true;
+			};
+
+			int nMcusWide, nMcusHigh;
+			if (vScan.size() == 1)
+			{
+				// non-interleaved: one block per MCU, covering only the component's own samples
+				nMcusWide = ((nWidth * vScan[0]->H + nMaxH - 1) / nMaxH + 7) / 8;
+				nMcusHigh = ((nHeight * vScan[0]->V + nMaxV - 1) / nMaxV + 7) / 8;
+			}
+			else
+			{
+				nMcusWide = (nWidth + nMaxH * 8 - 1) / (nMaxH * 8);
+				nMcusHigh = (nHeight + nMaxV * 8 - 1) / (nMaxV * 8);
+			}
+
+			int nMcusLeft = nRestartInterval;
+			for (int my = 0; my < nMcusHigh; my++)
+				for (int mx = 0; mx < nMcusWide; mx++)
+				{
+					if (nRestartInterval && nMcusLeft-- == 0)
+					{
+						bits.Reset();
+						for (JpegComponent* pComponent : vScan)
+							pComponent->Predictor = 0;
+						nMcusLeft = nRestartInterval - 1;
+					}
+
+					if (vScan.size() == 1)
+					{
+						if (!DecodeBlock(*vScan[0], mx, my))
+							return false;
+						continue;
+					}
+					for (JpegComponent* pComponent : vScan)
+						for (int v = 0; v < pComponent->V; v++)
+							for (int h = 0; h < pComponent->H; h++)
+								if (!DecodeBlock(*pComponent, mx * pComponent->H + h, my * pComponent->V + v))
+									return false;
+				}
+
+			// continue after the entropy-coded data
+			uOffset = bits.Position;
+			while (uOffset + 1 < a_uSize && !(a_pData[uOffset] == 0xFF && a_pData[uOffset + 1] != 0x00 &&
+				!(a_pData[uOffset + 1] >= 0xD0 && a_pData[uOffset + 1] <= 0xD7)))
+				uOffset++;
+			bFrameDecoded = true;
+			continue;
+		}
+
+		uOffset += 2 + uLength;
+	}
+
+	if (!bFrameDecoded)
+		return false;
+
+	// upsample (nearest) and convert to RGB
+	a_Image.Width = (uint32_t)nWidth;
+	a_Image.Height = (uint32_t)nHeight;
+	a_Image.SRGB = false;
+	a_Image.Pixels.resize((size_t)nWidth * nHeight * 4);
+	bool bYCbCr = vComponents.size() == 3 && nAdobeTransform != 0;
+	for (int y = 0; y < nHeight; y++)
+	{
+		uint8_t* pOut = a_Image.Pixels.data() + (size_t)y * nWidth * 4;
+		for (int x = 0; x < nWidth; x++, pOut += 4)
+		{
+			float samples[3];
+			for (size_t c = 0; c < vComponents.size(); c++)
+			{
+				const JpegComponent& component = vComponents[c];
+				size_t uX = (size_t)x * component.H / nMaxH;
+				size_t uY = (size_t)y * component.V / nMaxV;
+				samples[c] = component.Plane[uY * component.BlocksWide * 8 + uX];
+			}
+
+			if (vComponents.size() == 1)
+				pOut[0] = pOut[1] = pOut[2] = (uint8_t)samples[0];
+			else if (!bYCbCr)
+				pOut[0] = (uint8_t)samples[0], pOut[1] = (uint8_t)samples[1], pOut[2] = (uint8_t)samples[2];
+			else
+			{
+				float fCb = samples[1] - 128.0f, fCr = samples[2] - 128.0f;
+				pOut[0] = (uint8_t)std::clamp((int)lrintf(samples[0] + 1.402f * fCr), 0, 255);
+				pOut[1] = (uint8_t)std::clamp((int)lrintf(samples[0] - 0.344136f * fCb - 0.714136f * fCr), 0, 255);
+				pOut[2] = (uint8_t)std::clamp((int)lrintf(samples[0] + 1.772f * fCb), 0, 255);
+			}
+			pOut[3] = 255;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Reads an image file and decodes it as PNG or JPEG
+/// </summary>
+/// <param name="a_sFileName">Path to the image</param>
+/// <param name="a_Image">Receives the RGBA8 pixels</param>
+/// <returns>Whether the file could be read and decoded</returns>
+bool LoadImageFile(const char* a_sFileName, DecodedImage& a_Image)
+{
+	std::ifstream file(a_sFileName, std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<uint8_t> vData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (vData.size() >= 8 && vData[0] == 0x89 && vData[1] == 'P')
+		return DecodePng(vData.data(), vData.size(), a_Image);
+	if (vData.size() >= 2 && vData[0] == 0xFF && vData[1] == 0xD8)
+		return DecodeJpeg(vData.data(), vData.size(), a_Image);
+	return false;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "ImageDecoder.h"
+
+// Pure C++ image decoders for the tools, which have to run where WIC doesn't exist.
+// PNG: every color type at 1-16 bits per channel (not interlaced).
+// JPEG: baseline and extended Huffman (not progressive or arithmetic coded).
+// Both return RGBA8 like DecodeImageFile; SRGB is only set from a PNG's sRGB chunk.
+bool DecodePng(const uint8_t* a_pData, size_t a_uSize, DecodedImage& a_Image);
+bool DecodeJpeg(const uint8_t* a_pData, size_t a_uSize, DecodedImage& a_Image);
+
+// Reads a file and decodes it with the decoder its signature asks for
+bool LoadImageFile(const char* a_sFileName, DecodedImage& a_Image);
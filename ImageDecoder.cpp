@@ -0,0 +1,53 @@
+#include "ImageDecoder.h"
+#include <Windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+#pragma comment(lib, "windowscodecs.lib")
+
+/// <summary>
+/// Decodes the first frame of an image file to RGBA8
+/// </summary>
+/// <param name="a_wsFileName">Path to the image</param>
+/// <param name="a_Image">Receives the pixels</param>
+/// <returns>Whether the image could be decoded</returns>
+bool DecodeImageFile(const wchar_t* a_wsFileName, DecodedImage& a_Image)
+{
+	Microsoft::WRL::ComPtr<IWICImagingFactory> cpFactory;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(cpFactory.GetAddressOf()))))
+		return false;
+
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> cpDecoder;
+	if (FAILED(cpFactory->CreateDecoderFromFilename(a_wsFileName, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, cpDecoder.GetAddressOf())))
+		return false;
+
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> cpFrame;
+	UINT uWidth = 0, uHeight = 0;
+	if (FAILED(cpDecoder->GetFrame(0, cpFrame.GetAddressOf())) || FAILED(cpFrame->GetSize(&uWidth, &uHeight)) || uWidth == 0 || uHeight == 0)
+		return false;
+
+	// sRGB is read from the metadata: the sRGB chunk of a PNG, the color space tag of anything else
+	a_Image.SRGB = false;
+	GUID containerFormat;
+	Microsoft::WRL::ComPtr<IWICMetadataQueryReader> cpMetadata;
+	if (SUCCEEDED(cpDecoder->GetContainerFormat(&containerFormat)) && SUCCEEDED(cpFrame->GetMetadataQueryReader(cpMetadata.GetAddressOf())))
+	{
+		PROPVARIANT value;
+		PropVariantInit(&value);
+		if (containerFormat == GUID_ContainerFormatPng)
+			a_Image.SRGB = SUCCEEDED(cpMetadata->GetMetadataByName(L"/sRGB/RenderingIntent", &value)) && value.vt == VT_UI1;
+		else
+			a_Image.SRGB = SUCCEEDED(cpMetadata->GetMetadataByName(L"System.Image.ColorSpace", &value)) && value.vt == VT_UI2 && value.uiVal == 1;
+		PropVariantClear(&value);
+	}
+
+	// convert whatever the file holds to RGBA8
+	Microsoft::WRL::ComPtr<IWICFormatConverter> cpConverter;
+	if (FAILED(cpFactory->CreateFormatConverter(cpConverter.GetAddressOf())) ||
+		FAILED(cpConverter->Initialize(cpFrame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeMedianCut)))
+		return false;
+
+	a_Image.Width = uWidth;
+	a_Image.Height = uHeight;
+	a_Image.Pixels.resize((size_t)uWidth * uHeight * 4);
+	return SUCCEEDED(cpConverter->CopyPixels(nullptr, uWidth * 4, (UINT)a_Image.Pixels.size(), a_Image.Pixels.data()));
+}
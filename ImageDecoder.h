@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// An image decoded to 8-bit RGBA in CPU memory
+// --------------------------------------------------------
+struct DecodedImage
+{
+	uint32_t Width;
+	uint32_t Height;
+	bool SRGB;						// the file says its colors are sRGB (the same check the WIC texture loader makes)
+	std::vector<uint8_t> Pixels;	// Width * Height * 4 bytes, rows top to bottom
+};
+
+// Reads and decodes a PNG/JPEG/BMP/... file with WIC. Needs no device, so it can run on any
+// thread that has initialized COM. Returns false if the file can't be read or decoded.
+bool DecodeImageFile(const wchar_t* a_wsFileName, DecodedImage& a_Image);
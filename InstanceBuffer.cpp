@@ -0,0 +1,128 @@
+#include "InstanceBuffer.h"
+#include "Graphics.h"
+#include <algorithm>
+#include <cstdint>
+#include <wrl/client.h>
+
+namespace InstanceBuffer
+{
+	// Annonymous namespace to hold the buffer's state
+	// only accessible in this file
+	namespace
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		unsigned int capacity = 0;
+		unsigned int grows = 0;
+
+		// this frame's counts, and last frame's
+		unsigned int instances = 0;
+		unsigned int maps = 0;
+		unsigned int lastInstances = 0;
+		unsigned int lastMaps = 0;
+
+		/// <summary>
+		/// Replaces the buffer with one that holds at least a_uCount instances. Nothing is copied over,
+		/// since every pass writes all of its instances anew.
+		/// </summary>
+		/// <returns>False if the new buffer couldn't be created, in which case the old one is kept</returns>
+		bool Grow(unsigned int a_uCount)
+		{
+			unsigned int uCapacity = (std::max)(capacity, (unsigned int)INSTANCE_BUFFER_INITIAL_INSTANCES);
+			while (uCapacity < a_uCount)
+				uCapacity *= 2;
+
+			D3D11_BUFFER_DESC desc = {};
+			desc.Usage = D3D11_USAGE_DYNAMIC;	// rewritten by every pass
+			desc.ByteWidth = uCapacity * sizeof(InstanceData);
+			desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+			desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+			Microsoft::WRL::ComPtr<ID3D11Buffer> cpBuffer;
+			if ((uint64_t)uCapacity * sizeof(InstanceData) > UINT32_MAX || FAILED(Graphics::Device->CreateBuffer(&desc, nullptr, cpBuffer.GetAddressOf())))
+				return false;
+
+			if (buffer)
+				grows++;
+			buffer = cpBuffer;
+			capacity = uCapacity;
+			return true;
+		}
+	}
+}
+
+/// <summary>
+/// Fills in an instance from the matrices of the render list
+/// </summary>
+/// <param name="a_Instance">Instance to fill in</param>
+/// <param name="a_m4World">World matrix</param>
+/// <param name="a_m4WorldInverseTranspose">Normal matrix (only its upper 3x3 is read)</param>
+void SetInstanceData(InstanceData& a_Instance, const DirectX::XMFLOAT4X4& a_m4World, const DirectX::XMFLOAT4X4& a_m4WorldInverseTranspose)
+{
+	a_Instance.World = a_m4World;
+	a_Instance.WorldInverseTranspose = DirectX::XMFLOAT3X3(
+		a_m4WorldInverseTranspose._11, a_m4WorldInverseTranspose._12, a_m4WorldInverseTranspose._13,
+		a_m4WorldInverseTranspose._21, a_m4WorldInverseTranspose._22, a_m4WorldInverseTranspose._23,
+		a_m4WorldInverseTranspose._31, a_m4WorldInverseTranspose._32, a_m4WorldInverseTranspose._33);
+}
+
+/// <summary>
+/// Maps room for a pass's instances, growing the buffer first if it's too small. What earlier
+/// passes wrote is discarded (their draws still see it). Write the instances in order, without
+/// reading them back, then Unmap().
+/// </summary>
+/// <param name="a_uCount">Most instances the pass may write</param>
+/// <returns>The first instance, or null if the buffer couldn't be grown or mapped</returns>
+InstanceData* InstanceBuffer::Map(unsigned int a_uCount)
+{
+	if (a_uCount > capacity && !Grow(a_uCount))
+		return nullptr;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(Graphics::Context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return nullptr;
+	maps++;
+	return (InstanceData*)mapped.pData;
+}
+
+/// <summary>
+/// Hands the instances written since Map() to the GPU
+/// </summary>
+/// <param name="a_uWritten">Number of instances written, for the statistics</param>
+void InstanceBuffer::Unmap(unsigned int a_uWritten)
+{
+	instances += a_uWritten;
+	Graphics::Context->Unmap(buffer.Get(), 0);
+}
+
+/// <summary>
+/// Sets the buffer as vertex buffer slot 1, where the instanced vertex shaders read it from
+/// </summary>
+void InstanceBuffer::Bind()
+{
+	Graphics::State->SetVertexBuffer(1, buffer.Get(), sizeof(InstanceData), 0);
+}
+
+/// <summary>
+/// Closes the frame's counts (see GetStats)
+/// </summary>
+void InstanceBuffer::EndFrame()
+{
+	lastInstances = instances;
+	lastMaps = maps;
+	instances = 0;
+	maps = 0;
+}
+
+/// <summary>
+/// Returns the size of the buffer, and how much was written to it last frame
+/// </summary>
+/// <returns>Buffer statistics</returns>
+InstanceBufferStats InstanceBuffer::GetStats()
+{
+	InstanceBufferStats stats = {};
+	stats.Capacity = capacity;
+	stats.Bytes = (size_t)capacity * sizeof(InstanceData);
+	stats.Grows = grows;
+	stats.Instances = lastInstances;
+	stats.Maps = lastMaps;
+	return stats;
+}
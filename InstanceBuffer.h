@@ -0,0 +1,53 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+
+// Instances the buffer starts with room for; it doubles whenever a pass needs more
+#define INSTANCE_BUFFER_INITIAL_INSTANCES (1 << 12)
+
+// Fewest draws sharing state and geometry that are drawn as instances of one draw
+#define INSTANCING_MIN_BATCH 2
+
+// --------------------------------------------------------
+// What an instanced draw knows about each instance; the
+// vertex shaders read it from vertex buffer slot 1 (see
+// InstanceInput in ShaderStructs.hlsli)
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT3X3 WorldInverseTranspose;	// the upper 3x3 is all the normals need
+};
+
+// --------------------------------------------------------
+// Size of the instance buffer and what went through it
+// last frame
+// --------------------------------------------------------
+struct InstanceBufferStats
+{
+	unsigned int Capacity;	// instances
+	size_t Bytes;			// video memory the buffer takes
+	unsigned int Grows;		// times the buffer was reallocated larger so far
+	unsigned int Instances;	// instances written last frame
+	unsigned int Maps;		// times it was mapped last frame
+};
+
+void SetInstanceData(InstanceData& a_Instance, const DirectX::XMFLOAT4X4& a_m4World, const DirectX::XMFLOAT4X4& a_m4WorldInverseTranspose);
+
+// --------------------------------------------------------
+// One dynamic vertex buffer of per-instance data, shared by
+// every pass. A pass maps it once for all the instances it
+// draws (discarding what the last pass wrote), binds it and
+// draws its batches at their offsets into it. Runs on the
+// thread that owns the device context.
+// --------------------------------------------------------
+namespace InstanceBuffer
+{
+	InstanceData* Map(unsigned int a_uCount);
+	void Unmap(unsigned int a_uWritten);
+	void Bind();
+	void EndFrame();
+
+	InstanceBufferStats GetStats();
+}
@@ -0,0 +1,459 @@
+#include "JobScheduler.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <random>
+
+namespace
+{
+	// The scheduler the current thread is a spawned worker of, and which worker it is
+	thread_local JobScheduler* t_pScheduler = nullptr;
+	thread_local unsigned int t_uWorker = 0;
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point a_tpStart)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - a_tpStart).count();
+	}
+}
+
+#pragma region JobCounter
+/// <summary>
+/// Creates a counter with nothing pending
+/// </summary>
+JobCounter::JobCounter()
+{
+	m_uPending = 0;
+}
+
+/// <summary>
+/// Whether every job counted on it has finished (the jobs it holds back may not have started)
+/// </summary>
+bool JobCounter::IsDone() const
+{
+	return m_uPending.load() == 0;
+}
+#pragma endregion
+
+#pragma region Deque
+JobScheduler::Deque::Deque()
+{
+	m_nTop = 0;
+	m_nBottom = 0;
+	for (std::atomic<Job*>& job : m_pJobs)
+		job.store(nullptr, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Adds a job at the bottom. Only the owner may call this.
+/// </summary>
+/// <returns>False if the deque is full</returns>
+bool JobScheduler::Deque::Push(Job* a_pJob)
+{
+	int64_t nBottom = m_nBottom.load(std::memory_order_relaxed);
+	int64_t nTop = m_nTop.load(std::memory_order_acquire);
+	if (nBottom - nTop >= JOB_DEQUE_CAPACITY)
+		return false;
+
+	m_pJobs[nBottom & (JOB_DEQUE_CAPACITY - 1)].store(a_pJob, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_nBottom.store(nBottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+/// <summary>
+/// Takes the newest job off the bottom. Only the owner may call this.
+/// </summary>
+/// <returns>The job, or null if the deque was empty or a thief took the last one</returns>
+Job* JobScheduler::Deque::Pop()
+{
+	// claim the bottom slot first, so a thief that gets there later sees it gone
+	int64_t nBottom = m_nBottom.load(std::memory_order_relaxed) - 1;
+	m_nBottom.store(nBottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t nTop = m_nTop.load(std::memory_order_relaxed);
+
+	Job* pJob = nullptr;
+	if (nTop <= nBottom)
+	{
+		pJob = m_pJobs[nBottom & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (nTop == nBottom)
+		{
+			// the last job: whoever moves the top first gets it
+			if (!m_nTop.compare_exchange_strong(nTop, nTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				pJob = nullptr;
+			m_nBottom.store(nBottom + 1, std::memory_order_relaxed);
+		}
+	}
+	else
+		m_nBottom.store(nBottom + 1, std::memory_order_relaxed);
+	return pJob;
+}
+
+/// <summary>
+/// Takes the oldest job off the top. Any thread may call this.
+/// </summary>
+/// <returns>The job, or null if the deque was empty or someone else took it first</returns>
+Job* JobScheduler::Deque::Steal()
+{
+	int64_t nTop = m_nTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t nBottom = m_nBottom.load(std::memory_order_acquire);
+	if (nTop >= nBottom)
+		return nullptr;
+
+	Job* pJob = m_pJobs[nTop & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!m_nTop.compare_exchange_strong(nTop, nTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return pJob;
+}
+
+/// <summary>
+/// Whether the deque looks empty; only a hint while other threads use it
+/// </summary>
+bool JobScheduler::Deque::IsEmpty() const
+{
+	return m_nBottom.load(std::memory_order_relaxed) <= m_nTop.load(std::memory_order_relaxed);
+}
+#pragma endregion
+
+/// <summary>
+/// Starts the workers; the calling thread becomes worker 0
+/// </summary>
+/// <param name="a_uThreadCount">Number of workers including the calling thread, 0 for one per hardware thread</param>
+JobScheduler::JobScheduler(unsigned int a_uThreadCount)
+{
+	m_OwnerThread = std::this_thread::get_id();
+	m_uQueued = 0;
+	m_uSleeping = 0;
+	m_bStopping = false;
+
+	unsigned int uThreads = a_uThreadCount ? a_uThreadCount : (std::max)(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < uThreads; i++)
+	{
+		m_vWorkers.push_back(std::make_unique<Worker>());
+		m_vWorkers[i]->Ran = 0;
+		m_vWorkers[i]->Stolen = 0;
+		m_vWorkers[i]->Inline = 0;
+		m_vWorkers[i]->Sleeps = 0;
+		m_vWorkers[i]->Random = 0x9E3779B9u * (i + 1);
+	}
+	for (unsigned int i = 1; i < uThreads; i++)
+		m_vThreads.emplace_back(&JobScheduler::WorkerMain, this, i);
+	m_Total.Threads = uThreads;
+	m_LastFrame.Threads = uThreads;
+}
+
+/// <summary>
+/// Runs every job that is still queued, then stops the workers
+/// </summary>
+JobScheduler::~JobScheduler()
+{
+	bool bRan = true;
+	while (bRan)
+		bRan = RunOne(0);
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_bStopping = true;
+	}
+	m_WorkAvailable.notify_all();
+	for (std::thread& thread : m_vThreads)
+		thread.join();
+}
+
+/// <summary>
+/// Queues a job, counted on a counter until it has finished. From a worker it goes onto the
+/// worker's own deque; from any other thread (or with the deque full) it runs right away.
+/// </summary>
+/// <param name="a_Counter">Counter the job is counted on</param>
+/// <param name="a_Job">Job, which may queue more jobs and wait on them</param>
+/// <param name="a_pAfter">Counter the job waits for before it starts, or null. Queue every job
+/// of that counter before making others wait for it, since it is done whenever it reaches 0.</param>
+void JobScheduler::Run(JobCounter& a_Counter, std::function<void()> a_Job, JobCounter* a_pAfter)
+{
+	a_Counter.m_uPending++;
+	Job* pJob = new Job{ std::move(a_Job), &a_Counter };
+
+	if (a_pAfter)
+	{
+		// the job that brings the count to 0 releases the held jobs under the same lock
+		std::lock_guard<std::mutex> lock(a_pAfter->m_Mutex);
+		if (a_pAfter->m_uPending > 0)
+		{
+			a_pAfter->m_vHeld.push_back(pJob);
+			return;
+		}
+	}
+	Queue(pJob);
+}
+
+/// <summary>
+/// Returns when every job counted on a counter has finished. Workers run jobs while they wait,
+/// so jobs may wait on the jobs they queue.
+/// </summary>
+/// <param name="a_Counter">Counter to wait for</param>
+void JobScheduler::Wait(JobCounter& a_Counter)
+{
+	unsigned int uWorker = WorkerIndex();
+	while (a_Counter.m_uPending.load() > 0)
+	{
+		if (uWorker == UINT_MAX || !RunOne(uWorker))
+			std::this_thread::yield();
+	}
+
+	// the job that brought the count to 0 may still be releasing held jobs
+	std::lock_guard<std::mutex> lock(a_Counter.m_Mutex);
+}
+
+/// <summary>
+/// Closes the frame's counts (see GetStats)
+/// </summary>
+void JobScheduler::EndFrame()
+{
+	JobSchedulerStats total = {};
+	total.Threads = (unsigned int)m_vWorkers.size();
+	for (const std::unique_ptr<Worker>& spWorker : m_vWorkers)
+	{
+		total.Jobs += spWorker->Ran;
+		total.Steals += spWorker->Stolen;
+		total.Inline += spWorker->Inline;
+		total.Sleeps += spWorker->Sleeps;
+	}
+	m_LastFrame.Threads = total.Threads;
+	m_LastFrame.Jobs = total.Jobs - m_Total.Jobs;
+	m_LastFrame.Steals = total.Steals - m_Total.Steals;
+	m_LastFrame.Inline = total.Inline - m_Total.Inline;
+	m_LastFrame.Sleeps = total.Sleeps - m_Total.Sleeps;
+	m_Total = total;
+}
+
+/// <summary>
+/// Finds which of this scheduler's workers the calling thread is
+/// </summary>
+/// <returns>Worker index, UINT_MAX for other threads</returns>
+unsigned int JobScheduler::WorkerIndex()
+{
+	if (t_pScheduler == this)
+		return t_uWorker;
+	return std::this_thread::get_id() == m_OwnerThread ? 0 : UINT_MAX;
+}
+
+/// <summary>
+/// Whether the calling worker has nothing queued, so splitting work off would feed an idle worker.
+/// False on other threads, which can't queue.
+/// </summary>
+bool JobScheduler::IsOwnDequeEmpty()
+{
+	unsigned int uWorker = WorkerIndex();
+	return uWorker != UINT_MAX && m_vWorkers.size() > 1 && m_vWorkers[uWorker]->Jobs.IsEmpty();
+}
+
+/// <summary>
+/// Puts a job on the calling worker's deque and wakes a sleeping worker for it
+/// </summary>
+void JobScheduler::Queue(Job* a_pJob)
+{
+	unsigned int uWorker = WorkerIndex();
+	if (uWorker == UINT_MAX)
+	{
+		m_vWorkers[0]->Inline++;
+		Execute(a_pJob);
+		return;
+	}
+
+	// counted before it is pushed, so a thief never sees the count go below zero
+	m_uQueued++;
+	if (!m_vWorkers[uWorker]->Jobs.Push(a_pJob))
+	{
+		m_uQueued--;
+		m_vWorkers[uWorker]->Inline++;
+		Execute(a_pJob);
+		return;
+	}
+
+	// a worker going to sleep counts itself before it checks m_uQueued, so one of the two sees the other
+	if (m_uSleeping.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_SleepMutex);
+		}
+		m_WorkAvailable.notify_one();
+	}
+}
+
+/// <summary>
+/// Takes the newest job off a worker's deque, or else steals the oldest one of another, and runs it
+/// </summary>
+/// <param name="a_uWorker">The worker</param>
+/// <returns>False if no job was found</returns>
+bool JobScheduler::RunOne(unsigned int a_uWorker)
+{
+	Worker& worker = *m_vWorkers[a_uWorker];
+	Job* pJob = worker.Jobs.Pop();
+	if (!pJob && m_uQueued.load() > 0)
+	{
+		// start at a random victim, so thieves don't all pile onto the same deque
+		worker.Random ^= worker.Random << 13;
+		worker.Random ^= worker.Random >> 17;
+		worker.Random ^= worker.Random << 5;
+		size_t uCount = m_vWorkers.size();
+		size_t uStart = worker.Random % uCount;
+		for (size_t i = 0; i < uCount && !pJob; i++)
+		{
+			size_t uVictim = (uStart + i) % uCount;
+			if (uVictim != a_uWorker)
+				pJob = m_vWorkers[uVictim]->Jobs.Steal();
+		}
+		if (pJob)
+			worker.Stolen++;
+	}
+	if (!pJob)
+		return false;
+
+	m_uQueued--;
+	worker.Ran++;
+	Execute(pJob);
+	return true;
+}
+
+/// <summary>
+/// Runs a job and counts it off its counter, releasing the jobs held back by the counter if it was the last
+/// </summary>
+void JobScheduler::Execute(Job* a_pJob)
+{
+	a_pJob->Run();
+	JobCounter& counter = *a_pJob->Counter;
+	delete a_pJob;
+
+	// only the last job takes the lock; a waiter takes it too before it lets the counter go
+	uint32_t uPending = counter.m_uPending.load();
+	while (uPending > 1)
+	{
+		if (counter.m_uPending.compare_exchange_weak(uPending, uPending - 1))
+			return;
+	}
+	std::vector<Job*> vHeld;
+	{
+		std::lock_guard<std::mutex> lock(counter.m_Mutex);
+		if (--counter.m_uPending == 0)
+			vHeld.swap(counter.m_vHeld);
+	}
+	for (Job* pHeld : vHeld)
+		Queue(pHeld);
+}
+
+/// <summary>
+/// Worker loop: runs jobs, its own first, and sleeps when there are none, until the scheduler is destroyed
+/// </summary>
+/// <param name="a_uWorker">The worker</param>
+void JobScheduler::WorkerMain(unsigned int a_uWorker)
+{
+	t_pScheduler = this;
+	t_uWorker = a_uWorker;
+	while (true)
+	{
+		bool bRan = false;
+		for (int i = 0; i < JOB_SPIN_COUNT && !bRan; i++)
+		{
+			bRan = RunOne(a_uWorker);
+			if (!bRan)
+				std::this_thread::yield();
+		}
+		if (bRan)
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		m_uSleeping++;
+		m_vWorkers[a_uWorker]->Sleeps++;
+		m_WorkAvailable.wait(lock, [this] { return m_bStopping || m_uQueued.load() > 0; });
+		m_uSleeping--;
+		if (m_bStopping && m_uQueued.load() == 0)
+			break;
+	}
+}
+
+#pragma region Getters
+/// <summary>
+/// Gets the number of workers, counting the thread that created the scheduler
+/// </summary>
+/// <returns>Thread count</returns>
+unsigned int JobScheduler::GetThreadCount()
+{
+	return (unsigned int)m_vWorkers.size();
+}
+/// <summary>
+/// Gets what the scheduler did in the frame before the last EndFrame
+/// </summary>
+/// <returns>Scheduler statistics</returns>
+JobSchedulerStats JobScheduler::GetStats()
+{
+	return m_LastFrame;
+}
+#pragma endregion
+
+/// <summary>
+/// Measures how the scheduler scales: builds a_uItems world matrices from random positions,
+/// rotations and scales with ParallelFor, and queues and waits on empty jobs, on schedulers of
+/// 1, 2, 4 ... JOB_BENCHMARK_MAX_THREADS workers. Counts above the hardware's share its cores.
+/// </summary>
+/// <param name="a_uItems">Number of matrices</param>
+/// <param name="a_uSeed">Seed of the random transforms</param>
+/// <returns>Timings of every thread count</returns>
+JobSchedulerBenchmark BenchmarkJobScheduler(unsigned int a_uItems, unsigned int a_uSeed)
+{
+	const unsigned int EMPTY_JOBS = 1 << 14;
+	const unsigned int EMPTY_JOB_BATCH = JOB_DEQUE_CAPACITY / 2;
+
+	std::mt19937 random(a_uSeed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<DirectX::XMFLOAT4> vLocal(a_uItems * (size_t)3);
+	for (DirectX::XMFLOAT4& f4 : vLocal)
+		f4 = DirectX::XMFLOAT4(unit(random), unit(random), unit(random), unit(random));
+	std::vector<DirectX::XMFLOAT4X4> vWorld(a_uItems);
+
+	// a batch of matrices per item range; each one is independent of the others
+	auto Build = [&](uint32_t a_uFirst, uint32_t a_uEnd)
+	{
+		for (uint32_t i = a_uFirst; i < a_uEnd; i++)
+		{
+			DirectX::XMVECTOR vRotation = DirectX::XMQuaternionNormalize(DirectX::XMLoadFloat4(&vLocal[i * 3 + 1]));
+			DirectX::XMMATRIX m4World = DirectX::XMMatrixAffineTransformation(DirectX::XMLoadFloat4(&vLocal[i * 3 + 2]),
+				DirectX::XMVectorZero(), vRotation, DirectX::XMLoadFloat4(&vLocal[i * 3]));
+			DirectX::XMStoreFloat4x4(&vWorld[i], DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, m4World)));
+		}
+	};
+
+	JobSchedulerBenchmark result = {};
+	result.Items = a_uItems;
+	result.HardwareThreads = (std::max)(1u, std::thread::hardware_concurrency());
+	for (unsigned int uThreads = 1; uThreads <= JOB_BENCHMARK_MAX_THREADS && result.Cases < JOB_BENCHMARK_CASES; uThreads *= 2)
+	{
+		JobScheduler scheduler(uThreads);
+		JobScalingCase& scaling = result.Results[result.Cases++];
+		scaling.Threads = uThreads;
+		scaling.Milliseconds = DBL_MAX;
+		scaling.JobMicroseconds = DBL_MAX;
+		for (int nRun = 0; nRun < JOB_BENCHMARK_RUNS; nRun++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			scheduler.ParallelFor(a_uItems, 256, Build);
+			scaling.Milliseconds = (std::min)(scaling.Milliseconds, MillisecondsSince(start));
+
+			// queued in batches that fit the deque, so none of them run inline
+			start = std::chrono::high_resolution_clock::now();
+			for (unsigned int uQueued = 0; uQueued < EMPTY_JOBS; uQueued += EMPTY_JOB_BATCH)
+			{
+				JobCounter counter;
+				for (unsigned int i = 0; i < EMPTY_JOB_BATCH; i++)
+					scheduler.Run(counter, [] {});
+				scheduler.Wait(counter);
+			}
+			scaling.JobMicroseconds = (std::min)(scaling.JobMicroseconds, MillisecondsSince(start) * 1000.0 / EMPTY_JOBS);
+		}
+		scheduler.EndFrame();
+		scaling.Steals = scheduler.GetStats().Steals;
+		scaling.Speedup = result.Results[0].Milliseconds / scaling.Milliseconds;
+	}
+	return result;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Jobs each worker's deque holds (a power of two); a job that doesn't fit runs right away
+#define JOB_DEQUE_CAPACITY 4096
+
+// Times an idle worker looks for a job to steal before it goes to sleep
+#define JOB_SPIN_COUNT 64
+
+// Thread counts BenchmarkJobScheduler goes up to, doubling from 1
+#define JOB_BENCHMARK_MAX_THREADS 64
+#define JOB_BENCHMARK_CASES 7
+
+// Times each case of BenchmarkJobScheduler runs (the best run counts)
+#define JOB_BENCHMARK_RUNS 3
+
+// --------------------------------------------------------
+// What the scheduler did last frame
+// --------------------------------------------------------
+struct JobSchedulerStats
+{
+	unsigned int Threads;	// workers, counting the thread that created the scheduler
+	uint64_t Jobs;			// jobs run
+	uint64_t Steals;		// jobs run by another worker than the one that queued them
+	uint64_t Inline;		// jobs run on the spot because the deque was full or the caller isn't a worker
+	uint64_t Sleeps;		// times a worker ran out of jobs and slept
+};
+
+// --------------------------------------------------------
+// One thread count of BenchmarkJobScheduler
+// --------------------------------------------------------
+struct JobScalingCase
+{
+	unsigned int Threads;
+	double Milliseconds;		// ParallelFor over the items
+	double Speedup;				// of the single-threaded case
+	double JobMicroseconds;		// cost of one empty job, queued and waited on
+	uint64_t Steals;
+};
+
+// --------------------------------------------------------
+// Result of BenchmarkJobScheduler
+// --------------------------------------------------------
+struct JobSchedulerBenchmark
+{
+	unsigned int Items;
+	unsigned int HardwareThreads;	// cases beyond this share the cores
+	unsigned int Cases;
+	JobScalingCase Results[JOB_BENCHMARK_CASES];
+};
+
+struct Job;
+
+// --------------------------------------------------------
+// Counts the jobs of a group that haven't finished. Jobs
+// can be held back until another counter is done, which is
+// how dependencies are expressed. A counter must outlive
+// the jobs counted on it and the jobs held back by it.
+// --------------------------------------------------------
+class JobCounter
+{
+public:
+	JobCounter();
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const;
+
+private:
+	friend class JobScheduler;
+
+	std::atomic<uint32_t> m_uPending;
+	std::mutex m_Mutex; //taken by the job that brings the count to 0, and to hold jobs back
+	std::vector<Job*> m_vHeld; //jobs that start when the count reaches 0
+};
+
+// --------------------------------------------------------
+// A queued job and the counter it finishes
+// --------------------------------------------------------
+struct Job
+{
+	std::function<void()> Run;
+	JobCounter* Counter;
+};
+
+// --------------------------------------------------------
+// Runs jobs on one worker thread per core. The thread that
+// creates the scheduler is worker 0 and works while it
+// waits. Each worker queues its jobs on a Chase-Lev deque
+// of its own: it takes the newest back first, while its
+// data is still in cache, and idle workers steal the
+// oldest, which is usually the largest piece left. Jobs
+// queued from threads that aren't workers run on the spot.
+// --------------------------------------------------------
+class JobScheduler
+{
+public:
+	JobScheduler(unsigned int a_uThreadCount = 0);
+	~JobScheduler();
+	JobScheduler(const JobScheduler&) = delete;
+	JobScheduler& operator=(const JobScheduler&) = delete;
+
+	void Run(JobCounter& a_Counter, std::function<void()> a_Job, JobCounter* a_pAfter = nullptr);
+	void Wait(JobCounter& a_Counter);
+	template <typename BODY>
+	void ParallelFor(uint32_t a_uCount, uint32_t a_uMinChunk, const BODY& a_Body);
+	void EndFrame();
+
+	// getters
+	unsigned int GetThreadCount();
+	JobSchedulerStats GetStats();
+
+private:
+	// --------------------------------------------------------
+	// Fixed-size Chase-Lev deque: the owner pushes and pops at
+	// the bottom, thieves take from the top, and only taking
+	// the last job needs a compare-and-swap
+	// --------------------------------------------------------
+	class Deque
+	{
+	public:
+		Deque();
+		bool Push(Job* a_pJob);
+		Job* Pop();
+		Job* Steal();
+		bool IsEmpty() const;
+
+	private:
+		alignas(64) std::atomic<int64_t> m_nTop;
+		alignas(64) std::atomic<int64_t> m_nBottom;
+		std::atomic<Job*> m_pJobs[JOB_DEQUE_CAPACITY];
+	};
+
+	// One worker's deque and counts, on cache lines of their own
+	struct alignas(64) Worker
+	{
+		Deque Jobs;
+		std::atomic<uint64_t> Ran;
+		std::atomic<uint64_t> Stolen;
+		std::atomic<uint64_t> Inline;
+		std::atomic<uint64_t> Sleeps;
+		uint32_t Random; //picks the first worker to steal from
+	};
+
+	std::vector<std::unique_ptr<Worker>> m_vWorkers;
+	std::vector<std::thread> m_vThreads;
+	std::thread::id m_OwnerThread; //worker 0
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WorkAvailable;
+	std::atomic<uint32_t> m_uQueued; //jobs in the deques
+	std::atomic<uint32_t> m_uSleeping;
+	bool m_bStopping;
+	JobSchedulerStats m_Total = {}; //counts up to the last EndFrame
+	JobSchedulerStats m_LastFrame = {};
+
+	unsigned int WorkerIndex();
+	bool IsOwnDequeEmpty();
+	void Queue(Job* a_pJob);
+	bool RunOne(unsigned int a_uWorker);
+	void Execute(Job* a_pJob);
+	void WorkerMain(unsigned int a_uWorker);
+};
+
+/// <summary>
+/// Runs a_Body(first, end) over bands of [0, a_uCount) that together cover it once, and returns
+/// when all of them are done. A band splits its upper half off as a job only while its worker's
+/// deque is empty (lazy binary splitting), so the band size follows how busy the other workers are
+/// instead of being fixed, and a worker with nobody to share with runs its band in one go.
+/// </summary>
+/// <param name="a_uCount">Number of items</param>
+/// <param name="a_uMinChunk">Fewest items worth a job of their own</param>
+/// <param name="a_Body">Called with the first and end item of each band, from any worker</param>
+template <typename BODY>
+void JobScheduler::ParallelFor(uint32_t a_uCount, uint32_t a_uMinChunk, const BODY& a_Body)
+{
+	JobCounter counter;
+	uint32_t uMinChunk = a_uMinChunk > 0 ? a_uMinChunk : 1;
+	std::function<void(uint32_t, uint32_t)> band = [&](uint32_t a_uFirst, uint32_t a_uEnd)
+	{
+		while (a_uFirst < a_uEnd)
+		{
+			if (a_uEnd - a_uFirst > uMinChunk && IsOwnDequeEmpty())
+			{
+				uint32_t uMiddle = a_uFirst + (a_uEnd - a_uFirst) / 2;
+				Run(counter, [&band, uMiddle, a_uEnd] { band(uMiddle, a_uEnd); });
+				a_uEnd = uMiddle;
+				continue;
+			}
+			uint32_t uStop = a_uEnd - a_uFirst > uMinChunk ? a_uFirst + uMinChunk : a_uEnd;
+			a_Body(a_uFirst, uStop);
+			a_uFirst = uStop;
+		}
+	};
+	band(0, a_uCount);
+	Wait(counter);
+}
+
+// Times a ParallelFor over a_uItems matrices, and empty jobs, on 1 to JOB_BENCHMARK_MAX_THREADS workers
+JobSchedulerBenchmark BenchmarkJobScheduler(unsigned int a_uItems, unsigned int a_uSeed = 1);
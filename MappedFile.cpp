@@ -0,0 +1,125 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Opens and maps the given file for reading. Check IsOpen() afterwards.
+/// </summary>
+/// <param name="a_sFileName">Path to the file</param>
+MappedFile::MappedFile(const char* a_sFileName)
+{
+	m_pData = nullptr;
+	m_uSize = 0;
+
+#ifdef _WIN32
+	m_hMapping = nullptr;
+	m_hFile = CreateFileA(a_sFileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		m_hFile = nullptr;
+		return;
+	}
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return;
+	}
+	m_uSize = (size_t)size.QuadPart;
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping == nullptr)
+	{
+		Close();
+		return;
+	}
+
+	m_pData = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_pData == nullptr)
+		Close();
+#else
+	m_nFile = open(a_sFileName, O_RDONLY);
+	if (m_nFile < 0)
+		return;
+
+	struct stat info = {};
+	if (fstat(m_nFile, &info) != 0 || info.st_size == 0)
+	{
+		Close();
+		return;
+	}
+	m_uSize = (size_t)info.st_size;
+
+	void* pView = mmap(nullptr, m_uSize, PROT_READ, MAP_PRIVATE, m_nFile, 0);
+	if (pView == MAP_FAILED)
+	{
+		Close();
+		return;
+	}
+	m_pData = (const char*)pView;
+	madvise(pView, m_uSize, MADV_SEQUENTIAL);
+#endif
+}
+
+// unmaps the view and closes the file
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/// <summary>
+/// Releases the view, mapping and file handle (whichever exist)
+/// </summary>
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_hMapping) CloseHandle(m_hMapping);
+	if (m_hFile) CloseHandle(m_hFile);
+	m_hMapping = nullptr;
+	m_hFile = nullptr;
+#else
+	if (m_pData) munmap((void*)m_pData, m_uSize);
+	if (m_nFile >= 0) close(m_nFile);
+	m_nFile = -1;
+#endif
+	m_pData = nullptr;
+	m_uSize = 0;
+}
+
+#pragma region Getters
+/// <summary>
+/// Returns whether the file was opened and mapped successfully
+/// </summary>
+/// <returns>true if the data pointer is valid</returns>
+bool MappedFile::IsOpen()
+{
+	return m_pData != nullptr;
+}
+
+/// <summary>
+/// Returns a pointer to the first byte of the mapped file
+/// </summary>
+/// <returns>mapped file data</returns>
+const char* MappedFile::GetData()
+{
+	return m_pData;
+}
+
+/// <summary>
+/// Returns the size of the mapped file in bytes
+/// </summary>
+/// <returns>file size in bytes</returns>
+size_t MappedFile::GetSize()
+{
+	return m_uSize;
+}
+#pragma endregion
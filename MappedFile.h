@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// A read-only, memory-mapped view of an entire file
+//
+// The mapping lives exactly as long as this object, so any
+// pointer handed out by GetData() must not outlive it.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const char* a_sFileName);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete; // Remove copy constructor
+	MappedFile& operator=(const MappedFile&) = delete; // Remove copy-assignment operator
+
+	// getters
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	void Close();
+
+#ifdef _WIN32
+	void* m_hFile;		// HANDLE of the open file
+	void* m_hMapping;	// HANDLE of the file mapping object
+#else
+	int m_nFile;		// file descriptor of the open file
+#endif
+
+	const char* m_pData;	// start of the mapped view
+	size_t m_uSize;		// size of the mapped view in bytes
+};
@@ -27,6 +27,16 @@ void Material::AddTextureSRV(std::string a_sShaderResourceName, Microsoft::WRL::
 	m_htTextureSRVs.insert({ a_sShaderResourceName, a_cpTextureSRV });
 }
 /// <summary>
+/// Adds a texture that may still be loading under the given key. Whatever view it holds
+/// when the material is prepared gets bound, so the real texture replaces the placeholder by itself.
+/// </summary>
+/// <param name="a_sShaderResourceName">Hash table key; name of the shader variable</param>
+/// <param name="a_spTexture">Texture from the asset loader</param>
+void Material::AddTexture(std::string a_sShaderResourceName, std::shared_ptr<TextureAsset> a_spTexture)
+{
+	m_htTextureAssets.insert({ a_sShaderResourceName, a_spTexture });
+}
+/// <summary>
 /// Adds the given sampler state to the sampler state hash table unde the given key
 /// </summary>
 /// <param name="a_sShaderResourceName">Hash table key; name of the shader variable</param>
@@ -36,11 +46,22 @@ void Material::AddSampler(std::string a_sShaderResourceName, Microsoft::WRL::Com
 	m_htSamplers.insert({ a_sShaderResourceName,a_cpSampler });
 }
 /// <summary>
+/// Sets the material's packed occlusion/roughness/metalness maps and binds them as "PackedMaps".
+/// Their constant channels replace texture fetches in the shader (see GetPackedConstant).
+/// </summary>
+/// <param name="a_spPackedMaps">Packed maps from the asset loader</param>
+void Material::SetPackedMaps(std::shared_ptr<TextureAsset> a_spPackedMaps)
+{
+	m_spPackedMaps = a_spPackedMaps;
+	m_htTextureAssets.insert_or_assign("PackedMaps", a_spPackedMaps);
+}
+/// <summary>
 /// Binds this material's SRVs and sampler states to the pixel shader
 /// </summary>
 void Material::PrepareMaterial()
 {
 	for (auto& t : m_htTextureSRVs) { m_spPixelShader->SetShaderResourceView(t.first.c_str(), t.second); }
+	for (auto& t : m_htTextureAssets) { m_spPixelShader->SetShaderResourceView(t.first.c_str(), t.second->SRV); }
 	for (auto& s : m_htSamplers) { m_spPixelShader->SetSamplerState(s.first.c_str(), s.second); }
 }
 
@@ -62,6 +83,14 @@ std::shared_ptr<SimpleVertexShader> Material::GetVertexShader()
 	return m_spVertexShader;
 }
 /// <summary>
+/// Gets the vertex shader that draws the material instanced
+/// </summary>
+/// <returns>Instanced vertex shader, or null if the material is only drawn one entity at a time</returns>
+std::shared_ptr<SimpleVertexShader> Material::GetInstancedVertexShader()
+{
+	return m_spInstancedVertexShader;
+}
+/// <summary>
 /// Gets the material's pixel shader
 /// </summary>
 /// <returns>pixel shader</returns>
@@ -91,7 +120,17 @@ DirectX::XMFLOAT2 Material::GetUVOffset()
 /// <returns>Hash table containing texture SRVs</returns>
 std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> Material::GetTextureSRVs()
 {
-	return m_htTextureSRVs;
+	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> htTextureSRVs = m_htTextureSRVs;
+	for (auto& t : m_htTextureAssets) { htTextureSRVs.insert({ t.first, t.second->SRV }); }
+	return htTextureSRVs;
+}
+/// <summary>
+/// Gets this material's textures that came from the asset loader, including its packed maps
+/// </summary>
+/// <returns>Hash table containing texture handles</returns>
+const std::unordered_map<std::string, std::shared_ptr<TextureAsset>>& Material::GetTextureAssets()
+{
+	return m_htTextureAssets;
 }
 /// <summary>
 /// Gets this material's hash table of sampler states
@@ -109,6 +148,23 @@ float Material::GetRoughness()
 {
 	return m_fRoughness;
 }
+/// <summary>
+/// Gets the occlusion, roughness and metalness the shader uses for channels it doesn't sample;
+/// without packed maps that is no occlusion, this material's roughness and no metalness
+/// </summary>
+/// <returns>Occlusion, roughness, metalness</returns>
+DirectX::XMFLOAT3 Material::GetPackedConstant()
+{
+	return m_spPackedMaps ? m_spPackedMaps->Constant : DirectX::XMFLOAT3(1.0f, m_fRoughness, 0.0f);
+}
+/// <summary>
+/// Gets which packed channels have to be sampled (1) rather than taken from GetPackedConstant (0)
+/// </summary>
+/// <returns>Occlusion, roughness, metalness</returns>
+DirectX::XMFLOAT3 Material::GetPackedSampled()
+{
+	return m_spPackedMaps ? m_spPackedMaps->Sampled : DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+}
 #pragma endregion
 #pragma region Setters
 /// <summary>
@@ -139,6 +195,14 @@ void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> a_spVertexSha
 	m_spVertexShader = a_spVertexShader;
 }
 /// <summary>
+/// Sets the vertex shader that draws the material instanced
+/// </summary>
+/// <param name="a_spInstancedVertexShader">Instanced counterpart of the vertex shader (see Mesh::LoadVertexShader)</param>
+void Material::SetInstancedVertexShader(std::shared_ptr<SimpleVertexShader> a_spInstancedVertexShader)
+{
+	m_spInstancedVertexShader = a_spInstancedVertexShader;
+}
+/// <summary>
 /// Sets the material's pixel shader to the given pixel shader
 /// </summary>
 /// <param name="a_spPixelShader">Pixel shader</param>
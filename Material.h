@@ -3,6 +3,7 @@
 #include <memory>
 #include "SimpleShader.h"
 #include <unordered_map>
+#include "TextureAsset.h"
 
 class Material
 {
@@ -12,17 +13,22 @@ public:
 	// getters
 	DirectX::XMFLOAT4 GetColorTint();
 	std::shared_ptr<SimpleVertexShader> GetVertexShader();
+	std::shared_ptr<SimpleVertexShader> GetInstancedVertexShader();
 	std::shared_ptr<SimplePixelShader> GetPixelShader();
 	DirectX::XMFLOAT2 GetUVScale();
 	DirectX::XMFLOAT2 GetUVOffset();
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> GetTextureSRVs();
+	const std::unordered_map<std::string, std::shared_ptr<TextureAsset>>& GetTextureAssets();
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> GetSamplers();
 	float GetRoughness();
+	DirectX::XMFLOAT3 GetPackedConstant();
+	DirectX::XMFLOAT3 GetPackedSampled();
 
 	// setters
 	void SetColorTint(DirectX::XMFLOAT4 a_f4ColorTint);
 	void SetColorTint(float a_fRed, float a_fGreen, float a_fBlue, float a_fAlpha);
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> a_spVertexShader);
+	void SetInstancedVertexShader(std::shared_ptr<SimpleVertexShader> a_spInstancedVertexShader);
 	void SetPixelShader(std::shared_ptr<SimplePixelShader> a_spPixelShader);
 	void SetUVScale(DirectX::XMFLOAT2 a_f2UVScale);
 	void SetUVScale(float a_fU, float a_fV);
@@ -31,15 +37,20 @@ public:
 	void SetRoughness(float a_fRoughness);
 
 	void AddTextureSRV(std::string a_sShaderResourceName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> a_cpTextureSRV);
+	void AddTexture(std::string a_sShaderResourceName, std::shared_ptr<TextureAsset> a_spTexture);
 	void AddSampler(std::string a_sShaderResourceName, Microsoft::WRL::ComPtr<ID3D11SamplerState> a_cpSampler);
+	void SetPackedMaps(std::shared_ptr<TextureAsset> a_spPackedMaps);
 	void PrepareMaterial();
 
 private:
 	DirectX::XMFLOAT4 m_f4ColorTint;
 	std::shared_ptr<SimpleVertexShader> m_spVertexShader;
+	std::shared_ptr<SimpleVertexShader> m_spInstancedVertexShader; //takes the world matrices per instance, null if the material can't be instanced
 	std::shared_ptr<SimplePixelShader> m_spPixelShader;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_htTextureSRVs;
+	std::unordered_map<std::string, std::shared_ptr<TextureAsset>> m_htTextureAssets; //textures that may still be loading
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> m_htSamplers;
+	std::shared_ptr<TextureAsset> m_spPackedMaps; //occlusion/roughness/metalness, null if the material has none
 	float m_fRoughness;
 
 	DirectX::XMFLOAT2 m_f2UVScale;
@@ -0,0 +1,129 @@
+#include "MaterialPacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace
+{
+	/// <summary>
+	/// Red channel of an image at a position given in the pixels of another size (nearest)
+	/// </summary>
+	uint8_t SampleRed(const DecodedImage& a_Image, uint32_t a_uX, uint32_t a_uY, uint32_t a_uWidth, uint32_t a_uHeight)
+	{
+		size_t uX = (size_t)a_uX * a_Image.Width / a_uWidth;
+		size_t uY = (size_t)a_uY * a_Image.Height / a_uHeight;
+		return a_Image.Pixels[(uY * a_Image.Width + uX) * 4];
+	}
+
+	/// <summary>
+	/// Checks whether the red channel of a map stays within PACKED_CONSTANT_TOLERANCE of its mean
+	/// </summary>
+	/// <param name="a_fMean">Receives the mean, 0-1</param>
+	bool IsConstant(const DecodedImage& a_Image, float& a_fMean)
+	{
+		size_t uPixels = (size_t)a_Image.Width * a_Image.Height;
+		uint64_t uSum = 0;
+		uint8_t uMin = 255, uMax = 0;
+		for (size_t i = 0; i < uPixels; i++)
+		{
+			uint8_t uValue = a_Image.Pixels[i * 4];
+			uSum += uValue;
+			uMin = std::min(uMin, uValue);
+			uMax = std::max(uMax, uValue);
+		}
+		float fMean = (float)uSum / (float)std::max<size_t>(1, uPixels);
+		a_fMean = fMean / 255.0f;
+		return fMean - uMin <= PACKED_CONSTANT_TOLERANCE && uMax - fMean <= PACKED_CONSTANT_TOLERANCE;
+	}
+}
+
+/// <summary>
+/// Packs occlusion, roughness and metalness into one texture
+/// </summary>
+/// <param name="a_Packed">Receives the packed image and the constant channels</param>
+/// <param name="a_pOcclusion">Occlusion map, or null</param>
+/// <param name="a_pRoughness">Roughness map, or null</param>
+/// <param name="a_pMetalness">Metalness map, or null</param>
+/// <param name="a_pDefaults">Values of the channels without a map</param>
+void PackMaterialMaps(PackedMaterialMaps& a_Packed, const DecodedImage* a_pOcclusion, const DecodedImage* a_pRoughness,
+	const DecodedImage* a_pMetalness, const float a_pDefaults[PACKED_CHANNEL_COUNT])
+{
+	const DecodedImage* sources[PACKED_CHANNEL_COUNT] = { a_pOcclusion, a_pRoughness, a_pMetalness };
+
+	// flat maps collapse to their mean; only the channels that vary set the size
+	uint32_t uWidth = 1, uHeight = 1;
+	for (int c = 0; c < PACKED_CHANNEL_COUNT; c++)
+	{
+		a_Packed.Constant[c] = true;
+		a_Packed.ConstantValue[c] = a_pDefaults[c];
+		if (sources[c] && !IsConstant(*sources[c], a_Packed.ConstantValue[c]))
+		{
+			a_Packed.Constant[c] = false;
+			uWidth = std::max(uWidth, sources[c]->Width);
+			uHeight = std::max(uHeight, sources[c]->Height);
+		}
+	}
+
+	a_Packed.Image.Width = uWidth;
+	a_Packed.Image.Height = uHeight;
+	a_Packed.Image.SRGB = false;
+	a_Packed.Image.Pixels.resize((size_t)uWidth * uHeight * 4);
+	uint8_t constants[PACKED_CHANNEL_COUNT];
+	for (int c = 0; c < PACKED_CHANNEL_COUNT; c++)
+		constants[c] = (uint8_t)lrintf(std::clamp(a_Packed.ConstantValue[c], 0.0f, 1.0f) * 255.0f);
+
+	for (uint32_t y = 0; y < uHeight; y++)
+	{
+		uint8_t* pOut = &a_Packed.Image.Pixels[(size_t)y * uWidth * 4];
+		for (uint32_t x = 0; x < uWidth; x++, pOut += 4)
+		{
+			for (int c = 0; c < PACKED_CHANNEL_COUNT; c++)
+				pOut[c] = a_Packed.Constant[c] ? constants[c] : SampleRed(*sources[c], x, y, uWidth, uHeight);
+			pOut[3] = 255;
+		}
+	}
+}
+
+/// <summary>
+/// Measures how far a packed image is from the maps it was packed from
+/// </summary>
+/// <param name="a_Packed">Result of PackMaterialMaps</param>
+/// <param name="a_Image">Image to check: a_Packed.Image, or the same after compression</param>
+/// <param name="a_pOcclusion">Occlusion map, or null</param>
+/// <param name="a_pRoughness">Roughness map, or null</param>
+/// <param name="a_pMetalness">Metalness map, or null</param>
+/// <returns>Error per channel</returns>
+PackedMapValidation ValidatePackedMaps(const PackedMaterialMaps& a_Packed, const DecodedImage& a_Image,
+	const DecodedImage* a_pOcclusion, const DecodedImage* a_pRoughness, const DecodedImage* a_pMetalness)
+{
+	const DecodedImage* sources[PACKED_CHANNEL_COUNT] = { a_pOcclusion, a_pRoughness, a_pMetalness };
+	PackedMapValidation validation = {};
+	for (int c = 0; c < PACKED_CHANNEL_COUNT; c++)
+	{
+		uint32_t uWidth = a_Image.Width, uHeight = a_Image.Height;
+		if (sources[c])
+		{
+			uWidth = std::max(uWidth, sources[c]->Width);
+			uHeight = std::max(uHeight, sources[c]->Height);
+		}
+		int nConstant = (int)lrintf(std::clamp(a_Packed.ConstantValue[c], 0.0f, 1.0f) * 255.0f);
+
+		double dSquaredError = 0.0;
+		for (uint32_t y = 0; y < uHeight; y++)
+			for (uint32_t x = 0; x < uWidth; x++)
+			{
+				size_t uX = (size_t)x * a_Image.Width / uWidth;
+				size_t uY = (size_t)y * a_Image.Height / uHeight;
+				int nPacked = a_Image.Pixels[(uY * a_Image.Width + uX) * 4 + c];
+				int nSource = sources[c] ? SampleRed(*sources[c], x, y, uWidth, uHeight) : nConstant;
+				int nError = abs(nPacked - nSource);
+				validation.MaxError[c] = std::max(validation.MaxError[c], nError);
+				dSquaredError += (double)nError * nError;
+			}
+
+		double dMeanSquaredError = dSquaredError / ((double)uWidth * uHeight);
+		validation.Psnr[c] = dMeanSquaredError == 0.0 ? std::numeric_limits<double>::infinity() : 10.0 * log10(255.0 * 255.0 / dMeanSquaredError);
+	}
+	return validation;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include "ImageDecoder.h"
+
+// Channels of a packed material map
+#define PACKED_CHANNEL_OCCLUSION	0	// red
+#define PACKED_CHANNEL_ROUGHNESS	1	// green
+#define PACKED_CHANNEL_METALNESS	2	// blue
+#define PACKED_CHANNEL_COUNT		3
+
+// Largest difference (in 8-bit steps) from a map's mean for which it still counts as
+// constant; covers the noise JPEG leaves in flat images
+#define PACKED_CONSTANT_TOLERANCE	2
+
+// --------------------------------------------------------
+// A material's occlusion, roughness and metalness maps
+// packed into the RGB channels of one texture. Channels
+// that are the same everywhere are also kept as constants,
+// so the shader can skip the fetch when all of them are.
+// --------------------------------------------------------
+struct PackedMaterialMaps
+{
+	DecodedImage Image;							// RGBA8, alpha 255; 1x1 when every channel is constant
+	bool Constant[PACKED_CHANNEL_COUNT];		// the channel had no map, or its map is flat
+	float ConstantValue[PACKED_CHANNEL_COUNT];	// 0-1 value of a constant channel (also written into Image)
+};
+
+// --------------------------------------------------------
+// Result of ValidatePackedMaps
+// --------------------------------------------------------
+struct PackedMapValidation
+{
+	int MaxError[PACKED_CHANNEL_COUNT];		// largest difference from the source, in 8-bit steps
+	double Psnr[PACKED_CHANNEL_COUNT];		// dB (infinity when the channel matches exactly)
+};
+
+// Packs the red channel of each map into its channel of a_Packed. Any map may be null, in which
+// case its channel is the constant from a_pDefaults (0-1). Maps of different sizes are sampled
+// (nearest) at the size of the largest one.
+void PackMaterialMaps(PackedMaterialMaps& a_Packed, const DecodedImage* a_pOcclusion, const DecodedImage* a_pRoughness,
+	const DecodedImage* a_pMetalness, const float a_pDefaults[PACKED_CHANNEL_COUNT]);
+
+// Compares each channel of a packed image (as packed, or as decompressed after cooking) with the
+// map it came from, or with its constant where there was no map. a_Image may be any size; both
+// sides are sampled (nearest) at the size of the larger one.
+PackedMapValidation ValidatePackedMaps(const PackedMaterialMaps& a_Packed, const DecodedImage& a_Image,
+	const DecodedImage* a_pOcclusion, const DecodedImage* a_pRoughness, const DecodedImage* a_pMetalness);
@@ -6,12 +6,95 @@
 #include "Graphics.h"
 #include "Mesh.h"
 #include <vector>
-#include <fstream>
 #include <stdexcept>
 #include <DirectXMath.h>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "AssetCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexPacking.h"
+#include "TangentGenerator.h"
+#include "InstanceBuffer.h"
+#include "SimpleShader.h"
 
 using namespace DirectX;
 
+namespace
+{
+	// Hashes a face corner for the vertex welding table
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner& a_Corner) const
+		{
+			size_t hash = a_Corner.Position;
+			hash = hash * 0x9E3779B1u + a_Corner.UV;
+			hash = hash * 0x9E3779B1u + a_Corner.Normal;
+			return hash;
+		}
+	};
+
+#if PACKED_VERTICES
+	// The vertex format that ends up in the vertex buffer
+	typedef PackedVertex GpuVertex;
+
+	// Describes the uploaded vertex format to the mesh cache so stale layouts are rejected
+	MeshCacheLayout VertexCacheLayout()
+	{
+		MeshCacheLayout layout = {};
+		layout.Stride = sizeof(PackedVertex);
+		layout.ElementCount = 4;
+		layout.Elements[0] = { MESH_CACHE_POSITION, MESH_CACHE_UNORM16X4, (uint32_t)offsetof(PackedVertex, Position) };
+		layout.Elements[1] = { MESH_CACHE_TEXCOORD, MESH_CACHE_HALF2, (uint32_t)offsetof(PackedVertex, UV) };
+		layout.Elements[2] = { MESH_CACHE_NORMAL, MESH_CACHE_SNORM16X2, (uint32_t)offsetof(PackedVertex, Normal) };
+		layout.Elements[3] = { MESH_CACHE_TANGENT, MESH_CACHE_SNORM16X2, (uint32_t)offsetof(PackedVertex, Tangent) };
+		return layout;
+	}
+#else
+	// The vertex format that ends up in the vertex buffer
+	typedef Vertex GpuVertex;
+
+	// Describes the uploaded vertex format to the mesh cache so stale layouts are rejected
+	MeshCacheLayout VertexCacheLayout()
+	{
+		MeshCacheLayout layout = {};
+		layout.Stride = sizeof(Vertex);
+		layout.ElementCount = 4;
+		layout.Elements[0] = { MESH_CACHE_POSITION, MESH_CACHE_FLOAT3, (uint32_t)offsetof(Vertex, Position) };
+		layout.Elements[1] = { MESH_CACHE_TEXCOORD, MESH_CACHE_FLOAT2, (uint32_t)offsetof(Vertex, UV) };
+		layout.Elements[2] = { MESH_CACHE_NORMAL, MESH_CACHE_FLOAT3, (uint32_t)offsetof(Vertex, Normal) };
+		layout.Elements[3] = { MESH_CACHE_TANGENT, MESH_CACHE_FLOAT4, (uint32_t)offsetof(Vertex, Tangent) };
+		return layout;
+	}
+#endif
+
+	static_assert(MESH_CACHE_MAX_LODS >= MESH_MAX_LODS, "the mesh cache must be able to hold every LOD");
+
+	// Whether a cache entry's LOD table and clusters only point inside its index blob
+	bool CachedRangesFit(const MeshCacheHeader* a_pHeader, const Meshlet* a_pMeshlets)
+	{
+		const MeshCacheInfo& info = a_pHeader->Info;
+		if (info.LodCount == 0 || info.LodCount > MESH_MAX_LODS)
+			return false;
+		for (uint32_t i = 0; i < info.LodCount; i++)
+			if ((uint64_t)info.LodIndexStart[i] + info.LodIndexCount[i] > a_pHeader->IndexCount)
+				return false;
+
+		// clusters cover the full-resolution level
+		for (uint32_t i = 0; i < a_pHeader->MeshletCount; i++)
+			if ((uint64_t)a_pMeshlets[i].IndexStart + (uint64_t)a_pMeshlets[i].TriangleCount * 3 > info.LodIndexStart[0] + info.LodIndexCount[0])
+				return false;
+		return true;
+	}
+}
+
 /// <summary>
 /// Takes a set of verticies and indicies and creates a vertex and index buffer for this mesh
 /// </summary>
@@ -19,416 +102,609 @@ using namespace DirectX;
 /// <param name="a_uVerticiesLength">The number of verticies in the array</param>
 /// <param name="a_pIndicies">Array of indicies</param>
 /// <param name="a_uIndiciesLength">The number of indicies in the array</param>
-Mesh::Mesh(Vertex* a_pVerticies, unsigned int a_uVerticiesLength, unsigned int* a_pIndicies, unsigned int a_uIndiciesLength)
+/// <param name="a_bOptimize">Whether to reorder the geometry for the GPU's vertex cache</param>
+Mesh::Mesh(Vertex* a_pVerticies, unsigned int a_uVerticiesLength, unsigned int* a_pIndicies, unsigned int a_uIndiciesLength, bool a_bOptimize)
 {
+	m_uUnweldedVertices = a_uVerticiesLength;
+	m_dLoadMilliseconds = 0.0;
+	m_uFileBytes = 0;
+	m_uLoadThreads = 0;
+	m_bLoadedFromCache = false;
+	m_dTangentMilliseconds = 0.0;
+	m_uTangentThreads = 0;
+	m_uMirroredVertices = 0;
+	m_ClusterCullStats = {};
+	m_uPendingIndexSize = 0;
+	m_uVersion = 0;
+
+	if (a_bOptimize)
+	{
+		// work on copies since the optimizer can drop triangles and verticies
+		std::vector<Vertex> verts(a_pVerticies, a_pVerticies + a_uVerticiesLength);
+		std::vector<unsigned int> indices(a_pIndicies, a_pIndicies + a_uIndiciesLength);
+		Optimize(verts, indices);
+
+		// the simplified levels only reference verticies of the full mesh
+		CalculateTangents(verts.data(), (int)verts.size(), indices.data(), (int)m_vLods[0].IndexCount);
+		CalculateBounds(verts.data(), (unsigned int)verts.size());
+		BuildClusters(verts.data(), (unsigned int)verts.size(), indices.data());
+		CreateVertexAndIndexBuffers(verts.data(), (unsigned int)verts.size(), indices.data(), (unsigned int)indices.size());
+		return;
+	}
+
+	VertexCacheStats stats = AnalyzeVertexCache(a_pIndicies, a_uIndiciesLength, a_uVerticiesLength);
+	m_fSourceACMR = m_fACMR = stats.ACMR;
+	m_fSourceATVR = m_fATVR = stats.ATVR;
+	m_vLods.assign(1, { 0, a_uIndiciesLength, 0.0f });
+
+	// calculate the tangents for all vertices
+	CalculateTangents(a_pVerticies, a_uVerticiesLength, a_pIndicies, a_uIndiciesLength);
+	CalculateBounds(a_pVerticies, a_uVerticiesLength);
+	BuildClusters(a_pVerticies, a_uVerticiesLength, a_pIndicies);
 	CreateVertexAndIndexBuffers(a_pVerticies, a_uVerticiesLength, a_pIndicies, a_uIndiciesLength);
 }
 
-Mesh::Mesh(const char* a_sFileName)
-{
-	// Author: Chris Cascioli
-	// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-	// 
-	// - You are allowed to directly copy/paste this into your code base
-	//   for assignments, given that you clearly cite that this is not
-	//   code of your own design.
-
-	// *************************************
-	//      IMPLEMENTATION NOTES (1/2)
-	//
-	//  - You'll need to #include both
-	//      <fstream> and <stdexcept>
-	//
-	//  - This is code you will need to 
-	//      integrate into a function or
-	//      constructor of your own making
-	//
-	//  - There is MORE TO DO after pasting 
-	//      this code in - see the bottom for
-	//      what to do *after* including 
-	//      this code in your mesh class
-	//
-	// *************************************
-
-	// File input object
-		std::ifstream obj(a_sFileName);
-
-		// Check for successful open
-		if (!obj.is_open())
-			throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
-
-		// Variables used while reading the file
-		std::vector<DirectX::XMFLOAT3> positions;	// Positions from the file
-		std::vector<DirectX::XMFLOAT3> normals;		// Normals from the file
-		std::vector<DirectX::XMFLOAT2> uvs;		// UVs from the file
-		std::vector<Vertex> verts;		// Verts we're assembling
-		std::vector<UINT> indices;		// Indices of these verts
-		int vertCounter = 0;			// Count of vertices
-		int indexCounter = 0;			// Count of indices
-		char chars[100];			// String for line reading
-
-		// Still have data left?
-		while (obj.good())
+/// <summary>
+/// Loads an .OBJ file and builds a welded, indexed mesh from it. The finished
+/// vertex and index data is cached in a .meshcache file, in the asset cache
+/// keyed by the source's contents (or next to the source when the cache is
+/// off), which later loads map and upload directly without parsing anything.
+/// </summary>
+/// <param name="a_sFileName">Path to the .OBJ file</param>
+/// <param name="a_bOptimize">Whether to reorder the geometry for the GPU's vertex cache</param>
+/// <param name="a_bDeferUpload">Keep the finished data on the CPU until Upload() is called (for loading off the main thread)</param>
+Mesh::Mesh(const char* a_sFileName, bool a_bOptimize, bool a_bDeferUpload)
+{
+	std::string sCacheFileName = GetAssetCachePath(a_bOptimize ? ASSET_KIND_MESH : ASSET_KIND_MESH_UNOPTIMIZED, { a_sFileName });
+	if (sCacheFileName.empty())
+		sCacheFileName = std::string(a_sFileName) + ".meshcache";
+	MeshCacheLayout cacheLayout = VertexCacheLayout();
+	uint32_t uCacheFlags = a_bOptimize ? MESH_CACHE_FLAG_OPTIMIZED : 0;
+	m_bLoadedFromCache = false;
+	m_dTangentMilliseconds = 0.0;
+	m_uTangentThreads = 0;
+	m_uMirroredVertices = 0;
+	m_ClusterCullStats = {};
+	m_uPendingIndexSize = 0;
+	m_uVersion = 0;
+
+	// Fast path: upload straight out of the mapped cache file
+	bool bRefreshStamp = false;
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		MeshCacheFile cache(sCacheFileName.c_str(), a_sFileName, cacheLayout);
+		if (cache.IsValid() && cache.GetHeader()->Info.Flags == uCacheFlags && CachedRangesFit(cache.GetHeader(), cache.GetMeshlets()))
 		{
-			// Get the line (100 characters should be more than enough)
-			obj.getline(chars, 100);
-
-			// Check the type of line
-			if (chars[0] == 'v' && chars[1] == 'n')
-			{
-				// Read the 3 numbers directly into an XMFLOAT3
-				DirectX::XMFLOAT3 norm;
-				sscanf_s(
-					chars,
-					"vn %f %f %f",
-					&norm.x, &norm.y, &norm.z);
-
-				// Add to the list of normals
-				normals.push_back(norm);
-			}
-			else if (chars[0] == 'v' && chars[1] == 't')
-			{
-				// Read the 2 numbers directly into an XMFLOAT2
-				DirectX::XMFLOAT2 uv;
-				sscanf_s(
-					chars,
-					"vt %f %f",
-					&uv.x, &uv.y);
-
-				// Add to the list of uv's
-				uvs.push_back(uv);
-			}
-			else if (chars[0] == 'v')
-			{
-				// Read the 3 numbers directly into an XMFLOAT3
-				DirectX::XMFLOAT3 pos;
-				sscanf_s(
-					chars,
-					"v %f %f %f",
-					&pos.x, &pos.y, &pos.z);
-
-				// Add to the positions
-				positions.push_back(pos);
-			}
-			else if (chars[0] == 'f')
-			{
-				// Read the face indices into an array
-				// NOTE: This assumes the given obj file contains
-				//  vertex positions, uv coordinates AND normals.
-				unsigned int i[12];
-				int numbersRead = sscanf_s(
-					chars,
-					"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-					&i[0], &i[1], &i[2],
-					&i[3], &i[4], &i[5],
-					&i[6], &i[7], &i[8],
-					&i[9], &i[10], &i[11]);
-
-				// If we only got the first number, chances are the OBJ
-				// file has no UV coordinates.  This isn't great, but we
-				// still want to load the model without crashing, so we
-				// need to re-read a different pattern (in which we assume
-				// there are no UVs denoted for any of the vertices)
-				if (numbersRead == 1)
-				{
-					// Re-read with a different pattern
-					numbersRead = sscanf_s(
-						chars,
-						"f %d//%d %d//%d %d//%d %d//%d",
-						&i[0], &i[2],
-						&i[3], &i[5],
-						&i[6], &i[8],
-						&i[9], &i[11]);
-
-					// The following indices are where the UVs should 
-					// have been, so give them a valid value
-					i[1] = 1;
-					i[4] = 1;
-					i[7] = 1;
-					i[10] = 1;
-
-					// If we have no UVs, create a single UV coordinate
-					// that will be used for all vertices
-					if (uvs.size() == 0)
-						uvs.push_back(DirectX::XMFLOAT2(0, 0));
-				}
-
-				// - Create the verts by looking up
-				//    corresponding data from vectors
-				// - OBJ File indices are 1-based, so
-				//    they need to be adusted
-				Vertex v1;
-				v1.Position = positions[i[0] - 1];
-				v1.UV = uvs[i[1] - 1];
-				v1.Normal = normals[i[2] - 1];
-
-				Vertex v2;
-				v2.Position = positions[i[3] - 1];
-				v2.UV = uvs[i[4] - 1];
-				v2.Normal = normals[i[5] - 1];
-
-				Vertex v3;
-				v3.Position = positions[i[6] - 1];
-				v3.UV = uvs[i[7] - 1];
-				v3.Normal = normals[i[8] - 1];
-
-				// The model is most likely in a right-handed space,
-				// especially if it came from Maya.  We want to convert
-				// to a left-handed space for DirectX.  This means we 
-				// need to:
-				//  - Invert the Z position
-				//  - Invert the normal's Z
-				//  - Flip the winding order
-				// We also need to flip the UV coordinate since DirectX
-				// defines (0,0) as the top left of the texture, and many
-				// 3D modeling packages use the bottom left as (0,0)
-
-				// Flip the UV's since they're probably "upside down"
-				v1.UV.y = 1.0f - v1.UV.y;
-				v2.UV.y = 1.0f - v2.UV.y;
-				v3.UV.y = 1.0f - v3.UV.y;
-
-				// Flip Z (LH vs. RH)
-				v1.Position.z *= -1.0f;
-				v2.Position.z *= -1.0f;
-				v3.Position.z *= -1.0f;
-
-				// Flip normal's Z
-				v1.Normal.z *= -1.0f;
-				v2.Normal.z *= -1.0f;
-				v3.Normal.z *= -1.0f;
-
-				// Add the verts to the vector (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v3);
-				verts.push_back(v2);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-
-				// Was there a 4th face?
-				// - 12 numbers read means 4 faces WITH uv's
-				// - 8 numbers read means 4 faces WITHOUT uv's
-				if (numbersRead == 12 || numbersRead == 8)
-				{
-					// Make the last vertex
-					Vertex v4;
-					v4.Position = positions[i[9] - 1];
-					v4.UV = uvs[i[10] - 1];
-					v4.Normal = normals[i[11] - 1];
-
-					// Flip the UV, Z pos and normal's Z
-					v4.UV.y = 1.0f - v4.UV.y;
-					v4.Position.z *= -1.0f;
-					v4.Normal.z *= -1.0f;
-
-					// Add a whole triangle (flipping the winding order)
-					verts.push_back(v1);
-					verts.push_back(v4);
-					verts.push_back(v3);
-					vertCounter += 3;
-
-					// Add three more indices
-					indices.push_back(indexCounter); indexCounter += 1;
-					indices.push_back(indexCounter); indexCounter += 1;
-					indices.push_back(indexCounter); indexCounter += 1;
-				}
-			}
+			const MeshCacheHeader* pHeader = cache.GetHeader();
+			m_uUnweldedVertices = pHeader->Info.UnweldedVertexCount;
+			m_uFileBytes = (size_t)(pHeader->IndexOffset + (uint64_t)pHeader->IndexCount * pHeader->IndexSize);
+			m_uLoadThreads = 1;
+			m_bLoadedFromCache = true;
+			m_f3BoundsMin = DirectX::XMFLOAT3(pHeader->Info.BoundsMin);
+			m_f3BoundsMax = DirectX::XMFLOAT3(pHeader->Info.BoundsMax);
+			m_fSourceACMR = pHeader->Info.SourceACMR;
+			m_fSourceATVR = pHeader->Info.SourceATVR;
+			m_fACMR = pHeader->Info.ACMR;
+			m_fATVR = pHeader->Info.ATVR;
+			m_PackingError = { pHeader->Info.PackingError[0], pHeader->Info.PackingError[1], pHeader->Info.PackingError[2], pHeader->Info.PackingError[3] };
+			m_vLods.resize(pHeader->Info.LodCount);
+			for (uint32_t i = 0; i < pHeader->Info.LodCount; i++)
+				m_vLods[i] = { pHeader->Info.LodIndexStart[i], pHeader->Info.LodIndexCount[i], pHeader->Info.LodError[i] };
+			m_vMeshlets.assign(cache.GetMeshlets(), cache.GetMeshlets() + pHeader->MeshletCount);
+
+			// the cache already holds GPU-ready data
+			if (a_bDeferUpload)
+				StageBuffers(cache.GetVertices(), pHeader->VertexCount, cache.GetIndices(), pHeader->IndexCount, pHeader->IndexSize);
+			else
+				CreateBuffers(cache.GetVertices(), pHeader->VertexCount, cache.GetIndices(), pHeader->IndexCount, pHeader->IndexSize);
+
+			m_dLoadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			bRefreshStamp = cache.IsSourceStampStale();
 		}
+	}
+	if (m_bLoadedFromCache)
+	{
+		// source was touched but its contents are unchanged; the mapping is closed now so the header can be patched
+		if (bRefreshStamp)
+			RefreshMeshCacheStamp(sCacheFileName.c_str(), a_sFileName);
+		return;
+	}
+
+	// Parse the raw file (memory-mapped, chunked across threads)
+	ObjData obj = ParseObjFile(a_sFileName);
+
+	m_dLoadMilliseconds = obj.ParseMilliseconds;
+	m_uFileBytes = obj.FileBytes;
+	m_uLoadThreads = obj.ThreadCount;
 
-		// Close the file and create the actual buffers
-		obj.close();
-
-		// *************************************
-		//      IMPLEMENTATION NOTES (2/2)
-		//
-		// - At this point, "verts" is a std::vector 
-		//     of Vertex structs, and can be used
-		//     to create your mesh's vertex buffer
-		//
-		// - NOTE: Use &verts[0] for the address of 
-		//     the first vertx, NOT JUST &verts
-		//
-		// - The vector "indices" is similar. It's 
-		//     a std::vector of unsigned ints and
-		//     can be used to create the index 
-		//     buffer (again, &indices[0] is the 
-		//     address of the first integer)
-		//
-		// - Make sure your mesh class actually SAVES
-		//     the number of vertices and indices, or
-		//     drawing may have unintended problems.
-		//     - "vertCounter" is the number of vertices
-		//     - "indexCounter" is the number of indices
-		//
-		// - If you dig into the code, you may notice 
-		//     that  "vertCounter" and "indexCounter" 
-		//     end up being the same.  Recall that OBJs 
-		//     do not index entire vertices, making
-		//     it complex to detect duplicate vertices.
-		//     This also means an index buffer isn't
-		//     doing much for us.  We could try to 
-		//     detect duplicate vertices ourselves, 
-		//     but at that point it would be better 
-		//     to use a more sophisticated mesh loading
-		//     library like TinyOBJLoader or 
-		//     The Open Asset Importer Library, both
-		//     of which are unnecessary for now.
-		//
-		// *************************************
-
-		CreateVertexAndIndexBuffers(&verts[0], vertCounter, &indices[0], indexCounter);
+	// Variables used while assembling the mesh
+	std::vector<Vertex> verts;		// Verts we're assembling
+	std::vector<UINT> indices;		// Indices of these verts
+	verts.reserve(obj.Positions.size());
+	indices.reserve(obj.Corners.size());
+
+	// Welding table: OBJ faces index positions, uvs and normals separately,
+	// so each unique triple becomes exactly one vertex in the final mesh
+	std::unordered_map<ObjCorner, UINT, ObjCornerHash> weldTable;
+	weldTable.reserve(obj.Positions.size());
+
+	// Looks up (or creates) the welded vertex for a single face corner
+	auto WeldVertex = [&](const ObjCorner& a_Corner) -> UINT
+	{
+		auto it = weldTable.find(a_Corner);
+		if (it != weldTable.end())
+			return it->second;
+
+		// Author: Chris Cascioli (handedness conversion from the original loader)
+		// The model is most likely in a right-handed space,
+		// especially if it came from Maya.  We want to convert
+		// to a left-handed space for DirectX.  This means we 
+		// need to:
+		//  - Invert the Z position
+		//  - Invert the normal's Z
+		//  - Flip the winding order (done below)
+		// We also need to flip the UV coordinate since DirectX
+		// defines (0,0) as the top left of the texture, and many
+		// 3D modeling packages use the bottom left as (0,0)
+		const ObjFloat3& pos = obj.Positions[a_Corner.Position];
+		const ObjFloat2& uv = obj.UVs[a_Corner.UV];
+		const ObjFloat3& norm = obj.Normals[a_Corner.Normal];
+
+		Vertex v;
+		v.Position = DirectX::XMFLOAT3(pos.x, pos.y, -pos.z);
+		v.UV = DirectX::XMFLOAT2(uv.x, 1.0f - uv.y);
+		v.Normal = DirectX::XMFLOAT3(norm.x, norm.y, -norm.z);
+		v.Tangent = DirectX::XMFLOAT4(0, 0, 0, 0);
+
+		// Add the new vert and remember where it went
+		UINT index = (UINT)verts.size();
+		verts.push_back(v);
+		weldTable.insert({ a_Corner, index });
+		return index;
+	};
+
+	// Weld every triangle, flipping the winding order
+	for (size_t i = 0; i + 2 < obj.Corners.size(); i += 3)
+	{
+		UINT i1 = WeldVertex(obj.Corners[i]);
+		UINT i2 = WeldVertex(obj.Corners[i + 1]);
+		UINT i3 = WeldVertex(obj.Corners[i + 2]);
+
+		indices.push_back(i1);
+		indices.push_back(i3);
+		indices.push_back(i2);
+	}
+
+	if (verts.empty())
+		throw std::invalid_argument("Error reading OBJ: file contains no faces");
+
+	// Every index would have been its own vertex without welding
+	m_uUnweldedVertices = (unsigned int)indices.size();
+
+	if (a_bOptimize)
+	{
+		Optimize(verts, indices);
+		if (indices.empty())
+			throw std::invalid_argument("Error reading OBJ: file contains only degenerate faces");
+	}
+	else
+	{
+		VertexCacheStats stats = AnalyzeVertexCache(indices.data(), indices.size(), verts.size());
+		m_fSourceACMR = m_fACMR = stats.ACMR;
+		m_fSourceATVR = m_fATVR = stats.ATVR;
+		m_vLods.assign(1, { 0, (unsigned int)indices.size(), 0.0f });
+	}
+
+	// the simplified levels only reference verticies of the full mesh
+	CalculateTangents(verts.data(), (int)verts.size(), indices.data(), (int)m_vLods[0].IndexCount);
+	CalculateBounds(verts.data(), (unsigned int)verts.size());
+	BuildClusters(verts.data(), (unsigned int)verts.size(), indices.data());
+
+	std::vector<unsigned char> vertexData;
+	std::vector<unsigned char> indexData;
+	unsigned int uIndexSize = EncodeBuffers(verts.data(), (unsigned int)verts.size(), indices.data(), (unsigned int)indices.size(), vertexData, indexData);
+	if (a_bDeferUpload)
+		StageBuffers(vertexData.data(), (unsigned int)verts.size(), indexData.data(), (unsigned int)indices.size(), uIndexSize);
+	else
+		CreateBuffers(vertexData.data(), (unsigned int)verts.size(), indexData.data(), (unsigned int)indices.size(), uIndexSize);
+
+	// Save the finished mesh for next time (failing to write the cache is not an error)
+	MeshCacheInfo cacheInfo = {};
+	cacheInfo.UnweldedVertexCount = m_uUnweldedVertices;
+	cacheInfo.Flags = uCacheFlags;
+	cacheInfo.SourceACMR = m_fSourceACMR;
+	cacheInfo.SourceATVR = m_fSourceATVR;
+	cacheInfo.ACMR = m_fACMR;
+	cacheInfo.ATVR = m_fATVR;
+	memcpy(cacheInfo.BoundsMin, &m_f3BoundsMin, sizeof(cacheInfo.BoundsMin));
+	memcpy(cacheInfo.BoundsMax, &m_f3BoundsMax, sizeof(cacheInfo.BoundsMax));
+	memcpy(cacheInfo.PackingError, &m_PackingError, sizeof(cacheInfo.PackingError));
+	cacheInfo.LodCount = (uint32_t)m_vLods.size();
+	for (size_t i = 0; i < m_vLods.size(); i++)
+	{
+		cacheInfo.LodIndexStart[i] = m_vLods[i].IndexStart;
+		cacheInfo.LodIndexCount[i] = m_vLods[i].IndexCount;
+		cacheInfo.LodError[i] = m_vLods[i].Error;
+	}
+	WriteMeshCache(sCacheFileName.c_str(), a_sFileName, cacheLayout,
+		vertexData.data(), (uint32_t)verts.size(), indexData.data(), (uint32_t)indices.size(), uIndexSize,
+		m_vMeshlets.data(), (uint32_t)m_vMeshlets.size(), cacheInfo);
 }
 
 // default destructor
 Mesh::~Mesh() {}
 
 /// <summary>
-/// Creates vertes and index buffers using the given verticies, indicies, and vertex and index count
+/// Creates the buffers of a mesh that was loaded with a_bDeferUpload. Must run on the
+/// thread that owns the device context; does nothing if there is no data waiting.
+/// </summary>
+void Mesh::Upload()
+{
+	if (m_vPendingVertexData.empty())
+		return;
+
+	CreateBuffers(m_vPendingVertexData.data(), (unsigned int)(m_vPendingVertexData.size() / sizeof(GpuVertex)),
+		m_vPendingIndexData.data(), (unsigned int)(m_vPendingIndexData.size() / m_uPendingIndexSize), m_uPendingIndexSize);
+
+	// release the CPU copy
+	std::vector<unsigned char>().swap(m_vPendingVertexData);
+	std::vector<unsigned char>().swap(m_vPendingIndexData);
+}
+
+/// <summary>
+/// Takes over the geometry of another mesh, so everything holding on to this one draws
+/// the new geometry from now on (used to swap a placeholder for the loaded mesh)
+/// </summary>
+/// <param name="a_Mesh">Mesh to move from, already uploaded</param>
+void Mesh::Replace(Mesh&& a_Mesh)
+{
+	unsigned int uVersion = m_uVersion + 1;
+	*this = std::move(a_Mesh);
+	m_uVersion = uVersion;
+}
+
+/// <summary>
+/// Reorders a triangle list for the post-transform vertex cache, then for overdraw, appends
+/// the simplified levels of detail, then reorders the verticies for fetch locality.
+/// Degenerate triangles are dropped first. Records the vertex cache statistics from
+/// before and after (of the full-resolution level).
+/// </summary>
+/// <param name="a_vVerticies">Verticies, reordered (and possibly shrunk) in place</param>
+/// <param name="a_vIndicies">Indicies, reordered in place and followed by every coarser level</param>
+void Mesh::Optimize(std::vector<Vertex>& a_vVerticies, std::vector<unsigned int>& a_vIndicies)
+{
+	VertexCacheStats before = AnalyzeVertexCache(a_vIndicies.data(), a_vIndicies.size(), a_vVerticies.size());
+	m_fSourceACMR = before.ACMR;
+	m_fSourceATVR = before.ATVR;
+
+	a_vIndicies.resize(RemoveDegenerateTriangles(a_vIndicies.data(), a_vIndicies.size()));
+	OptimizeVertexCache(a_vIndicies.data(), a_vIndicies.data(), a_vIndicies.size(), a_vVerticies.size());
+	OptimizeOverdraw(a_vIndicies.data(), a_vIndicies.data(), a_vIndicies.size(),
+		&a_vVerticies[0].Position, a_vVerticies.size(), sizeof(Vertex));
+
+	m_vLods.assign(1, { 0, (unsigned int)a_vIndicies.size(), 0.0f });
+	GenerateLods(a_vVerticies, a_vIndicies);
+
+	// every level shares one vertex buffer, which is ordered by first use in the full-resolution level
+	a_vVerticies.resize(OptimizeVertexFetch(a_vVerticies.data(), a_vIndicies.data(), a_vIndicies.size(), a_vVerticies.size(), sizeof(Vertex)));
+
+	VertexCacheStats after = AnalyzeVertexCache(a_vIndicies.data(), m_vLods[0].IndexCount, a_vVerticies.size());
+	m_fACMR = after.ACMR;
+	m_fATVR = after.ATVR;
+}
+
+/// <summary>
+/// Simplifies the full-resolution triangle list into a chain of coarser levels of detail, each
+/// built from the one before with about half its triangles, and appends them to the index list.
+/// The chain stops at MESH_MAX_LODS levels, once the error budget is used up, or once a level
+/// no longer gets meaningfully smaller (seams, borders and non-manifold geometry are kept).
+/// </summary>
+/// <param name="a_vVerticies">Verticies the triangle list indexes</param>
+/// <param name="a_vIndicies">Full-resolution triangle list; receives the coarser levels after it</param>
+void Mesh::GenerateLods(const std::vector<Vertex>& a_vVerticies, std::vector<unsigned int>& a_vIndicies)
+{
+	// the error budget scales with the size of the model
+	DirectX::XMVECTOR boundsMin = DirectX::XMVectorReplicate(FLT_MAX);
+	DirectX::XMVECTOR boundsMax = DirectX::XMVectorReplicate(-FLT_MAX);
+	for (const Vertex& vertex : a_vVerticies)
+	{
+		DirectX::XMVECTOR pos = DirectX::XMLoadFloat3(&vertex.Position);
+		boundsMin = DirectX::XMVectorMin(boundsMin, pos);
+		boundsMax = DirectX::XMVectorMax(boundsMax, pos);
+	}
+	DirectX::XMFLOAT3 f3Extent;
+	DirectX::XMStoreFloat3(&f3Extent, DirectX::XMVectorSubtract(boundsMax, boundsMin));
+	float fMaxError = (std::max)((std::max)(f3Extent.x, f3Extent.y), f3Extent.z) * MESH_LOD_MAX_ERROR;
+
+	std::vector<unsigned int> previous(a_vIndicies);
+	std::vector<unsigned int> next;
+	while (m_vLods.size() < MESH_MAX_LODS)
+	{
+		// each level's error is measured against the level before, so the budget shrinks as they add up
+		float fLevelError = 0.0f;
+		next.resize(previous.size());
+		next.resize(SimplifyMesh(next.data(), previous.data(), previous.size(),
+			&a_vVerticies[0].Position, a_vVerticies.size(), sizeof(Vertex),
+			previous.size() / 6 * 3, fMaxError - m_vLods.back().Error, &fLevelError));
+		if (next.empty() || next.size() > previous.size() * MESH_LOD_MIN_REDUCTION)
+			break;
+
+		OptimizeVertexCache(next.data(), next.data(), next.size(), a_vVerticies.size());
+		m_vLods.push_back({ (unsigned int)a_vIndicies.size(), (unsigned int)next.size(), m_vLods.back().Error + fLevelError });
+		a_vIndicies.insert(a_vIndicies.end(), next.begin(), next.end());
+		previous.swap(next);
+	}
+}
+
+/// <summary>
+/// Calculates the object-space bounding box of a set of verticies
+/// </summary>
+/// <param name="a_pVerticies">List of verticies</param>
+/// <param name="a_uVerticiesLength">Number of verticies</param>
+void Mesh::CalculateBounds(const Vertex* a_pVerticies, unsigned int a_uVerticiesLength)
+{
+	DirectX::XMVECTOR boundsMin = DirectX::XMVectorReplicate(FLT_MAX);
+	DirectX::XMVECTOR boundsMax = DirectX::XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = 0; i < a_uVerticiesLength; i++)
+	{
+		DirectX::XMVECTOR pos = DirectX::XMLoadFloat3(&a_pVerticies[i].Position);
+		boundsMin = DirectX::XMVectorMin(boundsMin, pos);
+		boundsMax = DirectX::XMVectorMax(boundsMax, pos);
+	}
+	DirectX::XMStoreFloat3(&m_f3BoundsMin, boundsMin);
+	DirectX::XMStoreFloat3(&m_f3BoundsMax, boundsMax);
+}
+
+/// <summary>
+/// Creates vertes and index buffers using the given verticies, indicies, and vertex and index count.
+/// Tangents and bounds must already be calculated.
 /// </summary>
 /// <param name="a_pVerticies">List of verticies</param>
 /// <param name="a_uVerticiesLength">Number of verticies</param>
 /// <param name="a_pIndicies">List of Indicies</param>
 /// <param name="a_uIndiciesLength">Number of indicies</param>
-void Mesh::CreateVertexAndIndexBuffers(Vertex* a_pVerticies, unsigned int a_uVerticiesLength, unsigned int* a_pIndicies, unsigned int a_uIndiciesLength)
+void Mesh::CreateVertexAndIndexBuffers(const Vertex* a_pVerticies, unsigned int a_uVerticiesLength, const unsigned int* a_pIndicies, unsigned int a_uIndiciesLength)
+{
+	std::vector<unsigned char> vertexData;
+	std::vector<unsigned char> indexData;
+	unsigned int uIndexSize = EncodeBuffers(a_pVerticies, a_uVerticiesLength, a_pIndicies, a_uIndiciesLength, vertexData, indexData);
+	CreateBuffers(vertexData.data(), a_uVerticiesLength, indexData.data(), a_uIndiciesLength, uIndexSize);
+}
+
+/// <summary>
+/// Converts verticies and indicies to the format the GPU reads: packed verticies (if
+/// PACKED_VERTICES is on) and 16-bit indicies whenever every vertex can be addressed
+/// </summary>
+/// <param name="a_pVerticies">List of verticies</param>
+/// <param name="a_uVerticiesLength">Number of verticies</param>
+/// <param name="a_pIndicies">List of Indicies</param>
+/// <param name="a_uIndiciesLength">Number of indicies</param>
+/// <param name="a_vVertexData">Receives the vertex buffer contents</param>
+/// <param name="a_vIndexData">Receives the index buffer contents</param>
+/// <returns>Size of one index in bytes</returns>
+unsigned int Mesh::EncodeBuffers(const Vertex* a_pVerticies, unsigned int a_uVerticiesLength, const unsigned int* a_pIndicies, unsigned int a_uIndiciesLength,
+	std::vector<unsigned char>& a_vVertexData, std::vector<unsigned char>& a_vIndexData)
+{
+#if PACKED_VERTICES
+	a_vVertexData.resize(sizeof(PackedVertex) * a_uVerticiesLength);
+	m_PackingError = PackVertices(a_pVerticies, a_uVerticiesLength, m_f3BoundsMin, m_f3BoundsMax, (PackedVertex*)a_vVertexData.data());
+#else
+	a_vVertexData.assign((const unsigned char*)a_pVerticies, (const unsigned char*)(a_pVerticies + a_uVerticiesLength));
+	m_PackingError = {};
+#endif
+
+	if (a_uVerticiesLength <= 0xFFFF)
+	{
+		a_vIndexData.resize(sizeof(uint16_t) * a_uIndiciesLength);
+		uint16_t* pShortIndicies = (uint16_t*)a_vIndexData.data();
+		for (unsigned int i = 0; i < a_uIndiciesLength; i++)
+			pShortIndicies[i] = (uint16_t)a_pIndicies[i];
+		return sizeof(uint16_t);
+	}
+
+	a_vIndexData.assign((const unsigned char*)a_pIndicies, (const unsigned char*)(a_pIndicies + a_uIndiciesLength));
+	return sizeof(uint32_t);
+}
+
+/// <summary>
+/// Keeps a copy of data that is already in the GPU format for Upload()
+/// </summary>
+/// <param name="a_pVertexData">Vertex buffer contents</param>
+/// <param name="a_uVerticiesLength">Number of verticies</param>
+/// <param name="a_pIndexData">Index buffer contents</param>
+/// <param name="a_uIndiciesLength">Number of indicies</param>
+/// <param name="a_uIndexSize">Size of one index in bytes (2 or 4)</param>
+void Mesh::StageBuffers(const void* a_pVertexData, unsigned int a_uVerticiesLength, const void* a_pIndexData, unsigned int a_uIndiciesLength, unsigned int a_uIndexSize)
+{
+	m_vPendingVertexData.assign((const unsigned char*)a_pVertexData, (const unsigned char*)a_pVertexData + (size_t)a_uVerticiesLength * sizeof(GpuVertex));
+	m_vPendingIndexData.assign((const unsigned char*)a_pIndexData, (const unsigned char*)a_pIndexData + (size_t)a_uIndiciesLength * a_uIndexSize);
+	m_uPendingIndexSize = a_uIndexSize;
+
+	// the counts are known before the buffers exist
+	m_uVertices = a_uVerticiesLength;
+	m_uIndicies = a_uIndiciesLength;
+}
+
+/// <summary>
+/// Copies data that is already in the GPU format into the geometry pool's shared buffers
+/// </summary>
+/// <param name="a_pVertexData">Vertex buffer contents</param>
+/// <param name="a_uVerticiesLength">Number of verticies</param>
+/// <param name="a_pIndexData">Index buffer contents</param>
+/// <param name="a_uIndiciesLength">Number of indicies</param>
+/// <param name="a_uIndexSize">Size of one index in bytes (2 or 4)</param>
+void Mesh::CreateBuffers(const void* a_pVertexData, unsigned int a_uVerticiesLength, const void* a_pIndexData, unsigned int a_uIndiciesLength, unsigned int a_uIndexSize)
 {
 	// initialize values
 	m_uVertices = a_uVerticiesLength;
 	m_uIndicies = a_uIndiciesLength;
+	m_eIndexFormat = a_uIndexSize == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
-	// calculate the tangents for all vertices
-	CalculateTangents(a_pVerticies, a_uVerticiesLength, a_pIndicies, a_uIndiciesLength);
+	// the indicies stay relative to the mesh's first vertex, DrawIndexed adds its base vertex
+	// (taking the pool's ranges frees the ones this mesh had before)
+	m_Geometry = GeometryPool::Allocate(a_pVertexData, a_uVerticiesLength, sizeof(GpuVertex), a_pIndexData, a_uIndiciesLength, a_uIndexSize);
 
-	// Create a VERTEX BUFFER
-	D3D11_BUFFER_DESC vbd = {};
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change 
-	vbd.ByteWidth = sizeof(Vertex) * a_uVerticiesLength;       // 3 = number of vertices in the buffer
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer 
-	vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good) 
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
-
-	// specify initial vertex data
-	D3D11_SUBRESOURCE_DATA initialVertexData = {};
-	initialVertexData.pSysMem = a_pVerticies; // pSysMem = Pointer to System Memory
-
-	//create the buffer
-	Graphics::Device->CreateBuffer(&vbd, &initialVertexData, m_cpVertexBuffer.GetAddressOf());
-
-	// Create an INDEX BUFFER
-	D3D11_BUFFER_DESC ibd = {};
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-	ibd.ByteWidth = sizeof(unsigned int) * a_uIndiciesLength;	// 3 = number of indices in the buffer
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
-	ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
-
-	//specify initial index data
-	D3D11_SUBRESOURCE_DATA initialIndexData = {};
-	initialIndexData.pSysMem = a_pIndicies; // pSysMem = Pointer to System Memory
-
-	//create the index buffer
-	Graphics::Device->CreateBuffer(&ibd, &initialIndexData, m_cpIndexBuffer.GetAddressOf());
-}
-
-// --------------------------------------------------------
-// Author: Chris Cascioli
-// Purpose: Calculates the tangents of the vertices in a mesh
-// --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* a_pVertices, int a_nVerticiesLength, unsigned int* a_pIndices, int a_nIndiciesLength)
-{
-	// Reset tangents
-	for (int i = 0; i < a_nVerticiesLength; i++)
+	// Clustered meshes keep their full-resolution indicies on the CPU and
+	// upload the ones that survive culling to a dynamic buffer every draw
+	m_vClusterIndexData.clear();
+	m_cpClusterIndexBuffer.Reset();
+	if (!m_vMeshlets.empty())
 	{
-		a_pVertices[i].Tangent = DirectX::XMFLOAT3(0, 0, 0);
+		// the clusters address the index buffer from its start
+		const unsigned char* pIndexData = (const unsigned char*)a_pIndexData;
+		m_vClusterIndexData.assign(pIndexData, pIndexData + ((size_t)m_vLods[0].IndexStart + m_vLods[0].IndexCount) * a_uIndexSize);
+		m_vVisibleMeshlets.resize(m_vMeshlets.size());
+
+		D3D11_BUFFER_DESC cbd = {};
+		cbd.Usage = D3D11_USAGE_DYNAMIC;	// rewritten by the CPU every draw
+		cbd.ByteWidth = (UINT)m_vLods[0].IndexCount * a_uIndexSize;
+		cbd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		cbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		Graphics::Device->CreateBuffer(&cbd, nullptr, m_cpClusterIndexBuffer.GetAddressOf());
 	}
+}
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < a_nIndiciesLength;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = a_pIndices[i++];
-		unsigned int i2 = a_pIndices[i++];
-		unsigned int i3 = a_pIndices[i++];
-		Vertex* v1 = &a_pVertices[i1];
-		Vertex* v2 = &a_pVertices[i2];
-		Vertex* v3 = &a_pVertices[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
+/// <summary>
+/// Splits the full-resolution level into clusters if the mesh is large enough to be worth
+/// culling on the CPU. The triangle order must be final.
+/// </summary>
+/// <param name="a_pVerticies">List of verticies</param>
+/// <param name="a_uVerticiesLength">Number of verticies</param>
+/// <param name="a_pIndicies">Index list starting with the full-resolution level</param>
+void Mesh::BuildClusters(const Vertex* a_pVerticies, unsigned int a_uVerticiesLength, const unsigned int* a_pIndicies)
+{
+	m_vMeshlets.clear();
+	if (m_vLods[0].IndexCount / 3 < MESH_CLUSTER_CULL_MIN_TRIANGLES)
+		return;
+
+	m_vMeshlets = BuildMeshlets(a_pIndicies + m_vLods[0].IndexStart, m_vLods[0].IndexCount,
+		&a_pVerticies[0].Position, a_uVerticiesLength, sizeof(Vertex));
+	for (Meshlet& meshlet : m_vMeshlets)
+		meshlet.IndexStart += m_vLods[0].IndexStart;
+}
+
+/// <summary>
+/// Sends the range the vertex positions were quantized against to a vertex shader
+/// (positionOffset/positionScale; ignored by shaders that don't declare them)
+/// </summary>
+/// <param name="a_spVertexShader">Vertex shader that will draw this mesh</param>
+void Mesh::SetDecodeParameters(std::shared_ptr<SimpleVertexShader> a_spVertexShader)
+{
+	a_spVertexShader->SetFloat3("positionOffset", m_f3BoundsMin);
+	a_spVertexShader->SetFloat3("positionScale", DirectX::XMFLOAT3(
+		m_f3BoundsMax.x - m_f3BoundsMin.x,
+		m_f3BoundsMax.y - m_f3BoundsMin.y,
+		m_f3BoundsMax.z - m_f3BoundsMin.z));
+}
 
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < a_nVerticiesLength; i++)
+/// <summary>
+/// Picks the coarsest level of detail whose simplification error stays within a pixel budget
+/// once the mesh's bounding sphere is projected to the screen
+/// </summary>
+/// <param name="a_m4World">World matrix the mesh is drawn with</param>
+/// <param name="a_m4View">View matrix of the pass</param>
+/// <param name="a_m4Projection">Perspective or orthographic projection matrix of the pass</param>
+/// <param name="a_fViewportHeight">Height of the render target in pixels</param>
+/// <param name="a_fMaxPixelError">How many pixels the simplified surface may be off by</param>
+/// <returns>Level of detail to draw</returns>
+unsigned int Mesh::SelectLod(DirectX::XMFLOAT4X4 a_m4World, DirectX::XMFLOAT4X4 a_m4View, DirectX::XMFLOAT4X4 a_m4Projection, float a_fViewportHeight, float a_fMaxPixelError)
+{
+	if (m_vLods.size() <= 1)
+		return 0;
+
+	// world-space bounding sphere (the largest axis scale keeps it conservative)
+	DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&a_m4World);
+	float fScale = DirectX::XMVectorGetX(DirectX::XMVectorMax(DirectX::XMVectorMax(
+		DirectX::XMVector3Length(world.r[0]),
+		DirectX::XMVector3Length(world.r[1])),
+		DirectX::XMVector3Length(world.r[2])));
+	DirectX::XMVECTOR boundsMin = DirectX::XMLoadFloat3(&m_f3BoundsMin);
+	DirectX::XMVECTOR boundsMax = DirectX::XMLoadFloat3(&m_f3BoundsMax);
+	DirectX::XMVECTOR center = DirectX::XMVector3Transform(DirectX::XMVectorScale(DirectX::XMVectorAdd(boundsMin, boundsMax), 0.5f), world);
+	float fRadius = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(boundsMax, boundsMin))) * 0.5f * fScale;
+
+	// pixels covered by one object-space unit; perspective projections shrink it with the
+	// distance to the nearest point of the sphere, orthographic ones don't (_44 is 1)
+	float fPixelsPerUnit = fScale * a_m4Projection._22 * a_fViewportHeight * 0.5f;
+	if (a_m4Projection._44 == 0.0f)
 	{
-		// Grab the two vectors
-		DirectX::XMVECTOR normal = DirectX::XMLoadFloat3(&a_pVertices[i].Normal);
-		DirectX::XMVECTOR tangent = DirectX::XMLoadFloat3(&a_pVertices[i].Tangent);
+		float fDistance = DirectX::XMVectorGetZ(DirectX::XMVector3Transform(center, DirectX::XMLoadFloat4x4(&a_m4View))) - fRadius;
+		if (fDistance <= 0.0f)
+			return 0; // the camera is inside the sphere
+		fPixelsPerUnit /= fDistance;
+	}
 
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = DirectX::XMVector3Normalize(
-			tangent - normal * DirectX::XMVector3Dot(normal, tangent));
+	unsigned int uLod = 0;
+	while (uLod + 1 < m_vLods.size() && m_vLods[uLod + 1].Error * fPixelsPerUnit <= a_fMaxPixelError)
+		uLod++;
+	return uLod;
+}
 
-		// Store the tangent
-		DirectX::XMStoreFloat3(&a_pVertices[i].Tangent, tangent);
+/// <summary>
+/// Loads a vertex shader with an input layout that matches the verticies meshes upload.
+/// The packed formats can't be derived from shader reflection, so they are described here.
+/// Instanced shaders also read an InstanceData per instance from vertex buffer slot 1.
+/// </summary>
+/// <param name="a_wsFileName">Path to the compiled shader</param>
+/// <param name="a_bInstanced">Whether the shader takes the per-instance inputs (see InstanceInput in ShaderStructs.hlsli)</param>
+/// <returns>The vertex shader</returns>
+std::shared_ptr<SimpleVertexShader> Mesh::LoadVertexShader(const wchar_t* a_wsFileName, bool a_bInstanced)
+{
+#if PACKED_VERTICES
+	Microsoft::WRL::ComPtr<ID3DBlob> cpShaderBlob;
+	if (SUCCEEDED(D3DReadFileToBlob(a_wsFileName, cpShaderBlob.GetAddressOf())))
+	{
+		D3D11_INPUT_ELEMENT_DESC inputElements[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(PackedVertex, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(PackedVertex, UV), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(PackedVertex, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(PackedVertex, Tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "WORLD_PER_INSTANCE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(InstanceData, World._11), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "WORLD_PER_INSTANCE", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(InstanceData, World._21), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "WORLD_PER_INSTANCE", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(InstanceData, World._31), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "WORLD_PER_INSTANCE", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(InstanceData, World._41), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "WORLD_INV_TRANSPOSE_PER_INSTANCE", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, offsetof(InstanceData, WorldInverseTranspose._11), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "WORLD_INV_TRANSPOSE_PER_INSTANCE", 1, DXGI_FORMAT_R32G32B32_FLOAT, 1, offsetof(InstanceData, WorldInverseTranspose._21), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "WORLD_INV_TRANSPOSE_PER_INSTANCE", 2, DXGI_FORMAT_R32G32B32_FLOAT, 1, offsetof(InstanceData, WorldInverseTranspose._31), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+		UINT uElements = a_bInstanced ? ARRAYSIZE(inputElements) : 4;
+
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> cpInputLayout;
+		Graphics::Device->CreateInputLayout(inputElements, uElements,
+			cpShaderBlob->GetBufferPointer(), cpShaderBlob->GetBufferSize(), cpInputLayout.GetAddressOf());
+
+		return std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, a_wsFileName, cpInputLayout, a_bInstanced);
 	}
+#endif
+	// reflection puts the _PER_INSTANCE inputs in slot 1 on its own
+	return std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, a_wsFileName);
 }
 
-#pragma region Getters
 /// <summary>
-/// Returns the vertex buffer ComPtr
+/// Calculates the tangents of the vertices in a mesh, including the handedness of the
+/// bitangent (Tangent.w) so mirrored UVs shade correctly. Records how long it took.
 /// </summary>
-/// <returns>vertex buffer ComPtr</returns>
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
+/// <param name="a_pVertices">Verticies with positions, UVs and normals; receives the tangents</param>
+/// <param name="a_nVerticiesLength">Number of verticies</param>
+/// <param name="a_pIndices">Triangle list</param>
+/// <param name="a_nIndiciesLength">Number of indicies</param>
+void Mesh::CalculateTangents(Vertex* a_pVertices, int a_nVerticiesLength, unsigned int* a_pIndices, int a_nIndiciesLength)
 {
-	return m_cpVertexBuffer;
+	TangentGeneratorStats stats = GenerateTangents(a_pVertices, a_nVerticiesLength, a_pIndices, a_nIndiciesLength);
+	m_dTangentMilliseconds = stats.Milliseconds;
+	m_uTangentThreads = stats.ThreadCount;
+	m_uMirroredVertices = (unsigned int)stats.MirroredVertexCount;
 }
 
+#pragma region Getters
 /// <summary>
-/// Returns the index buffer ComPtr
+/// Returns where the mesh's verticies and indicies are in the geometry pool
 /// </summary>
-/// <returns>index buffer ComPtr</returns>
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
+/// <returns>The mesh's pool allocation</returns>
+const GeometryAllocation& Mesh::GetGeometry()
 {
-	return m_cpIndexBuffer;
+	return m_Geometry;
 }
 
 /// <summary>
@@ -448,22 +724,243 @@ unsigned int Mesh::GetVertexCount()
 {
 	return m_uVertices;
 }
+/// <summary>
+/// Returns the number of verticies this mesh would have had without welding
+/// </summary>
+/// <returns>number of unwelded verticies</returns>
+unsigned int Mesh::GetUnweldedVertexCount()
+{
+	return m_uUnweldedVertices;
+}
+/// <summary>
+/// Returns how long it took to read this mesh's source file
+/// </summary>
+/// <returns>load time in milliseconds (0 for meshes built in code)</returns>
+double Mesh::GetLoadMilliseconds()
+{
+	return m_dLoadMilliseconds;
+}
+/// <summary>
+/// Returns the size of this mesh's source file
+/// </summary>
+/// <returns>file size in bytes (0 for meshes built in code)</returns>
+size_t Mesh::GetFileBytes()
+{
+	return m_uFileBytes;
+}
+/// <summary>
+/// Returns how many threads parsed this mesh's source file
+/// </summary>
+/// <returns>thread count (0 for meshes built in code)</returns>
+unsigned int Mesh::GetLoadThreadCount()
+{
+	return m_uLoadThreads;
+}
+/// <summary>
+/// Returns whether this mesh was loaded from its .meshcache file
+/// </summary>
+/// <returns>true if the source file was not parsed</returns>
+bool Mesh::GetLoadedFromCache()
+{
+	return m_bLoadedFromCache;
+}
+/// <summary>
+/// Returns how long tangent generation took
+/// </summary>
+/// <returns>milliseconds (0 if the tangents came from the mesh cache)</returns>
+double Mesh::GetTangentMilliseconds()
+{
+	return m_dTangentMilliseconds;
+}
+/// <summary>
+/// Returns how many threads generated this mesh's tangents
+/// </summary>
+/// <returns>thread count (0 if the tangents came from the mesh cache)</returns>
+unsigned int Mesh::GetTangentThreadCount()
+{
+	return m_uTangentThreads;
+}
+/// <summary>
+/// Returns how many verticies have mirrored UVs (a bitangent handedness of -1)
+/// </summary>
+/// <returns>mirrored vertex count (0 if the tangents came from the mesh cache)</returns>
+unsigned int Mesh::GetMirroredVertexCount()
+{
+	return m_uMirroredVertices;
+}
+/// <summary>
+/// Returns the minimum corner of the object-space bounding box
+/// </summary>
+/// <returns>bounds minimum</returns>
+DirectX::XMFLOAT3 Mesh::GetBoundsMin()
+{
+	return m_f3BoundsMin;
+}
+/// <summary>
+/// Returns the maximum corner of the object-space bounding box
+/// </summary>
+/// <returns>bounds maximum</returns>
+DirectX::XMFLOAT3 Mesh::GetBoundsMax()
+{
+	return m_f3BoundsMax;
+}
+/// <summary>
+/// Returns the simulated average cache miss ratio of the index order before optimization
+/// </summary>
+/// <returns>transformed verticies per triangle</returns>
+float Mesh::GetSourceACMR()
+{
+	return m_fSourceACMR;
+}
+/// <summary>
+/// Returns the simulated average transform to vertex ratio of the index order before optimization
+/// </summary>
+/// <returns>transformed verticies per unique vertex</returns>
+float Mesh::GetSourceATVR()
+{
+	return m_fSourceATVR;
+}
+/// <summary>
+/// Returns the simulated average cache miss ratio of the index buffer
+/// </summary>
+/// <returns>transformed verticies per triangle</returns>
+float Mesh::GetACMR()
+{
+	return m_fACMR;
+}
+/// <summary>
+/// Returns the simulated average transform to vertex ratio of the index buffer
+/// </summary>
+/// <returns>transformed verticies per unique vertex</returns>
+float Mesh::GetATVR()
+{
+	return m_fATVR;
+}
+/// <summary>
+/// Returns the size of one vertex in the vertex buffer
+/// </summary>
+/// <returns>vertex stride in bytes</returns>
+unsigned int Mesh::GetVertexStride()
+{
+	return sizeof(GpuVertex);
+}
+/// <summary>
+/// Returns the size of one index in the index buffer
+/// </summary>
+/// <returns>2 or 4 bytes</returns>
+unsigned int Mesh::GetIndexStride()
+{
+	return m_eIndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+/// <summary>
+/// Returns the worst-case round-trip error of the packed verticies
+/// </summary>
+/// <returns>packing error (all zero if verticies are not packed)</returns>
+VertexPackingError Mesh::GetPackingError()
+{
+	return m_PackingError;
+}
+/// <summary>
+/// Returns how many levels of detail this mesh has
+/// </summary>
+/// <returns>LOD count (at least 1)</returns>
+unsigned int Mesh::GetLodCount()
+{
+	return (unsigned int)m_vLods.size();
+}
+/// <summary>
+/// Returns how many clusters the full-resolution level is split into
+/// </summary>
+/// <returns>cluster count (0 if the mesh is too small to cull on the CPU)</returns>
+unsigned int Mesh::GetMeshletCount()
+{
+	return (unsigned int)m_vMeshlets.size();
+}
+/// <summary>
+/// Returns what the last DrawClusters call culled
+/// </summary>
+/// <returns>cluster cull statistics</returns>
+ClusterCullStats Mesh::GetClusterCullStats()
+{
+	return m_ClusterCullStats;
+}
+/// <summary>
+/// Gets a counter that changes every time the mesh's geometry is replaced
+/// </summary>
+/// <returns>Version of the mesh</returns>
+unsigned int Mesh::GetVersion()
+{
+	return m_uVersion;
+}
+/// <summary>
+/// Returns the index range and error of one level of detail
+/// </summary>
+/// <param name="a_uLod">Level of detail (0 is full resolution)</param>
+/// <returns>LOD description</returns>
+MeshLod Mesh::GetLod(unsigned int a_uLod)
+{
+	return m_vLods[(std::min)(a_uLod, (unsigned int)m_vLods.size() - 1)];
+}
 #pragma endregion
 
 /// <summary>
-/// Sets the buffers and draws the mesh
+/// Draws one level of detail of the mesh from the geometry pool's buffers, which the
+/// pass has already bound (see GeometryPool::Bind)
 /// </summary>
-void Mesh::Draw()
+/// <param name="a_uLod">Level of detail (0 is full resolution)</param>
+void Mesh::Draw(unsigned int a_uLod)
 {
-	// set buffers in the IA stage
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	Graphics::Context->IASetVertexBuffers(0, 1, m_cpVertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(m_cpIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	const MeshLod& lod = m_vLods[(std::min)(a_uLod, (unsigned int)m_vLods.size() - 1)];
+	GeometryPool::Draw(m_Geometry, lod.IndexStart, lod.IndexCount);
+}
 
-	// Tell Direct 3D to draw
-	Graphics::Context->DrawIndexed(
-		m_uIndicies,     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
-		0);    // Offset to add to each index when looking up vertices
-}
\ No newline at end of file
+/// <summary>
+/// Draws one level of detail of the mesh once for each of a run of instances in the
+/// instance buffer, which the pass has bound along with the geometry pool's buffers
+/// </summary>
+/// <param name="a_uLod">Level of detail (0 is full resolution)</param>
+/// <param name="a_uFirstInstance">First instance in the instance buffer</param>
+/// <param name="a_uInstanceCount">Number of instances to draw</param>
+void Mesh::DrawInstanced(unsigned int a_uLod, unsigned int a_uFirstInstance, unsigned int a_uInstanceCount)
+{
+	const MeshLod& lod = m_vLods[(std::min)(a_uLod, (unsigned int)m_vLods.size() - 1)];
+	GeometryPool::DrawInstanced(m_Geometry, lod.IndexStart, lod.IndexCount, a_uFirstInstance, a_uInstanceCount);
+}
+
+/// <summary>
+/// Draws the full-resolution level, skipping clusters that are outside the camera's frustum
+/// or facing away from it. Meshes without clusters draw normally.
+/// </summary>
+/// <param name="a_m4World">World matrix the mesh is drawn with</param>
+/// <param name="a_m4View">Camera view matrix</param>
+/// <param name="a_m4Projection">Camera projection matrix</param>
+/// <param name="a_f3CameraPosition">World-space camera position</param>
+void Mesh::DrawClusters(DirectX::XMFLOAT4X4 a_m4World, DirectX::XMFLOAT4X4 a_m4View, DirectX::XMFLOAT4X4 a_m4Projection, DirectX::XMFLOAT3 a_f3CameraPosition)
+{
+	if (m_vMeshlets.empty() || !m_cpClusterIndexBuffer)
+	{
+		Draw(0);
+		return;
+	}
+
+	DirectX::XMFLOAT4X4 m4ViewProjection;
+	DirectX::XMStoreFloat4x4(&m4ViewProjection, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&a_m4View), DirectX::XMLoadFloat4x4(&a_m4Projection)));
+	ClusterCullView view = MakeClusterCullView(&a_m4World._11, &m4ViewProjection._11, &a_f3CameraPosition.x);
+	size_t uVisible = CullMeshlets(m_vVisibleMeshlets.data(), m_vMeshlets.data(), m_vMeshlets.size(), view, &m_ClusterCullStats);
+	if (uVisible == 0)
+		return;
+
+	// gather the surviving index ranges into the dynamic buffer
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(Graphics::Context->Map(m_cpClusterIndexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		Draw(0);
+		return;
+	}
+	size_t uIndexCount = CompactMeshletIndices(mapped.pData, m_vClusterIndexData.data(), GetIndexStride(),
+		m_vMeshlets.data(), m_vVisibleMeshlets.data(), uVisible);
+	Graphics::Context->Unmap(m_cpClusterIndexBuffer.Get(), 0);
+
+	// the surviving indicies address the mesh's verticies in the shared vertex buffer
+	GeometryPool::DrawWithIndexBuffer(m_Geometry, m_cpClusterIndexBuffer.Get(), (unsigned int)uIndexCount);
+}
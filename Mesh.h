@@ -5,34 +5,138 @@
 #include "Vertex.h"
 #include "Graphics.h"
 #include <vector>
+#include <memory>
+#include <DirectXMath.h>
+#include "SimpleShader.h"
+#include "VertexPacking.h"
+#include "Meshlets.h"
+#include "GeometryPool.h"
 
+// Most levels of detail a mesh keeps (level 0 is the full-resolution mesh)
+#define MESH_MAX_LODS 5
+// Coarsest simplification allowed, as a fraction of the mesh's largest bounds extent
+#define MESH_LOD_MAX_ERROR 0.1f
+// A level that keeps more than this fraction of the previous level's triangles ends the chain
+#define MESH_LOD_MIN_REDUCTION 0.8f
+// Meshes with at least this many full-resolution triangles are split into clusters and culled on the CPU
+#define MESH_CLUSTER_CULL_MIN_TRIANGLES 4096
+
+// --------------------------------------------------------
+// One level of detail: a range of the shared index buffer
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int IndexStart;
+	unsigned int IndexCount;
+	float Error;	// how far (object space) the simplified surface may be from the full mesh
+};
 
 class Mesh
 {
 public:
 	// OOP stuff
-	Mesh(Vertex* a_pVerticies, unsigned int a_uVerticiesLength, unsigned int* a_pIndicies, unsigned int a_uIndiciesLength);
-	Mesh(const char* a_sFileName);
+	Mesh(Vertex* a_pVerticies, unsigned int a_uVerticiesLength, unsigned int* a_pIndicies, unsigned int a_uIndiciesLength, bool a_bOptimize = true);
+	Mesh(const char* a_sFileName, bool a_bOptimize = true, bool a_bDeferUpload = false);
 	~Mesh();
+	Mesh& operator=(Mesh&&) = default;
 
 	// primary functions
-	void CreateVertexAndIndexBuffers(Vertex* a_pVerticies, unsigned int a_uVerticiesLength, unsigned int* a_pIndicies, unsigned int a_uIndiciesLength);
+	void CreateVertexAndIndexBuffers(const Vertex* a_pVerticies, unsigned int a_uVerticiesLength, const unsigned int* a_pIndicies, unsigned int a_uIndiciesLength);
 	void CalculateTangents(Vertex* a_pVertices, int a_nVerticiesLength, unsigned int* a_pIndices, int a_nIndiciesLength);
+	void SetDecodeParameters(std::shared_ptr<SimpleVertexShader> a_spVertexShader);
+	void Upload();
+	void Replace(Mesh&& a_Mesh);
+	unsigned int SelectLod(DirectX::XMFLOAT4X4 a_m4World, DirectX::XMFLOAT4X4 a_m4View, DirectX::XMFLOAT4X4 a_m4Projection, float a_fViewportHeight, float a_fMaxPixelError);
+
+	// vertex shaders that draw meshes must be loaded through this so the input layout matches the vertex format
+	static std::shared_ptr<SimpleVertexShader> LoadVertexShader(const wchar_t* a_wsFileName, bool a_bInstanced = false);
 
 	// getters
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+	const GeometryAllocation& GetGeometry();
 
 	unsigned int GetIndexCount();
 	unsigned int GetVertexCount();
-	void Draw();
+	unsigned int GetUnweldedVertexCount();
+	double GetLoadMilliseconds();
+	size_t GetFileBytes();
+	unsigned int GetLoadThreadCount();
+	double GetTangentMilliseconds();
+	unsigned int GetTangentThreadCount();
+	unsigned int GetMirroredVertexCount();
+	bool GetLoadedFromCache();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+	float GetSourceACMR();
+	float GetSourceATVR();
+	float GetACMR();
+	float GetATVR();
+	unsigned int GetVertexStride();
+	unsigned int GetIndexStride();
+	VertexPackingError GetPackingError();
+	unsigned int GetLodCount();
+	MeshLod GetLod(unsigned int a_uLod);
+	unsigned int GetMeshletCount();
+	ClusterCullStats GetClusterCullStats();
+	unsigned int GetVersion();
+	void Draw(unsigned int a_uLod = 0);
+	void DrawInstanced(unsigned int a_uLod, unsigned int a_uFirstInstance, unsigned int a_uInstanceCount);
+	void DrawClusters(DirectX::XMFLOAT4X4 a_m4World, DirectX::XMFLOAT4X4 a_m4View, DirectX::XMFLOAT4X4 a_m4Projection, DirectX::XMFLOAT3 a_f3CameraPosition);
 
 private:
-	// geometry data buffers
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_cpVertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_cpIndexBuffer;
+	// geometry data, in the shared buffers of the geometry pool
+	GeometryAllocation m_Geometry;
 
 	unsigned int m_uIndicies; //number of indices in index buffer
 	unsigned int m_uVertices; //number of vertices in vertex buffer
+	DXGI_FORMAT m_eIndexFormat; //16- or 32-bit indices
+	unsigned int m_uUnweldedVertices; //number of vertices before duplicate face corners were welded
 	//unsigned int m_nFaces;
+
+	// load statistics
+	double m_dLoadMilliseconds; //time spent reading the source file
+	size_t m_uFileBytes; //size of the source file
+	unsigned int m_uLoadThreads; //number of threads that parsed the source file
+	bool m_bLoadedFromCache; //whether the geometry came from a .meshcache file instead of the source
+	double m_dTangentMilliseconds; //time spent generating tangents
+	unsigned int m_uTangentThreads; //number of threads that generated tangents
+	unsigned int m_uMirroredVertices; //number of vertices with mirrored UVs
+
+	// object-space bounding box
+	DirectX::XMFLOAT3 m_f3BoundsMin;
+	DirectX::XMFLOAT3 m_f3BoundsMax;
+
+	// vertex cache statistics of the index order before and after optimization
+	float m_fSourceACMR;
+	float m_fSourceATVR;
+	float m_fACMR;
+	float m_fATVR;
+
+	// worst-case error introduced by packing the verticies
+	VertexPackingError m_PackingError;
+
+	// index ranges of the levels of detail, finest first
+	std::vector<MeshLod> m_vLods;
+
+	// clusters of the full-resolution level (only for meshes large enough to cull)
+	std::vector<Meshlet> m_vMeshlets;
+	std::vector<unsigned char> m_vClusterIndexData; //CPU copy of the full-resolution indicies in the GPU format
+	std::vector<uint32_t> m_vVisibleMeshlets; //clusters that survived the last cull
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_cpClusterIndexBuffer; //dynamic, refilled with the surviving clusters every draw
+	ClusterCullStats m_ClusterCullStats;
+
+	// GPU-ready data of a mesh loaded with a_bDeferUpload, waiting for Upload() on the main thread
+	std::vector<unsigned char> m_vPendingVertexData;
+	std::vector<unsigned char> m_vPendingIndexData;
+	unsigned int m_uPendingIndexSize;
+
+	unsigned int m_uVersion; //incremented every time the geometry is replaced
+
+	void CalculateBounds(const Vertex* a_pVerticies, unsigned int a_uVerticiesLength);
+	void Optimize(std::vector<Vertex>& a_vVerticies, std::vector<unsigned int>& a_vIndicies);
+	void GenerateLods(const std::vector<Vertex>& a_vVerticies, std::vector<unsigned int>& a_vIndicies);
+	void BuildClusters(const Vertex* a_pVerticies, unsigned int a_uVerticiesLength, const unsigned int* a_pIndicies);
+	unsigned int EncodeBuffers(const Vertex* a_pVerticies, unsigned int a_uVerticiesLength, const unsigned int* a_pIndicies, unsigned int a_uIndiciesLength,
+		std::vector<unsigned char>& a_vVertexData, std::vector<unsigned char>& a_vIndexData);
+	void StageBuffers(const void* a_pVertexData, unsigned int a_uVerticiesLength, const void* a_pIndexData, unsigned int a_uIndiciesLength, unsigned int a_uIndexSize);
+	void CreateBuffers(const void* a_pVertexData, unsigned int a_uVerticiesLength, const void* a_pIndexData, unsigned int a_uIndiciesLength, unsigned int a_uIndexSize);
 };
\ No newline at end of file
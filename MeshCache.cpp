@@ -0,0 +1,278 @@
+#include "MeshCache.h"
+#include "Hash.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+namespace
+{
+	const uint32_t MESH_CACHE_MAGIC = 0x4348534D; // 'MSHC' in little-endian
+
+	// Alignment of the vertex blob inside the file (keeps SIMD loads happy)
+	const uint64_t MESH_CACHE_BLOB_ALIGNMENT = 16;
+
+	inline uint64_t AlignUp(uint64_t a_uValue, uint64_t a_uAlignment)
+	{
+		return (a_uValue + a_uAlignment - 1) & ~(a_uAlignment - 1);
+	}
+
+	/// <summary>
+	/// Reads the last write time and size of a file without opening it
+	/// </summary>
+	bool GetSourceStamp(const char* a_sFileName, int64_t& a_nTimestamp, uint64_t& a_uSize)
+	{
+		std::error_code error;
+		std::filesystem::path path(a_sFileName);
+		auto time = std::filesystem::last_write_time(path, error);
+		if (error) return false;
+		uintmax_t size = std::filesystem::file_size(path, error);
+		if (error) return false;
+
+		a_nTimestamp = (int64_t)time.time_since_epoch().count();
+		a_uSize = (uint64_t)size;
+		return true;
+	}
+
+	/// <summary>
+	/// Hashes the full contents of a file
+	/// </summary>
+	bool HashSourceFile(const char* a_sFileName, uint64_t& a_uHash)
+	{
+		MappedFile source(a_sFileName);
+		if (!source.IsOpen())
+			return false;
+		a_uHash = HashBytes(source.GetData(), source.GetSize());
+		return true;
+	}
+
+	/// <summary>
+	/// Checksum of the payload: the vertex blob followed by the index and meshlet blobs
+	/// </summary>
+	uint64_t PayloadChecksum(const void* a_pVertices, size_t a_uVertexBytes, const void* a_pIndices, size_t a_uIndexBytes,
+		const void* a_pMeshlets, size_t a_uMeshletBytes)
+	{
+		uint64_t hash = HashBytes(a_pVertices, a_uVertexBytes);
+		hash = HashBytes(a_pIndices, a_uIndexBytes, hash);
+		return HashBytes(a_pMeshlets, a_uMeshletBytes, hash);
+	}
+
+	/// <summary>
+	/// Compares two layouts element by element
+	/// </summary>
+	bool LayoutsMatch(const MeshCacheLayout& a_A, const MeshCacheLayout& a_B)
+	{
+		if (a_A.Stride != a_B.Stride || a_A.ElementCount != a_B.ElementCount || a_A.ElementCount > MESH_CACHE_MAX_ELEMENTS)
+			return false;
+		for (uint32_t i = 0; i < a_A.ElementCount; i++)
+		{
+			if (a_A.Elements[i].Semantic != a_B.Elements[i].Semantic ||
+				a_A.Elements[i].Format != a_B.Elements[i].Format ||
+				a_A.Elements[i].Offset != a_B.Elements[i].Offset)
+				return false;
+		}
+		return true;
+	}
+}
+
+/// <summary>
+/// Maps a cache file and validates it against the current layout and the source file
+/// </summary>
+/// <param name="a_sCacheFileName">Path to the cache file</param>
+/// <param name="a_sSourceFileName">Path to the file the cache was built from</param>
+/// <param name="a_Layout">The vertex layout the caller expects</param>
+MeshCacheFile::MeshCacheFile(const char* a_sCacheFileName, const char* a_sSourceFileName, const MeshCacheLayout& a_Layout)
+{
+	m_pHeader = nullptr;
+	m_bValid = false;
+	m_bStaleStamp = false;
+
+	m_upFile = std::make_unique<MappedFile>(a_sCacheFileName);
+	if (!m_upFile->IsOpen() || m_upFile->GetSize() < sizeof(MeshCacheHeader))
+		return;
+
+	const MeshCacheHeader* pHeader = (const MeshCacheHeader*)m_upFile->GetData();
+	if (pHeader->Magic != MESH_CACHE_MAGIC || pHeader->Version != MESH_CACHE_VERSION)
+		return;
+	if (!LayoutsMatch(pHeader->Layout, a_Layout))
+		return;
+
+	// make sure every blob is inside the file
+	uint64_t uVertexBytes = (uint64_t)pHeader->VertexCount * pHeader->Layout.Stride;
+	uint64_t uIndexBytes = (uint64_t)pHeader->IndexCount * pHeader->IndexSize;
+	uint64_t uMeshletBytes = (uint64_t)pHeader->MeshletCount * sizeof(Meshlet);
+	if (pHeader->VertexCount == 0 || pHeader->IndexCount == 0 ||
+		(pHeader->IndexSize != sizeof(uint16_t) && pHeader->IndexSize != sizeof(uint32_t)) ||
+		pHeader->VertexOffset % MESH_CACHE_BLOB_ALIGNMENT != 0 || pHeader->IndexOffset % pHeader->IndexSize != 0 ||
+		pHeader->VertexOffset + uVertexBytes > m_upFile->GetSize() ||
+		pHeader->IndexOffset + uIndexBytes > m_upFile->GetSize() ||
+		pHeader->MeshletOffset % MESH_CACHE_BLOB_ALIGNMENT != 0 ||
+		pHeader->MeshletOffset + uMeshletBytes > m_upFile->GetSize())
+		return;
+
+	// the source must be the one we were built from: a matching timestamp and size
+	// is enough, otherwise fall back to comparing content hashes
+	int64_t nTimestamp = 0;
+	uint64_t uSize = 0;
+	if (!GetSourceStamp(a_sSourceFileName, nTimestamp, uSize))
+		return;
+	if (nTimestamp != pHeader->SourceTimestamp || uSize != pHeader->SourceSize)
+	{
+		uint64_t uHash = 0;
+		if (uSize != pHeader->SourceSize || !HashSourceFile(a_sSourceFileName, uHash) || uHash != pHeader->SourceHash)
+			return;
+		m_bStaleStamp = true;
+	}
+
+	// reject torn or corrupted payloads
+	const char* pBase = m_upFile->GetData();
+	if (PayloadChecksum(pBase + pHeader->VertexOffset, (size_t)uVertexBytes, pBase + pHeader->IndexOffset, (size_t)uIndexBytes,
+		pBase + pHeader->MeshletOffset, (size_t)uMeshletBytes) != pHeader->PayloadChecksum)
+		return;
+
+	m_pHeader = pHeader;
+	m_bValid = true;
+}
+
+#pragma region Getters
+/// <summary>
+/// Returns whether the cache entry is usable
+/// </summary>
+/// <returns>true if the vertex and index pointers are valid</returns>
+bool MeshCacheFile::IsValid()
+{
+	return m_bValid;
+}
+/// <summary>
+/// Returns whether the source was touched (same content, new timestamp)
+/// </summary>
+/// <returns>true if the cache should be re-stamped</returns>
+bool MeshCacheFile::IsSourceStampStale()
+{
+	return m_bStaleStamp;
+}
+/// <summary>
+/// Returns the cache file's header
+/// </summary>
+/// <returns>header, or nullptr if the cache is not valid</returns>
+const MeshCacheHeader* MeshCacheFile::GetHeader()
+{
+	return m_pHeader;
+}
+/// <summary>
+/// Returns a pointer to the first vertex inside the mapping
+/// </summary>
+/// <returns>mapped vertex data, or nullptr if the cache is not valid</returns>
+const void* MeshCacheFile::GetVertices()
+{
+	return m_bValid ? m_upFile->GetData() + m_pHeader->VertexOffset : nullptr;
+}
+/// <summary>
+/// Returns a pointer to the first index inside the mapping
+/// </summary>
+/// <returns>mapped index data, or nullptr if the cache is not valid</returns>
+const void* MeshCacheFile::GetIndices()
+{
+	return m_bValid ? m_upFile->GetData() + m_pHeader->IndexOffset : nullptr;
+}
+/// <summary>
+/// Returns a pointer to the first meshlet inside the mapping
+/// </summary>
+/// <returns>mapped meshlets, or nullptr if the cache is not valid</returns>
+const Meshlet* MeshCacheFile::GetMeshlets()
+{
+	return m_bValid ? (const Meshlet*)(m_upFile->GetData() + m_pHeader->MeshletOffset) : nullptr;
+}
+#pragma endregion
+
+/// <summary>
+/// Writes a cache entry (to a temporary file that is then renamed over the old entry)
+/// </summary>
+/// <param name="a_sCacheFileName">Path to the cache file</param>
+/// <param name="a_sSourceFileName">Path to the file the data was built from</param>
+/// <param name="a_Layout">Layout of the vertex data</param>
+/// <param name="a_pVertices">Vertex data</param>
+/// <param name="a_uVertexCount">Number of vertices</param>
+/// <param name="a_pIndices">Index data</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_uIndexSize">Size of one index in bytes (2 or 4)</param>
+/// <param name="a_pMeshlets">Clusters of the index data (may be null if there are none)</param>
+/// <param name="a_uMeshletCount">Number of clusters</param>
+/// <param name="a_Info">How the data was produced (stored for statistics)</param>
+/// <returns>true if the entry was written</returns>
+bool WriteMeshCache(
+	const char* a_sCacheFileName,
+	const char* a_sSourceFileName,
+	const MeshCacheLayout& a_Layout,
+	const void* a_pVertices, uint32_t a_uVertexCount,
+	const void* a_pIndices, uint32_t a_uIndexCount, uint32_t a_uIndexSize,
+	const Meshlet* a_pMeshlets, uint32_t a_uMeshletCount,
+	const MeshCacheInfo& a_Info)
+{
+	MeshCacheHeader header = {};
+	header.Magic = MESH_CACHE_MAGIC;
+	header.Version = MESH_CACHE_VERSION;
+	header.Layout = a_Layout;
+	header.VertexCount = a_uVertexCount;
+	header.IndexCount = a_uIndexCount;
+	header.IndexSize = a_uIndexSize;
+	header.MeshletCount = a_uMeshletCount;
+	header.Info = a_Info;
+
+	if (!GetSourceStamp(a_sSourceFileName, header.SourceTimestamp, header.SourceSize) ||
+		!HashSourceFile(a_sSourceFileName, header.SourceHash))
+		return false;
+
+	size_t uVertexBytes = (size_t)a_uVertexCount * a_Layout.Stride;
+	size_t uIndexBytes = (size_t)a_uIndexCount * a_uIndexSize;
+	size_t uMeshletBytes = (size_t)a_uMeshletCount * sizeof(Meshlet);
+	header.VertexOffset = AlignUp(sizeof(MeshCacheHeader), MESH_CACHE_BLOB_ALIGNMENT);
+	header.IndexOffset = AlignUp(header.VertexOffset + uVertexBytes, MESH_CACHE_BLOB_ALIGNMENT);
+	header.MeshletOffset = AlignUp(header.IndexOffset + uIndexBytes, MESH_CACHE_BLOB_ALIGNMENT);
+	header.PayloadChecksum = PayloadChecksum(a_pVertices, uVertexBytes, a_pIndices, uIndexBytes, a_pMeshlets, uMeshletBytes);
+
+	// write everything to a temporary file first so a crash never leaves a torn entry behind
+	std::string sTempName = std::string(a_sCacheFileName) + ".tmp";
+	{
+		std::ofstream out(sTempName, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		const char zeros[MESH_CACHE_BLOB_ALIGNMENT] = {};
+		out.write((const char*)&header, sizeof(header));
+		out.write(zeros, header.VertexOffset - sizeof(header));
+		out.write((const char*)a_pVertices, uVertexBytes);
+		out.write(zeros, header.IndexOffset - (header.VertexOffset + uVertexBytes));
+		out.write((const char*)a_pIndices, uIndexBytes);
+		out.write(zeros, header.MeshletOffset - (header.IndexOffset + uIndexBytes));
+		out.write((const char*)a_pMeshlets, uMeshletBytes);
+		if (!out.good())
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(sTempName, a_sCacheFileName, error);
+	return !error;
+}
+
+/// <summary>
+/// Updates the stored source timestamp of a cache entry whose source content did not change
+/// </summary>
+/// <param name="a_sCacheFileName">Path to the cache file</param>
+/// <param name="a_sSourceFileName">Path to the source file</param>
+/// <returns>true if the header was updated</returns>
+bool RefreshMeshCacheStamp(const char* a_sCacheFileName, const char* a_sSourceFileName)
+{
+	int64_t nTimestamp = 0;
+	uint64_t uSize = 0;
+	if (!GetSourceStamp(a_sSourceFileName, nTimestamp, uSize))
+		return false;
+
+	std::fstream file(a_sCacheFileName, std::ios::binary | std::ios::in | std::ios::out);
+	if (!file.is_open())
+		return false;
+
+	file.seekp(offsetof(MeshCacheHeader, SourceTimestamp));
+	file.write((const char*)&nTimestamp, sizeof(nTimestamp));
+	return file.good();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "MappedFile.h"
+#include "Meshlets.h"
+
+// Bump whenever the file layout or the import pipeline output changes
+#define MESH_CACHE_VERSION 6
+#define MESH_CACHE_MAX_ELEMENTS 8
+#define MESH_CACHE_MAX_LODS 5
+
+// --------------------------------------------------------
+// Describes one attribute of the cached vertex layout
+// --------------------------------------------------------
+enum MeshCacheSemantic : uint32_t
+{
+	MESH_CACHE_POSITION = 0,
+	MESH_CACHE_TEXCOORD = 1,
+	MESH_CACHE_NORMAL = 2,
+	MESH_CACHE_TANGENT = 3
+};
+
+enum MeshCacheFormat : uint32_t
+{
+	MESH_CACHE_FLOAT2 = 0,
+	MESH_CACHE_FLOAT3 = 1,
+	MESH_CACHE_FLOAT4 = 2,
+	MESH_CACHE_UNORM16X4 = 3,
+	MESH_CACHE_SNORM16X2 = 4,
+	MESH_CACHE_HALF2 = 5
+};
+
+struct MeshCacheElement
+{
+	uint32_t Semantic;	// MeshCacheSemantic
+	uint32_t Format;	// MeshCacheFormat
+	uint32_t Offset;	// byte offset inside one vertex
+};
+
+// --------------------------------------------------------
+// A vertex layout: stride plus an ordered list of elements
+// --------------------------------------------------------
+struct MeshCacheLayout
+{
+	uint32_t Stride;
+	uint32_t ElementCount;
+	MeshCacheElement Elements[MESH_CACHE_MAX_ELEMENTS];
+};
+
+// Info flags
+#define MESH_CACHE_FLAG_OPTIMIZED 0x1	// index and vertex order went through the mesh optimizer
+
+// --------------------------------------------------------
+// How the cached data was produced (not checked by MeshCacheFile)
+// --------------------------------------------------------
+struct MeshCacheInfo
+{
+	uint32_t UnweldedVertexCount;	// vertex count before duplicate face corners were welded
+	uint32_t Flags;					// MESH_CACHE_FLAG_*
+	float SourceACMR;				// vertex cache statistics of the unoptimized index order
+	float SourceATVR;
+	float ACMR;						// vertex cache statistics of the cached index order
+	float ATVR;
+	float BoundsMin[3];				// object-space bounding box (also the position quantization range)
+	float BoundsMax[3];
+	float PackingError[4];			// VertexPackingError of the cached verticies (zero if unpacked)
+	uint32_t LodCount;				// levels of detail in the index blob (at least 1)
+	uint32_t LodIndexStart[MESH_CACHE_MAX_LODS];	// first index of each level
+	uint32_t LodIndexCount[MESH_CACHE_MAX_LODS];	// index count of each level
+	float LodError[MESH_CACHE_MAX_LODS];			// object-space simplification error of each level
+};
+
+// --------------------------------------------------------
+// On-disk header at the start of every cache file. The
+// vertex, index and meshlet blobs follow at the given offsets.
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	uint32_t Magic;				// 'MSHC'
+	uint32_t Version;			// MESH_CACHE_VERSION
+	MeshCacheLayout Layout;		// layout of every vertex in the vertex blob
+
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t IndexSize;			// 2 or 4 bytes per index
+	uint32_t MeshletCount;		// Meshlet records in the meshlet blob (may be 0)
+	MeshCacheInfo Info;
+
+	int64_t SourceTimestamp;	// last write time of the source file
+	uint64_t SourceSize;		// size of the source file in bytes
+	uint64_t SourceHash;		// HashBytes() of the source file
+
+	uint64_t VertexOffset;		// byte offset of the vertex blob from the start of the file
+	uint64_t IndexOffset;		// byte offset of the index blob from the start of the file
+	uint64_t MeshletOffset;		// byte offset of the meshlet blob from the start of the file
+	uint64_t PayloadChecksum;	// HashBytes() over the vertex, index and meshlet blobs in that order
+};
+
+// --------------------------------------------------------
+// A memory-mapped cache entry. If IsValid() is true the
+// vertex, index and meshlet pointers point straight into the mapping
+// and stay valid for as long as this object lives.
+// --------------------------------------------------------
+class MeshCacheFile
+{
+public:
+	MeshCacheFile(const char* a_sCacheFileName, const char* a_sSourceFileName, const MeshCacheLayout& a_Layout);
+
+	bool IsValid();
+	bool IsSourceStampStale();
+	const MeshCacheHeader* GetHeader();
+	const void* GetVertices();
+	const void* GetIndices();
+	const Meshlet* GetMeshlets();
+
+private:
+	std::unique_ptr<MappedFile> m_upFile;
+	const MeshCacheHeader* m_pHeader;
+	bool m_bValid;
+	bool m_bStaleStamp;
+};
+
+// Writes a new cache entry for the given source file
+bool WriteMeshCache(
+	const char* a_sCacheFileName,
+	const char* a_sSourceFileName,
+	const MeshCacheLayout& a_Layout,
+	const void* a_pVertices, uint32_t a_uVertexCount,
+	const void* a_pIndices, uint32_t a_uIndexCount, uint32_t a_uIndexSize,
+	const Meshlet* a_pMeshlets, uint32_t a_uMeshletCount,
+	const MeshCacheInfo& a_Info);
+
+// Re-stamps a cache entry whose source was touched but not changed
+bool RefreshMeshCacheStamp(const char* a_sCacheFileName, const char* a_sSourceFileName);
@@ -0,0 +1,381 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// --------------------------------------------------------
+	// Tuning values from Tom Forsyth's "Linear-Speed Vertex
+	// Cache Optimisation" (2006)
+	// --------------------------------------------------------
+	const int FORSYTH_CACHE_SIZE = 32;
+	const int FORSYTH_MAX_VALENCE_SCORE = 32;
+	const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+	const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+	const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+	const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+	const uint32_t NO_TRIANGLE = UINT32_MAX;
+
+	// Precomputed score tables so the main loop never calls pow()
+	struct ForsythScoreTables
+	{
+		float Cache[FORSYTH_CACHE_SIZE];
+		float Valence[FORSYTH_MAX_VALENCE_SCORE];
+
+		ForsythScoreTables()
+		{
+			for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+			{
+				// the three verticies of the last triangle get a fixed score so the
+				// next triangle doesn't just reuse the same edge every time
+				if (i < 3)
+					Cache[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+				else
+					Cache[i] = powf(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+			}
+			Valence[0] = 0.0f;
+			for (int i = 1; i < FORSYTH_MAX_VALENCE_SCORE; i++)
+				Valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+		}
+	};
+
+	/// <summary>
+	/// Scores a vertex by its cache position and how many triangles still use it
+	/// </summary>
+	float ForsythVertexScore(const ForsythScoreTables& a_Tables, int a_nCachePosition, uint32_t a_uRemainingValence)
+	{
+		// no triangles left to draw, so the vertex is worthless
+		if (a_uRemainingValence == 0)
+			return -1.0f;
+
+		float score = a_nCachePosition >= 0 ? a_Tables.Cache[a_nCachePosition] : 0.0f;
+		score += a_Tables.Valence[std::min<uint32_t>(a_uRemainingValence, FORSYTH_MAX_VALENCE_SCORE - 1)];
+		return score;
+	}
+
+	/// <summary>
+	/// Area-weighted centroid and normal of a range of triangles
+	/// </summary>
+	void AccumulateTriangle(const uint32_t* a_pTriangle, const char* a_pPositions, size_t a_uStride, float* a_pCentroid, float* a_pNormal)
+	{
+		float p[3][3];
+		for (int k = 0; k < 3; k++)
+			memcpy(p[k], a_pPositions + a_pTriangle[k] * a_uStride, sizeof(p[k]));
+
+		float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+		float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+		for (int c = 0; c < 3; c++)
+		{
+			a_pCentroid[c] += (p[0][c] + p[1][c] + p[2][c]) / 3.0f * area;
+			a_pNormal[c] += n[c];
+		}
+		a_pCentroid[3] += area;
+	}
+}
+
+/// <summary>
+/// Simulates a FIFO post-transform cache (the model most GPUs are closest to) over a triangle list
+/// </summary>
+/// <param name="a_pIndices">Triangle list</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_uVertexCount">Number of verticies the indices refer to</param>
+/// <param name="a_uCacheSize">Number of entries in the simulated cache</param>
+/// <returns>ACMR and ATVR of the triangle list</returns>
+VertexCacheStats AnalyzeVertexCache(const uint32_t* a_pIndices, size_t a_uIndexCount, size_t a_uVertexCount, unsigned int a_uCacheSize)
+{
+	VertexCacheStats stats = {};
+	if (a_uIndexCount < 3)
+		return stats;
+
+	// a vertex is cached while fewer than a_uCacheSize misses happened since it was inserted
+	std::vector<uint64_t> insertedAt(a_uVertexCount, 0);
+	uint64_t uMisses = 0;
+	size_t uUnique = 0;
+
+	for (size_t i = 0; i < a_uIndexCount; i++)
+	{
+		uint32_t v = a_pIndices[i];
+		if (insertedAt[v] == 0)
+			uUnique++;
+		if (insertedAt[v] == 0 || uMisses - insertedAt[v] >= a_uCacheSize)
+			insertedAt[v] = ++uMisses;
+	}
+
+	stats.ACMR = (float)uMisses / (float)(a_uIndexCount / 3);
+	stats.ATVR = (float)uMisses / (float)uUnique;
+	return stats;
+}
+
+/// <summary>
+/// Removes triangles that reference the same vertex more than once
+/// </summary>
+/// <param name="a_pIndices">Triangle list, compacted in place</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <returns>Number of indices left</returns>
+size_t RemoveDegenerateTriangles(uint32_t* a_pIndices, size_t a_uIndexCount)
+{
+	size_t uWrite = 0;
+	for (size_t i = 0; i + 2 < a_uIndexCount; i += 3)
+	{
+		uint32_t a = a_pIndices[i], b = a_pIndices[i + 1], c = a_pIndices[i + 2];
+		if (a == b || b == c || a == c)
+			continue;
+
+		a_pIndices[uWrite++] = a;
+		a_pIndices[uWrite++] = b;
+		a_pIndices[uWrite++] = c;
+	}
+	return uWrite;
+}
+
+/// <summary>
+/// Reorders triangles so verticies are reused while still in the post-transform cache.
+/// Each step emits the best scoring triangle touching the cache, then rescores only the
+/// verticies whose cache position changed, which keeps the whole pass linear.
+/// </summary>
+/// <param name="a_pDestination">Output triangle list (may be the same as a_pIndices)</param>
+/// <param name="a_pIndices">Input triangle list</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_uVertexCount">Number of verticies the indices refer to</param>
+void OptimizeVertexCache(uint32_t* a_pDestination, const uint32_t* a_pIndices, size_t a_uIndexCount, size_t a_uVertexCount)
+{
+	static const ForsythScoreTables tables;
+
+	std::vector<uint32_t> indices(a_pIndices, a_pIndices + a_uIndexCount);
+	size_t uTriangleCount = a_uIndexCount / 3;
+
+	// build vertex -> triangle adjacency (each vertex keeps its live triangles at the front of its range)
+	std::vector<uint32_t> valence(a_uVertexCount, 0);
+	for (size_t i = 0; i < uTriangleCount * 3; i++)
+		valence[indices[i]]++;
+
+	std::vector<uint32_t> adjacencyOffset(a_uVertexCount + 1, 0);
+	for (size_t v = 0; v < a_uVertexCount; v++)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+
+	std::vector<uint32_t> adjacency(uTriangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t t = 0; t < uTriangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+			adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+	}
+
+	// initial scores
+	std::vector<int> cachePosition(a_uVertexCount, -1);
+	std::vector<float> vertexScore(a_uVertexCount);
+	for (size_t v = 0; v < a_uVertexCount; v++)
+		vertexScore[v] = ForsythVertexScore(tables, -1, valence[v]);
+
+	std::vector<float> triangleScore(uTriangleCount);
+	std::vector<bool> emitted(uTriangleCount, false);
+	uint32_t uBest = NO_TRIANGLE;
+	for (size_t t = 0; t < uTriangleCount; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (uBest == NO_TRIANGLE || triangleScore[t] > triangleScore[uBest])
+			uBest = (uint32_t)t;
+	}
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	size_t uCursor = 0;
+
+	for (size_t uOut = 0; uOut < uTriangleCount; uOut++)
+	{
+		// nothing in the cache is connected to anything left, restart at the next unused triangle
+		if (uBest == NO_TRIANGLE)
+		{
+			while (emitted[uCursor])
+				uCursor++;
+			uBest = (uint32_t)uCursor;
+		}
+
+		const uint32_t* tri = &indices[uBest * 3];
+		a_pDestination[uOut * 3] = tri[0];
+		a_pDestination[uOut * 3 + 1] = tri[1];
+		a_pDestination[uOut * 3 + 2] = tri[2];
+		emitted[uBest] = true;
+
+		// unlink the triangle from its verticies
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = tri[k];
+			uint32_t* begin = &adjacency[adjacencyOffset[v]];
+			uint32_t* end = begin + valence[v];
+			std::iter_swap(std::find(begin, end, uBest), end - 1);
+			valence[v]--;
+		}
+
+		// LRU update: the triangle's verticies move to the front
+		newCache.assign(tri, tri + 3);
+		for (uint32_t v : cache)
+		{
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+		}
+
+		// rescore everything whose cache position changed (including verticies that fell out)
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+
+			float score = ForsythVertexScore(tables, cachePosition[v], valence[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const uint32_t* adjacent = &adjacency[adjacencyOffset[v]];
+			for (uint32_t j = 0; j < valence[v]; j++)
+				triangleScore[adjacent[j]] += delta;
+		}
+		if (newCache.size() > FORSYTH_CACHE_SIZE)
+			newCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(newCache);
+
+		// next triangle: the best one connected to the cache
+		uBest = NO_TRIANGLE;
+		for (uint32_t v : cache)
+		{
+			const uint32_t* adjacent = &adjacency[adjacencyOffset[v]];
+			for (uint32_t j = 0; j < valence[v]; j++)
+			{
+				if (uBest == NO_TRIANGLE || triangleScore[adjacent[j]] > triangleScore[uBest])
+					uBest = adjacent[j];
+			}
+		}
+	}
+
+	// copy any trailing partial triangle through untouched
+	for (size_t i = uTriangleCount * 3; i < a_uIndexCount; i++)
+		a_pDestination[i] = indices[i];
+}
+
+/// <summary>
+/// Splits a cache-optimized triangle list into clusters at the points where the cache
+/// starts over (every vertex of a triangle misses), then sorts the clusters so the ones
+/// facing away from the mesh center draw first and occlude the rest (Sander et al. 2007).
+/// Because cluster boundaries are already cache misses, the reordering costs little ACMR.
+/// </summary>
+/// <param name="a_pDestination">Output triangle list (may be the same as a_pIndices)</param>
+/// <param name="a_pIndices">Input triangle list, ideally from OptimizeVertexCache</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_pPositions">Start of the first vertex position (3 floats)</param>
+/// <param name="a_uVertexCount">Number of verticies</param>
+/// <param name="a_uPositionStride">Byte distance between positions</param>
+/// <param name="a_fThreshold">Largest allowed ACMR ratio of the result over the input</param>
+void OptimizeOverdraw(uint32_t* a_pDestination, const uint32_t* a_pIndices, size_t a_uIndexCount,
+	const void* a_pPositions, size_t a_uVertexCount, size_t a_uPositionStride, float a_fThreshold)
+{
+	std::vector<uint32_t> indices(a_pIndices, a_pIndices + a_uIndexCount);
+	size_t uTriangleCount = a_uIndexCount / 3;
+	const char* pPositions = (const char*)a_pPositions;
+
+	// find cluster starts with the same FIFO model the statistics use
+	std::vector<uint32_t> clusterStart;
+	std::vector<uint64_t> insertedAt(a_uVertexCount, 0);
+	uint64_t uMisses = 0;
+	for (size_t t = 0; t < uTriangleCount; t++)
+	{
+		int nTriangleMisses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			if (insertedAt[v] == 0 || uMisses - insertedAt[v] >= VERTEX_CACHE_SIMULATED_SIZE)
+			{
+				insertedAt[v] = ++uMisses;
+				nTriangleMisses++;
+			}
+		}
+		if (t == 0 || nTriangleMisses == 3)
+			clusterStart.push_back((uint32_t)t);
+	}
+	clusterStart.push_back((uint32_t)uTriangleCount);
+
+	// per-cluster centroid and average normal, plus the mesh centroid
+	size_t uClusterCount = clusterStart.size() - 1;
+	std::vector<float> clusterData(uClusterCount * 7, 0.0f); // centroid * area (3), area (1), normal (3)
+	float meshCentroid[4] = {};
+	for (size_t c = 0; c < uClusterCount; c++)
+	{
+		float* pData = &clusterData[c * 7];
+		for (uint32_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+			AccumulateTriangle(&indices[t * 3], pPositions, a_uPositionStride, pData, pData + 4);
+
+		for (int i = 0; i < 4; i++)
+			meshCentroid[i] += pData[i];
+	}
+	for (int i = 0; i < 3 && meshCentroid[3] > 0.0f; i++)
+		meshCentroid[i] /= meshCentroid[3];
+
+	// sort key: how far the cluster faces outward from the mesh center
+	std::vector<float> sortKey(uClusterCount, 0.0f);
+	for (size_t c = 0; c < uClusterCount; c++)
+	{
+		const float* pData = &clusterData[c * 7];
+		float normalLength = sqrtf(pData[4] * pData[4] + pData[5] * pData[5] + pData[6] * pData[6]);
+		if (pData[3] <= 0.0f || normalLength <= 0.0f)
+			continue;
+
+		for (int i = 0; i < 3; i++)
+			sortKey[c] += (pData[i] / pData[3] - meshCentroid[i]) * (pData[4 + i] / normalLength);
+	}
+
+	std::vector<uint32_t> clusterOrder(uClusterCount);
+	for (size_t c = 0; c < uClusterCount; c++)
+		clusterOrder[c] = (uint32_t)c;
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+		[&](uint32_t a_uA, uint32_t a_uB) { return sortKey[a_uA] > sortKey[a_uB]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(a_uIndexCount);
+	for (uint32_t c : clusterOrder)
+		result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+	result.insert(result.end(), indices.begin() + uTriangleCount * 3, indices.end());
+
+	// keep the input order if the new one costs too many extra transforms
+	float fBefore = AnalyzeVertexCache(indices.data(), uTriangleCount * 3, a_uVertexCount).ACMR;
+	float fAfter = AnalyzeVertexCache(result.data(), uTriangleCount * 3, a_uVertexCount).ACMR;
+	const std::vector<uint32_t>& chosen = fAfter <= fBefore * a_fThreshold ? result : indices;
+	std::copy(chosen.begin(), chosen.end(), a_pDestination);
+}
+
+/// <summary>
+/// Reorders verticies into the order the index buffer first uses them, so vertex fetches walk memory
+/// linearly, and drops verticies no triangle uses
+/// </summary>
+/// <param name="a_pVertices">Vertex array, reordered in place</param>
+/// <param name="a_pIndices">Triangle list, remapped in place</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_uVertexCount">Number of verticies</param>
+/// <param name="a_uVertexSize">Size of one vertex in bytes</param>
+/// <returns>Number of verticies left</returns>
+size_t OptimizeVertexFetch(void* a_pVertices, uint32_t* a_pIndices, size_t a_uIndexCount, size_t a_uVertexCount, size_t a_uVertexSize)
+{
+	std::vector<uint32_t> remap(a_uVertexCount, UINT32_MAX);
+	uint32_t uNext = 0;
+	for (size_t i = 0; i < a_uIndexCount; i++)
+	{
+		uint32_t& index = a_pIndices[i];
+		if (remap[index] == UINT32_MAX)
+			remap[index] = uNext++;
+		index = remap[index];
+	}
+
+	char* pVertices = (char*)a_pVertices;
+	std::vector<char> original(pVertices, pVertices + a_uVertexCount * a_uVertexSize);
+	for (size_t v = 0; v < a_uVertexCount; v++)
+	{
+		if (remap[v] != UINT32_MAX)
+			memcpy(pVertices + remap[v] * a_uVertexSize, &original[v * a_uVertexSize], a_uVertexSize);
+	}
+	return uNext;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Size of the FIFO post-transform cache the statistics simulate
+#define VERTEX_CACHE_SIMULATED_SIZE 16
+
+// --------------------------------------------------------
+// Post-transform cache efficiency of an index buffer
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float ACMR;	// average cache miss ratio: transformed verticies per triangle (0.5 - 3.0)
+	float ATVR;	// average transform to vertex ratio: transformed verticies per unique vertex (1.0 is ideal)
+};
+
+// Simulates a FIFO post-transform cache over a triangle list
+VertexCacheStats AnalyzeVertexCache(const uint32_t* a_pIndices, size_t a_uIndexCount, size_t a_uVertexCount, unsigned int a_uCacheSize = VERTEX_CACHE_SIMULATED_SIZE);
+
+// Removes triangles that reference the same vertex more than once (in place), returns the new index count
+size_t RemoveDegenerateTriangles(uint32_t* a_pIndices, size_t a_uIndexCount);
+
+// Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm)
+void OptimizeVertexCache(uint32_t* a_pDestination, const uint32_t* a_pIndices, size_t a_uIndexCount, size_t a_uVertexCount);
+
+// Reorders clusters of a cache-optimized triangle list so outward-facing clusters draw first.
+// a_fThreshold limits how much worse the ACMR may get (1.05 = at most 5% worse).
+void OptimizeOverdraw(uint32_t* a_pDestination, const uint32_t* a_pIndices, size_t a_uIndexCount,
+	const void* a_pPositions, size_t a_uVertexCount, size_t a_uPositionStride, float a_fThreshold = 1.05f);
+
+// Reorders verticies into first-use order and drops unreferenced ones (in place), returns the new vertex count
+size_t OptimizeVertexFetch(void* a_pVertices, uint32_t* a_pIndices, size_t a_uIndexCount, size_t a_uVertexCount, size_t a_uVertexSize);
@@ -0,0 +1,443 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// A collapse is rejected if it turns any remaining triangle's normal by more than ~90 degrees
+	const float SIMPLIFY_FLIP_COSINE = 1e-2f;
+
+	// How strongly seams and open borders resist moving sideways, relative to the surface
+	const float SIMPLIFY_BOUNDARY_WEIGHT = 1.0f;
+
+	const uint32_t NO_VERTEX = UINT32_MAX;
+
+	enum VertexKind : unsigned char
+	{
+		VERTEX_FREE,		// interior vertex with one wedge, may collapse onto any neighbour
+		VERTEX_BOUNDARY,	// inside a single seam or border chain, may only slide along it
+		VERTEX_LOCKED		// chain ends and corners, non-manifold verticies
+	};
+
+	// The two positions next to a vertex along its seam or border chain
+	struct BoundaryNeighbours
+	{
+		uint32_t Vertex[2];
+		uint32_t Count;
+	};
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 Subtract(const Float3& a_A, const Float3& a_B)
+	{
+		return { a_A.x - a_B.x, a_A.y - a_B.y, a_A.z - a_B.z };
+	}
+
+	Float3 Cross(const Float3& a_A, const Float3& a_B)
+	{
+		return { a_A.y * a_B.z - a_A.z * a_B.y, a_A.z * a_B.x - a_A.x * a_B.z, a_A.x * a_B.y - a_A.y * a_B.x };
+	}
+
+	float Dot(const Float3& a_A, const Float3& a_B)
+	{
+		return a_A.x * a_B.x + a_A.y * a_B.y + a_A.z * a_B.z;
+	}
+
+	// --------------------------------------------------------
+	// Sum of squared distances to a set of planes, stored as
+	// the upper half of a symmetric 4x4 matrix. Each plane is
+	// weighted by the area of the triangle it came from.
+	// --------------------------------------------------------
+	struct Quadric
+	{
+		double a2, b2, c2, d2;
+		double ab, ac, ad, bc, bd, cd;
+		double Weight;
+	};
+
+	// Surface planes count towards the weight the error is averaged over, boundary constraints don't
+	void AddPlane(Quadric& a_Quadric, const Float3& a_Normal, float a_fDistance, float a_fWeight, bool a_bSurface)
+	{
+		double a = a_Normal.x, b = a_Normal.y, c = a_Normal.z, d = a_fDistance, w = a_fWeight;
+		a_Quadric.a2 += w * a * a;
+		a_Quadric.b2 += w * b * b;
+		a_Quadric.c2 += w * c * c;
+		a_Quadric.d2 += w * d * d;
+		a_Quadric.ab += w * a * b;
+		a_Quadric.ac += w * a * c;
+		a_Quadric.ad += w * a * d;
+		a_Quadric.bc += w * b * c;
+		a_Quadric.bd += w * b * d;
+		a_Quadric.cd += w * c * d;
+		if (a_bSurface)
+			a_Quadric.Weight += w;
+	}
+
+	void AddQuadric(Quadric& a_Quadric, const Quadric& a_Other)
+	{
+		a_Quadric.a2 += a_Other.a2;
+		a_Quadric.b2 += a_Other.b2;
+		a_Quadric.c2 += a_Other.c2;
+		a_Quadric.d2 += a_Other.d2;
+		a_Quadric.ab += a_Other.ab;
+		a_Quadric.ac += a_Other.ac;
+		a_Quadric.ad += a_Other.ad;
+		a_Quadric.bc += a_Other.bc;
+		a_Quadric.bd += a_Other.bd;
+		a_Quadric.cd += a_Other.cd;
+		a_Quadric.Weight += a_Other.Weight;
+	}
+
+	// Area-weighted mean squared distance from a point to the quadric's planes
+	float QuadricError(const Quadric& a_Quadric, const Float3& a_Point)
+	{
+		if (a_Quadric.Weight <= 0.0)
+			return 0.0f;
+
+		double x = a_Point.x, y = a_Point.y, z = a_Point.z;
+		double error =
+			a_Quadric.a2 * x * x + a_Quadric.b2 * y * y + a_Quadric.c2 * z * z + a_Quadric.d2 +
+			2.0 * (a_Quadric.ab * x * y + a_Quadric.ac * x * z + a_Quadric.bc * y * z +
+				a_Quadric.ad * x + a_Quadric.bd * y + a_Quadric.cd * z);
+		return (float)std::max(error / a_Quadric.Weight, 0.0);
+	}
+
+	// Exact position match used to find verticies that were split by a seam
+	struct PositionKey
+	{
+		uint32_t Bits[3];
+
+		bool operator==(const PositionKey& a_Other) const
+		{
+			return Bits[0] == a_Other.Bits[0] && Bits[1] == a_Other.Bits[1] && Bits[2] == a_Other.Bits[2];
+		}
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& a_Key) const
+		{
+			size_t hash = a_Key.Bits[0];
+			hash = hash * 0x9E3779B1u + a_Key.Bits[1];
+			hash = hash * 0x9E3779B1u + a_Key.Bits[2];
+			return hash;
+		}
+	};
+
+	uint64_t EdgeKey(uint32_t a_uFrom, uint32_t a_uTo)
+	{
+		return ((uint64_t)a_uFrom << 32) | a_uTo;
+	}
+
+	// Moving one vertex onto another
+	struct Collapse
+	{
+		uint32_t From;
+		uint32_t To;
+		float Error;
+	};
+}
+
+size_t SimplifyMesh(uint32_t* a_pDestination, const uint32_t* a_pIndices, size_t a_uIndexCount,
+	const void* a_pPositions, size_t a_uVertexCount, size_t a_uPositionStride,
+	size_t a_uTargetIndexCount, float a_fMaxError, float* a_pResultError)
+{
+	// work on a copy so the destination may alias the source
+	std::vector<uint32_t> indices(a_pIndices, a_pIndices + a_uIndexCount);
+	if (a_pResultError)
+		*a_pResultError = 0.0f;
+
+	if (a_uIndexCount <= a_uTargetIndexCount || a_uVertexCount == 0)
+	{
+		memcpy(a_pDestination, indices.data(), a_uIndexCount * sizeof(uint32_t));
+		return a_uIndexCount;
+	}
+
+	// scale positions into the unit cube so the quadrics stay well conditioned
+	const char* pPositions = (const char*)a_pPositions;
+	std::vector<Float3> positions(a_uVertexCount);
+	Float3 boundsMin = *(const Float3*)pPositions;
+	Float3 boundsMax = boundsMin;
+	for (size_t v = 0; v < a_uVertexCount; v++)
+	{
+		positions[v] = *(const Float3*)(pPositions + v * a_uPositionStride);
+		boundsMin = { std::min(boundsMin.x, positions[v].x), std::min(boundsMin.y, positions[v].y), std::min(boundsMin.z, positions[v].z) };
+		boundsMax = { std::max(boundsMax.x, positions[v].x), std::max(boundsMax.y, positions[v].y), std::max(boundsMax.z, positions[v].z) };
+	}
+	float fExtent = std::max(std::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+	if (fExtent <= 0.0f)
+		fExtent = 1.0f;
+	float fScale = 1.0f / fExtent;
+	for (size_t v = 0; v < a_uVertexCount; v++)
+		positions[v] = { (positions[v].x - boundsMin.x) * fScale, (positions[v].y - boundsMin.y) * fScale, (positions[v].z - boundsMin.z) * fScale };
+
+	// verticies at the same position are wedges of one point (split by a UV or normal seam).
+	// wedge[] maps every vertex to the first one at its position, nextWedge[] links them in a ring.
+	std::vector<uint32_t> wedge(a_uVertexCount);
+	std::vector<uint32_t> nextWedge(a_uVertexCount);
+	{
+		std::unordered_map<PositionKey, uint32_t, PositionKeyHash> positionTable;
+		positionTable.reserve(a_uVertexCount);
+		for (size_t v = 0; v < a_uVertexCount; v++)
+		{
+			PositionKey key;
+			memcpy(key.Bits, pPositions + v * a_uPositionStride, sizeof(key.Bits));
+			auto inserted = positionTable.insert({ key, (uint32_t)v });
+			wedge[v] = inserted.first->second;
+			nextWedge[v] = (uint32_t)v;
+			if (!inserted.second)
+			{
+				nextWedge[v] = nextWedge[wedge[v]];
+				nextWedge[wedge[v]] = (uint32_t)v;
+			}
+		}
+	}
+
+	// Classify every position. Seam and open border edges form chains; a vertex in the
+	// middle of exactly one chain may slide along it, anything more complicated is locked.
+	std::vector<unsigned char> kind(a_uVertexCount, VERTEX_FREE);
+	std::vector<BoundaryNeighbours> boundary(a_uVertexCount, BoundaryNeighbours{ { NO_VERTEX, NO_VERTEX }, 0 });
+	std::vector<Quadric> quadrics(a_uVertexCount, Quadric{});
+	{
+		struct EdgeUse
+		{
+			uint32_t From;		// vertex indicies of the first triangle edge between the two positions
+			uint32_t To;
+			uint32_t Triangle;
+			uint32_t Count;	// triangles using the edge in this direction
+		};
+		std::unordered_map<uint64_t, EdgeUse> edgeTable;
+		edgeTable.reserve(a_uIndexCount);
+		for (size_t i = 0; i < a_uIndexCount; i += 3)
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t a = indices[i + k];
+				uint32_t b = indices[i + (k + 1) % 3];
+				auto inserted = edgeTable.insert({ EdgeKey(wedge[a], wedge[b]), EdgeUse{ a, b, (uint32_t)(i / 3), 0 } });
+				inserted.first->second.Count++;
+			}
+
+		for (const auto& entry : edgeTable)
+		{
+			uint32_t a = (uint32_t)(entry.first >> 32);
+			uint32_t b = (uint32_t)entry.first;
+			const EdgeUse& use = entry.second;
+			auto reverse = edgeTable.find(EdgeKey(b, a));
+
+			if (use.Count != 1 || (reverse != edgeTable.end() && reverse->second.Count != 1))
+			{
+				kind[a] = kind[b] = VERTEX_LOCKED; // non-manifold
+				continue;
+			}
+
+			bool bBorder = reverse == edgeTable.end();
+			bool bSeam = !bBorder && (reverse->second.From != use.To || reverse->second.To != use.From);
+			if (!bBorder && !bSeam)
+				continue;
+
+			// a plane through the edge, perpendicular to its triangle, keeps the chain where it is
+			const uint32_t* pTriangle = &indices[use.Triangle * 3];
+			const Float3& p0 = positions[pTriangle[0]];
+			Float3 normal = Cross(Subtract(positions[pTriangle[1]], p0), Subtract(positions[pTriangle[2]], p0));
+			Float3 edge = Subtract(positions[b], positions[a]);
+			Float3 side = Cross(edge, normal);
+			float fSideLength = sqrtf(Dot(side, side));
+			if (fSideLength > 0.0f)
+			{
+				side = { side.x / fSideLength, side.y / fSideLength, side.z / fSideLength };
+				float fWeight = Dot(edge, edge) * SIMPLIFY_BOUNDARY_WEIGHT;
+				AddPlane(quadrics[a], side, -Dot(side, positions[a]), fWeight, false);
+				AddPlane(quadrics[b], side, -Dot(side, positions[a]), fWeight, false);
+			}
+
+			// seams show up in both directions, only link them once
+			if (bSeam && a > b)
+				continue;
+			for (uint32_t v : { a, b })
+			{
+				BoundaryNeighbours& neighbours = boundary[v];
+				if (neighbours.Count < 2)
+					neighbours.Vertex[neighbours.Count] = v == a ? b : a;
+				neighbours.Count++;
+			}
+		}
+
+		for (size_t v = 0; v < a_uVertexCount; v++)
+		{
+			if (wedge[v] != v || kind[v] == VERTEX_LOCKED)
+				continue;
+			if (boundary[v].Count == 2)
+				kind[v] = VERTEX_BOUNDARY;
+			else if (boundary[v].Count != 0 || nextWedge[v] != v)
+				kind[v] = VERTEX_LOCKED;
+		}
+	}
+
+	// every position also gets the planes of the triangles around it
+	for (size_t i = 0; i < a_uIndexCount; i += 3)
+	{
+		const Float3& p0 = positions[indices[i]];
+		Float3 normal = Cross(Subtract(positions[indices[i + 1]], p0), Subtract(positions[indices[i + 2]], p0));
+		float fLength = sqrtf(Dot(normal, normal));
+		if (fLength == 0.0f)
+			continue;
+		normal = { normal.x / fLength, normal.y / fLength, normal.z / fLength };
+
+		for (int k = 0; k < 3; k++)
+			AddPlane(quadrics[wedge[indices[i + k]]], normal, -Dot(normal, p0), fLength * 0.5f, true);
+	}
+
+	float fMaxError = a_fMaxError * fScale;
+	float fResultError = 0.0f;
+	size_t uIndexCount = a_uIndexCount;
+
+	std::vector<uint32_t> collapseTarget(a_uVertexCount);
+	std::vector<unsigned char> touched(a_uVertexCount);
+	std::vector<uint32_t> triangleOffsets(a_uVertexCount + 1);
+	std::vector<uint32_t> vertexTriangles(a_uIndexCount);
+	std::vector<Collapse> candidates;
+	candidates.reserve(a_uIndexCount);
+
+	// Each pass makes a batch of independent collapses, cheapest first
+	while (uIndexCount > a_uTargetIndexCount)
+	{
+		size_t uTriangleCount = uIndexCount / 3;
+
+		// vertex -> triangle adjacency of the current triangle list
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (size_t i = 0; i < uIndexCount; i++)
+			triangleOffsets[indices[i] + 1]++;
+		for (size_t v = 0; v < a_uVertexCount; v++)
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		{
+			std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (size_t i = 0; i < uIndexCount; i++)
+				vertexTriangles[cursor[indices[i]]++] = (uint32_t)(i / 3);
+		}
+
+		// every interior edge shows up once per direction, so each free vertex sees all of its neighbours;
+		// chain verticies may only slide onto their neighbours along the chain
+		candidates.clear();
+		for (size_t i = 0; i < uIndexCount; i += 3)
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t from = indices[i + k];
+				uint32_t to = indices[i + (k + 1) % 3];
+				uint32_t a = wedge[from];
+				uint32_t b = wedge[to];
+				if (kind[a] == VERTEX_FREE || (kind[a] == VERTEX_BOUNDARY && (boundary[a].Vertex[0] == b || boundary[a].Vertex[1] == b)))
+					candidates.push_back({ from, to, QuadricError(quadrics[a], positions[to]) });
+			}
+		if (candidates.empty())
+			break;
+
+		std::sort(candidates.begin(), candidates.end(),
+			[](const Collapse& a_A, const Collapse& a_B) { return a_A.Error < a_B.Error; });
+
+		// a collapse removes about two triangles
+		size_t uCollapseLimit = std::max<size_t>((uIndexCount - a_uTargetIndexCount) / 6, 1);
+		size_t uCollapses = 0;
+		for (size_t v = 0; v < a_uVertexCount; v++)
+			collapseTarget[v] = (uint32_t)v;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		for (const Collapse& collapse : candidates)
+		{
+			if (uCollapses >= uCollapseLimit || sqrtf(collapse.Error) > fMaxError)
+				break;
+
+			// anything near an earlier collapse this pass has stale adjacency and quadrics
+			uint32_t from = wedge[collapse.From];
+			uint32_t to = wedge[collapse.To];
+			if (touched[from] || touched[to])
+				continue;
+
+			// every wedge of the collapsing vertex moves onto the wedge of the target it shares a triangle with
+			bool bValid = true;
+			uint32_t v = from;
+			do
+			{
+				for (uint32_t t = triangleOffsets[v]; t < triangleOffsets[v + 1] && collapseTarget[v] == v; t++)
+					for (int k = 0; k < 3; k++)
+						if (wedge[indices[vertexTriangles[t] * 3 + k]] == to)
+							collapseTarget[v] = indices[vertexTriangles[t] * 3 + k];
+				bValid = collapseTarget[v] != v || triangleOffsets[v] == triangleOffsets[v + 1];
+				v = nextWedge[v];
+			} while (v != from && bValid);
+
+			// reject collapses that fold a surviving triangle over
+			const Float3& target = positions[collapse.To];
+			do
+			{
+				for (uint32_t t = triangleOffsets[v]; t < triangleOffsets[v + 1] && bValid; t++)
+				{
+					const uint32_t* pTriangle = &indices[vertexTriangles[t] * 3];
+					if (wedge[pTriangle[0]] == to || wedge[pTriangle[1]] == to || wedge[pTriangle[2]] == to)
+						continue; // this triangle disappears
+
+					Float3 corners[3] = { positions[pTriangle[0]], positions[pTriangle[1]], positions[pTriangle[2]] };
+					Float3 before = Cross(Subtract(corners[1], corners[0]), Subtract(corners[2], corners[0]));
+					for (int k = 0; k < 3; k++)
+						if (wedge[pTriangle[k]] == from)
+							corners[k] = target;
+					Float3 after = Cross(Subtract(corners[1], corners[0]), Subtract(corners[2], corners[0]));
+
+					float fLengths = sqrtf(Dot(before, before) * Dot(after, after));
+					bValid = Dot(before, after) > SIMPLIFY_FLIP_COSINE * fLengths;
+				}
+				v = nextWedge[v];
+			} while (v != from && bValid);
+
+			if (!bValid)
+			{
+				do
+				{
+					collapseTarget[v] = v;
+					v = nextWedge[v];
+				} while (v != from);
+				continue;
+			}
+
+			AddQuadric(quadrics[to], quadrics[from]);
+			do
+			{
+				for (uint32_t t = triangleOffsets[v]; t < triangleOffsets[v + 1]; t++)
+					for (int k = 0; k < 3; k++)
+						touched[wedge[indices[vertexTriangles[t] * 3 + k]]] = 1;
+				v = nextWedge[v];
+			} while (v != from);
+
+			fResultError = std::max(fResultError, collapse.Error);
+			uCollapses++;
+		}
+		if (uCollapses == 0)
+			break;
+
+		// apply the collapses and drop the triangles that lost their area
+		size_t uWrite = 0;
+		for (size_t t = 0; t < uTriangleCount; t++)
+		{
+			uint32_t a = collapseTarget[indices[t * 3]];
+			uint32_t b = collapseTarget[indices[t * 3 + 1]];
+			uint32_t c = collapseTarget[indices[t * 3 + 2]];
+			if (wedge[a] == wedge[b] || wedge[b] == wedge[c] || wedge[a] == wedge[c])
+				continue;
+
+			indices[uWrite++] = a;
+			indices[uWrite++] = b;
+			indices[uWrite++] = c;
+		}
+		uIndexCount = uWrite;
+	}
+
+	memcpy(a_pDestination, indices.data(), uIndexCount * sizeof(uint32_t));
+	if (a_pResultError)
+		*a_pResultError = sqrtf(fResultError) * fExtent;
+	return uIndexCount;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Simplifies a triangle list with quadric error metric edge collapses (Garland & Heckbert 1997).
+// Collapsed corners move onto a neighbouring vertex, so the vertex buffer is shared with the input.
+// UV/normal seams and open borders are kept in place. Stops once a_uTargetIndexCount is reached
+// or the next collapse would move the surface more than a_fMaxError object-space units.
+// Returns the new index count; a_pResultError receives the largest error of any collapse made.
+size_t SimplifyMesh(uint32_t* a_pDestination, const uint32_t* a_pIndices, size_t a_uIndexCount,
+	const void* a_pPositions, size_t a_uVertexCount, size_t a_uPositionStride,
+	size_t a_uTargetIndexCount, float a_fMaxError, float* a_pResultError = nullptr);
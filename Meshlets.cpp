@@ -0,0 +1,547 @@
+#include "Meshlets.h"
+#include "FrustumCulling.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	// Clusters whose triangles spread wider than this (cosine to the average direction) always draw
+	const float MESHLET_MIN_CONE_COSINE = 0.1f;
+
+	/// <summary>
+	/// Fills in the bounding sphere and normal cone of a cluster whose triangle range is set
+	/// </summary>
+	void ComputeMeshletBounds(Meshlet& a_Meshlet, const uint32_t* a_pIndices, const char* a_pPositions, size_t a_uPositionStride)
+	{
+		const uint32_t* pIndices = a_pIndices + a_Meshlet.IndexStart;
+		size_t uIndexCount = (size_t)a_Meshlet.TriangleCount * 3;
+
+		// sphere around the center of the bounding box
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = 0; i < uIndexCount; i++)
+		{
+			const float* pPosition = (const float*)(a_pPositions + pIndices[i] * a_uPositionStride);
+			for (int k = 0; k < 3; k++)
+			{
+				boundsMin[k] = std::min(boundsMin[k], pPosition[k]);
+				boundsMax[k] = std::max(boundsMax[k], pPosition[k]);
+			}
+		}
+		for (int k = 0; k < 3; k++)
+			a_Meshlet.Center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+
+		float fRadiusSquared = 0.0f;
+		for (size_t i = 0; i < uIndexCount; i++)
+		{
+			const float* pPosition = (const float*)(a_pPositions + pIndices[i] * a_uPositionStride);
+			float dx = pPosition[0] - a_Meshlet.Center[0];
+			float dy = pPosition[1] - a_Meshlet.Center[1];
+			float dz = pPosition[2] - a_Meshlet.Center[2];
+			fRadiusSquared = std::max(fRadiusSquared, dx * dx + dy * dy + dz * dz);
+		}
+		a_Meshlet.Radius = sqrtf(fRadiusSquared);
+
+		// the cone axis is the average face normal, its width the normal furthest from it
+		std::vector<float> normals(uIndexCount);
+		float axis[3] = {};
+		for (size_t i = 0; i < uIndexCount; i += 3)
+		{
+			const float* p0 = (const float*)(a_pPositions + pIndices[i] * a_uPositionStride);
+			const float* p1 = (const float*)(a_pPositions + pIndices[i + 1] * a_uPositionStride);
+			const float* p2 = (const float*)(a_pPositions + pIndices[i + 2] * a_uPositionStride);
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float fLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int k = 0; k < 3; k++)
+			{
+				normals[i + k] = fLength > 0.0f ? normal[k] / fLength : 0.0f;
+				axis[k] += normals[i + k];
+			}
+		}
+
+		a_Meshlet.ConeCutoff = 1.0f;
+		a_Meshlet.ConeAxis[0] = a_Meshlet.ConeAxis[1] = a_Meshlet.ConeAxis[2] = 0.0f;
+		a_Meshlet.Padding = 0.0f;
+		float fAxisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		if (fAxisLength == 0.0f)
+			return;
+		for (int k = 0; k < 3; k++)
+			a_Meshlet.ConeAxis[k] = axis[k] / fAxisLength;
+
+		float fMinDot = 1.0f;
+		for (size_t i = 0; i < uIndexCount; i += 3)
+		{
+			if (normals[i] == 0.0f && normals[i + 1] == 0.0f && normals[i + 2] == 0.0f)
+				continue; // degenerate triangles face nowhere
+			fMinDot = std::min(fMinDot, normals[i] * a_Meshlet.ConeAxis[0] + normals[i + 1] * a_Meshlet.ConeAxis[1] + normals[i + 2] * a_Meshlet.ConeAxis[2]);
+		}
+		if (fMinDot > MESHLET_MIN_CONE_COSINE)
+			a_Meshlet.ConeCutoff = sqrtf(1.0f - fMinDot * fMinDot);
+	}
+
+	/// <summary>
+	/// Unnormalized face normal cross(p1 - p0, p2 - p0) of a triangle, the way the bounds see it
+	/// </summary>
+	void TriangleNormal(float a_pNormal[3], const float* p0, const float* p1, const float* p2)
+	{
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		a_pNormal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		a_pNormal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		a_pNormal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	/// <summary>
+	/// Row-major, row-vector view * projection of a left-handed camera at a_pEye looking at the
+	/// origin (60 degree vertical field of view, 16:9), like DirectXMath's LookAtLH * PerspectiveFovLH
+	/// </summary>
+	void LookAtOrigin(float a_pViewProjection[16], const float a_pEye[3])
+	{
+		float fLength = sqrtf(a_pEye[0] * a_pEye[0] + a_pEye[1] * a_pEye[1] + a_pEye[2] * a_pEye[2]);
+		float z[3] = { -a_pEye[0] / fLength, -a_pEye[1] / fLength, -a_pEye[2] / fLength };
+		float up[3] = { 0.0f, 1.0f, 0.0f };
+		if (fabsf(z[1]) > 0.99f)
+		{
+			up[0] = 1.0f;
+			up[1] = 0.0f;
+		}
+		float x[3] = { up[1] * z[2] - up[2] * z[1], up[2] * z[0] - up[0] * z[2], up[0] * z[1] - up[1] * z[0] };
+		fLength = sqrtf(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+		for (int k = 0; k < 3; k++)
+			x[k] /= fLength;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+		float view[4][4] =
+		{
+			{ x[0], y[0], z[0], 0.0f },
+			{ x[1], y[1], z[1], 0.0f },
+			{ x[2], y[2], z[2], 0.0f },
+			{
+				-(x[0] * a_pEye[0] + x[1] * a_pEye[1] + x[2] * a_pEye[2]),
+				-(y[0] * a_pEye[0] + y[1] * a_pEye[1] + y[2] * a_pEye[2]),
+				-(z[0] * a_pEye[0] + z[1] * a_pEye[1] + z[2] * a_pEye[2]),
+				1.0f
+			},
+		};
+
+		const float fNear = 0.1f;
+		const float fFar = 100.0f;
+		float fScaleY = 1.0f / tanf(0.5f * 1.04719755f);
+		float fScaleX = fScaleY / (16.0f / 9.0f);
+		float fRange = fFar / (fFar - fNear);
+		float projection[4][4] =
+		{
+			{ fScaleX, 0.0f, 0.0f, 0.0f },
+			{ 0.0f, fScaleY, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, fRange, 1.0f },
+			{ 0.0f, 0.0f, -fRange * fNear, 0.0f },
+		};
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+				a_pViewProjection[r * 4 + c] = view[r][0] * projection[0][c] + view[r][1] * projection[1][c] + view[r][2] * projection[2][c] + view[r][3] * projection[3][c];
+		}
+	}
+}
+
+/// <summary>
+/// Greedily splits a triangle list into clusters of at most MESHLET_MAX_TRIANGLES triangles
+/// and MESHLET_MAX_VERTICES verticies without reordering it
+/// </summary>
+/// <param name="a_pIndices">Triangle list</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_pPositions">First vertex position (three floats)</param>
+/// <param name="a_uVertexCount">Number of verticies</param>
+/// <param name="a_uPositionStride">Bytes between two positions</param>
+/// <returns>The clusters, in index buffer order</returns>
+std::vector<Meshlet> BuildMeshlets(const uint32_t* a_pIndices, size_t a_uIndexCount,
+	const void* a_pPositions, size_t a_uVertexCount, size_t a_uPositionStride)
+{
+	std::vector<Meshlet> meshlets;
+	meshlets.reserve(a_uIndexCount / 3 / MESHLET_MAX_TRIANGLES + 1);
+
+	// which cluster last counted each vertex
+	std::vector<uint32_t> usedBy(a_uVertexCount, UINT32_MAX);
+	Meshlet current = {};
+
+	for (size_t i = 0; i + 2 < a_uIndexCount; i += 3)
+	{
+		uint32_t uMeshlet = (uint32_t)meshlets.size();
+		uint32_t a = a_pIndices[i], b = a_pIndices[i + 1], c = a_pIndices[i + 2];
+		uint32_t uNewVertices = (usedBy[a] != uMeshlet) + (usedBy[b] != uMeshlet && b != a) + (usedBy[c] != uMeshlet && c != a && c != b);
+
+		// start a new cluster once this triangle doesn't fit
+		if (current.TriangleCount == MESHLET_MAX_TRIANGLES || current.VertexCount + uNewVertices > MESHLET_MAX_VERTICES)
+		{
+			ComputeMeshletBounds(current, a_pIndices, (const char*)a_pPositions, a_uPositionStride);
+			meshlets.push_back(current);
+			current = {};
+			current.IndexStart = (uint32_t)i;
+			uMeshlet++;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (usedBy[a_pIndices[i + k]] != uMeshlet)
+			{
+				usedBy[a_pIndices[i + k]] = uMeshlet;
+				current.VertexCount++;
+			}
+		}
+		current.TriangleCount++;
+	}
+
+	if (current.TriangleCount > 0)
+	{
+		ComputeMeshletBounds(current, a_pIndices, (const char*)a_pPositions, a_uPositionStride);
+		meshlets.push_back(current);
+	}
+	return meshlets;
+}
+
+/// <summary>
+/// Moves the camera and the frustum planes into object space so the cull doesn't have to
+/// transform any cluster
+/// </summary>
+/// <param name="a_pWorld">World matrix of the draw</param>
+/// <param name="a_pViewProjection">View * projection of the camera (D3D clip space, 0 <= z <= w)</param>
+/// <param name="a_pCameraPosition">World-space camera position</param>
+/// <returns>The cull view</returns>
+ClusterCullView MakeClusterCullView(const float a_pWorld[16], const float a_pViewProjection[16], const float a_pCameraPosition[3])
+{
+	ClusterCullView view = {};
+	const float(*world)[4] = (const float(*)[4])a_pWorld;
+
+	// world-space planes
+	float planes[6][4];
+	ExtractFrustumPlanes(planes, a_pViewProjection);
+
+	// p_world = p_object * World, so a world plane becomes World * plane in object space
+	for (int p = 0; p < 6; p++)
+	{
+		for (int r = 0; r < 4; r++)
+			view.Planes[p][r] = world[r][0] * planes[p][0] + world[r][1] * planes[p][1] + world[r][2] * planes[p][2] + world[r][3] * planes[p][3];
+	}
+
+	// object-space distances grow by at most the largest axis scale
+	for (int r = 0; r < 3; r++)
+		view.RadiusScale = std::max(view.RadiusScale, sqrtf(world[r][0] * world[r][0] + world[r][1] * world[r][1] + world[r][2] * world[r][2]));
+
+	// camera position through the inverse of the affine world matrix: (p - translation) * inverse(3x3)
+	float m[3][3] =
+	{
+		{ world[1][1] * world[2][2] - world[1][2] * world[2][1], world[0][2] * world[2][1] - world[0][1] * world[2][2], world[0][1] * world[1][2] - world[0][2] * world[1][1] },
+		{ world[1][2] * world[2][0] - world[1][0] * world[2][2], world[0][0] * world[2][2] - world[0][2] * world[2][0], world[0][2] * world[1][0] - world[0][0] * world[1][2] },
+		{ world[1][0] * world[2][1] - world[1][1] * world[2][0], world[0][1] * world[2][0] - world[0][0] * world[2][1], world[0][0] * world[1][1] - world[0][1] * world[1][0] },
+	};
+	float fDeterminant = world[0][0] * m[0][0] + world[0][1] * m[1][0] + world[0][2] * m[2][0];
+	float fInverseDeterminant = fDeterminant != 0.0f ? 1.0f / fDeterminant : 0.0f;
+	float relative[3] = { a_pCameraPosition[0] - world[3][0], a_pCameraPosition[1] - world[3][1], a_pCameraPosition[2] - world[3][2] };
+	for (int c = 0; c < 3; c++)
+		view.CameraPosition[c] = (relative[0] * m[0][c] + relative[1] * m[1][c] + relative[2] * m[2][c]) * fInverseDeterminant;
+
+	return view;
+}
+
+/// <summary>
+/// Rejects clusters that are completely outside the frustum or whose every triangle faces
+/// away from the camera. Both tests are conservative.
+/// </summary>
+/// <param name="a_pVisible">Receives the indices of the surviving clusters</param>
+/// <param name="a_pMeshlets">Clusters</param>
+/// <param name="a_uMeshletCount">Number of clusters</param>
+/// <param name="a_View">Cull view of the draw</param>
+/// <param name="a_pStats">Optional statistics</param>
+/// <returns>Number of surviving clusters</returns>
+size_t CullMeshlets(uint32_t* a_pVisible, const Meshlet* a_pMeshlets, size_t a_uMeshletCount,
+	const ClusterCullView& a_View, ClusterCullStats* a_pStats)
+{
+	ClusterCullStats stats = {};
+	size_t uVisible = 0;
+	for (size_t i = 0; i < a_uMeshletCount; i++)
+	{
+		const Meshlet& meshlet = a_pMeshlets[i];
+
+		// sphere against each frustum plane
+		float fWorldRadius = meshlet.Radius * a_View.RadiusScale;
+		bool bInside = true;
+		for (int p = 0; p < 6 && bInside; p++)
+			bInside = a_View.Planes[p][0] * meshlet.Center[0] + a_View.Planes[p][1] * meshlet.Center[1] +
+				a_View.Planes[p][2] * meshlet.Center[2] + a_View.Planes[p][3] >= -fWorldRadius;
+		if (!bInside)
+		{
+			stats.OutsideFrustum++;
+			continue;
+		}
+
+		// back-facing if the camera is inside the cone's back side, padded by the sphere:
+		// dot(center - eye, axis) >= cutoff * |center - eye| + radius
+		float toCenter[3] =
+		{
+			meshlet.Center[0] - a_View.CameraPosition[0],
+			meshlet.Center[1] - a_View.CameraPosition[1],
+			meshlet.Center[2] - a_View.CameraPosition[2],
+		};
+		float fDistance = sqrtf(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] + toCenter[2] * toCenter[2]);
+		float fFacing = toCenter[0] * meshlet.ConeAxis[0] + toCenter[1] * meshlet.ConeAxis[1] + toCenter[2] * meshlet.ConeAxis[2];
+		if (fFacing >= meshlet.ConeCutoff * fDistance + meshlet.Radius)
+		{
+			stats.BackFacing++;
+			continue;
+		}
+
+		a_pVisible[uVisible++] = (uint32_t)i;
+		stats.VisibleTriangles += meshlet.TriangleCount;
+	}
+
+	stats.Visible = (uint32_t)uVisible;
+	if (a_pStats)
+		*a_pStats = stats;
+	return uVisible;
+}
+
+/// <summary>
+/// Gathers the index ranges of the visible clusters into one contiguous list
+/// </summary>
+/// <param name="a_pDestination">Receives the indices (room for every cluster's indices)</param>
+/// <param name="a_pIndices">Index data the clusters were built from</param>
+/// <param name="a_uIndexSize">Size of one index in bytes (2 or 4)</param>
+/// <param name="a_pMeshlets">Clusters</param>
+/// <param name="a_pVisible">Indices of the clusters to keep, in ascending order</param>
+/// <param name="a_uVisibleCount">Number of clusters to keep</param>
+/// <returns>Number of indices written</returns>
+size_t CompactMeshletIndices(void* a_pDestination, const void* a_pIndices, size_t a_uIndexSize,
+	const Meshlet* a_pMeshlets, const uint32_t* a_pVisible, size_t a_uVisibleCount)
+{
+	char* pDestination = (char*)a_pDestination;
+	const char* pIndices = (const char*)a_pIndices;
+	size_t uWritten = 0;
+
+	size_t i = 0;
+	while (i < a_uVisibleCount)
+	{
+		// neighbouring clusters are neighbouring index ranges, copy runs of them at once
+		size_t uStart = a_pMeshlets[a_pVisible[i]].IndexStart;
+		size_t uEnd = uStart + (size_t)a_pMeshlets[a_pVisible[i]].TriangleCount * 3;
+		for (i++; i < a_uVisibleCount && a_pMeshlets[a_pVisible[i]].IndexStart == uEnd; i++)
+			uEnd += (size_t)a_pMeshlets[a_pVisible[i]].TriangleCount * 3;
+
+		memcpy(pDestination + uWritten * a_uIndexSize, pIndices + uStart * a_uIndexSize, (uEnd - uStart) * a_uIndexSize);
+		uWritten += uEnd - uStart;
+	}
+	return uWritten;
+}
+
+/// <summary>
+/// Checks clusters against the triangle list they were built from
+/// </summary>
+/// <param name="a_pMeshlets">Clusters</param>
+/// <param name="a_uMeshletCount">Number of clusters</param>
+/// <param name="a_pIndices">Triangle list the clusters were built from</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_pPositions">First vertex position (three floats)</param>
+/// <param name="a_uVertexCount">Number of verticies</param>
+/// <param name="a_uPositionStride">Bytes between two positions</param>
+/// <returns>How many clusters and triangles broke each rule</returns>
+MeshletCheck VerifyMeshlets(const Meshlet* a_pMeshlets, size_t a_uMeshletCount, const uint32_t* a_pIndices, size_t a_uIndexCount,
+	const void* a_pPositions, size_t a_uVertexCount, size_t a_uPositionStride)
+{
+	MeshletCheck check = {};
+	const char* pPositions = (const char*)a_pPositions;
+	auto Position = [&](uint32_t a_uIndex) { return (const float*)(pPositions + a_uIndex * a_uPositionStride); };
+
+	std::vector<uint32_t> vCoverage(a_uIndexCount / 3, 0);
+	std::vector<uint32_t> vUsedBy(a_uVertexCount, UINT32_MAX);
+	for (size_t m = 0; m < a_uMeshletCount; m++)
+	{
+		const Meshlet& meshlet = a_pMeshlets[m];
+		if (meshlet.IndexStart % 3 != 0 || meshlet.IndexStart + (size_t)meshlet.TriangleCount * 3 > a_uIndexCount)
+		{
+			check.Oversized++;
+			continue;
+		}
+
+		// limits, and the recorded vertex count against the real one
+		uint32_t uVertices = 0;
+		const uint32_t* pIndices = a_pIndices + meshlet.IndexStart;
+		for (size_t i = 0; i < (size_t)meshlet.TriangleCount * 3; i++)
+		{
+			if (vUsedBy[pIndices[i]] != (uint32_t)m)
+			{
+				vUsedBy[pIndices[i]] = (uint32_t)m;
+				uVertices++;
+			}
+		}
+		if (meshlet.TriangleCount > MESHLET_MAX_TRIANGLES || uVertices > MESHLET_MAX_VERTICES || uVertices != meshlet.VertexCount)
+			check.Oversized++;
+
+		// the sphere must hold every corner (allowing for float rounding of the radius)
+		float fLimit = meshlet.Radius * 1.0001f + 1e-6f;
+		bool bLooseSphere = false;
+		for (size_t i = 0; i < (size_t)meshlet.TriangleCount * 3; i++)
+		{
+			const float* p = Position(pIndices[i]);
+			float dx = p[0] - meshlet.Center[0], dy = p[1] - meshlet.Center[1], dz = p[2] - meshlet.Center[2];
+			bLooseSphere |= dx * dx + dy * dy + dz * dz > fLimit * fLimit;
+		}
+		check.LooseSpheres += bLooseSphere ? 1 : 0;
+
+		// and a cone that can cull must hold every triangle's facing direction
+		bool bLooseCone = false;
+		float fMinCosine = sqrtf(std::max(0.0f, 1.0f - meshlet.ConeCutoff * meshlet.ConeCutoff)) - 1e-4f;
+		for (uint32_t t = 0; t < meshlet.TriangleCount; t++)
+		{
+			vCoverage[meshlet.IndexStart / 3 + t]++;
+			if (meshlet.ConeCutoff >= 1.0f)
+				continue;
+			float normal[3];
+			TriangleNormal(normal, Position(pIndices[t * 3]), Position(pIndices[t * 3 + 1]), Position(pIndices[t * 3 + 2]));
+			float fLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			if (fLength > 0.0f)
+				bLooseCone |= normal[0] * meshlet.ConeAxis[0] + normal[1] * meshlet.ConeAxis[1] + normal[2] * meshlet.ConeAxis[2] < fMinCosine * fLength;
+		}
+		check.LooseCones += bLooseCone ? 1 : 0;
+	}
+
+	for (uint32_t uCoverage : vCoverage)
+		check.MiscoveredTriangles += uCoverage == 1 ? 0 : 1;
+	return check;
+}
+
+/// <summary>
+/// Builds and culls clusters of a generated sphere with a wavy surface (so the cones differ),
+/// from cameras spread around it, some close enough for the frustum to cut the sphere
+/// </summary>
+/// <param name="a_uTriangles">How many triangles the sphere should have at least</param>
+/// <param name="a_uSeed">Seed of the jitter on the surface</param>
+/// <returns>Timings, the result of VerifyMeshlets and how many clusters were culled wrongly</returns>
+MeshletBenchmark BenchmarkMeshlets(uint32_t a_uTriangles, unsigned int a_uSeed)
+{
+	// a pole, uRings - 1 rings of uSegments verticies and another pole; 2 * uSegments * (uRings - 1) triangles
+	uint32_t uRings = std::max(3u, (uint32_t)sqrtf(a_uTriangles / 4.0f) + 1);
+	uint32_t uSegments = uRings * 2;
+	std::mt19937 random(a_uSeed);
+	std::uniform_real_distribution<float> jitter(-0.0005f, 0.0005f);
+	std::vector<float> vPositions;
+	vPositions.reserve(((size_t)(uRings - 1) * uSegments + 2) * 3);
+	auto AddVertex = [&](float a_fTheta, float a_fPhi)
+	{
+		float fRadius = 1.0f + 0.05f * sinf(5.0f * a_fTheta) * sinf(4.0f * a_fPhi) + jitter(random);
+		vPositions.insert(vPositions.end(), { fRadius * sinf(a_fTheta) * cosf(a_fPhi), fRadius * cosf(a_fTheta), fRadius * sinf(a_fTheta) * sinf(a_fPhi) });
+	};
+	const float fPi = 3.14159265f;
+	AddVertex(0.0f, 0.0f);
+	for (uint32_t r = 1; r < uRings; r++)
+	{
+		for (uint32_t s = 0; s < uSegments; s++)
+			AddVertex(fPi * r / uRings, 2.0f * fPi * s / uSegments);
+	}
+	AddVertex(fPi, 0.0f);
+	uint32_t uVertexCount = (uint32_t)(vPositions.size() / 3);
+
+	// wound so cross(p1 - p0, p2 - p0) points out of the sphere
+	auto Ring = [&](uint32_t r, uint32_t s) { return 1 + (r - 1) * uSegments + s % uSegments; };
+	std::vector<uint32_t> vIndices;
+	vIndices.reserve((size_t)uSegments * (uRings - 1) * 6);
+	for (uint32_t s = 0; s < uSegments; s++)
+		vIndices.insert(vIndices.end(), { 0, Ring(1, s + 1), Ring(1, s) });
+	for (uint32_t r = 1; r + 1 < uRings; r++)
+	{
+		for (uint32_t s = 0; s < uSegments; s++)
+			vIndices.insert(vIndices.end(), { Ring(r, s), Ring(r, s + 1), Ring(r + 1, s), Ring(r, s + 1), Ring(r + 1, s + 1), Ring(r + 1, s) });
+	}
+	for (uint32_t s = 0; s < uSegments; s++)
+		vIndices.insert(vIndices.end(), { uVertexCount - 1, Ring(uRings - 1, s), Ring(uRings - 1, s + 1) });
+	OptimizeVertexCache(vIndices.data(), vIndices.data(), vIndices.size(), uVertexCount);
+
+	MeshletBenchmark result = {};
+	result.Triangles = (uint32_t)(vIndices.size() / 3);
+	result.BuildMilliseconds = result.CullMilliseconds = 1e30;
+	std::vector<Meshlet> vMeshlets;
+	for (int run = 0; run < MESHLET_BENCHMARK_RUNS; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		vMeshlets = BuildMeshlets(vIndices.data(), vIndices.size(), vPositions.data(), uVertexCount, sizeof(float) * 3);
+		auto end = std::chrono::high_resolution_clock::now();
+		result.BuildMilliseconds = std::min(result.BuildMilliseconds, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	result.Meshlets = (uint32_t)vMeshlets.size();
+	result.Check = VerifyMeshlets(vMeshlets.data(), vMeshlets.size(), vIndices.data(), vIndices.size(), vPositions.data(), uVertexCount, sizeof(float) * 3);
+
+	// cameras on a spiral around the sphere, alternately far and close, with the mesh at the origin
+	const float world[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	float eyes[MESHLET_BENCHMARK_VIEWS][3];
+	ClusterCullView views[MESHLET_BENCHMARK_VIEWS];
+	float planes[MESHLET_BENCHMARK_VIEWS][6][4];
+	for (int v = 0; v < MESHLET_BENCHMARK_VIEWS; v++)
+	{
+		float fY = 1.0f - (v + 0.5f) * 2.0f / MESHLET_BENCHMARK_VIEWS;
+		float fRing = sqrtf(1.0f - fY * fY);
+		float fAngle = v * 2.39996323f;
+		float fDistance = (v % 2) ? 1.4f : 3.0f;
+		eyes[v][0] = fDistance * fRing * cosf(fAngle);
+		eyes[v][1] = fDistance * fY;
+		eyes[v][2] = fDistance * fRing * sinf(fAngle);
+		float viewProjection[16];
+		LookAtOrigin(viewProjection, eyes[v]);
+		views[v] = MakeClusterCullView(world, viewProjection, eyes[v]);
+		ExtractFrustumPlanes(planes[v], viewProjection);
+	}
+
+	std::vector<uint32_t> vVisible(vMeshlets.size());
+	std::vector<uint32_t> vCompacted(vIndices.size());
+	uint64_t uVisibleTriangles = 0;
+	for (int run = 0; run < MESHLET_BENCHMARK_RUNS; run++)
+	{
+		uVisibleTriangles = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int v = 0; v < MESHLET_BENCHMARK_VIEWS; v++)
+		{
+			size_t uVisible = CullMeshlets(vVisible.data(), vMeshlets.data(), vMeshlets.size(), views[v]);
+			uVisibleTriangles += CompactMeshletIndices(vCompacted.data(), vIndices.data(), sizeof(uint32_t), vMeshlets.data(), vVisible.data(), uVisible) / 3;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		result.CullMilliseconds = std::min(result.CullMilliseconds, std::chrono::duration<double, std::milli>(end - start).count() / MESHLET_BENCHMARK_VIEWS);
+	}
+	result.VisibleTriangles = (uint32_t)(uVisibleTriangles / MESHLET_BENCHMARK_VIEWS);
+
+	// every culled cluster must be all back-facing or all outside one frustum plane
+	std::vector<uint8_t> vKept(vMeshlets.size());
+	for (int v = 0; v < MESHLET_BENCHMARK_VIEWS; v++)
+	{
+		size_t uVisible = CullMeshlets(vVisible.data(), vMeshlets.data(), vMeshlets.size(), views[v]);
+		std::fill(vKept.begin(), vKept.end(), 0);
+		for (size_t i = 0; i < uVisible; i++)
+			vKept[vVisible[i]] = 1;
+
+		for (size_t m = 0; m < vMeshlets.size(); m++)
+		{
+			bool bWrong = false;
+			for (uint32_t t = 0; t < vMeshlets[m].TriangleCount && !vKept[m] && !bWrong; t++)
+			{
+				const uint32_t* pTriangle = &vIndices[vMeshlets[m].IndexStart + t * 3];
+				const float* p[3] = { &vPositions[pTriangle[0] * 3], &vPositions[pTriangle[1] * 3], &vPositions[pTriangle[2] * 3] };
+				float normal[3];
+				TriangleNormal(normal, p[0], p[1], p[2]);
+				bool bFront = normal[0] * (eyes[v][0] - p[0][0]) + normal[1] * (eyes[v][1] - p[0][1]) + normal[2] * (eyes[v][2] - p[0][2]) > 0.0f;
+				bool bOutside = false;
+				for (int k = 0; k < 6 && !bOutside; k++)
+				{
+					bOutside = true;
+					for (int c = 0; c < 3; c++)
+						bOutside &= planes[v][k][0] * p[c][0] + planes[v][k][1] * p[c][1] + planes[v][k][2] * p[c][2] + planes[v][k][3] < 0.0f;
+				}
+				bWrong = bFront && !bOutside;
+			}
+			result.WrongCulls += bWrong ? 1 : 0;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Size limits of one cluster (the usual mesh shader limits, so the data carries over)
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Times the build and the cull of BenchmarkMeshlets run (the best run counts)
+#define MESHLET_BENCHMARK_RUNS 3
+
+// Camera positions around the mesh BenchmarkMeshlets culls from
+#define MESHLET_BENCHMARK_VIEWS 16
+
+// --------------------------------------------------------
+// A small cluster of neighbouring triangles that is culled
+// as a whole. Its triangles are a contiguous range of the
+// index buffer it was built from.
+// --------------------------------------------------------
+struct Meshlet
+{
+	uint32_t IndexStart;	// first index of the cluster's triangles
+	uint32_t TriangleCount;	// at most MESHLET_MAX_TRIANGLES
+	uint32_t VertexCount;	// unique verticies the triangles use, at most MESHLET_MAX_VERTICES
+	float Radius;			// bounding sphere radius
+	float Center[3];		// bounding sphere center
+	float ConeCutoff;		// sine of the normal cone's half angle (1 if the cluster can't be back-face culled)
+	float ConeAxis[3];		// average facing direction of the triangles
+	float Padding;
+};
+
+// --------------------------------------------------------
+// Everything the cull needs about one draw, already moved
+// into the space the meshlets were built in
+// --------------------------------------------------------
+struct ClusterCullView
+{
+	float CameraPosition[3];	// eye position
+	float RadiusScale;			// largest axis scale of the world matrix (meshlet radii -> world units)
+	float Planes[6][4];			// frustum planes; a point p is inside when dot(xyz, p) + w >= 0, measured in world units
+};
+
+// --------------------------------------------------------
+// What a call to CullMeshlets did
+// --------------------------------------------------------
+struct ClusterCullStats
+{
+	uint32_t Visible;			// clusters that survived
+	uint32_t BackFacing;		// clusters rejected by their normal cone
+	uint32_t OutsideFrustum;	// clusters rejected by the view frustum
+	uint32_t VisibleTriangles;	// triangles in the surviving clusters
+};
+
+// --------------------------------------------------------
+// What VerifyMeshlets found wrong with a set of clusters
+// (all zero when they are fine)
+// --------------------------------------------------------
+struct MeshletCheck
+{
+	uint32_t Oversized;				// clusters over MESHLET_MAX_VERTICES or MESHLET_MAX_TRIANGLES, or whose VertexCount is wrong
+	uint32_t MiscoveredTriangles;	// triangles that are in no cluster or in more than one
+	uint32_t LooseSpheres;			// clusters with a vertex outside their bounding sphere
+	uint32_t LooseCones;			// clusters with a triangle facing outside their normal cone
+};
+
+// --------------------------------------------------------
+// Result of BenchmarkMeshlets
+// --------------------------------------------------------
+struct MeshletBenchmark
+{
+	uint32_t Triangles;
+	uint32_t Meshlets;
+	double BuildMilliseconds;		// best of several runs of BuildMeshlets
+	double CullMilliseconds;		// CullMeshlets and CompactMeshletIndices of one view, averaged over the views
+	uint32_t VisibleTriangles;		// triangles that survived, averaged over the views
+	MeshletCheck Check;				// VerifyMeshlets on the built clusters
+	uint32_t WrongCulls;			// clusters culled although one of their triangles faces a camera inside its frustum
+};
+
+// Splits a triangle list into clusters in its current order (run it on a vertex-cache-optimized
+// list so neighbouring triangles end up together), computing each cluster's bounds and normal cone
+std::vector<Meshlet> BuildMeshlets(const uint32_t* a_pIndices, size_t a_uIndexCount,
+	const void* a_pPositions, size_t a_uVertexCount, size_t a_uPositionStride);
+
+// Builds the cull view of one draw. Matrices are row-major and transform row vectors (p * M),
+// like DirectXMath's; a_pViewProjection is the camera's view matrix times its projection matrix.
+ClusterCullView MakeClusterCullView(const float a_pWorld[16], const float a_pViewProjection[16], const float a_pCameraPosition[3]);
+
+// Writes the indices of the clusters that are inside the frustum and not facing away from the
+// camera to a_pVisible (room for a_uMeshletCount), returns how many were written
+size_t CullMeshlets(uint32_t* a_pVisible, const Meshlet* a_pMeshlets, size_t a_uMeshletCount,
+	const ClusterCullView& a_View, ClusterCullStats* a_pStats = nullptr);
+
+// Copies the index ranges of the visible clusters back to back (merging neighbouring ranges).
+// a_uIndexSize is the size of one index in bytes, returns the number of indices written.
+size_t CompactMeshletIndices(void* a_pDestination, const void* a_pIndices, size_t a_uIndexSize,
+	const Meshlet* a_pMeshlets, const uint32_t* a_pVisible, size_t a_uVisibleCount);
+
+// Checks clusters against the triangle list they were built from: the size limits, that every
+// triangle is in exactly one cluster, and that the spheres and cones contain their triangles
+MeshletCheck VerifyMeshlets(const Meshlet* a_pMeshlets, size_t a_uMeshletCount, const uint32_t* a_pIndices, size_t a_uIndexCount,
+	const void* a_pPositions, size_t a_uVertexCount, size_t a_uPositionStride);
+
+// Builds clusters for a generated, vertex-cache-optimized sphere of at least a_uTriangles triangles,
+// checks them with VerifyMeshlets and times the build and the cull from cameras around it. Needs no
+// device, so it also runs without a window.
+MeshletBenchmark BenchmarkMeshlets(uint32_t a_uTriangles, unsigned int a_uSeed = 1);
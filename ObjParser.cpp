@@ -0,0 +1,595 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+	// Smallest amount of text worth handing to its own thread
+	const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+	// Flags describing how a chunk-local corner index must be fixed up when merging
+	const uint8_t CORNER_RELATIVE_POSITION = 1 << 0;	// negative OBJ index, relative to the chunk's first position
+	const uint8_t CORNER_RELATIVE_UV = 1 << 1;			// negative OBJ index, relative to the chunk's first uv
+	const uint8_t CORNER_RELATIVE_NORMAL = 1 << 2;		// negative OBJ index, relative to the chunk's first normal
+	const uint8_t CORNER_MISSING_UV = 1 << 3;			// "f p//n" or "f p" - no uv given
+	const uint8_t CORNER_MISSING_NORMAL = 1 << 4;		// "f p/t" or "f p" - no normal given
+
+	// A face corner as seen by a single chunk, before the merge knows where the chunk starts
+	struct RawCorner
+	{
+		int64_t Position;
+		int64_t UV;
+		int64_t Normal;
+		uint8_t Flags;
+	};
+
+	// Everything a single thread parsed out of its slice of the file
+	struct ObjChunk
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+		std::vector<ObjFloat3> Positions;
+		std::vector<ObjFloat2> UVs;
+		std::vector<ObjFloat3> Normals;
+		std::vector<RawCorner> Corners;
+		bool MissingUVs = false;
+		bool MissingNormals = false;
+		bool BadIndex = false;
+	};
+
+	// Powers of ten that are exact floats (5^10 still fits in the 24-bit significand)
+	const float POWERS_OF_TEN[] =
+	{
+		1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+	};
+
+	// Largest mantissa the fast path takes: every integer up to 2^24 is an exact float
+	const uint64_t MAX_EXACT_FLOAT_MANTISSA = 1ull << 24;
+
+	inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+	inline bool IsLineEnd(char c) { return c == '\n' || c == '\r' || c == '#'; }
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p)) p++;
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		while (p < end && *p != '\n') p++;
+		return p < end ? p + 1 : end;
+	}
+
+	/// <summary>
+	/// Parses a float without touching the locale. Numbers with at most 7 significant
+	/// digits and a small exponent, which is most of what exporters write, take the
+	/// fast path; anything else (longer mantissas, large exponents, inf/nan) goes to
+	/// std::from_chars. Both round exactly once, so the result is correctly rounded.
+	/// </summary>
+	const char* ParseFloat(const char* p, const char* end, float& out)
+	{
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		uint64_t mantissa = 0;
+		int significantDigits = 0;
+		int exponent = 0;
+		bool anyDigits = false;
+
+		// integer part
+		while (p < end && IsDigit(*p))
+		{
+			anyDigits = true;
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) significantDigits++;
+			}
+			else
+			{
+				exponent++;
+			}
+			p++;
+		}
+
+		// fractional part
+		if (p < end && *p == '.')
+		{
+			p++;
+			while (p < end && IsDigit(*p))
+			{
+				anyDigits = true;
+				if (significantDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0) significantDigits++;
+					exponent--;
+				}
+				p++;
+			}
+		}
+
+		if (!anyDigits)
+		{
+			// not a plain decimal number (inf, nan, garbage) - let the standard library decide
+			const char* text = (start < end && *start == '+') ? start + 1 : start;
+			std::from_chars_result result = std::from_chars(text, end, out);
+			return result.ec == std::errc() ? result.ptr : start;
+		}
+
+		// exponent
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negativeExponent = *e == '-';
+				e++;
+			}
+			if (e < end && IsDigit(*e))
+			{
+				int value = 0;
+				while (e < end && IsDigit(*e))
+				{
+					if (value < 100000) value = value * 10 + (*e - '0');
+					e++;
+				}
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
+
+		// Fast path: both the mantissa and the power of ten are exact floats, so the
+		// one float multiply/divide is the only rounding. Going through a double and
+		// casting down would round twice and can be one ulp off.
+		if (mantissa <= MAX_EXACT_FLOAT_MANTISSA && exponent >= -10 && exponent <= 10)
+		{
+			float value = (float)mantissa;
+			value = exponent < 0 ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+			out = negative ? -value : value;
+			return p;
+		}
+
+		// Slow path for long or extreme numbers, correctly rounded straight to float
+		const char* text = (*start == '+') ? start + 1 : start;
+		std::from_chars_result result = std::from_chars(text, end, out);
+		return result.ec == std::errc() || result.ec == std::errc::result_out_of_range ? result.ptr : p;
+	}
+
+	/// <summary>
+	/// Parses a (possibly negative) integer. Returns nullptr if there were no digits.
+	/// </summary>
+	const char* ParseInt(const char* p, const char* end, int64_t& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+		if (p >= end || !IsDigit(*p))
+			return nullptr;
+
+		int64_t value = 0;
+		while (p < end && IsDigit(*p))
+		{
+			value = value * 10 + (*p - '0');
+			p++;
+		}
+		out = negative ? -value : value;
+		return p;
+	}
+
+	/// <summary>
+	/// Converts a 1-based (or negative, relative) OBJ index to a chunk-local 0-based one
+	/// </summary>
+	inline void ResolveIndex(int64_t a_nIndex, size_t a_uLocalCount, uint8_t a_uRelativeFlag, int64_t& a_nOut, uint8_t& a_uFlags, bool& a_bBadIndex)
+	{
+		if (a_nIndex > 0)
+		{
+			a_nOut = a_nIndex - 1;
+		}
+		else if (a_nIndex < 0)
+		{
+			// may point into a previous chunk; fixed up once chunk offsets are known
+			a_nOut = (int64_t)a_uLocalCount + a_nIndex;
+			a_uFlags |= a_uRelativeFlag;
+		}
+		else
+		{
+			a_nOut = 0;
+			a_bBadIndex = true; // OBJ indices are never 0
+		}
+	}
+
+	/// <summary>
+	/// Parses one newline-aligned slice of the file into chunk-local arrays
+	/// </summary>
+	void ParseChunk(ObjChunk& a_Chunk)
+	{
+		const char* p = a_Chunk.Begin;
+		const char* end = a_Chunk.End;
+		std::vector<RawCorner> face;
+
+		while (p < end)
+		{
+			p = SkipSpaces(p, end);
+			if (p >= end)
+				break;
+
+			if (p[0] == 'v' && p + 1 < end && IsSpace(p[1]))
+			{
+				ObjFloat3 pos = {};
+				p = SkipSpaces(p + 1, end); p = ParseFloat(p, end, pos.x);
+				p = SkipSpaces(p, end); p = ParseFloat(p, end, pos.y);
+				p = SkipSpaces(p, end); p = ParseFloat(p, end, pos.z);
+				a_Chunk.Positions.push_back(pos);
+			}
+			else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && IsSpace(p[2]))
+			{
+				ObjFloat2 uv = {};
+				p = SkipSpaces(p + 2, end); p = ParseFloat(p, end, uv.x);
+				p = SkipSpaces(p, end); p = ParseFloat(p, end, uv.y);
+				a_Chunk.UVs.push_back(uv);
+			}
+			else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && IsSpace(p[2]))
+			{
+				ObjFloat3 norm = {};
+				p = SkipSpaces(p + 2, end); p = ParseFloat(p, end, norm.x);
+				p = SkipSpaces(p, end); p = ParseFloat(p, end, norm.y);
+				p = SkipSpaces(p, end); p = ParseFloat(p, end, norm.z);
+				a_Chunk.Normals.push_back(norm);
+			}
+			else if (p[0] == 'f' && p + 1 < end && IsSpace(p[1]))
+			{
+				face.clear();
+				p = SkipSpaces(p + 1, end);
+
+				// read every "p", "p/t", "p//n" or "p/t/n" token on the line
+				while (p < end && !IsLineEnd(*p))
+				{
+					RawCorner corner = {};
+					int64_t value = 0;
+					const char* next = ParseInt(p, end, value);
+					if (!next)
+						break;
+					ResolveIndex(value, a_Chunk.Positions.size(), CORNER_RELATIVE_POSITION, corner.Position, corner.Flags, a_Chunk.BadIndex);
+					p = next;
+
+					corner.Flags |= CORNER_MISSING_UV | CORNER_MISSING_NORMAL;
+					if (p < end && *p == '/')
+					{
+						p++;
+						next = ParseInt(p, end, value);
+						if (next)
+						{
+							corner.Flags &= ~CORNER_MISSING_UV;
+							ResolveIndex(value, a_Chunk.UVs.size(), CORNER_RELATIVE_UV, corner.UV, corner.Flags, a_Chunk.BadIndex);
+							p = next;
+						}
+						if (p < end && *p == '/')
+						{
+							p++;
+							next = ParseInt(p, end, value);
+							if (next)
+							{
+								corner.Flags &= ~CORNER_MISSING_NORMAL;
+								ResolveIndex(value, a_Chunk.Normals.size(), CORNER_RELATIVE_NORMAL, corner.Normal, corner.Flags, a_Chunk.BadIndex);
+								p = next;
+							}
+						}
+					}
+
+					a_Chunk.MissingUVs |= (corner.Flags & CORNER_MISSING_UV) != 0;
+					a_Chunk.MissingNormals |= (corner.Flags & CORNER_MISSING_NORMAL) != 0;
+					face.push_back(corner);
+					p = SkipSpaces(p, end);
+				}
+
+				// fan-triangulate the polygon
+				for (size_t k = 1; k + 1 < face.size(); k++)
+				{
+					a_Chunk.Corners.push_back(face[0]);
+					a_Chunk.Corners.push_back(face[k]);
+					a_Chunk.Corners.push_back(face[k + 1]);
+				}
+			}
+
+			// anything else (comments, groups, materials, smoothing) is ignored
+			p = SkipLine(p, end);
+		}
+	}
+}
+
+/// <summary>
+/// Parses an OBJ file by memory-mapping it and parsing newline-aligned chunks in parallel
+/// </summary>
+/// <param name="a_sFileName">Path to the OBJ file</param>
+/// <param name="a_uMaxThreads">Upper bound on worker threads (0 = hardware concurrency)</param>
+/// <returns>Raw OBJ data</returns>
+ObjData ParseObjFile(const char* a_sFileName, unsigned int a_uMaxThreads)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	MappedFile file(a_sFileName);
+	if (!file.IsOpen())
+		throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+
+	ObjData data = ParseObjText(file.GetData(), file.GetSize(), a_uMaxThreads);
+
+	// report the whole load, including mapping and page faults
+	data.ParseMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return data;
+}
+
+/// <summary>
+/// Parses OBJ text that is already in memory
+/// </summary>
+/// <param name="a_pText">OBJ file contents</param>
+/// <param name="a_uLength">Length of the text in bytes</param>
+/// <param name="a_uMaxThreads">Upper bound on worker threads (0 = hardware concurrency)</param>
+/// <returns>Raw OBJ data</returns>
+ObjData ParseObjText(const char* a_pText, size_t a_uLength, unsigned int a_uMaxThreads)
+{
+	auto start = std::chrono::steady_clock::now();
+	const char* end = a_pText + a_uLength;
+
+	// decide how many slices the file is worth
+	unsigned int uThreads = a_uMaxThreads ? a_uMaxThreads : std::max(1u, std::thread::hardware_concurrency());
+	size_t uChunkCount = std::max<size_t>(1, std::min<size_t>(uThreads, a_uLength / MIN_CHUNK_BYTES));
+
+	// split on line boundaries so no line is shared between two chunks
+	std::vector<ObjChunk> vChunks(uChunkCount);
+	const char* chunkStart = a_pText;
+	for (size_t i = 0; i < uChunkCount; i++)
+	{
+		const char* chunkEnd = (i + 1 == uChunkCount) ? end : a_pText + a_uLength * (i + 1) / uChunkCount;
+		if (chunkEnd < chunkStart) chunkEnd = chunkStart;
+		while (chunkEnd < end && chunkEnd[-1] != '\n') chunkEnd++;
+
+		vChunks[i].Begin = chunkStart;
+		vChunks[i].End = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	// parse every chunk (the calling thread takes the first one)
+	{
+		std::vector<std::thread> vWorkers;
+		for (size_t i = 1; i < uChunkCount; i++)
+			vWorkers.emplace_back(ParseChunk, std::ref(vChunks[i]));
+		ParseChunk(vChunks[0]);
+		for (auto& t : vWorkers) t.join();
+	}
+
+	// prefix sums give every chunk a fixed, deterministic place in the output
+	std::vector<size_t> vPositionBase(uChunkCount), vUVBase(uChunkCount), vNormalBase(uChunkCount), vCornerBase(uChunkCount);
+	size_t uPositions = 0, uUVs = 0, uNormals = 0, uCorners = 0;
+	bool bMissingUVs = false, bMissingNormals = false;
+	for (size_t i = 0; i < uChunkCount; i++)
+	{
+		vPositionBase[i] = uPositions; uPositions += vChunks[i].Positions.size();
+		vUVBase[i] = uUVs; uUVs += vChunks[i].UVs.size();
+		vNormalBase[i] = uNormals; uNormals += vChunks[i].Normals.size();
+		vCornerBase[i] = uCorners; uCorners += vChunks[i].Corners.size();
+		bMissingUVs |= vChunks[i].MissingUVs;
+		bMissingNormals |= vChunks[i].MissingNormals;
+	}
+
+	ObjData data;
+	data.Positions.resize(uPositions);
+	data.UVs.resize(uUVs + (bMissingUVs ? 1 : 0));
+	data.Normals.resize(uNormals + (bMissingNormals ? 1 : 0));
+	data.Corners.resize(uCorners);
+
+	// corners without uvs or normals all share one default value at the end
+	if (bMissingUVs) data.UVs[uUVs] = { 0.0f, 0.0f };
+	if (bMissingNormals) data.Normals[uNormals] = { 0.0f, 1.0f, 0.0f };
+
+	// copy each chunk into place and turn its local indices into global ones
+	auto MergeChunk = [&](size_t i)
+	{
+		ObjChunk& chunk = vChunks[i];
+		std::copy(chunk.Positions.begin(), chunk.Positions.end(), data.Positions.begin() + vPositionBase[i]);
+		std::copy(chunk.UVs.begin(), chunk.UVs.end(), data.UVs.begin() + vUVBase[i]);
+		std::copy(chunk.Normals.begin(), chunk.Normals.end(), data.Normals.begin() + vNormalBase[i]);
+
+		ObjCorner* pOut = data.Corners.data() + vCornerBase[i];
+		for (const RawCorner& raw : chunk.Corners)
+		{
+			int64_t position = raw.Position + ((raw.Flags & CORNER_RELATIVE_POSITION) ? (int64_t)vPositionBase[i] : 0);
+			int64_t uv = (raw.Flags & CORNER_MISSING_UV) ? (int64_t)uUVs : raw.UV + ((raw.Flags & CORNER_RELATIVE_UV) ? (int64_t)vUVBase[i] : 0);
+			int64_t normal = (raw.Flags & CORNER_MISSING_NORMAL) ? (int64_t)uNormals : raw.Normal + ((raw.Flags & CORNER_RELATIVE_NORMAL) ? (int64_t)vNormalBase[i] : 0);
+
+			if (position < 0 || position >= (int64_t)data.Positions.size() ||
+				uv < 0 || uv >= (int64_t)data.UVs.size() ||
+				normal < 0 || normal >= (int64_t)data.Normals.size())
+			{
+				chunk.BadIndex = true;
+				position = uv = normal = 0;
+			}
+
+			*pOut++ = { (unsigned int)position, (unsigned int)uv, (unsigned int)normal };
+		}
+	};
+
+	{
+		std::vector<std::thread> vWorkers;
+		for (size_t i = 1; i < uChunkCount; i++)
+			vWorkers.emplace_back(MergeChunk, i);
+		MergeChunk(0);
+		for (auto& t : vWorkers) t.join();
+	}
+
+	for (auto& chunk : vChunks)
+	{
+		if (chunk.BadIndex)
+			throw std::invalid_argument("Error reading OBJ: face references a vertex attribute that does not exist");
+	}
+
+	data.FileBytes = a_uLength;
+	data.ThreadCount = (unsigned int)uChunkCount;
+	data.ParseMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return data;
+}
+
+/// <summary>
+/// Writes a grid of at least a_uTriangles triangles as OBJ text, with randomly
+/// displaced heights and normals so the numbers take every length an exporter writes
+/// </summary>
+/// <param name="a_uTriangles">How many triangles the grid should have at least</param>
+/// <param name="a_uSeed">Seed of the displacement</param>
+/// <returns>The OBJ text</returns>
+std::string GenerateObjText(unsigned int a_uTriangles, unsigned int a_uSeed)
+{
+	// two triangles per grid cell
+	unsigned int uCells = std::max(1u, (a_uTriangles + 1) / 2);
+	unsigned int uWidth = std::max(1u, (unsigned int)std::sqrt((double)uCells));
+	unsigned int uHeight = (uCells + uWidth - 1) / uWidth;
+
+	std::mt19937 random(a_uSeed);
+	std::uniform_real_distribution<float> height(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> tilt(-0.3f, 0.3f);
+
+	std::string sText;
+	sText.reserve((size_t)(uWidth + 1) * (uHeight + 1) * 100 + (size_t)uWidth * uHeight * 60);
+	sText += "# generated grid\n";
+	char line[128];
+	for (unsigned int z = 0; z <= uHeight; z++)
+	{
+		for (unsigned int x = 0; x <= uWidth; x++)
+		{
+			int n = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", (x - 0.5f * uWidth) * 0.05f, height(random), (z - 0.5f * uHeight) * 0.05f);
+			sText.append(line, n);
+			n = snprintf(line, sizeof(line), "vt %.6f %.6f\n", (float)x / uWidth, (float)z / uHeight);
+			sText.append(line, n);
+			float nx = tilt(random), nz = tilt(random);
+			float fLength = std::sqrt(nx * nx + 1.0f + nz * nz);
+			n = snprintf(line, sizeof(line), "vn %.4f %.4f %.4f\n", nx / fLength, 1.0f / fLength, nz / fLength);
+			sText.append(line, n);
+		}
+	}
+	for (unsigned int z = 0; z < uHeight; z++)
+	{
+		for (unsigned int x = 0; x < uWidth; x++)
+		{
+			// 1-based corners of the cell, uv and normal share the position's index
+			unsigned int a = z * (uWidth + 1) + x + 1, b = a + 1, c = a + uWidth + 1, d = c + 1;
+			int n = snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, b, b, b);
+			sText.append(line, n);
+			n = snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", b, b, b, c, c, c, d, d, d);
+			sText.append(line, n);
+		}
+	}
+	return sText;
+}
+
+/// <summary>
+/// Times ParseObjFile loading a generated OBJ from a temporary file, on one thread and on every
+/// hardware thread, and checks the result against a line by line reference read of the same text.
+/// The file was just written, so it is read from the OS file cache: the times cover opening,
+/// mapping, page faults and parsing, not the disk.
+/// </summary>
+/// <param name="a_uTriangles">How many triangles the generated OBJ should have at least</param>
+/// <param name="a_uSeed">Seed of the generated grid</param>
+/// <returns>Best times of each run, and whether the parse matched the reference</returns>
+ObjParserBenchmark BenchmarkObjParser(unsigned int a_uTriangles, unsigned int a_uSeed)
+{
+	std::string sText = GenerateObjText(a_uTriangles, a_uSeed);
+
+	ObjParserBenchmark result = {};
+	result.Bytes = sText.size();
+	result.Threads = std::max(1u, std::thread::hardware_concurrency());
+	result.SingleThreadMilliseconds = result.ThreadedMilliseconds = 1e30;
+
+	std::error_code error;
+	std::string sFileName = (std::filesystem::temp_directory_path(error) / "ObjParserBenchmark.obj").string();
+	{
+		std::ofstream file(sFileName, std::ios::binary | std::ios::trunc);
+		file.write(sText.data(), sText.size());
+		file.close();
+		if (error || file.fail())
+			return result;
+	}
+
+	ObjData data;
+	for (int run = 0; run < OBJ_PARSER_BENCHMARK_RUNS; run++)
+	{
+		data = ParseObjFile(sFileName.c_str(), 1);
+		result.SingleThreadMilliseconds = std::min(result.SingleThreadMilliseconds, data.ParseMilliseconds);
+
+		data = ParseObjFile(sFileName.c_str(), result.Threads);
+		result.ThreadedMilliseconds = std::min(result.ThreadedMilliseconds, data.ParseMilliseconds);
+	}
+	std::filesystem::remove(sFileName, error);
+	result.Triangles = (unsigned int)(data.Corners.size() / 3);
+
+	// reference: every number read on its own by std::from_chars, which rounds correctly
+	const char* p = sText.data();
+	const char* end = p + sText.size();
+	size_t uPositions = 0, uUVs = 0, uNormals = 0, uCorners = 0;
+	bool bCorrect = true;
+	auto Expect = [&](float a_fParsed)
+	{
+		float fValue = 0.0f;
+		p = std::from_chars(SkipSpaces(p, end), end, fValue).ptr;
+		if (memcmp(&fValue, &a_fParsed, sizeof(float)) != 0)
+			result.FloatMismatches++;
+	};
+	while (p < end)
+	{
+		if (p[0] == 'v' && p[1] == ' ' && uPositions < data.Positions.size())
+		{
+			const ObjFloat3& v = data.Positions[uPositions++];
+			p += 1;
+			Expect(v.x); Expect(v.y); Expect(v.z);
+		}
+		else if (p[0] == 'v' && p[1] == 't' && uUVs < data.UVs.size())
+		{
+			const ObjFloat2& v = data.UVs[uUVs++];
+			p += 2;
+			Expect(v.x); Expect(v.y);
+		}
+		else if (p[0] == 'v' && p[1] == 'n' && uNormals < data.Normals.size())
+		{
+			const ObjFloat3& v = data.Normals[uNormals++];
+			p += 2;
+			Expect(v.x); Expect(v.y); Expect(v.z);
+		}
+		else if (p[0] == 'f')
+		{
+			p += 1;
+			for (int k = 0; k < 3 && bCorrect; k++)
+			{
+				unsigned int position = 0, uv = 0, normal = 0;
+				p = std::from_chars(SkipSpaces(p, end), end, position).ptr;
+				p = std::from_chars(p + 1, end, uv).ptr;
+				p = std::from_chars(p + 1, end, normal).ptr;
+				bCorrect = uCorners < data.Corners.size() &&
+					data.Corners[uCorners++] == ObjCorner{ position - 1, uv - 1, normal - 1 };
+			}
+		}
+		p = SkipLine(p, end);
+	}
+	result.Correct = bCorrect && uPositions == data.Positions.size() && uUVs == data.UVs.size() &&
+		uNormals == data.Normals.size() && uCorners == data.Corners.size();
+	return result;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Times each parse of BenchmarkObjParser runs (the best run counts)
+#define OBJ_PARSER_BENCHMARK_RUNS 3
+
+// --------------------------------------------------------
+// Plain float vectors used by the OBJ parser so it does not
+// depend on DirectXMath (layout-compatible with XMFLOAT2/3)
+// --------------------------------------------------------
+struct ObjFloat2
+{
+	float x;
+	float y;
+};
+
+struct ObjFloat3
+{
+	float x;
+	float y;
+	float z;
+};
+
+// --------------------------------------------------------
+// A single face corner: 0-based position, uv and normal
+// indices into the parsed attribute arrays
+// --------------------------------------------------------
+struct ObjCorner
+{
+	unsigned int Position;
+	unsigned int UV;
+	unsigned int Normal;
+
+	bool operator==(const ObjCorner& a_Other) const
+	{
+		return Position == a_Other.Position && UV == a_Other.UV && Normal == a_Other.Normal;
+	}
+};
+
+// --------------------------------------------------------
+// Raw OBJ contents, exactly as written in the file
+// (no handedness conversion, no welding)
+//
+// Faces are fan-triangulated, so every three consecutive
+// entries of Corners form one triangle in file winding.
+// --------------------------------------------------------
+struct ObjData
+{
+	std::vector<ObjFloat3> Positions;
+	std::vector<ObjFloat2> UVs;
+	std::vector<ObjFloat3> Normals;
+	std::vector<ObjCorner> Corners;
+
+	// load statistics
+	size_t FileBytes = 0;
+	unsigned int ThreadCount = 0;
+	double ParseMilliseconds = 0.0;
+};
+
+// --------------------------------------------------------
+// Result of BenchmarkObjParser
+// --------------------------------------------------------
+struct ObjParserBenchmark
+{
+	size_t Bytes;						// size of the generated OBJ file
+	unsigned int Triangles;
+	unsigned int Threads;				// threads of the threaded run
+	double SingleThreadMilliseconds;	// best of several loads of the file by ParseObjFile on one thread, mapping included
+	double ThreadedMilliseconds;		// the same on Threads threads
+	unsigned int FloatMismatches;		// parsed numbers that differ from std::from_chars on the same text
+	bool Correct;						// the file was written, the counts match and every face points where it was written to
+};
+
+// Parses an OBJ file by memory-mapping it and splitting it into
+// newline-aligned chunks that are parsed in parallel
+ObjData ParseObjFile(const char* a_sFileName, unsigned int a_uMaxThreads = 0);
+
+// Parses OBJ text that is already in memory
+ObjData ParseObjText(const char* a_pText, size_t a_uLength, unsigned int a_uMaxThreads = 0);
+
+// Writes a grid of roughly a_uTriangles triangles as OBJ text the way exporters do: positions,
+// uvs and normals with six decimals and "f p/t/n" faces
+std::string GenerateObjText(unsigned int a_uTriangles, unsigned int a_uSeed = 1);
+
+// Writes the text of GenerateObjText to a temporary file, times ParseObjFile loading it on one and
+// on every hardware thread, and checks the parsed data against what was written. Needs no device,
+// so it also runs without a window.
+ObjParserBenchmark BenchmarkObjParser(unsigned int a_uTriangles, unsigned int a_uSeed = 1);
@@ -4,8 +4,7 @@
 // texture and sampler
 Texture2D Albedo                        : register(t0);
 Texture2D NormalMap                     : register(t1);
-Texture2D RoughnessMap                  : register(t2);
-Texture2D MetalnessMap                  : register(t3);
+Texture2D PackedMaps                    : register(t2); // occlusion, roughness, metalness
 Texture2DArray ShadowMaps               : register(t4);
 //Texture2D ShadowMap : register(t4);
 SamplerState BasicSampler               : register(s0);
@@ -17,7 +16,8 @@ cbuffer ExternalData : register(b0)
     float4 colorTint;
     float2 uvScale;
     float2 uvOffset;
-    float roughness;
+    float3 packedConstant;  // occlusion, roughness, metalness of the channels that aren't sampled
+    float3 packedSampled;   // 1 for the channels PackedMaps varies in
     float3 cameraPos;
     float3 ambient;
     Light lights[5];
@@ -36,25 +36,32 @@ float4 main(VertexToPixel input) : SV_TARGET
 {
     // re-normalize the normals
     input.normal = normalize(input.normal);
-    input.tangent = normalize(input.tangent);
+    input.tangent.xyz = normalize(input.tangent.xyz);
     
     float2 uvPosition = input.uv * uvScale + uvOffset;
     
     // sample the textures 
     float3 albedoColor = pow(Albedo.Sample(BasicSampler, uvPosition), 2.2f).rgb;
-    float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
-    float metalness = MetalnessMap.Sample(BasicSampler, input.uv).r;
     
-    // unpack the normal from the normal map
-    float3 unpackedNormal = NormalMap.Sample(BasicSampler, uvPosition).rgb * 2 - 1;
+    // one fetch for the packed maps, none when every channel is a constant
+    float3 packed = packedConstant;
+    if (any(packedSampled))
+        packed = lerp(packedConstant, PackedMaps.Sample(BasicSampler, uvPosition).rgb, packedSampled);
+    float occlusion = packed.r;
+    float roughness = packed.g;
+    float metalness = packed.b;
+    
+    // unpack the normal from the normal map; z is rebuilt from x and y, since cooked (BC5) normal maps only store those
+    float2 normalXY = NormalMap.Sample(BasicSampler, uvPosition).rg * 2 - 1;
+    float3 unpackedNormal = float3(normalXY, sqrt(saturate(1 - dot(normalXY, normalXY))));
     unpackedNormal = normalize(unpackedNormal); // Dont forget to normalize!
     
     // Feel free to adjust/simplify this code to fit with your existing shader(s)
     // Simplifications include not re-normalizing the same vector more than once!
     float3 N = input.normal; 
-    float3 T = input.tangent;
+    float3 T = input.tangent.xyz;
     T = normalize(T - N * dot(T, N)); // Gram-Schmidt assumes T&N are normalized!
-    float3 B = cross(T, N);
+    float3 B = cross(T, N) * (input.tangent.w < 0 ? -1.0f : 1.0f); // flipped where the UVs are mirrored
     float3x3 TBN = float3x3(T, B, N);
     
     // transform the normal by the the value from the normal map
@@ -70,7 +77,7 @@ float4 main(VertexToPixel input) : SV_TARGET
     float3 view = normalize(cameraPos - input.worldPosition);
     
     // ambient light calculations
-    //float3 ambientTerm = ambient * albedoColor;
+    //float3 ambientTerm = ambient * albedoColor * occlusion;
     
     // calculate light from all lights
     float3 result = float3(0, 0, 0);
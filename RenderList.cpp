@@ -0,0 +1,217 @@
+#include "RenderList.h"
+#include <algorithm>
+#include <chrono>
+
+/// <summary>
+/// Gathers a packet for every drawn entity of a world, bringing its box up to date on the way.
+/// Call after the transforms were updated for the frame.
+/// </summary>
+/// <param name="a_World">World whose entities to draw</param>
+void RenderList::Build(EntityWorld& a_World)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// meshes, materials and shader programs are numbered in the order they're first met, so the numbers stay put while the world does
+	m_vMeshes.clear();
+	m_vMaterials.clear();
+	m_htMeshIds.clear();
+	m_htMaterialIds.clear();
+	m_vMaterialShaders.clear();
+	m_vShaders.clear();
+
+	uint32_t uCount = a_World.GetCount(DrawnEntityMask());
+	m_vPackets.resize(uCount);
+	m_vWorld.resize(uCount);
+	m_vWorldInverseTranspose.resize(uCount);
+	m_Bounds.Resize(uCount);
+
+	uint32_t uPacket = 0;
+	a_World.ForEach(DrawnEntityMask(), [&](const EntityChunk& a_Chunk)
+	{
+		const uint32_t* pEntities = a_Chunk.GetEntities();
+		const EntityTransform* pTransforms = a_Chunk.Get<EntityTransform>();
+		const EntityRender* pRenders = a_Chunk.Get<EntityRender>();
+		EntityBounds* pBounds = a_Chunk.Get<EntityBounds>();
+		for (uint32_t i = 0; i < a_Chunk.Count; i++, uPacket++)
+		{
+			UpdateEntityBounds(pTransforms[i], pRenders[i], pBounds[i]);
+
+			DrawPacket& packet = m_vPackets[uPacket];
+			packet.Mesh = MeshId(pRenders[i].Mesh);
+			packet.Material = MaterialId(pRenders[i].Material);
+			packet.Shader = m_vMaterialShaders[packet.Material];
+			packet.SortKey = MakeDrawKey(DRAW_PASS_OPAQUE, packet.Shader, packet.Material, packet.Mesh, 0, 0);
+			packet.World = uPacket;
+			packet.Entity = pEntities[i];
+			packet.Center = pBounds[i].Center;
+			packet.Extent = pBounds[i].Extent;
+
+			m_vWorld[uPacket] = pTransforms[i].Hierarchy->GetWorldMatrix(pTransforms[i].Node);
+			m_vWorldInverseTranspose[uPacket] = pTransforms[i].Hierarchy->GetWorldInverseTransposeMatrix(pTransforms[i].Node);
+			m_Bounds.Set(uPacket, &packet.Center.x, &packet.Extent.x);
+		}
+	});
+
+	m_dBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/// <summary>
+/// Splits a pass's sorted packets into runs whose keys only differ in depth and whose packets use the
+/// same mesh (and, in the opaque pass, the same material), and writes the world matrices of the runs
+/// that can be instanced to the instance buffer, in draw order. Runs shorter
+/// than INSTANCING_MIN_BATCH are left to draw one at a time, and so are, in the opaque pass, those
+/// whose material has no instanced vertex shader and those of meshes that cull their clusters at full
+/// resolution (culling is per entity). Bind the instance buffer after this, since it may have grown.
+/// </summary>
+/// <param name="a_vKeys">The pass's sorted draw keys, with the level of detail in them</param>
+/// <param name="a_vOrder">Packets in the order of the keys</param>
+/// <param name="a_vBatches">Receives the runs, in draw order</param>
+/// <returns>Number of instances written</returns>
+uint32_t RenderList::BatchInstances(const std::vector<uint64_t>& a_vKeys, const std::vector<uint32_t>& a_vOrder, std::vector<DrawBatch>& a_vBatches) const
+{
+	a_vBatches.clear();
+	if (a_vKeys.empty())
+		return 0;
+
+	// if the buffer can't be mapped everything is drawn one at a time
+	InstanceData* pInstances = InstanceBuffer::Map((unsigned int)a_vKeys.size());
+	uint32_t uInstances = 0;
+	for (size_t uFirst = 0, uEnd = 0; uFirst < a_vKeys.size(); uFirst = uEnd)
+	{
+		// ids past the width of their key field wrap, so equal keys don't guarantee equal
+		// meshes and materials; the packets' own ids decide (shadows only bind the mesh)
+		uint64_t uBatch = GetDrawKeyBatch(a_vKeys[uFirst]);
+		const DrawPacket& packet = m_vPackets[a_vOrder[uFirst]];
+		bool bOpaque = GetDrawKeyPass(a_vKeys[uFirst]) == DRAW_PASS_OPAQUE;
+		auto SameBatch = [&](size_t i)
+		{
+			const DrawPacket& other = m_vPackets[a_vOrder[i]];
+			return GetDrawKeyBatch(a_vKeys[i]) == uBatch && other.Mesh == packet.Mesh && (!bOpaque || other.Material == packet.Material);
+		};
+		for (uEnd = uFirst + 1; uEnd < a_vKeys.size() && SameBatch(uEnd); uEnd++);
+
+		DrawBatch batch = { (uint32_t)uFirst, (uint32_t)(uEnd - uFirst), uInstances, false };
+		batch.Instanced = pInstances && batch.Count >= INSTANCING_MIN_BATCH;
+		if (bOpaque)
+			batch.Instanced = batch.Instanced && m_vMaterials[packet.Material]->GetInstancedVertexShader()
+				&& !(GetDrawKeyLod(a_vKeys[uFirst]) == 0 && m_vMeshes[packet.Mesh]->GetMeshletCount() > 0);
+
+		if (batch.Instanced)
+		{
+			for (size_t i = uFirst; i < uEnd; i++)
+			{
+				uint32_t uWorld = m_vPackets[a_vOrder[i]].World;
+				SetInstanceData(pInstances[uInstances++], m_vWorld[uWorld], m_vWorldInverseTranspose[uWorld]);
+			}
+		}
+		a_vBatches.push_back(batch);
+	}
+	if (pInstances)
+		InstanceBuffer::Unmap(uInstances);
+	return uInstances;
+}
+
+/// <summary>
+/// Numbers a mesh, the first time it's met this build
+/// </summary>
+uint32_t RenderList::MeshId(Mesh* a_pMesh)
+{
+	auto it = m_htMeshIds.find(a_pMesh);
+	if (it != m_htMeshIds.end())
+		return it->second;
+	m_vMeshes.push_back(a_pMesh);
+	return m_htMeshIds[a_pMesh] = (uint32_t)m_vMeshes.size() - 1;
+}
+
+/// <summary>
+/// Numbers a material, and its shader program, the first time it's met this build
+/// </summary>
+uint32_t RenderList::MaterialId(Material* a_pMaterial)
+{
+	auto it = m_htMaterialIds.find(a_pMaterial);
+	if (it != m_htMaterialIds.end())
+		return it->second;
+
+	// there are few shader programs, so looking through them beats hashing the pair
+	std::pair<SimpleVertexShader*, SimplePixelShader*> shaders(a_pMaterial->GetVertexShader().get(), a_pMaterial->GetPixelShader().get());
+	uint32_t uShader = (uint32_t)(std::find(m_vShaders.begin(), m_vShaders.end(), shaders) - m_vShaders.begin());
+	if (uShader == m_vShaders.size())
+		m_vShaders.push_back(shaders);
+	m_vMaterialShaders.push_back(uShader);
+
+	m_vMaterials.push_back(a_pMaterial);
+	return m_htMaterialIds[a_pMaterial] = (uint32_t)m_vMaterials.size() - 1;
+}
+
+#pragma region Getters
+/// <summary>
+/// Gets the packets, in the order the list was built
+/// </summary>
+const std::vector<DrawPacket>& RenderList::GetPackets() const
+{
+	return m_vPackets;
+}
+/// <summary>
+/// Gets the packets' world-space boxes, box i belonging to packet i
+/// </summary>
+const BoundingBoxList& RenderList::GetBounds() const
+{
+	return m_Bounds;
+}
+/// <summary>
+/// Gets a mesh by its index in this list
+/// </summary>
+Mesh* RenderList::GetMesh(uint32_t a_uMesh) const
+{
+	return m_vMeshes[a_uMesh];
+}
+/// <summary>
+/// Gets a material by its index in this list
+/// </summary>
+Material* RenderList::GetMaterial(uint32_t a_uMaterial) const
+{
+	return m_vMaterials[a_uMaterial];
+}
+/// <summary>
+/// Gets a world matrix by its index in this list
+/// </summary>
+const DirectX::XMFLOAT4X4& RenderList::GetWorldMatrix(uint32_t a_uWorld) const
+{
+	return m_vWorld[a_uWorld];
+}
+/// <summary>
+/// Gets the normal matrix that goes with a world matrix (only its upper 3x3 is filled in)
+/// </summary>
+const DirectX::XMFLOAT4X4& RenderList::GetWorldInverseTransposeMatrix(uint32_t a_uWorld) const
+{
+	return m_vWorldInverseTranspose[a_uWorld];
+}
+/// <summary>
+/// Gets how many distinct vertex and pixel shader pairs the packets' materials use
+/// </summary>
+uint32_t RenderList::GetShaderCount() const
+{
+	return (uint32_t)m_vShaders.size();
+}
+/// <summary>
+/// Gets how many distinct meshes the packets use
+/// </summary>
+uint32_t RenderList::GetMeshCount() const
+{
+	return (uint32_t)m_vMeshes.size();
+}
+/// <summary>
+/// Gets how many distinct materials the packets use
+/// </summary>
+uint32_t RenderList::GetMaterialCount() const
+{
+	return (uint32_t)m_vMaterials.size();
+}
+/// <summary>
+/// Gets how long the last Build() took on the CPU
+/// </summary>
+double RenderList::GetBuildMilliseconds() const
+{
+	return m_dBuildMilliseconds;
+}
+#pragma endregion
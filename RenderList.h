@@ -0,0 +1,86 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DrawSort.h"
+#include "Entity.h"
+#include "EntityWorld.h"
+#include "FrustumCulling.h"
+#include "InstanceBuffer.h"
+
+// --------------------------------------------------------
+// Everything a pass needs to draw one entity, as plain data.
+// The mesh, material and matrices are indices into the
+// RenderList the packet belongs to.
+// --------------------------------------------------------
+struct DrawPacket
+{
+	uint64_t SortKey;			// opaque-pass draw key of the packet's state, without level of detail and depth (see DrawSort.h)
+	uint32_t Shader;			// index into the list's shader programs
+	uint32_t Mesh;				// index into the list's meshes
+	uint32_t Material;			// index into the list's materials
+	uint32_t World;				// index into the list's world matrices
+	uint32_t Entity;			// id in the EntityWorld the packet was built from
+	DirectX::XMFLOAT3 Center;	// world-space box around the mesh
+	DirectX::XMFLOAT3 Extent;
+};
+
+// --------------------------------------------------------
+// A run of a pass's sorted packets that bind the same state
+// and geometry. Instanced runs are one draw of the instances
+// at FirstInstance in the instance buffer; the others draw
+// their packets one at a time.
+// --------------------------------------------------------
+struct DrawBatch
+{
+	uint32_t First;			// position of the first packet in the pass's draw order
+	uint32_t Count;
+	uint32_t FirstInstance;
+	bool Instanced;
+};
+
+// --------------------------------------------------------
+// Every drawn entity of a world, gathered once a frame after
+// the update into a flat array of draw packets, the world
+// matrices they point at, the distinct meshes and materials
+// they use (and the shader programs of those materials), and their boxes for the culler (box i belongs to
+// packet i). The shadow passes and the main pass all read
+// the same list by const reference.
+// --------------------------------------------------------
+class RenderList
+{
+public:
+	void Build(EntityWorld& a_World);
+	uint32_t BatchInstances(const std::vector<uint64_t>& a_vKeys, const std::vector<uint32_t>& a_vOrder, std::vector<DrawBatch>& a_vBatches) const;
+
+	// getters
+	const std::vector<DrawPacket>& GetPackets() const;
+	const BoundingBoxList& GetBounds() const;
+	Mesh* GetMesh(uint32_t a_uMesh) const;
+	Material* GetMaterial(uint32_t a_uMaterial) const;
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(uint32_t a_uWorld) const;
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(uint32_t a_uWorld) const;
+	uint32_t GetShaderCount() const;
+	uint32_t GetMeshCount() const;
+	uint32_t GetMaterialCount() const;
+	double GetBuildMilliseconds() const;
+
+private:
+	std::vector<DrawPacket> m_vPackets;
+	BoundingBoxList m_Bounds;
+	std::vector<DirectX::XMFLOAT4X4> m_vWorld;
+	std::vector<DirectX::XMFLOAT4X4> m_vWorldInverseTranspose;
+	std::vector<Mesh*> m_vMeshes;
+	std::vector<Material*> m_vMaterials;
+	std::unordered_map<Mesh*, uint32_t> m_htMeshIds; //index of each mesh in m_vMeshes
+	std::unordered_map<Material*, uint32_t> m_htMaterialIds; //index of each material in m_vMaterials
+	std::vector<uint32_t> m_vMaterialShaders; //shader program of each material
+	std::vector<std::pair<SimpleVertexShader*, SimplePixelShader*>> m_vShaders; //distinct vertex and pixel shader pairs
+	double m_dBuildMilliseconds = 0.0;
+
+	uint32_t MeshId(Mesh* a_pMesh);
+	uint32_t MaterialId(Material* a_pMaterial);
+};
@@ -0,0 +1,457 @@
+#include "RenderStateCache.h"
+#include <cstdint>
+#include <random>
+
+namespace
+{
+	// stands for "anything could be bound", so the next call goes through whatever it binds
+	const void* const UNKNOWN = reinterpret_cast<const void*>(~(uintptr_t)0);
+
+	// D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, DXGI_FORMAT_R16_UINT and DXGI_FORMAT_R32_UINT, for the check
+	const unsigned int TOPOLOGY_TRIANGLELIST = 4;
+	const unsigned int FORMAT_R16_UINT = 57;
+	const unsigned int FORMAT_R32_UINT = 42;
+
+	/// <summary>
+	/// Makes a distinct, never dereferenced pointer to stand in for a D3D object
+	/// </summary>
+	template<typename T> T* Fake(unsigned int a_uId)
+	{
+		return reinterpret_cast<T*>((uintptr_t)(a_uId + 1) * 64);
+	}
+}
+
+RenderStateCache::RenderStateCache(std::shared_ptr<IRenderContext> a_spContext)
+{
+	m_spContext = a_spContext;
+	Invalidate();
+}
+
+/// <summary>
+/// Counts a call, returning whether it has to be passed on
+/// </summary>
+/// <param name="a_bRedundant">Whether the call binds what is already bound</param>
+/// <param name="a_uKind">RENDER_STATE_CALL_ kind of the call</param>
+bool RenderStateCache::Filter(bool a_bRedundant, unsigned int a_uKind)
+{
+	if (a_bRedundant)
+	{
+		m_Stats.Skipped[a_uKind]++;
+		return false;
+	}
+	m_Stats.Issued[a_uKind]++;
+	return true;
+}
+
+bool RenderStateCache::SetInputLayout(ID3D11InputLayout* a_pInputLayout)
+{
+	if (!Filter(m_pInputLayout == a_pInputLayout, RENDER_STATE_CALL_SHADER))
+		return false;
+	m_spContext->SetInputLayout(a_pInputLayout);
+	m_pInputLayout = a_pInputLayout;
+	return true;
+}
+
+bool RenderStateCache::SetPrimitiveTopology(unsigned int a_uTopology)
+{
+	if (!Filter(m_nTopology == (int)a_uTopology, RENDER_STATE_CALL_INPUT_ASSEMBLER))
+		return false;
+	m_spContext->SetPrimitiveTopology(a_uTopology);
+	m_nTopology = (int)a_uTopology;
+	return true;
+}
+
+bool RenderStateCache::SetVertexBuffer(unsigned int a_uSlot, ID3D11Buffer* a_pBuffer, unsigned int a_uStride, unsigned int a_uOffset)
+{
+	if (!Filter(m_pVertexBuffers[a_uSlot] == a_pBuffer && m_uVertexStrides[a_uSlot] == a_uStride && m_uVertexOffsets[a_uSlot] == a_uOffset,
+		RENDER_STATE_CALL_INPUT_ASSEMBLER))
+		return false;
+	m_spContext->SetVertexBuffer(a_uSlot, a_pBuffer, a_uStride, a_uOffset);
+	m_pVertexBuffers[a_uSlot] = a_pBuffer;
+	m_uVertexStrides[a_uSlot] = a_uStride;
+	m_uVertexOffsets[a_uSlot] = a_uOffset;
+	return true;
+}
+
+bool RenderStateCache::SetIndexBuffer(ID3D11Buffer* a_pBuffer, unsigned int a_uFormat, unsigned int a_uOffset)
+{
+	if (!Filter(m_pIndexBuffer == a_pBuffer && m_nIndexFormat == (int)a_uFormat && m_uIndexOffset == a_uOffset, RENDER_STATE_CALL_INPUT_ASSEMBLER))
+		return false;
+	m_spContext->SetIndexBuffer(a_pBuffer, a_uFormat, a_uOffset);
+	m_pIndexBuffer = a_pBuffer;
+	m_nIndexFormat = (int)a_uFormat;
+	m_uIndexOffset = a_uOffset;
+	return true;
+}
+
+bool RenderStateCache::SetVertexShader(ID3D11VertexShader* a_pShader)
+{
+	if (!Filter(m_pVertexShader == a_pShader, RENDER_STATE_CALL_SHADER))
+		return false;
+	m_spContext->SetVertexShader(a_pShader);
+	m_pVertexShader = a_pShader;
+	return true;
+}
+
+bool RenderStateCache::SetPixelShader(ID3D11PixelShader* a_pShader)
+{
+	if (!Filter(m_pPixelShader == a_pShader, RENDER_STATE_CALL_SHADER))
+		return false;
+	m_spContext->SetPixelShader(a_pShader);
+	m_pPixelShader = a_pShader;
+	return true;
+}
+
+bool RenderStateCache::SetConstantBuffer(unsigned int a_uStage, unsigned int a_uSlot, ID3D11Buffer* a_pBuffer)
+{
+	if (!Filter(m_pConstantBuffers[a_uStage][a_uSlot] == a_pBuffer, RENDER_STATE_CALL_CONSTANT_BUFFER))
+		return false;
+	m_spContext->SetConstantBuffer(a_uStage, a_uSlot, a_pBuffer);
+	m_pConstantBuffers[a_uStage][a_uSlot] = a_pBuffer;
+	return true;
+}
+
+bool RenderStateCache::SetShaderResource(unsigned int a_uStage, unsigned int a_uSlot, ID3D11ShaderResourceView* a_pView)
+{
+	if (!Filter(m_pShaderResources[a_uStage][a_uSlot] == a_pView, RENDER_STATE_CALL_SHADER_RESOURCE))
+		return false;
+	m_spContext->SetShaderResource(a_uStage, a_uSlot, a_pView);
+	m_pShaderResources[a_uStage][a_uSlot] = a_pView;
+	return true;
+}
+
+/// <summary>
+/// Unbinds every shader resource of a stage with one call, unless none is bound
+/// </summary>
+bool RenderStateCache::ClearShaderResources(unsigned int a_uStage)
+{
+	bool bRedundant = true;
+	for (const void* pView : m_pShaderResources[a_uStage])
+		bRedundant &= pView == nullptr;
+	if (!Filter(bRedundant, RENDER_STATE_CALL_SHADER_RESOURCE))
+		return false;
+	m_spContext->ClearShaderResources(a_uStage);
+	for (const void*& pView : m_pShaderResources[a_uStage])
+		pView = nullptr;
+	return true;
+}
+
+bool RenderStateCache::SetSampler(unsigned int a_uStage, unsigned int a_uSlot, ID3D11SamplerState* a_pSampler)
+{
+	if (!Filter(m_pSamplers[a_uStage][a_uSlot] == a_pSampler, RENDER_STATE_CALL_SAMPLER))
+		return false;
+	m_spContext->SetSampler(a_uStage, a_uSlot, a_pSampler);
+	m_pSamplers[a_uStage][a_uSlot] = a_pSampler;
+	return true;
+}
+
+bool RenderStateCache::SetRasterizerState(ID3D11RasterizerState* a_pState)
+{
+	if (!Filter(m_pRasterizerState == a_pState, RENDER_STATE_CALL_FIXED_FUNCTION))
+		return false;
+	m_spContext->SetRasterizerState(a_pState);
+	m_pRasterizerState = a_pState;
+	return true;
+}
+
+bool RenderStateCache::SetDepthStencilState(ID3D11DepthStencilState* a_pState, unsigned int a_uStencilRef)
+{
+	if (!Filter(m_pDepthStencilState == a_pState && m_uStencilRef == a_uStencilRef, RENDER_STATE_CALL_FIXED_FUNCTION))
+		return false;
+	m_spContext->SetDepthStencilState(a_pState, a_uStencilRef);
+	m_pDepthStencilState = a_pState;
+	m_uStencilRef = a_uStencilRef;
+	return true;
+}
+
+/// <summary>
+/// Binds render targets, always. D3D unbinds any shader resource that views one of the new
+/// targets, so which shader resources are still bound is unknown afterwards.
+/// </summary>
+/// <param name="a_uCount">Number of render targets</param>
+/// <param name="a_ppTargets">Render targets</param>
+/// <param name="a_pDepth">Depth buffer, or null</param>
+void RenderStateCache::SetRenderTargets(unsigned int a_uCount, ID3D11RenderTargetView* const* a_ppTargets, ID3D11DepthStencilView* a_pDepth)
+{
+	m_spContext->SetRenderTargets(a_uCount, a_ppTargets, a_pDepth);
+	ForgetShaderResources();
+}
+
+void RenderStateCache::ForgetShaderResources()
+{
+	for (auto& stage : m_pShaderResources)
+		for (const void*& pView : stage)
+			pView = UNKNOWN;
+}
+
+/// <summary>
+/// Forgets everything, so the next call of each kind reaches the context
+/// </summary>
+void RenderStateCache::Invalidate()
+{
+	m_pInputLayout = UNKNOWN;
+	m_nTopology = -1;
+	for (unsigned int i = 0; i < RENDER_STATE_VERTEX_BUFFER_SLOTS; i++)
+	{
+		m_pVertexBuffers[i] = UNKNOWN;
+		m_uVertexStrides[i] = 0;
+		m_uVertexOffsets[i] = 0;
+	}
+	m_pIndexBuffer = UNKNOWN;
+	m_nIndexFormat = -1;
+	m_uIndexOffset = 0;
+	m_pVertexShader = UNKNOWN;
+	m_pPixelShader = UNKNOWN;
+	for (auto& stage : m_pConstantBuffers)
+		for (const void*& pBuffer : stage)
+			pBuffer = UNKNOWN;
+	ForgetShaderResources();
+	for (auto& stage : m_pSamplers)
+		for (const void*& pSampler : stage)
+			pSampler = UNKNOWN;
+	m_pRasterizerState = UNKNOWN;
+	m_pDepthStencilState = UNKNOWN;
+	m_uStencilRef = 0;
+}
+
+/// <summary>
+/// Closes the frame's call counts (see GetStats)
+/// </summary>
+void RenderStateCache::EndFrame()
+{
+	m_LastStats = m_Stats;
+	m_Stats = {};
+}
+
+#pragma region Getters
+/// <summary>
+/// Gets how many calls of each kind were issued and skipped last frame
+/// </summary>
+RenderStateStats RenderStateCache::GetStats()
+{
+	return m_LastStats;
+}
+#pragma endregion
+
+RecordingRenderContext::RecordingRenderContext()
+{
+	m_State = {};
+	m_State.Topology = -1;
+	m_State.IndexFormat = -1;
+}
+
+void RecordingRenderContext::SetInputLayout(ID3D11InputLayout* a_pInputLayout)
+{
+	m_State.InputLayout = a_pInputLayout;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetPrimitiveTopology(unsigned int a_uTopology)
+{
+	m_State.Topology = (int)a_uTopology;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetVertexBuffer(unsigned int a_uSlot, ID3D11Buffer* a_pBuffer, unsigned int a_uStride, unsigned int a_uOffset)
+{
+	m_State.VertexBuffers[a_uSlot] = a_pBuffer;
+	m_State.VertexStrides[a_uSlot] = a_uStride;
+	m_State.VertexOffsets[a_uSlot] = a_uOffset;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetIndexBuffer(ID3D11Buffer* a_pBuffer, unsigned int a_uFormat, unsigned int a_uOffset)
+{
+	m_State.IndexBuffer = a_pBuffer;
+	m_State.IndexFormat = (int)a_uFormat;
+	m_State.IndexOffset = a_uOffset;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetVertexShader(ID3D11VertexShader* a_pShader)
+{
+	m_State.VertexShader = a_pShader;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetPixelShader(ID3D11PixelShader* a_pShader)
+{
+	m_State.PixelShader = a_pShader;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetConstantBuffer(unsigned int a_uStage, unsigned int a_uSlot, ID3D11Buffer* a_pBuffer)
+{
+	m_State.ConstantBuffers[a_uStage][a_uSlot] = a_pBuffer;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetShaderResource(unsigned int a_uStage, unsigned int a_uSlot, ID3D11ShaderResourceView* a_pView)
+{
+	m_State.ShaderResources[a_uStage][a_uSlot] = a_pView;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::ClearShaderResources(unsigned int a_uStage)
+{
+	for (const void*& pView : m_State.ShaderResources[a_uStage])
+		pView = nullptr;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetSampler(unsigned int a_uStage, unsigned int a_uSlot, ID3D11SamplerState* a_pSampler)
+{
+	m_State.Samplers[a_uStage][a_uSlot] = a_pSampler;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetRasterizerState(ID3D11RasterizerState* a_pState)
+{
+	m_State.RasterizerState = a_pState;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetDepthStencilState(ID3D11DepthStencilState* a_pState, unsigned int a_uStencilRef)
+{
+	m_State.DepthStencilState = a_pState;
+	m_State.StencilRef = a_uStencilRef;
+	m_State.Calls++;
+}
+
+void RecordingRenderContext::SetRenderTargets(unsigned int, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*)
+{
+	for (auto& stage : m_State.ShaderResources)
+		for (const void*& pView : stage)
+			pView = nullptr;
+	m_State.Calls++;
+}
+
+#pragma region Getters
+/// <summary>
+/// Gets what is bound
+/// </summary>
+const RecordedRenderState& RecordingRenderContext::GetState() const
+{
+	return m_State;
+}
+#pragma endregion
+
+/// <summary>
+/// Plays frames shaped like the game's (a shadow pass, a main pass of draws with random materials, a sky and
+/// clearing the shader resources) through a cache over a recording context, and checks after every call that
+/// the context has what was asked for bound, whether or not the cache passed the call on
+/// </summary>
+/// <param name="a_uDraws">Number of draws, spread over a few frames</param>
+/// <param name="a_uSeed">Seed of the random materials</param>
+/// <returns>Calls made, issued and skipped, and how many left the context with the wrong state</returns>
+RenderStateCacheCheck VerifyRenderStateCache(unsigned int a_uDraws, unsigned int a_uSeed)
+{
+	// shader programs with their own layout and constant buffers, and materials with their own textures and a sampler
+	const unsigned int SHADERS = 4;
+	const unsigned int MATERIALS = 16;
+	const unsigned int TEXTURES = 3;
+	const unsigned int FRAMES = 8;
+	const unsigned int SHADOW_SHADER = SHADERS;
+
+	std::shared_ptr<RecordingRenderContext> spContext = std::make_shared<RecordingRenderContext>();
+	const RecordedRenderState& state = spContext->GetState();
+	RenderStateCache cache(spContext);
+	RenderStateCacheCheck check = {};
+	check.Draws = a_uDraws;
+	// compares after the call, which is why the bound state comes in by reference
+	auto Call = [&](bool a_bIssued, const auto& a_Bound, auto a_Expected)
+	{
+		check.Calls++;
+		check.Issued += a_bIssued;
+		check.Skipped += !a_bIssued;
+		check.Mismatches += !(a_Bound == a_Expected);
+	};
+	auto SetShaders = [&](unsigned int a_uShader, bool a_bPixelShader)
+	{
+		Call(cache.SetInputLayout(Fake<ID3D11InputLayout>(a_uShader)), state.InputLayout, Fake<ID3D11InputLayout>(a_uShader));
+		Call(cache.SetVertexShader(Fake<ID3D11VertexShader>(a_uShader)), state.VertexShader, Fake<ID3D11VertexShader>(a_uShader));
+		ID3D11PixelShader* pPixelShader = a_bPixelShader ? Fake<ID3D11PixelShader>(a_uShader) : nullptr;
+		Call(cache.SetPixelShader(pPixelShader), state.PixelShader, pPixelShader);
+		for (unsigned int uStage = 0; uStage < RENDER_STATE_STAGES; uStage++)
+			for (unsigned int uSlot = 0; uSlot < 2; uSlot++)
+			{
+				ID3D11Buffer* pBuffer = Fake<ID3D11Buffer>(a_uShader * 4 + uStage * 2 + uSlot);
+				Call(cache.SetConstantBuffer(uStage, uSlot, pBuffer), state.ConstantBuffers[uStage][uSlot], pBuffer);
+			}
+	};
+	auto SetBuffers = [&](unsigned int a_uIndexBuffer)
+	{
+		Call(cache.SetVertexBuffer(0, Fake<ID3D11Buffer>(1000), 16, 0), state.VertexBuffers[0], Fake<ID3D11Buffer>(1000));
+		check.Mismatches += state.VertexStrides[0] != 16;
+		unsigned int uFormat = a_uIndexBuffer ? FORMAT_R32_UINT : FORMAT_R16_UINT;
+		Call(cache.SetIndexBuffer(Fake<ID3D11Buffer>(1001 + a_uIndexBuffer), uFormat, 0), state.IndexBuffer, Fake<ID3D11Buffer>(1001 + a_uIndexBuffer));
+		check.Mismatches += state.IndexFormat != (int)uFormat;
+	};
+
+	std::mt19937 random(a_uSeed);
+	std::uniform_int_distribution<unsigned int> material(0, MATERIALS - 1);
+	unsigned int uDirectCalls = 0;
+	for (unsigned int uFrame = 0; uFrame < FRAMES; uFrame++)
+	{
+		unsigned int uDraws = a_uDraws / FRAMES + (uFrame < a_uDraws % FRAMES);
+		Call(cache.SetPrimitiveTopology(TOPOLOGY_TRIANGLELIST), state.Topology, (int)TOPOLOGY_TRIANGLELIST);
+
+		// shadow pass: one shader, no pixel shader, its own rasterizer state
+		cache.SetRenderTargets(0, nullptr, Fake<ID3D11DepthStencilView>(0));
+		Call(cache.SetRasterizerState(Fake<ID3D11RasterizerState>(0)), state.RasterizerState, Fake<ID3D11RasterizerState>(0));
+		for (unsigned int i = 0; i < uDraws; i++)
+		{
+			SetShaders(SHADOW_SHADER, false);
+			SetBuffers(random() % 8 == 0);
+		}
+		Call(cache.SetRasterizerState(nullptr), state.RasterizerState, nullptr);
+
+		// main pass: the material's shaders and textures, and the shadow map
+		ID3D11RenderTargetView* pTarget = Fake<ID3D11RenderTargetView>(0);
+		cache.SetRenderTargets(1, &pTarget, Fake<ID3D11DepthStencilView>(1));
+		for (unsigned int i = 0; i < uDraws; i++)
+		{
+			unsigned int uMaterial = material(random);
+			SetShaders(uMaterial % SHADERS, true);
+			for (unsigned int uSlot = 0; uSlot < TEXTURES; uSlot++)
+			{
+				ID3D11ShaderResourceView* pView = Fake<ID3D11ShaderResourceView>(uMaterial * TEXTURES + uSlot);
+				Call(cache.SetShaderResource(RENDER_STATE_STAGE_PIXEL, uSlot, pView), state.ShaderResources[RENDER_STATE_STAGE_PIXEL][uSlot], pView);
+			}
+			ID3D11ShaderResourceView* pShadowMap = Fake<ID3D11ShaderResourceView>(MATERIALS * TEXTURES);
+			Call(cache.SetShaderResource(RENDER_STATE_STAGE_PIXEL, TEXTURES, pShadowMap),
+				state.ShaderResources[RENDER_STATE_STAGE_PIXEL][TEXTURES], pShadowMap);
+			Call(cache.SetSampler(RENDER_STATE_STAGE_PIXEL, 0, Fake<ID3D11SamplerState>(uMaterial % 2)),
+				state.Samplers[RENDER_STATE_STAGE_PIXEL][0], Fake<ID3D11SamplerState>(uMaterial % 2));
+			Call(cache.SetSampler(RENDER_STATE_STAGE_PIXEL, 1, Fake<ID3D11SamplerState>(2)),
+				state.Samplers[RENDER_STATE_STAGE_PIXEL][1], Fake<ID3D11SamplerState>(2));
+			SetBuffers(random() % 8 == 0);
+		}
+
+		// sky: sets and resets its states
+		Call(cache.SetRasterizerState(Fake<ID3D11RasterizerState>(1)), state.RasterizerState, Fake<ID3D11RasterizerState>(1));
+		Call(cache.SetDepthStencilState(Fake<ID3D11DepthStencilState>(0), 0), state.DepthStencilState, Fake<ID3D11DepthStencilState>(0));
+		Call(cache.SetRasterizerState(nullptr), state.RasterizerState, nullptr);
+		Call(cache.SetDepthStencilState(nullptr, 0), state.DepthStencilState, nullptr);
+
+		// end of the frame; every other frame leaves its shader resources bound into the next shadow pass
+		if (uFrame % 2 == 0)
+			Call(cache.ClearShaderResources(RENDER_STATE_STAGE_PIXEL), state.ShaderResources[RENDER_STATE_STAGE_PIXEL][0], nullptr);
+		cache.EndFrame();
+
+		// something uses the context directly now and then, and says so
+		if (uFrame % 3 == 2)
+		{
+			spContext->SetPixelShader(nullptr);
+			spContext->SetRasterizerState(Fake<ID3D11RasterizerState>(2));
+			spContext->SetShaderResource(RENDER_STATE_STAGE_PIXEL, TEXTURES, nullptr);
+			uDirectCalls += 3;
+			cache.Invalidate();
+		}
+	}
+
+	// the context saw exactly the issued calls, the render target changes and the direct calls
+	if (state.Calls != check.Issued + FRAMES * 2 + uDirectCalls)
+		check.Mismatches++;
+	return check;
+}
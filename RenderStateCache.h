@@ -0,0 +1,205 @@
+#pragma once
+
+#include <memory>
+
+// The Direct3D 11 objects the cache binds. Only pointers to them pass through it, so they
+// are declared here instead of including d3d11.h, which keeps the cache buildable (and its
+// check runnable) without the Windows SDK
+struct ID3D11Buffer;
+struct ID3D11DepthStencilState;
+struct ID3D11DepthStencilView;
+struct ID3D11InputLayout;
+struct ID3D11PixelShader;
+struct ID3D11RasterizerState;
+struct ID3D11RenderTargetView;
+struct ID3D11SamplerState;
+struct ID3D11ShaderResourceView;
+struct ID3D11VertexShader;
+
+// Shader stages whose bindings the cache tracks
+#define RENDER_STATE_STAGE_VERTEX	0
+#define RENDER_STATE_STAGE_PIXEL	1
+#define RENDER_STATE_STAGES			2
+
+// Slots tracked in each stage, as many as Direct3D 11 has (Graphics.cpp checks them against d3d11.h)
+#define RENDER_STATE_CONSTANT_BUFFER_SLOTS	14	// D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT
+#define RENDER_STATE_SHADER_RESOURCE_SLOTS	128	// D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT
+#define RENDER_STATE_SAMPLER_SLOTS			16	// D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT
+#define RENDER_STATE_VERTEX_BUFFER_SLOTS	32	// D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT
+
+// Kinds of calls the statistics are kept for
+#define RENDER_STATE_CALL_SHADER			0	// shaders and the input layout
+#define RENDER_STATE_CALL_CONSTANT_BUFFER	1
+#define RENDER_STATE_CALL_SHADER_RESOURCE	2
+#define RENDER_STATE_CALL_SAMPLER			3
+#define RENDER_STATE_CALL_INPUT_ASSEMBLER	4	// vertex and index buffers and the topology
+#define RENDER_STATE_CALL_FIXED_FUNCTION	5	// rasterizer and depth-stencil states
+#define RENDER_STATE_CALL_KINDS				6
+
+// --------------------------------------------------------
+// The calls of a device context the cache filters. Graphics
+// implements it over the immediate context; the recording
+// context below stands in for it where there is no device.
+// Topologies are D3D11_PRIMITIVE_TOPOLOGY values and index
+// formats DXGI_FORMAT values.
+// --------------------------------------------------------
+class IRenderContext
+{
+public:
+	virtual ~IRenderContext() = default;
+
+	virtual void SetInputLayout(ID3D11InputLayout* a_pInputLayout) = 0;
+	virtual void SetPrimitiveTopology(unsigned int a_uTopology) = 0;
+	virtual void SetVertexBuffer(unsigned int a_uSlot, ID3D11Buffer* a_pBuffer, unsigned int a_uStride, unsigned int a_uOffset) = 0;
+	virtual void SetIndexBuffer(ID3D11Buffer* a_pBuffer, unsigned int a_uFormat, unsigned int a_uOffset) = 0;
+	virtual void SetVertexShader(ID3D11VertexShader* a_pShader) = 0;
+	virtual void SetPixelShader(ID3D11PixelShader* a_pShader) = 0;
+	virtual void SetConstantBuffer(unsigned int a_uStage, unsigned int a_uSlot, ID3D11Buffer* a_pBuffer) = 0;
+	virtual void SetShaderResource(unsigned int a_uStage, unsigned int a_uSlot, ID3D11ShaderResourceView* a_pView) = 0;
+	virtual void ClearShaderResources(unsigned int a_uStage) = 0;
+	virtual void SetSampler(unsigned int a_uStage, unsigned int a_uSlot, ID3D11SamplerState* a_pSampler) = 0;
+	virtual void SetRasterizerState(ID3D11RasterizerState* a_pState) = 0;
+	virtual void SetDepthStencilState(ID3D11DepthStencilState* a_pState, unsigned int a_uStencilRef) = 0;
+	virtual void SetRenderTargets(unsigned int a_uCount, ID3D11RenderTargetView* const* a_ppTargets, ID3D11DepthStencilView* a_pDepth) = 0;
+};
+
+// --------------------------------------------------------
+// Calls of each kind the cache passed on to the context
+// and dropped because they wouldn't have changed anything
+// --------------------------------------------------------
+struct RenderStateStats
+{
+	unsigned int Issued[RENDER_STATE_CALL_KINDS];
+	unsigned int Skipped[RENDER_STATE_CALL_KINDS];
+};
+
+// --------------------------------------------------------
+// What a recording context was left bound with
+// --------------------------------------------------------
+struct RecordedRenderState
+{
+	const void* InputLayout;
+	int Topology;
+	const void* VertexBuffers[RENDER_STATE_VERTEX_BUFFER_SLOTS];
+	unsigned int VertexStrides[RENDER_STATE_VERTEX_BUFFER_SLOTS];
+	unsigned int VertexOffsets[RENDER_STATE_VERTEX_BUFFER_SLOTS];
+	const void* IndexBuffer;
+	int IndexFormat;
+	unsigned int IndexOffset;
+	const void* VertexShader;
+	const void* PixelShader;
+	const void* ConstantBuffers[RENDER_STATE_STAGES][RENDER_STATE_CONSTANT_BUFFER_SLOTS];
+	const void* ShaderResources[RENDER_STATE_STAGES][RENDER_STATE_SHADER_RESOURCE_SLOTS];
+	const void* Samplers[RENDER_STATE_STAGES][RENDER_STATE_SAMPLER_SLOTS];
+	const void* RasterizerState;
+	const void* DepthStencilState;
+	unsigned int StencilRef;
+	unsigned int Calls;
+};
+
+// --------------------------------------------------------
+// Result of VerifyRenderStateCache
+// --------------------------------------------------------
+struct RenderStateCacheCheck
+{
+	unsigned int Draws;
+	unsigned int Calls;			// calls made to the cache
+	unsigned int Issued;		// calls that reached the context
+	unsigned int Skipped;
+	unsigned int Mismatches;	// times the context's state differed from what was asked for
+};
+
+// --------------------------------------------------------
+// Keeps a copy of what is bound to a context and drops the
+// calls that would bind it again. Each setter returns
+// whether the call reached the context. Code that changes
+// the context behind the cache's back has to Invalidate()
+// it afterwards.
+// --------------------------------------------------------
+class RenderStateCache
+{
+public:
+	RenderStateCache(std::shared_ptr<IRenderContext> a_spContext);
+
+	bool SetInputLayout(ID3D11InputLayout* a_pInputLayout);
+	bool SetPrimitiveTopology(unsigned int a_uTopology);
+	bool SetVertexBuffer(unsigned int a_uSlot, ID3D11Buffer* a_pBuffer, unsigned int a_uStride, unsigned int a_uOffset);
+	bool SetIndexBuffer(ID3D11Buffer* a_pBuffer, unsigned int a_uFormat, unsigned int a_uOffset);
+	bool SetVertexShader(ID3D11VertexShader* a_pShader);
+	bool SetPixelShader(ID3D11PixelShader* a_pShader);
+	bool SetConstantBuffer(unsigned int a_uStage, unsigned int a_uSlot, ID3D11Buffer* a_pBuffer);
+	bool SetShaderResource(unsigned int a_uStage, unsigned int a_uSlot, ID3D11ShaderResourceView* a_pView);
+	bool ClearShaderResources(unsigned int a_uStage);
+	bool SetSampler(unsigned int a_uStage, unsigned int a_uSlot, ID3D11SamplerState* a_pSampler);
+	bool SetRasterizerState(ID3D11RasterizerState* a_pState);
+	bool SetDepthStencilState(ID3D11DepthStencilState* a_pState, unsigned int a_uStencilRef);
+	void SetRenderTargets(unsigned int a_uCount, ID3D11RenderTargetView* const* a_ppTargets, ID3D11DepthStencilView* a_pDepth);
+
+	void Invalidate();
+	void EndFrame();
+
+	// Getters
+	RenderStateStats GetStats();
+
+private:
+	std::shared_ptr<IRenderContext> m_spContext;
+
+	// what the context has bound; UNKNOWN (see the .cpp) where it can't be known
+	const void* m_pInputLayout;
+	int m_nTopology;
+	const void* m_pVertexBuffers[RENDER_STATE_VERTEX_BUFFER_SLOTS];
+	unsigned int m_uVertexStrides[RENDER_STATE_VERTEX_BUFFER_SLOTS];
+	unsigned int m_uVertexOffsets[RENDER_STATE_VERTEX_BUFFER_SLOTS];
+	const void* m_pIndexBuffer;
+	int m_nIndexFormat;
+	unsigned int m_uIndexOffset;
+	const void* m_pVertexShader;
+	const void* m_pPixelShader;
+	const void* m_pConstantBuffers[RENDER_STATE_STAGES][RENDER_STATE_CONSTANT_BUFFER_SLOTS];
+	const void* m_pShaderResources[RENDER_STATE_STAGES][RENDER_STATE_SHADER_RESOURCE_SLOTS];
+	const void* m_pSamplers[RENDER_STATE_STAGES][RENDER_STATE_SAMPLER_SLOTS];
+	const void* m_pRasterizerState;
+	const void* m_pDepthStencilState;
+	unsigned int m_uStencilRef;
+
+	RenderStateStats m_Stats = {}; //this frame's calls
+	RenderStateStats m_LastStats = {}; //last frame's
+
+	bool Filter(bool a_bRedundant, unsigned int a_uKind);
+	void ForgetShaderResources();
+};
+
+// --------------------------------------------------------
+// A context that only remembers what it was told to bind,
+// the way a device context would. SetRenderTargets unbinds
+// every shader resource, since a recording can't tell which
+// of them alias the targets (D3D unbinds those).
+// --------------------------------------------------------
+class RecordingRenderContext : public IRenderContext
+{
+public:
+	RecordingRenderContext();
+
+	void SetInputLayout(ID3D11InputLayout* a_pInputLayout) override;
+	void SetPrimitiveTopology(unsigned int a_uTopology) override;
+	void SetVertexBuffer(unsigned int a_uSlot, ID3D11Buffer* a_pBuffer, unsigned int a_uStride, unsigned int a_uOffset) override;
+	void SetIndexBuffer(ID3D11Buffer* a_pBuffer, unsigned int a_uFormat, unsigned int a_uOffset) override;
+	void SetVertexShader(ID3D11VertexShader* a_pShader) override;
+	void SetPixelShader(ID3D11PixelShader* a_pShader) override;
+	void SetConstantBuffer(unsigned int a_uStage, unsigned int a_uSlot, ID3D11Buffer* a_pBuffer) override;
+	void SetShaderResource(unsigned int a_uStage, unsigned int a_uSlot, ID3D11ShaderResourceView* a_pView) override;
+	void ClearShaderResources(unsigned int a_uStage) override;
+	void SetSampler(unsigned int a_uStage, unsigned int a_uSlot, ID3D11SamplerState* a_pSampler) override;
+	void SetRasterizerState(ID3D11RasterizerState* a_pState) override;
+	void SetDepthStencilState(ID3D11DepthStencilState* a_pState, unsigned int a_uStencilRef) override;
+	void SetRenderTargets(unsigned int, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*) override;
+
+	// Getters
+	const RecordedRenderState& GetState() const;
+
+private:
+	RecordedRenderState m_State;
+};
+
+// Plays a_uDraws random draws through a cache over a recording context, checking the context after every call
+RenderStateCacheCheck VerifyRenderStateCache(unsigned int a_uDraws, unsigned int a_uSeed = 1);
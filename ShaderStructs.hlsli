@@ -7,6 +7,9 @@
 
 #define MAX_SPECULAR_EXPONENT 256.0f
 
+// Meshes upload compressed verticies (must match PACKED_VERTICES in Vertex.h)
+#define PACKED_VERTICES 1
+
 
 
 // struct that holds data passed from the vertex shader to the pixel shader
@@ -15,7 +18,7 @@ struct VertexToPixel
     float4 screenPosition   : SV_POSITION;
     float2 uv               : TEXCOORD;
     float3 normal           : NORMAL;
-    float3 tangent          : TANGENT;
+    float4 tangent          : TANGENT; // xyz = tangent, w = bitangent handedness
     float3 worldPosition    : POSITION;
     float4 shadowMapPositions[5] : SHADOW_POSITION;
 };
@@ -37,9 +40,73 @@ struct VertexShaderInput
     float3 localPosition    : POSITION; // XYZ position
     float2 uv               : TEXCOORD; // texture coordinates
     float3 normal           : NORMAL; // normal vector
-    float3 tangent          : TANGENT;
+    float4 tangent          : TANGENT; // xyz = tangent, w = bitangent handedness (+1 or -1)
+};
+
+// Compressed vertex as uploaded by meshes when PACKED_VERTICES is on (see PackedVertex in Vertex.h)
+struct VertexShaderInputPacked
+{
+    float4 localPosition    : POSITION; // XYZ quantized to [0,1] inside the mesh bounds, W = tangent sign
+    float2 uv               : TEXCOORD; // texture coordinates
+    float2 normal           : NORMAL; // octahedral-encoded normal
+    float2 tangent          : TANGENT; // octahedral-encoded tangent
 };
 
+// Turns an octahedral-encoded direction back into a unit vector
+float3 OctahedralDecode(float2 encoded)
+{
+    float3 n = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    if (n.z < 0)
+        n.xy = (1.0f - abs(n.yx)) * float2(n.x >= 0 ? 1.0f : -1.0f, n.y >= 0 ? 1.0f : -1.0f);
+    return normalize(n);
+}
+
+// Expands a packed vertex using the mesh's quantization range
+VertexShaderInput UnpackVertex(VertexShaderInputPacked packed, float3 positionOffset, float3 positionScale)
+{
+    VertexShaderInput input;
+    input.localPosition = positionOffset + packed.localPosition.xyz * positionScale;
+    input.uv = packed.uv;
+    input.normal = OctahedralDecode(packed.normal);
+    input.tangent = float4(OctahedralDecode(packed.tangent), packed.localPosition.w * 2.0f - 1.0f);
+    return input;
+}
+
+// Vertex shaders that draw meshes take MESH_VERTEX_INPUT and call UNPACK_VERTEX on it
+// (their constant buffer needs positionOffset and positionScale)
+#if PACKED_VERTICES
+#define MESH_VERTEX_INPUT VertexShaderInputPacked
+#define UNPACK_VERTEX(v) UnpackVertex(v, positionOffset, positionScale)
+#else
+#define MESH_VERTEX_INPUT VertexShaderInput
+#define UNPACK_VERTEX(v) (v)
+#endif
+
+// Per-instance data of instanced draws, from vertex buffer slot 1 (see InstanceData in InstanceBuffer.h).
+// The rows are those of the C++ matrices, so they come out transposed from how constant buffers hold them.
+struct InstanceInput
+{
+    float4 world0               : WORLD_PER_INSTANCE0;
+    float4 world1               : WORLD_PER_INSTANCE1;
+    float4 world2               : WORLD_PER_INSTANCE2;
+    float4 world3               : WORLD_PER_INSTANCE3;
+    float3 worldInvTranspose0   : WORLD_INV_TRANSPOSE_PER_INSTANCE0;
+    float3 worldInvTranspose1   : WORLD_INV_TRANSPOSE_PER_INSTANCE1;
+    float3 worldInvTranspose2   : WORLD_INV_TRANSPOSE_PER_INSTANCE2;
+};
+
+// The instance's world matrix, laid out like a constant buffer's
+matrix InstanceWorld(InstanceInput instance)
+{
+    return transpose(float4x4(instance.world0, instance.world1, instance.world2, instance.world3));
+}
+
+// The instance's normal matrix, laid out like a constant buffer's
+float3x3 InstanceWorldInvTranspose(InstanceInput instance)
+{
+    return transpose(float3x3(instance.worldInvTranspose0, instance.worldInvTranspose1, instance.worldInvTranspose2));
+}
+
 struct Light
 {
     int Type;               // Which kind of light? 0, 1 or 2 (see above)
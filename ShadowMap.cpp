@@ -2,13 +2,17 @@
 #include <DirectXMath.h>
 #include "Window.h"
 #include "Graphics.h"
+#include "GeometryPool.h"
+#include "InstanceBuffer.h"
 
 using namespace DirectX;
 
-ShadowMap::ShadowMap(std::shared_ptr<Light> a_spLight, std::shared_ptr<SimpleVertexShader> a_spShadowVertexShader, int a_nResolution, float a_fProjectionSize, float a_fNearPlaneDistance, float a_fFarPlaneDistance, float a_fBackupDistance)
+ShadowMap::ShadowMap(std::shared_ptr<Light> a_spLight, std::shared_ptr<SimpleVertexShader> a_spShadowVertexShader, std::shared_ptr<SimpleVertexShader> a_spInstancedShadowVertexShader, int a_nResolution, float a_fProjectionSize, float a_fNearPlaneDistance, float a_fFarPlaneDistance, float a_fBackupDistance)
 {
 	m_nResolution = a_nResolution;
+	m_CullStats = {};
 	m_spShadowVertexShader = a_spShadowVertexShader;
+	m_spInstancedShadowVertexShader = a_spInstancedShadowVertexShader;
 
 	// Create the actual texture that will be the shadow map
 	D3D11_TEXTURE2D_DESC tdShadowDesc = {};
@@ -81,13 +85,52 @@ ShadowMap::ShadowMap(std::shared_ptr<Light> a_spLight, std::shared_ptr<SimpleVer
 	*/
 }
 
-void ShadowMap::Draw(std::vector<Entity> a_vEntities, Microsoft::WRL::ComPtr<ID3D11RasterizerState> a_cpShadowRasterizer)
+/// <summary>
+/// Works out what the shadow map draws, and in which order, without touching the device context,
+/// so it can run as a job next to the other views. Draw() then submits it.
+/// </summary>
+/// <param name="a_RenderList">This frame's render list, which must not change until Draw()</param>
+void ShadowMap::Prepare(const RenderList& a_RenderList)
+{
+	// skip entities outside the light's box (nothing outside it is rendered into the map anyway)
+	DirectX::XMFLOAT4X4 m4ViewProjection;
+	DirectX::XMStoreFloat4x4(&m4ViewProjection, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&m_m4View), DirectX::XMLoadFloat4x4(&m_m4Projection)));
+	float planes[6][4];
+	ExtractFrustumPlanes(planes, &m4ViewProjection._11);
+	const std::vector<DrawPacket>& vPackets = a_RenderList.GetPackets();
+	m_vVisible.resize(vPackets.size());
+	m_CullStats = CullBoundingBoxes(m_vVisible.data(), a_RenderList.GetBounds(), planes);
+
+	// sort the visible packets by mesh and by the level of detail picked from their size in the shadow map,
+	// so the packets of each mesh and level can be drawn as the instances of one draw
+	m_vDrawKeys.clear();
+	m_vDrawOrder.clear();
+	for (uint32_t i = 0; i < (uint32_t)vPackets.size(); i++)
+	{
+		if (!m_vVisible[i])
+			continue;
+		unsigned int uLod = a_RenderList.GetMesh(vPackets[i].Mesh)->SelectLod(a_RenderList.GetWorldMatrix(vPackets[i].World), m_m4View, m_m4Projection,
+			(float)m_nResolution, LOD_MAX_PIXEL_ERROR * SHADOW_LOD_BIAS);
+		m_vDrawKeys.push_back(MakeDrawKey(DRAW_PASS_SHADOW, 0, 0, vPackets[i].Mesh, uLod, 0));
+		m_vDrawOrder.push_back(i);
+	}
+	m_DrawSorter.Sort(m_vDrawKeys, m_vDrawOrder);
+}
+
+/// <summary>
+/// Draws what Prepare() picked into the shadow map. Runs on the thread that owns the device context.
+/// </summary>
+/// <param name="a_RenderList">The render list Prepare() was given</param>
+/// <param name="a_cpShadowRasterizer">Rasterizer state with the depth bias</param>
+void ShadowMap::Draw(const RenderList& a_RenderList, Microsoft::WRL::ComPtr<ID3D11RasterizerState> a_cpShadowRasterizer)
 {
+	const std::vector<DrawPacket>& vPackets = a_RenderList.GetPackets();
+
 	// set the render target's depth buffer to the shadow map
 	Graphics::Context->ClearDepthStencilView(m_cpDepthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0); // reset depth values to 1.0
 	ID3D11RenderTargetView* nullRTV{};
-	Graphics::Context->OMSetRenderTargets(1, &nullRTV, m_cpDepthStencilView.Get()); // set the shadow map as the depth buffer and unbind the back buffer
-	Graphics::Context->PSSetShader(0, 0, 0); // unbind the pixel shader
+	Graphics::State->SetRenderTargets(1, &nullRTV, m_cpDepthStencilView.Get()); // set the shadow map as the depth buffer and unbind the back buffer
+	Graphics::State->SetPixelShader(nullptr); // unbind the pixel shader
 
 	// create a viewport that matches the shadow map's resolution
 	D3D11_VIEWPORT viewport = {};
@@ -97,31 +140,57 @@ void ShadowMap::Draw(std::vector<Entity> a_vEntities, Microsoft::WRL::ComPtr<ID3
 	Graphics::Context->RSSetViewports(1, &viewport);
 
 	//enable the specialized rasterizer state for depth biasing
-	Graphics::Context->RSSetState(a_cpShadowRasterizer.Get());
+	Graphics::State->SetRasterizerState(a_cpShadowRasterizer.Get());
 
-	// loop through the entities and draw them using the specialized shader
-	m_spShadowVertexShader->SetShader();
+	// loop through the entities and draw them using the specialized shaders
 	m_spShadowVertexShader->SetMatrix4x4("view", m_m4View);
 	m_spShadowVertexShader->SetMatrix4x4("projection", m_m4Projection);
+	m_spInstancedShadowVertexShader->SetMatrix4x4("view", m_m4View);
+	m_spInstancedShadowVertexShader->SetMatrix4x4("projection", m_m4Projection);
+	// every mesh draws from the geometry pool's buffers, which are set once for the pass
+	GeometryPool::Bind();
+
+	// the instances are written here, since mapping the buffer needs the context
+	a_RenderList.BatchInstances(m_vDrawKeys, m_vDrawOrder, m_vDrawBatches);
+	InstanceBuffer::Bind();
+
 	// Loop and draw all entities
-	for (auto& e : a_vEntities)
+	m_vLodDrawCounts.assign(MESH_MAX_LODS, 0);
+	for (const DrawBatch& batch : m_vDrawBatches)
 	{
-		m_spShadowVertexShader->SetMatrix4x4("world", e.GetTransform()->GetWorldMatrix());
-		m_spShadowVertexShader->CopyAllBufferData();
-		// Draw the mesh directly to avoid the entity's material
-		// Note: Your code may differ significantly here!
-		e.GetMesh()->Draw();
+		Mesh* pMesh = a_RenderList.GetMesh(vPackets[m_vDrawOrder[batch.First]].Mesh);
+		unsigned int uLod = GetDrawKeyLod(m_vDrawKeys[batch.First]);
+		m_vLodDrawCounts[uLod] += batch.Count;
+
+		// Draw the meshes directly to avoid the entities' materials
+		if (batch.Instanced)
+		{
+			m_spInstancedShadowVertexShader->SetShader();
+			pMesh->SetDecodeParameters(m_spInstancedShadowVertexShader);
+			m_spInstancedShadowVertexShader->CopyAllBufferData();
+			pMesh->DrawInstanced(uLod, batch.FirstInstance, batch.Count);
+			continue;
+		}
+
+		m_spShadowVertexShader->SetShader();
+		pMesh->SetDecodeParameters(m_spShadowVertexShader);
+		for (uint32_t i = batch.First; i < batch.First + batch.Count; i++)
+		{
+			m_spShadowVertexShader->SetMatrix4x4("world", a_RenderList.GetWorldMatrix(vPackets[m_vDrawOrder[i]].World));
+			m_spShadowVertexShader->CopyAllBufferData();
+			pMesh->Draw(uLod);
+		}
 	}
 
 	// reset the pipeline
 	viewport.Width = (float)Window::Width();
 	viewport.Height = (float)Window::Height();
 	Graphics::Context->RSSetViewports(1, &viewport);
-	Graphics::Context->OMSetRenderTargets(
+	Graphics::State->SetRenderTargets(
 		1,
 		Graphics::BackBufferRTV.GetAddressOf(),
 		Graphics::DepthBufferDSV.Get());
-	Graphics::Context->RSSetState(0);
+	Graphics::State->SetRasterizerState(nullptr);
 }
 
 #pragma region GETTERS
@@ -177,6 +246,22 @@ int ShadowMap::GetResolution()
 {
 	return m_nResolution;
 }
+/// <summary>
+/// Gets how many meshes were drawn at each level of detail the last time the shadow map was drawn
+/// </summary>
+/// <returns>Draw count per LOD (MESH_MAX_LODS entries)</returns>
+std::vector<unsigned int> ShadowMap::GetLodDrawCounts()
+{
+	return m_vLodDrawCounts;
+}
+/// <summary>
+/// Gets how many entities were inside and outside the light's box the last time the shadow map was drawn
+/// </summary>
+/// <returns>Cull counts</returns>
+FrustumCullStats ShadowMap::GetCullStats()
+{
+	return m_CullStats;
+}
 #pragma endregion
 
 
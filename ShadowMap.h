@@ -6,13 +6,19 @@
 #include <memory>
 #include "SimpleShader.h"
 #include "Entity.h"
+#include "RenderList.h"
+#include "FrustumCulling.h"
+
+// Shadow maps are blurred and only show silhouettes, so they may use coarser levels of detail
+#define SHADOW_LOD_BIAS 4.0f
 
 class ShadowMap
 {
 public:
-	ShadowMap(std::shared_ptr<Light> a_spLight, std::shared_ptr<SimpleVertexShader> a_spShadowVertexShader, int a_nResolution, float a_fProjectionSize, float a_fNearPlaneDistance, float a_fFarPlaneDistance, float a_fBackupDistance);
+	ShadowMap(std::shared_ptr<Light> a_spLight, std::shared_ptr<SimpleVertexShader> a_spShadowVertexShader, std::shared_ptr<SimpleVertexShader> a_spInstancedShadowVertexShader, int a_nResolution, float a_fProjectionSize, float a_fNearPlaneDistance, float a_fFarPlaneDistance, float a_fBackupDistance);
 
-	void Draw(std::vector<Entity> a_vEntities, Microsoft::WRL::ComPtr<ID3D11RasterizerState> a_cpShadowRasterizer);
+	void Prepare(const RenderList& a_RenderList);
+	void Draw(const RenderList& a_RenderList, Microsoft::WRL::ComPtr<ID3D11RasterizerState> a_cpShadowRasterizer);
 
 	// getters
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> GetDSV();
@@ -22,6 +28,8 @@ public:
 	DirectX::XMFLOAT4X4 GetViewMatrix();
 	DirectX::XMFLOAT4X4 GetProjectionMatrix();
 	int GetResolution();
+	std::vector<unsigned int> GetLodDrawCounts();
+	FrustumCullStats GetCullStats();
 
 private:
 	//std::shared_ptr<Light> m_spLight;
@@ -32,11 +40,19 @@ private:
 	//Microsoft::WRL::ComPtr<ID3D11SamplerState> m_cpSamplerState;
 
 	std::shared_ptr<SimpleVertexShader> m_spShadowVertexShader;
+	std::shared_ptr<SimpleVertexShader> m_spInstancedShadowVertexShader; //draws the runs of packets with the same mesh and level of detail
 
 	DirectX::XMFLOAT4X4 m_m4View;
 	DirectX::XMFLOAT4X4 m_m4Projection;
 
 	int m_nResolution;
+	std::vector<unsigned int> m_vLodDrawCounts; //how many meshes were drawn at each level of detail last time
+	std::vector<uint8_t> m_vVisible; //which draw packets were inside the light's box last time
+	std::vector<uint64_t> m_vDrawKeys; //keys of the visible packets, sorted by mesh and level of detail
+	std::vector<uint32_t> m_vDrawOrder; //the visible packets, in the order they're drawn
+	std::vector<DrawBatch> m_vDrawBatches; //runs of the draw order with the same mesh and level of detail
+	DrawKeySorter m_DrawSorter;
+	FrustumCullStats m_CullStats;
 	//float m_fProjectionSize;
 	//float m_fNearPlaneDistance;
 	//float m_fFarPlaneDistance;
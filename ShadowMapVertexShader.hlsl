@@ -6,12 +6,15 @@ cbuffer externalData : register(b0)
     matrix world;
     matrix view;
     matrix projection;
+    float3 positionOffset;
+    float3 positionScale;
 };
 // --------------------------------------------------------
 // A simplified vertex shader for rendering to a shadow map
 // --------------------------------------------------------
-float4 main(VertexShaderInput input) : SV_POSITION
+float4 main(MESH_VERTEX_INPUT vertex) : SV_POSITION
 {
+    VertexShaderInput input = UNPACK_VERTEX(vertex);
     matrix wvp = mul(projection, mul(view, world));
     return mul(wvp, float4(input.localPosition, 1.0f));
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include "ShaderStructs.hlsli"
+
+// Constant Buffer for external (C++) data
+cbuffer externalData : register(b0)
+{
+    matrix view;
+    matrix projection;
+    float3 positionOffset;
+    float3 positionScale;
+};
+// --------------------------------------------------------
+// ShadowMapVertexShader.hlsl for instanced draws, with the
+// world matrix of each instance from its InstanceData
+// --------------------------------------------------------
+float4 main(MESH_VERTEX_INPUT vertex, InstanceInput instance) : SV_POSITION
+{
+    VertexShaderInput input = UNPACK_VERTEX(vertex);
+    float4 worldPosition = mul(InstanceWorld(instance), float4(input.localPosition, 1.0f));
+    return mul(projection, mul(view, worldPosition));
+}
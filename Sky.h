@@ -6,6 +6,7 @@
 #include "Mesh.h"
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "TextureAsset.h"
 
 class Sky
 {
@@ -19,17 +20,19 @@ public:
 		const wchar_t* a_wsDown,
 		const wchar_t* a_wsFront,
 		const wchar_t* a_wsBack);
+	Sky(std::shared_ptr<Mesh> a_spMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> a_cpSamplerState, std::shared_ptr<TextureAsset> a_spCubemap);
 
 	void Draw(std::shared_ptr<Camera> a_spCamera);
 private:
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_cpSamplerState;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_cpTextureSRV;
+	std::shared_ptr<TextureAsset> m_spCubemap;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_cpDepthStencilState;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_cpRasterizerState;
 	std::shared_ptr<Mesh> m_spMesh;
 	std::shared_ptr<SimplePixelShader> m_spPixelShader;
 	std::shared_ptr<SimpleVertexShader> m_spVertexShader;
 
+	void CreateStatesAndShaders();
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
 		const wchar_t* a_wsRight,
 		const wchar_t* a_wsLeft,
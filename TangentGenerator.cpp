@@ -0,0 +1,429 @@
+#include "TangentGenerator.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Smallest number of triangles worth handing to its own thread
+	const size_t MIN_CHUNK_TRIANGLES = 64 * 1024;
+
+	// Triangles and verticies are processed in groups of four, one per XMVECTOR lane
+	const size_t LANES = 4;
+
+	inline size_t RoundUpToLanes(size_t a_uCount)
+	{
+		return (a_uCount + LANES - 1) & ~(LANES - 1);
+	}
+
+	/// <summary>
+	/// Any unit vector perpendicular to the normal, for verticies whose UVs don't define a tangent
+	/// </summary>
+	XMFLOAT3 PerpendicularTangent(const XMFLOAT3& a_f3Normal)
+	{
+		XMVECTOR normal = XMLoadFloat3(&a_f3Normal);
+		XMVECTOR axis = fabsf(a_f3Normal.x) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		XMFLOAT3 tangent;
+		XMStoreFloat3(&tangent, XMVector3Normalize(XMVector3Cross(XMVector3Cross(normal, axis), normal)));
+		return tangent;
+	}
+
+	/// <summary>
+	/// Runs a_Run(i) for every i in [0, a_uCount), each on its own thread; the calling thread takes 0
+	/// </summary>
+	template <typename RUN>
+	void RunOnThreads(size_t a_uCount, const RUN& a_Run)
+	{
+		std::vector<std::thread> vWorkers;
+		for (size_t i = 1; i < a_uCount; i++)
+			vWorkers.emplace_back(a_Run, i);
+		a_Run(0);
+		for (auto& t : vWorkers) t.join();
+	}
+
+	/// <summary>
+	/// Calculates the tangents of the verticies [a_uBegin, a_uEnd) (a "bin"). The triangles with a
+	/// corner in the bin are solved four at a time (one triangle per lane) and added to the bin's
+	/// verticies, which are then orthonormalized four at a time. A bin only writes its own
+	/// verticies, so bins can run on separate threads without atomics.
+	/// </summary>
+	/// <param name="a_pTriangles">Triangles touching the bin, in order; null when every triangle does</param>
+	/// <returns>Number of mirrored verticies in the bin</returns>
+	size_t GenerateBin(Vertex* a_pVertices, const uint32_t* a_pIndices, const uint32_t* a_pTriangles, size_t a_uTriangleCount, size_t a_uBegin, size_t a_uEnd)
+	{
+		XMVECTOR zero = XMVectorZero();
+		XMVECTOR one = XMVectorReplicate(1.0f);
+		XMVECTOR minimum = XMVectorReplicate(FLT_MIN);
+		uint32_t uBinStart = (uint32_t)a_uBegin;
+		uint32_t uBinSize = (uint32_t)(a_uEnd - a_uBegin);
+
+		// while summing, Tangent.xyz holds the tangent sum and Tangent.w the handedness sum
+		for (size_t v = a_uBegin; v < a_uEnd; v++)
+			a_pVertices[v].Tangent = XMFLOAT4(0, 0, 0, 0);
+
+		for (size_t t = 0; t < a_uTriangleCount; t += LANES)
+		{
+			// corners of four triangles (lanes past the end repeat the last triangle)
+			uint32_t indices[3][LANES];
+			for (size_t lane = 0; lane < LANES; lane++)
+			{
+				size_t uTriangle = std::min(t + lane, a_uTriangleCount - 1);
+				if (a_pTriangles)
+					uTriangle = a_pTriangles[uTriangle];
+				for (size_t c = 0; c < 3; c++)
+					indices[c][lane] = a_pIndices[uTriangle * 3 + c];
+			}
+
+			// transpose the corners so each XMVECTOR holds one component of four triangles
+			XMVECTOR px[3], py[3], pz[3], pu[3], pv[3];
+			for (size_t c = 0; c < 3; c++)
+			{
+				const Vertex& v0 = a_pVertices[indices[c][0]];
+				const Vertex& v1 = a_pVertices[indices[c][1]];
+				const Vertex& v2 = a_pVertices[indices[c][2]];
+				const Vertex& v3 = a_pVertices[indices[c][3]];
+				px[c] = XMVectorSet(v0.Position.x, v1.Position.x, v2.Position.x, v3.Position.x);
+				py[c] = XMVectorSet(v0.Position.y, v1.Position.y, v2.Position.y, v3.Position.y);
+				pz[c] = XMVectorSet(v0.Position.z, v1.Position.z, v2.Position.z, v3.Position.z);
+				pu[c] = XMVectorSet(v0.UV.x, v1.UV.x, v2.UV.x, v3.UV.x);
+				pv[c] = XMVectorSet(v0.UV.y, v1.UV.y, v2.UV.y, v3.UV.y);
+			}
+
+			// edges relative to the first corner, in space (x, y, z) and in UV (s, t)
+			XMVECTOR x1 = px[1] - px[0], y1 = py[1] - py[0], z1 = pz[1] - pz[0];
+			XMVECTOR x2 = px[2] - px[0], y2 = py[2] - py[0], z2 = pz[2] - pz[0];
+			XMVECTOR s1 = pu[1] - pu[0], t1 = pv[1] - pv[0];
+			XMVECTOR s2 = pu[2] - pu[0], t2 = pv[2] - pv[0];
+
+			// solve the 2x2 UV system, skipping triangles whose UVs are collinear
+			XMVECTOR determinant = s1 * t2 - s2 * t1;
+			XMVECTOR r = XMVectorSelect(zero, XMVectorReciprocal(determinant), XMVectorGreater(XMVectorAbs(determinant), minimum));
+
+			// the tangent (direction of +U), and cross(tangent, bitangent), which for a
+			// single triangle is cross(edge1, edge2) / determinant
+			XMFLOAT4 tx, ty, tz, cx, cy, cz;
+			XMStoreFloat4(&tx, (t2 * x1 - t1 * x2) * r);
+			XMStoreFloat4(&ty, (t2 * y1 - t1 * y2) * r);
+			XMStoreFloat4(&tz, (t2 * z1 - t1 * z2) * r);
+			XMStoreFloat4(&cx, (y1 * z2 - z1 * y2) * r);
+			XMStoreFloat4(&cy, (z1 * x2 - x1 * z2) * r);
+			XMStoreFloat4(&cz, (x1 * y2 - y1 * x2) * r);
+
+			// add each triangle to its corners that belong to this bin. The handedness
+			// dot(N, cross(T, B)) is positive when the bitangent follows cross(N, T)
+			for (size_t lane = 0; lane < LANES && t + lane < a_uTriangleCount; lane++)
+			{
+				for (size_t c = 0; c < 3; c++)
+				{
+					if (indices[c][lane] - uBinStart >= uBinSize)
+						continue;
+					Vertex& v = a_pVertices[indices[c][lane]];
+					v.Tangent.x += (&tx.x)[lane];
+					v.Tangent.y += (&ty.x)[lane];
+					v.Tangent.z += (&tz.x)[lane];
+					v.Tangent.w += v.Normal.x * (&cx.x)[lane] + v.Normal.y * (&cy.x)[lane] + v.Normal.z * (&cz.x)[lane];
+				}
+			}
+		}
+
+		// orthonormalize against the normal and turn the handedness sum into a sign
+		size_t uMirrored = 0;
+		for (size_t v = a_uBegin; v < a_uEnd; v += LANES)
+		{
+			// four verticies (lanes past the end of the bin repeat its last vertex)
+			const Vertex& v0 = a_pVertices[v];
+			const Vertex& v1 = a_pVertices[std::min(v + 1, a_uEnd - 1)];
+			const Vertex& v2 = a_pVertices[std::min(v + 2, a_uEnd - 1)];
+			const Vertex& v3 = a_pVertices[std::min(v + 3, a_uEnd - 1)];
+			XMVECTOR nx = XMVectorSet(v0.Normal.x, v1.Normal.x, v2.Normal.x, v3.Normal.x);
+			XMVECTOR ny = XMVectorSet(v0.Normal.y, v1.Normal.y, v2.Normal.y, v3.Normal.y);
+			XMVECTOR nz = XMVectorSet(v0.Normal.z, v1.Normal.z, v2.Normal.z, v3.Normal.z);
+			XMVECTOR tx = XMVectorSet(v0.Tangent.x, v1.Tangent.x, v2.Tangent.x, v3.Tangent.x);
+			XMVECTOR ty = XMVectorSet(v0.Tangent.y, v1.Tangent.y, v2.Tangent.y, v3.Tangent.y);
+			XMVECTOR tz = XMVectorSet(v0.Tangent.z, v1.Tangent.z, v2.Tangent.z, v3.Tangent.z);
+			XMVECTOR handedness = XMVectorSet(v0.Tangent.w, v1.Tangent.w, v2.Tangent.w, v3.Tangent.w);
+
+			// Gram-Schmidt: remove the part of the tangent along the normal, then normalize
+			XMVECTOR dot = nx * tx + ny * ty + nz * tz;
+			tx -= nx * dot;
+			ty -= ny * dot;
+			tz -= nz * dot;
+			XMVECTOR lengthSq = tx * tx + ty * ty + tz * tz;
+			XMVECTOR valid = XMVectorGreater(lengthSq, minimum);
+			XMVECTOR invLength = XMVectorReciprocalSqrt(XMVectorSelect(one, lengthSq, valid));
+
+			XMFLOAT4 outX, outY, outZ, outW, outValid;
+			XMStoreFloat4(&outX, tx * invLength);
+			XMStoreFloat4(&outY, ty * invLength);
+			XMStoreFloat4(&outZ, tz * invLength);
+			XMStoreFloat4(&outW, XMVectorSelect(one, -one, XMVectorLess(handedness, zero)));
+			XMStoreFloat4(&outValid, XMVectorSelect(zero, one, valid));
+
+			for (size_t lane = 0; lane < LANES && v + lane < a_uEnd; lane++)
+			{
+				Vertex& vertex = a_pVertices[v + lane];
+				if ((&outValid.x)[lane] != 0.0f)
+				{
+					vertex.Tangent = XMFLOAT4((&outX.x)[lane], (&outY.x)[lane], (&outZ.x)[lane], (&outW.x)[lane]);
+					uMirrored += (&outW.x)[lane] < 0.0f ? 1 : 0;
+				}
+				else
+				{
+					XMFLOAT3 fallback = PerpendicularTangent(vertex.Normal);
+					vertex.Tangent = XMFLOAT4(fallback.x, fallback.y, fallback.z, 1.0f);
+				}
+			}
+		}
+		return uMirrored;
+	}
+
+	/// <summary>
+	/// The one-triangle-at-a-time routine meshes used before GenerateTangents, kept as the
+	/// reference BenchmarkTangents compares against. Only writes Tangent.xyz.
+	/// </summary>
+	void CalculateTangentsScalar(Vertex* a_pVertices, size_t a_uVertexCount, const uint32_t* a_pIndices, size_t a_uIndexCount)
+	{
+		// Reset tangents
+		for (size_t i = 0; i < a_uVertexCount; i++)
+			a_pVertices[i].Tangent = XMFLOAT4(0, 0, 0, 0);
+
+		// Calculate tangents one whole triangle at a time
+		for (size_t i = 0; i + 2 < a_uIndexCount; i += 3)
+		{
+			Vertex* v1 = &a_pVertices[a_pIndices[i]];
+			Vertex* v2 = &a_pVertices[a_pIndices[i + 1]];
+			Vertex* v3 = &a_pVertices[a_pIndices[i + 2]];
+
+			// Calculate vectors relative to triangle positions
+			float x1 = v2->Position.x - v1->Position.x;
+			float y1 = v2->Position.y - v1->Position.y;
+			float z1 = v2->Position.z - v1->Position.z;
+			float x2 = v3->Position.x - v1->Position.x;
+			float y2 = v3->Position.y - v1->Position.y;
+			float z2 = v3->Position.z - v1->Position.z;
+
+			// Do the same for vectors relative to triangle uv's
+			float s1 = v2->UV.x - v1->UV.x;
+			float t1 = v2->UV.y - v1->UV.y;
+			float s2 = v3->UV.x - v1->UV.x;
+			float t2 = v3->UV.y - v1->UV.y;
+
+			// Create vectors for tangent calculation
+			float r = 1.0f / (s1 * t2 - s2 * t1);
+			float tx = (t2 * x1 - t1 * x2) * r;
+			float ty = (t2 * y1 - t1 * y2) * r;
+			float tz = (t2 * z1 - t1 * z2) * r;
+
+			// Adjust tangents of each vert of the triangle
+			for (Vertex* v : { v1, v2, v3 })
+			{
+				v->Tangent.x += tx;
+				v->Tangent.y += ty;
+				v->Tangent.z += tz;
+			}
+		}
+
+		// Ensure all of the tangents are orthogonal to the normals (Gram-Schmidt)
+		for (size_t i = 0; i < a_uVertexCount; i++)
+		{
+			XMVECTOR normal = XMLoadFloat3(&a_pVertices[i].Normal);
+			XMVECTOR tangent = XMLoadFloat4(&a_pVertices[i].Tangent);
+			tangent = XMVector3Normalize(tangent - normal * XMVector3Dot(normal, tangent));
+			XMStoreFloat4(&a_pVertices[i].Tangent, tangent);
+		}
+	}
+}
+
+/// <summary>
+/// Generates tangents for an indexed triangle list. The verticies are split into contiguous bins,
+/// one per thread; each thread solves the triangles that touch its bin with DirectXMath, four
+/// triangles at a time, and sums them into verticies that only it writes. The triangles are first
+/// bucketed by the bins they touch (a count per thread and bin, a prefix sum, then a fill), so a
+/// thread only walks its own. A triangle is solved again by every bin it touches, which is rare
+/// once the mesh optimizer has put verticies in first-use order.
+/// </summary>
+/// <param name="a_pVertices">Verticies with positions, UVs and normals; receives the tangents</param>
+/// <param name="a_uVertexCount">Number of verticies</param>
+/// <param name="a_pIndices">Triangle list</param>
+/// <param name="a_uIndexCount">Number of indices</param>
+/// <param name="a_uMaxThreads">Upper bound on worker threads (0 = hardware concurrency)</param>
+/// <returns>Timing and handedness statistics</returns>
+TangentGeneratorStats GenerateTangents(Vertex* a_pVertices, size_t a_uVertexCount,
+	const uint32_t* a_pIndices, size_t a_uIndexCount, unsigned int a_uMaxThreads)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t uTriangleCount = a_uIndexCount / 3;
+
+	unsigned int uThreads = a_uMaxThreads ? a_uMaxThreads : std::max(1u, std::thread::hardware_concurrency());
+	size_t uBinCount = std::max<size_t>(1, std::min<size_t>(uThreads, uTriangleCount / MIN_CHUNK_TRIANGLES));
+
+	// bins start on a multiple of LANES so groups of four verticies line up
+	size_t uGroups = RoundUpToLanes(a_uVertexCount) / LANES;
+	auto BinStart = [&](size_t i) { return std::min(a_uVertexCount, uGroups * i / uBinCount * LANES); };
+
+	std::vector<size_t> vBinStart(uBinCount + 1);
+	for (size_t i = 0; i <= uBinCount; i++)
+		vBinStart[i] = BinStart(i);
+
+	// bucket the triangles by the bins their corners fall in: each thread counts a slice of them
+	// per bin, the counts are summed into where each thread's part of each bin goes, and each
+	// thread then writes its slice there, which keeps every bin's triangles in order
+	std::vector<uint32_t> vBinTriangles;
+	std::vector<size_t> vBinFirst(uBinCount + 1, 0);
+	if (uBinCount > 1)
+	{
+		auto SliceStart = [&](size_t i) { return uTriangleCount * i / uBinCount; };
+		double dBinsPerVertex = (double)uBinCount / (uGroups * LANES);
+		auto BinOf = [&](size_t a_uVertex)
+		{
+			// the vertex's share of the bins is right to within one bin
+			size_t uBin = std::min(uBinCount - 1, (size_t)(a_uVertex * dBinsPerVertex));
+			while (uBin + 1 < uBinCount && vBinStart[uBin + 1] <= a_uVertex)
+				uBin++;
+			while (uBin > 0 && vBinStart[uBin] > a_uVertex)
+				uBin--;
+			return uBin;
+		};
+		auto ForEachBin = [&](size_t a_uTriangle, const auto& a_Add)
+		{
+			size_t uIndex0 = a_pIndices[a_uTriangle * 3], uIndex1 = a_pIndices[a_uTriangle * 3 + 1], uIndex2 = a_pIndices[a_uTriangle * 3 + 2];
+			size_t uBin0 = BinOf(uIndex0);
+			a_Add(uBin0);
+
+			// most triangles lie inside one bin
+			size_t uStart = vBinStart[uBin0], uSize = vBinStart[uBin0 + 1] - uStart;
+			if (uIndex1 - uStart < uSize && uIndex2 - uStart < uSize)
+				return;
+			size_t uBin1 = BinOf(uIndex1), uBin2 = BinOf(uIndex2);
+			if (uBin1 != uBin0)
+				a_Add(uBin1);
+			if (uBin2 != uBin0 && uBin2 != uBin1)
+				a_Add(uBin2);
+		};
+
+		// counts and then write positions, one row of bins per thread (kept in a local copy while
+		// it changes, so the threads don't share cache lines)
+		std::vector<size_t> vOffsets(uBinCount * uBinCount, 0);
+		RunOnThreads(uBinCount, [&](size_t i)
+		{
+			std::vector<size_t> vCounts(uBinCount, 0);
+			for (size_t t = SliceStart(i); t < SliceStart(i + 1); t++)
+				ForEachBin(t, [&](size_t a_uBin) { vCounts[a_uBin]++; });
+			std::copy(vCounts.begin(), vCounts.end(), vOffsets.begin() + i * uBinCount);
+		});
+		size_t uTotal = 0;
+		for (size_t uBin = 0; uBin < uBinCount; uBin++)
+		{
+			vBinFirst[uBin] = uTotal;
+			for (size_t i = 0; i < uBinCount; i++)
+			{
+				size_t uCount = vOffsets[i * uBinCount + uBin];
+				vOffsets[i * uBinCount + uBin] = uTotal;
+				uTotal += uCount;
+			}
+		}
+		vBinFirst[uBinCount] = uTotal;
+
+		vBinTriangles.resize(uTotal);
+		RunOnThreads(uBinCount, [&](size_t i)
+		{
+			std::vector<size_t> vNext(vOffsets.begin() + i * uBinCount, vOffsets.begin() + (i + 1) * uBinCount);
+			for (size_t t = SliceStart(i); t < SliceStart(i + 1); t++)
+				ForEachBin(t, [&](size_t a_uBin) { vBinTriangles[vNext[a_uBin]++] = (uint32_t)t; });
+		});
+	}
+
+	std::vector<size_t> vMirrored(uBinCount, 0);
+	RunOnThreads(uBinCount, [&](size_t i)
+	{
+		if (vBinStart[i] >= vBinStart[i + 1])
+			return;
+		if (uBinCount > 1)
+			vMirrored[i] = GenerateBin(a_pVertices, a_pIndices, vBinTriangles.data() + vBinFirst[i], vBinFirst[i + 1] - vBinFirst[i], vBinStart[i], vBinStart[i + 1]);
+		else
+			vMirrored[i] = GenerateBin(a_pVertices, a_pIndices, nullptr, uTriangleCount, vBinStart[i], vBinStart[i + 1]);
+	});
+
+	TangentGeneratorStats stats = {};
+	stats.ThreadCount = (unsigned int)uBinCount;
+	for (size_t uMirrored : vMirrored)
+		stats.MirroredVertexCount += uMirrored;
+	stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+/// <summary>
+/// Times GenerateTangents, on one thread and on every hardware thread, against the scalar
+/// routine it replaced, on a grid with random heights and normals, and compares the tangents
+/// </summary>
+/// <param name="a_uTriangles">How many triangles the grid should have at least</param>
+/// <param name="a_uSeed">Seed of the displacement</param>
+/// <returns>Best times of each routine and how far their tangents are apart</returns>
+TangentBenchmark BenchmarkTangents(unsigned int a_uTriangles, unsigned int a_uSeed)
+{
+	// two triangles per grid cell, uvs stretched over the whole grid
+	unsigned int uCells = std::max(1u, (a_uTriangles + 1) / 2);
+	unsigned int uWidth = std::max(1u, (unsigned int)std::sqrt((double)uCells));
+	unsigned int uHeight = (uCells + uWidth - 1) / uWidth;
+
+	std::mt19937 random(a_uSeed);
+	std::uniform_real_distribution<float> height(-0.02f, 0.02f);
+	std::uniform_real_distribution<float> tilt(-0.3f, 0.3f);
+	std::vector<Vertex> vVerticies((size_t)(uWidth + 1) * (uHeight + 1));
+	for (unsigned int z = 0; z <= uHeight; z++)
+	{
+		for (unsigned int x = 0; x <= uWidth; x++)
+		{
+			Vertex& v = vVerticies[(size_t)z * (uWidth + 1) + x];
+			v.Position = XMFLOAT3(x * 0.1f, height(random), z * 0.1f);
+			v.UV = XMFLOAT2((float)x / uWidth, 1.0f - (float)z / uHeight);
+			XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(tilt(random), 1.0f, tilt(random), 0.0f)));
+		}
+	}
+	std::vector<uint32_t> vIndices;
+	vIndices.reserve((size_t)uCells * 6);
+	for (unsigned int z = 0; z < uHeight; z++)
+	{
+		for (unsigned int x = 0; x < uWidth; x++)
+		{
+			uint32_t a = z * (uWidth + 1) + x, b = a + 1, c = a + uWidth + 1, d = c + 1;
+			vIndices.insert(vIndices.end(), { a, c, b, b, c, d });
+		}
+	}
+
+	TangentBenchmark result = {};
+	result.Triangles = (unsigned int)(vIndices.size() / 3);
+	result.Verticies = (unsigned int)vVerticies.size();
+	result.Threads = std::max(1u, std::thread::hardware_concurrency());
+	result.ScalarMilliseconds = result.SingleThreadMilliseconds = result.ThreadedMilliseconds = 1e30;
+	std::vector<Vertex> vReference = vVerticies;
+	for (int run = 0; run < TANGENT_BENCHMARK_RUNS; run++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		CalculateTangentsScalar(vReference.data(), vReference.size(), vIndices.data(), vIndices.size());
+		result.ScalarMilliseconds = std::min(result.ScalarMilliseconds,
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+		TangentGeneratorStats stats = GenerateTangents(vVerticies.data(), vVerticies.size(), vIndices.data(), vIndices.size(), 1);
+		result.SingleThreadMilliseconds = std::min(result.SingleThreadMilliseconds, stats.Milliseconds);
+
+		stats = GenerateTangents(vVerticies.data(), vVerticies.size(), vIndices.data(), vIndices.size(), result.Threads);
+		result.ThreadedMilliseconds = std::min(result.ThreadedMilliseconds, stats.Milliseconds);
+	}
+
+	for (size_t i = 0; i < vVerticies.size(); i++)
+	{
+		const XMFLOAT4& a = vVerticies[i].Tangent;
+		const XMFLOAT4& b = vReference[i].Tangent;
+		float fDifference = std::max({ fabsf(a.x - b.x), fabsf(a.y - b.y), fabsf(a.z - b.z) });
+		result.MaxDifference = std::max(result.MaxDifference, fDifference);
+		result.Mismatches += fDifference <= TANGENT_BENCHMARK_TOLERANCE ? 0 : 1;
+	}
+	return result;
+}
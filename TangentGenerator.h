@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Vertex.h"
+
+// Times each routine of BenchmarkTangents runs (the best run counts)
+#define TANGENT_BENCHMARK_RUNS 3
+
+// Largest difference BenchmarkTangents accepts between a tangent and the scalar reference's
+#define TANGENT_BENCHMARK_TOLERANCE 1e-3f
+
+// --------------------------------------------------------
+// What a call to GenerateTangents did
+// --------------------------------------------------------
+struct TangentGeneratorStats
+{
+	double Milliseconds;			// wall-clock time of the whole call
+	unsigned int ThreadCount;		// number of threads the work was split across
+	size_t MirroredVertexCount;		// verticies whose UVs are mirrored (Tangent.w == -1)
+};
+
+// --------------------------------------------------------
+// Result of BenchmarkTangents
+// --------------------------------------------------------
+struct TangentBenchmark
+{
+	unsigned int Triangles;
+	unsigned int Verticies;
+	unsigned int Threads;				// threads of the threaded run
+	double ScalarMilliseconds;			// best of several runs of the one-triangle-at-a-time routine meshes used before
+	double SingleThreadMilliseconds;	// GenerateTangents on one thread
+	double ThreadedMilliseconds;		// GenerateTangents on Threads threads
+	float MaxDifference;				// largest per-component difference of a tangent from the scalar routine's
+	unsigned int Mismatches;			// verticies further than TANGENT_BENCHMARK_TOLERANCE from the scalar routine
+};
+
+// Calculates per-vertex tangents (xyz) and bitangent handedness (w) for an indexed triangle list.
+// Normals, positions and UVs must already be filled in. Large meshes are split across threads.
+TangentGeneratorStats GenerateTangents(Vertex* a_pVertices, size_t a_uVertexCount,
+	const uint32_t* a_pIndices, size_t a_uIndexCount, unsigned int a_uMaxThreads = 0);
+
+// Times GenerateTangents against the scalar routine it replaced on a generated, displaced grid of
+// at least a_uTriangles triangles and compares their tangents. Needs no device, so it also runs
+// without a window.
+TangentBenchmark BenchmarkTangents(unsigned int a_uTriangles, unsigned int a_uSeed = 1);
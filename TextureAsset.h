@@ -0,0 +1,22 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// A texture that may still be loading. Materials and the
+// sky hold on to this instead of the view itself, so the
+// placeholder it starts with can be swapped for the real
+// texture once the asset loader has created it.
+// --------------------------------------------------------
+struct TextureAsset
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+	bool Loaded;	// false while SRV is still the placeholder
+
+	// Packed material maps (see MaterialPacking.h) only: a channel that is the same everywhere
+	// has a 0 in Sampled and its value in Constant, so shaders can use that instead of sampling
+	DirectX::XMFLOAT3 Constant;
+	DirectX::XMFLOAT3 Sampled;
+};
@@ -0,0 +1,341 @@
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../ImageCodecs.h"
+#include "../TextureMips.h"
+#include "../BlockCompression.h"
+#include "../DdsFile.h"
+#include "../MaterialPacking.h"
+
+// Offline texture cooker: decodes PNG/JPEG source images, builds their mip chains in linear
+// space and writes each one next to its source as a block compressed .dds, which the game's
+// asset loader picks up instead of the source image. With --pack it instead packs a material's
+// occlusion, roughness and metalness maps into one texture and checks the result against the
+// maps, and with --benchmark it times the mip generator headless. Pure C++, so it also builds on Linux:
+//   g++ -std=c++17 -O2 -msse2 -pthread TextureCooker/Main.cpp ImageCodecs.cpp TextureMips.cpp
+//       BlockCompression.cpp DdsFile.cpp MaterialPacking.cpp -o texture-cooker
+
+// What a map holds, which decides its filtering and its format
+#define COOK_TYPE_ALBEDO	0	// BC7 (or BC1), filtered as sRGB color
+#define COOK_TYPE_NORMAL	1	// BC5, x and y only (the shader rebuilds z)
+#define COOK_TYPE_ROUGHNESS	2	// BC4
+#define COOK_TYPE_METALNESS	3	// BC4
+
+namespace
+{
+	// --------------------------------------------------------
+	// Options from the command line
+	// --------------------------------------------------------
+	struct CookOptions
+	{
+		int Type;				// COOK_TYPE_*, or -1 to go by the file name
+		bool UseBc1;			// albedo as BC1 instead of BC7
+		int MipFilter;			// MIP_FILTER_*
+		unsigned int Threads;	// 0 = every hardware thread
+	};
+
+	void PrintUsage()
+	{
+		printf("Usage: TextureCooker [--type albedo|normal|roughness|metalness] [--bc1] [--box] [--threads N] image...\n");
+		printf("       TextureCooker --pack occlusion roughness metalness [--box] [--threads N]\n");
+		printf("       TextureCooker --benchmark [size] [--threads N]\n");
+		printf("Without --type, the type comes from the file name (_diff, _nor, _rough, _metal).\n");
+		printf("Each image is written next to itself with a .dds extension.\n");
+		printf("Mips are filtered with a Kaiser window, or a 2x2 box with --box.\n");
+		printf("--pack takes - for a missing map and writes <first map>_packed.dds (BC7, occlusion/roughness/metalness in RGB).\n");
+		printf("--benchmark times mip chain generation on a size x size image (4096 by default) and writes nothing.\n");
+	}
+
+	/// <summary>
+	/// Guesses a map's type from the naming of the texture sets in Assets
+	/// </summary>
+	/// <returns>COOK_TYPE_*, or -1 if the name doesn't say</returns>
+	int TypeFromFileName(const std::string& a_sFileName)
+	{
+		std::string sName = a_sFileName.substr(a_sFileName.find_last_of("/\\") + 1);
+		if (sName.find("_nor") != std::string::npos) return COOK_TYPE_NORMAL;
+		if (sName.find("_rough") != std::string::npos) return COOK_TYPE_ROUGHNESS;
+		if (sName.find("_metal") != std::string::npos) return COOK_TYPE_METALNESS;
+		if (sName.find("_diff") != std::string::npos || sName.find("_albedo") != std::string::npos) return COOK_TYPE_ALBEDO;
+		return -1;
+	}
+
+	int TypeFromName(const char* a_sName)
+	{
+		if (strcmp(a_sName, "albedo") == 0) return COOK_TYPE_ALBEDO;
+		if (strcmp(a_sName, "normal") == 0) return COOK_TYPE_NORMAL;
+		if (strcmp(a_sName, "roughness") == 0) return COOK_TYPE_ROUGHNESS;
+		if (strcmp(a_sName, "metalness") == 0) return COOK_TYPE_METALNESS;
+		return -1;
+	}
+
+	/// <summary>
+	/// The path of a source image with its extension replaced by .dds
+	/// </summary>
+	std::string CookedFileName(const std::string& a_sFileName)
+	{
+		size_t uDot = a_sFileName.find_last_of('.');
+		size_t uSlash = a_sFileName.find_last_of("/\\");
+		if (uDot == std::string::npos || (uSlash != std::string::npos && uDot < uSlash))
+			return a_sFileName + ".dds";
+		return a_sFileName.substr(0, uDot) + ".dds";
+	}
+
+	/// <summary>
+	/// Builds an image's mip chain, compresses every level and writes them as a .dds
+	/// </summary>
+	/// <param name="a_vLevels">Receives the compressed levels</param>
+	/// <returns>Whether the file was written</returns>
+	bool WriteCookedTexture(std::vector<DdsMipLevel>& a_vLevels, const std::string& a_sOutput, const DecodedImage& a_Image,
+		int a_nKind, int a_nFormat, uint32_t a_uDxgiFormat, const CookOptions& a_Options)
+	{
+		std::vector<DecodedImage> vMips = GenerateMipChain(a_Image, a_nKind, a_Options.MipFilter, a_Options.Threads);
+		a_vLevels.resize(vMips.size());
+		for (size_t i = 0; i < vMips.size(); i++)
+		{
+			a_vLevels[i].Width = vMips[i].Width;
+			a_vLevels[i].Height = vMips[i].Height;
+			a_vLevels[i].Blocks.resize(GetCompressedSize(vMips[i].Width, vMips[i].Height, a_nFormat));
+			CompressImage(a_vLevels[i].Blocks.data(), vMips[i], a_nFormat, a_Options.Threads);
+		}
+		return WriteDdsFile(a_sOutput.c_str(), a_uDxgiFormat, (uint32_t)GetBlockSize(a_nFormat), a_vLevels);
+	}
+
+	/// <summary>
+	/// The path a material's packed maps are written to: the first map's path with _packed.dds instead of its extension
+	/// </summary>
+	std::string PackedFileName(const std::string& a_sFileName)
+	{
+		std::string sCooked = CookedFileName(a_sFileName);
+		return sCooked.substr(0, sCooked.size() - 4) + "_packed.dds";
+	}
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point a_tpStart)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - a_tpStart).count();
+	}
+
+	/// <summary>
+	/// Cooks one image
+	/// </summary>
+	/// <returns>Whether the .dds was written</returns>
+	bool CookTexture(const std::string& a_sFileName, const CookOptions& a_Options)
+	{
+		int nType = a_Options.Type >= 0 ? a_Options.Type : TypeFromFileName(a_sFileName);
+		if (nType < 0)
+		{
+			printf("%s: can't tell the map type from the name, pass --type\n", a_sFileName.c_str());
+			return false;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		DecodedImage image;
+		if (!LoadImageFile(a_sFileName.c_str(), image))
+		{
+			printf("%s: not a PNG or baseline JPEG this cooker can decode\n", a_sFileName.c_str());
+			return false;
+		}
+		double dDecodeMilliseconds = MillisecondsSince(start);
+
+		int nFormat, nChannels, nKind;
+		uint32_t uDxgiFormat;
+		switch (nType)
+		{
+		case COOK_TYPE_ALBEDO:
+			// UNORM rather than _SRGB: the pixel shader linearizes albedo itself
+			nFormat = a_Options.UseBc1 ? BC_FORMAT_BC1 : BC_FORMAT_BC7;
+			uDxgiFormat = a_Options.UseBc1 ? DDS_DXGI_FORMAT_BC1_UNORM : DDS_DXGI_FORMAT_BC7_UNORM;
+			nChannels = 3;
+			nKind = TEXTURE_KIND_COLOR;
+			break;
+		case COOK_TYPE_NORMAL:
+			nFormat = BC_FORMAT_BC5;
+			uDxgiFormat = DDS_DXGI_FORMAT_BC5_UNORM;
+			nChannels = 2;
+			nKind = TEXTURE_KIND_NORMAL;
+			break;
+		default:
+			nFormat = BC_FORMAT_BC4;
+			uDxgiFormat = DDS_DXGI_FORMAT_BC4_UNORM;
+			nChannels = 1;
+			nKind = TEXTURE_KIND_DATA;
+			break;
+		}
+
+		start = std::chrono::steady_clock::now();
+		std::string sOutput = CookedFileName(a_sFileName);
+		std::vector<DdsMipLevel> vLevels;
+		if (!WriteCookedTexture(vLevels, sOutput, image, nKind, nFormat, uDxgiFormat, a_Options))
+		{
+			printf("%s: couldn't write %s\n", a_sFileName.c_str(), sOutput.c_str());
+			return false;
+		}
+		double dCookMilliseconds = MillisecondsSince(start);
+
+		// quality of the top level, over the channels the format keeps
+		DecodedImage decompressed;
+		DecompressImage(decompressed, vLevels[0].Blocks.data(), image.Width, image.Height, nFormat);
+		double dPsnr = ComputePsnr(image, decompressed, nChannels);
+
+		static const char* FORMAT_NAMES[8] = { "", "BC1", "", "", "BC4", "BC5", "", "BC7" };
+		printf("%s -> %s: %ux%u, %zu mips, %s, PSNR %.2f dB (decode %.0f ms, mips and encode %.0f ms)\n",
+			a_sFileName.c_str(), sOutput.c_str(), image.Width, image.Height, vLevels.size(), FORMAT_NAMES[nFormat],
+			dPsnr, dDecodeMilliseconds, dCookMilliseconds);
+		return true;
+	}
+
+	/// <summary>
+	/// Packs a material's occlusion, roughness and metalness maps into one BC7 texture and
+	/// checks the packed image, before and after compression, against the maps
+	/// </summary>
+	/// <param name="a_pFileNames">Occlusion, roughness and metalness images ("-" for none)</param>
+	/// <returns>Whether the .dds was written and the packing is exact</returns>
+	bool PackMaterial(const std::string a_pFileNames[PACKED_CHANNEL_COUNT], const CookOptions& a_Options)
+	{
+		static const char* CHANNEL_NAMES[PACKED_CHANNEL_COUNT] = { "occlusion", "roughness", "metalness" };
+		static const float DEFAULTS[PACKED_CHANNEL_COUNT] = { 1.0f, 0.5f, 0.0f };
+
+		DecodedImage maps[PACKED_CHANNEL_COUNT];
+		const DecodedImage* sources[PACKED_CHANNEL_COUNT] = {};
+		std::string sOutput;
+		for (int c = 0; c < PACKED_CHANNEL_COUNT; c++)
+		{
+			if (a_pFileNames[c] == "-")
+				continue;
+			if (!LoadImageFile(a_pFileNames[c].c_str(), maps[c]))
+			{
+				printf("%s: not a PNG or baseline JPEG this cooker can decode\n", a_pFileNames[c].c_str());
+				return false;
+			}
+			sources[c] = &maps[c];
+			if (sOutput.empty())
+				sOutput = PackedFileName(a_pFileNames[c]);
+		}
+		if (sOutput.empty())
+		{
+			printf("--pack needs at least one map\n");
+			return false;
+		}
+
+		PackedMaterialMaps packed;
+		PackMaterialMaps(packed, sources[0], sources[1], sources[2], DEFAULTS);
+
+		std::vector<DdsMipLevel> vLevels;
+		if (!WriteCookedTexture(vLevels, sOutput, packed.Image, TEXTURE_KIND_DATA, BC_FORMAT_BC7, DDS_DXGI_FORMAT_BC7_UNORM, a_Options))
+		{
+			printf("couldn't write %s\n", sOutput.c_str());
+			return false;
+		}
+		DecodedImage decompressed;
+		DecompressImage(decompressed, vLevels[0].Blocks.data(), packed.Image.Width, packed.Image.Height, BC_FORMAT_BC7);
+
+		// the packing itself has to be exact, apart from flat maps collapsing to their mean
+		PackedMapValidation packedCheck = ValidatePackedMaps(packed, packed.Image, sources[0], sources[1], sources[2]);
+		PackedMapValidation cookedCheck = ValidatePackedMaps(packed, decompressed, sources[0], sources[1], sources[2]);
+		bool bValid = true;
+		printf("%s: %ux%u, %zu mips, BC7\n", sOutput.c_str(), packed.Image.Width, packed.Image.Height, vLevels.size());
+		for (int c = 0; c < PACKED_CHANNEL_COUNT; c++)
+		{
+			int nAllowed = packed.Constant[c] && sources[c] ? PACKED_CONSTANT_TOLERANCE + 1 : 0;
+			bool bChannelValid = packedCheck.MaxError[c] <= nAllowed;
+			bValid = bValid && bChannelValid;
+			printf("  %-9s %-9s %s max error %d packed, %d cooked (PSNR %.2f dB) %s\n", CHANNEL_NAMES[c],
+				sources[c] ? "map" : "no map", packed.Constant[c] ? "constant," : "varies,  ",
+				packedCheck.MaxError[c], cookedCheck.MaxError[c], cookedCheck.Psnr[c], bChannelValid ? "ok" : "MISMATCH");
+			if (packed.Constant[c])
+				printf("            constant %.3f\n", packed.ConstantValue[c]);
+		}
+		return bValid;
+	}
+
+	/// <summary>
+	/// Times mip chain generation from a size x size image down to 1x1 and prints the throughput
+	/// </summary>
+	void RunBenchmark(uint32_t a_uSize, unsigned int a_uThreads)
+	{
+		MipChainBenchmark result = BenchmarkMipChain(a_uSize, a_uThreads);
+		double dPixels = (double)result.Size * result.Size;
+		printf("Mip chain of a %ux%u color image, best of several runs:\n", result.Size, result.Size);
+		auto PrintRun = [&](const char* a_sName, unsigned int a_uRunThreads, double a_dMilliseconds)
+		{
+			printf("  %-10s %2u thread%s %8.1f ms %8.0f M pixels/s\n", a_sName, a_uRunThreads, a_uRunThreads == 1 ? " " : "s",
+				a_dMilliseconds, dPixels / (a_dMilliseconds * 1000.0));
+		};
+		PrintRun("scalar box", 1, result.ScalarMilliseconds);
+		PrintRun("box", 1, result.BoxMilliseconds);
+		PrintRun("box", result.Threads, result.BoxThreadedMilliseconds);
+		PrintRun("kaiser", 1, result.KaiserMilliseconds);
+		PrintRun("kaiser", result.Threads, result.KaiserThreadedMilliseconds);
+		printf("Largest difference of the box chain from the scalar one: %d\n", result.MaxBoxError);
+	}
+}
+
+// --------------------------------------------------------
+// Entry point of the texture cooker
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	CookOptions options = { -1, false, MIP_FILTER_KAISER, 0 };
+	std::vector<std::string> vFiles;
+	bool bPack = false;
+	uint32_t uBenchmarkSize = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--type") == 0 && i + 1 < argc)
+		{
+			options.Type = TypeFromName(argv[++i]);
+			if (options.Type < 0)
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--pack") == 0)
+			bPack = true;
+		else if (strcmp(argv[i], "--bc1") == 0)
+			options.UseBc1 = true;
+		else if (strcmp(argv[i], "--box") == 0)
+			options.MipFilter = MIP_FILTER_BOX;
+		else if (strcmp(argv[i], "--benchmark") == 0)
+			uBenchmarkSize = i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]) ? (uint32_t)atoi(argv[++i]) : 4096;
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.Threads = (unsigned int)atoi(argv[++i]);
+		else if (argv[i][0] == '-' && argv[i][1] != '\0')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			vFiles.push_back(argv[i]);
+	}
+	if (uBenchmarkSize > 0)
+	{
+		RunBenchmark(uBenchmarkSize, options.Threads);
+		return 0;
+	}
+	if (bPack)
+	{
+		if (vFiles.size() != PACKED_CHANNEL_COUNT)
+		{
+			PrintUsage();
+			return 1;
+		}
+		return PackMaterial(vFiles.data(), options) ? 0 : 1;
+	}
+	if (vFiles.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	int nFailed = 0;
+	for (const std::string& sFileName : vFiles)
+		if (!CookTexture(sFileName, options))
+			nFailed++;
+	return nFailed ? 1 : 0;
+}
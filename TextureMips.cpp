@@ -0,0 +1,575 @@
+#include "TextureMips.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Fewest rows of a level that get a thread of their own
+	const uint32_t MIN_CHUNK_ROWS = 32;
+
+	// Kaiser filter (the shape NVIDIA's texture tools use): pixel x of a level is made from pixels
+	// 2x - 3 to 2x + 4 of the level above, weighted by a sinc windowed to KAISER_RADIUS pixels of
+	// the new level
+	const int KAISER_TAPS = 8;
+	const float KAISER_RADIUS = 2.0f;
+	const float KAISER_ALPHA = 4.0f;
+	const double PI = 3.14159265358979323846;
+
+	// Linear values are sorted into this many buckets to find their sRGB code. A bucket is
+	// narrower than the gap between any two codes, so at most one code starts inside it.
+	const uint32_t SRGB_BUCKETS = 4096;
+
+	// Benchmark runs per configuration; the fastest one is reported
+	const int MIP_BENCHMARK_RUNS = 3;
+
+	float SrgbToLinear(float a_fValue)
+	{
+		return a_fValue <= 0.04045f ? a_fValue / 12.92f : powf((a_fValue + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float LinearToSrgb(float a_fValue)
+	{
+		return a_fValue <= 0.0031308f ? a_fValue * 12.92f : 1.055f * powf(a_fValue, 1.0f / 2.4f) - 0.055f;
+	}
+
+	uint8_t ToUnorm8(float a_fValue)
+	{
+		return (uint8_t)lrintf(std::clamp(a_fValue, 0.0f, 1.0f) * 255.0f);
+	}
+
+	// --------------------------------------------------------
+	// Lookup tables between 8-bit values and the float space
+	// textures are filtered in
+	// --------------------------------------------------------
+	struct ConversionTables
+	{
+		float ToFilterSpace[3][256];		// RGB, per TEXTURE_KIND_*
+		float ToAlpha[256];
+		float SrgbThreshold[256];			// linear value from which code k + 1 is stored instead of k
+		uint8_t SrgbBucket[SRGB_BUCKETS];	// code of the lowest value in each bucket
+	};
+
+	ConversionTables BuildConversionTables()
+	{
+		ConversionTables tables;
+		for (int i = 0; i < 256; i++)
+		{
+			float fValue = i / 255.0f;
+			tables.ToFilterSpace[TEXTURE_KIND_COLOR][i] = SrgbToLinear(fValue);
+			tables.ToFilterSpace[TEXTURE_KIND_NORMAL][i] = fValue * 2.0f - 1.0f;
+			tables.ToFilterSpace[TEXTURE_KIND_DATA][i] = fValue;
+			tables.ToAlpha[i] = fValue;
+			tables.SrgbThreshold[i] = i < 255 ? SrgbToLinear((i + 0.5f) / 255.0f) : FLT_MAX;
+		}
+
+		uint8_t uCode = 0;
+		for (uint32_t b = 0; b < SRGB_BUCKETS; b++)
+		{
+			while ((float)b / SRGB_BUCKETS >= tables.SrgbThreshold[uCode])
+				uCode++;
+			tables.SrgbBucket[b] = uCode;
+		}
+		return tables;
+	}
+
+	const ConversionTables& GetConversionTables()
+	{
+		static const ConversionTables tables = BuildConversionTables();
+		return tables;
+	}
+
+	/// <summary>
+	/// Rounds a linear value to the nearest 8-bit sRGB code without a pow per value
+	/// </summary>
+	uint8_t LinearToSrgb8(float a_fValue, const ConversionTables& a_Tables)
+	{
+		float fValue = std::clamp(a_fValue, 0.0f, 1.0f);
+		uint8_t uCode = a_Tables.SrgbBucket[std::min((uint32_t)(fValue * SRGB_BUCKETS), SRGB_BUCKETS - 1)];
+		return fValue >= a_Tables.SrgbThreshold[uCode] ? uCode + 1 : uCode;
+	}
+
+	/// <summary>
+	/// Converts a row of RGBA8 pixels into filter space
+	/// </summary>
+	void RowToFilterSpace(float* a_pOutput, const uint8_t* a_pPixels, uint32_t a_uWidth, int a_nKind, const ConversionTables& a_Tables)
+	{
+		const float* pTable = a_Tables.ToFilterSpace[a_nKind];
+		for (size_t i = 0; i < (size_t)a_uWidth * 4; i += 4)
+		{
+			a_pOutput[i + 0] = pTable[a_pPixels[i + 0]];
+			a_pOutput[i + 1] = pTable[a_pPixels[i + 1]];
+			a_pOutput[i + 2] = pTable[a_pPixels[i + 2]];
+			a_pOutput[i + 3] = a_Tables.ToAlpha[a_pPixels[i + 3]];
+		}
+	}
+
+	/// <summary>
+	/// Converts a row of filtered pixels back to RGBA8
+	/// </summary>
+	void RowFromFilterSpace(uint8_t* a_pPixels, const float* a_pRow, uint32_t a_uWidth, int a_nKind, const ConversionTables& a_Tables)
+	{
+		for (size_t i = 0; i < (size_t)a_uWidth * 4; i += 4)
+		{
+			const float* pPixel = &a_pRow[i];
+			if (a_nKind == TEXTURE_KIND_COLOR)
+			{
+				for (int c = 0; c < 3; c++)
+					a_pPixels[i + c] = LinearToSrgb8(pPixel[c], a_Tables);
+			}
+			else if (a_nKind == TEXTURE_KIND_NORMAL)
+			{
+				// averaging shortens the vectors, so they are renormalized before being stored
+				float fLength = sqrtf(pPixel[0] * pPixel[0] + pPixel[1] * pPixel[1] + pPixel[2] * pPixel[2]);
+				float fScale = fLength > 1e-6f ? 1.0f / fLength : 0.0f;
+				for (int c = 0; c < 3; c++)
+					a_pPixels[i + c] = ToUnorm8(fLength > 1e-6f ? pPixel[c] * fScale * 0.5f + 0.5f : c == 2 ? 1.0f : 0.5f);
+			}
+			else
+			{
+				for (int c = 0; c < 3; c++)
+					a_pPixels[i + c] = ToUnorm8(pPixel[c]);
+			}
+			a_pPixels[i + 3] = ToUnorm8(pPixel[3]);
+		}
+	}
+
+	/// <summary>
+	/// Weights of the Kaiser filter's taps, normalized so flat areas stay flat
+	/// </summary>
+	void GetKaiserWeights(float a_pWeights[KAISER_TAPS])
+	{
+		// modified Bessel function of the first kind, order 0, by its power series
+		auto BesselI0 = [](double a_dX)
+		{
+			double dSum = 1.0, dTerm = 1.0;
+			for (int k = 1; k < 64 && dTerm > 1e-12 * dSum; k++)
+			{
+				double dFactor = a_dX * 0.5 / k;
+				dTerm *= dFactor * dFactor;
+				dSum += dTerm;
+			}
+			return dSum;
+		};
+
+		double dTotal = 0.0;
+		double weights[KAISER_TAPS];
+		for (int k = 0; k < KAISER_TAPS; k++)
+		{
+			// tap centers relative to the new pixel's center, in pixels of the new level
+			double dT = (k - (KAISER_TAPS - 1) * 0.5) * 0.5;
+			double dSinc = sin(PI * dT) / (PI * dT);
+			double dRatio = dT / KAISER_RADIUS;
+			double dWindow = BesselI0(KAISER_ALPHA * sqrt(std::max(0.0, 1.0 - dRatio * dRatio))) / BesselI0(KAISER_ALPHA);
+			weights[k] = dSinc * dWindow;
+			dTotal += weights[k];
+		}
+		for (int k = 0; k < KAISER_TAPS; k++)
+			a_pWeights[k] = (float)(weights[k] / dTotal);
+	}
+
+	// --------------------------------------------------------
+	// The rows of the level being filtered, in filter space.
+	// Rows outside the level are clamped to its edges. The
+	// top level stays 8-bit: its rows are converted when they
+	// are first needed, into a ring that holds the last
+	// KAISER_TAPS of them, so no float copy of it is made.
+	// --------------------------------------------------------
+	class SourceRows
+	{
+	public:
+		SourceRows(const DecodedImage* a_pImage, const float* a_pPixels, uint32_t a_uWidth, uint32_t a_uHeight, int a_nKind, const ConversionTables& a_Tables)
+			: m_pImage(a_pImage), m_pPixels(a_pPixels), m_uWidth(a_uWidth), m_uHeight(a_uHeight), m_nKind(a_nKind), m_Tables(a_Tables)
+		{
+			if (m_pImage)
+				m_vRing.resize((size_t)a_uWidth * 4 * KAISER_TAPS);
+			std::fill(m_pRingRows, m_pRingRows + KAISER_TAPS, -1);
+		}
+
+		/// <summary>
+		/// Gets a row, converting it first if it comes from the 8-bit level
+		/// </summary>
+		const float* Row(int64_t a_nY)
+		{
+			int64_t nY = std::clamp<int64_t>(a_nY, 0, m_uHeight - 1);
+			size_t uStride = (size_t)m_uWidth * 4;
+			if (!m_pImage)
+				return m_pPixels + nY * uStride;
+
+			// a filter never asks for more than KAISER_TAPS consecutive rows at once, so they never share a slot
+			int nSlot = (int)(nY % KAISER_TAPS);
+			float* pRow = &m_vRing[nSlot * uStride];
+			if (m_pRingRows[nSlot] != nY)
+			{
+				RowToFilterSpace(pRow, &m_pImage->Pixels[nY * uStride], m_uWidth, m_nKind, m_Tables);
+				m_pRingRows[nSlot] = nY;
+			}
+			return pRow;
+		}
+
+	private:
+		const DecodedImage* m_pImage;
+		const float* m_pPixels;
+		uint32_t m_uWidth;
+		uint32_t m_uHeight;
+		int m_nKind;
+		const ConversionTables& m_Tables;
+		std::vector<float> m_vRing;
+		int64_t m_pRingRows[KAISER_TAPS];
+	};
+
+	/// <summary>
+	/// Box filter: averages each 2x2 square of two rows into one pixel
+	/// </summary>
+	void BoxRow(float* a_pOutput, const float* a_pRow0, const float* a_pRow1, uint32_t a_uWidth, uint32_t a_uNewWidth)
+	{
+		// a single column is only averaged vertically
+		if (a_uWidth == 1)
+		{
+			_mm_storeu_ps(a_pOutput, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(a_pRow0), _mm_loadu_ps(a_pRow1)), _mm_set1_ps(0.5f)));
+			return;
+		}
+
+		uint32_t x = 0;
+#if defined(__AVX__)
+		// two new pixels at a time: add the rows, then the even pixels to the odd ones
+		const __m256 quarter8 = _mm256_set1_ps(0.25f);
+		for (; x + 2 <= a_uNewWidth; x += 2)
+		{
+			__m256 left = _mm256_add_ps(_mm256_loadu_ps(a_pRow0 + x * 8), _mm256_loadu_ps(a_pRow1 + x * 8));
+			__m256 right = _mm256_add_ps(_mm256_loadu_ps(a_pRow0 + x * 8 + 8), _mm256_loadu_ps(a_pRow1 + x * 8 + 8));
+			__m256 even = _mm256_permute2f128_ps(left, right, 0x20);
+			__m256 odd = _mm256_permute2f128_ps(left, right, 0x31);
+			_mm256_storeu_ps(a_pOutput + x * 4, _mm256_mul_ps(_mm256_add_ps(even, odd), quarter8));
+		}
+#endif
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		for (; x < a_uNewWidth; x++)
+		{
+			__m128 top = _mm_add_ps(_mm_loadu_ps(a_pRow0 + x * 8), _mm_loadu_ps(a_pRow0 + x * 8 + 4));
+			__m128 bottom = _mm_add_ps(_mm_loadu_ps(a_pRow1 + x * 8), _mm_loadu_ps(a_pRow1 + x * 8 + 4));
+			_mm_storeu_ps(a_pOutput + x * 4, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+		}
+	}
+
+	/// <summary>
+	/// Kaiser filter, vertical pass: weights KAISER_TAPS full-width rows into one
+	/// </summary>
+	void KaiserColumns(float* a_pOutput, const float* const a_pRows[KAISER_TAPS], size_t a_uFloats, const float a_pWeights[KAISER_TAPS])
+	{
+		size_t i = 0;
+#if defined(__AVX__)
+		__m256 weights8[KAISER_TAPS];
+		for (int k = 0; k < KAISER_TAPS; k++)
+			weights8[k] = _mm256_set1_ps(a_pWeights[k]);
+		for (; i + 8 <= a_uFloats; i += 8)
+		{
+			__m256 sum = _mm256_mul_ps(_mm256_loadu_ps(a_pRows[0] + i), weights8[0]);
+			for (int k = 1; k < KAISER_TAPS; k++)
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a_pRows[k] + i), weights8[k]));
+			_mm256_storeu_ps(a_pOutput + i, sum);
+		}
+#endif
+		__m128 weights[KAISER_TAPS];
+		for (int k = 0; k < KAISER_TAPS; k++)
+			weights[k] = _mm_set1_ps(a_pWeights[k]);
+		for (; i < a_uFloats; i += 4)
+		{
+			__m128 sum = _mm_mul_ps(_mm_loadu_ps(a_pRows[0] + i), weights[0]);
+			for (int k = 1; k < KAISER_TAPS; k++)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a_pRows[k] + i), weights[k]));
+			_mm_storeu_ps(a_pOutput + i, sum);
+		}
+	}
+
+	/// <summary>
+	/// Kaiser filter, horizontal pass: weights the pixels of a full-width row down to half width
+	/// </summary>
+	void KaiserRow(float* a_pOutput, const float* a_pRow, uint32_t a_uWidth, uint32_t a_uNewWidth, const float a_pWeights[KAISER_TAPS])
+	{
+		__m128 weights[KAISER_TAPS];
+		for (int k = 0; k < KAISER_TAPS; k++)
+			weights[k] = _mm_set1_ps(a_pWeights[k]);
+
+		// near the edges the taps are clamped to the row
+		auto FilterClamped = [&](uint32_t x)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < KAISER_TAPS; k++)
+			{
+				int64_t nX = std::clamp<int64_t>((int64_t)x * 2 - KAISER_TAPS / 2 + 1 + k, 0, a_uWidth - 1);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a_pRow + nX * 4), weights[k]));
+			}
+			_mm_storeu_ps(a_pOutput + x * 4, sum);
+		};
+		auto Filter = [&](uint32_t x)
+		{
+			const float* pFirst = a_pRow + ((size_t)x * 2 - KAISER_TAPS / 2 + 1) * 4;
+			__m128 sum = _mm_mul_ps(_mm_loadu_ps(pFirst), weights[0]);
+			for (int k = 1; k < KAISER_TAPS; k++)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pFirst + k * 4), weights[k]));
+			_mm_storeu_ps(a_pOutput + x * 4, sum);
+		};
+
+		// every tap of pixel x is inside the row once 2x - 3 >= 0 and 2x + 4 < width
+		uint32_t x = 0;
+		for (; x < a_uNewWidth && x < KAISER_TAPS / 4; x++)
+			FilterClamped(x);
+#if defined(__AVX__)
+		// two new pixels at a time: pixel x takes its taps from the low halves (even taps) and high
+		// halves (odd taps) of pairs 0-3 of the source pixels, pixel x + 1 from pairs 1-4
+		__m256 weights8[KAISER_TAPS];
+		for (int k = 0; k < KAISER_TAPS; k++)
+			weights8[k] = _mm256_set1_ps(a_pWeights[k]);
+		for (; x + 1 < a_uNewWidth && (size_t)x * 2 + KAISER_TAPS / 2 + 2 < a_uWidth; x += 2)
+		{
+			const float* pFirst = a_pRow + ((size_t)x * 2 - KAISER_TAPS / 2 + 1) * 4;
+			__m256 pairs[KAISER_TAPS / 2 + 1];
+			for (int m = 0; m <= KAISER_TAPS / 2; m++)
+				pairs[m] = _mm256_loadu_ps(pFirst + m * 8);
+			__m256 sum = _mm256_setzero_ps();
+			for (int m = 0; m < KAISER_TAPS / 2; m++)
+			{
+				__m256 even = _mm256_permute2f128_ps(pairs[m], pairs[m + 1], 0x20);
+				__m256 odd = _mm256_permute2f128_ps(pairs[m], pairs[m + 1], 0x31);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(even, weights8[m * 2]));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(odd, weights8[m * 2 + 1]));
+			}
+			_mm256_storeu_ps(a_pOutput + x * 4, sum);
+		}
+#endif
+		for (; x < a_uNewWidth && (size_t)x * 2 + KAISER_TAPS / 2 < a_uWidth; x++)
+			Filter(x);
+		for (; x < a_uNewWidth; x++)
+			FilterClamped(x);
+	}
+
+	/// <summary>
+	/// Filters rows [a_uFirstRow, a_uEndRow) of a new level and stores them as floats and as RGBA8
+	/// </summary>
+	void FilterRows(float* a_pDestination, uint8_t* a_pPixels, SourceRows& a_Source, uint32_t a_uWidth, uint32_t a_uNewWidth,
+		int a_nKind, int a_nFilter, const float a_pWeights[KAISER_TAPS], uint32_t a_uFirstRow, uint32_t a_uEndRow, const ConversionTables& a_Tables)
+	{
+		std::vector<float> vColumns(a_nFilter == MIP_FILTER_KAISER ? (size_t)a_uWidth * 4 : 0);
+		for (uint32_t y = a_uFirstRow; y < a_uEndRow; y++)
+		{
+			float* pOutput = a_pDestination + (size_t)y * a_uNewWidth * 4;
+			if (a_nFilter == MIP_FILTER_KAISER)
+			{
+				const float* rows[KAISER_TAPS];
+				for (int k = 0; k < KAISER_TAPS; k++)
+					rows[k] = a_Source.Row((int64_t)y * 2 - KAISER_TAPS / 2 + 1 + k);
+				KaiserColumns(vColumns.data(), rows, vColumns.size(), a_pWeights);
+				KaiserRow(pOutput, vColumns.data(), a_uWidth, a_uNewWidth, a_pWeights);
+			}
+			else
+				BoxRow(pOutput, a_Source.Row((int64_t)y * 2), a_Source.Row((int64_t)y * 2 + 1), a_uWidth, a_uNewWidth);
+			RowFromFilterSpace(a_pPixels + (size_t)y * a_uNewWidth * 4, pOutput, a_uNewWidth, a_nKind, a_Tables);
+		}
+	}
+
+	/// <summary>
+	/// Splits a level's rows into bands, one per thread, and runs a_Run(first row, end row) on each
+	/// </summary>
+	template <typename RUN>
+	void ForEachBand(uint32_t a_uRows, unsigned int a_uThreads, const RUN& a_Run)
+	{
+		uint32_t uChunkCount = std::max(1u, std::min<uint32_t>(a_uThreads, a_uRows / MIN_CHUNK_ROWS));
+		auto ChunkStart = [&](uint32_t i) { return (uint32_t)((uint64_t)a_uRows * i / uChunkCount); };
+
+		// the calling thread takes the first band
+		auto RunChunk = [&](uint32_t i) { a_Run(ChunkStart(i), ChunkStart(i + 1)); };
+		std::vector<std::thread> vWorkers;
+		for (uint32_t i = 1; i < uChunkCount; i++)
+			vWorkers.emplace_back(RunChunk, i);
+		RunChunk(0);
+		for (auto& t : vWorkers) t.join();
+	}
+
+	/// <summary>
+	/// One channel at a time box filter with a pow per converted value, used as the benchmark's baseline
+	/// </summary>
+	std::vector<DecodedImage> GenerateMipChainScalar(const DecodedImage& a_Image, int a_nKind)
+	{
+		std::vector<DecodedImage> vLevels;
+		vLevels.push_back(a_Image);
+
+		std::vector<float> vSource(a_Image.Pixels.size()), vDestination;
+		for (size_t i = 0; i < a_Image.Pixels.size(); i++)
+		{
+			float fValue = a_Image.Pixels[i] / 255.0f;
+			vSource[i] = (i & 3) == 3 ? fValue : a_nKind == TEXTURE_KIND_COLOR ? SrgbToLinear(fValue) : a_nKind == TEXTURE_KIND_NORMAL ? fValue * 2.0f - 1.0f : fValue;
+		}
+
+		uint32_t uWidth = a_Image.Width, uHeight = a_Image.Height;
+		while (uWidth > 1 || uHeight > 1)
+		{
+			uint32_t uNewWidth = std::max(1u, uWidth / 2), uNewHeight = std::max(1u, uHeight / 2);
+			vDestination.resize((size_t)uNewWidth * uNewHeight * 4);
+			for (uint32_t y = 0; y < uNewHeight; y++)
+			{
+				const float* pRow0 = &vSource[(size_t)std::min(y * 2, uHeight - 1) * uWidth * 4];
+				const float* pRow1 = &vSource[(size_t)std::min(y * 2 + 1, uHeight - 1) * uWidth * 4];
+				float* pOut = &vDestination[(size_t)y * uNewWidth * 4];
+				for (uint32_t x = 0; x < uNewWidth; x++, pOut += 4)
+				{
+					size_t uX0 = (size_t)std::min(x * 2, uWidth - 1) * 4;
+					size_t uX1 = (size_t)std::min(x * 2 + 1, uWidth - 1) * 4;
+					for (int c = 0; c < 4; c++)
+						pOut[c] = (pRow0[uX0 + c] + pRow0[uX1 + c] + pRow1[uX0 + c] + pRow1[uX1 + c]) * 0.25f;
+				}
+			}
+
+			DecodedImage level;
+			level.Width = uNewWidth;
+			level.Height = uNewHeight;
+			level.SRGB = a_Image.SRGB;
+			level.Pixels.resize(vDestination.size());
+			for (size_t i = 0; i < vDestination.size(); i += 4)
+			{
+				const float* pPixel = &vDestination[i];
+				if (a_nKind == TEXTURE_KIND_NORMAL)
+				{
+					float fLength = sqrtf(pPixel[0] * pPixel[0] + pPixel[1] * pPixel[1] + pPixel[2] * pPixel[2]);
+					for (int c = 0; c < 3; c++)
+						level.Pixels[i + c] = ToUnorm8(fLength > 1e-6f ? pPixel[c] / fLength * 0.5f + 0.5f : c == 2 ? 1.0f : 0.5f);
+				}
+				else
+				{
+					for (int c = 0; c < 3; c++)
+						level.Pixels[i + c] = ToUnorm8(a_nKind == TEXTURE_KIND_COLOR ? LinearToSrgb(std::clamp(pPixel[c], 0.0f, 1.0f)) : pPixel[c]);
+				}
+				level.Pixels[i + 3] = ToUnorm8(pPixel[3]);
+			}
+			vLevels.push_back(std::move(level));
+
+			vSource.swap(vDestination);
+			uWidth = uNewWidth;
+			uHeight = uNewHeight;
+		}
+		return vLevels;
+	}
+}
+
+/// <summary>
+/// Builds the full mip chain of an image
+/// </summary>
+/// <param name="a_Image">RGBA8 image, becomes level 0</param>
+/// <param name="a_nKind">TEXTURE_KIND_COLOR, _NORMAL or _DATA</param>
+/// <param name="a_nFilter">MIP_FILTER_BOX or _KAISER</param>
+/// <param name="a_uThreadCount">Upper bound on threads (0 = hardware concurrency)</param>
+/// <returns>Every level from the full size down to 1x1</returns>
+std::vector<DecodedImage> GenerateMipChain(DecodedImage a_Image, int a_nKind, int a_nFilter, unsigned int a_uThreadCount)
+{
+	const ConversionTables& tables = GetConversionTables();
+	unsigned int uThreads = a_uThreadCount ? a_uThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	float weights[KAISER_TAPS];
+	GetKaiserWeights(weights);
+
+	size_t uLevelCount = 1;
+	for (uint32_t uWidth = a_Image.Width, uHeight = a_Image.Height; uWidth > 1 || uHeight > 1; uLevelCount++)
+	{
+		uWidth = std::max(1u, uWidth / 2);
+		uHeight = std::max(1u, uHeight / 2);
+	}
+	std::vector<DecodedImage> vLevels;
+	vLevels.reserve(uLevelCount);
+	vLevels.push_back(std::move(a_Image));
+
+	// level 1 is filtered straight from the 8-bit top level, every later one from the float
+	// copy of the level before it
+	std::vector<float> vSource, vDestination;
+	for (size_t uLevel = 1; uLevel < uLevelCount; uLevel++)
+	{
+		const DecodedImage& above = vLevels[uLevel - 1];
+		DecodedImage level;
+		level.Width = std::max(1u, above.Width / 2);
+		level.Height = std::max(1u, above.Height / 2);
+		level.SRGB = above.SRGB;
+		level.Pixels.resize((size_t)level.Width * level.Height * 4);
+		vDestination.resize(level.Pixels.size());
+
+		ForEachBand(level.Height, uThreads, [&](uint32_t a_uFirstRow, uint32_t a_uEndRow)
+		{
+			SourceRows source(uLevel == 1 ? &above : nullptr, vSource.data(), above.Width, above.Height, a_nKind, tables);
+			FilterRows(vDestination.data(), level.Pixels.data(), source, above.Width, level.Width, a_nKind, a_nFilter, weights,
+				a_uFirstRow, a_uEndRow, tables);
+		});
+		vLevels.push_back(std::move(level));
+		vSource.swap(vDestination);
+	}
+	return vLevels;
+}
+
+/// <summary>
+/// Times the SIMD mip chain against the scalar reference
+/// </summary>
+/// <param name="a_uSize">Width and height of the generated image</param>
+/// <param name="a_uThreadCount">Threads of the threaded runs (0 = hardware concurrency)</param>
+/// <param name="a_uSeed">Seed of the noise</param>
+/// <returns>Timings of every configuration</returns>
+MipChainBenchmark BenchmarkMipChain(uint32_t a_uSize, unsigned int a_uThreadCount, unsigned int a_uSeed)
+{
+	// noise over gradients, so every level has detail and the conversions see every code
+	std::mt19937 random(a_uSeed);
+	std::uniform_int_distribution<int> noise(-32, 32);
+	DecodedImage image;
+	image.Width = image.Height = std::max(1u, a_uSize);
+	image.SRGB = false;
+	image.Pixels.resize((size_t)image.Width * image.Height * 4);
+	for (uint32_t y = 0; y < image.Height; y++)
+		for (uint32_t x = 0; x < image.Width; x++)
+		{
+			uint8_t* pPixel = &image.Pixels[((size_t)y * image.Width + x) * 4];
+			int gradients[3] = { (int)(x * 255ull / image.Width), (int)(y * 255ull / image.Height), (int)((x + y) * 255ull / (image.Width * 2ull)) };
+			for (int c = 0; c < 3; c++)
+				pPixel[c] = (uint8_t)std::clamp(gradients[c] + noise(random), 0, 255);
+			pPixel[3] = 255;
+		}
+
+	MipChainBenchmark result = {};
+	result.Size = image.Width;
+	result.Threads = a_uThreadCount ? a_uThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	result.ScalarMilliseconds = result.BoxMilliseconds = result.BoxThreadedMilliseconds = 1e30;
+	result.KaiserMilliseconds = result.KaiserThreadedMilliseconds = 1e30;
+
+	// GenerateMipChain takes its image by value, so the copy is made outside the timing
+	auto TimeChain = [&](double& a_dBest, int a_nFilter, unsigned int a_uThreads, std::vector<DecodedImage>* a_pChain)
+	{
+		DecodedImage copy = image;
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<DecodedImage> vChain = GenerateMipChain(std::move(copy), TEXTURE_KIND_COLOR, a_nFilter, a_uThreads);
+		auto end = std::chrono::high_resolution_clock::now();
+		a_dBest = std::min(a_dBest, std::chrono::duration<double, std::milli>(end - start).count());
+		if (a_pChain)
+			*a_pChain = std::move(vChain);
+	};
+
+	std::vector<DecodedImage> vReference, vBox;
+	for (int run = 0; run < MIP_BENCHMARK_RUNS; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		vReference = GenerateMipChainScalar(image, TEXTURE_KIND_COLOR);
+		auto end = std::chrono::high_resolution_clock::now();
+		result.ScalarMilliseconds = std::min(result.ScalarMilliseconds, std::chrono::duration<double, std::milli>(end - start).count());
+
+		TimeChain(result.BoxMilliseconds, MIP_FILTER_BOX, 1, &vBox);
+		TimeChain(result.BoxThreadedMilliseconds, MIP_FILTER_BOX, result.Threads, nullptr);
+		TimeChain(result.KaiserMilliseconds, MIP_FILTER_KAISER, 1, nullptr);
+		TimeChain(result.KaiserThreadedMilliseconds, MIP_FILTER_KAISER, result.Threads, nullptr);
+	}
+
+	for (size_t i = 0; i < vReference.size() && i < vBox.size(); i++)
+		for (size_t j = 0; j < vReference[i].Pixels.size(); j++)
+			result.MaxBoxError = std::max(result.MaxBoxError, abs(vReference[i].Pixels[j] - vBox[i].Pixels[j]));
+	return result;
+}
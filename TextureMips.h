@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ImageDecoder.h"
+
+// How the channels of a texture are filtered when it is reduced
+#define TEXTURE_KIND_COLOR	0	// sRGB-encoded color (albedo): RGB averaged in linear light, alpha as is
+#define TEXTURE_KIND_NORMAL	1	// tangent-space normal in RGB: averaged as vectors, then renormalized
+#define TEXTURE_KIND_DATA	2	// linear values (roughness, metalness, ...): averaged as they are
+
+// How each level is filtered down from the one above it
+#define MIP_FILTER_BOX		0	// 2x2 average: cheapest, but soft and lets some aliasing through
+#define MIP_FILTER_KAISER	1	// 8x8 Kaiser-windowed sinc: keeps detail and suppresses aliasing, about 3x the work
+
+// --------------------------------------------------------
+// Result of BenchmarkMipChain
+// --------------------------------------------------------
+struct MipChainBenchmark
+{
+	uint32_t Size;						// width and height of the top level
+	unsigned int Threads;				// threads of the threaded runs
+	double ScalarMilliseconds;			// best of several runs of the one-channel-at-a-time box reference, one thread
+	double BoxMilliseconds;				// SIMD box filter, one thread
+	double BoxThreadedMilliseconds;		// SIMD box filter, Threads threads
+	double KaiserMilliseconds;			// SIMD Kaiser filter, one thread
+	double KaiserThreadedMilliseconds;	// SIMD Kaiser filter, Threads threads
+	int MaxBoxError;					// largest difference between the SIMD and reference box chains, in 8-bit steps
+};
+
+// Builds the full mip chain of an RGBA8 image, from the image itself down to 1x1. Each level
+// halves the previous one (rounding down, never below 1). The chain is filtered at float
+// precision so rounding errors don't add up per level, with SSE (AVX when the build targets it),
+// and each level is split into bands of rows across up to a_uThreadCount threads (0 = hardware
+// concurrency). The image is moved into level 0, so pass it with std::move when it isn't needed.
+std::vector<DecodedImage> GenerateMipChain(DecodedImage a_Image, int a_nKind, int a_nFilter = MIP_FILTER_BOX, unsigned int a_uThreadCount = 0);
+
+// Times GenerateMipChain on an a_uSize x a_uSize color image of noise over gradients, against a
+// scalar reference of the box filter. Needs no device, so it also runs without a window.
+MipChainBenchmark BenchmarkMipChain(uint32_t a_uSize = 4096, unsigned int a_uThreadCount = 0, unsigned int a_uSeed = 1);
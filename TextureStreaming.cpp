@@ -0,0 +1,379 @@
+#include "TextureStreaming.h"
+#include <algorithm>
+#include <cmath>
+#include "DdsFile.h"
+#include "Graphics.h"
+
+namespace
+{
+	/// <summary>
+	/// Creates an immutable texture from a mip chain, starting at one of its levels
+	/// </summary>
+	/// <param name="a_vLevels">Every level of the texture, largest first</param>
+	/// <param name="a_uFirstMip">Level that becomes the texture's top level</param>
+	/// <param name="a_Format">Format of the levels' data</param>
+	/// <param name="a_cpTexture">Receives the texture</param>
+	/// <param name="a_cpSRV">Receives its view</param>
+	/// <returns>Whether both were created</returns>
+	bool CreateLevels(const std::vector<StreamedMipLevel>& a_vLevels, uint32_t a_uFirstMip, DXGI_FORMAT a_Format,
+		Microsoft::WRL::ComPtr<ID3D11Texture2D>& a_cpTexture, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& a_cpSRV)
+	{
+		std::vector<D3D11_SUBRESOURCE_DATA> vData;
+		for (size_t i = a_uFirstMip; i < a_vLevels.size(); i++)
+			vData.push_back({ a_vLevels[i].Data.data(), a_vLevels[i].RowPitch, 0 });
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = a_vLevels[a_uFirstMip].Width;
+		desc.Height = a_vLevels[a_uFirstMip].Height;
+		desc.MipLevels = (UINT)vData.size();
+		desc.ArraySize = 1;
+		desc.Format = a_Format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		a_cpTexture.Reset();
+		a_cpSRV.Reset();
+		if (FAILED(Graphics::Device->CreateTexture2D(&desc, vData.data(), a_cpTexture.GetAddressOf())))
+			return false;
+		return SUCCEEDED(Graphics::Device->CreateShaderResourceView(a_cpTexture.Get(), nullptr, a_cpSRV.GetAddressOf()));
+	}
+}
+
+/// <summary>
+/// Starts the worker threads
+/// </summary>
+/// <param name="a_uBudgetBytes">Video memory the streamed textures may fill</param>
+TextureStreamer::TextureStreamer(size_t a_uBudgetBytes)
+{
+	m_uBudgetBytes = a_uBudgetBytes;
+	m_uResidentBytes = 0;
+	m_uPendingBytes = 0;
+	m_uFullBytes = 0;
+	m_uFrame = 0;
+	m_uPending = 0;
+	m_uStreamedLevels = 0;
+	m_uEvictedLevels = 0;
+	m_bStopping = false;
+
+	for (unsigned int i = 0; i < TEXTURE_STREAMING_THREADS; i++)
+		m_vWorkers.emplace_back(&TextureStreamer::WorkerMain, this);
+}
+
+/// <summary>
+/// Stops the workers, dropping any stream-in that hasn't started
+/// </summary>
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStopping = true;
+	}
+	m_WorkAvailable.notify_all();
+	for (std::thread& worker : m_vWorkers)
+		worker.join();
+}
+
+/// <summary>
+/// Takes over a loaded texture: creates it with only its low levels and points the handle at that
+/// </summary>
+/// <param name="a_spTexture">Handle materials draw the texture through</param>
+/// <param name="a_Format">Format of the levels' data</param>
+/// <param name="a_vLevels">Every level of the texture, largest first, each half the one before</param>
+/// <returns>False if the texture couldn't be created, in which case the handle is unchanged</returns>
+bool TextureStreamer::AddTexture(std::shared_ptr<TextureAsset> a_spTexture, DXGI_FORMAT a_Format, std::vector<StreamedMipLevel> a_vLevels)
+{
+	if (a_vLevels.empty() || m_htIndices.count(a_spTexture.get()))
+		return false;
+
+	StreamedTexture texture = {};
+	texture.Handle = a_spTexture;
+	texture.Format = a_Format;
+	texture.BlockCompressed = GetDdsBlockSize((uint32_t)a_Format) != 0;
+	texture.Levels = std::make_shared<const std::vector<StreamedMipLevel>>(std::move(a_vLevels));
+
+	// the first level no larger than the resident size that a texture can start at
+	const std::vector<StreamedMipLevel>& vLevels = *texture.Levels;
+	uint32_t uMip = 0;
+	while (uMip + 1 < vLevels.size() && (std::max)(vLevels[uMip].Width, vLevels[uMip].Height) > TEXTURE_STREAMING_RESIDENT_SIZE)
+		uMip++;
+	while (uMip > 0 && !CanStartAt(texture, uMip))
+		uMip--;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cpSRV;
+	if (!CreateLevels(vLevels, uMip, a_Format, texture.Texture, cpSRV))
+		return false;
+
+	texture.MinResidentMip = uMip;
+	texture.ResidentMip = uMip;
+	texture.WantedMip = uMip;
+	texture.LastUsedFrame = m_uFrame;
+	a_spTexture->SRV = cpSRV;
+	a_spTexture->Loaded = true;
+
+	m_uResidentBytes += BytesFrom(texture, uMip);
+	m_uFullBytes += BytesFrom(texture, 0);
+	m_htIndices[a_spTexture.get()] = m_vTextures.size();
+	m_vTextures.push_back(std::move(texture));
+	return true;
+}
+
+/// <summary>
+/// Tells the streamer a texture is drawn this frame and how large. Call for every texture of
+/// every visible entity before Update(); the largest request of the frame counts.
+/// </summary>
+/// <param name="a_spTexture">Texture handle, ignored if the streamer doesn't manage it</param>
+/// <param name="a_fTexelsOnScreen">Pixels one repeat of the texture spans on screen, along its longer side</param>
+void TextureStreamer::RequestDetail(const std::shared_ptr<TextureAsset>& a_spTexture, float a_fTexelsOnScreen)
+{
+	auto it = m_htIndices.find(a_spTexture.get());
+	if (it == m_htIndices.end())
+		return;
+
+	StreamedTexture& texture = m_vTextures[it->second];
+	if (texture.LastUsedFrame != m_uFrame)
+		texture.TexelsOnScreen = 0.0f;
+	texture.TexelsOnScreen = (std::max)(texture.TexelsOnScreen, a_fTexelsOnScreen);
+	texture.LastUsedFrame = m_uFrame;
+}
+
+/// <summary>
+/// Swaps in the stream-ins the workers finished, evicts levels while over budget and queues
+/// stream-ins for the textures drawn this frame. Call once per frame on the main thread.
+/// </summary>
+void TextureStreamer::Update()
+{
+	std::vector<Job> vFinished;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		vFinished.swap(m_vFinished);
+	}
+
+	// a pending texture is never evicted, so it still holds the levels the job was planned against
+	for (Job& job : vFinished)
+	{
+		StreamedTexture& texture = m_vTextures[job.TextureIndex];
+		texture.Pending = false;
+		m_uPendingBytes -= job.Bytes;
+		m_uPending--;
+		if (job.SRV && job.FirstMip < texture.ResidentMip)
+		{
+			m_uResidentBytes += job.Bytes;
+			m_uStreamedLevels += texture.ResidentMip - job.FirstMip;
+			texture.ResidentMip = job.FirstMip;
+			texture.Texture = job.Texture;
+			texture.Handle->SRV = job.SRV;
+		}
+	}
+
+	// what the textures drawn this frame need; the rest keep what they have until the budget runs out
+	size_t uNeededBytes = 0;
+	for (StreamedTexture& texture : m_vTextures)
+	{
+		bool bUsed = texture.LastUsedFrame == m_uFrame;
+		texture.WantedMip = bUsed ? MipForTexels(texture, texture.TexelsOnScreen) : texture.MinResidentMip;
+		if (bUsed && !texture.Pending && texture.WantedMip < texture.ResidentMip)
+			uNeededBytes += BytesFrom(texture, texture.WantedMip) - BytesFrom(texture, texture.ResidentMip);
+	}
+
+	// least recently used first; textures drawn this frame only give up the levels they don't need
+	std::vector<size_t> vByAge;
+	for (size_t i = 0; i < m_vTextures.size(); i++)
+		if (!m_vTextures[i].Pending && m_vTextures[i].ResidentMip < m_vTextures[i].WantedMip)
+			vByAge.push_back(i);
+	std::sort(vByAge.begin(), vByAge.end(), [this](size_t a, size_t b) { return m_vTextures[a].LastUsedFrame < m_vTextures[b].LastUsedFrame; });
+
+	for (size_t uIndex : vByAge)
+	{
+		if (m_uResidentBytes + m_uPendingBytes + uNeededBytes <= m_uBudgetBytes)
+			break;
+
+		// drop one level at a time, only as far as it takes to fit
+		StreamedTexture& texture = m_vTextures[uIndex];
+		uint32_t uMip = texture.ResidentMip;
+		size_t uFreed = 0;
+		while (uMip < texture.WantedMip && m_uResidentBytes + m_uPendingBytes + uNeededBytes - uFreed > m_uBudgetBytes)
+		{
+			do { uMip++; } while (uMip < texture.WantedMip && !CanStartAt(texture, uMip));
+			uFreed = BytesFrom(texture, texture.ResidentMip) - BytesFrom(texture, uMip);
+		}
+		Evict(texture, uMip);
+	}
+
+	// queue what fits, settling for less detail where the whole request doesn't
+	for (size_t i = 0; i < m_vTextures.size(); i++)
+	{
+		StreamedTexture& texture = m_vTextures[i];
+		if (texture.LastUsedFrame != m_uFrame || texture.Pending || texture.WantedMip >= texture.ResidentMip)
+			continue;
+
+		uint32_t uMip = texture.WantedMip;
+		size_t uBytes = BytesFrom(texture, uMip) - BytesFrom(texture, texture.ResidentMip);
+		while (uMip < texture.ResidentMip && m_uResidentBytes + m_uPendingBytes + uBytes > m_uBudgetBytes)
+		{
+			do { uMip++; } while (uMip < texture.ResidentMip && !CanStartAt(texture, uMip));
+			uBytes = BytesFrom(texture, uMip) - BytesFrom(texture, texture.ResidentMip);
+		}
+		if (uMip >= texture.ResidentMip)
+			continue;
+
+		Job job = {};
+		job.TextureIndex = i;
+		job.FirstMip = uMip;
+		job.Bytes = uBytes;
+		job.Format = texture.Format;
+		job.Levels = texture.Levels;
+		texture.Pending = true;
+		m_uPendingBytes += uBytes;
+		m_uPending++;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_dQueued.push_back(std::move(job));
+		}
+		m_WorkAvailable.notify_one();
+	}
+
+	m_uFrame++;
+}
+
+/// <summary>
+/// Worker loop: creates the textures of stream-in requests until the streamer is destroyed
+/// </summary>
+void TextureStreamer::WorkerMain()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkAvailable.wait(lock, [this] { return m_bStopping || !m_dQueued.empty(); });
+			if (m_bStopping)
+				break;
+			job = std::move(m_dQueued.front());
+			m_dQueued.pop_front();
+		}
+
+		// a failed job comes back without a view, and the texture keeps the levels it has
+		CreateLevels(*job.Levels, job.FirstMip, job.Format, job.Texture, job.SRV);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_vFinished.push_back(std::move(job));
+	}
+}
+
+/// <summary>
+/// Drops a texture's top levels: copies the ones it keeps into a smaller texture and swaps that in
+/// </summary>
+/// <param name="a_Texture">Texture that isn't pending</param>
+/// <param name="a_uFirstMip">Level that becomes the top level, one it can start at</param>
+void TextureStreamer::Evict(StreamedTexture& a_Texture, uint32_t a_uFirstMip)
+{
+	if (a_uFirstMip <= a_Texture.ResidentMip)
+		return;
+
+	const std::vector<StreamedMipLevel>& vLevels = *a_Texture.Levels;
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = vLevels[a_uFirstMip].Width;
+	desc.Height = vLevels[a_uFirstMip].Height;
+	desc.MipLevels = (UINT)(vLevels.size() - a_uFirstMip);
+	desc.ArraySize = 1;
+	desc.Format = a_Texture.Format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	// the levels are already in video memory, so they are copied there rather than uploaded again
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cpTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cpSRV;
+	if (FAILED(Graphics::Device->CreateTexture2D(&desc, nullptr, cpTexture.GetAddressOf())) ||
+		FAILED(Graphics::Device->CreateShaderResourceView(cpTexture.Get(), nullptr, cpSRV.GetAddressOf())))
+		return;
+	UINT uSourceMips = (UINT)(vLevels.size() - a_Texture.ResidentMip);
+	for (UINT i = 0; i < desc.MipLevels; i++)
+		Graphics::Context->CopySubresourceRegion(cpTexture.Get(), D3D11CalcSubresource(i, 0, desc.MipLevels), 0, 0, 0,
+			a_Texture.Texture.Get(), D3D11CalcSubresource(a_uFirstMip - a_Texture.ResidentMip + i, 0, uSourceMips), nullptr);
+
+	m_uResidentBytes -= BytesFrom(a_Texture, a_Texture.ResidentMip) - BytesFrom(a_Texture, a_uFirstMip);
+	m_uEvictedLevels += a_uFirstMip - a_Texture.ResidentMip;
+	a_Texture.ResidentMip = a_uFirstMip;
+	a_Texture.Texture = cpTexture;
+	a_Texture.Handle->SRV = cpSRV;
+}
+
+/// <summary>
+/// Finds the level a texture needs to cover so many pixels without magnifying
+/// </summary>
+/// <param name="a_Texture">Texture</param>
+/// <param name="a_fTexelsOnScreen">Pixels its longer side spans on screen</param>
+/// <returns>Level it can start at, never less detailed than the always resident one</returns>
+uint32_t TextureStreamer::MipForTexels(const StreamedTexture& a_Texture, float a_fTexelsOnScreen)
+{
+	const StreamedMipLevel& top = (*a_Texture.Levels)[0];
+	float fLargest = (float)(std::max)(top.Width, top.Height);
+	if (a_fTexelsOnScreen <= 0.0f)
+		return a_Texture.MinResidentMip;
+
+	float fMip = std::floor(std::log2(fLargest / a_fTexelsOnScreen));
+	uint32_t uMip = fMip <= 0.0f ? 0 : (std::min)((uint32_t)fMip, a_Texture.MinResidentMip);
+	while (uMip > 0 && !CanStartAt(a_Texture, uMip))
+		uMip--;
+	return uMip;
+}
+
+/// <summary>
+/// Whether a texture can be created with a level as its top level; block compressed
+/// textures need a top level that is a whole number of blocks
+/// </summary>
+bool TextureStreamer::CanStartAt(const StreamedTexture& a_Texture, uint32_t a_uMip)
+{
+	const StreamedMipLevel& level = (*a_Texture.Levels)[a_uMip];
+	return !a_Texture.BlockCompressed || (level.Width % 4 == 0 && level.Height % 4 == 0);
+}
+
+/// <summary>
+/// Video memory a texture takes with a level as its top level
+/// </summary>
+size_t TextureStreamer::BytesFrom(const StreamedTexture& a_Texture, uint32_t a_uFirstMip)
+{
+	size_t uBytes = 0;
+	for (size_t i = a_uFirstMip; i < a_Texture.Levels->size(); i++)
+		uBytes += (*a_Texture.Levels)[i].Data.size();
+	return uBytes;
+}
+
+#pragma region Getters
+/// <summary>
+/// Gets the video memory the streamed textures may fill
+/// </summary>
+/// <returns>Budget in bytes</returns>
+size_t TextureStreamer::GetBudget()
+{
+	return m_uBudgetBytes;
+}
+/// <summary>
+/// Gets what the streamer holds and is doing
+/// </summary>
+/// <returns>Streaming stats</returns>
+TextureStreamingStats TextureStreamer::GetStats()
+{
+	TextureStreamingStats stats = {};
+	stats.BudgetBytes = m_uBudgetBytes;
+	stats.ResidentBytes = m_uResidentBytes;
+	stats.FullBytes = m_uFullBytes;
+	stats.Textures = (unsigned int)m_vTextures.size();
+	stats.PendingRequests = m_uPending;
+	stats.StreamedLevels = m_uStreamedLevels;
+	stats.EvictedLevels = m_uEvictedLevels;
+	return stats;
+}
+#pragma endregion
+#pragma region Setters
+/// <summary>
+/// Sets the video memory the streamed textures may fill; a smaller budget evicts on the next Update()
+/// </summary>
+/// <param name="a_uBudgetBytes">Budget in bytes</param>
+void TextureStreamer::SetBudget(size_t a_uBudgetBytes)
+{
+	m_uBudgetBytes = a_uBudgetBytes;
+}
+#pragma endregion
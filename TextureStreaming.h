@@ -0,0 +1,133 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "TextureAsset.h"
+
+// Video memory the streamed textures may fill before their least recently used levels are evicted
+#define TEXTURE_STREAMING_DEFAULT_BUDGET_MB 256
+
+// Levels this size (along their longer side) and smaller are always resident; a streamed
+// texture starts out with only these
+#define TEXTURE_STREAMING_RESIDENT_SIZE 128
+
+// Threads that create the textures of stream-in requests
+#define TEXTURE_STREAMING_THREADS 2
+
+// --------------------------------------------------------
+// One mip level of a streamed texture, kept in system memory
+// --------------------------------------------------------
+struct StreamedMipLevel
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t RowPitch;			// bytes per row of pixels (or of 4x4 blocks)
+	std::vector<uint8_t> Data;
+};
+
+// --------------------------------------------------------
+// What the streamer holds and is doing
+// --------------------------------------------------------
+struct TextureStreamingStats
+{
+	size_t BudgetBytes;
+	size_t ResidentBytes;			// levels in video memory now
+	size_t FullBytes;				// if every level of every texture were resident
+	unsigned int Textures;
+	unsigned int PendingRequests;	// stream-ins queued or being created
+	unsigned int StreamedLevels;	// levels streamed in so far
+	unsigned int EvictedLevels;		// levels evicted so far
+};
+
+// --------------------------------------------------------
+// Keeps the top mip levels of textures out of video memory
+// until something on screen needs them. Every level stays in
+// system memory; a texture starts with the levels up to
+// TEXTURE_STREAMING_RESIDENT_SIZE, and each frame the game
+// says how many texels of it cover the screen. Update() then
+// has worker threads create the texture again with the
+// levels that are wanted, and swaps it into the TextureAsset
+// once it is ready. Past the budget, textures that weren't
+// drawn lose their top levels first, least recently used
+// first.
+// --------------------------------------------------------
+class TextureStreamer
+{
+public:
+	TextureStreamer(size_t a_uBudgetBytes = (size_t)TEXTURE_STREAMING_DEFAULT_BUDGET_MB << 20);
+	~TextureStreamer();
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	bool AddTexture(std::shared_ptr<TextureAsset> a_spTexture, DXGI_FORMAT a_Format, std::vector<StreamedMipLevel> a_vLevels);
+	void RequestDetail(const std::shared_ptr<TextureAsset>& a_spTexture, float a_fTexelsOnScreen);
+	void Update();
+
+	// getters
+	size_t GetBudget();
+	TextureStreamingStats GetStats();
+
+	// setters
+	void SetBudget(size_t a_uBudgetBytes);
+
+private:
+	// A texture the streamer manages
+	struct StreamedTexture
+	{
+		std::shared_ptr<TextureAsset> Handle;
+		DXGI_FORMAT Format;
+		bool BlockCompressed;
+		std::shared_ptr<const std::vector<StreamedMipLevel>> Levels; // every level, read by the workers too
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture; // holds levels ResidentMip and below
+		uint32_t ResidentMip;		// most detailed level in video memory
+		uint32_t MinResidentMip;	// most detailed level that is always resident
+		uint32_t WantedMip;			// what it last covered on screen needs
+		bool Pending;				// a stream-in is queued or being created
+		uint64_t LastUsedFrame;
+		float TexelsOnScreen;		// largest request this frame
+	};
+
+	// One stream-in, handed from the main thread to a worker and back
+	struct Job
+	{
+		size_t TextureIndex;
+		uint32_t FirstMip;
+		size_t Bytes;				// video memory it adds
+		DXGI_FORMAT Format;
+		std::shared_ptr<const std::vector<StreamedMipLevel>> Levels;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+	};
+
+	std::vector<StreamedTexture> m_vTextures; //main thread only
+	std::unordered_map<const TextureAsset*, size_t> m_htIndices;
+	size_t m_uBudgetBytes;
+	size_t m_uResidentBytes;
+	size_t m_uPendingBytes; //what the queued stream-ins will add
+	size_t m_uFullBytes;
+	uint64_t m_uFrame;
+	unsigned int m_uPending;
+	unsigned int m_uStreamedLevels;
+	unsigned int m_uEvictedLevels;
+
+	std::vector<std::thread> m_vWorkers;
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkAvailable;
+	std::deque<Job> m_dQueued; //waiting for a worker
+	std::vector<Job> m_vFinished; //waiting for Update()
+	bool m_bStopping;
+
+	void WorkerMain();
+	void Evict(StreamedTexture& a_Texture, uint32_t a_uFirstMip);
+	uint32_t MipForTexels(const StreamedTexture& a_Texture, float a_fTexelsOnScreen);
+	bool CanStartAt(const StreamedTexture& a_Texture, uint32_t a_uMip);
+	size_t BytesFrom(const StreamedTexture& a_Texture, uint32_t a_uFirstMip);
+};
@@ -0,0 +1,75 @@
+#include "TextureUpload.h"
+#include "Graphics.h"
+
+namespace
+{
+	/// <summary>
+	/// Creates an immutable texture (array) from the levels of one or more mip chains
+	/// </summary>
+	/// <param name="a_vChains">Chain of every array slice, all the same size</param>
+	/// <param name="a_bCubemap">Whether the six slices are the faces of a cubemap</param>
+	/// <returns>Texture view, null on failure</returns>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateFromChains(const std::vector<const std::vector<DecodedImage>*>& a_vChains, bool a_bCubemap)
+	{
+		const std::vector<DecodedImage>& first = *a_vChains[0];
+		if (first.empty())
+			return nullptr;
+
+		// subresources are ordered slice by slice, each with all of its levels
+		std::vector<D3D11_SUBRESOURCE_DATA> vData;
+		for (const std::vector<DecodedImage>* pChain : a_vChains)
+		{
+			if (pChain->size() != first.size())
+				return nullptr;
+			for (size_t i = 0; i < pChain->size(); i++)
+			{
+				const DecodedImage& level = (*pChain)[i];
+				if (level.Width != first[i].Width || level.Height != first[i].Height)
+					return nullptr;
+				vData.push_back({ level.Pixels.data(), level.Width * 4, 0 });
+			}
+		}
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = first[0].Width;
+		desc.Height = first[0].Height;
+		desc.MipLevels = (UINT)first.size();
+		desc.ArraySize = (UINT)a_vChains.size();
+		desc.Format = first[0].SRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = a_bCubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> cpTexture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cpSRV;
+		if (SUCCEEDED(Graphics::Device->CreateTexture2D(&desc, vData.data(), cpTexture.GetAddressOf())))
+			Graphics::Device->CreateShaderResourceView(cpTexture.Get(), nullptr, cpSRV.GetAddressOf());
+		return cpSRV;
+	}
+}
+
+/// <summary>
+/// Creates a texture with every level of a mip chain
+/// </summary>
+/// <param name="a_vMips">Levels from the full size down to 1x1</param>
+/// <returns>Texture view, null on failure</returns>
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateMippedTexture(const std::vector<DecodedImage>& a_vMips)
+{
+	return CreateFromChains({ &a_vMips }, false);
+}
+
+/// <summary>
+/// Creates a cubemap with every level of its faces' mip chains
+/// </summary>
+/// <param name="a_vFaces">Chains of +X, -X, +Y, -Y, +Z, -Z</param>
+/// <returns>Texture view, null on failure</returns>
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateMippedCubemap(const std::vector<std::vector<DecodedImage>>& a_vFaces)
+{
+	if (a_vFaces.size() != 6)
+		return nullptr;
+	std::vector<const std::vector<DecodedImage>*> vChains;
+	for (const std::vector<DecodedImage>& face : a_vFaces)
+		vChains.push_back(&face);
+	return CreateFromChains(vChains, true);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include "ImageDecoder.h"
+
+// Creates an immutable texture from a mip chain built on the CPU (see GenerateMipChain), every
+// level uploaded at creation. Returns null if the device can't create it.
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateMippedTexture(const std::vector<DecodedImage>& a_vMips);
+
+// Creates an immutable cubemap from the mip chains of its six faces (+X, -X, +Y, -Y, +Z, -Z).
+// Returns null if the faces differ in size or the device can't create it.
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateMippedCubemap(const std::vector<std::vector<DecodedImage>>& a_vFaces);
@@ -2,18 +2,49 @@
 
 #include <DirectXMath.h>
 #include "Transform.h"
+#include <algorithm>
+#include <cmath>
 
-Transform::Transform()
+namespace
 {
-	m_f3Position = DirectX::XMFLOAT3();
-	m_f3Rotation = DirectX::XMFLOAT3();
-	m_f3Scale = DirectX::XMFLOAT3(1,1,1); // scale is (1,1,1) not (0,0,0)
+	/// <summary>
+	/// Finds the pitch, yaw and roll that XMQuaternionRotationRollPitchYaw turns into the given
+	/// rotation, by reading them back out of its rotation matrix (roll, then pitch, then yaw)
+	/// </summary>
+	DirectX::XMFLOAT3 PitchYawRollOf(const DirectX::XMFLOAT4& a_f4Quaternion)
+	{
+		float x = a_f4Quaternion.x, y = a_f4Quaternion.y, z = a_f4Quaternion.z, w = a_f4Quaternion.w;
+		float fSinPitch = (std::max)(-1.0f, (std::min)(1.0f, 2.0f * (x * w - y * z)));
+		float fPitch = asinf(fSinPitch);
 
-	DirectX::XMStoreFloat4x4(&m_m4World, DirectX::XMMatrixIdentity());
-	DirectX::XMStoreFloat4x4(&m_m4WorldInverseTranspose, DirectX::XMMatrixIdentity());
+		// looking straight up or down, yaw and roll turn about the same axis: put it all in yaw
+		if (fabsf(fSinPitch) > 0.99999f)
+			return DirectX::XMFLOAT3(fPitch, atan2f(-2.0f * (x * z - y * w), 1.0f - 2.0f * (y * y + z * z)), 0.0f);
 
-	m_bDirty = false;
+		return DirectX::XMFLOAT3(fPitch,
+			atan2f(2.0f * (x * z + y * w), 1.0f - 2.0f * (x * x + y * y)),
+			atan2f(2.0f * (x * y + z * w), 1.0f - 2.0f * (x * x + z * z)));
+	}
+}
 
+Transform::Transform() : Transform(TransformHierarchy::GetDefault())
+{
+}
+
+/// <summary>
+/// Creates a root transform (identity, scale is (1,1,1) not (0,0,0)) in the given hierarchy
+/// </summary>
+/// <param name="a_spHierarchy">Hierarchy to create the node in</param>
+Transform::Transform(std::shared_ptr<TransformHierarchy> a_spHierarchy)
+{
+	m_spHierarchy = a_spHierarchy;
+	m_uNode = m_spHierarchy->Create();
+	m_bBasisDirty = true;
+}
+
+Transform::~Transform()
+{
+	m_spHierarchy->Destroy(m_uNode);
 }
 
 #pragma region Setters
@@ -25,8 +56,7 @@ Transform::Transform()
 /// <param name="a_fZPosition">New z position</param>
 void Transform::SetPosition(float a_fXPosition, float a_fYPosition, float a_fZPosition)
 {
-	m_f3Position = DirectX::XMFLOAT3(a_fXPosition, a_fYPosition, a_fZPosition);
-	m_bDirty = true;
+	m_spHierarchy->SetPosition(m_uNode, DirectX::XMFLOAT3(a_fXPosition, a_fYPosition, a_fZPosition));
 }
 /// <summary>
 /// Sets the position of the transform to the given position
@@ -34,8 +64,7 @@ void Transform::SetPosition(float a_fXPosition, float a_fYPosition, float a_fZPo
 /// <param name="a_f3Position">New position</param>
 void Transform::SetPosition(DirectX::XMFLOAT3 a_f3Position)
 {
-	m_f3Position = DirectX::XMFLOAT3(a_f3Position);
-	m_bDirty = true;
+	m_spHierarchy->SetPosition(m_uNode, a_f3Position);
 }
 /// <summary>
 /// Sets the rotation of the transform to the given pitch, yaw, and roll values
@@ -45,8 +74,10 @@ void Transform::SetPosition(DirectX::XMFLOAT3 a_f3Position)
 /// <param name="a_fRoll">New roll</param>
 void Transform::SetRotation(float a_fPitch, float a_fYaw, float a_fRoll)
 {
-	m_f3Rotation = DirectX::XMFLOAT3(a_fPitch, a_fYaw, a_fRoll);
-	m_bDirty = true;
+	DirectX::XMFLOAT4 f4Rotation;
+	DirectX::XMStoreFloat4(&f4Rotation, DirectX::XMQuaternionRotationRollPitchYaw(a_fPitch, a_fYaw, a_fRoll));
+	m_spHierarchy->SetRotation(m_uNode, f4Rotation);
+	m_bBasisDirty = true;
 }
 /// <summary>
 /// Sets the rotation of the transform to the given rotation
@@ -54,8 +85,16 @@ void Transform::SetRotation(float a_fPitch, float a_fYaw, float a_fRoll)
 /// <param name="a_f3Rotation">New rotation</param>
 void Transform::SetRotation(DirectX::XMFLOAT3 a_f3Rotation)
 {
-	m_f3Rotation = a_f3Rotation;
-	m_bDirty = true;
+	SetRotation(a_f3Rotation.x, a_f3Rotation.y, a_f3Rotation.z);
+}
+/// <summary>
+/// Sets the rotation of the transform to the given quaternion
+/// </summary>
+/// <param name="a_f4Rotation">New rotation, normalized</param>
+void Transform::SetRotationQuaternion(DirectX::XMFLOAT4 a_f4Rotation)
+{
+	m_spHierarchy->SetRotation(m_uNode, a_f4Rotation);
+	m_bBasisDirty = true;
 }
 /// <summary>
 /// Sets the scale of the transform to the given x, y and z values
@@ -65,8 +104,7 @@ void Transform::SetRotation(DirectX::XMFLOAT3 a_f3Rotation)
 /// <param name="a_fZScale">New Z scale</param>
 void Transform::SetScale(float a_fXScale, float a_fYScale, float a_fZScale)
 {
-	m_f3Scale = DirectX::XMFLOAT3(a_fXScale, a_fYScale, a_fZScale);
-	m_bDirty = true;
+	m_spHierarchy->SetScale(m_uNode, DirectX::XMFLOAT3(a_fXScale, a_fYScale, a_fZScale));
 }
 /// <summary>
 /// Sets the scale of the transform to the given scale
@@ -74,8 +112,20 @@ void Transform::SetScale(float a_fXScale, float a_fYScale, float a_fZScale)
 /// <param name="a_f3Scale">New Scale</param>
 void Transform::SetScale(DirectX::XMFLOAT3 a_f3Scale)
 {
-	m_f3Scale = a_f3Scale;
-	m_bDirty = true;
+	m_spHierarchy->SetScale(m_uNode, a_f3Scale);
+}
+/// <summary>
+/// Attaches the transform to a parent in the same hierarchy, after which its position, rotation
+/// and scale are relative to the parent's. Does nothing if that would make a loop.
+/// </summary>
+/// <param name="a_spParent">New parent, nullptr to detach the transform</param>
+void Transform::SetParent(std::shared_ptr<Transform> a_spParent)
+{
+	if (a_spParent && a_spParent->m_spHierarchy != m_spHierarchy)
+		return;
+
+	if (m_spHierarchy->SetParent(m_uNode, a_spParent ? a_spParent->m_uNode : TRANSFORM_NONE))
+		m_spParent = a_spParent;
 }
 #pragma endregion
 #pragma region Getters
@@ -85,11 +135,8 @@ void Transform::SetScale(DirectX::XMFLOAT3 a_f3Scale)
 /// <returns>Right vector</returns>
 DirectX::XMFLOAT3 Transform::GetRight()
 {
-	DirectX::XMVECTOR xvWorldRight = DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
-	DirectX::XMVECTOR xvRotation = DirectX::XMQuaternionRotationRollPitchYaw(m_f3Rotation.x, m_f3Rotation.y, m_f3Rotation.z);
-	DirectX::XMFLOAT3 f3LocalRight;
-	XMStoreFloat3(&f3LocalRight, DirectX::XMVector3Rotate(xvWorldRight, xvRotation));
-	return f3LocalRight;
+	UpdateBasis();
+	return m_f3Right;
 }
 /// <summary>
 /// Gets the transform's up vector
@@ -97,11 +144,8 @@ DirectX::XMFLOAT3 Transform::GetRight()
 /// <returns>Up vector</returns>
 DirectX::XMFLOAT3 Transform::GetUp()
 {
-	DirectX::XMVECTOR xvWorldUp = DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-	DirectX::XMVECTOR xvRotation = DirectX::XMQuaternionRotationRollPitchYaw(m_f3Rotation.x, m_f3Rotation.y, m_f3Rotation.z);
-	DirectX::XMFLOAT3 f3LocalUp;
-	XMStoreFloat3(&f3LocalUp, DirectX::XMVector3Rotate(xvWorldUp, xvRotation));
-	return f3LocalUp;
+	UpdateBasis();
+	return m_f3Up;
 }
 /// <summary>
 /// Gets the transform's forward vector
@@ -109,11 +153,8 @@ DirectX::XMFLOAT3 Transform::GetUp()
 /// <returns>Forward vector</returns>
 DirectX::XMFLOAT3 Transform::GetForward()
 {
-	DirectX::XMVECTOR xvWorldForward = DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-	DirectX::XMVECTOR xvRotation = DirectX::XMQuaternionRotationRollPitchYaw(m_f3Rotation.x, m_f3Rotation.y, m_f3Rotation.z);
-	DirectX::XMFLOAT3 f3LocalForward;
-	XMStoreFloat3(&f3LocalForward, DirectX::XMVector3Rotate(xvWorldForward, xvRotation));
-	return f3LocalForward;
+	UpdateBasis();
+	return m_f3Forward;
 }
 /// <summary>
 /// Gets the transform's current position
@@ -121,7 +162,7 @@ DirectX::XMFLOAT3 Transform::GetForward()
 /// <returns>Current position</returns>
 DirectX::XMFLOAT3 Transform::GetPosition()
 {
-	return m_f3Position;
+	return m_spHierarchy->GetLocal(m_uNode).Position;
 }
 /// <summary>
 /// Gets the transform's current rotation
@@ -129,7 +170,15 @@ DirectX::XMFLOAT3 Transform::GetPosition()
 /// <returns>Current rotation</returns>
 DirectX::XMFLOAT3 Transform::GetPitchYawRoll()
 {
-	return m_f3Rotation;
+	return PitchYawRollOf(m_spHierarchy->GetLocal(m_uNode).Rotation);
+}
+/// <summary>
+/// Gets the transform's current rotation as it is stored
+/// </summary>
+/// <returns>Current rotation quaternion</returns>
+DirectX::XMFLOAT4 Transform::GetRotationQuaternion()
+{
+	return m_spHierarchy->GetLocal(m_uNode).Rotation;
 }
 /// <summary>
 /// Gets the transform's current scale
@@ -137,7 +186,40 @@ DirectX::XMFLOAT3 Transform::GetPitchYawRoll()
 /// <returns>Current scale</returns>
 DirectX::XMFLOAT3 Transform::GetScale()
 {
-	return m_f3Scale;
+	return m_spHierarchy->GetLocal(m_uNode).Scale;
+}
+/// <summary>
+/// Gets a counter that changes every time the world matrix does (including when a parent
+/// moves), so cached values derived from it can tell when to update
+/// </summary>
+/// <returns>Version of the transform</returns>
+unsigned int Transform::GetVersion()
+{
+	return m_spHierarchy->GetVersion(m_uNode);
+}
+/// <summary>
+/// Gets the transform this one is attached to
+/// </summary>
+/// <returns>Parent, nullptr for a root</returns>
+std::shared_ptr<Transform> Transform::GetParent()
+{
+	return m_spParent;
+}
+/// <summary>
+/// Gets the hierarchy the transform's node is in
+/// </summary>
+/// <returns>Hierarchy</returns>
+std::shared_ptr<TransformHierarchy> Transform::GetHierarchy()
+{
+	return m_spHierarchy;
+}
+/// <summary>
+/// Gets the id of the transform's node in its hierarchy
+/// </summary>
+/// <returns>Node id</returns>
+uint32_t Transform::GetNode()
+{
+	return m_uNode;
 }
 /// <summary>
 /// Gets the transform's world matrix
@@ -145,51 +227,15 @@ DirectX::XMFLOAT3 Transform::GetScale()
 /// <returns>World matrix</returns>
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	// if the transform is dirty, recalculate it
-	if (m_bDirty)
-	{
-		DirectX::XMMATRIX t = DirectX::XMMatrixTranslation(m_f3Position.x, m_f3Position.y, m_f3Position.z);
-		DirectX::XMMATRIX r = DirectX::XMMatrixRotationRollPitchYaw(m_f3Rotation.x, m_f3Rotation.y, m_f3Rotation.z);
-		DirectX::XMMATRIX s = DirectX::XMMatrixScaling(m_f3Scale.x, m_f3Scale.y, m_f3Scale.z);
-
-		// calculate the matrix
-		DirectX::XMMATRIX world = s * r * t;
-
-		//store it (and inverse)
-		XMStoreFloat4x4(&m_m4World, world);
-		XMStoreFloat4x4(&m_m4WorldInverseTranspose,XMMatrixInverse(0, XMMatrixTranspose(world)));
-
-		// transform is no longer dirty
-		m_bDirty = false;
-	}
-
-	return m_m4World;
+	return m_spHierarchy->GetWorldMatrix(m_uNode);
 }
 /// <summary>
-/// Gets the transpose of the transform's world matrix
+/// Gets the inverse transpose of the transform's world matrix
 /// </summary>
-/// <returns>Transposed world matrix</returns>
+/// <returns>Inverse transposed world matrix</returns>
 DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
-	// if the transform is dirty, recalculate it
-	if (m_bDirty)
-	{
-		DirectX::XMMATRIX t = DirectX::XMMatrixTranslation(m_f3Position.x, m_f3Position.y, m_f3Position.z);
-		DirectX::XMMATRIX r = DirectX::XMMatrixRotationRollPitchYaw(m_f3Rotation.x, m_f3Rotation.y, m_f3Rotation.z);
-		DirectX::XMMATRIX s = DirectX::XMMatrixScaling(m_f3Scale.x, m_f3Scale.y, m_f3Scale.z);
-
-		// calculate the matrix
-		DirectX::XMMATRIX world = s * r * t;
-
-		//store it (and inverse)
-		XMStoreFloat4x4(&m_m4World, world);
-		XMStoreFloat4x4(&m_m4WorldInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(world)));
-
-		// transform is no longer dirty
-		m_bDirty = false;
-	}
-
-	return m_m4WorldInverseTranspose;
+	return m_spHierarchy->GetWorldInverseTransposeMatrix(m_uNode);
 }
 #pragma endregion
 #pragma region Transformers
@@ -201,10 +247,13 @@ DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 /// <param name="a_fZOffset">Z position offset</param>
 void Transform::MoveRelative(float a_fXOffset, float a_fYOffset, float a_fZOffset)
 {
-	DirectX::XMVECTOR xvOffset = DirectX::XMVectorSet(a_fXOffset, a_fYOffset, a_fZOffset, 0.0f);
-	DirectX::XMVECTOR xvRotation = DirectX::XMQuaternionRotationRollPitchYaw(m_f3Rotation.x, m_f3Rotation.y, m_f3Rotation.z);
+	// the offset along each of the transform's own axes
+	UpdateBasis();
+	DirectX::XMVECTOR xvOffset = DirectX::XMVectorScale(DirectX::XMLoadFloat3(&m_f3Right), a_fXOffset);
+	xvOffset = DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat3(&m_f3Up), DirectX::XMVectorReplicate(a_fYOffset), xvOffset);
+	xvOffset = DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat3(&m_f3Forward), DirectX::XMVectorReplicate(a_fZOffset), xvOffset);
 	DirectX::XMFLOAT3 f3AbsoluteOffset;
-	XMStoreFloat3(&f3AbsoluteOffset, DirectX::XMVector3Rotate(xvOffset, xvRotation));
+	XMStoreFloat3(&f3AbsoluteOffset, xvOffset);
 	MoveAbsolute(f3AbsoluteOffset);
 }
 /// <summary>
@@ -213,11 +262,7 @@ void Transform::MoveRelative(float a_fXOffset, float a_fYOffset, float a_fZOffse
 /// <param name="a_fZOffset">Position offset</param> 
 void Transform::MoveRelative(DirectX::XMFLOAT3 a_f3Offset)
 {
-	DirectX::XMVECTOR xvOffset = DirectX::XMVectorSet(a_f3Offset.x, a_f3Offset.y, a_f3Offset.z, 0.0f);
-	DirectX::XMVECTOR xvRotation = DirectX::XMQuaternionRotationRollPitchYaw(m_f3Rotation.x, m_f3Rotation.y, m_f3Rotation.z);
-	DirectX::XMFLOAT3 f3AbsoluteOffset;
-	XMStoreFloat3(&f3AbsoluteOffset, DirectX::XMVector3Rotate(xvOffset, xvRotation));
-	MoveAbsolute(f3AbsoluteOffset);
+	MoveRelative(a_f3Offset.x, a_f3Offset.y, a_f3Offset.z);
 }
 /// <summary>
 /// Moves the transform by the given x, y, and z offsets in world space
@@ -227,10 +272,11 @@ void Transform::MoveRelative(DirectX::XMFLOAT3 a_f3Offset)
 /// <param name="a_fZOffset">Z position offset</param>
 void Transform::MoveAbsolute(float a_fXOffset, float a_fYOffset, float a_fZOffset)
 {
-	m_f3Position.x += a_fXOffset;
-	m_f3Position.y += a_fYOffset;
-	m_f3Position.z += a_fZOffset;
-	m_bDirty = true;
+	DirectX::XMFLOAT3 f3Position = m_spHierarchy->GetLocal(m_uNode).Position;
+	f3Position.x += a_fXOffset;
+	f3Position.y += a_fYOffset;
+	f3Position.z += a_fZOffset;
+	m_spHierarchy->SetPosition(m_uNode, f3Position);
 }
 /// <summary>
 /// Moves the transform by the given offset in world space
@@ -238,34 +284,34 @@ void Transform::MoveAbsolute(float a_fXOffset, float a_fYOffset, float a_fZOffse
 /// <param name="a_f3Offset">Position offset</param>
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 a_f3Offset)
 {
-	m_f3Position.x +=  a_f3Offset.x;
-	m_f3Position.y += a_f3Offset.y;
-	m_f3Position.z += a_f3Offset.z;
-	m_bDirty = true;
+	DirectX::XMFLOAT3 f3Position = m_spHierarchy->GetLocal(m_uNode).Position;
+	f3Position.x +=  a_f3Offset.x;
+	f3Position.y += a_f3Offset.y;
+	f3Position.z += a_f3Offset.z;
+	m_spHierarchy->SetPosition(m_uNode, f3Position);
 }
 /// <summary>
-/// Rotates the transform by the given pitch, yaw, and roll offsets
+/// Rotates the transform by the given pitch, yaw, and roll, about its own axes
 /// </summary>
 /// <param name="a_fPitch">Pitch offset</param>
 /// <param name="a_fYaw">Yaw offset</param>
 /// <param name="a_fRoll">Roll offset</param>
 void Transform::Rotate(float a_fPitch, float a_fYaw, float a_fRoll)
 {
-	m_f3Rotation.x += a_fPitch;
-	m_f3Rotation.y += a_fYaw;
-	m_f3Rotation.z += a_fRoll;
-	m_bDirty = true;
+	// the new rotation goes first, so it turns the transform about its local axes
+	DirectX::XMFLOAT4 f4Rotation = m_spHierarchy->GetLocal(m_uNode).Rotation;
+	DirectX::XMVECTOR xvRotation = DirectX::XMQuaternionMultiply(DirectX::XMQuaternionRotationRollPitchYaw(a_fPitch, a_fYaw, a_fRoll), DirectX::XMLoadFloat4(&f4Rotation));
+	DirectX::XMStoreFloat4(&f4Rotation, DirectX::XMQuaternionNormalize(xvRotation));
+	m_spHierarchy->SetRotation(m_uNode, f4Rotation);
+	m_bBasisDirty = true;
 }
 /// <summary>
-/// Rotates the transform by the given rotation
+/// Rotates the transform by the given rotation, about its own axes
 /// </summary>
 /// <param name="a_f3Rotation">Rotation</param>
 void Transform::Rotate(DirectX::XMFLOAT3 a_f3Rotation)
 {
-	m_f3Rotation.x += a_f3Rotation.x;
-	m_f3Rotation.y += a_f3Rotation.y;
-	m_f3Rotation.z += a_f3Rotation.z;
-	m_bDirty = true;
+	Rotate(a_f3Rotation.x, a_f3Rotation.y, a_f3Rotation.z);
 }
 /// <summary>
 /// Scales the transform by the given x, y, and z scalars
@@ -275,10 +321,11 @@ void Transform::Rotate(DirectX::XMFLOAT3 a_f3Rotation)
 /// <param name="a_fZScale">Z scalar</param>
 void Transform::Scale(float a_fXScale, float a_fYScale, float a_fZScale)
 {
-	m_f3Scale.x *= a_fXScale;
-	m_f3Scale.y *= a_fXScale;
-	m_f3Scale.z *= a_fXScale;
-	m_bDirty = true;
+	DirectX::XMFLOAT3 f3Scale = m_spHierarchy->GetLocal(m_uNode).Scale;
+	f3Scale.x *= a_fXScale;
+	f3Scale.y *= a_fXScale;
+	f3Scale.z *= a_fXScale;
+	m_spHierarchy->SetScale(m_uNode, f3Scale);
 }
 /// <summary>
 /// Scales the transform by the given scalar
@@ -286,11 +333,27 @@ void Transform::Scale(float a_fXScale, float a_fYScale, float a_fZScale)
 /// <param name="a_f3Scale">Scalar</param>
 void Transform::Scale(DirectX::XMFLOAT3 a_f3Scale)
 {
-	m_f3Scale.x *= a_f3Scale.x;
-	m_f3Scale.y *= a_f3Scale.y;
-	m_f3Scale.z *= a_f3Scale.z;
-	m_bDirty = true;
+	DirectX::XMFLOAT3 f3Scale = m_spHierarchy->GetLocal(m_uNode).Scale;
+	f3Scale.x *= a_f3Scale.x;
+	f3Scale.y *= a_f3Scale.y;
+	f3Scale.z *= a_f3Scale.z;
+	m_spHierarchy->SetScale(m_uNode, f3Scale);
 }
 #pragma endregion
 
+/// <summary>
+/// Rebuilds the right, up and forward vectors if the rotation changed since they were last built
+/// </summary>
+void Transform::UpdateBasis()
+{
+	if (!m_bBasisDirty)
+		return;
 
+	// the rows of the rotation matrix are where it takes the x, y and z axes
+	DirectX::XMFLOAT4 f4Rotation = m_spHierarchy->GetLocal(m_uNode).Rotation;
+	DirectX::XMMATRIX rotation = DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&f4Rotation));
+	DirectX::XMStoreFloat3(&m_f3Right, rotation.r[0]);
+	DirectX::XMStoreFloat3(&m_f3Up, rotation.r[1]);
+	DirectX::XMStoreFloat3(&m_f3Forward, rotation.r[2]);
+	m_bBasisDirty = false;
+}
\ No newline at end of file
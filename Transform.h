@@ -1,20 +1,34 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <memory>
+#include "TransformHierarchy.h"
 
+// --------------------------------------------------------
+// A handle to a node of a TransformHierarchy. Position,
+// rotation and scale are relative to the parent; the world
+// matrices include every ancestor. Rotation is stored as a
+// quaternion; pitch/yaw/roll are converted to and from it.
+// --------------------------------------------------------
 class Transform
 {
 public:
 	// OOP stuff
 	Transform();
+	Transform(std::shared_ptr<TransformHierarchy> a_spHierarchy);
+	~Transform();
+	Transform(const Transform&) = delete;
+	Transform& operator=(const Transform&) = delete;
 
 	// Setters
 	void SetPosition(float a_fXPosition, float a_fYPosition, float a_fZPosition);
 	void SetPosition(DirectX::XMFLOAT3 a_f3Position);
 	void SetRotation(float a_fPitch, float a_fYaw, float a_fRoll);
 	void SetRotation(DirectX::XMFLOAT3 a_f3Rotation);
+	void SetRotationQuaternion(DirectX::XMFLOAT4 a_f4Rotation);
 	void SetScale(float a_fXScale, float a_fYScale, float a_fZScale);
 	void SetScale(DirectX::XMFLOAT3 a_f3Scale);
+	void SetParent(std::shared_ptr<Transform> a_spParent);
 
 	// Getters
 	DirectX::XMFLOAT3 GetRight();
@@ -22,9 +36,14 @@ public:
 	DirectX::XMFLOAT3 GetForward();
 	DirectX::XMFLOAT3 GetPosition();
 	DirectX::XMFLOAT3 GetPitchYawRoll();
+	DirectX::XMFLOAT4 GetRotationQuaternion();
 	DirectX::XMFLOAT3 GetScale();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
+	unsigned int GetVersion();
+	std::shared_ptr<Transform> GetParent();
+	std::shared_ptr<TransformHierarchy> GetHierarchy();
+	uint32_t GetNode();
 
 	// Transformers (roll out!)
 	void MoveRelative(float a_fXOffset, float a_fYOffset, float a_fZOffset);
@@ -38,12 +57,15 @@ public:
 
 
 private:
-	DirectX::XMFLOAT3 m_f3Position;
-	DirectX::XMFLOAT3 m_f3Rotation;
-	DirectX::XMFLOAT3 m_f3Scale;
+	std::shared_ptr<TransformHierarchy> m_spHierarchy; //owns the local and world transforms
+	uint32_t m_uNode;
+	std::shared_ptr<Transform> m_spParent; //keeps the parent's node alive as long as this one points at it
 
-	DirectX::XMFLOAT4X4 m_m4World;
-	DirectX::XMFLOAT4X4 m_m4WorldInverseTranspose;
+	// local axes, rebuilt from the rotation only after it changes
+	DirectX::XMFLOAT3 m_f3Right;
+	DirectX::XMFLOAT3 m_f3Up;
+	DirectX::XMFLOAT3 m_f3Forward;
+	bool m_bBasisDirty;
 
-	bool m_bDirty;
+	void UpdateBasis();
 };
\ No newline at end of file
@@ -0,0 +1,987 @@
+#include "TransformHierarchy.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <type_traits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	const TransformLocal IDENTITY_LOCAL = { { 0, 0, 0 }, { 0, 0, 0, 1 }, { 1, 1, 1 } };
+
+	/// <summary>
+	/// Builds the matrix of a transform relative to its parent: scale, then rotation, then translation.
+	/// Scaling first only scales the rows of the rotation, so no matrices are multiplied.
+	/// </summary>
+	DirectX::XMMATRIX LocalMatrix(const TransformLocal& a_Local)
+	{
+		DirectX::XMMATRIX m = DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&a_Local.Rotation));
+		m.r[0] = DirectX::XMVectorScale(m.r[0], a_Local.Scale.x);
+		m.r[1] = DirectX::XMVectorScale(m.r[1], a_Local.Scale.y);
+		m.r[2] = DirectX::XMVectorScale(m.r[2], a_Local.Scale.z);
+		m.r[3] = DirectX::XMVectorSet(a_Local.Position.x, a_Local.Position.y, a_Local.Position.z, 1.0f);
+		return m;
+	}
+
+	/// <summary>
+	/// Builds the inverse transpose of LocalMatrix's upper 3x3 without inverting anything: the rotation
+	/// is orthonormal, so it is its own inverse transpose, which leaves dividing its rows by the scale
+	/// </summary>
+	DirectX::XMMATRIX LocalNormalMatrix(const TransformLocal& a_Local)
+	{
+		DirectX::XMMATRIX m = DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&a_Local.Rotation));
+		if (a_Local.Scale.x == a_Local.Scale.y && a_Local.Scale.y == a_Local.Scale.z)
+		{
+			// uniform scale: one reciprocal, and none at all at unit scale, where it is just the rotation
+			if (a_Local.Scale.x != 1.0f)
+			{
+				float fInverseScale = 1.0f / a_Local.Scale.x;
+				m.r[0] = DirectX::XMVectorScale(m.r[0], fInverseScale);
+				m.r[1] = DirectX::XMVectorScale(m.r[1], fInverseScale);
+				m.r[2] = DirectX::XMVectorScale(m.r[2], fInverseScale);
+			}
+		}
+		else
+		{
+			m.r[0] = DirectX::XMVectorScale(m.r[0], 1.0f / a_Local.Scale.x);
+			m.r[1] = DirectX::XMVectorScale(m.r[1], 1.0f / a_Local.Scale.y);
+			m.r[2] = DirectX::XMVectorScale(m.r[2], 1.0f / a_Local.Scale.z);
+		}
+		return m;
+	}
+
+#if defined(__AVX__)
+	/// <summary>
+	/// Writes 8 matrices, given as one register per element (16 of them, row by row), to consecutive XMFLOAT4X4s.
+	/// Each half (two rows of every matrix) is an 8x8 transpose whose results go straight to memory.
+	/// </summary>
+	void StoreMatrices(DirectX::XMFLOAT4X4* a_pOutput, const __m256 a_pElements[16])
+	{
+		for (int nHalf = 0; nHalf < 2; nHalf++)
+		{
+			const __m256* pRows = a_pElements + nHalf * 8;
+			__m256 t0 = _mm256_unpacklo_ps(pRows[0], pRows[1]), t1 = _mm256_unpackhi_ps(pRows[0], pRows[1]);
+			__m256 t2 = _mm256_unpacklo_ps(pRows[2], pRows[3]), t3 = _mm256_unpackhi_ps(pRows[2], pRows[3]);
+			__m256 t4 = _mm256_unpacklo_ps(pRows[4], pRows[5]), t5 = _mm256_unpackhi_ps(pRows[4], pRows[5]);
+			__m256 t6 = _mm256_unpacklo_ps(pRows[6], pRows[7]), t7 = _mm256_unpackhi_ps(pRows[6], pRows[7]);
+			__m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44), s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+			__m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44), s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+			__m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44), s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+			__m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44), s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+			_mm256_storeu_ps(&a_pOutput[0].m[nHalf * 2][0], _mm256_permute2f128_ps(s0, s4, 0x20));
+			_mm256_storeu_ps(&a_pOutput[1].m[nHalf * 2][0], _mm256_permute2f128_ps(s1, s5, 0x20));
+			_mm256_storeu_ps(&a_pOutput[2].m[nHalf * 2][0], _mm256_permute2f128_ps(s2, s6, 0x20));
+			_mm256_storeu_ps(&a_pOutput[3].m[nHalf * 2][0], _mm256_permute2f128_ps(s3, s7, 0x20));
+			_mm256_storeu_ps(&a_pOutput[4].m[nHalf * 2][0], _mm256_permute2f128_ps(s0, s4, 0x31));
+			_mm256_storeu_ps(&a_pOutput[5].m[nHalf * 2][0], _mm256_permute2f128_ps(s1, s5, 0x31));
+			_mm256_storeu_ps(&a_pOutput[6].m[nHalf * 2][0], _mm256_permute2f128_ps(s2, s6, 0x31));
+			_mm256_storeu_ps(&a_pOutput[7].m[nHalf * 2][0], _mm256_permute2f128_ps(s3, s7, 0x31));
+		}
+	}
+
+	/// <summary>
+	/// Builds the local and local normal matrices of TRANSFORM_BATCH consecutive transforms at once
+	/// </summary>
+	void LocalMatricesBatch(const TransformLocalList& a_Local, size_t a_uFirst, DirectX::XMFLOAT4X4* a_pWorld, DirectX::XMFLOAT4X4* a_pNormal)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 two = _mm256_set1_ps(2.0f);
+		const __m256 zero = _mm256_setzero_ps();
+		__m256 qx = _mm256_loadu_ps(&a_Local.RotationX[a_uFirst]);
+		__m256 qy = _mm256_loadu_ps(&a_Local.RotationY[a_uFirst]);
+		__m256 qz = _mm256_loadu_ps(&a_Local.RotationZ[a_uFirst]);
+		__m256 qw = _mm256_loadu_ps(&a_Local.RotationW[a_uFirst]);
+
+		// rotation matrix of each quaternion (the same terms as XMMatrixRotationQuaternion)
+		__m256 x2 = _mm256_mul_ps(qx, two), y2 = _mm256_mul_ps(qy, two), z2 = _mm256_mul_ps(qz, two);
+		__m256 xx = _mm256_mul_ps(qx, x2), yy = _mm256_mul_ps(qy, y2), zz = _mm256_mul_ps(qz, z2);
+		__m256 xy = _mm256_mul_ps(qx, y2), xz = _mm256_mul_ps(qx, z2), yz = _mm256_mul_ps(qy, z2);
+		__m256 wx = _mm256_mul_ps(qw, x2), wy = _mm256_mul_ps(qw, y2), wz = _mm256_mul_ps(qw, z2);
+		__m256 r[9] =
+		{
+			_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), _mm256_add_ps(xy, wz), _mm256_sub_ps(xz, wy),
+			_mm256_sub_ps(xy, wz), _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), _mm256_add_ps(yz, wx),
+			_mm256_add_ps(xz, wy), _mm256_sub_ps(yz, wx), _mm256_sub_ps(one, _mm256_add_ps(xx, yy))
+		};
+
+		// world: rows scaled, then the position; normal: rows divided by the scale
+		__m256 scale[3] = { _mm256_loadu_ps(&a_Local.ScaleX[a_uFirst]), _mm256_loadu_ps(&a_Local.ScaleY[a_uFirst]), _mm256_loadu_ps(&a_Local.ScaleZ[a_uFirst]) };
+		__m256 elements[16];
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				elements[i * 4 + j] = _mm256_mul_ps(r[i * 3 + j], scale[i]);
+			elements[i * 4 + 3] = zero;
+		}
+		elements[12] = _mm256_loadu_ps(&a_Local.PositionX[a_uFirst]);
+		elements[13] = _mm256_loadu_ps(&a_Local.PositionY[a_uFirst]);
+		elements[14] = _mm256_loadu_ps(&a_Local.PositionZ[a_uFirst]);
+		elements[15] = one;
+		StoreMatrices(a_pWorld, elements);
+
+		for (int i = 0; i < 3; i++)
+		{
+			__m256 inverseScale = _mm256_div_ps(one, scale[i]);
+			for (int j = 0; j < 3; j++)
+				elements[i * 4 + j] = _mm256_mul_ps(r[i * 3 + j], inverseScale);
+		}
+		elements[12] = elements[13] = elements[14] = zero;
+		StoreMatrices(a_pNormal, elements);
+	}
+#else
+	/// <summary>
+	/// Writes 4 matrices, given as one register per element (16 of them, row by row), to consecutive XMFLOAT4X4s
+	/// </summary>
+	void StoreMatrices(DirectX::XMFLOAT4X4* a_pOutput, const __m128 a_pElements[16])
+	{
+		for (int nRow = 0; nRow < 4; nRow++)
+		{
+			__m128 r0 = a_pElements[nRow * 4], r1 = a_pElements[nRow * 4 + 1], r2 = a_pElements[nRow * 4 + 2], r3 = a_pElements[nRow * 4 + 3];
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(&a_pOutput[0].m[nRow][0], r0);
+			_mm_storeu_ps(&a_pOutput[1].m[nRow][0], r1);
+			_mm_storeu_ps(&a_pOutput[2].m[nRow][0], r2);
+			_mm_storeu_ps(&a_pOutput[3].m[nRow][0], r3);
+		}
+	}
+
+	/// <summary>
+	/// Builds the local and local normal matrices of TRANSFORM_BATCH consecutive transforms at once, in halves of four
+	/// </summary>
+	void LocalMatricesBatch(const TransformLocalList& a_Local, size_t a_uFirst, DirectX::XMFLOAT4X4* a_pWorld, DirectX::XMFLOAT4X4* a_pNormal)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 zero = _mm_setzero_ps();
+		for (size_t h = 0; h < TRANSFORM_BATCH; h += 4)
+		{
+			size_t i0 = a_uFirst + h;
+			__m128 qx = _mm_loadu_ps(&a_Local.RotationX[i0]);
+			__m128 qy = _mm_loadu_ps(&a_Local.RotationY[i0]);
+			__m128 qz = _mm_loadu_ps(&a_Local.RotationZ[i0]);
+			__m128 qw = _mm_loadu_ps(&a_Local.RotationW[i0]);
+
+			// rotation matrix of each quaternion (the same terms as XMMatrixRotationQuaternion)
+			__m128 x2 = _mm_mul_ps(qx, two), y2 = _mm_mul_ps(qy, two), z2 = _mm_mul_ps(qz, two);
+			__m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2), zz = _mm_mul_ps(qz, z2);
+			__m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2), yz = _mm_mul_ps(qy, z2);
+			__m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2), wz = _mm_mul_ps(qw, z2);
+			__m128 r[9] =
+			{
+				_mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, wz), _mm_sub_ps(xz, wy),
+				_mm_sub_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_add_ps(yz, wx),
+				_mm_add_ps(xz, wy), _mm_sub_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy))
+			};
+
+			// world: rows scaled, then the position; normal: rows divided by the scale
+			__m128 scale[3] = { _mm_loadu_ps(&a_Local.ScaleX[i0]), _mm_loadu_ps(&a_Local.ScaleY[i0]), _mm_loadu_ps(&a_Local.ScaleZ[i0]) };
+			__m128 elements[16];
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = 0; j < 3; j++)
+					elements[i * 4 + j] = _mm_mul_ps(r[i * 3 + j], scale[i]);
+				elements[i * 4 + 3] = zero;
+			}
+			elements[12] = _mm_loadu_ps(&a_Local.PositionX[i0]);
+			elements[13] = _mm_loadu_ps(&a_Local.PositionY[i0]);
+			elements[14] = _mm_loadu_ps(&a_Local.PositionZ[i0]);
+			elements[15] = one;
+			StoreMatrices(a_pWorld + h, elements);
+
+			for (int i = 0; i < 3; i++)
+			{
+				__m128 inverseScale = _mm_div_ps(one, scale[i]);
+				for (int j = 0; j < 3; j++)
+					elements[i * 4 + j] = _mm_mul_ps(r[i * 3 + j], inverseScale);
+			}
+			elements[12] = elements[13] = elements[14] = zero;
+			StoreMatrices(a_pNormal + h, elements);
+		}
+	}
+#endif
+
+	/// <summary>
+	/// Builds the local and local normal matrices of slots [a_uFirst, a_uEnd): whole batches, then one at a time
+	/// </summary>
+	void LocalMatrices(const TransformLocalList& a_Local, size_t a_uFirst, size_t a_uEnd, DirectX::XMFLOAT4X4* a_pWorld, DirectX::XMFLOAT4X4* a_pNormal)
+	{
+		size_t i = a_uFirst;
+		for (; i + TRANSFORM_BATCH <= a_uEnd; i += TRANSFORM_BATCH)
+			LocalMatricesBatch(a_Local, i, a_pWorld + i, a_pNormal + i);
+		for (; i < a_uEnd; i++)
+		{
+			TransformLocal local = a_Local.Get(i);
+			DirectX::XMStoreFloat4x4(&a_pWorld[i], LocalMatrix(local));
+			DirectX::XMStoreFloat4x4(&a_pNormal[i], LocalNormalMatrix(local));
+		}
+	}
+
+	// --------------------------------------------------------
+	// A node of the scene graph the benchmark compares with:
+	// allocated on its own, with a list of its children, and
+	// rotated by pitch, yaw and roll
+	// --------------------------------------------------------
+	struct PointerNode
+	{
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 PitchYawRoll;
+		DirectX::XMFLOAT3 Scale;
+		DirectX::XMFLOAT4X4 World;
+		DirectX::XMFLOAT4X4 WorldInverseTranspose;
+		std::vector<PointerNode*> Children;
+	};
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point a_tpStart)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - a_tpStart).count();
+	}
+}
+
+#pragma region TransformLocalList
+/// <summary>
+/// Adds a transform at the end of the arrays
+/// </summary>
+/// <param name="a_Local">Transform to add</param>
+void TransformLocalList::PushBack(const TransformLocal& a_Local)
+{
+	PositionX.push_back(a_Local.Position.x);
+	PositionY.push_back(a_Local.Position.y);
+	PositionZ.push_back(a_Local.Position.z);
+	RotationX.push_back(a_Local.Rotation.x);
+	RotationY.push_back(a_Local.Rotation.y);
+	RotationZ.push_back(a_Local.Rotation.z);
+	RotationW.push_back(a_Local.Rotation.w);
+	ScaleX.push_back(a_Local.Scale.x);
+	ScaleY.push_back(a_Local.Scale.y);
+	ScaleZ.push_back(a_Local.Scale.z);
+	Count++;
+}
+
+/// <summary>
+/// Gathers one transform's components from the arrays
+/// </summary>
+/// <param name="a_uIndex">Index of the transform</param>
+/// <returns>The transform</returns>
+TransformLocal TransformLocalList::Get(size_t a_uIndex) const
+{
+	TransformLocal local;
+	local.Position = DirectX::XMFLOAT3(PositionX[a_uIndex], PositionY[a_uIndex], PositionZ[a_uIndex]);
+	local.Rotation = DirectX::XMFLOAT4(RotationX[a_uIndex], RotationY[a_uIndex], RotationZ[a_uIndex], RotationW[a_uIndex]);
+	local.Scale = DirectX::XMFLOAT3(ScaleX[a_uIndex], ScaleY[a_uIndex], ScaleZ[a_uIndex]);
+	return local;
+}
+
+/// <summary>
+/// Scatters one transform's components into the arrays
+/// </summary>
+/// <param name="a_uIndex">Index of the transform</param>
+/// <param name="a_Local">New transform</param>
+void TransformLocalList::Set(size_t a_uIndex, const TransformLocal& a_Local)
+{
+	PositionX[a_uIndex] = a_Local.Position.x;
+	PositionY[a_uIndex] = a_Local.Position.y;
+	PositionZ[a_uIndex] = a_Local.Position.z;
+	RotationX[a_uIndex] = a_Local.Rotation.x;
+	RotationY[a_uIndex] = a_Local.Rotation.y;
+	RotationZ[a_uIndex] = a_Local.Rotation.z;
+	RotationW[a_uIndex] = a_Local.Rotation.w;
+	ScaleX[a_uIndex] = a_Local.Scale.x;
+	ScaleY[a_uIndex] = a_Local.Scale.y;
+	ScaleZ[a_uIndex] = a_Local.Scale.z;
+}
+
+/// <summary>
+/// Rearranges the transforms so the i-th one is the one that was at a_vOrder[i]
+/// </summary>
+/// <param name="a_vOrder">Old index of every new index</param>
+void TransformLocalList::Gather(const std::vector<uint32_t>& a_vOrder)
+{
+	std::vector<float>* pArrays[10] = { &PositionX, &PositionY, &PositionZ, &RotationX, &RotationY, &RotationZ, &RotationW, &ScaleX, &ScaleY, &ScaleZ };
+	std::vector<float> vSorted;
+	for (std::vector<float>* pArray : pArrays)
+	{
+		vSorted.resize(a_vOrder.size());
+		for (size_t i = 0; i < a_vOrder.size(); i++)
+			vSorted[i] = (*pArray)[a_vOrder[i]];
+		pArray->swap(vSorted);
+	}
+	Count = a_vOrder.size();
+}
+#pragma endregion
+
+/// <summary>
+/// Creates an empty hierarchy
+/// </summary>
+TransformHierarchy::TransformHierarchy()
+{
+	m_bOrderDirty = false;
+	m_uDeadSlots = 0;
+	m_Stats = {};
+}
+
+/// <summary>
+/// Gets the hierarchy transforms are created in unless they're given one
+/// </summary>
+/// <returns>The shared default hierarchy</returns>
+std::shared_ptr<TransformHierarchy> TransformHierarchy::GetDefault()
+{
+	static std::shared_ptr<TransformHierarchy> spDefault = std::make_shared<TransformHierarchy>();
+	return spDefault;
+}
+
+/// <summary>
+/// Adds a root node with the identity transform. Roots go at the end, which keeps the order intact.
+/// </summary>
+/// <returns>Id of the node</returns>
+uint32_t TransformHierarchy::Create()
+{
+	uint32_t uNode;
+	if (!m_vFreeNodes.empty())
+	{
+		uNode = m_vFreeNodes.back();
+		m_vFreeNodes.pop_back();
+	}
+	else
+	{
+		uNode = (uint32_t)m_vSlotOfNode.size();
+		m_vSlotOfNode.push_back(TRANSFORM_NONE);
+	}
+
+	DirectX::XMFLOAT4X4 m4Identity;
+	DirectX::XMStoreFloat4x4(&m4Identity, DirectX::XMMatrixIdentity());
+	m_vSlotOfNode[uNode] = (uint32_t)m_Local.Count;
+	m_Local.PushBack(IDENTITY_LOCAL);
+	m_vParent.push_back(TRANSFORM_NONE);
+	m_vSubtreeSize.push_back(1);
+	m_vWorld.push_back(m4Identity);
+	m_vWorldInverseTranspose.push_back(m4Identity);
+	m_vVersion.push_back(0);
+	m_vDirty.push_back(0);
+	m_vNodeOfSlot.push_back(uNode);
+	return uNode;
+}
+
+/// <summary>
+/// Removes a node. Its children move up to its parent, keeping their local transforms.
+/// The slot stays behind (skipped by updates) until the next re-sort, so the order holds.
+/// </summary>
+/// <param name="a_uNode">Node to remove</param>
+void TransformHierarchy::Destroy(uint32_t a_uNode)
+{
+	uint32_t uSlot = SlotOf(a_uNode);
+
+	// with the order intact the children can only be inside the node's own run of slots
+	uint32_t uFirst = m_bOrderDirty ? 0 : uSlot + 1;
+	uint32_t uEnd = m_bOrderDirty ? (uint32_t)m_vParent.size() : uSlot + m_vSubtreeSize[uSlot];
+	for (uint32_t i = uFirst; i < uEnd; i++)
+		if (m_vParent[i] == uSlot && m_vNodeOfSlot[i] != TRANSFORM_NONE)
+		{
+			m_vParent[i] = m_vParent[uSlot];
+			Flag(i);
+		}
+
+	m_vNodeOfSlot[uSlot] = TRANSFORM_NONE;
+	m_vParent[uSlot] = TRANSFORM_NONE;
+	m_vDirty[uSlot] = 0;
+	m_vSlotOfNode[a_uNode] = TRANSFORM_NONE;
+	m_vFreeNodes.push_back(a_uNode);
+	m_uDeadSlots++;
+}
+
+/// <summary>
+/// Moves a node (with its subtree) under another node, keeping its local transform
+/// </summary>
+/// <param name="a_uNode">Node to move</param>
+/// <param name="a_uParent">New parent, TRANSFORM_NONE to make the node a root</param>
+/// <returns>False if the new parent is the node itself or one of its descendants</returns>
+bool TransformHierarchy::SetParent(uint32_t a_uNode, uint32_t a_uParent)
+{
+	uint32_t uSlot = SlotOf(a_uNode);
+	uint32_t uParentSlot = a_uParent == TRANSFORM_NONE ? TRANSFORM_NONE : SlotOf(a_uParent);
+	if (m_vParent[uSlot] == uParentSlot)
+		return true;
+
+	// a node can't go under its own descendant
+	for (uint32_t uAncestor = uParentSlot; uAncestor != TRANSFORM_NONE; uAncestor = m_vParent[uAncestor])
+		if (uAncestor == uSlot)
+			return false;
+
+	m_vParent[uSlot] = uParentSlot;
+	m_bOrderDirty = true;
+	Flag(uSlot);
+	return true;
+}
+
+/// <summary>
+/// Recomputes the world matrices of every flagged node and everything below it. The flagged
+/// subtrees are merged into spans of consecutive slots that don't depend on each other, and
+/// large subtrees are split at their children so the spans can be shared out between workers.
+/// </summary>
+void TransformHierarchy::Update()
+{
+	if (m_bOrderDirty || m_uDeadSlots > m_Local.Count / 2)
+		Reorder();
+
+	m_Stats.DirtyRanges = 0;
+	m_Stats.UpdatedNodes = 0;
+	std::vector<std::pair<uint32_t, uint32_t>> vSpans;
+	auto AddSpan = [&vSpans](uint32_t a_uFirst, uint32_t a_uEnd)
+	{
+		// neighbouring subtrees make one longer span, so more of it is whole SIMD batches
+		if (!vSpans.empty() && vSpans.back().second == a_uFirst)
+			vSpans.back().second = a_uEnd;
+		else
+			vSpans.push_back({ a_uFirst, a_uEnd });
+	};
+
+	// takes a flagged slot's whole subtree and returns the slot after it
+	auto AddSubtree = [&](uint32_t a_uSlot)
+	{
+		uint32_t uEnd = a_uSlot + m_vSubtreeSize[a_uSlot];
+		m_Stats.DirtyRanges++;
+		m_Stats.UpdatedNodes += uEnd - a_uSlot;
+		if (uEnd - a_uSlot <= TRANSFORM_HIERARCHY_SPLIT_NODES)
+		{
+			AddSpan(a_uSlot, uEnd);
+			return uEnd;
+		}
+
+		// the root of a large subtree goes first, after which its children's subtrees are independent
+		UpdateSpans({ { a_uSlot, a_uSlot + 1 } }, 1);
+		for (uint32_t uChild = a_uSlot + 1; uChild < uEnd; uChild += m_vSubtreeSize[uChild])
+			AddSpan(uChild, uChild + m_vSubtreeSize[uChild]);
+		return uEnd;
+	};
+
+	// flagged slots in slot order. When many moved, walking the flags (and jumping over the subtrees
+	// already taken) is cheaper than sorting them. A flagged node inside a subtree that is already
+	// taken is updated with it.
+	if (m_vDirtyNodes.size() > m_Local.Count / TRANSFORM_HIERARCHY_SCAN_FRACTION)
+	{
+		for (uint32_t i = 0; i < (uint32_t)m_Local.Count;)
+			i = m_vDirty[i] ? AddSubtree(i) : i + 1;
+	}
+	else
+	{
+		std::vector<uint32_t> vSlots;
+		vSlots.reserve(m_vDirtyNodes.size());
+		for (uint32_t uNode : m_vDirtyNodes)
+		{
+			uint32_t uSlot = m_vSlotOfNode[uNode];
+			if (uSlot != TRANSFORM_NONE && m_vDirty[uSlot])
+				vSlots.push_back(uSlot);
+		}
+		std::sort(vSlots.begin(), vSlots.end());
+
+		uint32_t uEnd = 0;
+		for (uint32_t uSlot : vSlots)
+			if (uSlot >= uEnd)
+				uEnd = AddSubtree(uSlot);
+	}
+	m_vDirtyNodes.clear();
+
+	UpdateSpans(vSpans, m_Stats.UpdatedNodes);
+}
+
+/// <summary>
+/// Recomputes the world matrices of spans of slots whose parents outside the span are up to date:
+/// first every local matrix, a batch at a time, then a forward pass multiplying in the parents
+/// </summary>
+/// <param name="a_vSpans">First and end slot of every span, in slot order</param>
+/// <param name="a_uNodes">Slots in all the spans, which decides whether to use the job scheduler</param>
+void TransformHierarchy::UpdateSpans(const std::vector<std::pair<uint32_t, uint32_t>>& a_vSpans, uint32_t a_uNodes)
+{
+	if (a_vSpans.empty())
+		return;
+
+	// where every span would start if they were laid end to end, to share them out by slots
+	std::vector<uint32_t> vSpanStart(a_vSpans.size() + 1, 0);
+	for (size_t i = 0; i < a_vSpans.size(); i++)
+		vSpanStart[i + 1] = vSpanStart[i] + a_vSpans[i].second - a_vSpans[i].first;
+	uint32_t uTotal = vSpanStart.back();
+
+	// small updates aren't worth the jobs; without a scheduler everything runs on the calling thread
+	bool bSpread = m_spJobs && a_uNodes >= TRANSFORM_HIERARCHY_PARALLEL_NODES;
+	auto Spread = [&](const auto& a_Run)
+	{
+		if (bSpread)
+			m_spJobs->ParallelFor(uTotal, TRANSFORM_HIERARCHY_JOB_SLOTS, a_Run);
+		else
+			a_Run(0, uTotal);
+	};
+
+	// local matrices don't depend on each other, so any band of slots will do
+	Spread([&](uint32_t a_uFirst, uint32_t a_uEnd)
+	{
+		size_t uSpan = std::upper_bound(vSpanStart.begin(), vSpanStart.end(), a_uFirst) - vSpanStart.begin() - 1;
+		for (uint32_t uAt = a_uFirst; uAt < a_uEnd; uSpan++)
+		{
+			uint32_t uBandEnd = (std::min)(a_uEnd, vSpanStart[uSpan + 1]);
+			uint32_t uSlot = a_vSpans[uSpan].first + (uAt - vSpanStart[uSpan]);
+			LocalMatrices(m_Local, uSlot, uSlot + (uBandEnd - uAt), m_vWorld.data(), m_vWorldInverseTranspose.data());
+			uAt = uBandEnd;
+		}
+	});
+
+	// parents come before their children inside a span, so each band takes the spans that start in it, whole
+	Spread([&](uint32_t a_uFirst, uint32_t a_uEnd)
+	{
+		size_t uSpan = std::lower_bound(vSpanStart.begin(), vSpanStart.end(), a_uFirst) - vSpanStart.begin();
+		for (; uSpan < a_vSpans.size() && vSpanStart[uSpan] < a_uEnd; uSpan++)
+			for (uint32_t i = a_vSpans[uSpan].first; i < a_vSpans[uSpan].second; i++)
+			{
+				if (m_vNodeOfSlot[i] == TRANSFORM_NONE)
+					continue;
+
+				// the inverse transpose of a product is the product of the inverse transposes, in the same order
+				uint32_t uParent = m_vParent[i];
+				if (uParent != TRANSFORM_NONE)
+				{
+					DirectX::XMStoreFloat4x4(&m_vWorld[i], DirectX::XMLoadFloat4x4(&m_vWorld[i]) * DirectX::XMLoadFloat4x4(&m_vWorld[uParent]));
+					DirectX::XMStoreFloat4x4(&m_vWorldInverseTranspose[i],
+						DirectX::XMLoadFloat4x4(&m_vWorldInverseTranspose[i]) * DirectX::XMLoadFloat4x4(&m_vWorldInverseTranspose[uParent]));
+				}
+				m_vVersion[i]++;
+				m_vDirty[i] = 0;
+			}
+	});
+}
+
+/// <summary>
+/// Sorts the slots into depth-first order again (after parents changed) and drops the slots
+/// of destroyed nodes. Subtrees keep the relative order they had, so roots stay in creation order.
+/// </summary>
+void TransformHierarchy::Reorder()
+{
+	uint32_t uSlots = (uint32_t)m_Local.Count;
+
+	// children of every slot, in slot order, as one array (counting sort by parent)
+	std::vector<uint32_t> vChildStart(uSlots + 1, 0);
+	std::vector<uint32_t> vRoots;
+	for (uint32_t i = 0; i < uSlots; i++)
+	{
+		if (m_vNodeOfSlot[i] == TRANSFORM_NONE)
+			continue;
+		if (m_vParent[i] == TRANSFORM_NONE)
+			vRoots.push_back(i);
+		else
+			vChildStart[m_vParent[i] + 1]++;
+	}
+	for (uint32_t i = 0; i < uSlots; i++)
+		vChildStart[i + 1] += vChildStart[i];
+	std::vector<uint32_t> vChildren(vChildStart[uSlots]);
+	std::vector<uint32_t> vFill(vChildStart.begin(), vChildStart.end() - 1);
+	for (uint32_t i = 0; i < uSlots; i++)
+		if (m_vNodeOfSlot[i] != TRANSFORM_NONE && m_vParent[i] != TRANSFORM_NONE)
+			vChildren[vFill[m_vParent[i]]++] = i;
+
+	// depth-first walk with an explicit stack, so deep chains can't overflow the call stack
+	std::vector<uint32_t> vOrder; //old slot of every new slot
+	vOrder.reserve(uSlots - m_uDeadSlots);
+	std::vector<uint32_t> vStack;
+	for (uint32_t uRoot : vRoots)
+	{
+		vStack.push_back(uRoot);
+		while (!vStack.empty())
+		{
+			uint32_t uSlot = vStack.back();
+			vStack.pop_back();
+			vOrder.push_back(uSlot);
+			for (uint32_t c = vChildStart[uSlot + 1]; c > vChildStart[uSlot]; c--)
+				vStack.push_back(vChildren[c - 1]);
+		}
+	}
+
+	std::vector<uint32_t> vNewSlot(uSlots, TRANSFORM_NONE);
+	for (uint32_t i = 0; i < (uint32_t)vOrder.size(); i++)
+		vNewSlot[vOrder[i]] = i;
+
+	auto gather = [&vOrder](auto& a_vArray)
+	{
+		std::remove_reference_t<decltype(a_vArray)> vSorted(vOrder.size());
+		for (size_t i = 0; i < vOrder.size(); i++)
+			vSorted[i] = a_vArray[vOrder[i]];
+		a_vArray.swap(vSorted);
+	};
+	m_Local.Gather(vOrder);
+	gather(m_vParent);
+	gather(m_vWorld);
+	gather(m_vWorldInverseTranspose);
+	gather(m_vVersion);
+	gather(m_vDirty);
+	gather(m_vNodeOfSlot);
+
+	for (uint32_t& uParent : m_vParent)
+		if (uParent != TRANSFORM_NONE)
+			uParent = vNewSlot[uParent];
+
+	// parents come first, so walking backwards adds every subtree into its parent's after it is complete
+	m_vSubtreeSize.assign(vOrder.size(), 1);
+	for (size_t i = vOrder.size(); i-- > 0;)
+		if (m_vParent[i] != TRANSFORM_NONE)
+			m_vSubtreeSize[m_vParent[i]] += m_vSubtreeSize[i];
+	for (size_t i = 0; i < vOrder.size(); i++)
+		m_vSlotOfNode[m_vNodeOfSlot[i]] = (uint32_t)i;
+
+	m_bOrderDirty = false;
+	m_uDeadSlots = 0;
+	m_Stats.Reorders++;
+}
+
+/// <summary>
+/// Marks a slot's local transform as changed, once per update
+/// </summary>
+void TransformHierarchy::Flag(uint32_t a_uSlot)
+{
+	if (!m_vDirty[a_uSlot])
+	{
+		m_vDirty[a_uSlot] = 1;
+		m_vDirtyNodes.push_back(m_vNodeOfSlot[a_uSlot]);
+	}
+}
+
+/// <summary>
+/// Finds the slot a node is in now
+/// </summary>
+uint32_t TransformHierarchy::SlotOf(uint32_t a_uNode)
+{
+	return m_vSlotOfNode[a_uNode];
+}
+
+#pragma region Setters
+/// <summary>
+/// Replaces a node's transform relative to its parent and flags its subtree for the next update
+/// </summary>
+/// <param name="a_uNode">Node to change</param>
+/// <param name="a_Local">New local transform</param>
+void TransformHierarchy::SetLocal(uint32_t a_uNode, const TransformLocal& a_Local)
+{
+	uint32_t uSlot = SlotOf(a_uNode);
+	m_Local.Set(uSlot, a_Local);
+	Flag(uSlot);
+}
+
+/// <summary>
+/// Sets a node's position relative to its parent and flags its subtree for the next update
+/// </summary>
+/// <param name="a_uNode">Node to change</param>
+/// <param name="a_f3Position">New position</param>
+void TransformHierarchy::SetPosition(uint32_t a_uNode, DirectX::XMFLOAT3 a_f3Position)
+{
+	uint32_t uSlot = SlotOf(a_uNode);
+	m_Local.PositionX[uSlot] = a_f3Position.x;
+	m_Local.PositionY[uSlot] = a_f3Position.y;
+	m_Local.PositionZ[uSlot] = a_f3Position.z;
+	Flag(uSlot);
+}
+
+/// <summary>
+/// Sets a node's rotation relative to its parent and flags its subtree for the next update
+/// </summary>
+/// <param name="a_uNode">Node to change</param>
+/// <param name="a_f4Rotation">New rotation, a unit quaternion</param>
+void TransformHierarchy::SetRotation(uint32_t a_uNode, DirectX::XMFLOAT4 a_f4Rotation)
+{
+	uint32_t uSlot = SlotOf(a_uNode);
+	m_Local.RotationX[uSlot] = a_f4Rotation.x;
+	m_Local.RotationY[uSlot] = a_f4Rotation.y;
+	m_Local.RotationZ[uSlot] = a_f4Rotation.z;
+	m_Local.RotationW[uSlot] = a_f4Rotation.w;
+	Flag(uSlot);
+}
+
+/// <summary>
+/// Sets a node's scale relative to its parent and flags its subtree for the next update
+/// </summary>
+/// <param name="a_uNode">Node to change</param>
+/// <param name="a_f3Scale">New scale</param>
+void TransformHierarchy::SetScale(uint32_t a_uNode, DirectX::XMFLOAT3 a_f3Scale)
+{
+	uint32_t uSlot = SlotOf(a_uNode);
+	m_Local.ScaleX[uSlot] = a_f3Scale.x;
+	m_Local.ScaleY[uSlot] = a_f3Scale.y;
+	m_Local.ScaleZ[uSlot] = a_f3Scale.z;
+	Flag(uSlot);
+}
+
+/// <summary>
+/// Spreads large updates over a job scheduler's workers. Update() then has to run on one of its
+/// workers; elsewhere the jobs run one by one.
+/// </summary>
+/// <param name="a_spJobs">Scheduler to use, null to run every update on the calling thread</param>
+void TransformHierarchy::SetJobScheduler(std::shared_ptr<JobScheduler> a_spJobs)
+{
+	m_spJobs = a_spJobs;
+}
+#pragma endregion
+
+#pragma region Getters
+/// <summary>
+/// Gets a node's parent
+/// </summary>
+/// <param name="a_uNode">Node</param>
+/// <returns>Id of the parent, TRANSFORM_NONE for a root</returns>
+uint32_t TransformHierarchy::GetParent(uint32_t a_uNode)
+{
+	uint32_t uParentSlot = m_vParent[SlotOf(a_uNode)];
+	return uParentSlot == TRANSFORM_NONE ? TRANSFORM_NONE : m_vNodeOfSlot[uParentSlot];
+}
+
+/// <summary>
+/// Gets a node's transform relative to its parent
+/// </summary>
+/// <param name="a_uNode">Node</param>
+/// <returns>Local transform</returns>
+TransformLocal TransformHierarchy::GetLocal(uint32_t a_uNode)
+{
+	return m_Local.Get(SlotOf(a_uNode));
+}
+
+/// <summary>
+/// Gets a node's world matrix, updating the hierarchy first if anything changed
+/// </summary>
+/// <param name="a_uNode">Node</param>
+/// <returns>World matrix</returns>
+const DirectX::XMFLOAT4X4& TransformHierarchy::GetWorldMatrix(uint32_t a_uNode)
+{
+	if (m_bOrderDirty || !m_vDirtyNodes.empty())
+		Update();
+	return m_vWorld[SlotOf(a_uNode)];
+}
+
+/// <summary>
+/// Gets the inverse transpose of a node's world matrix, updating the hierarchy first if anything changed
+/// </summary>
+/// <param name="a_uNode">Node</param>
+/// <returns>Inverse transpose world matrix</returns>
+const DirectX::XMFLOAT4X4& TransformHierarchy::GetWorldInverseTransposeMatrix(uint32_t a_uNode)
+{
+	if (m_bOrderDirty || !m_vDirtyNodes.empty())
+		Update();
+	return m_vWorldInverseTranspose[SlotOf(a_uNode)];
+}
+
+/// <summary>
+/// Gets a counter that changes every time a node's world matrix does, whether it moved
+/// or one of its ancestors did (updates the hierarchy first if anything changed)
+/// </summary>
+/// <param name="a_uNode">Node</param>
+/// <returns>Version of the node's world matrix</returns>
+unsigned int TransformHierarchy::GetVersion(uint32_t a_uNode)
+{
+	if (m_bOrderDirty || !m_vDirtyNodes.empty())
+		Update();
+	return m_vVersion[SlotOf(a_uNode)];
+}
+
+/// <summary>
+/// Gets where a node's matrix is in GetWorldMatrices(). Only valid until the hierarchy
+/// next changes, since the update that follows may re-sort the slots.
+/// </summary>
+/// <param name="a_uNode">Node</param>
+/// <returns>Slot of the node</returns>
+uint32_t TransformHierarchy::GetSlot(uint32_t a_uNode)
+{
+	if (m_bOrderDirty || !m_vDirtyNodes.empty())
+		Update();
+	return SlotOf(a_uNode);
+}
+
+/// <summary>
+/// Gets the number of matrices in GetWorldMatrices(), including the slots of destroyed
+/// nodes that haven't been dropped yet
+/// </summary>
+/// <returns>Number of slots</returns>
+uint32_t TransformHierarchy::GetSlotCount()
+{
+	if (m_bOrderDirty || !m_vDirtyNodes.empty())
+		Update();
+	return (uint32_t)m_Local.Count;
+}
+
+/// <summary>
+/// Gets every node's world matrix in one contiguous array, in slot order, ready to be copied
+/// into a buffer as it is (updates the hierarchy first if anything changed)
+/// </summary>
+/// <returns>GetSlotCount() world matrices</returns>
+const DirectX::XMFLOAT4X4* TransformHierarchy::GetWorldMatrices()
+{
+	if (m_bOrderDirty || !m_vDirtyNodes.empty())
+		Update();
+	return m_vWorld.data();
+}
+
+/// <summary>
+/// Gets the size of the hierarchy and what the last update did
+/// </summary>
+/// <returns>Hierarchy statistics</returns>
+TransformHierarchyStats TransformHierarchy::GetStats()
+{
+	TransformHierarchyStats stats = m_Stats;
+	stats.Nodes = (unsigned int)(m_Local.Count - m_uDeadSlots);
+	stats.Roots = 0;
+	for (size_t i = 0; i < m_vParent.size(); i++)
+		if (m_vParent[i] == TRANSFORM_NONE && m_vNodeOfSlot[i] != TRANSFORM_NONE)
+			stats.Roots++;
+	return stats;
+}
+#pragma endregion
+
+/// <summary>
+/// Times the hierarchy's updates against a scene graph of separately allocated nodes that is
+/// walked from its roots and builds every matrix on its own, the way Transform used to. Needs
+/// no device, so it also runs without a window.
+/// </summary>
+/// <param name="a_uNodes">Number of nodes</param>
+/// <param name="a_uBranching">Children per node; 1 builds chains, 0 only roots</param>
+/// <param name="a_uChainLength">Nodes per chain when a_uBranching is 1</param>
+/// <param name="a_uSeed">Seed of the random local transforms</param>
+/// <returns>Timings</returns>
+TransformHierarchyBenchmark BenchmarkTransformHierarchy(unsigned int a_uNodes, unsigned int a_uBranching, unsigned int a_uChainLength, unsigned int a_uSeed)
+{
+	// parent of every node, in creation order: breadth-first for trees, one chain after another otherwise
+	std::vector<uint32_t> vParents(a_uNodes);
+	std::vector<unsigned int> vDepths(a_uNodes, 0);
+	TransformHierarchyBenchmark result = {};
+	result.Nodes = a_uNodes;
+	for (uint32_t i = 0; i < a_uNodes; i++)
+	{
+		if (a_uBranching > 1)
+			vParents[i] = i == 0 ? TRANSFORM_NONE : (i - 1) / a_uBranching;
+		else if (a_uBranching == 1)
+			vParents[i] = i % a_uChainLength == 0 ? TRANSFORM_NONE : i - 1;
+		else
+			vParents[i] = TRANSFORM_NONE;
+		vDepths[i] = vParents[i] == TRANSFORM_NONE ? 0 : vDepths[vParents[i]] + 1;
+		result.Depth = (std::max)(result.Depth, vDepths[i]);
+	}
+
+	// small offsets and rotations, so deep chains don't run off to infinity
+	std::mt19937 random(a_uSeed);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> angle(-0.1f, 0.1f);
+	std::uniform_real_distribution<float> scale(0.99f, 1.01f);
+	std::vector<TransformLocal> vLocals(a_uNodes);
+	std::vector<DirectX::XMFLOAT3> vAngles(a_uNodes);
+	for (uint32_t i = 0; i < a_uNodes; i++)
+	{
+		vAngles[i] = DirectX::XMFLOAT3(angle(random), angle(random), angle(random));
+		vLocals[i].Position = DirectX::XMFLOAT3(offset(random), offset(random), offset(random));
+		DirectX::XMStoreFloat4(&vLocals[i].Rotation, DirectX::XMQuaternionRotationRollPitchYaw(vAngles[i].x, vAngles[i].y, vAngles[i].z));
+		vLocals[i].Scale = DirectX::XMFLOAT3(scale(random), scale(random), scale(random));
+	}
+
+	// the calling thread is the scheduler's first worker, so Update() can spread over it
+	std::shared_ptr<JobScheduler> spJobs = std::make_shared<JobScheduler>();
+	result.Threads = spJobs->GetThreadCount();
+	TransformHierarchy hierarchy;
+	hierarchy.SetJobScheduler(spJobs);
+	for (uint32_t i = 0; i < a_uNodes; i++)
+	{
+		hierarchy.Create();
+		hierarchy.SetLocal(i, vLocals[i]);
+		if (vParents[i] != TRANSFORM_NONE)
+			hierarchy.SetParent(i, vParents[i]);
+	}
+	hierarchy.Update();
+
+	std::vector<uint32_t> vRoots;
+	for (uint32_t i = 0; i < a_uNodes; i++)
+		if (vParents[i] == TRANSFORM_NONE)
+			vRoots.push_back(i);
+	std::uniform_int_distribution<uint32_t> node(0, a_uNodes - 1);
+	auto Nudge = [&hierarchy](uint32_t a_uNode)
+	{
+		DirectX::XMFLOAT3 f3Position = hierarchy.GetLocal(a_uNode).Position;
+		f3Position.y += 0.01f;
+		hierarchy.SetPosition(a_uNode, f3Position);
+	};
+
+	result.FullMilliseconds = result.SingleThreadMilliseconds = result.PartialMilliseconds = result.PointerMilliseconds = 1e30;
+	for (int run = 0; run < TRANSFORM_HIERARCHY_BENCHMARK_RUNS; run++)
+	{
+		// every root moved, on the scheduler's workers and then on this thread alone
+		for (bool bJobs : { true, false })
+		{
+			hierarchy.SetJobScheduler(bJobs ? spJobs : nullptr);
+			for (uint32_t uRoot : vRoots)
+				Nudge(uRoot);
+			auto start = std::chrono::high_resolution_clock::now();
+			hierarchy.Update();
+			double& dBest = bJobs ? result.FullMilliseconds : result.SingleThreadMilliseconds;
+			dBest = (std::min)(dBest, MillisecondsSince(start));
+		}
+		hierarchy.SetJobScheduler(spJobs);
+
+		for (unsigned int i = 0; i < a_uNodes / 100; i++)
+			Nudge(node(random));
+		auto start = std::chrono::high_resolution_clock::now();
+		hierarchy.Update();
+		result.PartialMilliseconds = (std::min)(result.PartialMilliseconds, MillisecondsSince(start));
+	}
+
+	// the same tree as nodes that each live in their own allocation
+	std::vector<std::unique_ptr<PointerNode>> vNodes(a_uNodes);
+	for (uint32_t i = 0; i < a_uNodes; i++)
+	{
+		vNodes[i] = std::make_unique<PointerNode>();
+		vNodes[i]->Position = vLocals[i].Position;
+		vNodes[i]->PitchYawRoll = vAngles[i];
+		vNodes[i]->Scale = vLocals[i].Scale;
+		if (vParents[i] != TRANSFORM_NONE)
+			vNodes[vParents[i]]->Children.push_back(vNodes[i].get());
+	}
+	std::vector<std::pair<PointerNode*, const PointerNode*>> vStack;
+	for (int run = 0; run < TRANSFORM_HIERARCHY_BENCHMARK_RUNS; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t uRoot : vRoots)
+		{
+			vStack.push_back({ vNodes[uRoot].get(), nullptr });
+			while (!vStack.empty())
+			{
+				PointerNode* pNode = vStack.back().first;
+				const PointerNode* pParent = vStack.back().second;
+				vStack.pop_back();
+
+				DirectX::XMMATRIX t = DirectX::XMMatrixTranslation(pNode->Position.x, pNode->Position.y, pNode->Position.z);
+				DirectX::XMMATRIX r = DirectX::XMMatrixRotationRollPitchYaw(pNode->PitchYawRoll.x, pNode->PitchYawRoll.y, pNode->PitchYawRoll.z);
+				DirectX::XMMATRIX s = DirectX::XMMatrixScaling(pNode->Scale.x, pNode->Scale.y, pNode->Scale.z);
+				DirectX::XMMATRIX world = s * r * t;
+				if (pParent)
+					world = world * DirectX::XMLoadFloat4x4(&pParent->World);
+				DirectX::XMStoreFloat4x4(&pNode->World, world);
+				DirectX::XMStoreFloat4x4(&pNode->WorldInverseTranspose, DirectX::XMMatrixInverse(0, DirectX::XMMatrixTranspose(world)));
+				for (PointerNode* pChild : pNode->Children)
+					vStack.push_back({ pChild, pNode });
+			}
+		}
+		result.PointerMilliseconds = (std::min)(result.PointerMilliseconds, MillisecondsSince(start));
+	}
+
+	// back to the locals both sides started from, so every node's matrices have to agree
+	for (uint32_t i = 0; i < a_uNodes; i++)
+		hierarchy.SetLocal(i, vLocals[i]);
+	hierarchy.Update();
+	auto Compare = [&result](const DirectX::XMFLOAT4X4& a_m4Hierarchy, const DirectX::XMFLOAT4X4& a_m4Pointer, int a_nSize)
+	{
+		for (int r = 0; r < a_nSize; r++)
+			for (int c = 0; c < a_nSize; c++)
+				result.MaxDifference = (std::max)(result.MaxDifference,
+					fabsf(a_m4Hierarchy.m[r][c] - a_m4Pointer.m[r][c]) / (1.0f + fabsf(a_m4Pointer.m[r][c])));
+	};
+	for (uint32_t i = 0; i < a_uNodes; i++)
+	{
+		// the general inverse also fills in the translation column, which normals never use
+		Compare(hierarchy.GetWorldMatrix(i), vNodes[i]->World, 4);
+		Compare(hierarchy.GetWorldInverseTransposeMatrix(i), vNodes[i]->WorldInverseTranspose, 3);
+	}
+	return result;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "JobScheduler.h"
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Node id of no node (the parent of a root)
+#define TRANSFORM_NONE 0xFFFFFFFFu
+
+// Times each case of BenchmarkTransformHierarchy runs (the best run counts)
+#define TRANSFORM_HIERARCHY_BENCHMARK_RUNS 5
+
+// Largest difference BenchmarkTransformHierarchy allows between its two sides' matrices, relative to the element's size
+#define TRANSFORM_HIERARCHY_BENCHMARK_TOLERANCE 1e-3f
+
+// Transforms whose local matrices are built per loop iteration (one AVX register, or two SSE registers, per component)
+#define TRANSFORM_BATCH 8
+
+// Fewest transforms an update needs to change before it spreads the work over the job scheduler
+#define TRANSFORM_HIERARCHY_PARALLEL_NODES 8192
+
+// Changed subtrees larger than this are split into their children's subtrees, so they can go to different workers
+#define TRANSFORM_HIERARCHY_SPLIT_NODES 1024
+
+// Once more than 1 in this many slots are flagged, Update() finds them by walking the flags in slot order instead of sorting them
+#define TRANSFORM_HIERARCHY_SCAN_FRACTION 16
+
+// Fewest slots a job of a job-scheduled update takes (see SetJobScheduler)
+#define TRANSFORM_HIERARCHY_JOB_SLOTS 512
+
+// --------------------------------------------------------
+// A node's transform relative to its parent
+// --------------------------------------------------------
+struct TransformLocal
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT4 Rotation;	// unit quaternion
+	DirectX::XMFLOAT3 Scale;
+};
+
+// --------------------------------------------------------
+// Local transforms stored as separate arrays of each
+// component, so a batch of consecutive transforms loads
+// straight into SIMD registers, one transform per lane
+// --------------------------------------------------------
+struct TransformLocalList
+{
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> RotationX, RotationY, RotationZ, RotationW;
+	std::vector<float> ScaleX, ScaleY, ScaleZ;
+	size_t Count = 0;
+
+	void PushBack(const TransformLocal& a_Local);
+	TransformLocal Get(size_t a_uIndex) const;
+	void Set(size_t a_uIndex, const TransformLocal& a_Local);
+	void Gather(const std::vector<uint32_t>& a_vOrder);
+};
+
+// --------------------------------------------------------
+// What the last Update() did
+// --------------------------------------------------------
+struct TransformHierarchyStats
+{
+	unsigned int Nodes;
+	unsigned int Roots;
+	unsigned int DirtyRanges;	// subtrees recomputed by the last update
+	unsigned int UpdatedNodes;	// world matrices recomputed by the last update
+	unsigned int Reorders;		// times the arrays were re-sorted after the tree changed
+};
+
+// --------------------------------------------------------
+// Result of BenchmarkTransformHierarchy
+// --------------------------------------------------------
+struct TransformHierarchyBenchmark
+{
+	unsigned int Nodes;
+	unsigned int Depth;					// deepest node's distance from its root
+	unsigned int Threads;
+	double FullMilliseconds;			// every root moved: the linear pass over all nodes
+	double SingleThreadMilliseconds;	// the same on one thread
+	double PartialMilliseconds;			// 1% of the nodes moved: only their subtrees
+	double PointerMilliseconds;			// every root moved: separately allocated nodes, walked recursively, each building
+										// its matrices from pitch/yaw/roll and a general inverse the way Transform used to
+	float MaxDifference;				// largest relative difference between the two sides' world and normal matrices
+};
+
+// --------------------------------------------------------
+// Parent/child relationships between transforms, stored in
+// flat arrays sorted so every subtree is one contiguous run
+// of slots with its root first (depth-first order). Changing
+// a node flags it; Update() then recomputes the world
+// matrices of the flagged subtrees: first every local matrix,
+// a SIMD batch at a time, then one forward pass multiplying
+// in the parents, where each parent is done before its
+// children. Large updates split both passes over the
+// workers of the job scheduler it was given, if any.
+// Nodes are addressed by ids that survive the re-sorting the
+// arrays need when the tree's shape changes. One thread at a
+// time (a job counts as one).
+// --------------------------------------------------------
+class TransformHierarchy
+{
+public:
+	TransformHierarchy();
+	TransformHierarchy(const TransformHierarchy&) = delete;
+	TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+	// the hierarchy transforms are created in unless they're given one
+	static std::shared_ptr<TransformHierarchy> GetDefault();
+
+	uint32_t Create();
+	void Destroy(uint32_t a_uNode);
+	bool SetParent(uint32_t a_uNode, uint32_t a_uParent);
+	void Update();
+
+	// setters
+	void SetLocal(uint32_t a_uNode, const TransformLocal& a_Local);
+	void SetPosition(uint32_t a_uNode, DirectX::XMFLOAT3 a_f3Position);
+	void SetRotation(uint32_t a_uNode, DirectX::XMFLOAT4 a_f4Rotation);
+	void SetScale(uint32_t a_uNode, DirectX::XMFLOAT3 a_f3Scale);
+	void SetJobScheduler(std::shared_ptr<JobScheduler> a_spJobs);
+
+	// getters
+	uint32_t GetParent(uint32_t a_uNode);
+	TransformLocal GetLocal(uint32_t a_uNode);
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(uint32_t a_uNode);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(uint32_t a_uNode);
+	unsigned int GetVersion(uint32_t a_uNode);
+	uint32_t GetSlot(uint32_t a_uNode);
+	uint32_t GetSlotCount();
+	const DirectX::XMFLOAT4X4* GetWorldMatrices();
+	TransformHierarchyStats GetStats();
+
+private:
+	// one entry per slot, in depth-first order
+	TransformLocalList m_Local;
+	std::vector<uint32_t> m_vParent; //slot of the parent, TRANSFORM_NONE for roots
+	std::vector<uint32_t> m_vSubtreeSize; //slots the node and its descendants take, starting at its own
+	std::vector<DirectX::XMFLOAT4X4> m_vWorld;
+	std::vector<DirectX::XMFLOAT4X4> m_vWorldInverseTranspose; //normal matrix: only the upper 3x3 is filled in
+	std::vector<unsigned int> m_vVersion; //incremented whenever the world matrix changes
+	std::vector<uint8_t> m_vDirty; //the local transform changed since the last update
+	std::vector<uint32_t> m_vNodeOfSlot; //TRANSFORM_NONE for destroyed nodes until the next re-sort
+
+	// node ids
+	std::vector<uint32_t> m_vSlotOfNode; //TRANSFORM_NONE for free ids
+	std::vector<uint32_t> m_vFreeNodes;
+
+	std::vector<uint32_t> m_vDirtyNodes; //flagged since the last update
+	bool m_bOrderDirty; //a parent changed; the slots must be re-sorted before the next update
+	unsigned int m_uDeadSlots; //slots of destroyed nodes, dropped at the next re-sort
+	TransformHierarchyStats m_Stats;
+	std::shared_ptr<JobScheduler> m_spJobs; //spreads large updates over its workers; without one they run on the calling thread
+
+	void Reorder();
+	void UpdateSpans(const std::vector<std::pair<uint32_t, uint32_t>>& a_vSpans, uint32_t a_uNodes);
+	void Flag(uint32_t a_uSlot);
+	uint32_t SlotOf(uint32_t a_uNode);
+};
+
+// Times updating a hierarchy of about a_uNodes nodes: a_uBranching children per node down to
+// whatever depth reaches the count (1 gives a set of deep chains of a_uChainLength nodes each,
+// 0 gives nothing but roots)
+TransformHierarchyBenchmark BenchmarkTransformHierarchy(unsigned int a_uNodes, unsigned int a_uBranching, unsigned int a_uChainLength = 1024, unsigned int a_uSeed = 1);
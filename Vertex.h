@@ -1,6 +1,11 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+// Upload meshes as PackedVertex instead of full-precision Vertex data
+// (must match PACKED_VERTICES in ShaderStructs.hlsli)
+#define PACKED_VERTICES 1
 
 // --------------------------------------------------------
 // A custom vertex definition
@@ -13,5 +18,17 @@ struct Vertex
 	//DirectX::XMFLOAT4 Color;        // The color of the vertex
 	DirectX::XMFLOAT2 UV;
 	DirectX::XMFLOAT3 Normal;
-	DirectX::XMFLOAT3 Tangent;
-};
\ No newline at end of file
+	DirectX::XMFLOAT4 Tangent;		// xyz = tangent, w = handedness of the bitangent (+1 or -1)
+};
+
+// --------------------------------------------------------
+// Compressed version of Vertex that meshes upload to the GPU
+// (20 bytes instead of 44). Decoded in the vertex shaders.
+// --------------------------------------------------------
+struct PackedVertex
+{
+	DirectX::PackedVector::XMUSHORTN4 Position;	// R16G16B16A16_UNORM: xyz quantized against the mesh bounds, w = tangent handedness (0 = -1, 1 = +1)
+	DirectX::PackedVector::XMSHORTN2 Normal;	// R16G16_SNORM: octahedral-encoded normal
+	DirectX::PackedVector::XMSHORTN2 Tangent;	// R16G16_SNORM: octahedral-encoded tangent
+	DirectX::PackedVector::XMHALF2 UV;			// R16G16_FLOAT
+};
@@ -0,0 +1,181 @@
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	const float SNORM16_MAX = 32767.0f;
+	const float UNORM16_MAX = 65535.0f;
+
+	inline float SignNotZero(float a_fValue)
+	{
+		return a_fValue >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	inline bool IsFinite(const XMFLOAT3& a_f3Value)
+	{
+		return std::isfinite(a_f3Value.x) && std::isfinite(a_f3Value.y) && std::isfinite(a_f3Value.z);
+	}
+
+	/// <summary>
+	/// Maps a unit vector onto the [-1, 1] square (octahedral projection)
+	/// </summary>
+	XMFLOAT2 OctahedralEncode(XMFLOAT3 a_f3Direction)
+	{
+		float l1 = fabsf(a_f3Direction.x) + fabsf(a_f3Direction.y) + fabsf(a_f3Direction.z);
+		if (l1 <= 0.0f)
+			return XMFLOAT2(0.0f, 0.0f);
+
+		float x = a_f3Direction.x / l1;
+		float y = a_f3Direction.y / l1;
+		if (a_f3Direction.z < 0.0f)
+		{
+			// fold the lower hemisphere over the diagonals
+			float fx = (1.0f - fabsf(y)) * SignNotZero(x);
+			float fy = (1.0f - fabsf(x)) * SignNotZero(y);
+			x = fx;
+			y = fy;
+		}
+		return XMFLOAT2(x, y);
+	}
+
+	/// <summary>
+	/// Inverse of OctahedralEncode (matches OctahedralDecode in ShaderStructs.hlsli)
+	/// </summary>
+	XMFLOAT3 OctahedralDecode(float a_fX, float a_fY)
+	{
+		XMFLOAT3 n(a_fX, a_fY, 1.0f - fabsf(a_fX) - fabsf(a_fY));
+		float t = std::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+
+		float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		return XMFLOAT3(n.x / length, n.y / length, n.z / length);
+	}
+
+	inline float DecodeSnorm16(int16_t a_nValue)
+	{
+		return std::max(a_nValue / SNORM16_MAX, -1.0f);
+	}
+
+	/// <summary>
+	/// Quantizes a direction to two SNORM16 values. Tries the four neighbouring grid
+	/// points and keeps the one that decodes closest, instead of plain rounding.
+	/// </summary>
+	XMSHORTN2 PackDirection(XMFLOAT3 a_f3Direction)
+	{
+		XMFLOAT2 encoded = OctahedralEncode(a_f3Direction);
+		float length = sqrtf(a_f3Direction.x * a_f3Direction.x + a_f3Direction.y * a_f3Direction.y + a_f3Direction.z * a_f3Direction.z);
+		if (length <= 0.0f)
+			return XMSHORTN2((int16_t)0, (int16_t)0);
+
+		float baseX = floorf(encoded.x * SNORM16_MAX);
+		float baseY = floorf(encoded.y * SNORM16_MAX);
+
+		XMSHORTN2 best((int16_t)0, (int16_t)0);
+		float bestDot = -2.0f;
+		for (int i = 0; i < 4; i++)
+		{
+			int16_t x = (int16_t)std::clamp(baseX + (i & 1), -SNORM16_MAX, SNORM16_MAX);
+			int16_t y = (int16_t)std::clamp(baseY + (i >> 1), -SNORM16_MAX, SNORM16_MAX);
+			XMFLOAT3 decoded = OctahedralDecode(DecodeSnorm16(x), DecodeSnorm16(y));
+			float dot = (decoded.x * a_f3Direction.x + decoded.y * a_f3Direction.y + decoded.z * a_f3Direction.z) / length;
+			if (dot > bestDot)
+			{
+				bestDot = dot;
+				best = XMSHORTN2(x, y);
+			}
+		}
+		return best;
+	}
+
+	inline uint16_t QuantizeUnorm16(float a_fValue, float a_fMin, float a_fExtent)
+	{
+		if (a_fExtent <= 0.0f)
+			return 0;
+		float normalized = std::clamp((a_fValue - a_fMin) / a_fExtent, 0.0f, 1.0f);
+		return (uint16_t)(normalized * UNORM16_MAX + 0.5f);
+	}
+
+	/// <summary>
+	/// Angle between two directions in degrees (the original doesn't need to be normalized)
+	/// </summary>
+	float AngleDegrees(XMFLOAT3 a_f3Original, XMFLOAT3 a_f3Decoded)
+	{
+		float length = sqrtf(a_f3Original.x * a_f3Original.x + a_f3Original.y * a_f3Original.y + a_f3Original.z * a_f3Original.z);
+		if (length <= 0.0f || !IsFinite(a_f3Original))
+			return 0.0f;
+
+		float dot = (a_f3Original.x * a_f3Decoded.x + a_f3Original.y * a_f3Decoded.y + a_f3Original.z * a_f3Decoded.z) / length;
+		return XMConvertToDegrees(acosf(std::clamp(dot, -1.0f, 1.0f)));
+	}
+}
+
+/// <summary>
+/// Packs verticies into the compressed GPU format: positions become UNORM16 relative to the
+/// bounds, normals and tangents are octahedral SNORM16 pairs, and UVs become half floats.
+/// The tangent's handedness (Tangent.w) goes into Position.w.
+/// </summary>
+/// <param name="a_pVertices">Full-precision verticies</param>
+/// <param name="a_uVertexCount">Number of verticies</param>
+/// <param name="a_f3BoundsMin">Minimum corner of the bounds the positions are quantized against</param>
+/// <param name="a_f3BoundsMax">Maximum corner of the bounds the positions are quantized against</param>
+/// <param name="a_pPacked">Output array with room for a_uVertexCount verticies</param>
+/// <returns>Worst-case round-trip error</returns>
+VertexPackingError PackVertices(const Vertex* a_pVertices, size_t a_uVertexCount,
+	XMFLOAT3 a_f3BoundsMin, XMFLOAT3 a_f3BoundsMax, PackedVertex* a_pPacked)
+{
+	VertexPackingError error = {};
+	XMFLOAT3 extent(a_f3BoundsMax.x - a_f3BoundsMin.x, a_f3BoundsMax.y - a_f3BoundsMin.y, a_f3BoundsMax.z - a_f3BoundsMin.z);
+
+	for (size_t i = 0; i < a_uVertexCount; i++)
+	{
+		const Vertex& v = a_pVertices[i];
+		PackedVertex& packed = a_pPacked[i];
+
+		packed.Position = XMUSHORTN4(
+			QuantizeUnorm16(v.Position.x, a_f3BoundsMin.x, extent.x),
+			QuantizeUnorm16(v.Position.y, a_f3BoundsMin.y, extent.y),
+			QuantizeUnorm16(v.Position.z, a_f3BoundsMin.z, extent.z),
+			v.Tangent.w < 0.0f ? (uint16_t)0 : (uint16_t)UNORM16_MAX);
+		XMFLOAT3 tangent(v.Tangent.x, v.Tangent.y, v.Tangent.z);
+		packed.Normal = PackDirection(IsFinite(v.Normal) ? v.Normal : XMFLOAT3(0, 0, 0));
+		packed.Tangent = PackDirection(IsFinite(tangent) ? tangent : XMFLOAT3(0, 0, 0));
+		packed.UV = XMHALF2(XMConvertFloatToHalf(v.UV.x), XMConvertFloatToHalf(v.UV.y));
+
+		// round trip
+		Vertex decoded = UnpackVertex(packed, a_f3BoundsMin, a_f3BoundsMax);
+		float dx = decoded.Position.x - v.Position.x;
+		float dy = decoded.Position.y - v.Position.y;
+		float dz = decoded.Position.z - v.Position.z;
+		error.Position = std::max(error.Position, sqrtf(dx * dx + dy * dy + dz * dz));
+		error.Normal = std::max(error.Normal, AngleDegrees(v.Normal, decoded.Normal));
+		error.Tangent = std::max(error.Tangent, AngleDegrees(tangent, XMFLOAT3(decoded.Tangent.x, decoded.Tangent.y, decoded.Tangent.z)));
+		error.UV = std::max(error.UV, std::max(fabsf(decoded.UV.x - v.UV.x), fabsf(decoded.UV.y - v.UV.y)));
+	}
+	return error;
+}
+
+/// <summary>
+/// Decodes a packed vertex the same way the vertex shaders do
+/// </summary>
+/// <param name="a_Packed">Packed vertex</param>
+/// <param name="a_f3BoundsMin">Minimum corner of the bounds the position was quantized against</param>
+/// <param name="a_f3BoundsMax">Maximum corner of the bounds the position was quantized against</param>
+/// <returns>Decoded vertex</returns>
+Vertex UnpackVertex(const PackedVertex& a_Packed, XMFLOAT3 a_f3BoundsMin, XMFLOAT3 a_f3BoundsMax)
+{
+	Vertex v;
+	v.Position = XMFLOAT3(
+		a_f3BoundsMin.x + a_Packed.Position.x / UNORM16_MAX * (a_f3BoundsMax.x - a_f3BoundsMin.x),
+		a_f3BoundsMin.y + a_Packed.Position.y / UNORM16_MAX * (a_f3BoundsMax.y - a_f3BoundsMin.y),
+		a_f3BoundsMin.z + a_Packed.Position.z / UNORM16_MAX * (a_f3BoundsMax.z - a_f3BoundsMin.z));
+	v.Normal = OctahedralDecode(DecodeSnorm16(a_Packed.Normal.x), DecodeSnorm16(a_Packed.Normal.y));
+	XMFLOAT3 tangent = OctahedralDecode(DecodeSnorm16(a_Packed.Tangent.x), DecodeSnorm16(a_Packed.Tangent.y));
+	v.Tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, a_Packed.Position.w / UNORM16_MAX * 2.0f - 1.0f);
+	v.UV = XMFLOAT2(XMConvertHalfToFloat(a_Packed.UV.x), XMConvertHalfToFloat(a_Packed.UV.y));
+	return v;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Worst-case round-trip error of a set of packed verticies
+// --------------------------------------------------------
+struct VertexPackingError
+{
+	float Position;	// largest distance between original and decoded position (object units)
+	float Normal;	// largest angle between original and decoded normal (degrees)
+	float Tangent;	// largest angle between original and decoded tangent (degrees)
+	float UV;		// largest difference in either UV component
+};
+
+// Packs verticies against the given bounds and reports the round-trip error
+VertexPackingError PackVertices(const Vertex* a_pVertices, size_t a_uVertexCount,
+	DirectX::XMFLOAT3 a_f3BoundsMin, DirectX::XMFLOAT3 a_f3BoundsMax, PackedVertex* a_pPacked);
+
+// Decodes a packed vertex exactly like the vertex shaders do
+Vertex UnpackVertex(const PackedVertex& a_Packed, DirectX::XMFLOAT3 a_f3BoundsMin, DirectX::XMFLOAT3 a_f3BoundsMax);
@@ -10,6 +10,8 @@ cbuffer ExternalData : register(b0)
     matrix projection;
     matrix lightViews[5];
     matrix lightProjections[5];
+    float3 positionOffset;
+    float3 positionScale;
 }
 
 // --------------------------------------------------------
@@ -19,8 +21,10 @@ cbuffer ExternalData : register(b0)
 // - Output is a single struct of data to pass down the pipeline
 // - Named "main" because that's the default the shader compiler looks for
 // --------------------------------------------------------
-VertexToPixel main( VertexShaderInput input )
+VertexToPixel main( MESH_VERTEX_INPUT vertex )
 {
+    VertexShaderInput input = UNPACK_VERTEX(vertex);
+
 	// Set up output struct
 	VertexToPixel output;
 
@@ -45,7 +49,7 @@ VertexToPixel main( VertexShaderInput input )
 	// pass the UV and normal data down the pipeline
     output.uv = input.uv;
     output.normal = mul((float3x3) worldInvTranspose, input.normal); // account for transformation
-    output.tangent = mul((float3x3) world, input.tangent); // same for tangent, but with the world matrix
+    output.tangent = float4(mul((float3x3) world, input.tangent.xyz), input.tangent.w); // same for tangent, but with the world matrix
 	
 	// get the world position
     output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
@@ -0,0 +1,44 @@
+#include "ShaderStructs.hlsli"
+
+//constant buffer input (VertexShader.hlsl's, with the world matrices coming from the instance instead)
+cbuffer ExternalData : register(b0)
+{
+    float4 colorTint;
+    matrix view;
+    matrix projection;
+    matrix lightViews[5];
+    matrix lightProjections[5];
+    float3 positionOffset;
+    float3 positionScale;
+}
+
+// --------------------------------------------------------
+// VertexShader.hlsl for instanced draws: every instance of
+// the mesh is drawn with the matrices of its InstanceData
+// --------------------------------------------------------
+VertexToPixel main( MESH_VERTEX_INPUT vertex, InstanceInput instance )
+{
+    VertexShaderInput input = UNPACK_VERTEX(vertex);
+    matrix world = InstanceWorld(instance);
+
+	// Set up output struct
+	VertexToPixel output;
+
+	// get the world position, and project it
+    float4 worldPosition = mul(world, float4(input.localPosition, 1.0f));
+    output.screenPosition = mul(projection, mul(view, worldPosition));
+	
+	// pass the UV and normal data down the pipeline
+    output.uv = input.uv;
+    output.normal = mul(InstanceWorldInvTranspose(instance), input.normal); // account for transformation
+    output.tangent = float4(mul((float3x3) world, input.tangent.xyz), input.tangent.w); // same for tangent, but with the world matrix
+    output.worldPosition = worldPosition.xyz;
+	
+	// calculate the positions for each shadow map
+    for (int i = 0; i < 5; i++)
+    {
+        output.shadowMapPositions[i] = mul(lightProjections[i], mul(lightViews[i], worldPosition));
+    }
+
+	return output;
+}
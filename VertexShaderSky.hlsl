@@ -4,10 +4,13 @@ cbuffer ExternalData : register(b0)
 {
     matrix view;
     matrix projection;
+    float3 positionOffset;
+    float3 positionScale;
 };
 
-VertexToPixel_Sky main( VertexShaderInput input )
+VertexToPixel_Sky main( MESH_VERTEX_INPUT vertex )
 {
+    VertexShaderInput input = UNPACK_VERTEX(vertex);
     VertexToPixel_Sky output;
     
     matrix viewNoTranslation = view;